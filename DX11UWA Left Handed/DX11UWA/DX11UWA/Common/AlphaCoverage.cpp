@@ -0,0 +1,155 @@
+#include "AlphaCoverage.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <mutex>
+
+using namespace DX;
+
+namespace
+{
+	// Below this many texels a surface is analyzed on the calling thread.
+	const size_t ParallelThreshold = 128 * 1024;
+
+	void AnalyzeRow(const uint32_t* row, size_t width, uint32_t cutoff, AlphaCoverage& out)
+	{
+		size_t x = 0;
+		uint64_t opaque = 0;
+		uint64_t clear = 0;
+		uint64_t below = 0;
+
+#if DX_SIMD_SSE2
+		// Compare masks are -1 per matching lane, so subtracting them counts matches. The 32-bit
+		// lane counters are flushed every block to stay far from overflow on wide rows.
+		const __m128i full = _mm_set1_epi32(255);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i limit = _mm_set1_epi32(static_cast<int>(cutoff));
+		const size_t block = 1u << 20;
+		while (x + 4 <= width)
+		{
+			__m128i opaqueCount = zero;
+			__m128i clearCount = zero;
+			__m128i belowCount = zero;
+			size_t end = std::min(width & ~size_t(3), x + block);
+			for (; x < end; x += 4)
+			{
+				__m128i a = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), 24);
+				opaqueCount = _mm_sub_epi32(opaqueCount, _mm_cmpeq_epi32(a, full));
+				clearCount = _mm_sub_epi32(clearCount, _mm_cmpeq_epi32(a, zero));
+				belowCount = _mm_sub_epi32(belowCount, _mm_cmplt_epi32(a, limit));
+			}
+
+			alignas(16) uint32_t lanes[3][4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), opaqueCount);
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), clearCount);
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), belowCount);
+			for (int i = 0; i < 4; ++i)
+			{
+				opaque += lanes[0][i];
+				clear += lanes[1][i];
+				below += lanes[2][i];
+			}
+		}
+#endif
+		for (; x < width; ++x)
+		{
+			uint32_t a = row[x] >> 24;
+			opaque += (a == 255);
+			clear += (a == 0);
+			below += (a < cutoff);
+		}
+
+		out.texels += width;
+		out.opaque += opaque;
+		out.clear += clear;
+		out.belowCutoff += below;
+	}
+}
+
+void AlphaCoverage::Add(const AlphaCoverage& other)
+{
+	texels += other.texels;
+	opaque += other.opaque;
+	clear += other.clear;
+	belowCutoff += other.belowCutoff;
+}
+
+AlphaCoverage DX::AnalyzeAlpha(const uint32_t* texels, size_t width, size_t height, size_t pitch, uint8_t cutoff)
+{
+	AlphaCoverage total;
+	if (width * height < ParallelThreshold)
+	{
+		for (size_t y = 0; y < height; ++y)
+		{
+			AnalyzeRow(texels + y * pitch, width, cutoff, total);
+		}
+		return total;
+	}
+
+	std::mutex lock;
+	size_t grain = ParallelThreshold / 4 / width + 1;
+	WorkerPool::Shared().ParallelFor(height, grain, [&](size_t begin, size_t end)
+	{
+		AlphaCoverage partial;
+		for (size_t y = begin; y < end; ++y)
+		{
+			AnalyzeRow(texels + y * pitch, width, cutoff, partial);
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		total.Add(partial);
+	});
+	return total;
+}
+
+AlphaClass DX::ClassifyAlpha(const AlphaCoverage& coverage, const AlphaSettings& settings)
+{
+	if (coverage.belowCutoff == 0)
+		return AlphaOpaque;
+
+	uint64_t partial = coverage.texels - coverage.opaque - coverage.clear;
+	if (double(partial) <= double(coverage.texels) * settings.blendedFraction)
+		return AlphaTested;
+
+	return AlphaBlended;
+}
+
+AlphaClass DX::ClassifyImageAlpha(const DDSImage& image, std::vector<AlphaClass>* perMip, const AlphaSettings& settings)
+{
+	if (perMip)
+	{
+		perMip->clear();
+	}
+
+	AlphaClass worst = AlphaOpaque;
+	for (uint32_t mip = 0; mip < image.mipLevels; ++mip)
+	{
+		AlphaCoverage level;
+		for (uint32_t face = 0; face < image.faceCount; ++face)
+		{
+			uint32_t width = image.LevelWidth(mip);
+			level.Add(AnalyzeAlpha(image.Level(face, mip), width, image.LevelHeight(mip), width, settings.cutoff));
+		}
+
+		AlphaClass levelClass = ClassifyAlpha(level, settings);
+		worst = std::max(worst, levelClass);
+		if (perMip)
+		{
+			perMip->push_back(levelClass);
+		}
+	}
+	return worst;
+}
+
+const char* DX::AlphaClassName(AlphaClass alphaClass)
+{
+	switch (alphaClass)
+	{
+	case AlphaOpaque:
+		return "opaque";
+	case AlphaTested:
+		return "alpha tested";
+	default:
+		return "blended";
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "DDSFile.h"
+
+// Load-time alpha analysis of 32-bit textures. The renderer uses the result to draw
+// materials that can never hit the alpha-test discard with a shader that doesn't
+// contain one, which keeps early depth testing enabled for them.
+// This file has no Direct3D dependencies.
+namespace DX
+{
+	enum AlphaClass : uint32_t
+	{
+		AlphaOpaque = 0,  // No texel is below the cutoff, so a discard would never fire.
+		AlphaTested,      // Texels are mostly fully opaque or fully clear; the discard does real work.
+		AlphaBlended,     // Many partially transparent texels.
+	};
+
+	// Texel counts for one surface. Alpha is the top byte of each texel in both RGBA and BGRA order.
+	struct AlphaCoverage
+	{
+		uint64_t texels = 0;
+		uint64_t opaque = 0;       // alpha == 255
+		uint64_t clear = 0;        // alpha == 0
+		uint64_t belowCutoff = 0;  // alpha < cutoff, i.e. texels the shader would discard
+
+		void Add(const AlphaCoverage& other);
+	};
+
+	struct AlphaSettings
+	{
+		uint8_t cutoff = 128;          // Matches "if (a < 0.5f) discard" for UNORM8 alpha.
+		float   blendedFraction = 0.1f; // Share of partial texels above which a surface counts as blended.
+	};
+
+	// Counts the alpha values of a width x height surface. pitch is in texels.
+	AlphaCoverage AnalyzeAlpha(const uint32_t* texels, size_t width, size_t height, size_t pitch, uint8_t cutoff);
+
+	AlphaClass ClassifyAlpha(const AlphaCoverage& coverage, const AlphaSettings& settings = AlphaSettings());
+
+	// Classifies every mip of every face; perMip receives one entry per mip level (faces combined).
+	// The returned class is the least opaque of all levels, since the sampler can reach any of them.
+	AlphaClass ClassifyImageAlpha(const DDSImage& image, std::vector<AlphaClass>* perMip = nullptr,
+								  const AlphaSettings& settings = AlphaSettings());
+
+	const char* AlphaClassName(AlphaClass alphaClass);
+}
@@ -0,0 +1,156 @@
+#include "AnimationCurve.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DX;
+
+AnimationCurve::AnimationCurve(CurveInterpolation interpolation, CurveWrap wrap) :
+	m_interpolation(interpolation),
+	m_wrap(wrap)
+{
+}
+
+void AnimationCurve::AddKey(float time, float value, float tangent)
+{
+	CurveKey key = { time, value, tangent };
+	auto at = std::lower_bound(m_keys.begin(), m_keys.end(), time,
+							   [](const CurveKey& k, float t) { return k.time < t; });
+	if (at != m_keys.end() && at->time == time)
+		*at = key;
+	else
+		m_keys.insert(at, key);
+}
+
+void AnimationCurve::SmoothTangents(void)
+{
+	size_t count = m_keys.size();
+	if (count < 2)
+	{
+		for (CurveKey& key : m_keys)
+		{
+			key.tangent = 0.0f;
+		}
+		return;
+	}
+
+	for (size_t i = 1; i + 1 < count; ++i)
+	{
+		const CurveKey& before = m_keys[i - 1];
+		const CurveKey& after = m_keys[i + 1];
+		m_keys[i].tangent = (after.value - before.value) / (after.time - before.time);
+	}
+	float seam = 0.0f;
+	if (m_wrap == CurveLoop && count > 2)
+	{
+		// The last key stands for the first, so the neighbours across the seam are keys 1 and count - 2.
+		const CurveKey& before = m_keys[count - 2];
+		const CurveKey& after = m_keys[1];
+		float span = (after.time - m_keys[0].time) + (m_keys[count - 1].time - before.time);
+		seam = (after.value - before.value) / span;
+	}
+	m_keys[0].tangent = seam;
+	m_keys[count - 1].tangent = seam;
+}
+
+float AnimationCurve::Evaluate(double time) const
+{
+	if (m_keys.empty())
+		return 0.0f;
+	if (m_keys.size() == 1)
+		return m_keys[0].value;
+
+	float direction;
+	float t = Wrap(time, direction);
+	size_t i = FindSegment(t);
+	const CurveKey& k0 = m_keys[i];
+	const CurveKey& k1 = m_keys[i + 1];
+	float dt = k1.time - k0.time;
+	float s = (t - k0.time) / dt;
+	if (m_interpolation == CurveLinear)
+		return k0.value + (k1.value - k0.value) * s;
+
+	float s2 = s * s;
+	float s3 = s2 * s;
+	float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+	float h10 = s3 - 2.0f * s2 + s;
+	float h01 = 3.0f * s2 - 2.0f * s3;
+	float h11 = s3 - s2;
+	return h00 * k0.value + h10 * dt * k0.tangent + h01 * k1.value + h11 * dt * k1.tangent;
+}
+
+float AnimationCurve::EvaluateSlope(double time) const
+{
+	if (m_keys.size() < 2)
+		return 0.0f;
+
+	float direction;
+	float t = Wrap(time, direction);
+	if (direction == 0.0f)
+		return 0.0f;
+
+	size_t i = FindSegment(t);
+	const CurveKey& k0 = m_keys[i];
+	const CurveKey& k1 = m_keys[i + 1];
+	float dt = k1.time - k0.time;
+	if (m_interpolation == CurveLinear)
+		return direction * (k1.value - k0.value) / dt;
+
+	float s = (t - k0.time) / dt;
+	float s2 = s * s;
+	float d00 = 6.0f * s2 - 6.0f * s;
+	float d10 = 3.0f * s2 - 4.0f * s + 1.0f;
+	float d11 = 3.0f * s2 - 2.0f * s;
+	float slope = (d00 * (k0.value - k1.value)) / dt + d10 * k0.tangent + d11 * k1.tangent;
+	return direction * slope;
+}
+
+float AnimationCurve::Wrap(double time, float& direction) const
+{
+	double first = m_keys.front().time;
+	double duration = m_keys.back().time - first;
+	double local = time - first;
+	direction = 1.0f;
+	if (duration <= 0.0)
+	{
+		direction = 0.0f;
+		return m_keys.front().time;
+	}
+
+	switch (m_wrap)
+	{
+	case CurveLoop:
+		local = fmod(local, duration);
+		if (local < 0.0)
+			local += duration;
+		break;
+
+	case CurvePingPong:
+		local = fmod(local, 2.0 * duration);
+		if (local < 0.0)
+			local += 2.0 * duration;
+		if (local > duration)
+		{
+			local = 2.0 * duration - local;
+			direction = -1.0f;
+		}
+		break;
+
+	default:
+		if (local < 0.0 || local > duration)
+		{
+			local = std::min(std::max(local, 0.0), duration);
+			direction = 0.0f;
+		}
+		break;
+	}
+	return static_cast<float>(first + local);
+}
+
+size_t AnimationCurve::FindSegment(float t) const
+{
+	auto after = std::upper_bound(m_keys.begin(), m_keys.end(), t,
+								  [](float value, const CurveKey& k) { return value < k.time; });
+	size_t i = static_cast<size_t>(after - m_keys.begin());
+	return std::min(std::max(i, size_t(1)), m_keys.size() - 1) - 1;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Keyframed curves of one value over time, in seconds, for animating light and scene parameters
+// from StepTimer's clock rather than per frame. Keys are interpolated linearly or with cubic
+// Hermite splines through per-key tangents; past the last key a curve holds its end values,
+// starts over, or runs back to its first key.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum CurveInterpolation : uint32_t
+	{
+		CurveLinear = 0,
+		CurveHermite
+	};
+
+	enum CurveWrap : uint32_t
+	{
+		CurveClamp = 0,
+		CurveLoop,			// The last key should have the first one's value, or the curve jumps.
+		CurvePingPong
+	};
+
+	struct CurveKey
+	{
+		float time;			// Seconds.
+		float value;
+		float tangent;		// Value per second, for Hermite interpolation.
+	};
+
+	class AnimationCurve
+	{
+	public:
+		AnimationCurve(CurveInterpolation interpolation = CurveLinear, CurveWrap wrap = CurveClamp);
+
+		void SetInterpolation(CurveInterpolation interpolation) { m_interpolation = interpolation; }
+		void SetWrap(CurveWrap wrap) { m_wrap = wrap; }
+		CurveInterpolation GetInterpolation(void) const { return m_interpolation; }
+		CurveWrap GetWrap(void) const { return m_wrap; }
+
+		// Keys may be added in any order; a key at the time of an existing one replaces it.
+		void AddKey(float time, float value, float tangent = 0.0f);
+		void Clear(void) { m_keys.clear(); }
+		// Catmull-Rom tangents for every key. The ends of clamped and ping-pong curves get flat
+		// tangents, so the value eases into its turns; a loop's ends share one tangent across the seam.
+		void SmoothTangents(void);
+
+		size_t GetKeyCount(void) const { return m_keys.size(); }
+		const CurveKey* GetKeys(void) const { return m_keys.data(); }
+		// From the first key to the last.
+		float GetDuration(void) const { return m_keys.empty() ? 0.0f : m_keys.back().time - m_keys.front().time; }
+
+		// time is in seconds and may lie anywhere; doubles keep a long-running clock precise. An
+		// empty curve is 0.
+		float Evaluate(double time) const;
+		// Change per second at time: negative while a ping-pong curve runs back, 0 while a clamped
+		// one holds.
+		float EvaluateSlope(double time) const;
+
+	private:
+		// Maps time onto the keys' span. direction is 1 where the curve runs forward, -1 where it
+		// runs back and 0 where it holds.
+		float Wrap(double time, float& direction) const;
+		// The key starting the segment t is in; t must lie within the keys.
+		size_t FindSegment(float t) const;
+
+		std::vector<CurveKey> m_keys;		// In time order.
+		CurveInterpolation m_interpolation;
+		CurveWrap m_wrap;
+	};
+}
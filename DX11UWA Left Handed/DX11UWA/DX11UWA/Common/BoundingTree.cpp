@@ -0,0 +1,797 @@
+#include "BoundingTree.h"
+#include "SimdConfig.h"
+
+#include <math.h>
+#include <float.h>
+
+using namespace DX;
+
+namespace
+{
+	float Area(const float* min, const float* max)
+	{
+		float dx = max[0] - min[0];
+		float dy = max[1] - min[1];
+		float dz = max[2] - min[2];
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	void Union(const float* minA, const float* maxA, const float* minB, const float* maxB, float* min, float* max)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = minA[axis] < minB[axis] ? minA[axis] : minB[axis];
+			max[axis] = maxA[axis] > maxB[axis] ? maxA[axis] : maxB[axis];
+		}
+	}
+
+	float UnionArea(const float* minA, const float* maxA, const float* minB, const float* maxB)
+	{
+		float min[3], max[3];
+		Union(minA, maxA, minB, maxB, min, max);
+		return Area(min, max);
+	}
+
+	// Node indices still to visit. Trees stay far shallower than the inline capacity, but a
+	// degenerate one spills to the heap instead of overflowing.
+	class TraversalStack
+	{
+	public:
+		TraversalStack() : m_data(m_local), m_size(0), m_capacity(LocalCapacity) {}
+
+		bool Empty(void) const { return m_size == 0; }
+		uint32_t Pop(void) { return m_data[--m_size]; }
+		void Push(uint32_t node)
+		{
+			if (m_size == m_capacity)
+			{
+				if (m_data == m_local)
+				{
+					m_heap.assign(m_local, m_local + m_size);
+				}
+				m_capacity *= 2;
+				m_heap.resize(m_capacity);
+				m_data = m_heap.data();
+			}
+			m_data[m_size++] = node;
+		}
+
+	private:
+		static const size_t LocalCapacity = 64;
+		uint32_t m_local[LocalCapacity];
+		std::vector<uint32_t> m_heap;
+		uint32_t* m_data;
+		size_t m_size;
+		size_t m_capacity;
+	};
+
+#if DX_SIMD_SSE2
+	// Loads a box corner. The fourth lane holds an index that reads as a denormal float, which
+	// would slow down every instruction it passes through, so it is cleared right away.
+	__m128 LoadCorner(const float* corner)
+	{
+		return _mm_and_ps(_mm_loadu_ps(corner), _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+	}
+#endif
+
+	enum Overlap
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	// The six frustum planes as structure-of-arrays, padded to eight with planes every box is
+	// inside of, so a node is tested against four planes per instruction.
+	struct PlaneSet
+	{
+		float x[8], y[8], z[8], w[8];
+
+		explicit PlaneSet(const Frustum& frustum)
+		{
+			for (int i = 0; i < 8; ++i)
+			{
+				bool real = i < Frustum::PlaneCount;
+				x[i] = real ? frustum.planes[i][0] : 0.0f;
+				y[i] = real ? frustum.planes[i][1] : 0.0f;
+				z[i] = real ? frustum.planes[i][2] : 0.0f;
+				w[i] = real ? frustum.planes[i][3] : FLT_MAX;
+			}
+		}
+
+		// active has one bit per plane the box's parent straddles; planes it was fully inside of can't
+		// cut its children, so they are skipped. On return, active holds the planes this box straddles.
+		Overlap Test(const float* min, const float* max, uint32_t& active) const
+		{
+#if DX_SIMD_SSE2
+			__m128 lo = LoadCorner(min);
+			__m128 hi = LoadCorner(max);
+			__m128 half = _mm_set1_ps(0.5f);
+			__m128 center = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+			__m128 extent = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+			__m128 cx = _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 cy = _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 cz = _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 ex = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 ey = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 ez = _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2));
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			const __m128 zero = _mm_setzero_ps();
+
+			uint32_t straddling = 0;
+			for (int group = 0; group < 8; group += 4)
+			{
+				if (((active >> group) & 0xf) == 0)
+					continue;
+
+				__m128 px = _mm_loadu_ps(x + group);
+				__m128 py = _mm_loadu_ps(y + group);
+				__m128 pz = _mm_loadu_ps(z + group);
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+											 _mm_add_ps(_mm_mul_ps(pz, cz), _mm_loadu_ps(w + group)));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+													 _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+										  _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+				if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, reach), zero)))
+					return Outside;
+				straddling |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, reach), zero))) << group;
+			}
+			active &= straddling;
+#else
+			for (int i = 0; i < Frustum::PlaneCount; ++i)
+			{
+				if (!(active & (1u << i)))
+					continue;
+
+				float distance = w[i];
+				float reach = 0.0f;
+				const float plane[3] = { x[i], y[i], z[i] };
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					distance += plane[axis] * 0.5f * (min[axis] + max[axis]);
+					reach += fabsf(plane[axis]) * 0.5f * (max[axis] - min[axis]);
+				}
+				if (distance + reach < 0.0f)
+					return Outside;
+				if (distance - reach >= 0.0f)
+					active &= ~(1u << i);
+			}
+#endif
+			return active ? Intersecting : Inside;
+		}
+	};
+
+	bool SphereTouchesBox(const float* center, float radiusSq, const float* min, const float* max)
+	{
+#if DX_SIMD_SSE2
+		__m128 c = _mm_set_ps(0.0f, center[2], center[1], center[0]);
+		__m128 zero = _mm_setzero_ps();
+		__m128 below = _mm_max_ps(_mm_sub_ps(LoadCorner(min), c), zero);
+		__m128 above = _mm_max_ps(_mm_sub_ps(c, LoadCorner(max)), zero);
+		__m128 d = _mm_add_ps(below, above);
+		d = _mm_mul_ps(d, d);
+		d = _mm_add_ps(d, _mm_movehl_ps(d, d));
+		d = _mm_add_ss(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1)));
+		return _mm_cvtss_f32(d) <= radiusSq;
+#else
+		float distanceSq = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float d = center[axis] < min[axis] ? min[axis] - center[axis] : (center[axis] > max[axis] ? center[axis] - max[axis] : 0.0f);
+			distanceSq += d * d;
+		}
+		return distanceSq <= radiusSq;
+#endif
+	}
+
+	// Slab test. Zero direction components are nudged to a tiny value so the reciprocal stays finite.
+	struct Ray
+	{
+		float origin[4];
+		float inverse[4];
+		float maxDistance;
+
+		Ray(const float o[3], const float direction[3], float distance) : maxDistance(distance)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float d = direction[axis];
+				if (fabsf(d) < 1e-20f)
+				{
+					d = d < 0.0f ? -1e-20f : 1e-20f;
+				}
+				origin[axis] = o[axis];
+				inverse[axis] = 1.0f / d;
+			}
+			origin[3] = 0.0f;
+			inverse[3] = 0.0f;
+		}
+
+		// Returns the entry distance, or a negative value on a miss.
+		float Enter(const float* min, const float* max) const
+		{
+#if DX_SIMD_SSE2
+			const __m128 lanes = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			__m128 o = _mm_loadu_ps(origin);
+			__m128 inv = _mm_loadu_ps(inverse);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(LoadCorner(min), o), inv);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(LoadCorner(max), o), inv);
+			__m128 limit = _mm_set1_ps(maxDistance);
+			__m128 tNear = _mm_max_ps(_mm_and_ps(_mm_min_ps(t1, t2), lanes), _mm_setzero_ps());
+			__m128 tFar = _mm_or_ps(_mm_and_ps(_mm_max_ps(t1, t2), lanes), _mm_andnot_ps(lanes, limit));
+			tFar = _mm_min_ps(tFar, limit);
+			tNear = _mm_max_ps(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 0, 3, 2)));
+			tNear = _mm_max_ss(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 3, 0, 1)));
+			tFar = _mm_min_ps(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 0, 3, 2)));
+			tFar = _mm_min_ss(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 3, 0, 1)));
+			float enter = _mm_cvtss_f32(tNear);
+			return enter <= _mm_cvtss_f32(tFar) ? enter : -1.0f;
+#else
+			float tNear = 0.0f;
+			float tFar = maxDistance;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float t1 = (min[axis] - origin[axis]) * inverse[axis];
+				float t2 = (max[axis] - origin[axis]) * inverse[axis];
+				tNear = fmaxf(tNear, fminf(t1, t2));
+				tFar = fminf(tFar, fmaxf(t1, t2));
+			}
+			return tNear <= tFar ? tNear : -1.0f;
+#endif
+		}
+	};
+}
+
+BoundingTree::BoundingTree(float margin) :
+	m_margin(margin)
+{
+	Clear();
+}
+
+void BoundingTree::Clear(void)
+{
+	m_nodes.clear();
+	m_root = NullNode;
+	m_freeList = NullNode;
+	m_nodeCount = 0;
+	m_leafCount = 0;
+	m_rebalanceCursor = 0;
+}
+
+uint32_t BoundingTree::AllocateNode(void)
+{
+	uint32_t node = m_freeList;
+	if (node == NullNode)
+	{
+		node = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.push_back(Node());
+	}
+	else
+	{
+		m_freeList = m_nodes[node].parent;
+	}
+
+	Node& n = m_nodes[node];
+	n.parent = NullNode;
+	n.child1 = NullNode;
+	n.child2 = NullNode;
+	n.userData = 0;
+	n.height = 0;
+	n.padding = 0;
+	++m_nodeCount;
+	return node;
+}
+
+void BoundingTree::FreeNode(uint32_t node)
+{
+	m_nodes[node].parent = m_freeList;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+	--m_nodeCount;
+}
+
+uint32_t BoundingTree::Insert(const float min[3], const float max[3], uint32_t userData)
+{
+	uint32_t leaf = AllocateNode();
+	Node& node = m_nodes[leaf];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		node.min[axis] = min[axis] - m_margin;
+		node.max[axis] = max[axis] + m_margin;
+	}
+	node.userData = userData;
+	InsertLeaf(leaf);
+	++m_leafCount;
+	return leaf;
+}
+
+void BoundingTree::Remove(uint32_t proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--m_leafCount;
+}
+
+bool BoundingTree::Move(uint32_t proxy, const float min[3], const float max[3])
+{
+	Node& node = m_nodes[proxy];
+	bool contained = true;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		contained = contained && node.min[axis] <= min[axis] && max[axis] <= node.max[axis];
+	}
+	if (contained)
+		return false;
+
+	RemoveLeaf(proxy);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		node.min[axis] = min[axis] - m_margin;
+		node.max[axis] = max[axis] + m_margin;
+	}
+	InsertLeaf(proxy);
+	return true;
+}
+
+void BoundingTree::Refit(uint32_t proxy, const float min[3], const float max[3])
+{
+	Node& node = m_nodes[proxy];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		node.min[axis] = min[axis] - m_margin;
+		node.max[axis] = max[axis] + m_margin;
+	}
+
+	for (uint32_t index = node.parent; index != NullNode; index = m_nodes[index].parent)
+	{
+		Node& parent = m_nodes[index];
+		const Node& child1 = m_nodes[parent.child1];
+		const Node& child2 = m_nodes[parent.child2];
+		Union(child1.min, child1.max, child2.min, child2.max, parent.min, parent.max);
+	}
+}
+
+void BoundingTree::RefitAll(void)
+{
+	if (m_root == NullNode)
+		return;
+
+	// Parents come before their children in pre-order, so walking the list backwards refits bottom up.
+	std::vector<uint32_t> order;
+	order.reserve(m_nodeCount);
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.Empty())
+	{
+		uint32_t index = stack.Pop();
+		const Node& node = m_nodes[index];
+		if (node.IsLeaf())
+			continue;
+
+		order.push_back(index);
+		stack.Push(node.child1);
+		stack.Push(node.child2);
+	}
+
+	for (size_t i = order.size(); i-- > 0;)
+	{
+		Node& node = m_nodes[order[i]];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		Union(child1.min, child1.max, child2.min, child2.max, node.min, node.max);
+		node.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+	}
+}
+
+void BoundingTree::Rebalance(uint32_t nodeCount)
+{
+	uint32_t size = static_cast<uint32_t>(m_nodes.size());
+	for (uint32_t visited = 0; visited < nodeCount && size > 0; ++visited)
+	{
+		uint32_t index = m_rebalanceCursor;
+		m_rebalanceCursor = (m_rebalanceCursor + 1) % size;
+		if (m_nodes[index].height < 2)
+			continue;
+
+		Rotate(index);
+
+		// A rotation keeps the node's box but may change heights further up.
+		for (uint32_t parent = m_nodes[index].parent; parent != NullNode; parent = m_nodes[parent].parent)
+		{
+			Node& node = m_nodes[parent];
+			int32_t height1 = m_nodes[node.child1].height;
+			int32_t height2 = m_nodes[node.child2].height;
+			node.height = 1 + (height1 > height2 ? height1 : height2);
+		}
+	}
+}
+
+void BoundingTree::InsertLeaf(uint32_t leaf)
+{
+	if (m_root == NullNode)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	// Walk down while splitting a child is cheaper than pairing the leaf with the current node.
+	// Every step adds the growth of the node itself, which all deeper choices inherit.
+	const float* leafMin = m_nodes[leaf].min;
+	const float* leafMax = m_nodes[leaf].max;
+	uint32_t index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+
+		float area = Area(node.min, node.max);
+		float combinedArea = UnionArea(node.min, node.max, leafMin, leafMax);
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area);
+
+		float cost1 = UnionArea(child1.min, child1.max, leafMin, leafMax) + inheritance;
+		if (!child1.IsLeaf())
+		{
+			cost1 -= Area(child1.min, child1.max);
+		}
+		float cost2 = UnionArea(child2.min, child2.max, leafMin, leafMax) + inheritance;
+		if (!child2.IsLeaf())
+		{
+			cost2 -= Area(child2.min, child2.max);
+		}
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	uint32_t sibling = index;
+	uint32_t oldParent = m_nodes[sibling].parent;
+	uint32_t newParent = AllocateNode();
+
+	Node& parent = m_nodes[newParent];
+	Node& siblingNode = m_nodes[sibling];
+	Node& leafNode = m_nodes[leaf];
+	Union(siblingNode.min, siblingNode.max, leafNode.min, leafNode.max, parent.min, parent.max);
+	parent.parent = oldParent;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	parent.height = siblingNode.height + 1;
+	siblingNode.parent = newParent;
+	leafNode.parent = newParent;
+
+	if (oldParent == NullNode)
+	{
+		m_root = newParent;
+	}
+	else if (m_nodes[oldParent].child1 == sibling)
+	{
+		m_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_nodes[oldParent].child2 = newParent;
+	}
+
+	RefitAncestors(newParent);
+}
+
+void BoundingTree::RemoveLeaf(uint32_t leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = NullNode;
+		return;
+	}
+
+	uint32_t parent = m_nodes[leaf].parent;
+	uint32_t grandParent = m_nodes[parent].parent;
+	uint32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	m_nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	if (grandParent == NullNode)
+	{
+		m_root = sibling;
+		return;
+	}
+
+	if (m_nodes[grandParent].child1 == parent)
+	{
+		m_nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		m_nodes[grandParent].child2 = sibling;
+	}
+	RefitAncestors(grandParent);
+}
+
+// Refits the boxes and heights from node up to the root, rotating at each step.
+void BoundingTree::RefitAncestors(uint32_t node)
+{
+	for (uint32_t index = node; index != NullNode; index = m_nodes[index].parent)
+	{
+		Node& n = m_nodes[index];
+		const Node& child1 = m_nodes[n.child1];
+		const Node& child2 = m_nodes[n.child2];
+		Union(child1.min, child1.max, child2.min, child2.max, n.min, n.max);
+		n.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+		Rotate(index);
+	}
+}
+
+// Swaps one child of the node with a grandchild on the other side when that shrinks the other
+// child's box. The node's own box and leaf set stay the same, so nothing above needs a refit.
+void BoundingTree::Rotate(uint32_t a)
+{
+	Node& A = m_nodes[a];
+	if (A.height < 2)
+		return;
+
+	uint32_t b = A.child1;
+	uint32_t c = A.child2;
+	Node& B = m_nodes[b];
+	Node& C = m_nodes[c];
+
+	enum { None, SwapBF, SwapBG, SwapCD, SwapCE } best = None;
+	float bestGain = 0.0f;
+
+	if (!C.IsLeaf())
+	{
+		const Node& F = m_nodes[C.child1];
+		const Node& G = m_nodes[C.child2];
+		float areaC = Area(C.min, C.max);
+
+		float gain = areaC - UnionArea(B.min, B.max, G.min, G.max);
+		if (gain > bestGain)
+		{
+			best = SwapBF;
+			bestGain = gain;
+		}
+		gain = areaC - UnionArea(B.min, B.max, F.min, F.max);
+		if (gain > bestGain)
+		{
+			best = SwapBG;
+			bestGain = gain;
+		}
+	}
+
+	if (!B.IsLeaf())
+	{
+		const Node& D = m_nodes[B.child1];
+		const Node& E = m_nodes[B.child2];
+		float areaB = Area(B.min, B.max);
+
+		float gain = areaB - UnionArea(C.min, C.max, E.min, E.max);
+		if (gain > bestGain)
+		{
+			best = SwapCD;
+			bestGain = gain;
+		}
+		gain = areaB - UnionArea(C.min, C.max, D.min, D.max);
+		if (gain > bestGain)
+		{
+			best = SwapCE;
+			bestGain = gain;
+		}
+	}
+
+	// up takes a child slot of A; down moves into inner, whose box and height are rebuilt from down and kept.
+	uint32_t up, down, inner, kept;
+	switch (best)
+	{
+	case SwapBF:
+		up = C.child1; down = b; inner = c; kept = C.child2;
+		A.child1 = up;
+		C.child1 = down;
+		break;
+	case SwapBG:
+		up = C.child2; down = b; inner = c; kept = C.child1;
+		A.child1 = up;
+		C.child2 = down;
+		break;
+	case SwapCD:
+		up = B.child1; down = c; inner = b; kept = B.child2;
+		A.child2 = up;
+		B.child1 = down;
+		break;
+	case SwapCE:
+		up = B.child2; down = c; inner = b; kept = B.child1;
+		A.child2 = up;
+		B.child2 = down;
+		break;
+	default:
+		return;
+	}
+
+	Node& upNode = m_nodes[up];
+	Node& downNode = m_nodes[down];
+	Node& innerNode = m_nodes[inner];
+	const Node& keptNode = m_nodes[kept];
+	upNode.parent = a;
+	downNode.parent = inner;
+	Union(downNode.min, downNode.max, keptNode.min, keptNode.max, innerNode.min, innerNode.max);
+	innerNode.height = 1 + (downNode.height > keptNode.height ? downNode.height : keptNode.height);
+	A.height = 1 + (innerNode.height > upNode.height ? innerNode.height : upNode.height);
+}
+
+void BoundingTree::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const
+{
+	if (m_root == NullNode)
+		return;
+
+	// Each stack entry carries the planes its parent straddles.
+	PlaneSet planes(frustum);
+	TraversalStack stack;
+	TraversalStack planeMasks;
+	TraversalStack inside;
+	stack.Push(m_root);
+	planeMasks.Push((1u << Frustum::PlaneCount) - 1);
+	while (!stack.Empty())
+	{
+		uint32_t index = stack.Pop();
+		uint32_t active = planeMasks.Pop();
+		const Node& node = m_nodes[index];
+		Overlap overlap = planes.Test(node.min, node.max, active);
+		if (overlap == Outside)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else if (overlap == Inside)
+		{
+			// The whole subtree is visible; collect its leaves without testing.
+			inside.Push(index);
+			while (!inside.Empty())
+			{
+				const Node& n = m_nodes[inside.Pop()];
+				if (n.IsLeaf())
+				{
+					results.push_back(n.userData);
+				}
+				else
+				{
+					inside.Push(n.child2);
+					inside.Push(n.child1);
+				}
+			}
+		}
+		else
+		{
+			stack.Push(node.child2);
+			stack.Push(node.child1);
+			planeMasks.Push(active);
+			planeMasks.Push(active);
+		}
+	}
+}
+
+void BoundingTree::QuerySphere(const float center[3], float radius, std::vector<uint32_t>& results) const
+{
+	if (m_root == NullNode)
+		return;
+
+	float radiusSq = radius * radius;
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.Empty())
+	{
+		const Node& node = m_nodes[stack.Pop()];
+		if (!SphereTouchesBox(center, radiusSq, node.min, node.max))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			stack.Push(node.child2);
+			stack.Push(node.child1);
+		}
+	}
+}
+
+void BoundingTree::QueryRay(const float origin[3], const float direction[3], float maxDistance, std::vector<uint32_t>& results) const
+{
+	if (m_root == NullNode)
+		return;
+
+	Ray ray(origin, direction, maxDistance);
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.Empty())
+	{
+		const Node& node = m_nodes[stack.Pop()];
+		if (ray.Enter(node.min, node.max) < 0.0f)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			results.push_back(node.userData);
+		}
+		else
+		{
+			stack.Push(node.child2);
+			stack.Push(node.child1);
+		}
+	}
+}
+
+uint32_t BoundingTree::RayCast(const float origin[3], const float direction[3], float maxDistance, float* distance) const
+{
+	uint32_t nearest = NullNode;
+	if (m_root == NullNode)
+		return nearest;
+
+	Ray ray(origin, direction, maxDistance);
+	TraversalStack stack;
+	stack.Push(m_root);
+	while (!stack.Empty())
+	{
+		uint32_t index = stack.Pop();
+		const Node& node = m_nodes[index];
+		float enter = ray.Enter(node.min, node.max);
+		if (enter < 0.0f)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			// Later boxes have to start in front of this one to win.
+			nearest = index;
+			ray.maxDistance = enter;
+			continue;
+		}
+
+		// Visit the nearer child first so the search range shrinks early.
+		float enter1 = ray.Enter(m_nodes[node.child1].min, m_nodes[node.child1].max);
+		float enter2 = ray.Enter(m_nodes[node.child2].min, m_nodes[node.child2].max);
+		bool firstNearer = enter1 >= 0.0f && (enter2 < 0.0f || enter1 <= enter2);
+		if (enter1 >= 0.0f && enter2 >= 0.0f)
+		{
+			stack.Push(firstNearer ? node.child2 : node.child1);
+		}
+		if (enter1 >= 0.0f || enter2 >= 0.0f)
+		{
+			stack.Push(firstNearer ? node.child1 : node.child2);
+		}
+	}
+
+	if (nearest != NullNode && distance)
+	{
+		*distance = ray.maxDistance;
+	}
+	return nearest;
+}
+
+void BoundingTree::GetFatBounds(uint32_t proxy, float min[3], float max[3]) const
+{
+	const Node& node = m_nodes[proxy];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		min[axis] = node.min[axis];
+		max[axis] = node.max[axis];
+	}
+}
+
+float BoundingTree::ComputeCost(void) const
+{
+	if (m_root == NullNode || m_nodes[m_root].IsLeaf())
+		return 0.0f;
+
+	float total = 0.0f;
+	for (const Node& node : m_nodes)
+	{
+		if (node.height > 0)
+		{
+			total += Area(node.min, node.max);
+		}
+	}
+	return total / Area(m_nodes[m_root].min, m_nodes[m_root].max);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+// Dynamic AABB tree over scene objects. Leaves hold a box slightly larger than the object
+// ("fat" box), so small moves don't touch the tree; bigger moves reinsert the leaf. Inserts pick
+// the sibling that adds the least surface area, and tree rotations keep the hierarchy shallow
+// while objects move around. Nodes live in one flat array and are addressed by index.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class BoundingTree
+	{
+	public:
+		static const uint32_t NullNode = 0xffffffff;
+
+		// margin is added on every side of a leaf's box when it is (re)inserted.
+		explicit BoundingTree(float margin = 0.1f);
+
+		// Returns a proxy id that stays valid until Remove. userData comes back from queries.
+		uint32_t Insert(const float min[3], const float max[3], uint32_t userData);
+		void Remove(uint32_t proxy);
+		void Clear(void);
+
+		// Moves a leaf. Nothing happens while the new box stays inside the fat box; otherwise the
+		// leaf is reinserted with a new fat box. Returns true if the tree changed.
+		bool Move(uint32_t proxy, const float min[3], const float max[3]);
+
+		// Sets a leaf's box and refits its ancestors without changing the topology. Cheaper than
+		// Move for objects that move every frame; call Rebalance now and then to restore quality.
+		void Refit(uint32_t proxy, const float min[3], const float max[3]);
+
+		// Recomputes every internal box from the leaves, bottom up.
+		void RefitAll(void);
+
+		// Tries a tree rotation at up to nodeCount internal nodes, continuing where the previous call
+		// stopped, so the whole tree is revisited over a few frames.
+		void Rebalance(uint32_t nodeCount);
+
+		// Append the userData of every leaf whose box touches the volume.
+		void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& results) const;
+		void QuerySphere(const float center[3], float radius, std::vector<uint32_t>& results) const;
+		void QueryRay(const float origin[3], const float direction[3], float maxDistance, std::vector<uint32_t>& results) const;
+
+		// Proxy of the leaf box the ray enters first, or NullNode. distance receives the entry distance.
+		uint32_t RayCast(const float origin[3], const float direction[3], float maxDistance, float* distance = nullptr) const;
+
+		uint32_t GetUserData(uint32_t proxy) const { return m_nodes[proxy].userData; }
+		void GetFatBounds(uint32_t proxy, float min[3], float max[3]) const;
+
+		uint32_t GetLeafCount(void) const { return m_leafCount; }
+		uint32_t GetNodeCount(void) const { return m_nodeCount; }
+		int32_t GetHeight(void) const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+
+		// Summed surface area of the internal nodes over that of the root. Lower means better queries.
+		float ComputeCost(void) const;
+
+	private:
+		// 48 bytes. min and max sit in front of a 32-bit field each so one unaligned 16-byte load
+		// picks up a box corner; the fourth lane is masked off.
+		struct Node
+		{
+			float min[3];
+			uint32_t parent;        // Next free node while the node is on the free list.
+			float max[3];
+			uint32_t child1;        // NullNode for leaves.
+			uint32_t child2;
+			uint32_t userData;
+			int32_t height;         // 0 for leaves, -1 for free nodes.
+			uint32_t padding;
+
+			bool IsLeaf(void) const { return child1 == NullNode; }
+		};
+
+		uint32_t AllocateNode(void);
+		void FreeNode(uint32_t node);
+		void InsertLeaf(uint32_t leaf);
+		void RemoveLeaf(uint32_t leaf);
+		void RefitAncestors(uint32_t node);
+		void Rotate(uint32_t node);
+
+		std::vector<Node> m_nodes;
+		uint32_t m_root;
+		uint32_t m_freeList;
+		uint32_t m_nodeCount;
+		uint32_t m_leafCount;
+		uint32_t m_rebalanceCursor;
+		float m_margin;
+	};
+}
@@ -0,0 +1,249 @@
+#include "CommandList.h"
+
+using namespace DX;
+
+namespace
+{
+	enum Op : uint32_t
+	{
+		OpInputLayout = 0,
+		OpVertexBuffer,
+		OpIndexBuffer,
+		OpTopology,
+		OpShader,
+		OpConstantBuffer,
+		OpShaderResource,
+		OpSampler,
+		OpRasterizerState,
+		OpDrawIndexed,
+		OpDrawIndexedInstanced,
+		OpUpdateBuffer
+	};
+
+	// Handles take two words so that the stream layout is the same for 32- and 64-bit builds.
+	void PutHandle(uint32_t* out, const void* handle)
+	{
+		uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+		out[0] = static_cast<uint32_t>(bits);
+		out[1] = static_cast<uint32_t>(bits >> 32);
+	}
+
+	// Reads the stream back in the order it was written.
+	class Reader
+	{
+	public:
+		explicit Reader(const uint32_t* words) : m_words(words) {}
+
+		uint32_t Word(void) { return *m_words++; }
+		int32_t Signed(void) { return static_cast<int32_t>(*m_words++); }
+		const void* Handle(void)
+		{
+			uint64_t bits = uint64_t(m_words[0]) | (uint64_t(m_words[1]) << 32);
+			m_words += 2;
+			return reinterpret_cast<const void*>(static_cast<uintptr_t>(bits));
+		}
+		const uint32_t* Position(void) const { return m_words; }
+
+	private:
+		const uint32_t* m_words;
+	};
+
+	// StateCache and IRenderBackend share their method names, so one loop serves both.
+	template <typename Target>
+	void ReplayInto(const uint32_t* words, size_t count, Target& target)
+	{
+		Reader reader(words);
+		const uint32_t* end = words + count;
+		while (reader.Position() < end)
+		{
+			uint32_t header = reader.Word();
+			ShaderStage stage = static_cast<ShaderStage>((header >> 8) & 0xff);
+			uint32_t slot = header >> 16;
+			switch (header & 0xff)
+			{
+			case OpInputLayout:
+				target.SetInputLayout(reader.Handle());
+				break;
+			case OpVertexBuffer:
+			{
+				const void* buffer = reader.Handle();
+				uint32_t stride = reader.Word();
+				uint32_t offset = reader.Word();
+				target.SetVertexBuffer(slot, buffer, stride, offset);
+				break;
+			}
+			case OpIndexBuffer:
+			{
+				const void* buffer = reader.Handle();
+				uint32_t format = reader.Word();
+				uint32_t offset = reader.Word();
+				target.SetIndexBuffer(buffer, format, offset);
+				break;
+			}
+			case OpTopology:
+				target.SetPrimitiveTopology(reader.Word());
+				break;
+			case OpShader:
+				target.SetShader(stage, reader.Handle());
+				break;
+			case OpConstantBuffer:
+			{
+				const void* buffer = reader.Handle();
+				uint32_t firstConstant = reader.Word();
+				uint32_t constantCount = reader.Word();
+				target.SetConstantBuffer(stage, slot, buffer, firstConstant, constantCount);
+				break;
+			}
+			case OpShaderResource:
+				target.SetShaderResource(stage, slot, reader.Handle());
+				break;
+			case OpSampler:
+				target.SetSampler(stage, slot, reader.Handle());
+				break;
+			case OpRasterizerState:
+				target.SetRasterizerState(reader.Handle());
+				break;
+			case OpDrawIndexed:
+			{
+				uint32_t indexCount = reader.Word();
+				uint32_t startIndex = reader.Word();
+				int32_t baseVertex = reader.Signed();
+				target.DrawIndexed(indexCount, startIndex, baseVertex);
+				break;
+			}
+			case OpDrawIndexedInstanced:
+			{
+				uint32_t indexCount = reader.Word();
+				uint32_t instanceCount = reader.Word();
+				uint32_t startIndex = reader.Word();
+				int32_t baseVertex = reader.Signed();
+				uint32_t startInstance = reader.Word();
+				target.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+				break;
+			}
+			case OpUpdateBuffer:
+			{
+				const void* buffer = reader.Handle();
+				const void* data = reader.Handle();
+				uint32_t size = reader.Word();
+				target.UpdateBuffer(buffer, data, size);
+				break;
+			}
+			}
+		}
+	}
+}
+
+void CommandList::Reset(void)
+{
+	m_used = 0;
+	m_commandCount = 0;
+}
+
+void CommandList::Grow(size_t words)
+{
+	size_t capacity = m_words.size() ? m_words.size() * 2 : 1024;
+	while (capacity < m_used + words)
+	{
+		capacity *= 2;
+	}
+	m_words.resize(capacity);
+}
+
+void CommandList::SetInputLayout(const void* layout)
+{
+	uint32_t* out = Begin(OpInputLayout, 0, 0, 3);
+	PutHandle(out, layout);
+}
+
+void CommandList::SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+{
+	uint32_t* out = Begin(OpVertexBuffer, 0, slot, 5);
+	PutHandle(out, buffer);
+	out[2] = stride;
+	out[3] = offset;
+}
+
+void CommandList::SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset)
+{
+	uint32_t* out = Begin(OpIndexBuffer, 0, 0, 5);
+	PutHandle(out, buffer);
+	out[2] = format;
+	out[3] = offset;
+}
+
+void CommandList::SetPrimitiveTopology(uint32_t topology)
+{
+	uint32_t* out = Begin(OpTopology, 0, 0, 2);
+	out[0] = topology;
+}
+
+void CommandList::SetShader(ShaderStage stage, const void* shader)
+{
+	uint32_t* out = Begin(OpShader, stage, 0, 3);
+	PutHandle(out, shader);
+}
+
+void CommandList::SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+									uint32_t firstConstant, uint32_t constantCount)
+{
+	uint32_t* out = Begin(OpConstantBuffer, stage, slot, 5);
+	PutHandle(out, buffer);
+	out[2] = firstConstant;
+	out[3] = constantCount;
+}
+
+void CommandList::SetShaderResource(ShaderStage stage, uint32_t slot, const void* view)
+{
+	uint32_t* out = Begin(OpShaderResource, stage, slot, 3);
+	PutHandle(out, view);
+}
+
+void CommandList::SetSampler(ShaderStage stage, uint32_t slot, const void* sampler)
+{
+	uint32_t* out = Begin(OpSampler, stage, slot, 3);
+	PutHandle(out, sampler);
+}
+
+void CommandList::SetRasterizerState(const void* state)
+{
+	uint32_t* out = Begin(OpRasterizerState, 0, 0, 3);
+	PutHandle(out, state);
+}
+
+void CommandList::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	uint32_t* out = Begin(OpDrawIndexed, 0, 0, 4);
+	out[0] = indexCount;
+	out[1] = startIndex;
+	out[2] = static_cast<uint32_t>(baseVertex);
+}
+
+void CommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+									   int32_t baseVertex, uint32_t startInstance)
+{
+	uint32_t* out = Begin(OpDrawIndexedInstanced, 0, 0, 6);
+	out[0] = indexCount;
+	out[1] = instanceCount;
+	out[2] = startIndex;
+	out[3] = static_cast<uint32_t>(baseVertex);
+	out[4] = startInstance;
+}
+
+void CommandList::UpdateBuffer(const void* buffer, const void* data, uint32_t size)
+{
+	uint32_t* out = Begin(OpUpdateBuffer, 0, 0, 6);
+	PutHandle(out, buffer);
+	PutHandle(out + 2, data);
+	out[4] = size;
+}
+
+void CommandList::Replay(IRenderBackend& backend) const
+{
+	ReplayInto(m_words.data(), m_used, backend);
+}
+
+void CommandList::Replay(StateCache& cache) const
+{
+	ReplayInto(m_words.data(), m_used, cache);
+}
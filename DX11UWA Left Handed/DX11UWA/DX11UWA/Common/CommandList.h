@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "StateCache.h"
+
+// API-neutral recording of state, draw and buffer-update calls. A command list is itself a
+// backend, so a worker thread can record through its own StateCache and keep only the calls
+// that change something. The submission thread then replays the lists in order into the real
+// backend, or through the immediate StateCache so that state repeated across lists is filtered
+// too. Each command is one header word (opcode, stage, slot) followed by its arguments, with
+// handles taking two words, so a draw with a few state changes fits in a cache line.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class CommandList : public IRenderBackend
+	{
+	public:
+		CommandList() : m_used(0), m_commandCount(0) {}
+
+		// Drops every command but keeps the memory for the next frame.
+		void Reset(void);
+		bool Empty(void) const { return m_commandCount == 0; }
+		size_t GetCommandCount(void) const { return m_commandCount; }
+		size_t GetSizeBytes(void) const { return m_used * sizeof(uint32_t); }
+
+		void SetInputLayout(const void* layout) override;
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) override;
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetShader(ShaderStage stage, const void* shader) override;
+		void SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+							   uint32_t firstConstant, uint32_t constantCount) override;
+		void SetShaderResource(ShaderStage stage, uint32_t slot, const void* view) override;
+		void SetSampler(ShaderStage stage, uint32_t slot, const void* sampler) override;
+		void SetRasterizerState(const void* state) override;
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+								  int32_t baseVertex, uint32_t startInstance) override;
+		// Only the pointer is recorded; data must stay valid until the list has been replayed.
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size) override;
+
+		// Issues the recorded calls in order. A list can be replayed any number of times.
+		void Replay(IRenderBackend& backend) const;
+		void Replay(StateCache& cache) const;
+
+	private:
+		// Reserves a command of words words, header included, and returns the first argument word.
+		uint32_t* Begin(uint32_t op, uint32_t stage, uint32_t slot, size_t words)
+		{
+			if (m_used + words > m_words.size())
+				Grow(words);
+			uint32_t* out = m_words.data() + m_used;
+			m_used += words;
+			++m_commandCount;
+			out[0] = op | (stage << 8) | (slot << 16);
+			return out + 1;
+		}
+		void Grow(size_t words);
+
+		std::vector<uint32_t> m_words;	// Sized to the capacity; m_used words hold commands.
+		size_t m_used;
+		size_t m_commandCount;
+	};
+}
@@ -0,0 +1,111 @@
+#include "ConstantRing.h"
+
+#include <string.h>
+
+using namespace DX;
+
+ConstantRing::ConstantRing(uint32_t capacity, IConstantRingBackend* backend) :
+	m_mapped(nullptr)
+{
+	Reset(capacity, backend);
+}
+
+void ConstantRing::Reset(uint32_t capacity, IConstantRingBackend* backend)
+{
+	m_backend = backend;
+	m_mapped = nullptr;
+	m_capacity = capacity & ~(Alignment - 1);
+	m_head = 0;
+	m_pendingStart = 0;
+	m_frameStart = 0;
+	m_peakFrameBytes = 0;
+	m_discardNext = true;
+	m_stats = ConstantRingStats();
+	m_lastFrame = ConstantRingStats();
+}
+
+void ConstantRing::BeginFrame(void)
+{
+	Flush();
+
+	uint32_t used = m_head - m_frameStart;
+	if (used > m_peakFrameBytes)
+	{
+		m_peakFrameBytes = used;
+	}
+	m_lastFrame = m_stats;
+	m_stats = ConstantRingStats();
+
+	if (m_capacity - m_head < m_peakFrameBytes)
+	{
+		m_head = 0;
+		m_discardNext = true;
+	}
+	m_frameStart = m_head;
+	m_pendingStart = m_head;
+}
+
+void* ConstantRing::Allocate(uint32_t size, RingSlice& slice)
+{
+	uint32_t aligned = (size + Alignment - 1) & ~(Alignment - 1);
+	if (aligned == 0 || aligned > m_capacity || !m_backend)
+	{
+		++m_stats.failed;
+		return nullptr;
+	}
+
+	if (m_capacity - m_head < aligned)
+	{
+		// Wrapping discards the buffer, which is only safe once every written slice has been drawn.
+		if (m_head != m_pendingStart)
+		{
+			++m_stats.failed;
+			return nullptr;
+		}
+		Flush();
+		m_head = 0;
+		m_pendingStart = 0;
+		m_frameStart = 0;
+		m_discardNext = true;
+	}
+
+	if (!m_mapped)
+	{
+		m_mapped = static_cast<uint8_t*>(m_backend->Map(m_discardNext));
+		if (!m_mapped)
+		{
+			++m_stats.failed;
+			return nullptr;
+		}
+		++m_stats.maps;
+		m_stats.discards += m_discardNext ? 1 : 0;
+		m_discardNext = false;
+	}
+
+	slice.offset = m_head;
+	slice.size = aligned;
+	m_head += aligned;
+	++m_stats.allocations;
+	m_stats.bytes += aligned;
+	return m_mapped + slice.offset;
+}
+
+bool ConstantRing::Upload(const void* data, uint32_t size, RingSlice& slice)
+{
+	void* destination = Allocate(size, slice);
+	if (!destination)
+		return false;
+
+	memcpy(destination, data, size);
+	return true;
+}
+
+void ConstantRing::Flush(void)
+{
+	if (m_mapped)
+	{
+		m_backend->Unmap();
+		m_mapped = nullptr;
+	}
+	m_pendingStart = m_head;
+}
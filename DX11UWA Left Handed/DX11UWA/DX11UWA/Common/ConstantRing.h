@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Suballocates per-draw constant data from one large dynamic buffer. Slices are 256-byte
+// aligned so they can be bound by offset with *SetConstantBuffers1. Writes use no-overwrite
+// maps while the ring advances and a discard map whenever it starts over at offset 0, so the
+// driver never has to copy or stall on data the GPU may still be reading.
+// The mapping itself goes through IConstantRingBackend, which keeps this file free of Direct3D.
+namespace DX
+{
+	class IConstantRingBackend
+	{
+	public:
+		virtual ~IConstantRingBackend() {}
+
+		// Maps the whole buffer for writing. discard asks for fresh memory; otherwise the caller
+		// promises not to touch bytes that earlier draws may still read.
+		virtual void* Map(bool discard) = 0;
+		virtual void Unmap(void) = 0;
+	};
+
+	// Part of the ring handed to one draw. Sizes are rounded up to the alignment.
+	struct RingSlice
+	{
+		uint32_t offset;
+		uint32_t size;
+
+		// The same range in 16-byte shader constants, as *SetConstantBuffers1 expects it.
+		uint32_t FirstConstant(void) const { return offset / 16; }
+		uint32_t ConstantCount(void) const { return size / 16; }
+	};
+
+	struct ConstantRingStats
+	{
+		uint32_t allocations = 0;
+		uint32_t bytes = 0;
+		uint32_t maps = 0;
+		uint32_t discards = 0;
+		uint32_t failed = 0;    // Allocations that didn't fit; see Allocate.
+	};
+
+	class ConstantRing
+	{
+	public:
+		static const uint32_t Alignment = 256;
+
+		// capacity is rounded down to the alignment.
+		explicit ConstantRing(uint32_t capacity = 0, IConstantRingBackend* backend = nullptr);
+
+		// Attaches a new buffer. The first map after this always discards.
+		void Reset(uint32_t capacity, IConstantRingBackend* backend);
+
+		// Starts a frame. Slices from earlier frames have all been drawn by now, so if the ring
+		// can't hold another frame as large as the biggest one so far, it starts over here.
+		void BeginFrame(void);
+
+		// Reserves size bytes and returns where to write them; the pointer stays valid until Flush.
+		// Slices returned since the last Flush haven't been drawn yet, so the ring can't discard
+		// them to wrap around: if the request doesn't fit behind them it fails with nullptr.
+		void* Allocate(uint32_t size, RingSlice& slice);
+
+		// Allocate plus copy.
+		bool Upload(const void* data, uint32_t size, RingSlice& slice);
+
+		// Unmaps the buffer. Call before issuing the draws that read the new slices.
+		void Flush(void);
+
+		uint32_t GetCapacity(void) const { return m_capacity; }
+		const ConstantRingStats& GetStats(void) const { return m_stats; }
+		const ConstantRingStats& GetLastFrameStats(void) const { return m_lastFrame; }
+
+	private:
+		IConstantRingBackend* m_backend;
+		uint8_t* m_mapped;
+		uint32_t m_capacity;
+		uint32_t m_head;            // Next free byte.
+		uint32_t m_pendingStart;    // First byte written since the last Flush.
+		uint32_t m_frameStart;
+		uint32_t m_peakFrameBytes;
+		bool m_discardNext;
+		ConstantRingStats m_stats;
+		ConstantRingStats m_lastFrame;
+	};
+
+	// Backend over plain memory. The renderer uses it when the device can't bind constant
+	// buffers by offset and copies each slice into a regular constant buffer instead.
+	class MemoryRingBackend : public IConstantRingBackend
+	{
+	public:
+		explicit MemoryRingBackend(uint32_t capacity = 0) : m_memory(capacity) {}
+
+		void Resize(uint32_t capacity) { m_memory.assign(capacity, 0); }
+		const uint8_t* Data(void) const { return m_memory.data(); }
+
+		void* Map(bool) override { return m_memory.data(); }
+		void Unmap(void) override {}
+
+	private:
+		std::vector<uint8_t> m_memory;
+	};
+}
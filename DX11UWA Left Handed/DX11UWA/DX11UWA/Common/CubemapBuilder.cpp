@@ -0,0 +1,328 @@
+#include "CubemapBuilder.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DX;
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+
+	// Basis of each face: direction = major + s * u + t * v, with s and t in [-1, 1].
+	struct FaceBasis
+	{
+		float major[3];
+		float u[3];
+		float v[3];
+	};
+
+	const FaceBasis FaceBases[6] =
+	{
+		{ {  1,  0,  0 }, {  0, 0, -1 }, { 0, -1,  0 } }, // +X
+		{ { -1,  0,  0 }, {  0, 0,  1 }, { 0, -1,  0 } }, // -X
+		{ {  0,  1,  0 }, {  1, 0,  0 }, { 0,  0,  1 } }, // +Y
+		{ {  0, -1,  0 }, {  1, 0,  0 }, { 0,  0, -1 } }, // -Y
+		{ {  0,  0,  1 }, {  1, 0,  0 }, { 0, -1,  0 } }, // +Z
+		{ {  0,  0, -1 }, { -1, 0,  0 }, { 0, -1,  0 } }, // -Z
+	};
+
+	inline uint32_t MipCount(uint32_t size)
+	{
+		uint32_t count = 1;
+		while (size > 1)
+		{
+			size >>= 1;
+			++count;
+		}
+		return count;
+	}
+
+	// Bilinear fetch at texel-space coordinates. X wraps for panoramas and clamps otherwise; Y always clamps.
+	inline uint32_t SampleBilinear(const uint32_t* src, uint32_t width, uint32_t height, float x, float y, bool wrapX)
+	{
+		x -= 0.5f;
+		y -= 0.5f;
+		float fx = floorf(x);
+		float fy = floorf(y);
+		float ax = x - fx;
+		float ay = y - fy;
+
+		int x0 = static_cast<int>(fx);
+		int y0 = static_cast<int>(fy);
+		int x1 = x0 + 1;
+		int y1 = y0 + 1;
+		int w = static_cast<int>(width);
+		int h = static_cast<int>(height);
+
+		if (wrapX)
+		{
+			x0 = ((x0 % w) + w) % w;
+			x1 = ((x1 % w) + w) % w;
+		}
+		else
+		{
+			x0 = std::min(std::max(x0, 0), w - 1);
+			x1 = std::min(std::max(x1, 0), w - 1);
+		}
+		y0 = std::min(std::max(y0, 0), h - 1);
+		y1 = std::min(std::max(y1, 0), h - 1);
+
+		uint32_t t00 = src[size_t(y0) * width + x0];
+		uint32_t t10 = src[size_t(y0) * width + x1];
+		uint32_t t01 = src[size_t(y1) * width + x0];
+		uint32_t t11 = src[size_t(y1) * width + x1];
+
+#if defined(DX_SIMD_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		__m128 c00 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(t00)), zero), zero));
+		__m128 c10 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(t10)), zero), zero));
+		__m128 c01 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(t01)), zero), zero));
+		__m128 c11 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(t11)), zero), zero));
+
+		__m128 wx = _mm_set1_ps(ax);
+		__m128 top = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), wx));
+		__m128 bottom = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), wx));
+		__m128 result = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(ay)));
+
+		__m128i packed = _mm_cvtps_epi32(result);
+		packed = _mm_packs_epi32(packed, packed);
+		packed = _mm_packus_epi16(packed, packed);
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+#else
+		uint32_t result = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			float c00 = float((t00 >> shift) & 0xff);
+			float c10 = float((t10 >> shift) & 0xff);
+			float c01 = float((t01 >> shift) & 0xff);
+			float c11 = float((t11 >> shift) & 0xff);
+			float top = c00 + (c10 - c00) * ax;
+			float bottom = c01 + (c11 - c01) * ax;
+			uint32_t c = static_cast<uint32_t>(top + (bottom - top) * ay + 0.5f);
+			result |= std::min(c, 255u) << shift;
+		}
+		return result;
+#endif
+	}
+
+#if defined(DX_SIMD_SSE2)
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Four-wide atan2 with a minimax polynomial, accurate to about 1e-5 radians.
+	inline __m128 Atan2(__m128 y, __m128 x)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 ax = _mm_andnot_ps(signMask, x);
+		__m128 ay = _mm_andnot_ps(signMask, y);
+		__m128 hi = _mm_max_ps(ax, ay);
+		__m128 lo = _mm_min_ps(ax, ay);
+		__m128 a = _mm_div_ps(lo, _mm_max_ps(hi, _mm_set1_ps(1e-30f)));
+		__m128 s = _mm_mul_ps(a, a);
+
+		__m128 r = _mm_set1_ps(-0.0117212f);
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.05265332f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.11643287f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.19354346f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.33262347f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.99997726f));
+		r = _mm_mul_ps(r, a);
+
+		r = Select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(Pi * 0.5f), r), r);
+		r = Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(Pi), r), r);
+		return _mm_or_ps(r, _mm_and_ps(y, signMask));
+	}
+#endif
+
+	// Fills one row of one face from the panorama.
+	void ResampleEquirectRow(const DDSImage& src, uint32_t face, uint32_t row, uint32_t faceSize, uint32_t* dst)
+	{
+		const FaceBasis& basis = FaceBases[face];
+		const float scale = 2.0f / faceSize;
+		const float t = (row + 0.5f) * scale - 1.0f;
+		const float uScale = src.width / (2.0f * Pi);
+		const float vScale = src.height / Pi;
+		const uint32_t* texels = src.Level(0, 0);
+
+		float base[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			base[i] = basis.major[i] + t * basis.v[i];
+		}
+
+		uint32_t x = 0;
+#if defined(DX_SIMD_SSE2)
+		const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		for (; x + 4 <= faceSize; x += 4)
+		{
+			__m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(x)), lane), _mm_set1_ps(scale)), _mm_set1_ps(1.0f));
+			__m128 dx = _mm_add_ps(_mm_set1_ps(base[0]), _mm_mul_ps(s, _mm_set1_ps(basis.u[0])));
+			__m128 dy = _mm_add_ps(_mm_set1_ps(base[1]), _mm_mul_ps(s, _mm_set1_ps(basis.u[1])));
+			__m128 dz = _mm_add_ps(_mm_set1_ps(base[2]), _mm_mul_ps(s, _mm_set1_ps(basis.u[2])));
+
+			__m128 lon = Atan2(dx, dz);
+			__m128 lat = Atan2(dy, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz))));
+			__m128 u = _mm_mul_ps(_mm_add_ps(lon, _mm_set1_ps(Pi)), _mm_set1_ps(uScale));
+			__m128 v = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(Pi * 0.5f), lat), _mm_set1_ps(vScale));
+
+			alignas(16) float us[4];
+			alignas(16) float vs[4];
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+			for (int i = 0; i < 4; ++i)
+			{
+				dst[x + i] = SampleBilinear(texels, src.width, src.height, us[i], vs[i], true);
+			}
+		}
+#endif
+		for (; x < faceSize; ++x)
+		{
+			float s = (x + 0.5f) * scale - 1.0f;
+			float dx = base[0] + s * basis.u[0];
+			float dy = base[1] + s * basis.u[1];
+			float dz = base[2] + s * basis.u[2];
+			float u = (atan2f(dx, dz) + Pi) * uScale;
+			float v = (Pi * 0.5f - atan2f(dy, sqrtf(dx * dx + dz * dz))) * vScale;
+			dst[x] = SampleBilinear(texels, src.width, src.height, u, v, true);
+		}
+	}
+
+	// Averages a 2x2 block of RGBA8 texels per destination texel.
+	void DownsampleRow(const uint32_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t row, uint32_t* dst, uint32_t dstWidth)
+	{
+		const uint32_t* row0 = src + size_t(std::min(row * 2, srcHeight - 1)) * srcWidth;
+		const uint32_t* row1 = src + size_t(std::min(row * 2 + 1, srcHeight - 1)) * srcWidth;
+
+		uint32_t x = 0;
+#if defined(DX_SIMD_SSE2)
+		if (srcWidth >= 2)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i round = _mm_set1_epi16(2);
+			for (; x + 2 <= dstWidth && x * 2 + 4 <= srcWidth; x += 2)
+			{
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2));
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				// lo holds texels 0,1 and hi texels 2,3; add the horizontal neighbours.
+				__m128i sum0 = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+				__m128i sum1 = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+				__m128i sums = _mm_unpacklo_epi64(sum0, sum1);
+				sums = _mm_srli_epi16(_mm_add_epi16(sums, round), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sums, sums));
+			}
+		}
+#endif
+		for (; x < dstWidth; ++x)
+		{
+			uint32_t x0 = std::min(x * 2, srcWidth - 1);
+			uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8)
+			{
+				uint32_t sum = ((row0[x0] >> shift) & 0xff) + ((row0[x1] >> shift) & 0xff) +
+							   ((row1[x0] >> shift) & 0xff) + ((row1[x1] >> shift) & 0xff);
+				result |= ((sum + 2) >> 2) << shift;
+			}
+			dst[x] = result;
+		}
+	}
+
+	void AllocateCube(const CubemapSettings& settings, bool bgra, DDSImage& cube)
+	{
+		uint32_t fullChain = MipCount(settings.faceSize);
+		uint32_t mips = settings.mipLevels ? std::min(settings.mipLevels, fullChain) : fullChain;
+		cube.Allocate(settings.faceSize, settings.faceSize, mips, 6);
+		cube.bgra = bgra;
+	}
+}
+
+bool DX::BuildCubemapFromEquirect(const DDSImage& equirect, const CubemapSettings& settings, DDSImage& cube, WorkerPool& pool)
+{
+	if (equirect.width == 0 || equirect.height == 0 || equirect.faceCount != 1 || settings.faceSize == 0)
+		return false;
+
+	AllocateCube(settings, equirect.bgra, cube);
+
+	const uint32_t faceSize = settings.faceSize;
+	pool.ParallelFor(size_t(6) * faceSize, 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			uint32_t face = static_cast<uint32_t>(i / faceSize);
+			uint32_t row = static_cast<uint32_t>(i % faceSize);
+			ResampleEquirectRow(equirect, face, row, faceSize, cube.Level(face, 0) + size_t(row) * faceSize);
+		}
+	});
+
+	GenerateMips(cube, pool);
+	return true;
+}
+
+bool DX::BuildCubemapFromFaces(const DDSImage* const faces[6], const CubemapSettings& settings, DDSImage& cube, WorkerPool& pool)
+{
+	for (int face = 0; face < 6; ++face)
+	{
+		if (!faces[face] || faces[face]->width == 0 || faces[face]->height == 0 || faces[face]->bgra != faces[0]->bgra)
+			return false;
+	}
+	if (settings.faceSize == 0)
+		return false;
+
+	AllocateCube(settings, faces[0]->bgra, cube);
+
+	const uint32_t faceSize = settings.faceSize;
+	pool.ParallelFor(size_t(6) * faceSize, 16, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			uint32_t face = static_cast<uint32_t>(i / faceSize);
+			uint32_t row = static_cast<uint32_t>(i % faceSize);
+			const DDSImage& src = *faces[face];
+			uint32_t* dst = cube.Level(face, 0) + size_t(row) * faceSize;
+
+			if (src.width == faceSize && src.height == faceSize)
+			{
+				std::copy(src.Level(0, 0) + size_t(row) * faceSize, src.Level(0, 0) + size_t(row + 1) * faceSize, dst);
+				continue;
+			}
+
+			float sx = float(src.width) / faceSize;
+			float y = (row + 0.5f) * float(src.height) / faceSize;
+			for (uint32_t x = 0; x < faceSize; ++x)
+			{
+				dst[x] = SampleBilinear(src.Level(0, 0), src.width, src.height, (x + 0.5f) * sx, y, false);
+			}
+		}
+	});
+
+	GenerateMips(cube, pool);
+	return true;
+}
+
+void DX::GenerateMips(DDSImage& image, WorkerPool& pool)
+{
+	for (uint32_t mip = 1; mip < image.mipLevels; ++mip)
+	{
+		const uint32_t srcWidth = image.LevelWidth(mip - 1);
+		const uint32_t srcHeight = image.LevelHeight(mip - 1);
+		const uint32_t dstWidth = image.LevelWidth(mip);
+		const uint32_t dstHeight = image.LevelHeight(mip);
+
+		pool.ParallelFor(size_t(image.faceCount) * dstHeight, 16, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				uint32_t face = static_cast<uint32_t>(i / dstHeight);
+				uint32_t row = static_cast<uint32_t>(i % dstHeight);
+				DownsampleRow(image.Level(face, mip - 1), srcWidth, srcHeight, row, image.Level(face, mip) + size_t(row) * dstWidth, dstWidth);
+			}
+		});
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "DDSFile.h"
+
+// CPU conversion of skybox sources into a mip-mapped cube map that CreateDDSTextureFromFile
+// and CreateDDSTextureFromMemory load directly. Faces use the Direct3D order
+// +X, -X, +Y, -Y, +Z, -Z and are processed in parallel, one row per work item.
+namespace DX
+{
+	class WorkerPool;
+
+	struct CubemapSettings
+	{
+		uint32_t faceSize = 512;
+		uint32_t mipLevels = 0;     // 0 builds the full chain down to 1x1.
+	};
+
+	// Resamples an equirectangular (longitude/latitude) panorama into a cube map.
+	bool BuildCubemapFromEquirect(const DDSImage& equirect, const CubemapSettings& settings, DDSImage& cube, WorkerPool& pool);
+
+	// Assembles six face images into a cube map, resampling any face whose size differs from faceSize.
+	bool BuildCubemapFromFaces(const DDSImage* const faces[6], const CubemapSettings& settings, DDSImage& cube, WorkerPool& pool);
+
+	// Rebuilds mips 1..n of every face from mip 0 with a 2x2 box filter.
+	void GenerateMips(DDSImage& image, WorkerPool& pool);
+}
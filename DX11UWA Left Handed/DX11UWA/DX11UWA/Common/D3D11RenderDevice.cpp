@@ -0,0 +1,314 @@
+#include "pch.h"
+#include "D3D11RenderDevice.h"
+#include "WorkerPool.h"
+
+using namespace DX;
+
+namespace
+{
+	// Handles are the objects' own interface pointers; every Direct3D interface starts with IUnknown.
+	template <typename T>
+	T* As(const void* handle)
+	{
+		return static_cast<T*>(const_cast<void*>(handle));
+	}
+
+	// Bytes per element or texel of the formats in DX::Format.
+	uint32_t FormatBytes(Format format)
+	{
+		switch (format)
+		{
+		case FormatR32G32B32A32Float: return 16;
+		case FormatR32G32B32Float: return 12;
+		case FormatR32G32Uint: return 8;
+		case FormatR8G8B8A8Unorm:
+		case FormatB8G8R8A8Unorm:
+		case FormatR32Uint: return 4;
+		case FormatR16Uint: return 2;
+		default: return 0;
+		}
+	}
+}
+
+D3D11RenderDevice::D3D11RenderDevice(const std::shared_ptr<DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources),
+	m_device(deviceResources->GetD3DDevice()),
+	m_context(deviceResources->GetD3DDeviceContext())
+{
+	m_immediate.SetContext(m_context);
+
+	// Binding constant buffers by offset is a Direct3D 11.1 option that nearly every driver exposes.
+	// A ring of constants also maps its buffer with WRITE_NO_OVERWRITE, which dynamic constant
+	// buffers only allow with MapNoOverwriteOnDynamicConstantBuffer, so both are needed.
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	m_caps.constantOffsets = options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+
+	// Deferred contexts only pay off when the driver records command lists itself; the runtime's
+	// emulation just moves the same work around.
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	m_device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+	if (threading.DriverCommandLists)
+	{
+		m_deferred.resize(WorkerPool::Shared().GetConcurrency());
+		for (Deferred& deferred : m_deferred)
+		{
+			if (FAILED(m_device->CreateDeferredContext1(0, &deferred.context)))
+			{
+				m_deferred.clear();
+				break;
+			}
+			deferred.backend.SetContext(deferred.context.Get());
+		}
+	}
+	m_caps.deferredContexts = static_cast<uint32_t>(m_deferred.size());
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	m_immediate.SetContext(nullptr);
+}
+
+const void* D3D11RenderDevice::CreateBuffer(const BufferDesc& desc, const void* initialData)
+{
+	UINT bindFlags = 0;
+	bindFlags |= (desc.bindFlags & BindVertexBuffer) ? D3D11_BIND_VERTEX_BUFFER : 0;
+	bindFlags |= (desc.bindFlags & BindIndexBuffer) ? D3D11_BIND_INDEX_BUFFER : 0;
+	bindFlags |= (desc.bindFlags & BindConstantBuffer) ? D3D11_BIND_CONSTANT_BUFFER : 0;
+	bindFlags |= (desc.bindFlags & BindShaderResource) ? D3D11_BIND_SHADER_RESOURCE : 0;
+	D3D11_USAGE usage = desc.usage == UsageImmutable ? D3D11_USAGE_IMMUTABLE : desc.usage == UsageDynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	CD3D11_BUFFER_DESC bufferDesc(desc.size, bindFlags, usage, desc.usage == UsageDynamic ? D3D11_CPU_ACCESS_WRITE : 0);
+
+	D3D11_SUBRESOURCE_DATA data = { initialData, 0, 0 };
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	if (FAILED(m_device->CreateBuffer(&bufferDesc, initialData ? &data : nullptr, &buffer)))
+		return nullptr;
+
+	if (desc.bindFlags & BindShaderResource)
+	{
+		uint32_t elementBytes = FormatBytes(desc.viewFormat);
+		if (!elementBytes)
+			return nullptr;
+		CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(buffer.Get(), static_cast<DXGI_FORMAT>(desc.viewFormat), 0, desc.size / elementBytes);
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+		if (FAILED(m_device->CreateShaderResourceView(buffer.Get(), &viewDesc, &view)))
+			return nullptr;
+		m_bufferViews[buffer.Get()] = view;
+	}
+	return buffer.Detach();
+}
+
+const void* D3D11RenderDevice::CreateTexture(const TextureDesc& desc, const void* initialData)
+{
+	uint32_t mipLevels = desc.mipLevels;
+	if (mipLevels == 0)
+	{
+		for (uint32_t size = (std::max)(desc.width, desc.height); size; size >>= 1)
+		{
+			++mipLevels;
+		}
+	}
+
+	CD3D11_TEXTURE2D_DESC textureDesc(static_cast<DXGI_FORMAT>(desc.format), desc.width, desc.height, desc.arraySize, mipLevels,
+									  D3D11_BIND_SHADER_RESOURCE, initialData ? D3D11_USAGE_IMMUTABLE : D3D11_USAGE_DEFAULT, 0, 1, 0,
+									  desc.cube ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0);
+
+	// Every mip of every slice, tightly packed, in subresource order.
+	std::vector<D3D11_SUBRESOURCE_DATA> data;
+	const uint8_t* texels = static_cast<const uint8_t*>(initialData);
+	uint32_t texelBytes = FormatBytes(desc.format);
+	for (uint32_t slice = 0; initialData && slice < desc.arraySize; ++slice)
+	{
+		for (uint32_t mip = 0; mip < mipLevels; ++mip)
+		{
+			uint32_t width = (std::max)(desc.width >> mip, 1u);
+			uint32_t height = (std::max)(desc.height >> mip, 1u);
+			D3D11_SUBRESOURCE_DATA level = { texels, width * texelBytes, width * height * texelBytes };
+			data.push_back(level);
+			texels += size_t(width) * height * texelBytes;
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(m_device->CreateTexture2D(&textureDesc, initialData ? data.data() : nullptr, &texture)))
+		return nullptr;
+
+	CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(texture.Get(), desc.cube ? D3D11_SRV_DIMENSION_TEXTURECUBE : D3D11_SRV_DIMENSION_TEXTURE2DARRAY);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	if (FAILED(m_device->CreateShaderResourceView(texture.Get(), &viewDesc, &view)))
+		return nullptr;
+	return view.Detach();
+}
+
+const void* D3D11RenderDevice::CreateShader(ShaderStage stage, const void* bytecode, size_t size)
+{
+	HRESULT result = E_INVALIDARG;
+	const void* shader = nullptr;
+	switch (stage)
+	{
+	case StageVertex:
+	{
+		ID3D11VertexShader* vertexShader = nullptr;
+		result = m_device->CreateVertexShader(bytecode, size, nullptr, &vertexShader);
+		shader = vertexShader;
+		break;
+	}
+	case StageHull:
+	{
+		ID3D11HullShader* hullShader = nullptr;
+		result = m_device->CreateHullShader(bytecode, size, nullptr, &hullShader);
+		shader = hullShader;
+		break;
+	}
+	case StageDomain:
+	{
+		ID3D11DomainShader* domainShader = nullptr;
+		result = m_device->CreateDomainShader(bytecode, size, nullptr, &domainShader);
+		shader = domainShader;
+		break;
+	}
+	case StageGeometry:
+	{
+		ID3D11GeometryShader* geometryShader = nullptr;
+		result = m_device->CreateGeometryShader(bytecode, size, nullptr, &geometryShader);
+		shader = geometryShader;
+		break;
+	}
+	case StagePixel:
+	{
+		ID3D11PixelShader* pixelShader = nullptr;
+		result = m_device->CreatePixelShader(bytecode, size, nullptr, &pixelShader);
+		shader = pixelShader;
+		break;
+	}
+	default:
+		break;
+	}
+	return SUCCEEDED(result) ? shader : nullptr;
+}
+
+const void* D3D11RenderDevice::CreateInputLayout(const InputElement* elements, uint32_t count,
+												 const void* vertexShaderBytecode, size_t size)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> descs(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const InputElement& element = elements[i];
+		D3D11_INPUT_ELEMENT_DESC desc =
+		{
+			element.semantic, element.semanticIndex, static_cast<DXGI_FORMAT>(element.format), element.slot, element.offset,
+			element.perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA, element.perInstance ? 1u : 0u
+		};
+		descs[i] = desc;
+	}
+
+	ID3D11InputLayout* layout = nullptr;
+	if (FAILED(m_device->CreateInputLayout(descs.data(), count, vertexShaderBytecode, size, &layout)))
+		return nullptr;
+	return layout;
+}
+
+const void* D3D11RenderDevice::CreateRasterizerState(const RasterizerDesc& desc)
+{
+	CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+	rasterizerDesc.CullMode = desc.cullBack ? D3D11_CULL_BACK : D3D11_CULL_NONE;
+	rasterizerDesc.FrontCounterClockwise = desc.frontCounterClockwise;
+	rasterizerDesc.FillMode = desc.wireframe ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+
+	ID3D11RasterizerState* state = nullptr;
+	if (FAILED(m_device->CreateRasterizerState(&rasterizerDesc, &state)))
+		return nullptr;
+	return state;
+}
+
+const void* D3D11RenderDevice::CreateSampler(const SamplerDesc& desc)
+{
+	CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+	samplerDesc.Filter = desc.linear ? D3D11_FILTER_MIN_MAG_MIP_LINEAR : D3D11_FILTER_MIN_MAG_MIP_POINT;
+	samplerDesc.AddressU = desc.wrap ? D3D11_TEXTURE_ADDRESS_WRAP : D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = samplerDesc.AddressU;
+
+	ID3D11SamplerState* sampler = nullptr;
+	if (FAILED(m_device->CreateSamplerState(&samplerDesc, &sampler)))
+		return nullptr;
+	return sampler;
+}
+
+void D3D11RenderDevice::Release(const void* handle)
+{
+	if (!handle)
+		return;
+	m_bufferViews.erase(handle);
+	As<IUnknown>(handle)->Release();
+}
+
+void* D3D11RenderDevice::Map(const void* buffer, bool discard)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (!buffer || FAILED(m_context->Map(As<ID3D11Buffer>(buffer), 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+		return nullptr;
+	return mapped.pData;
+}
+
+void D3D11RenderDevice::Unmap(const void* buffer)
+{
+	m_context->Unmap(As<ID3D11Buffer>(buffer), 0);
+}
+
+const void* D3D11RenderDevice::GetBufferView(const void* buffer)
+{
+	auto found = m_bufferViews.find(buffer);
+	return found != m_bufferViews.end() ? found->second.Get() : nullptr;
+}
+
+void D3D11RenderDevice::WriteBuffer(const void* buffer, uint32_t offset, const void* data, uint32_t size)
+{
+	// Constant buffers can only be updated whole, and take no box.
+	D3D11_BUFFER_DESC desc;
+	As<ID3D11Buffer>(buffer)->GetDesc(&desc);
+	D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+	bool whole = (desc.BindFlags & D3D11_BIND_CONSTANT_BUFFER) != 0;
+	m_context->UpdateSubresource(As<ID3D11Buffer>(buffer), 0, whole ? nullptr : &box, data, 0, 0);
+}
+
+void D3D11RenderDevice::SetTextureMinLod(const void* texture, float lod)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	As<ID3D11ShaderResourceView>(texture)->GetResource(&resource);
+	m_context->SetResourceMinLOD(resource.Get(), lod);
+}
+
+void D3D11RenderDevice::ClearDepth(void)
+{
+	m_context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+}
+
+IRenderBackend& D3D11RenderDevice::BeginDeferred(uint32_t index)
+{
+	Deferred& deferred = m_deferred[index];
+	BindRenderTarget(deferred.context.Get());
+	return deferred.backend;
+}
+
+bool D3D11RenderDevice::FinishDeferred(uint32_t index)
+{
+	Deferred& deferred = m_deferred[index];
+	deferred.commands.Reset();
+	return SUCCEEDED(deferred.context->FinishCommandList(FALSE, &deferred.commands));
+}
+
+void D3D11RenderDevice::ExecuteDeferred(uint32_t index)
+{
+	Deferred& deferred = m_deferred[index];
+	m_context->ExecuteCommandList(deferred.commands.Get(), FALSE);
+	deferred.commands.Reset();
+	BindRenderTarget(m_context);
+}
+
+void D3D11RenderDevice::BindRenderTarget(ID3D11DeviceContext* context)
+{
+	D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+	context->RSSetViewports(1, &viewport);
+	ID3D11RenderTargetView* const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
+	context->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceResources.h"
+#include "D3D11StateBackend.h"
+#include "RenderDevice.h"
+
+namespace DX
+{
+	// IRenderDevice over the device and contexts of DeviceResources. Handles are the Direct3D
+	// objects themselves, one reference each, so D3D11StateBackend binds them as they are: buffers,
+	// shaders, input layouts and states as their own interfaces and textures as the shader resource
+	// view, which holds the texture. Create the device again after the DeviceResources device is lost.
+	class D3D11RenderDevice : public IRenderDevice
+	{
+	public:
+		explicit D3D11RenderDevice(const std::shared_ptr<DeviceResources>& deviceResources);
+		~D3D11RenderDevice();
+
+		const void* CreateBuffer(const BufferDesc& desc, const void* initialData) override;
+		const void* CreateTexture(const TextureDesc& desc, const void* initialData) override;
+		const void* CreateShader(ShaderStage stage, const void* bytecode, size_t size) override;
+		const void* CreateInputLayout(const InputElement* elements, uint32_t count,
+									  const void* vertexShaderBytecode, size_t size) override;
+		const void* CreateRasterizerState(const RasterizerDesc& desc) override;
+		const void* CreateSampler(const SamplerDesc& desc) override;
+		void Release(const void* handle) override;
+		void* Map(const void* buffer, bool discard) override;
+		void Unmap(const void* buffer) override;
+		DeviceCaps GetCaps(void) const override { return m_caps; }
+		const void* GetBufferView(const void* buffer) override;
+		IRenderBackend& GetContext(void) override { return m_immediate; }
+		void WriteBuffer(const void* buffer, uint32_t offset, const void* data, uint32_t size) override;
+		void SetTextureMinLod(const void* texture, float lod) override;
+		void ClearDepth(void) override;
+		IRenderBackend& BeginDeferred(uint32_t index) override;
+		bool FinishDeferred(uint32_t index) override;
+		void ExecuteDeferred(uint32_t index) override;
+
+	private:
+		struct Deferred
+		{
+			Microsoft::WRL::ComPtr<ID3D11DeviceContext1>	context;
+			Microsoft::WRL::ComPtr<ID3D11CommandList>		commands;
+			D3D11StateBackend								backend;
+		};
+
+		// Points a context at the back buffer, as DX11UWAMain does for the immediate context each frame.
+		void BindRenderTarget(ID3D11DeviceContext* context);
+
+		std::shared_ptr<DeviceResources>	m_deviceResources;
+		ID3D11Device3*						m_device;
+		ID3D11DeviceContext3*				m_context;
+		D3D11StateBackend					m_immediate;
+		DeviceCaps							m_caps;
+		std::vector<Deferred>				m_deferred;
+
+		// Views of the shader resource buffers, by buffer.
+		std::unordered_map<const void*, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_bufferViews;
+	};
+}
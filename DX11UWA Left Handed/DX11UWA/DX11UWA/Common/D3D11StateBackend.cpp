@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "D3D11StateBackend.h"
+
+using namespace DX;
+
+namespace
+{
+	// The cache hands back the same pointers it was given, so the casts restore the original types.
+	template <typename T>
+	T* As(const void* handle)
+	{
+		return static_cast<T*>(const_cast<void*>(handle));
+	}
+}
+
+void D3D11StateBackend::SetInputLayout(const void* layout)
+{
+	m_context->IASetInputLayout(As<ID3D11InputLayout>(layout));
+}
+
+void D3D11StateBackend::SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+{
+	ID3D11Buffer* buffers[] = { As<ID3D11Buffer>(buffer) };
+	UINT strides[] = { stride };
+	UINT offsets[] = { offset };
+	m_context->IASetVertexBuffers(slot, 1, buffers, strides, offsets);
+}
+
+void D3D11StateBackend::SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset)
+{
+	m_context->IASetIndexBuffer(As<ID3D11Buffer>(buffer), static_cast<DXGI_FORMAT>(format), offset);
+}
+
+void D3D11StateBackend::SetPrimitiveTopology(uint32_t topology)
+{
+	m_context->IASetPrimitiveTopology(static_cast<D3D11_PRIMITIVE_TOPOLOGY>(topology));
+}
+
+void D3D11StateBackend::SetShader(ShaderStage stage, const void* shader)
+{
+	switch (stage)
+	{
+	case StageVertex:
+		m_context->VSSetShader(As<ID3D11VertexShader>(shader), nullptr, 0);
+		break;
+	case StageHull:
+		m_context->HSSetShader(As<ID3D11HullShader>(shader), nullptr, 0);
+		break;
+	case StageDomain:
+		m_context->DSSetShader(As<ID3D11DomainShader>(shader), nullptr, 0);
+		break;
+	case StageGeometry:
+		m_context->GSSetShader(As<ID3D11GeometryShader>(shader), nullptr, 0);
+		break;
+	case StagePixel:
+		m_context->PSSetShader(As<ID3D11PixelShader>(shader), nullptr, 0);
+		break;
+	}
+}
+
+void D3D11StateBackend::SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+										  uint32_t firstConstant, uint32_t constantCount)
+{
+	ID3D11Buffer* buffers[] = { As<ID3D11Buffer>(buffer) };
+	UINT first[] = { firstConstant };
+	UINT count[] = { constantCount };
+
+	// Null ranges bind the whole buffer, which also works on devices without constant buffer offsetting.
+	const UINT* firstConstants = constantCount ? first : nullptr;
+	const UINT* constantCounts = constantCount ? count : nullptr;
+	switch (stage)
+	{
+	case StageVertex:
+		m_context->VSSetConstantBuffers1(slot, 1, buffers, firstConstants, constantCounts);
+		break;
+	case StageHull:
+		m_context->HSSetConstantBuffers1(slot, 1, buffers, firstConstants, constantCounts);
+		break;
+	case StageDomain:
+		m_context->DSSetConstantBuffers1(slot, 1, buffers, firstConstants, constantCounts);
+		break;
+	case StageGeometry:
+		m_context->GSSetConstantBuffers1(slot, 1, buffers, firstConstants, constantCounts);
+		break;
+	case StagePixel:
+		m_context->PSSetConstantBuffers1(slot, 1, buffers, firstConstants, constantCounts);
+		break;
+	}
+}
+
+void D3D11StateBackend::SetShaderResource(ShaderStage stage, uint32_t slot, const void* view)
+{
+	ID3D11ShaderResourceView* views[] = { As<ID3D11ShaderResourceView>(view) };
+	switch (stage)
+	{
+	case StageVertex:
+		m_context->VSSetShaderResources(slot, 1, views);
+		break;
+	case StageHull:
+		m_context->HSSetShaderResources(slot, 1, views);
+		break;
+	case StageDomain:
+		m_context->DSSetShaderResources(slot, 1, views);
+		break;
+	case StageGeometry:
+		m_context->GSSetShaderResources(slot, 1, views);
+		break;
+	case StagePixel:
+		m_context->PSSetShaderResources(slot, 1, views);
+		break;
+	}
+}
+
+void D3D11StateBackend::SetSampler(ShaderStage stage, uint32_t slot, const void* sampler)
+{
+	ID3D11SamplerState* samplers[] = { As<ID3D11SamplerState>(sampler) };
+	switch (stage)
+	{
+	case StageVertex:
+		m_context->VSSetSamplers(slot, 1, samplers);
+		break;
+	case StageHull:
+		m_context->HSSetSamplers(slot, 1, samplers);
+		break;
+	case StageDomain:
+		m_context->DSSetSamplers(slot, 1, samplers);
+		break;
+	case StageGeometry:
+		m_context->GSSetSamplers(slot, 1, samplers);
+		break;
+	case StagePixel:
+		m_context->PSSetSamplers(slot, 1, samplers);
+		break;
+	}
+}
+
+void D3D11StateBackend::SetRasterizerState(const void* state)
+{
+	m_context->RSSetState(As<ID3D11RasterizerState>(state));
+}
+
+void D3D11StateBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11StateBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+											 int32_t baseVertex, uint32_t startInstance)
+{
+	m_context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11StateBackend::UpdateBuffer(const void* buffer, const void* data, uint32_t size)
+{
+	// Whole-buffer updates only, so size is implied by the buffer.
+	(void)size;
+	m_context->UpdateSubresource1(As<ID3D11Buffer>(buffer), 0, nullptr, data, 0, 0, 0);
+}
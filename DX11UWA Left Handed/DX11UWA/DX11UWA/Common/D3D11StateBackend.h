@@ -0,0 +1,35 @@
+#pragma once
+
+#include "StateCache.h"
+
+namespace DX
+{
+	// Forwards the state cache's calls to a Direct3D 11 device context.
+	class D3D11StateBackend : public IRenderBackend
+	{
+	public:
+		D3D11StateBackend() : m_context(nullptr) {}
+
+		// Immediate or deferred.
+		void SetContext(ID3D11DeviceContext1* context) { m_context = context; }
+		ID3D11DeviceContext1* GetContext(void) const { return m_context; }
+
+		void SetInputLayout(const void* layout) override;
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) override;
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetShader(ShaderStage stage, const void* shader) override;
+		void SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+							   uint32_t firstConstant, uint32_t constantCount) override;
+		void SetShaderResource(ShaderStage stage, uint32_t slot, const void* view) override;
+		void SetSampler(ShaderStage stage, uint32_t slot, const void* sampler) override;
+		void SetRasterizerState(const void* state) override;
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+								  int32_t baseVertex, uint32_t startInstance) override;
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size) override;
+
+	private:
+		ID3D11DeviceContext1* m_context;
+	};
+}
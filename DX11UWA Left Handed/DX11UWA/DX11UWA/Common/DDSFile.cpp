@@ -0,0 +1,244 @@
+#include "DDSFile.h"
+#include "DDSFormatConvert.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t DDSMagic = 0x20534444; // "DDS "
+
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_HEIGHT = 0x2;
+	const uint32_t DDSD_WIDTH = 0x4;
+	const uint32_t DDSD_PITCH = 0x8;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDPF_RGB = 0x40;
+
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+	const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xfe00;
+
+#pragma pack(push, 1)
+	struct PixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rMask;
+		uint32_t gMask;
+		uint32_t bMask;
+		uint32_t aMask;
+	};
+
+	struct Header
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		PixelFormat ddspf;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(Header) == 124, "DDS header size mismatch");
+
+	FILE* OpenFile(const char* path, const char* mode)
+	{
+#if defined(_MSC_VER)
+		FILE* file = nullptr;
+		return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+		return fopen(path, mode);
+#endif
+	}
+}
+
+void DDSImage::Allocate(uint32_t w, uint32_t h, uint32_t mips, uint32_t faces)
+{
+	width = w;
+	height = h;
+	mipLevels = mips;
+	faceCount = faces;
+	texels.assign(LevelOffset(faces, 0), 0);
+}
+
+size_t DDSImage::LevelOffset(uint32_t face, uint32_t mip) const
+{
+	size_t faceSize = 0;
+	for (uint32_t m = 0; m < mipLevels; ++m)
+	{
+		faceSize += size_t(LevelWidth(m)) * LevelHeight(m);
+	}
+
+	size_t offset = faceSize * face;
+	for (uint32_t m = 0; m < mip; ++m)
+	{
+		offset += size_t(LevelWidth(m)) * LevelHeight(m);
+	}
+	return offset;
+}
+
+bool DX::ReadDDS(const uint8_t* data, size_t size, DDSImage& image)
+{
+	if (size < sizeof(uint32_t) + sizeof(Header))
+		return false;
+
+	uint32_t magic;
+	memcpy(&magic, data, sizeof(magic));
+	if (magic != DDSMagic)
+		return false;
+
+	Header header;
+	memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+	if (header.size != sizeof(Header) || (header.ddspf.flags & DDPF_FOURCC))
+		return false;
+
+	const PixelFormat& pf = header.ddspf;
+	LegacyFormat legacy = LegacyUnknown;
+	bool bgra;
+	if (pf.rgbBitCount == 32 && pf.rMask == 0x000000ff && pf.gMask == 0x0000ff00 && pf.bMask == 0x00ff0000)
+		bgra = false;
+	else if (pf.rgbBitCount == 32 && pf.rMask == 0x00ff0000 && pf.gMask == 0x0000ff00 && pf.bMask == 0x000000ff)
+		bgra = true;
+	else
+	{
+		// Older layouts (24-bit, luminance, 16-bit) are expanded to 32 bits on the way in.
+		legacy = ClassifyLegacyFormat(pf.flags, pf.rgbBitCount, pf.rMask, pf.gMask, pf.bMask, pf.aMask);
+		if (legacy == LegacyUnknown)
+			return false;
+		bgra = LegacyTargetLayout(legacy) == ConvertedB8G8R8A8;
+	}
+
+	uint32_t mips = header.mipMapCount ? header.mipMapCount : 1;
+	uint32_t faces = ((header.caps2 & DDSCAPS2_CUBEMAP_ALLFACES) == DDSCAPS2_CUBEMAP_ALLFACES) ? 6 : 1;
+
+	image.Allocate(header.width, header.height, mips, faces);
+	image.bgra = bgra;
+
+	const uint8_t* src = data + sizeof(uint32_t) + sizeof(Header);
+	size_t available = size - sizeof(uint32_t) - sizeof(Header);
+	if (legacy != LegacyUnknown)
+	{
+		const uint32_t bpp = LegacyBitsPerPixel(legacy);
+		for (uint32_t face = 0; face < faces; ++face)
+		{
+			for (uint32_t mip = 0; mip < mips; ++mip)
+			{
+				size_t rowBytes = (size_t(image.LevelWidth(mip)) * bpp + 7) / 8;
+				size_t levelBytes = rowBytes * image.LevelHeight(mip);
+				if (available < levelBytes)
+					return false;
+
+				ConvertLegacySurface(legacy, src, rowBytes, reinterpret_cast<uint8_t*>(image.Level(face, mip)),
+									 size_t(image.LevelWidth(mip)) * sizeof(uint32_t), image.LevelWidth(mip), image.LevelHeight(mip));
+				src += levelBytes;
+				available -= levelBytes;
+			}
+		}
+		return true;
+	}
+
+	size_t bytes = image.texels.size() * sizeof(uint32_t);
+	if (available < bytes)
+		return false;
+	memcpy(image.texels.data(), src, bytes);
+
+	// Layouts without an alpha mask store garbage in the top byte; treat them as opaque.
+	if (!(header.ddspf.flags & DDPF_ALPHAPIXELS) || header.ddspf.aMask == 0)
+	{
+		for (uint32_t& texel : image.texels)
+		{
+			texel |= 0xff000000;
+		}
+	}
+	return true;
+}
+
+bool DX::ReadDDSFile(const char* path, DDSImage& image)
+{
+	FILE* file = OpenFile(path, "rb");
+	if (!file)
+		return false;
+
+	std::vector<uint8_t> data;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (length > 0)
+	{
+		data.resize(static_cast<size_t>(length));
+		data.resize(fread(data.data(), 1, data.size(), file));
+	}
+	fclose(file);
+
+	return ReadDDS(data.data(), data.size(), image);
+}
+
+std::vector<uint8_t> DX::WriteDDS(const DDSImage& image)
+{
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(Header);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_PITCH;
+	header.height = image.height;
+	header.width = image.width;
+	header.pitchOrLinearSize = image.width * 4;
+	header.mipMapCount = image.mipLevels;
+	header.ddspf.size = sizeof(PixelFormat);
+	header.ddspf.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+	header.ddspf.rgbBitCount = 32;
+	header.ddspf.rMask = image.bgra ? 0x00ff0000 : 0x000000ff;
+	header.ddspf.gMask = 0x0000ff00;
+	header.ddspf.bMask = image.bgra ? 0x000000ff : 0x00ff0000;
+	header.ddspf.aMask = 0xff000000;
+	header.caps = DDSCAPS_TEXTURE;
+
+	if (image.mipLevels > 1)
+	{
+		header.flags |= DDSD_MIPMAPCOUNT;
+		header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	if (image.faceCount == 6)
+	{
+		header.caps |= DDSCAPS_COMPLEX;
+		header.caps2 = DDSCAPS2_CUBEMAP_ALLFACES;
+	}
+
+	std::vector<uint8_t> file(sizeof(uint32_t) + sizeof(Header) + image.texels.size() * sizeof(uint32_t));
+	memcpy(file.data(), &DDSMagic, sizeof(uint32_t));
+	memcpy(file.data() + sizeof(uint32_t), &header, sizeof(header));
+	if (!image.texels.empty())
+	{
+		memcpy(file.data() + sizeof(uint32_t) + sizeof(Header), image.texels.data(), image.texels.size() * sizeof(uint32_t));
+	}
+	return file;
+}
+
+bool DX::WriteDDSFile(const char* path, const DDSImage& image)
+{
+	FILE* file = OpenFile(path, "wb");
+	if (!file)
+		return false;
+
+	std::vector<uint8_t> data = WriteDDS(image);
+	bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+	return (fclose(file) == 0) && ok;
+}
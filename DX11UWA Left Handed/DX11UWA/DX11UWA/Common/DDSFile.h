@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Minimal reader/writer for uncompressed DDS images (2D or cube, with mips), held as 32-bit texels.
+// Used by the offline tools and by CPU-side texture processing; the GPU upload path
+// stays in DDSTextureLoader.
+namespace DX
+{
+	struct DDSImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		uint32_t faceCount = 1;      // 1 for a 2D texture, 6 for a cube map.
+		bool     bgra = false;       // Channel order of the texels, B8G8R8A8 instead of R8G8B8A8.
+		std::vector<uint32_t> texels; // Face-major, then mip, each level tightly packed.
+
+		void Allocate(uint32_t w, uint32_t h, uint32_t mips, uint32_t faces);
+		size_t LevelOffset(uint32_t face, uint32_t mip) const;
+		uint32_t LevelWidth(uint32_t mip) const { return (width >> mip) ? (width >> mip) : 1; }
+		uint32_t LevelHeight(uint32_t mip) const { return (height >> mip) ? (height >> mip) : 1; }
+		uint32_t* Level(uint32_t face, uint32_t mip) { return texels.data() + LevelOffset(face, mip); }
+		const uint32_t* Level(uint32_t face, uint32_t mip) const { return texels.data() + LevelOffset(face, mip); }
+	};
+
+	// Parses a DDS file in memory. 32bpp RGBA/BGRA is read as is; the legacy layouts known to
+	// DDSFormatConvert (24-bit RGB, luminance, 16-bit) are expanded to 32bpp.
+	bool ReadDDS(const uint8_t* data, size_t size, DDSImage& image);
+	bool ReadDDSFile(const char* path, DDSImage& image);
+
+	// Serializes an image with a legacy header that CreateDDSTextureFromFile/Memory understand.
+	std::vector<uint8_t> WriteDDS(const DDSImage& image);
+	bool WriteDDSFile(const char* path, const DDSImage& image);
+}
@@ -0,0 +1,407 @@
+#include "DDSFormatConvert.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t DDPF_RGB = 0x40;
+	const uint32_t DDPF_LUMINANCE = 0x20000;
+
+	// Below this many texels a surface is converted on the calling thread.
+	const size_t ParallelThreshold = 64 * 1024;
+
+	inline uint32_t Expand5(uint32_t v) { return (v << 3) | (v >> 2); }
+	inline uint32_t Expand4(uint32_t v) { return v * 17; }
+	inline uint32_t Expand3(uint32_t v) { return (v << 5) | (v << 2) | (v >> 1); }
+	inline uint32_t Expand2(uint32_t v) { return v * 85; }
+
+	inline uint32_t Pack(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t a)
+	{
+		return c0 | (c1 << 8) | (c2 << 16) | (a << 24);
+	}
+
+	inline uint16_t Load16(const uint8_t* p)
+	{
+		uint16_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t Load32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+#if DX_SIMD_SSE2
+	// 24bpp -> 32bpp by inserting an opaque alpha byte after every third byte.
+	// Reads 16 bytes per 4 texels, so it stops while at least 6 texels remain to stay inside the row.
+	size_t Expand24(const uint8_t* src, uint32_t* dst, size_t width)
+	{
+		size_t x = 0;
+#if DX_SIMD_AVX2
+		const __m256i shuffle8 = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+												  0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i alpha8 = _mm256_set1_epi32(static_cast<int>(0xff000000));
+		for (; x + 10 <= width; x += 8)
+		{
+			__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3));
+			__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3 + 12));
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle8), alpha8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+		}
+#endif
+#if DX_SIMD_SSE41
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+		for (; x + 6 <= width; x += 4)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+		}
+#else
+		(void)src;
+		(void)dst;
+		(void)width;
+#endif
+		return x;
+	}
+
+	size_t ExpandX8(const uint8_t* src, uint32_t* dst, size_t width)
+	{
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+		size_t x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(v, alpha));
+		}
+		return x;
+	}
+
+	size_t ExpandL8(const uint8_t* src, uint32_t* dst, size_t width)
+	{
+		const __m128i ones = _mm_set1_epi8(-1);
+		size_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			__m128i ll0 = _mm_unpacklo_epi8(l, l);
+			__m128i ll1 = _mm_unpackhi_epi8(l, l);
+			__m128i la0 = _mm_unpacklo_epi8(l, ones);
+			__m128i la1 = _mm_unpackhi_epi8(l, ones);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 0), _mm_unpacklo_epi16(ll0, la0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), _mm_unpackhi_epi16(ll0, la0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 8), _mm_unpacklo_epi16(ll1, la1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 12), _mm_unpackhi_epi16(ll1, la1));
+		}
+		return x;
+	}
+
+	// Each 16-bit texel is (A << 8) | L. Duplicating the low byte of every 16-bit lane gives (L, L),
+	// and interleaving that with the original lanes gives L, L, L, A.
+	size_t ExpandA8L8(const uint8_t* src, uint32_t* dst, size_t width)
+	{
+		const __m128i lowByte = _mm_set1_epi16(0x00ff);
+		size_t x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+			__m128i l = _mm_and_si128(v, lowByte);
+			__m128i ll = _mm_or_si128(l, _mm_slli_epi16(l, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 0), _mm_unpacklo_epi16(ll, v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), _mm_unpackhi_epi16(ll, v));
+		}
+		return x;
+	}
+
+	// 5:5:5 expands each field to 8 bits as (v << 3) | (v >> 2), building B|G<<8 and R|A<<8 halves
+	// that are then interleaved into BGRA.
+	size_t Expand555(const uint8_t* src, uint32_t* dst, size_t width, bool hasAlpha)
+	{
+		const __m128i mask5 = _mm_set1_epi16(0x1f);
+		const __m128i opaque = _mm_set1_epi16(static_cast<short>(0xff00));
+		size_t x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+			__m128i b = _mm_and_si128(v, mask5);
+			__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask5);
+			__m128i r = _mm_and_si128(_mm_srli_epi16(v, 10), mask5);
+			b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+			g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+			r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+
+			// The arithmetic shift smears bit 15 across the lane, giving 0x0000 or 0xffff.
+			__m128i a = hasAlpha ? _mm_and_si128(_mm_srai_epi16(v, 15), opaque) : opaque;
+			__m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+			__m128i ra = _mm_or_si128(r, a);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 0), _mm_unpacklo_epi16(bg, ra));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), _mm_unpackhi_epi16(bg, ra));
+		}
+		return x;
+	}
+
+	// 4:4:4:4 splits into (B, R) and (G, A) nibble pairs, widens each nibble with v | v << 4,
+	// and interleaves the bytes back into B, G, R, A.
+	size_t Expand4444(const uint8_t* src, uint32_t* dst, size_t width, bool hasAlpha)
+	{
+		const __m128i nibbles = _mm_set1_epi16(0x0f0f);
+		const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+		const __m128i keep = hasAlpha ? _mm_setzero_si128() : opaque;
+		size_t x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+			__m128i br = _mm_and_si128(v, nibbles);
+			__m128i ga = _mm_and_si128(_mm_srli_epi16(v, 4), nibbles);
+			br = _mm_or_si128(br, _mm_slli_epi16(br, 4));
+			ga = _mm_or_si128(ga, _mm_slli_epi16(ga, 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 0), _mm_or_si128(_mm_unpacklo_epi8(br, ga), keep));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), _mm_or_si128(_mm_unpackhi_epi8(br, ga), keep));
+		}
+		return x;
+	}
+#endif
+}
+
+LegacyFormat DX::ClassifyLegacyFormat(uint32_t flags, uint32_t bitCount, uint32_t rMask, uint32_t gMask, uint32_t bMask, uint32_t aMask)
+{
+#define LEGACY_MASK(r, g, b, a) (rMask == (r) && gMask == (g) && bMask == (b) && aMask == (a))
+	if (flags & DDPF_RGB)
+	{
+		switch (bitCount)
+		{
+		case 32:
+			if (LEGACY_MASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000))
+				return LegacyX8B8G8R8;
+			break;
+
+		case 24:
+			if (LEGACY_MASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+				return LegacyR8G8B8;
+			if (LEGACY_MASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000))
+				return LegacyB8G8R8;
+			break;
+
+		case 16:
+			if (LEGACY_MASK(0x7c00, 0x03e0, 0x001f, 0x0000))
+				return LegacyX1R5G5B5;
+			if (LEGACY_MASK(0x7c00, 0x03e0, 0x001f, 0x8000))
+				return LegacyA1R5G5B5;
+			if (LEGACY_MASK(0x0f00, 0x00f0, 0x000f, 0x0000))
+				return LegacyX4R4G4B4;
+			if (LEGACY_MASK(0x0f00, 0x00f0, 0x000f, 0xf000))
+				return LegacyA4R4G4B4;
+			if (LEGACY_MASK(0x00e0, 0x001c, 0x0003, 0xff00))
+				return LegacyA8R3G3B2;
+			break;
+
+		case 8:
+			if (LEGACY_MASK(0xe0, 0x1c, 0x03, 0x00))
+				return LegacyR3G3B2;
+			break;
+		}
+	}
+	else if (flags & DDPF_LUMINANCE)
+	{
+		if (bitCount == 8 && LEGACY_MASK(0xff, 0, 0, 0))
+			return LegacyL8;
+		if (bitCount == 8 && LEGACY_MASK(0x0f, 0, 0, 0xf0))
+			return LegacyA4L4;
+		if (bitCount == 16 && LEGACY_MASK(0x00ff, 0, 0, 0xff00))
+			return LegacyA8L8;
+	}
+#undef LEGACY_MASK
+	return LegacyUnknown;
+}
+
+uint32_t DX::LegacyBitsPerPixel(LegacyFormat format)
+{
+	switch (format)
+	{
+	case LegacyX8B8G8R8:
+		return 32;
+	case LegacyR8G8B8:
+	case LegacyB8G8R8:
+		return 24;
+	case LegacyA8L8:
+	case LegacyX1R5G5B5:
+	case LegacyA1R5G5B5:
+	case LegacyX4R4G4B4:
+	case LegacyA4R4G4B4:
+	case LegacyA8R3G3B2:
+		return 16;
+	case LegacyL8:
+	case LegacyA4L4:
+	case LegacyR3G3B2:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+ConvertedLayout DX::LegacyTargetLayout(LegacyFormat format)
+{
+	switch (format)
+	{
+	case LegacyB8G8R8:
+	case LegacyX8B8G8R8:
+	case LegacyL8:
+	case LegacyA8L8:
+	case LegacyA4L4:
+		return ConvertedR8G8B8A8;
+	default:
+		return ConvertedB8G8R8A8;
+	}
+}
+
+const char* DX::LegacyFormatName(LegacyFormat format)
+{
+	static const char* const names[LegacyFormatCount] =
+	{
+		"Unknown", "R8G8B8", "B8G8R8", "X8B8G8R8", "L8", "A8L8", "A4L4",
+		"X1R5G5B5", "A1R5G5B5", "X4R4G4B4", "A4R4G4B4", "R3G3B2", "A8R3G3B2",
+	};
+	return format < LegacyFormatCount ? names[format] : names[0];
+}
+
+void DX::ConvertLegacyRowScalar(LegacyFormat format, const uint8_t* src, uint32_t* dst, size_t width)
+{
+	switch (format)
+	{
+	case LegacyR8G8B8:
+	case LegacyB8G8R8:
+		for (size_t x = 0; x < width; ++x, src += 3)
+			dst[x] = Pack(src[0], src[1], src[2], 0xff);
+		break;
+
+	case LegacyX8B8G8R8:
+		for (size_t x = 0; x < width; ++x, src += 4)
+			dst[x] = Load32(src) | 0xff000000;
+		break;
+
+	case LegacyL8:
+		for (size_t x = 0; x < width; ++x)
+			dst[x] = Pack(src[x], src[x], src[x], 0xff);
+		break;
+
+	case LegacyA8L8:
+		for (size_t x = 0; x < width; ++x, src += 2)
+			dst[x] = Pack(src[0], src[0], src[0], src[1]);
+		break;
+
+	case LegacyA4L4:
+		for (size_t x = 0; x < width; ++x)
+		{
+			uint32_t l = Expand4(src[x] & 0x0f);
+			dst[x] = Pack(l, l, l, Expand4(src[x] >> 4));
+		}
+		break;
+
+	case LegacyX1R5G5B5:
+	case LegacyA1R5G5B5:
+		for (size_t x = 0; x < width; ++x, src += 2)
+		{
+			uint32_t v = Load16(src);
+			uint32_t a = (format == LegacyX1R5G5B5 || (v & 0x8000)) ? 0xff : 0;
+			dst[x] = Pack(Expand5(v & 0x1f), Expand5((v >> 5) & 0x1f), Expand5((v >> 10) & 0x1f), a);
+		}
+		break;
+
+	case LegacyX4R4G4B4:
+	case LegacyA4R4G4B4:
+		for (size_t x = 0; x < width; ++x, src += 2)
+		{
+			uint32_t v = Load16(src);
+			uint32_t a = format == LegacyX4R4G4B4 ? 0xff : Expand4(v >> 12);
+			dst[x] = Pack(Expand4(v & 0xf), Expand4((v >> 4) & 0xf), Expand4((v >> 8) & 0xf), a);
+		}
+		break;
+
+	case LegacyR3G3B2:
+		for (size_t x = 0; x < width; ++x)
+		{
+			uint32_t v = src[x];
+			dst[x] = Pack(Expand2(v & 0x3), Expand3((v >> 2) & 0x7), Expand3(v >> 5), 0xff);
+		}
+		break;
+
+	case LegacyA8R3G3B2:
+		for (size_t x = 0; x < width; ++x, src += 2)
+		{
+			uint32_t v = src[0];
+			dst[x] = Pack(Expand2(v & 0x3), Expand3((v >> 2) & 0x7), Expand3(v >> 5), src[1]);
+		}
+		break;
+
+	default:
+		memset(dst, 0, width * sizeof(uint32_t));
+		break;
+	}
+}
+
+void DX::ConvertLegacyRow(LegacyFormat format, const uint8_t* src, uint32_t* dst, size_t width)
+{
+	size_t done = 0;
+#if DX_SIMD_SSE2
+	switch (format)
+	{
+	case LegacyR8G8B8:
+	case LegacyB8G8R8:
+		done = Expand24(src, dst, width);
+		break;
+	case LegacyX8B8G8R8:
+		done = ExpandX8(src, dst, width);
+		break;
+	case LegacyL8:
+		done = ExpandL8(src, dst, width);
+		break;
+	case LegacyA8L8:
+		done = ExpandA8L8(src, dst, width);
+		break;
+	case LegacyX1R5G5B5:
+	case LegacyA1R5G5B5:
+		done = Expand555(src, dst, width, format == LegacyA1R5G5B5);
+		break;
+	case LegacyX4R4G4B4:
+	case LegacyA4R4G4B4:
+		done = Expand4444(src, dst, width, format == LegacyA4R4G4B4);
+		break;
+	default:
+		break;
+	}
+#endif
+	if (done < width)
+	{
+		size_t srcOffset = done * LegacyBitsPerPixel(format) / 8;
+		ConvertLegacyRowScalar(format, src + srcOffset, dst + done, width - done);
+	}
+}
+
+void DX::ConvertLegacySurface(LegacyFormat format, const uint8_t* src, size_t srcPitch,
+							  uint8_t* dst, size_t dstPitch, size_t width, size_t height)
+{
+	auto convertRows = [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			ConvertLegacyRow(format, src + y * srcPitch, reinterpret_cast<uint32_t*>(dst + y * dstPitch), width);
+		}
+	};
+
+	if (width * height < ParallelThreshold)
+	{
+		convertRows(0, height);
+		return;
+	}
+
+	size_t grain = ParallelThreshold / 4 / width + 1;
+	WorkerPool::Shared().ParallelFor(height, grain, convertRows);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Expands legacy Direct3D 9 DDS pixel layouts that have no DXGI equivalent into
+// 32-bit formats the GPU can sample directly. Used by DDSTextureLoader and DDSFile
+// while a file is loaded; no Direct3D dependencies.
+namespace DX
+{
+	enum LegacyFormat : uint32_t
+	{
+		LegacyUnknown = 0,
+		LegacyR8G8B8,     // 24bpp, bytes B,G,R        -> B8G8R8A8
+		LegacyB8G8R8,     // 24bpp, bytes R,G,B        -> R8G8B8A8
+		LegacyX8B8G8R8,   // 32bpp, bytes R,G,B,x      -> R8G8B8A8
+		LegacyL8,         // 8bpp luminance            -> R8G8B8A8 (L,L,L,1)
+		LegacyA8L8,       // 16bpp luminance + alpha   -> R8G8B8A8 (L,L,L,A)
+		LegacyA4L4,       // 8bpp, 4:4                 -> R8G8B8A8 (L,L,L,A)
+		LegacyX1R5G5B5,   // 16bpp 5:5:5, no alpha     -> B8G8R8A8
+		LegacyA1R5G5B5,   // 16bpp 5:5:5:1             -> B8G8R8A8
+		LegacyX4R4G4B4,   // 16bpp 4:4:4, no alpha     -> B8G8R8A8
+		LegacyA4R4G4B4,   // 16bpp 4:4:4:4             -> B8G8R8A8
+		LegacyR3G3B2,     // 8bpp 3:3:2                -> B8G8R8A8
+		LegacyA8R3G3B2,   // 16bpp 3:3:2 + 8 bit alpha -> B8G8R8A8
+		LegacyFormatCount
+	};
+
+	// Layout of the converted texels. Every target is 32 bits per texel.
+	enum ConvertedLayout : uint32_t
+	{
+		ConvertedR8G8B8A8,
+		ConvertedB8G8R8A8,
+	};
+
+	// Identifies a legacy layout from the DDS_PIXELFORMAT fields. flags uses the DDPF_* bits.
+	LegacyFormat ClassifyLegacyFormat(uint32_t flags, uint32_t bitCount, uint32_t rMask, uint32_t gMask, uint32_t bMask, uint32_t aMask);
+
+	uint32_t LegacyBitsPerPixel(LegacyFormat format);
+	ConvertedLayout LegacyTargetLayout(LegacyFormat format);
+	const char* LegacyFormatName(LegacyFormat format);
+
+	// Converts one row of width texels. dst receives width 32-bit texels.
+	void ConvertLegacyRow(LegacyFormat format, const uint8_t* src, uint32_t* dst, size_t width);
+
+	// Converts a whole surface, splitting rows across the shared worker pool when it is big
+	// enough to be worth it. Pitches are in bytes.
+	void ConvertLegacySurface(LegacyFormat format, const uint8_t* src, size_t srcPitch,
+							  uint8_t* dst, size_t dstPitch, size_t width, size_t height);
+
+	// Scalar reference used by the SIMD kernels for row tails and by non-x86 builds.
+	void ConvertLegacyRowScalar(LegacyFormat format, const uint8_t* src, uint32_t* dst, size_t width);
+}
@@ -24,6 +24,7 @@
 #include <memory>
 
 #include "DDSTextureLoader.h"
+#include "DDSFormatConvert.h"
 
 // fix for win 7 machines
 //#undef  _WIN32_WINNT
@@ -580,12 +581,8 @@ static DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
     {
         if (8 == ddpf.RGBBitCount)
         {
-            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x00000000))
-            {
-                return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
-            }
-
-            // No DXGI format maps to ISBITMASK(0x0f,0x00,0x00,0xf0) aka D3DFMT_A4L4
+            // D3DFMT_L8 and D3DFMT_A4L4 are expanded to grey R8G8B8A8 by ExpandLegacyData so that
+            // shaders sampling .rgb see luminance rather than a red-only texture
         }
 
         if (16 == ddpf.RGBBitCount)
@@ -594,10 +591,8 @@ static DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
             {
                 return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
             }
-            if (ISBITMASK(0x000000ff,0x00000000,0x00000000,0x0000ff00))
-            {
-                return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
-            }
+
+            // D3DFMT_A8L8 is expanded the same way
         }
     }
     else if (ddpf.flags & DDS_ALPHA)
@@ -703,6 +698,81 @@ static DXGI_FORMAT GetDXGIFormat( const DDS_PIXELFORMAT& ddpf )
 }
 
 
+//--------------------------------------------------------------------------------------
+// Converts the pixel data of a legacy layout with no DXGI equivalent into 32bpp texels.
+// The mip chain and array layout are unchanged, so FillInitData can walk the result as usual.
+//--------------------------------------------------------------------------------------
+static HRESULT ExpandLegacyData( _In_ DX::LegacyFormat legacy,
+                                 _In_ size_t width,
+                                 _In_ size_t height,
+                                 _In_ size_t depth,
+                                 _In_ size_t mipCount,
+                                 _In_ size_t arraySize,
+                                 _In_ size_t bitSize,
+                                 _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                 _Out_ std::unique_ptr<uint8_t[]>& expanded,
+                                 _Out_ size_t& expandedSize )
+{
+    const size_t bpp = DX::LegacyBitsPerPixel( legacy );
+
+    // Size the destination first; this also validates that the source holds every subresource
+    size_t srcSize = 0;
+    expandedSize = 0;
+    for (size_t j = 0; j < arraySize; j++)
+    {
+        size_t w = width;
+        size_t h = height;
+        size_t d = depth;
+        for (size_t i = 0; i < mipCount; i++)
+        {
+            srcSize += ( ( w * bpp + 7 ) / 8 ) * h * d;
+            expandedSize += w * 4 * h * d;
+
+            w = std::max<size_t>( w >> 1, 1 );
+            h = std::max<size_t>( h >> 1, 1 );
+            d = std::max<size_t>( d >> 1, 1 );
+        }
+    }
+
+    if (srcSize > bitSize)
+    {
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+
+    expanded.reset( new (std::nothrow) uint8_t[ expandedSize ] );
+    if (!expanded)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    const uint8_t* pSrc = bitData;
+    uint8_t* pDest = expanded.get();
+    for (size_t j = 0; j < arraySize; j++)
+    {
+        size_t w = width;
+        size_t h = height;
+        size_t d = depth;
+        for (size_t i = 0; i < mipCount; i++)
+        {
+            size_t srcRowBytes = ( w * bpp + 7 ) / 8;
+            size_t destRowBytes = w * 4;
+
+            // Volume slices are just more rows as far as the conversion is concerned
+            DX::ConvertLegacySurface( legacy, pSrc, srcRowBytes, pDest, destRowBytes, w, h * d );
+
+            pSrc += srcRowBytes * h * d;
+            pDest += destRowBytes * h * d;
+
+            w = std::max<size_t>( w >> 1, 1 );
+            h = std::max<size_t>( h >> 1, 1 );
+            d = std::max<size_t>( d >> 1, 1 );
+        }
+    }
+
+    return S_OK;
+}
+
+
 //--------------------------------------------------------------------------------------
 static HRESULT FillInitData( _In_ size_t width,
                              _In_ size_t height,
@@ -1045,6 +1115,7 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     uint32_t resDim = D3D11_RESOURCE_DIMENSION_UNKNOWN;
     size_t arraySize = 1;
     DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    DX::LegacyFormat legacy = DX::LegacyUnknown;
     bool isCubeMap = false;
 
     size_t mipCount = header->mipMapCount;
@@ -1115,7 +1186,15 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
 
         if (format == DXGI_FORMAT_UNKNOWN)
         {
-           return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+            // Legacy Direct3D 9 layouts without a DXGI format are expanded to 32bpp after the bounds checks
+            const DDS_PIXELFORMAT& ddpf = header->ddspf;
+            legacy = DX::ClassifyLegacyFormat( ddpf.flags, ddpf.RGBBitCount, ddpf.RBitMask, ddpf.GBitMask, ddpf.BBitMask, ddpf.ABitMask );
+            if (legacy == DX::LegacyUnknown)
+            {
+                return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+            }
+
+            format = (DX::LegacyTargetLayout( legacy ) == DX::ConvertedB8G8R8A8) ? DXGI_FORMAT_B8G8R8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
         }
 
         if (header->flags & DDS_HEADER_FLAGS_VOLUME)
@@ -1191,6 +1270,20 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
             break;
     }
 
+    std::unique_ptr<uint8_t[]> expandedData;
+    if (legacy != DX::LegacyUnknown)
+    {
+        size_t expandedSize = 0;
+        hr = ExpandLegacyData( legacy, width, height, depth, mipCount, arraySize, bitSize, bitData, expandedData, expandedSize );
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        bitData = expandedData.get();
+        bitSize = expandedSize;
+    }
+
     // Create the texture
     std::unique_ptr<D3D11_SUBRESOURCE_DATA> initData( new D3D11_SUBRESOURCE_DATA[ mipCount * arraySize ] );
     if ( !initData )
@@ -0,0 +1,361 @@
+#include "FrustumCulling.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Below this many boxes the list is culled on the calling thread.
+	const size_t ParallelThreshold = 64 * 1024;
+	const size_t ParallelGrain = 16 * 1024;
+
+	bool BoxVisible(const Frustum& frustum, float cx, float cy, float cz, float ex, float ey, float ez)
+	{
+		for (int i = 0; i < Frustum::PlaneCount; ++i)
+		{
+			const float* plane = frustum.planes[i];
+			float distance = plane[0] * cx + plane[1] * cy + plane[2] * cz + plane[3];
+			float reach = fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez;
+			if (distance + reach < 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
+
+MeshBounds DX::ComputeMeshBounds(const float* positions, size_t count, size_t stride)
+{
+	MeshBounds bounds;
+	memset(&bounds, 0, sizeof(bounds));
+	if (count == 0)
+		return bounds;
+
+	const uint8_t* vertex = reinterpret_cast<const uint8_t*>(positions);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bounds.min[axis] = bounds.max[axis] = positions[axis];
+	}
+	for (size_t i = 1; i < count; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(vertex + i * stride);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			bounds.min[axis] = p[axis] < bounds.min[axis] ? p[axis] : bounds.min[axis];
+			bounds.max[axis] = p[axis] > bounds.max[axis] ? p[axis] : bounds.max[axis];
+		}
+	}
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bounds.center[axis] = 0.5f * (bounds.min[axis] + bounds.max[axis]);
+		bounds.extents[axis] = 0.5f * (bounds.max[axis] - bounds.min[axis]);
+	}
+
+	float radiusSq = 0.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float* p = reinterpret_cast<const float*>(vertex + i * stride);
+		float dx = p[0] - bounds.center[0];
+		float dy = p[1] - bounds.center[1];
+		float dz = p[2] - bounds.center[2];
+		float distanceSq = dx * dx + dy * dy + dz * dz;
+		radiusSq = distanceSq > radiusSq ? distanceSq : radiusSq;
+	}
+	bounds.radius = sqrtf(radiusSq);
+	return bounds;
+}
+
+MeshBounds DX::TransformBounds(const MeshBounds& box, const float matrix[16])
+{
+	// The new center is the transformed center; each new extent sums the old extents scaled by
+	// the absolute matrix entries, which is the tightest box around the transformed box.
+	MeshBounds result;
+	float scale = 0.0f;
+	for (int column = 0; column < 3; ++column)
+	{
+		result.center[column] = matrix[12 + column];
+		result.extents[column] = 0.0f;
+		for (int row = 0; row < 3; ++row)
+		{
+			float m = matrix[row * 4 + column];
+			result.center[column] += box.center[row] * m;
+			result.extents[column] += box.extents[row] * fabsf(m);
+		}
+		result.min[column] = result.center[column] - result.extents[column];
+		result.max[column] = result.center[column] + result.extents[column];
+	}
+	for (int row = 0; row < 3; ++row)
+	{
+		const float* axis = matrix + row * 4;
+		float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		scale = length > scale ? length : scale;
+	}
+	result.radius = box.radius * scale;
+	return result;
+}
+
+MeshBounds DX::MergeBounds(const MeshBounds& a, const MeshBounds& b)
+{
+	MeshBounds result;
+	float radiusSq = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		result.min[axis] = a.min[axis] < b.min[axis] ? a.min[axis] : b.min[axis];
+		result.max[axis] = a.max[axis] > b.max[axis] ? a.max[axis] : b.max[axis];
+		result.center[axis] = 0.5f * (result.min[axis] + result.max[axis]);
+		result.extents[axis] = 0.5f * (result.max[axis] - result.min[axis]);
+		radiusSq += result.extents[axis] * result.extents[axis];
+	}
+	result.radius = sqrtf(radiusSq);
+	return result;
+}
+
+Frustum DX::ExtractFrustum(const float m[16])
+{
+	// With row vectors, clip = p * M, so each clip coordinate is p dotted with a column of M.
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w give the six planes.
+	const float column[4][4] =
+	{
+		{ m[0], m[4], m[8],  m[12] },
+		{ m[1], m[5], m[9],  m[13] },
+		{ m[2], m[6], m[10], m[14] },
+		{ m[3], m[7], m[11], m[15] },
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < 4; ++i)
+	{
+		frustum.planes[Frustum::Left][i] = column[3][i] + column[0][i];
+		frustum.planes[Frustum::Right][i] = column[3][i] - column[0][i];
+		frustum.planes[Frustum::Bottom][i] = column[3][i] + column[1][i];
+		frustum.planes[Frustum::Top][i] = column[3][i] - column[1][i];
+		frustum.planes[Frustum::Near][i] = column[2][i];
+		frustum.planes[Frustum::Far][i] = column[3][i] - column[2][i];
+	}
+
+	for (float* plane : frustum.planes)
+	{
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				plane[i] /= length;
+			}
+		}
+	}
+	return frustum;
+}
+
+void BoxList::Reserve(size_t count)
+{
+	for (std::vector<float>* list : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		list->reserve(count);
+	}
+}
+
+void BoxList::Clear(void)
+{
+	for (std::vector<float>* list : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		list->clear();
+	}
+}
+
+uint32_t BoxList::Add(const float center[3], const float extents[3])
+{
+	m_centerX.push_back(center[0]);
+	m_centerY.push_back(center[1]);
+	m_centerZ.push_back(center[2]);
+	m_extentX.push_back(extents[0]);
+	m_extentY.push_back(extents[1]);
+	m_extentZ.push_back(extents[2]);
+	return static_cast<uint32_t>(m_centerX.size() - 1);
+}
+
+void BoxList::Set(uint32_t index, const float center[3], const float extents[3])
+{
+	m_centerX[index] = center[0];
+	m_centerY[index] = center[1];
+	m_centerZ[index] = center[2];
+	m_extentX[index] = extents[0];
+	m_extentY[index] = extents[1];
+	m_extentZ[index] = extents[2];
+}
+
+void BoxList::Resize(size_t count)
+{
+	for (std::vector<float>* list : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		list->resize(count, 0.0f);
+	}
+}
+
+size_t DX::CullBoxesScalar(const Frustum& frustum, const BoxList& boxes, size_t begin, size_t end, uint32_t* visible)
+{
+	const float* cx = boxes.CenterX();
+	const float* cy = boxes.CenterY();
+	const float* cz = boxes.CenterZ();
+	const float* ex = boxes.ExtentX();
+	const float* ey = boxes.ExtentY();
+	const float* ez = boxes.ExtentZ();
+
+	size_t count = 0;
+	for (size_t i = begin; i < end; ++i)
+	{
+		visible[count] = static_cast<uint32_t>(i);
+		count += BoxVisible(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+	}
+	return count;
+}
+
+size_t DX::CullBoxes(const Frustum& frustum, const BoxList& boxes, size_t begin, size_t end, uint32_t* visible)
+{
+	size_t i = begin;
+	size_t count = 0;
+
+#if DX_SIMD_AVX2 || DX_SIMD_SSE2
+	const float* cx = boxes.CenterX();
+	const float* cy = boxes.CenterY();
+	const float* cz = boxes.CenterZ();
+	const float* ex = boxes.ExtentX();
+	const float* ey = boxes.ExtentY();
+	const float* ez = boxes.ExtentZ();
+#endif
+
+#if DX_SIMD_AVX2
+	{
+		__m256 nx[Frustum::PlaneCount], ny[Frustum::PlaneCount], nz[Frustum::PlaneCount], nw[Frustum::PlaneCount];
+		__m256 ax[Frustum::PlaneCount], ay[Frustum::PlaneCount], az[Frustum::PlaneCount];
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			nx[p] = _mm256_set1_ps(frustum.planes[p][0]);
+			ny[p] = _mm256_set1_ps(frustum.planes[p][1]);
+			nz[p] = _mm256_set1_ps(frustum.planes[p][2]);
+			nw[p] = _mm256_set1_ps(frustum.planes[p][3]);
+			ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+			ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+			az[p] = _mm256_andnot_ps(signMask, nz[p]);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(cx + i);
+			__m256 y = _mm256_loadu_ps(cy + i);
+			__m256 z = _mm256_loadu_ps(cz + i);
+			__m256 hx = _mm256_loadu_ps(ex + i);
+			__m256 hy = _mm256_loadu_ps(ey + i);
+			__m256 hz = _mm256_loadu_ps(ez + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < Frustum::PlaneCount; ++p)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)),
+												_mm256_add_ps(_mm256_mul_ps(nz[p], z), nw[p]));
+				__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], hx), _mm256_mul_ps(ay[p], hy)),
+											 _mm256_mul_ps(az[p], hz));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+			}
+
+			// Branch-free compaction: every lane writes its index, only visible lanes advance.
+			unsigned int bits = static_cast<unsigned int>(_mm256_movemask_ps(inside));
+			for (unsigned int lane = 0; lane < 8; ++lane)
+			{
+				visible[count] = static_cast<uint32_t>(i + lane);
+				count += (bits >> lane) & 1;
+			}
+		}
+	}
+#elif DX_SIMD_SSE2
+	{
+		__m128 nx[Frustum::PlaneCount], ny[Frustum::PlaneCount], nz[Frustum::PlaneCount], nw[Frustum::PlaneCount];
+		__m128 ax[Frustum::PlaneCount], ay[Frustum::PlaneCount], az[Frustum::PlaneCount];
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (int p = 0; p < Frustum::PlaneCount; ++p)
+		{
+			nx[p] = _mm_set1_ps(frustum.planes[p][0]);
+			ny[p] = _mm_set1_ps(frustum.planes[p][1]);
+			nz[p] = _mm_set1_ps(frustum.planes[p][2]);
+			nw[p] = _mm_set1_ps(frustum.planes[p][3]);
+			ax[p] = _mm_andnot_ps(signMask, nx[p]);
+			ay[p] = _mm_andnot_ps(signMask, ny[p]);
+			az[p] = _mm_andnot_ps(signMask, nz[p]);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(cx + i);
+			__m128 y = _mm_loadu_ps(cy + i);
+			__m128 z = _mm_loadu_ps(cz + i);
+			__m128 hx = _mm_loadu_ps(ex + i);
+			__m128 hy = _mm_loadu_ps(ey + i);
+			__m128 hz = _mm_loadu_ps(ez + i);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < Frustum::PlaneCount; ++p)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+											 _mm_add_ps(_mm_mul_ps(nz[p], z), nw[p]));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], hx), _mm_mul_ps(ay[p], hy)),
+										  _mm_mul_ps(az[p], hz));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+			}
+
+			unsigned int bits = static_cast<unsigned int>(_mm_movemask_ps(inside));
+			for (unsigned int lane = 0; lane < 4; ++lane)
+			{
+				visible[count] = static_cast<uint32_t>(i + lane);
+				count += (bits >> lane) & 1;
+			}
+		}
+	}
+#endif
+
+	return count + CullBoxesScalar(frustum, boxes, i, end, visible + count);
+}
+
+CullStats DX::CullBoxList(const Frustum& frustum, const BoxList& boxes, std::vector<uint32_t>& visible)
+{
+	size_t total = boxes.Size();
+	visible.resize(total);
+
+	size_t count = 0;
+	if (total < ParallelThreshold)
+	{
+		count = CullBoxes(frustum, boxes, 0, total, visible.data());
+	}
+	else
+	{
+		// Each chunk writes its survivors at the start of its own range; the ranges are then
+		// packed together in order.
+		size_t chunks = (total + ParallelGrain - 1) / ParallelGrain;
+		std::vector<size_t> chunkCounts(chunks);
+		WorkerPool::Shared().ParallelFor(total, ParallelGrain, [&](size_t begin, size_t end)
+		{
+			chunkCounts[begin / ParallelGrain] = CullBoxes(frustum, boxes, begin, end, visible.data() + begin);
+		});
+		for (size_t chunk = 0; chunk < chunks; ++chunk)
+		{
+			const uint32_t* source = visible.data() + chunk * ParallelGrain;
+			if (source != visible.data() + count)
+			{
+				memmove(visible.data() + count, source, chunkCounts[chunk] * sizeof(uint32_t));
+			}
+			count += chunkCounts[chunk];
+		}
+	}
+	visible.resize(count);
+
+	CullStats stats;
+	stats.tested = static_cast<uint32_t>(total);
+	stats.visible = static_cast<uint32_t>(count);
+	stats.culled = static_cast<uint32_t>(total - count);
+	return stats;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Load-time mesh bounds and a view-frustum test over many axis-aligned boxes at once.
+// Boxes are kept as structure-of-arrays so the test runs on four (SSE2) or eight (AVX2)
+// boxes per iteration. Matrices follow the DirectXMath layout: row-major, row vectors,
+// and a clip-space depth range of [0, w].
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct MeshBounds
+	{
+		float min[3];
+		float max[3];
+		float center[3];    // Center of the box.
+		float extents[3];   // Half size of the box.
+		float radius;       // Sphere around center that holds every vertex.
+	};
+
+	// positions points at the first float3 position; stride is the distance between vertices in bytes.
+	// An empty mesh gets an empty box at the origin.
+	MeshBounds ComputeMeshBounds(const float* positions, size_t count, size_t stride);
+
+	// Bounds of box after transforming it by a row-major, row-vector matrix.
+	MeshBounds TransformBounds(const MeshBounds& box, const float matrix[16]);
+
+	// Box around both inputs; the sphere is the one around that box.
+	MeshBounds MergeBounds(const MeshBounds& a, const MeshBounds& b);
+
+	// Planes point inwards and are normalized: a point p is inside when dot(n, p) + d >= 0 for all six.
+	struct Frustum
+	{
+		enum { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+		float planes[PlaneCount][4];
+	};
+
+	// Extracts the planes of a row-major, row-vector view-projection (or world-view-projection) matrix.
+	Frustum ExtractFrustum(const float viewProjection[16]);
+
+	// Axis-aligned boxes as separate center and extent arrays.
+	class BoxList
+	{
+	public:
+		void Reserve(size_t count);
+		void Clear(void);
+		uint32_t Add(const float center[3], const float extents[3]);
+		uint32_t Add(const MeshBounds& bounds) { return Add(bounds.center, bounds.extents); }
+		void Set(uint32_t index, const float center[3], const float extents[3]);
+		// Drops boxes past count; new boxes are empty at the origin.
+		void Resize(size_t count);
+		size_t Size(void) const { return m_centerX.size(); }
+
+		const float* CenterX(void) const { return m_centerX.data(); }
+		const float* CenterY(void) const { return m_centerY.data(); }
+		const float* CenterZ(void) const { return m_centerZ.data(); }
+		const float* ExtentX(void) const { return m_extentX.data(); }
+		const float* ExtentY(void) const { return m_extentY.data(); }
+		const float* ExtentZ(void) const { return m_extentZ.data(); }
+
+		// Writable views for code that fills many boxes at once.
+		float* CenterX(void) { return m_centerX.data(); }
+		float* CenterY(void) { return m_centerY.data(); }
+		float* CenterZ(void) { return m_centerZ.data(); }
+		float* ExtentX(void) { return m_extentX.data(); }
+		float* ExtentY(void) { return m_extentY.data(); }
+		float* ExtentZ(void) { return m_extentZ.data(); }
+
+	private:
+		std::vector<float> m_centerX, m_centerY, m_centerZ;
+		std::vector<float> m_extentX, m_extentY, m_extentZ;
+	};
+
+	struct CullStats
+	{
+		uint32_t tested = 0;
+		uint32_t visible = 0;
+		uint32_t culled = 0;	// Outside the frustum.
+		uint32_t occluded = 0;	// Inside the frustum but hidden behind occluders.
+	};
+
+	// Writes the indices of the boxes in [begin, end) that intersect the frustum to visible, in order,
+	// and returns how many there were. Boxes that straddle a plane count as visible.
+	size_t CullBoxes(const Frustum& frustum, const BoxList& boxes, size_t begin, size_t end, uint32_t* visible);
+	size_t CullBoxesScalar(const Frustum& frustum, const BoxList& boxes, size_t begin, size_t end, uint32_t* visible);
+
+	// Culls every box, splitting large lists across the shared worker pool. visible is resized to
+	// the number of visible boxes.
+	CullStats CullBoxList(const Frustum& frustum, const BoxList& boxes, std::vector<uint32_t>& visible);
+}
@@ -0,0 +1,191 @@
+#include "InstanceSet.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+
+using namespace DX;
+
+namespace
+{
+	// Below this many visible instances the data is written on the calling thread.
+	const size_t ParallelThreshold = 64 * 1024;
+	const size_t ParallelGrain = 16 * 1024;
+
+	InstanceData MakeInstance(const float world[16])
+	{
+		InstanceData instance;
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				instance.columns[column][row] = world[row * 4 + column];
+			}
+		}
+		return instance;
+	}
+
+	void ToMatrix(const InstanceData& instance, float world[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				world[row * 4 + column] = instance.columns[column][row];
+			}
+			world[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+		}
+	}
+
+	void CopyInstances(const InstanceData* instances, const uint32_t* indices, size_t count, InstanceData* out)
+	{
+#if DX_SIMD_SSE2
+		// Streaming stores skip reading the destination's cache lines, which write-combined memory
+		// can't serve anyway. They need 16-byte alignment; mapped buffers always have it.
+		if ((reinterpret_cast<uintptr_t>(out) & 15) == 0)
+		{
+			float* destination = out->columns[0];
+			for (size_t i = 0; i < count; ++i, destination += 12)
+			{
+				const float* source = instances[indices[i]].columns[0];
+				_mm_stream_ps(destination, _mm_loadu_ps(source));
+				_mm_stream_ps(destination + 4, _mm_loadu_ps(source + 4));
+				_mm_stream_ps(destination + 8, _mm_loadu_ps(source + 8));
+			}
+			_mm_sfence();
+			return;
+		}
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			out[i] = instances[indices[i]];
+		}
+	}
+}
+
+void InstanceSet::SetMeshBounds(const MeshBounds& bounds)
+{
+	m_meshBounds = bounds;
+	for (uint32_t i = 0; i < m_instances.size(); ++i)
+	{
+		UpdateBox(i);
+	}
+}
+
+void InstanceSet::Reserve(size_t count)
+{
+	m_instances.reserve(count);
+	m_boxes.Reserve(count);
+	m_visible.reserve(count);
+}
+
+void InstanceSet::Clear(void)
+{
+	m_instances.clear();
+	m_boxes.Clear();
+	m_visible.clear();
+}
+
+uint32_t InstanceSet::Add(const float world[16])
+{
+	uint32_t index = static_cast<uint32_t>(m_instances.size());
+	m_instances.push_back(MakeInstance(world));
+	m_boxes.Resize(m_instances.size());
+	UpdateBox(index);
+	return index;
+}
+
+void InstanceSet::Set(uint32_t index, const float world[16])
+{
+	m_instances[index] = MakeInstance(world);
+	UpdateBox(index);
+}
+
+void InstanceSet::Remove(uint32_t index)
+{
+	uint32_t last = static_cast<uint32_t>(m_instances.size() - 1);
+	if (index != last)
+	{
+		m_instances[index] = m_instances[last];
+		UpdateBox(index);
+	}
+	m_instances.pop_back();
+	m_boxes.Resize(last);
+}
+
+void InstanceSet::UpdateBox(uint32_t index)
+{
+	float world[16];
+	ToMatrix(m_instances[index], world);
+	MeshBounds box = TransformBounds(m_meshBounds, world);
+	m_boxes.Set(index, box.center, box.extents);
+}
+
+MeshBounds InstanceSet::ComputeBounds(void) const
+{
+	MeshBounds bounds = {};
+	size_t count = m_boxes.Size();
+	if (count == 0)
+		return bounds;
+
+	const float* centers[3] = { m_boxes.CenterX(), m_boxes.CenterY(), m_boxes.CenterZ() };
+	const float* extents[3] = { m_boxes.ExtentX(), m_boxes.ExtentY(), m_boxes.ExtentZ() };
+	float radiusSq = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float low = centers[axis][0] - extents[axis][0];
+		float high = centers[axis][0] + extents[axis][0];
+		size_t i = 1;
+#if DX_SIMD_SSE2
+		__m128 lows = _mm_set1_ps(low);
+		__m128 highs = _mm_set1_ps(high);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 center = _mm_loadu_ps(centers[axis] + i);
+			__m128 extent = _mm_loadu_ps(extents[axis] + i);
+			lows = _mm_min_ps(lows, _mm_sub_ps(center, extent));
+			highs = _mm_max_ps(highs, _mm_add_ps(center, extent));
+		}
+		lows = _mm_min_ps(lows, _mm_movehl_ps(lows, lows));
+		lows = _mm_min_ss(lows, _mm_shuffle_ps(lows, lows, 1));
+		highs = _mm_max_ps(highs, _mm_movehl_ps(highs, highs));
+		highs = _mm_max_ss(highs, _mm_shuffle_ps(highs, highs, 1));
+		low = _mm_cvtss_f32(lows);
+		high = _mm_cvtss_f32(highs);
+#endif
+		for (; i < count; ++i)
+		{
+			float boxLow = centers[axis][i] - extents[axis][i];
+			float boxHigh = centers[axis][i] + extents[axis][i];
+			low = boxLow < low ? boxLow : low;
+			high = boxHigh > high ? boxHigh : high;
+		}
+		bounds.min[axis] = low;
+		bounds.max[axis] = high;
+		bounds.center[axis] = 0.5f * (low + high);
+		bounds.extents[axis] = 0.5f * (high - low);
+		radiusSq += bounds.extents[axis] * bounds.extents[axis];
+	}
+	bounds.radius = sqrtf(radiusSq);
+	return bounds;
+}
+
+CullStats InstanceSet::Cull(const Frustum& frustum)
+{
+	return CullBoxList(frustum, m_boxes, m_visible);
+}
+
+void InstanceSet::WriteVisible(InstanceData* out) const
+{
+	size_t count = m_visible.size();
+	if (count < ParallelThreshold)
+	{
+		CopyInstances(m_instances.data(), m_visible.data(), count, out);
+		return;
+	}
+
+	WorkerPool::Shared().ParallelFor(count, ParallelGrain, [&](size_t begin, size_t end)
+	{
+		CopyInstances(m_instances.data(), m_visible.data() + begin, end - begin, out + begin);
+	});
+}
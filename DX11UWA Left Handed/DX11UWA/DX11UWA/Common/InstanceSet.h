@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+// Per-instance transforms for one mesh drawn with DrawIndexedInstanced. Each instance keeps a
+// world-space box next to its transform. Every frame the boxes are frustum culled with the SIMD
+// box test and the transforms of the survivors are packed into the instance vertex buffer, so
+// the GPU only sees visible instances and the count is limited by that buffer alone.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	// What the vertex shader reads per instance: the first three columns of a row-major,
+	// row-vector object-to-world matrix, so world.x = dot(float4(position, 1), columns[0]).
+	struct InstanceData
+	{
+		float columns[3][4];
+	};
+
+	class InstanceSet
+	{
+	public:
+		// Object-space bounds of the instanced mesh. Recomputes the box of every instance.
+		void SetMeshBounds(const MeshBounds& bounds);
+
+		void Reserve(size_t count);
+		void Clear(void);
+
+		// world is a row-major, row-vector affine matrix. Returns the index of the new instance.
+		uint32_t Add(const float world[16]);
+		void Set(uint32_t index, const float world[16]);
+		// Moves the last instance into the removed one's place.
+		void Remove(uint32_t index);
+		size_t Size(void) const { return m_instances.size(); }
+
+		const InstanceData& Get(uint32_t index) const { return m_instances[index]; }
+		const BoxList& GetBoxes(void) const { return m_boxes; }
+
+		// Box around every instance; an empty box at the origin when there are none.
+		MeshBounds ComputeBounds(void) const;
+
+		// Culls every instance against frustum and keeps the indices of the visible ones, in order.
+		CullStats Cull(const Frustum& frustum);
+		size_t GetVisibleCount(void) const { return m_visible.size(); }
+		const uint32_t* GetVisible(void) const { return m_visible.data(); }
+
+		// Writes the data of the visible instances to out, which must hold GetVisibleCount entries.
+		// Meant for mapped write-combined memory: out is written once, front to back.
+		void WriteVisible(InstanceData* out) const;
+
+	private:
+		void UpdateBox(uint32_t index);
+
+		MeshBounds					m_meshBounds = {};
+		std::vector<InstanceData>	m_instances;
+		BoxList						m_boxes;
+		std::vector<uint32_t>		m_visible;
+	};
+}
@@ -0,0 +1,47 @@
+#include "LightAnimation.h"
+
+using namespace DX;
+
+LightAnimation::Curve LightAnimation::AddCurve(const AnimationCurve& curve)
+{
+	m_curves.push_back(curve);
+	return static_cast<Curve>(m_curves.size() - 1);
+}
+
+LightAnimation::Track LightAnimation::AddTrack(LightStore::Light light, LightChannel channel, Curve curve, float phase, float offset)
+{
+	TrackData track = { light, channel, curve, phase, offset };
+	m_tracks.push_back(track);
+	return static_cast<Track>(m_tracks.size() - 1);
+}
+
+void LightAnimation::Clear(void)
+{
+	m_curves.clear();
+	m_tracks.clear();
+}
+
+void LightAnimation::Apply(double time, LightStore& lights) const
+{
+	const TrackData* previous = nullptr;
+	float value = 0.0f;
+	for (const TrackData& track : m_tracks)
+	{
+		if (!previous || track.curve != previous->curve || track.phase != previous->phase)
+			value = m_curves[track.curve].Evaluate(time + track.phase);
+		lights.SetChannel(track.light, track.channel, value + track.offset);
+		previous = &track;
+	}
+}
+
+float LightAnimation::GetValue(Track track, double time) const
+{
+	const TrackData& data = m_tracks[track];
+	return m_curves[data.curve].Evaluate(time + data.phase) + data.offset;
+}
+
+float LightAnimation::GetSlope(Track track, double time) const
+{
+	const TrackData& data = m_tracks[track];
+	return m_curves[data.curve].EvaluateSlope(time + data.phase);
+}
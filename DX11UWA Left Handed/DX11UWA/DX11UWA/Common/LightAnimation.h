@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "AnimationCurve.h"
+#include "LightStore.h"
+
+// Drives light parameters from animation curves. Each track plays one curve, shifted in time and
+// value, into one channel of one light; many tracks can share a curve. Apply evaluates every track
+// at a time in seconds, normally StepTimer::GetTotalSeconds, so the lights move at the same speed
+// at any frame rate, and the store only marks the lights whose values changed for upload.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class LightAnimation
+	{
+	public:
+		typedef uint32_t Curve;
+		typedef uint32_t Track;
+
+		Curve AddCurve(const AnimationCurve& curve);
+		AnimationCurve& GetCurve(Curve curve) { return m_curves[curve]; }
+
+		// The channel follows curve, phase seconds ahead of the clock, plus offset.
+		Track AddTrack(LightStore::Light light, LightChannel channel, Curve curve, float phase = 0.0f, float offset = 0.0f);
+		void Clear(void);
+		size_t GetTrackCount(void) const { return m_tracks.size(); }
+
+		// Writes every track's value at time into lights. Consecutive tracks with the same curve
+		// and phase evaluate it once.
+		void Apply(double time, LightStore& lights) const;
+
+		float GetValue(Track track, double time) const;
+		// Change of the track's channel per second at time.
+		float GetSlope(Track track, double time) const;
+
+	private:
+		struct TrackData
+		{
+			LightStore::Light light;
+			LightChannel channel;
+			Curve curve;
+			float phase;
+			float offset;
+		};
+
+		std::vector<AnimationCurve> m_curves;
+		std::vector<TrackData> m_tracks;
+	};
+}
@@ -0,0 +1,492 @@
+#include "LightGrid.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace DX;
+
+const uint32_t LightGrid::MaxLights;
+const uint32_t LightGrid::DefaultTileSize;
+const uint32_t LightGrid::DefaultSlices;
+
+namespace
+{
+	// Padding lights sit this far out with no radius, so they touch no box.
+	const float Unreachable = 1e18f;
+
+	size_t RoundUp8(size_t count)
+	{
+		return (count + 7) & ~size_t(7);
+	}
+
+#if !DX_SIMD_SSE2
+	// Squared distance from a point to a box; zero inside.
+	float BoxDistanceSquared(const float min[3], const float max[3], float x, float y, float z)
+	{
+		float dx = std::max(std::max(min[0] - x, x - max[0]), 0.0f);
+		float dy = std::max(std::max(min[1] - y, y - max[1]), 0.0f);
+		float dz = std::max(std::max(min[2] - z, z - max[2]), 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Whether a cone of the given range can reach the sphere, after "Cull that cone!" (Wronski):
+	// the sphere is outside when it is past the cone's side, beyond its range or behind its apex.
+	// A zero axis with cos -1 and sin 0 passes every sphere, so point lights need no branch.
+	bool ConeReaches(const float sphere[4], float x, float y, float z, float range,
+					 float axisX, float axisY, float axisZ, float cosAngle, float sinAngle)
+	{
+		float vx = sphere[0] - x;
+		float vy = sphere[1] - y;
+		float vz = sphere[2] - z;
+		float lengthSquared = vx * vx + vy * vy + vz * vz;
+		float along = vx * axisX + vy * axisY + vz * axisZ;
+		float side = cosAngle * sqrtf(std::max(lengthSquared - along * along, 0.0f)) - along * sinAngle;
+		return !(side > sphere[3]) && !(along > sphere[3] + range) && !(along < -sphere[3]);
+	}
+#endif
+
+	void ClearBox(float min[3], float max[3])
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = 1e30f;
+			max[axis] = -1e30f;
+		}
+	}
+
+	void GrowBox(float min[3], float max[3], const float point[3])
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = std::min(min[axis], point[axis]);
+			max[axis] = std::max(max[axis], point[axis]);
+		}
+	}
+}
+
+void LightGrid::LightList::Reserve(size_t capacity)
+{
+	capacity = RoundUp8(capacity);
+	if (index.size() < capacity)
+	{
+		for (std::vector<float>& field : fields)
+		{
+			field.resize(capacity);
+		}
+		index.resize(capacity);
+	}
+}
+
+void LightGrid::LightList::Pad(void)
+{
+	for (size_t i = count; i < RoundUp8(count); ++i)
+	{
+		fields[FieldX][i] = Unreachable;
+		fields[FieldY][i] = Unreachable;
+		fields[FieldZ][i] = Unreachable;
+		fields[FieldRadius][i] = 0.0f;
+		fields[FieldAxisX][i] = 0.0f;
+		fields[FieldAxisY][i] = 0.0f;
+		fields[FieldAxisZ][i] = 0.0f;
+		fields[FieldCos][i] = -1.0f;
+		fields[FieldSin][i] = 0.0f;
+		index[i] = 0;
+	}
+}
+
+LightGrid::LightGrid() :
+	m_indexCount(0)
+{
+	memset(&m_constants, 0, sizeof(m_constants));
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_lights.count = 0;
+}
+
+void LightGrid::SetProjection(const float projection[16], uint32_t width, uint32_t height, float nearZ, float farZ,
+							  uint32_t tileSize, uint32_t slices)
+{
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	tileSize = std::max(tileSize, 1u);
+	slices = std::max(slices, 1u);
+	uint32_t tilesX = (width + tileSize - 1) / tileSize;
+	uint32_t tilesY = (height + tileSize - 1) / tileSize;
+
+	float depthRange = log2f(farZ / nearZ);
+	m_constants.tilesX = tilesX;
+	m_constants.tilesY = tilesY;
+	m_constants.slices = slices;
+	m_constants.tileSize = tileSize;
+	m_constants.sliceScale = float(slices) / depthRange;
+	m_constants.sliceBias = -float(slices) * log2f(nearZ) / depthRange;
+
+	// Rays through the tile corners, scaled to z = 1. At z = 1, clip w is the same for every x and y,
+	// so the corner's NDC fixes x and y through the projection's upper 2x2.
+	const float* p = projection;
+	float w = p[11] + p[15];
+	float determinant = p[0] * p[5] - p[4] * p[1];
+	std::vector<float> rays((tilesX + 1) * (tilesY + 1) * 2);
+	for (uint32_t y = 0; y <= tilesY; ++y)
+	{
+		for (uint32_t x = 0; x <= tilesX; ++x)
+		{
+			float ndcX = 2.0f * float(std::min(x * tileSize, width)) / float(width) - 1.0f;
+			float ndcY = 1.0f - 2.0f * float(std::min(y * tileSize, height)) / float(height);
+			float bx = ndcX * w - p[8] - p[12];
+			float by = ndcY * w - p[9] - p[13];
+			float* ray = &rays[(y * (tilesX + 1) + x) * 2];
+			ray[0] = (bx * p[5] - by * p[4]) / determinant;
+			ray[1] = (p[0] * by - p[1] * bx) / determinant;
+		}
+	}
+
+	uint32_t clusters = tilesX * tilesY * slices;
+	m_clusterBoxes.resize(clusters);
+	m_clusterSpheres.resize(clusters * 4);
+	m_rowBoxes.resize(tilesY * slices);
+	m_sliceBoxes.resize(slices);
+	for (uint32_t slice = 0; slice < slices; ++slice)
+	{
+		float z0 = nearZ * powf(farZ / nearZ, float(slice) / float(slices));
+		float z1 = nearZ * powf(farZ / nearZ, float(slice + 1) / float(slices));
+		Box& sliceBox = m_sliceBoxes[slice];
+		ClearBox(sliceBox.min, sliceBox.max);
+		for (uint32_t y = 0; y < tilesY; ++y)
+		{
+			Box& rowBox = m_rowBoxes[slice * tilesY + y];
+			ClearBox(rowBox.min, rowBox.max);
+			for (uint32_t x = 0; x < tilesX; ++x)
+			{
+				uint32_t cluster = (slice * tilesY + y) * tilesX + x;
+				Box& box = m_clusterBoxes[cluster];
+				ClearBox(box.min, box.max);
+				for (uint32_t corner = 0; corner < 4; ++corner)
+				{
+					const float* ray = &rays[((y + corner / 2) * (tilesX + 1) + x + corner % 2) * 2];
+					const float nearPoint[3] = { ray[0] * z0, ray[1] * z0, z0 };
+					const float farPoint[3] = { ray[0] * z1, ray[1] * z1, z1 };
+					GrowBox(box.min, box.max, nearPoint);
+					GrowBox(box.min, box.max, farPoint);
+				}
+
+				float* sphere = &m_clusterSpheres[cluster * 4];
+				float radiusSquared = 0.0f;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					sphere[axis] = 0.5f * (box.min[axis] + box.max[axis]);
+					float half = 0.5f * (box.max[axis] - box.min[axis]);
+					radiusSquared += half * half;
+				}
+				sphere[3] = sqrtf(radiusSquared);
+				GrowBox(rowBox.min, rowBox.max, box.min);
+				GrowBox(rowBox.min, rowBox.max, box.max);
+			}
+			GrowBox(sliceBox.min, sliceBox.max, rowBox.min);
+			GrowBox(sliceBox.min, sliceBox.max, rowBox.max);
+		}
+	}
+
+	m_clusterRanges.assign(size_t(clusters) * 2, 0);
+	m_work.resize(slices);
+	m_indexCount = 0;
+}
+
+void LightGrid::Build(const float view[16], const GridLight* lights, uint32_t count)
+{
+	count = std::min(count, MaxLights);
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.lights = count;
+	m_indexCount = 0;
+	if (m_work.empty())
+		return;
+
+	// Lights into view space. Spot cones of 90 degrees or more are tested as spheres, and lights
+	// without a range are moved out of reach like the padding.
+	m_lights.Reserve(count);
+	m_lights.count = count;
+	const float* v = view;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const GridLight& light = lights[i];
+		const float* p = light.position;
+		const float* d = light.direction;
+		bool cone = light.cosOuter > 0.0f;
+		m_lights.fields[FieldX][i] = p[0] * v[0] + p[1] * v[4] + p[2] * v[8] + v[12];
+		m_lights.fields[FieldY][i] = p[0] * v[1] + p[1] * v[5] + p[2] * v[9] + v[13];
+		m_lights.fields[FieldZ][i] = p[0] * v[2] + p[1] * v[6] + p[2] * v[10] + v[14];
+		m_lights.fields[FieldRadius][i] = std::max(light.radius, 0.0f);
+		if (!(light.radius > 0.0f))
+		{
+			m_lights.fields[FieldX][i] = Unreachable;
+			m_lights.fields[FieldY][i] = Unreachable;
+			m_lights.fields[FieldZ][i] = Unreachable;
+		}
+		m_lights.fields[FieldAxisX][i] = cone ? d[0] * v[0] + d[1] * v[4] + d[2] * v[8] : 0.0f;
+		m_lights.fields[FieldAxisY][i] = cone ? d[0] * v[1] + d[1] * v[5] + d[2] * v[9] : 0.0f;
+		m_lights.fields[FieldAxisZ][i] = cone ? d[0] * v[2] + d[1] * v[6] + d[2] * v[10] : 0.0f;
+		m_lights.fields[FieldCos][i] = cone ? light.cosOuter : -1.0f;
+		m_lights.fields[FieldSin][i] = cone ? sqrtf(std::max(1.0f - light.cosOuter * light.cosOuter, 0.0f)) : 0.0f;
+		m_lights.index[i] = static_cast<uint16_t>(i);
+	}
+	m_lights.Pad();
+
+	WorkerPool::Shared().ParallelFor(m_work.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t slice = begin; slice < end; ++slice)
+		{
+			AssignSlice(static_cast<uint32_t>(slice));
+		}
+	});
+
+	// Concatenate the slices' lists and move their ranges to match.
+	size_t total = 0;
+	for (const SliceWork& work : m_work)
+	{
+		total += work.indexCount;
+	}
+	if (m_indices.size() < total)
+	{
+		m_indices.resize(total);
+	}
+	m_seen.assign(count, 0);
+	uint32_t clustersPerSlice = m_constants.tilesX * m_constants.tilesY;
+	for (uint32_t slice = 0; slice < m_work.size(); ++slice)
+	{
+		const SliceWork& work = m_work[slice];
+		std::copy(work.indices.begin(), work.indices.begin() + work.indexCount, m_indices.begin() + m_indexCount);
+		for (size_t i = 0; i < work.indexCount; ++i)
+		{
+			m_seen[work.indices[i]] = 1;
+		}
+		uint32_t* ranges = &m_clusterRanges[size_t(slice) * clustersPerSlice * 2];
+		for (uint32_t cluster = 0; cluster < clustersPerSlice; ++cluster)
+		{
+			ranges[cluster * 2] += static_cast<uint32_t>(m_indexCount);
+			m_stats.occupiedClusters += ranges[cluster * 2 + 1] ? 1 : 0;
+			m_stats.maxClusterLights = std::max(m_stats.maxClusterLights, ranges[cluster * 2 + 1]);
+		}
+		m_indexCount += work.indexCount;
+	}
+	m_stats.visibleLights = static_cast<uint32_t>(std::count(m_seen.begin(), m_seen.end(), uint8_t(1)));
+	m_stats.indices = m_indexCount;
+}
+
+// Narrows the lights to the slice, then to each tile row, then tests each cluster of the row.
+void LightGrid::AssignSlice(uint32_t slice)
+{
+	SliceWork& work = m_work[slice];
+	work.indexCount = 0;
+	work.slice.Reserve(m_lights.count);
+	work.slice.count = 0;
+	FilterLights(m_sliceBoxes[slice], m_lights, work.slice);
+	work.slice.Pad();
+
+	uint32_t tilesX = m_constants.tilesX;
+	for (uint32_t y = 0; y < m_constants.tilesY; ++y)
+	{
+		uint32_t row = slice * m_constants.tilesY + y;
+		work.row.Reserve(work.slice.count);
+		work.row.count = 0;
+		if (work.slice.count)
+		{
+			FilterLights(m_rowBoxes[row], work.slice, work.row);
+		}
+		work.row.Pad();
+
+		for (uint32_t x = 0; x < tilesX; ++x)
+		{
+			uint32_t cluster = row * tilesX + x;
+			size_t count = 0;
+			if (work.row.count)
+			{
+				size_t needed = work.indexCount + RoundUp8(work.row.count);
+				if (work.indices.size() < needed)
+				{
+					work.indices.resize(std::max(needed, work.indices.size() * 2));
+				}
+				count = AssignCluster(m_clusterBoxes[cluster], &m_clusterSpheres[cluster * 4], work.row,
+									  work.indices.data() + work.indexCount);
+			}
+			// Offsets are relative to the slice until Build concatenates the slices.
+			m_clusterRanges[cluster * 2] = static_cast<uint32_t>(work.indexCount);
+			m_clusterRanges[cluster * 2 + 1] = static_cast<uint32_t>(count);
+			work.indexCount += count;
+		}
+	}
+}
+
+void LightGrid::FilterLights(const Box& box, const LightList& in, LightList& out)
+{
+	const float* x = in.fields[FieldX].data();
+	const float* y = in.fields[FieldY].data();
+	const float* z = in.fields[FieldZ].data();
+	const float* radius = in.fields[FieldRadius].data();
+	size_t padded = RoundUp8(in.count);
+
+	auto append = [&](size_t i)
+	{
+		for (int field = 0; field < FieldCount; ++field)
+		{
+			out.fields[field][out.count] = in.fields[field][i];
+		}
+		out.index[out.count++] = in.index[i];
+	};
+
+#if DX_SIMD_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 boxMin[3] = { _mm256_set1_ps(box.min[0]), _mm256_set1_ps(box.min[1]), _mm256_set1_ps(box.min[2]) };
+	const __m256 boxMax[3] = { _mm256_set1_ps(box.max[0]), _mm256_set1_ps(box.max[1]), _mm256_set1_ps(box.max[2]) };
+	for (size_t i = 0; i < padded; i += 8)
+	{
+		const __m256 center[3] = { _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i) };
+		__m256 distance = zero;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(boxMin[axis], center[axis]), _mm256_sub_ps(center[axis], boxMax[axis])), zero);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(d, d));
+		}
+		__m256 r = _mm256_loadu_ps(radius + i);
+		unsigned int bits = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_mul_ps(r, r), _CMP_LE_OQ)));
+		for (unsigned int lane = 0; bits; ++lane, bits >>= 1)
+		{
+			if (bits & 1)
+				append(i + lane);
+		}
+	}
+#elif DX_SIMD_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 boxMin[3] = { _mm_set1_ps(box.min[0]), _mm_set1_ps(box.min[1]), _mm_set1_ps(box.min[2]) };
+	const __m128 boxMax[3] = { _mm_set1_ps(box.max[0]), _mm_set1_ps(box.max[1]), _mm_set1_ps(box.max[2]) };
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		const __m128 center[3] = { _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i) };
+		__m128 distance = zero;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMin[axis], center[axis]), _mm_sub_ps(center[axis], boxMax[axis])), zero);
+			distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+		}
+		__m128 r = _mm_loadu_ps(radius + i);
+		unsigned int bits = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distance, _mm_mul_ps(r, r))));
+		for (unsigned int lane = 0; bits; ++lane, bits >>= 1)
+		{
+			if (bits & 1)
+				append(i + lane);
+		}
+	}
+#else
+	for (size_t i = 0; i < padded; ++i)
+	{
+		if (BoxDistanceSquared(box.min, box.max, x[i], y[i], z[i]) <= radius[i] * radius[i])
+			append(i);
+	}
+#endif
+}
+
+size_t LightGrid::AssignCluster(const Box& box, const float sphere[4], const LightList& list, uint16_t* out)
+{
+	const float* x = list.fields[FieldX].data();
+	const float* y = list.fields[FieldY].data();
+	const float* z = list.fields[FieldZ].data();
+	const float* radius = list.fields[FieldRadius].data();
+	const float* axisX = list.fields[FieldAxisX].data();
+	const float* axisY = list.fields[FieldAxisY].data();
+	const float* axisZ = list.fields[FieldAxisZ].data();
+	const float* cosAngle = list.fields[FieldCos].data();
+	const float* sinAngle = list.fields[FieldSin].data();
+	const uint16_t* index = list.index.data();
+	size_t padded = RoundUp8(list.count);
+	size_t count = 0;
+
+#if DX_SIMD_AVX2
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 boxMin[3] = { _mm256_set1_ps(box.min[0]), _mm256_set1_ps(box.min[1]), _mm256_set1_ps(box.min[2]) };
+	const __m256 boxMax[3] = { _mm256_set1_ps(box.max[0]), _mm256_set1_ps(box.max[1]), _mm256_set1_ps(box.max[2]) };
+	const __m256 sphereCenter[3] = { _mm256_set1_ps(sphere[0]), _mm256_set1_ps(sphere[1]), _mm256_set1_ps(sphere[2]) };
+	const __m256 sphereRadius = _mm256_set1_ps(sphere[3]);
+	const __m256 negativeSphereRadius = _mm256_set1_ps(-sphere[3]);
+	for (size_t i = 0; i < padded; i += 8)
+	{
+		const __m256 center[3] = { _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i) };
+		__m256 distance = zero;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(boxMin[axis], center[axis]), _mm256_sub_ps(center[axis], boxMax[axis])), zero);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(d, d));
+		}
+		__m256 r = _mm256_loadu_ps(radius + i);
+		__m256 inside = _mm256_cmp_ps(distance, _mm256_mul_ps(r, r), _CMP_LE_OQ);
+
+		__m256 vx = _mm256_sub_ps(sphereCenter[0], center[0]);
+		__m256 vy = _mm256_sub_ps(sphereCenter[1], center[1]);
+		__m256 vz = _mm256_sub_ps(sphereCenter[2], center[2]);
+		__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+		__m256 along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, _mm256_loadu_ps(axisX + i)), _mm256_mul_ps(vy, _mm256_loadu_ps(axisY + i))),
+									 _mm256_mul_ps(vz, _mm256_loadu_ps(axisZ + i)));
+		__m256 across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(lengthSquared, _mm256_mul_ps(along, along)), zero));
+		__m256 side = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(cosAngle + i), across), _mm256_mul_ps(along, _mm256_loadu_ps(sinAngle + i)));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(side, sphereRadius, _CMP_LE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_add_ps(sphereRadius, r), _CMP_LE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, negativeSphereRadius, _CMP_GE_OQ));
+
+		// Branch-free compaction: every lane writes its index, only lights that reach advance.
+		unsigned int bits = static_cast<unsigned int>(_mm256_movemask_ps(inside));
+		for (unsigned int lane = 0; lane < 8; ++lane)
+		{
+			out[count] = index[i + lane];
+			count += (bits >> lane) & 1;
+		}
+	}
+#elif DX_SIMD_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 boxMin[3] = { _mm_set1_ps(box.min[0]), _mm_set1_ps(box.min[1]), _mm_set1_ps(box.min[2]) };
+	const __m128 boxMax[3] = { _mm_set1_ps(box.max[0]), _mm_set1_ps(box.max[1]), _mm_set1_ps(box.max[2]) };
+	const __m128 sphereCenter[3] = { _mm_set1_ps(sphere[0]), _mm_set1_ps(sphere[1]), _mm_set1_ps(sphere[2]) };
+	const __m128 sphereRadius = _mm_set1_ps(sphere[3]);
+	const __m128 negativeSphereRadius = _mm_set1_ps(-sphere[3]);
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		const __m128 center[3] = { _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i) };
+		__m128 distance = zero;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMin[axis], center[axis]), _mm_sub_ps(center[axis], boxMax[axis])), zero);
+			distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+		}
+		__m128 r = _mm_loadu_ps(radius + i);
+		__m128 inside = _mm_cmple_ps(distance, _mm_mul_ps(r, r));
+
+		__m128 vx = _mm_sub_ps(sphereCenter[0], center[0]);
+		__m128 vy = _mm_sub_ps(sphereCenter[1], center[1]);
+		__m128 vz = _mm_sub_ps(sphereCenter[2], center[2]);
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(axisX + i)), _mm_mul_ps(vy, _mm_loadu_ps(axisY + i))),
+								  _mm_mul_ps(vz, _mm_loadu_ps(axisZ + i)));
+		__m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSquared, _mm_mul_ps(along, along)), zero));
+		__m128 side = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(cosAngle + i), across), _mm_mul_ps(along, _mm_loadu_ps(sinAngle + i)));
+		inside = _mm_and_ps(inside, _mm_cmple_ps(side, sphereRadius));
+		inside = _mm_and_ps(inside, _mm_cmple_ps(along, _mm_add_ps(sphereRadius, r)));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(along, negativeSphereRadius));
+
+		unsigned int bits = static_cast<unsigned int>(_mm_movemask_ps(inside));
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			out[count] = index[i + lane];
+			count += (bits >> lane) & 1;
+		}
+	}
+#else
+	for (size_t i = 0; i < padded; ++i)
+	{
+		out[count] = index[i];
+		bool inside = BoxDistanceSquared(box.min, box.max, x[i], y[i], z[i]) <= radius[i] * radius[i] &&
+					  ConeReaches(sphere, x[i], y[i], z[i], radius[i], axisX[i], axisY[i], axisZ[i], cosAngle[i], sinAngle[i]);
+		count += inside ? 1 : 0;
+	}
+#endif
+
+	return count;
+}
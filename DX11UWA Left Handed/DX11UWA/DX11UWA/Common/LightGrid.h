@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// CPU light assignment for clustered forward shading. The view frustum is cut into screen tiles
+// and exponentially spaced depth slices; every frame Build transforms the lights into view space
+// and finds the clusters each one can reach, testing light spheres against cluster boxes and
+// spot cones against cluster spheres, eight lights at a time with AVX2, four with SSE2. The
+// slices are assigned in parallel on the shared worker pool, each narrowing its candidates per
+// slice and per tile row before testing single clusters. The result is one offset and count per
+// cluster into a compact list of 16-bit light indices, ready to upload as shader buffers.
+// Matrices follow the DirectXMath layout: row-major, row vectors.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct GridLight
+	{
+		float position[3];		// World space.
+		float radius;			// Range; nothing past it is lit, and nothing at all without one.
+		float direction[3];		// Spot axis, unit length. Zero for point lights.
+		float cosOuter;			// Cosine of the spot cone's outer half angle; -1 for point lights.
+	};
+
+	// What the pixel shaders need to find their cluster: cluster = (slice * tilesY + tileY) * tilesX
+	// + tileX, with tile = pixel / tileSize and slice = floor(log2(view z) * sliceScale + sliceBias).
+	struct LightGridConstants
+	{
+		uint32_t tilesX;
+		uint32_t tilesY;
+		uint32_t slices;
+		uint32_t tileSize;
+		float sliceScale;
+		float sliceBias;
+		float padding[2];
+	};
+
+	struct LightGridStats
+	{
+		uint32_t lights;				// Passed to Build.
+		uint32_t visibleLights;			// In at least one cluster.
+		uint32_t occupiedClusters;
+		uint32_t maxClusterLights;
+		size_t indices;
+	};
+
+	class LightGrid
+	{
+	public:
+		static const uint32_t MaxLights = 65535;
+		static const uint32_t DefaultTileSize = 64;
+		static const uint32_t DefaultSlices = 24;
+
+		LightGrid();
+
+		// Lays out the clusters for a perspective projection whose w is view-space z, as
+		// XMMatrixPerspectiveFovLH makes, optionally followed by a rotation of x and y (the display
+		// orientation). width and height are the render target's size in pixels.
+		void SetProjection(const float projection[16], uint32_t width, uint32_t height, float nearZ, float farZ,
+						   uint32_t tileSize = DefaultTileSize, uint32_t slices = DefaultSlices);
+
+		// Assigns count lights, at most MaxLights, to the clusters. Indices in the list refer to
+		// positions in lights; each cluster's are in increasing order.
+		void Build(const float view[16], const GridLight* lights, uint32_t count);
+
+		const LightGridConstants& GetConstants(void) const { return m_constants; }
+		uint32_t GetClusterCount(void) const { return static_cast<uint32_t>(m_clusterRanges.size() / 2); }
+		// Offset and count per cluster.
+		const uint32_t* GetClusterRanges(void) const { return m_clusterRanges.data(); }
+		const uint16_t* GetLightIndices(void) const { return m_indices.data(); }
+		size_t GetLightIndexCount(void) const { return m_indexCount; }
+		const LightGridStats& GetStats(void) const { return m_stats; }
+
+	private:
+		// Lights in view space as arrays per field, padded with unreachable lights to a multiple
+		// of eight so the SIMD loops need no tails.
+		enum Field
+		{
+			FieldX = 0, FieldY, FieldZ,
+			FieldRadius,
+			FieldAxisX, FieldAxisY, FieldAxisZ,
+			FieldCos, FieldSin,
+			FieldCount
+		};
+
+		struct LightList
+		{
+			std::vector<float> fields[FieldCount];
+			std::vector<uint16_t> index;
+			size_t count;
+
+			void Reserve(size_t capacity);
+			void Pad(void);
+		};
+
+		struct Box
+		{
+			float min[3];
+			float max[3];
+		};
+
+		// Scratch and output of one slice; each is only touched by the worker assigning it.
+		struct SliceWork
+		{
+			LightList slice;
+			LightList row;
+			std::vector<uint16_t> indices;
+			size_t indexCount;
+		};
+
+		void AssignSlice(uint32_t slice);
+		// Appends the lights of in whose spheres touch box to out, which must hold in.count more.
+		static void FilterLights(const Box& box, const LightList& in, LightList& out);
+		// Writes the indices of the lights of list that can reach the cluster to out, which must have
+		// room for list.count rounded up to eight, and returns how many there are.
+		static size_t AssignCluster(const Box& box, const float sphere[4], const LightList& list, uint16_t* out);
+
+		LightGridConstants m_constants;
+		std::vector<Box> m_clusterBoxes;
+		std::vector<float> m_clusterSpheres;	// Center and radius per cluster.
+		std::vector<Box> m_rowBoxes;			// Per slice and tile row.
+		std::vector<Box> m_sliceBoxes;
+
+		LightList m_lights;
+		std::vector<SliceWork> m_work;
+		std::vector<uint32_t> m_clusterRanges;
+		std::vector<uint16_t> m_indices;
+		size_t m_indexCount;
+		std::vector<uint8_t> m_seen;
+		LightGridStats m_stats;
+	};
+}
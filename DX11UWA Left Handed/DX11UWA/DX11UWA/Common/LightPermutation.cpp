@@ -0,0 +1,77 @@
+#include "LightPermutation.h"
+
+using namespace DX;
+
+const uint32_t LightPermutationTable::NoVariant;
+
+namespace
+{
+	const char* const Defines[LightPermutationBits] =
+	{
+		"LIGHT_ALPHA_TEST", "LIGHT_TEXTURE", "LIGHT_DIRECTIONAL", "LIGHT_POINT", "LIGHT_SPOT",
+	};
+
+	const uint32_t Textured = PermutationTexture;
+	const uint32_t AllLights = LightPermutationLights;
+	const uint32_t NoSpots = PermutationDirectional | PermutationPointLights;
+
+	static_assert(MakeLightPermutation(true, false, AllLights) == AllLights, "the alpha test needs a texture");
+	static_assert(CoversLightPermutation(LightPermutationAll, MakeLightPermutation(false, true, PermutationSpotLights)),
+				  "the general variant covers every textured key");
+	static_assert(!CoversLightPermutation(LightPermutationAll, AllLights), "an untextured key needs an untextured variant");
+	static_assert(LightPermutationCost(Textured | NoSpots) < LightPermutationCost(Textured | AllLights), "leaving out spot lights is cheaper");
+}
+
+const LightVariant DX::LightVariants[LightVariantCount] =
+{
+	{ "LightPixelShader", LightPermutationAll },
+	{ "LightPixelShaderOpaque", Textured | AllLights },
+	{ "LightPixelShaderPoint", PermutationAlphaTest | Textured | NoSpots },
+	{ "LightPixelShaderPointOpaque", Textured | NoSpots },
+	{ "LightPixelShaderDirectional", PermutationAlphaTest | Textured | PermutationDirectional },
+	{ "LightPixelShaderDirectionalOpaque", Textured | PermutationDirectional },
+	{ "LightPixelShaderUntextured", AllLights },
+};
+
+const char* DX::GetLightPermutationDefine(uint32_t feature)
+{
+	for (uint32_t bit = 0; bit < LightPermutationBits; ++bit)
+	{
+		if (feature == 1u << bit)
+			return Defines[bit];
+	}
+	return nullptr;
+}
+
+uint32_t DX::FindGridLightTypes(const uint16_t* indices, size_t count, uint32_t firstSpot)
+{
+	uint32_t types = 0;
+	for (size_t i = 0; i < count && types != (PermutationPointLights | PermutationSpotLights); ++i)
+	{
+		types |= indices[i] < firstSpot ? PermutationPointLights : PermutationSpotLights;
+	}
+	return types;
+}
+
+LightPermutationTable::LightPermutationTable()
+{
+	for (uint32_t& variant : m_lookup)
+	{
+		variant = NoVariant;
+	}
+}
+
+void LightPermutationTable::Build(const bool available[LightVariantCount])
+{
+	for (uint32_t key = 0; key < LightPermutationCount; ++key)
+	{
+		m_lookup[key] = NoVariant;
+		for (uint32_t i = 0; i < LightVariantCount; ++i)
+		{
+			if (!available[i] || !CoversLightPermutation(LightVariants[i].key, key))
+				continue;
+			if (m_lookup[key] == NoVariant || LightPermutationCost(LightVariants[i].key) < LightPermutationCost(LightVariants[m_lookup[key]].key))
+				m_lookup[key] = i;
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compile-time specializations of LightPixelShader. Each feature the shader can leave out is one
+// bit of a permutation key and one define of the HLSL, 0 or 1; a variant is a wrapper file that
+// defines the features it leaves out to 0 and includes LightPixelShader.hlsl, which on its own is
+// the variant with everything. Only the variants in LightVariants are compiled. Every frame the
+// renderer works out the key each lit draw needs, from its material and the light types in the
+// light grid, and the table maps it to the cheapest compiled variant that draws it correctly.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum LightPermutationFeature : uint32_t
+	{
+		PermutationAlphaTest = 1 << 0,		// LIGHT_ALPHA_TEST: discards texels below the cutoff.
+		PermutationTexture = 1 << 1,		// LIGHT_TEXTURE: samples the material, else the base color is white.
+		PermutationDirectional = 1 << 2,	// LIGHT_DIRECTIONAL: the directional light of LightProperties.
+		PermutationPointLights = 1 << 3,	// LIGHT_POINT: point lights in the cluster lists.
+		PermutationSpotLights = 1 << 4,		// LIGHT_SPOT: spot lights in the cluster lists.
+	};
+
+	const uint32_t LightPermutationBits = 5;
+	const uint32_t LightPermutationCount = 1 << LightPermutationBits;
+	const uint32_t LightPermutationAll = LightPermutationCount - 1;
+	const uint32_t LightPermutationLights = PermutationDirectional | PermutationPointLights | PermutationSpotLights;
+
+	// lights holds the light bits. An alpha test needs a texture to test, so it's dropped without one.
+	constexpr uint32_t MakeLightPermutation(bool alphaTest, bool texture, uint32_t lights)
+	{
+		return (alphaTest && texture ? uint32_t(PermutationAlphaTest) : 0) | (texture ? uint32_t(PermutationTexture) : 0) | (lights & LightPermutationLights);
+	}
+
+	// Whether variant draws what key needs: the same texture bit, and at least key's other features.
+	// A feature the pixel doesn't need costs time but changes nothing: the alpha test never fires on
+	// an opaque material, a disabled directional light adds zero and absent lights aren't in the lists.
+	constexpr bool CoversLightPermutation(uint32_t variant, uint32_t key)
+	{
+		return ((variant ^ key) & PermutationTexture) == 0 && (key & ~variant & LightPermutationAll) == 0;
+	}
+
+	// Rough per-pixel cost, for choosing between the variants that cover a key. The alpha test
+	// weighs most, as its discard turns off early depth testing; a cluster loop over both local
+	// light types also pays for the branch between them.
+	constexpr uint32_t LightPermutationCost(uint32_t key)
+	{
+		return ((key & PermutationAlphaTest) ? 8 : 0) + ((key & PermutationTexture) ? 2 : 0) + ((key & PermutationDirectional) ? 1 : 0) +
+			   ((key & PermutationPointLights) ? 3 : 0) + ((key & PermutationSpotLights) ? 4 : 0) +
+			   ((key & PermutationPointLights) && (key & PermutationSpotLights) ? 2 : 0);
+	}
+
+	// The HLSL define of one feature bit, e.g. "LIGHT_SPOT"; null if feature isn't a single bit.
+	const char* GetLightPermutationDefine(uint32_t feature);
+
+	// The light bits of the local lights a light grid lists. Lights are in packed order, so index
+	// firstSpot and the ones after it are spot lights. Stops as soon as both types have been seen.
+	uint32_t FindGridLightTypes(const uint16_t* indices, size_t count, uint32_t firstSpot);
+
+	struct LightVariant
+	{
+		const char* name;	// Content\<name>.hlsl, compiled to <name>.cso.
+		uint32_t key;
+	};
+
+	// The compiled variants. The first is LightPixelShader itself, which covers every textured key.
+	const uint32_t LightVariantCount = 7;
+	extern const LightVariant LightVariants[LightVariantCount];
+
+	class LightPermutationTable
+	{
+	public:
+		static const uint32_t NoVariant = 0xffffffff;
+
+		LightPermutationTable();
+
+		// available[i] tells whether LightVariants[i] can be used, e.g. whether its shader loaded.
+		void Build(const bool available[LightVariantCount]);
+		// The cheapest available variant covering key, the first in LightVariants on a tie; NoVariant if none does.
+		uint32_t Select(uint32_t key) const { return m_lookup[key & LightPermutationAll]; }
+
+	private:
+		uint32_t m_lookup[LightPermutationCount];
+	};
+}
@@ -0,0 +1,502 @@
+#include "LightStore.h"
+#include "SimdConfig.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DX;
+
+const uint32_t LightStore::MaxLightsPerType;
+
+namespace
+{
+	// One light per value, so the animation kernel below is written once and runs eight (AVX2),
+	// four (SSE2) or one light at a time.
+	struct Single
+	{
+		static const size_t Width = 1;
+		typedef bool Mask;
+		float v;
+
+		static Single Load(const float* p) { Single r = { *p }; return r; }
+		static Single Splat(float s) { Single r = { s }; return r; }
+		void Store(float* p) const { *p = v; }
+	};
+
+	inline Single operator+(Single a, Single b) { Single r = { a.v + b.v }; return r; }
+	inline Single operator-(Single a, Single b) { Single r = { a.v - b.v }; return r; }
+	inline Single operator*(Single a, Single b) { Single r = { a.v * b.v }; return r; }
+	inline bool Greater(Single a, Single b) { return a.v > b.v; }
+	inline bool GreaterEqual(Single a, Single b) { return a.v >= b.v; }
+	inline bool NotEqual(Single a, Single b) { return a.v != b.v; }
+	inline bool Any(bool mask) { return mask; }
+	inline Single Select(bool mask, Single a, Single b) { return mask ? a : b; }
+	inline Single ReciprocalLength(Single lengthSquared) { Single r = { 1.0f / sqrtf(lengthSquared.v) }; return r; }
+
+#if DX_SIMD_AVX2
+	struct Batch
+	{
+		static const size_t Width = 8;
+		struct Mask { __m256 v; };
+		__m256 v;
+
+		static Batch Load(const float* p) { Batch r = { _mm256_loadu_ps(p) }; return r; }
+		static Batch Splat(float s) { Batch r = { _mm256_set1_ps(s) }; return r; }
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+
+	inline Batch operator+(Batch a, Batch b) { Batch r = { _mm256_add_ps(a.v, b.v) }; return r; }
+	inline Batch operator-(Batch a, Batch b) { Batch r = { _mm256_sub_ps(a.v, b.v) }; return r; }
+	inline Batch operator*(Batch a, Batch b) { Batch r = { _mm256_mul_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask operator&(Batch::Mask a, Batch::Mask b) { Batch::Mask r = { _mm256_and_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask operator|(Batch::Mask a, Batch::Mask b) { Batch::Mask r = { _mm256_or_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask Greater(Batch a, Batch b) { Batch::Mask r = { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; return r; }
+	inline Batch::Mask GreaterEqual(Batch a, Batch b) { Batch::Mask r = { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; return r; }
+	inline Batch::Mask NotEqual(Batch a, Batch b) { Batch::Mask r = { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) }; return r; }
+	inline bool Any(Batch::Mask mask) { return _mm256_movemask_ps(mask.v) != 0; }
+	inline Batch Select(Batch::Mask mask, Batch a, Batch b) { Batch r = { _mm256_blendv_ps(b.v, a.v, mask.v) }; return r; }
+	inline Batch ReciprocalLength(Batch lengthSquared)
+	{
+		Batch r = { _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lengthSquared.v)) };
+		return r;
+	}
+#elif DX_SIMD_SSE2
+	struct Batch
+	{
+		static const size_t Width = 4;
+		struct Mask { __m128 v; };
+		__m128 v;
+
+		static Batch Load(const float* p) { Batch r = { _mm_loadu_ps(p) }; return r; }
+		static Batch Splat(float s) { Batch r = { _mm_set1_ps(s) }; return r; }
+		void Store(float* p) const { _mm_storeu_ps(p, v); }
+	};
+
+	inline Batch operator+(Batch a, Batch b) { Batch r = { _mm_add_ps(a.v, b.v) }; return r; }
+	inline Batch operator-(Batch a, Batch b) { Batch r = { _mm_sub_ps(a.v, b.v) }; return r; }
+	inline Batch operator*(Batch a, Batch b) { Batch r = { _mm_mul_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask operator&(Batch::Mask a, Batch::Mask b) { Batch::Mask r = { _mm_and_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask operator|(Batch::Mask a, Batch::Mask b) { Batch::Mask r = { _mm_or_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask Greater(Batch a, Batch b) { Batch::Mask r = { _mm_cmpgt_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask GreaterEqual(Batch a, Batch b) { Batch::Mask r = { _mm_cmpge_ps(a.v, b.v) }; return r; }
+	inline Batch::Mask NotEqual(Batch a, Batch b) { Batch::Mask r = { _mm_cmpneq_ps(a.v, b.v) }; return r; }
+	inline bool Any(Batch::Mask mask) { return _mm_movemask_ps(mask.v) != 0; }
+	inline Batch Select(Batch::Mask mask, Batch a, Batch b)
+	{
+		Batch r = { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+		return r;
+	}
+	inline Batch ReciprocalLength(Batch lengthSquared)
+	{
+		Batch r = { _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared.v)) };
+		return r;
+	}
+#else
+	typedef Single Batch;
+#endif
+
+	struct Columns
+	{
+		float* position[3];
+		float* velocity[3];
+		float* direction[3];
+		const float* low[3];
+		const float* high[3];
+		const float* target[3];
+		const float* aimed;
+	};
+
+	// Moves the B::Width lights starting at i by seconds of their velocity, then turns around any
+	// axis that reached its limit. Lights with targets are then re-aimed. Returns whether any of
+	// the lights' positions or directions changed.
+	template <typename B>
+	bool AnimateLights(const Columns& columns, size_t i, B seconds)
+	{
+		const B zero = B::Splat(0.0f);
+		B position[3];
+		auto changed = NotEqual(zero, zero);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			B old = B::Load(columns.position[axis] + i);
+			B v = B::Load(columns.velocity[axis] + i);
+			B p = old + v * seconds;
+			changed = changed | NotEqual(p, old);
+			auto turn = (Greater(v, zero) & GreaterEqual(p, B::Load(columns.high[axis] + i))) |
+						(Greater(zero, v) & GreaterEqual(B::Load(columns.low[axis] + i), p));
+			Select(turn, zero - v, v).Store(columns.velocity[axis] + i);
+			p.Store(columns.position[axis] + i);
+			position[axis] = p;
+		}
+
+		B d[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			d[axis] = B::Load(columns.target[axis] + i) - position[axis];
+		}
+		B lengthSquared = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		auto aim = Greater(B::Load(columns.aimed + i), zero) & Greater(lengthSquared, zero);
+		// Lanes that aren't aimed keep their direction; their reciprocal may be infinite.
+		B scale = ReciprocalLength(Select(aim, lengthSquared, B::Splat(1.0f)));
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float* direction = columns.direction[axis] + i;
+			B old = B::Load(direction);
+			B aimed = Select(aim, d[axis] * scale, old);
+			changed = changed | NotEqual(aimed, old);
+			aimed.Store(direction);
+		}
+		return Any(changed);
+	}
+}
+
+LightStore::LightStore()
+{
+	Clear();
+}
+
+void LightStore::Reserve(LightType type, size_t count)
+{
+	for (std::vector<float>& field : m_types[type].fields)
+	{
+		field.reserve(count);
+	}
+}
+
+void LightStore::Clear(void)
+{
+	for (TypeStore& store : m_types)
+	{
+		for (std::vector<float>& field : store.fields)
+		{
+			field.clear();
+		}
+		store.count = 0;
+		store.movingBegin = 0;
+		store.movingEnd = 0;
+		store.dirtyBegin = 0;
+		store.dirtyEnd = 0;
+	}
+}
+
+LightStore::Light LightStore::Create(LightType type)
+{
+	static const float Defaults[FieldCount] =
+	{
+		0.0f, 0.0f, 0.0f,
+		1.0f,
+		1.0f, 1.0f, 1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f,
+		0.0f, 0.0f,
+		1.0f,
+		0.0f, 0.0f, 0.0f,
+		-HUGE_VALF, -HUGE_VALF, -HUGE_VALF,
+		HUGE_VALF, HUGE_VALF, HUGE_VALF,
+		0.0f, 0.0f, 0.0f,
+		0.0f
+	};
+
+	TypeStore& store = m_types[type];
+	for (int field = 0; field < FieldCount; ++field)
+	{
+		store.fields[field].push_back(Defaults[field]);
+	}
+	uint32_t index = store.count++;
+	for (uint32_t t = type; t < LightTypeCount; ++t)
+	{
+		MarkDirty(m_types[t], 0, m_types[t].count);
+	}
+	return (static_cast<uint32_t>(type) << 24) | index;
+}
+
+void LightStore::SetPosition(Light light, float x, float y, float z)
+{
+	const float values[3] = { x, y, z };
+	Assign(light, PositionX, values, 3);
+}
+
+void LightStore::SetDirection(Light light, float x, float y, float z)
+{
+	float length = sqrtf(x * x + y * y + z * z);
+	float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	const float values[3] = { x * scale, y * scale, z * scale };
+	Assign(light, DirectionX, values, 3);
+}
+
+void LightStore::SetColor(Light light, float r, float g, float b, float a)
+{
+	const float values[4] = { r, g, b, a };
+	Assign(light, ColorR, values, 4);
+}
+
+void LightStore::SetRadius(Light light, float radius)
+{
+	Assign(light, Radius, &radius, 1);
+}
+
+void LightStore::SetCone(Light light, float cosInner, float cosOuter)
+{
+	const float values[2] = { cosInner, cosOuter };
+	Assign(light, CosInner, values, 2);
+}
+
+void LightStore::SetEnabled(Light light, bool enabled)
+{
+	float value = enabled ? 1.0f : 0.0f;
+	Assign(light, Enabled, &value, 1);
+}
+
+void LightStore::SetChannel(Light light, LightChannel channel, float value)
+{
+	Assign(light, FieldOf(channel), &value, 1);
+}
+
+void LightStore::SetMotion(Light light, const float velocity[3], const float low[3], const float high[3])
+{
+	TypeStore& store = StoreOf(light);
+	uint32_t i = IndexOf(light);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		store.fields[VelocityX + axis][i] = velocity[axis];
+		store.fields[LowX + axis][i] = low[axis];
+		store.fields[HighX + axis][i] = high[axis];
+	}
+	MarkMoving(store, i);
+}
+
+void LightStore::SetTarget(Light light, float x, float y, float z)
+{
+	TypeStore& store = StoreOf(light);
+	uint32_t i = IndexOf(light);
+	store.fields[TargetX][i] = x;
+	store.fields[TargetY][i] = y;
+	store.fields[TargetZ][i] = z;
+	store.fields[Aimed][i] = 1.0f;
+	MarkMoving(store, i);
+}
+
+void LightStore::ClearTarget(Light light)
+{
+	StoreOf(light).fields[Aimed][IndexOf(light)] = 0.0f;
+}
+
+void LightStore::GetPosition(Light light, float position[3]) const
+{
+	const TypeStore& store = m_types[TypeOf(light)];
+	uint32_t i = IndexOf(light);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		position[axis] = store.fields[PositionX + axis][i];
+	}
+}
+
+void LightStore::GetVelocity(Light light, float velocity[3]) const
+{
+	const TypeStore& store = m_types[TypeOf(light)];
+	uint32_t i = IndexOf(light);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		velocity[axis] = store.fields[VelocityX + axis][i];
+	}
+}
+
+float LightStore::GetChannel(Light light, LightChannel channel) const
+{
+	return m_types[TypeOf(light)].fields[FieldOf(channel)][IndexOf(light)];
+}
+
+void LightStore::Animate(float seconds)
+{
+	for (TypeStore& store : m_types)
+	{
+		if (store.movingBegin == store.movingEnd)
+			continue;
+
+		Columns columns;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			columns.position[axis] = store.fields[PositionX + axis].data();
+			columns.velocity[axis] = store.fields[VelocityX + axis].data();
+			columns.direction[axis] = store.fields[DirectionX + axis].data();
+			columns.low[axis] = store.fields[LowX + axis].data();
+			columns.high[axis] = store.fields[HighX + axis].data();
+			columns.target[axis] = store.fields[TargetX + axis].data();
+		}
+		columns.aimed = store.fields[Aimed].data();
+
+		uint32_t changedBegin = store.movingEnd;
+		uint32_t changedEnd = store.movingBegin;
+		uint32_t i = store.movingBegin;
+		for (; i + Batch::Width <= store.movingEnd; i += Batch::Width)
+		{
+			if (AnimateLights<Batch>(columns, i, Batch::Splat(seconds)))
+			{
+				changedBegin = std::min(changedBegin, i);
+				changedEnd = i + static_cast<uint32_t>(Batch::Width);
+			}
+		}
+		for (; i < store.movingEnd; ++i)
+		{
+			if (AnimateLights<Single>(columns, i, Single::Splat(seconds)))
+			{
+				changedBegin = std::min(changedBegin, i);
+				changedEnd = i + 1;
+			}
+		}
+		MarkDirty(store, changedBegin, changedEnd);
+	}
+}
+
+uint32_t LightStore::GetPackedCount(void) const
+{
+	return GetPackedOffset(LightTypeCount);
+}
+
+uint32_t LightStore::GetPackedOffset(LightType type) const
+{
+	uint32_t offset = 0;
+	for (uint32_t t = 0; t < type; ++t)
+	{
+		offset += m_types[t].count;
+	}
+	return offset;
+}
+
+void LightStore::Pack(uint32_t first, uint32_t count, PackedLight* out) const
+{
+	uint32_t end = first + count;
+	uint32_t offset = 0;
+	for (uint32_t type = 0; type < LightTypeCount; ++type)
+	{
+		const TypeStore& store = m_types[type];
+		uint32_t begin = std::max(first, offset);
+		uint32_t last = std::min(end, offset + store.count);
+		for (uint32_t packed = begin; packed < last; ++packed)
+		{
+			uint32_t i = packed - offset;
+			const std::vector<float>* f = store.fields;
+			PackedLight& light = out[packed - first];
+			light.positionRadius[0] = f[PositionX][i];
+			light.positionRadius[1] = f[PositionY][i];
+			light.positionRadius[2] = f[PositionZ][i];
+			light.positionRadius[3] = f[Radius][i];
+			light.color[0] = f[ColorR][i];
+			light.color[1] = f[ColorG][i];
+			light.color[2] = f[ColorB][i];
+			light.color[3] = f[ColorA][i];
+			light.directionInner[0] = f[DirectionX][i];
+			light.directionInner[1] = f[DirectionY][i];
+			light.directionInner[2] = f[DirectionZ][i];
+			light.directionInner[3] = f[CosInner][i];
+			light.parameters[0] = f[CosOuter][i];
+			light.parameters[1] = static_cast<float>(type);
+			light.parameters[2] = f[Enabled][i];
+			light.parameters[3] = 0.0f;
+		}
+		offset += store.count;
+	}
+}
+
+void LightStore::WriteGridLights(GridLight* out) const
+{
+	for (uint32_t type = LightPoint; type < LightTypeCount; ++type)
+	{
+		const TypeStore& store = m_types[type];
+		const std::vector<float>* f = store.fields;
+		for (uint32_t i = 0; i < store.count; ++i)
+		{
+			GridLight& light = *out++;
+			light.position[0] = f[PositionX][i];
+			light.position[1] = f[PositionY][i];
+			light.position[2] = f[PositionZ][i];
+			light.radius = f[Enabled][i] != 0.0f ? f[Radius][i] : 0.0f;
+			bool spot = type == LightSpot;
+			light.direction[0] = spot ? f[DirectionX][i] : 0.0f;
+			light.direction[1] = spot ? f[DirectionY][i] : 0.0f;
+			light.direction[2] = spot ? f[DirectionZ][i] : 0.0f;
+			light.cosOuter = spot ? f[CosOuter][i] : -1.0f;
+		}
+	}
+}
+
+bool LightStore::GetDirtyRange(uint32_t& first, uint32_t& count) const
+{
+	uint32_t begin = ~0u;
+	uint32_t end = 0;
+	uint32_t offset = 0;
+	for (const TypeStore& store : m_types)
+	{
+		if (store.dirtyBegin < store.dirtyEnd)
+		{
+			begin = std::min(begin, offset + store.dirtyBegin);
+			end = std::max(end, offset + store.dirtyEnd);
+		}
+		offset += store.count;
+	}
+	if (begin >= end)
+		return false;
+
+	first = begin;
+	count = end - begin;
+	return true;
+}
+
+void LightStore::ClearDirty(void)
+{
+	for (TypeStore& store : m_types)
+	{
+		store.dirtyBegin = 0;
+		store.dirtyEnd = 0;
+	}
+}
+
+void LightStore::Assign(Light light, Field first, const float* values, int count)
+{
+	TypeStore& store = StoreOf(light);
+	uint32_t i = IndexOf(light);
+	bool changed = false;
+	for (int k = 0; k < count; ++k)
+	{
+		float& field = store.fields[first + k][i];
+		changed |= field != values[k];
+		field = values[k];
+	}
+	if (changed)
+		MarkDirty(store, i, i + 1);
+}
+
+LightStore::Field LightStore::FieldOf(LightChannel channel)
+{
+	// The channels follow the fields' order up to the cone.
+	return channel < ChannelCosInner ? static_cast<Field>(channel) : static_cast<Field>(CosInner + (channel - ChannelCosInner));
+}
+
+void LightStore::MarkDirty(TypeStore& store, uint32_t begin, uint32_t end)
+{
+	if (begin >= end)
+		return;
+
+	if (store.dirtyBegin >= store.dirtyEnd)
+	{
+		store.dirtyBegin = begin;
+		store.dirtyEnd = end;
+	}
+	else
+	{
+		store.dirtyBegin = std::min(store.dirtyBegin, begin);
+		store.dirtyEnd = std::max(store.dirtyEnd, end);
+	}
+}
+
+void LightStore::MarkMoving(TypeStore& store, uint32_t index)
+{
+	if (store.movingBegin >= store.movingEnd)
+	{
+		store.movingBegin = index;
+		store.movingEnd = index + 1;
+	}
+	else
+	{
+		store.movingBegin = std::min(store.movingBegin, index);
+		store.movingEnd = std::max(store.movingEnd, index + 1);
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "LightGrid.h"
+
+// Light storage for the renderer. Lights are grouped by type, and each type keeps every
+// parameter in its own dense array: position, range, color, direction, cone and motion. Animate
+// moves every drifting light by the time elapsed and re-aims every light that tracks a target,
+// eight lights at a time with AVX2 and four with SSE2. Setting a parameter to the value it already
+// has changes nothing; every real change is recorded as a dirty range, so the renderer repacks and
+// uploads only the lights that changed, in the 64-byte layout LightPixelShader reads. The
+// lights are packed in type order (directional, point, spot), which is also their order in
+// the cluster light buffer.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum LightType : uint32_t
+	{
+		LightDirectional = 0,
+		LightPoint,
+		LightSpot,
+		LightTypeCount
+	};
+
+	// The parameters that can be set one value at a time, e.g. by LightAnimation's curves.
+	enum LightChannel : uint32_t
+	{
+		ChannelPositionX = 0, ChannelPositionY, ChannelPositionZ,
+		ChannelRadius,
+		ChannelColorR, ChannelColorG, ChannelColorB, ChannelColorA,
+		ChannelCosInner, ChannelCosOuter,
+		LightChannelCount
+	};
+
+	// One light as LightPixelShader reads it.
+	struct PackedLight
+	{
+		float positionRadius[4];	// World position; range of point and spot lights.
+		float color[4];
+		float directionInner[4];	// Where a directional or spot light shines; w = cosine of the inner cone.
+		float parameters[4];		// Cosine of the outer cone, LightType, 1 if enabled or 0, unused.
+	};
+
+	class LightStore
+	{
+	public:
+		// Type in the high 8 bits, index within the type in the low 24.
+		typedef uint32_t Light;
+		static const uint32_t MaxLightsPerType = 1 << 24;
+
+		LightStore();
+
+		void Reserve(LightType type, size_t count);
+		// Destroys every light; the whole store is dirty afterwards.
+		void Clear(void);
+
+		// New lights are white, enabled and still, at the origin with a range of 1, shining along
+		// +z with a cone of 90 degrees. Creating a light makes every light dirty, as the packed
+		// positions of the types after it move.
+		Light Create(LightType type);
+
+		void SetPosition(Light light, float x, float y, float z);
+		// Normalized by the store.
+		void SetDirection(Light light, float x, float y, float z);
+		void SetColor(Light light, float r, float g, float b, float a);
+		void SetRadius(Light light, float radius);
+		void SetCone(Light light, float cosInner, float cosOuter);
+		void SetEnabled(Light light, bool enabled);
+		void SetChannel(Light light, LightChannel channel, float value);
+		// Animate moves the light by velocity, in units per second. An axis turns around once the
+		// position passes high while moving up, or low while moving down.
+		void SetMotion(Light light, const float velocity[3], const float low[3], const float high[3]);
+		// After each Animate the light shines from its position towards target.
+		void SetTarget(Light light, float x, float y, float z);
+		void ClearTarget(Light light);
+
+		void GetPosition(Light light, float position[3]) const;
+		void GetVelocity(Light light, float velocity[3]) const;
+		float GetChannel(Light light, LightChannel channel) const;
+
+		// Moves every drifting light by seconds of its velocity and re-aims the lights with targets.
+		// Only the lights whose position or direction changed become dirty.
+		void Animate(float seconds);
+
+		static LightType TypeOf(Light light) { return static_cast<LightType>(light >> 24); }
+		uint32_t GetCount(LightType type) const { return m_types[type].count; }
+		uint32_t GetPackedCount(void) const;
+		// Where the type's lights, and a light, start in the packed order.
+		uint32_t GetPackedOffset(LightType type) const;
+		uint32_t GetPackedIndex(Light light) const { return GetPackedOffset(TypeOf(light)) + (light & (MaxLightsPerType - 1)); }
+
+		// Writes the packed lights [first, first + count).
+		void Pack(uint32_t first, uint32_t count, PackedLight* out) const;
+		// The point and spot lights, in packed order, for LightGrid::Build. Disabled lights get a
+		// range of zero, which the grid leaves out.
+		void WriteGridLights(GridLight* out) const;
+
+		// The packed lights changed since ClearDirty, as one range; false if none did.
+		bool GetDirtyRange(uint32_t& first, uint32_t& count) const;
+		void ClearDirty(void);
+
+	private:
+		enum Field
+		{
+			PositionX = 0, PositionY, PositionZ,
+			Radius,
+			ColorR, ColorG, ColorB, ColorA,
+			DirectionX, DirectionY, DirectionZ,
+			CosInner, CosOuter,
+			Enabled,
+			VelocityX, VelocityY, VelocityZ,
+			LowX, LowY, LowZ,
+			HighX, HighY, HighZ,
+			TargetX, TargetY, TargetZ,
+			Aimed,					// 1 when the light tracks its target, otherwise 0.
+			FieldCount
+		};
+
+		struct TypeStore
+		{
+			std::vector<float> fields[FieldCount];
+			uint32_t count;
+			// Lights [movingBegin, movingEnd) include every moving or aimed one; Animate touches only those.
+			uint32_t movingBegin;
+			uint32_t movingEnd;
+			// Changed since ClearDirty, within the type.
+			uint32_t dirtyBegin;
+			uint32_t dirtyEnd;
+		};
+
+		TypeStore& StoreOf(Light light) { return m_types[TypeOf(light)]; }
+		static uint32_t IndexOf(Light light) { return light & (MaxLightsPerType - 1); }
+		static Field FieldOf(LightChannel channel);
+		// Stores the values into fields [first, first + count) of the light and marks it dirty if any differed.
+		void Assign(Light light, Field first, const float* values, int count);
+		static void MarkDirty(TypeStore& store, uint32_t begin, uint32_t end);
+		static void MarkMoving(TypeStore& store, uint32_t index);
+
+		TypeStore m_types[LightTypeCount];
+	};
+}
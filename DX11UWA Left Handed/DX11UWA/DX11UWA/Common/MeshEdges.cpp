@@ -0,0 +1,232 @@
+#include "MeshEdges.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace DX;
+
+const uint32_t EdgeList::NoFace;
+const uint32_t EdgeList::NoEdge;
+
+namespace
+{
+	const float DegreesPerRadian = 57.2957795f;
+	const uint32_t Empty = 0xffffffff;
+
+	const float* Position(const float* positions, size_t stride, uint32_t index)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + stride * index);
+	}
+
+	// Adding zero turns -0 into +0, so both hash and compare alike.
+	uint32_t FloatBits(float value)
+	{
+		value += 0.0f;
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	// The 64-bit finalizer of MurmurHash3.
+	uint64_t Mix(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
+	// At most half full, so probe runs stay short.
+	size_t TableSize(size_t count)
+	{
+		size_t size = 16;
+		while (size < count * 2)
+		{
+			size *= 2;
+		}
+		return size;
+	}
+
+	// Maps each vertex to the first one at the same position.
+	void WeldPositions(const float* positions, size_t stride, uint32_t vertexCount, std::vector<uint32_t>& weld)
+	{
+		weld.resize(vertexCount);
+		std::vector<uint32_t> slots(TableSize(vertexCount), Empty);
+		const size_t mask = slots.size() - 1;
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const float* p = Position(positions, stride, v);
+			const uint32_t bits[3] = { FloatBits(p[0]), FloatBits(p[1]), FloatBits(p[2]) };
+			size_t slot = size_t(Mix((uint64_t(bits[0]) << 32 | bits[1]) ^ Mix(bits[2]))) & mask;
+			for (;; slot = (slot + 1) & mask)
+			{
+				if (slots[slot] == Empty)
+				{
+					slots[slot] = v;
+					weld[v] = v;
+					break;
+				}
+				const float* q = Position(positions, stride, slots[slot]);
+				if (FloatBits(q[0]) == bits[0] && FloatBits(q[1]) == bits[1] && FloatBits(q[2]) == bits[2])
+				{
+					weld[v] = slots[slot];
+					break;
+				}
+			}
+		}
+	}
+
+	// Unit face normal, or zero for a degenerate triangle.
+	void FaceNormal(const float* positions, size_t stride, const uint32_t* corners, float normal[3])
+	{
+		const float* a = Position(positions, stride, corners[0]);
+		const float* b = Position(positions, stride, corners[1]);
+		const float* c = Position(positions, stride, corners[2]);
+		float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = u[1] * v[2] - u[2] * v[1];
+		normal[1] = u[2] * v[0] - u[0] * v[2];
+		normal[2] = u[0] * v[1] - u[1] * v[0];
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		normal[0] *= scale;
+		normal[1] *= scale;
+		normal[2] *= scale;
+	}
+}
+
+void DX::ExtractEdges(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, EdgeList& edges)
+{
+	const size_t triangleCount = indexCount / 3;
+	uint32_t vertexCount = 0;
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+	{
+		vertexCount = std::max(vertexCount, indices[i] + 1);
+	}
+	std::vector<uint32_t> weld;
+	WeldPositions(positions, stride, vertexCount, weld);
+
+	edges.lines.clear();
+	edges.faces.clear();
+	edges.faceCounts.clear();
+	edges.kinds.clear();
+	edges.faceEdges.assign(triangleCount * 3, EdgeList::NoEdge);
+
+	// A closed mesh has one and a half edges per triangle; the table doubles when that's short.
+	std::vector<uint64_t> keys(TableSize(triangleCount * 3 / 2));
+	std::vector<uint32_t> slots(keys.size(), Empty);
+	auto find = [&](uint64_t key)
+	{
+		const size_t mask = slots.size() - 1;
+		size_t slot = size_t(Mix(key)) & mask;
+		while (slots[slot] != Empty && keys[slot] != key)
+		{
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	};
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (size_t k = 0; k < 3; ++k)
+		{
+			uint32_t a = weld[indices[t * 3 + k]];
+			uint32_t b = weld[indices[t * 3 + (k + 1) % 3]];
+			if (a == b)
+				continue;
+			uint32_t low = std::min(a, b);
+			uint32_t high = std::max(a, b);
+			uint64_t key = uint64_t(low) << 32 | high;
+
+			size_t slot = find(key);
+			uint32_t edge = slots[slot];
+			if (edge == Empty)
+			{
+				edge = static_cast<uint32_t>(edges.EdgeCount());
+				edges.lines.push_back(low);
+				edges.lines.push_back(high);
+				edges.faces.push_back(static_cast<uint32_t>(t));
+				edges.faces.push_back(EdgeList::NoFace);
+				edges.faceCounts.push_back(1);
+				keys[slot] = key;
+				slots[slot] = edge;
+
+				if (edges.EdgeCount() * 2 > slots.size())
+				{
+					keys.assign(slots.size() * 2, 0);
+					slots.assign(slots.size() * 2, Empty);
+					for (uint32_t e = 0; e < edges.EdgeCount(); ++e)
+					{
+						uint64_t rehashed = uint64_t(edges.lines[e * 2]) << 32 | edges.lines[e * 2 + 1];
+						size_t target = find(rehashed);
+						keys[target] = rehashed;
+						slots[target] = e;
+					}
+				}
+			}
+			else
+			{
+				if (edges.faceCounts[edge] == 1)
+					edges.faces[edge * 2 + 1] = static_cast<uint32_t>(t);
+				if (edges.faceCounts[edge] < 255)
+					++edges.faceCounts[edge];
+			}
+			edges.faceEdges[t * 3 + k] = edge;
+		}
+	}
+}
+
+void DX::ClassifyEdges(const float* positions, size_t stride, const uint32_t* indices, float creaseAngle, EdgeList& edges)
+{
+	const float creaseCosine = cosf(creaseAngle / DegreesPerRadian);
+	edges.kinds.resize(edges.EdgeCount());
+	for (size_t e = 0; e < edges.EdgeCount(); ++e)
+	{
+		if (edges.faceCounts[e] == 1)
+		{
+			edges.kinds[e] = EdgeBoundary;
+			continue;
+		}
+		if (edges.faceCounts[e] > 2)
+		{
+			edges.kinds[e] = EdgeNonManifold;
+			continue;
+		}
+		float first[3], second[3];
+		FaceNormal(positions, stride, indices + size_t(edges.faces[e * 2]) * 3, first);
+		FaceNormal(positions, stride, indices + size_t(edges.faces[e * 2 + 1]) * 3, second);
+		float cosine = first[0] * second[0] + first[1] * second[1] + first[2] * second[2];
+		edges.kinds[e] = cosine < creaseCosine ? EdgeCrease : EdgeSmooth;
+	}
+}
+
+void DX::FindSilhouetteEdges(const float* positions, size_t stride, const uint32_t* indices, const EdgeList& edges,
+							 const float eye[3], std::vector<uint32_t>& lines)
+{
+	const size_t triangleCount = edges.faceEdges.size() / 3;
+	std::vector<uint8_t> facing(triangleCount);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const float* a = Position(positions, stride, indices[t * 3]);
+		const float* b = Position(positions, stride, indices[t * 3 + 1]);
+		const float* c = Position(positions, stride, indices[t * 3 + 2]);
+		float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		facing[t] = n[0] * (eye[0] - a[0]) + n[1] * (eye[1] - a[1]) + n[2] * (eye[2] - a[2]) > 0.0f;
+	}
+
+	lines.clear();
+	for (size_t e = 0; e < edges.EdgeCount(); ++e)
+	{
+		bool outline = edges.faceCounts[e] != 2 || facing[edges.faces[e * 2]] != facing[edges.faces[e * 2 + 1]];
+		if (outline)
+		{
+			lines.push_back(edges.lines[e * 2]);
+			lines.push_back(edges.lines[e * 2 + 1]);
+		}
+	}
+}
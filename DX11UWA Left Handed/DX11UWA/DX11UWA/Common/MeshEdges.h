@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Unique edges of a triangle mesh, found once at load so a wireframe or outline is one line-list
+// draw instead of a geometry shader emitting every triangle's sides. Corners at the same position
+// count as one vertex, so a seam where the normals or uvs split still yields one edge with a face
+// on either side. Both the edge map and the position map are open-addressing hash tables.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum EdgeKind : uint8_t
+	{
+		EdgeSmooth = 0,		// Two faces, less than the crease angle apart.
+		EdgeCrease,			// Two faces meeting at a sharper angle.
+		EdgeBoundary,		// One face.
+		EdgeNonManifold		// More than two faces; faces holds the first two.
+	};
+
+	struct EdgeList
+	{
+		static const uint32_t NoFace = 0xffffffff;
+		static const uint32_t NoEdge = 0xffffffff;
+
+		std::vector<uint32_t> lines;		// Two indices per edge, of the first vertex seen at each end.
+		std::vector<uint32_t> faces;		// The triangles on either side of each edge, NoFace if missing.
+		std::vector<uint32_t> faceEdges;	// Three per triangle, edge k from corner k to k + 1; NoEdge if they weld.
+		std::vector<uint8_t> faceCounts;	// Triangles sharing each edge, saturating at 255.
+		std::vector<EdgeKind> kinds;		// Filled by ClassifyEdges.
+
+		size_t EdgeCount(void) const { return lines.size() / 2; }
+	};
+
+	// positions points at the first vertex's position, the next one stride bytes further.
+	void ExtractEdges(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, EdgeList& edges);
+
+	// Sets kinds: faces more than creaseAngle degrees apart make a crease.
+	void ClassifyEdges(const float* positions, size_t stride, const uint32_t* indices, float creaseAngle, EdgeList& edges);
+
+	// Replaces lines with the edges of the outline seen from eye, in object space: boundaries,
+	// non-manifold edges and edges between a triangle facing eye and one facing away.
+	void FindSilhouetteEdges(const float* positions, size_t stride, const uint32_t* indices, const EdgeList& edges,
+							 const float eye[3], std::vector<uint32_t>& lines);
+}
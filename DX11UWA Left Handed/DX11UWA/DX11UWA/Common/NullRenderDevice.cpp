@@ -0,0 +1,688 @@
+#include "NullRenderDevice.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DX;
+
+const uint32_t NullRenderDevice::VertexBufferSlots;
+const uint32_t NullRenderDevice::ConstantBufferSlots;
+const uint32_t NullRenderDevice::ShaderResourceSlots;
+const uint32_t NullRenderDevice::SamplerSlots;
+const uint32_t NullRenderDevice::MaxKeptErrors;
+
+namespace
+{
+	// Bytes per element or texel; zero for formats the renderer never uses.
+	uint32_t FormatBytes(uint32_t format)
+	{
+		switch (format)
+		{
+		case FormatR32G32B32A32Float: return 16;
+		case FormatR32G32B32Float: return 12;
+		case FormatR32G32Uint: return 8;
+		case FormatR8G8B8A8Unorm:
+		case FormatB8G8R8A8Unorm:
+		case FormatR32Uint: return 4;
+		case FormatR16Uint: return 2;
+		default: return 0;
+		}
+	}
+
+	uint32_t FullMipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		for (uint32_t size = width > height ? width : height; size > 1; size >>= 1)
+		{
+			++levels;
+		}
+		return levels;
+	}
+
+	bool IsPatchList(uint32_t topology)
+	{
+		return topology >= TopologyFirstPatchList && topology <= TopologyLastPatchList;
+	}
+
+	bool IsKnownTopology(uint32_t topology)
+	{
+		// Point, line and triangle lists and strips, their adjacency variants, and patch lists.
+		return (topology >= 1 && topology <= 5) || (topology >= 10 && topology <= 13) || IsPatchList(topology);
+	}
+
+	uint64_t PrimitiveCount(uint32_t topology, uint32_t indexCount)
+	{
+		switch (topology)
+		{
+		case 1: return indexCount;
+		case TopologyLineList: return indexCount / 2;
+		case 3: return indexCount > 1 ? indexCount - 1 : 0;
+		case TopologyTriangleList: return indexCount / 3;
+		case TopologyTriangleStrip: return indexCount > 2 ? indexCount - 2 : 0;
+		default:
+			return IsPatchList(topology) ? indexCount / (topology - TopologyFirstPatchList + 1) : 0;
+		}
+	}
+
+	const char* const StageNames[StageCount] = { "vertex", "hull", "domain", "geometry", "pixel" };
+}
+
+NullRenderDevice::NullRenderDevice() :
+	m_nextHandle(0),
+	m_inputLayout(nullptr),
+	m_indexBuffer(nullptr),
+	m_indexFormat(0),
+	m_indexOffset(0),
+	m_topology(0),
+	m_errorCount(0)
+{
+	memset(m_vertexStreams, 0, sizeof(m_vertexStreams));
+	memset(m_shaders, 0, sizeof(m_shaders));
+	memset(m_constantBuffers, 0, sizeof(m_constantBuffers));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+const void* NullRenderDevice::Add(Object& object)
+{
+	// Handles are never dereferenced, so any distinct non-null value will do.
+	const void* handle = reinterpret_cast<const void*>(++m_nextHandle * 16);
+	m_objects[handle] = std::move(object);
+	return handle;
+}
+
+NullRenderDevice::Object* NullRenderDevice::Find(const void* handle, ObjectKind kind, const char* call)
+{
+	if (!handle)
+		return nullptr;
+
+	auto found = m_objects.find(handle);
+	if (found == m_objects.end())
+	{
+		Error("%s: unknown or released handle %p", call, handle);
+		return nullptr;
+	}
+	if (found->second.kind != kind)
+	{
+		Error("%s: handle %p is the wrong kind of object", call, handle);
+		return nullptr;
+	}
+	return &found->second;
+}
+
+void NullRenderDevice::Error(const char* format, ...)
+{
+	++m_errorCount;
+	if (m_errors.size() >= MaxKeptErrors)
+		return;
+
+	char message[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	m_errors.push_back(message);
+}
+
+const void* NullRenderDevice::CreateBuffer(const BufferDesc& desc, const void* initialData)
+{
+	if (desc.size == 0 || desc.bindFlags == 0)
+	{
+		Error("CreateBuffer: empty size or bind flags");
+		return nullptr;
+	}
+	if ((desc.bindFlags & BindConstantBuffer) && (desc.bindFlags != BindConstantBuffer || desc.size % 16))
+	{
+		Error("CreateBuffer: constant buffers take no other bind flags and a multiple of 16 bytes");
+		return nullptr;
+	}
+	if (desc.usage == UsageImmutable && !initialData)
+	{
+		Error("CreateBuffer: immutable buffer without initial data");
+		return nullptr;
+	}
+	if ((desc.bindFlags & BindShaderResource) && (!FormatBytes(desc.viewFormat) || desc.size % FormatBytes(desc.viewFormat)))
+	{
+		Error("CreateBuffer: shader resource buffer without a view format that divides its size");
+		return nullptr;
+	}
+
+	Object object = {};
+	object.kind = KindBuffer;
+	object.buffer = desc;
+	object.bytes = desc.size;
+	if (desc.usage == UsageDynamic)
+	{
+		object.memory.resize(desc.size);
+		if (initialData)
+			memcpy(object.memory.data(), initialData, desc.size);
+	}
+
+	++m_stats.buffers;
+	m_stats.bufferBytes += desc.size;
+	if (initialData)
+		m_stats.uploadBytes += desc.size;
+	return Add(object);
+}
+
+const void* NullRenderDevice::CreateTexture(const TextureDesc& desc, const void* initialData)
+{
+	uint32_t texelBytes = FormatBytes(desc.format);
+	uint32_t fullMips = desc.width && desc.height ? FullMipCount(desc.width, desc.height) : 0;
+	uint32_t mipLevels = desc.mipLevels ? desc.mipLevels : fullMips;
+	if (!desc.width || !desc.height || !desc.arraySize || !texelBytes || mipLevels > fullMips)
+	{
+		Error("CreateTexture: bad size, mip count or format");
+		return nullptr;
+	}
+	if (desc.cube && desc.arraySize % 6)
+	{
+		Error("CreateTexture: cube map array size %u is not a multiple of 6", desc.arraySize);
+		return nullptr;
+	}
+
+	Object object = {};
+	object.kind = KindTexture;
+	object.mipLevels = mipLevels;
+	for (uint32_t level = 0; level < mipLevels; ++level)
+	{
+		uint32_t width = desc.width >> level;
+		uint32_t height = desc.height >> level;
+		object.bytes += uint64_t(width ? width : 1) * (height ? height : 1) * texelBytes;
+	}
+	object.bytes *= desc.arraySize;
+
+	++m_stats.textures;
+	m_stats.textureBytes += object.bytes;
+	if (initialData)
+		m_stats.uploadBytes += object.bytes;
+	return Add(object);
+}
+
+const void* NullRenderDevice::CreateShader(ShaderStage stage, const void* bytecode, size_t size)
+{
+	if (stage >= StageCount || !bytecode || !size)
+	{
+		Error("CreateShader: bad stage or empty bytecode");
+		return nullptr;
+	}
+
+	Object object = {};
+	object.kind = KindShader;
+	object.stage = stage;
+	object.bytes = size;
+	++m_stats.shaders;
+	return Add(object);
+}
+
+const void* NullRenderDevice::CreateInputLayout(const InputElement* elements, uint32_t count,
+												const void* vertexShaderBytecode, size_t size)
+{
+	if (!elements || !count || !vertexShaderBytecode || !size)
+	{
+		Error("CreateInputLayout: no elements or no vertex shader bytecode");
+		return nullptr;
+	}
+
+	Object object = {};
+	object.kind = KindInputLayout;
+	uint32_t vertexSlotMask = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const InputElement& element = elements[i];
+		uint32_t bytes = FormatBytes(element.format);
+		if (!element.semantic || !bytes || element.slot >= VertexBufferSlots)
+		{
+			Error("CreateInputLayout: element %u has a bad semantic, format or slot", i);
+			return nullptr;
+		}
+
+		uint32_t bit = 1u << element.slot;
+		(element.perInstance ? object.instanceSlotMask : vertexSlotMask) |= bit;
+		object.slotMask |= bit;
+		if (element.offset + bytes > object.slotBytes[element.slot])
+			object.slotBytes[element.slot] = element.offset + bytes;
+	}
+	if (vertexSlotMask & object.instanceSlotMask)
+	{
+		Error("CreateInputLayout: a slot mixes per-vertex and per-instance elements");
+		return nullptr;
+	}
+
+	++m_stats.inputLayouts;
+	return Add(object);
+}
+
+const void* NullRenderDevice::CreateRasterizerState(const RasterizerDesc& desc)
+{
+	(void)desc;
+	Object object = {};
+	object.kind = KindRasterizerState;
+	++m_stats.rasterizerStates;
+	return Add(object);
+}
+
+const void* NullRenderDevice::CreateSampler(const SamplerDesc& desc)
+{
+	(void)desc;
+	Object object = {};
+	object.kind = KindSampler;
+	++m_stats.samplers;
+	return Add(object);
+}
+
+void NullRenderDevice::Unbind(const Object* object)
+{
+	if (m_inputLayout == object)
+		m_inputLayout = nullptr;
+	if (m_indexBuffer == object)
+		m_indexBuffer = nullptr;
+	for (VertexStream& stream : m_vertexStreams)
+	{
+		if (stream.buffer == object)
+			stream.buffer = nullptr;
+	}
+	for (uint32_t stage = 0; stage < StageCount; ++stage)
+	{
+		if (m_shaders[stage] == object)
+			m_shaders[stage] = nullptr;
+		for (Object*& buffer : m_constantBuffers[stage])
+		{
+			if (buffer == object)
+				buffer = nullptr;
+		}
+	}
+}
+
+void NullRenderDevice::Release(const void* handle)
+{
+	auto found = m_objects.find(handle);
+	if (found == m_objects.end())
+	{
+		Error("Release: unknown or already released handle %p", handle);
+		return;
+	}
+
+	// Direct3D keeps bound objects alive until they are unbound; here the binding just goes away.
+	Object& object = found->second;
+	Unbind(&object);
+	switch (object.kind)
+	{
+	case KindBuffer:
+		--m_stats.buffers;
+		m_stats.bufferBytes -= object.bytes;
+		break;
+	case KindTexture:
+		--m_stats.textures;
+		m_stats.textureBytes -= object.bytes;
+		break;
+	case KindShader: --m_stats.shaders; break;
+	case KindInputLayout: --m_stats.inputLayouts; break;
+	case KindRasterizerState: --m_stats.rasterizerStates; break;
+	case KindSampler: --m_stats.samplers; break;
+	}
+	m_objects.erase(found);
+}
+
+void* NullRenderDevice::Map(const void* buffer, bool discard)
+{
+	(void)discard;
+	if (!buffer)
+	{
+		Error("Map: null buffer");
+		return nullptr;
+	}
+	Object* object = Find(buffer, KindBuffer, "Map");
+	if (!object)
+		return nullptr;
+	if (object->buffer.usage != UsageDynamic)
+	{
+		Error("Map: buffer %p is not dynamic", buffer);
+		return nullptr;
+	}
+	if (object->mapped)
+	{
+		Error("Map: buffer %p is already mapped", buffer);
+		return nullptr;
+	}
+
+	object->mapped = true;
+	++m_stats.maps;
+	return object->memory.data();
+}
+
+void NullRenderDevice::Unmap(const void* buffer)
+{
+	Object* object = Find(buffer, KindBuffer, "Unmap");
+	if (object && !object->mapped)
+		Error("Unmap: buffer %p is not mapped", buffer);
+	if (object)
+		object->mapped = false;
+}
+
+DeviceCaps NullRenderDevice::GetCaps(void) const
+{
+	DeviceCaps caps = { true, 0 };
+	return caps;
+}
+
+const void* NullRenderDevice::GetBufferView(const void* buffer)
+{
+	Object* object = Find(buffer, KindBuffer, "GetBufferView");
+	if (object && !(object->buffer.bindFlags & BindShaderResource))
+	{
+		Error("GetBufferView: buffer %p was not created as a shader resource", buffer);
+		return nullptr;
+	}
+	return object ? buffer : nullptr;
+}
+
+void NullRenderDevice::WriteBuffer(const void* buffer, uint32_t offset, const void* data, uint32_t size)
+{
+	if (!buffer || !data)
+	{
+		Error("WriteBuffer: null buffer or data");
+		return;
+	}
+	Object* object = Find(buffer, KindBuffer, "WriteBuffer");
+	if (!object)
+		return;
+	if (object->buffer.usage != UsageDefault || uint64_t(offset) + size > object->buffer.size)
+	{
+		Error("WriteBuffer: buffer %p is not default usage or %u+%u runs past it", buffer, offset, size);
+		return;
+	}
+	// Direct3D only updates constant buffers whole.
+	if ((object->buffer.bindFlags & BindConstantBuffer) && (offset || size != object->buffer.size))
+	{
+		Error("WriteBuffer: constant buffer %p written in part", buffer);
+		return;
+	}
+
+	++m_stats.updates;
+	m_stats.uploadBytes += size;
+}
+
+void NullRenderDevice::SetTextureMinLod(const void* texture, float lod)
+{
+	++m_stats.minLodChanges;
+	if (!texture)
+	{
+		Error("SetTextureMinLod: null texture");
+		return;
+	}
+	Object* object = Find(texture, KindTexture, "SetTextureMinLod");
+	if (object && !(lod >= 0.0f && lod < float(object->mipLevels)))
+		Error("SetTextureMinLod: %g is past the %u mips of texture %p", lod, object->mipLevels, texture);
+}
+
+void NullRenderDevice::ClearDepth(void)
+{
+	++m_stats.clears;
+}
+
+IRenderBackend& NullRenderDevice::BeginDeferred(uint32_t index)
+{
+	Error("BeginDeferred: no deferred context %u", index);
+	return *this;
+}
+
+bool NullRenderDevice::FinishDeferred(uint32_t index)
+{
+	Error("FinishDeferred: no deferred context %u", index);
+	return false;
+}
+
+void NullRenderDevice::ExecuteDeferred(uint32_t index)
+{
+	Error("ExecuteDeferred: no deferred context %u", index);
+}
+
+void NullRenderDevice::SetInputLayout(const void* layout)
+{
+	++m_stats.calls[CallInputLayout];
+	m_inputLayout = Find(layout, KindInputLayout, "SetInputLayout");
+}
+
+void NullRenderDevice::SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+{
+	++m_stats.calls[CallVertexBuffer];
+	if (slot >= VertexBufferSlots)
+	{
+		Error("SetVertexBuffer: slot %u out of range", slot);
+		return;
+	}
+
+	Object* object = Find(buffer, KindBuffer, "SetVertexBuffer");
+	if (object && !(object->buffer.bindFlags & BindVertexBuffer))
+	{
+		Error("SetVertexBuffer: buffer %p was not created as a vertex buffer", buffer);
+		object = nullptr;
+	}
+	VertexStream stream = { object, stride, offset };
+	m_vertexStreams[slot] = stream;
+}
+
+void NullRenderDevice::SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset)
+{
+	++m_stats.calls[CallIndexBuffer];
+	Object* object = Find(buffer, KindBuffer, "SetIndexBuffer");
+	if (object && !(object->buffer.bindFlags & BindIndexBuffer))
+	{
+		Error("SetIndexBuffer: buffer %p was not created as an index buffer", buffer);
+		object = nullptr;
+	}
+	if (object && format != FormatR16Uint && format != FormatR32Uint)
+	{
+		Error("SetIndexBuffer: format %u is not R16_UINT or R32_UINT", format);
+		object = nullptr;
+	}
+	if (object && offset % FormatBytes(format))
+	{
+		Error("SetIndexBuffer: offset %u is not aligned to the index size", offset);
+		object = nullptr;
+	}
+	m_indexBuffer = object;
+	m_indexFormat = format;
+	m_indexOffset = offset;
+}
+
+void NullRenderDevice::SetPrimitiveTopology(uint32_t topology)
+{
+	++m_stats.calls[CallTopology];
+	if (!IsKnownTopology(topology))
+		Error("SetPrimitiveTopology: unknown topology %u", topology);
+	m_topology = topology;
+}
+
+void NullRenderDevice::SetShader(ShaderStage stage, const void* shader)
+{
+	++m_stats.calls[CallShader];
+	if (stage >= StageCount)
+	{
+		Error("SetShader: bad stage %u", uint32_t(stage));
+		return;
+	}
+
+	Object* object = Find(shader, KindShader, "SetShader");
+	if (object && object->stage != stage)
+	{
+		Error("SetShader: %s shader %p bound to the %s stage", StageNames[object->stage], shader, StageNames[stage]);
+		object = nullptr;
+	}
+	m_shaders[stage] = object;
+}
+
+void NullRenderDevice::SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+										 uint32_t firstConstant, uint32_t constantCount)
+{
+	++m_stats.calls[CallConstantBuffer];
+	if (stage >= StageCount || slot >= ConstantBufferSlots)
+	{
+		Error("SetConstantBuffer: stage %u slot %u out of range", uint32_t(stage), slot);
+		return;
+	}
+
+	Object* object = Find(buffer, KindBuffer, "SetConstantBuffer");
+	if (object && !(object->buffer.bindFlags & BindConstantBuffer))
+	{
+		Error("SetConstantBuffer: buffer %p was not created as a constant buffer", buffer);
+		object = nullptr;
+	}
+	// Ranges are counted in 16-byte constants and must start and end on 256-byte boundaries.
+	if (object && constantCount &&
+		(firstConstant % 16 || constantCount % 16 || constantCount > 4096 ||
+		 (uint64_t(firstConstant) + constantCount) * 16 > object->buffer.size))
+	{
+		Error("SetConstantBuffer: range %u+%u doesn't fit buffer %p", firstConstant, constantCount, buffer);
+		object = nullptr;
+	}
+	m_constantBuffers[stage][slot] = object;
+}
+
+void NullRenderDevice::SetShaderResource(ShaderStage stage, uint32_t slot, const void* view)
+{
+	++m_stats.calls[CallShaderResource];
+	if (stage >= StageCount || slot >= ShaderResourceSlots)
+	{
+		Error("SetShaderResource: stage %u slot %u out of range", uint32_t(stage), slot);
+		return;
+	}
+	if (!view)
+		return;
+
+	auto found = m_objects.find(view);
+	if (found == m_objects.end())
+		Error("SetShaderResource: unknown or released handle %p", view);
+	else if (found->second.kind != KindTexture &&
+			 !(found->second.kind == KindBuffer && (found->second.buffer.bindFlags & BindShaderResource)))
+		Error("SetShaderResource: handle %p is not a texture or shader resource buffer", view);
+}
+
+void NullRenderDevice::SetSampler(ShaderStage stage, uint32_t slot, const void* sampler)
+{
+	++m_stats.calls[CallSampler];
+	if (stage >= StageCount || slot >= SamplerSlots)
+	{
+		Error("SetSampler: stage %u slot %u out of range", uint32_t(stage), slot);
+		return;
+	}
+	Find(sampler, KindSampler, "SetSampler");
+}
+
+void NullRenderDevice::SetRasterizerState(const void* state)
+{
+	++m_stats.calls[CallRasterizerState];
+	Find(state, KindRasterizerState, "SetRasterizerState");
+}
+
+void NullRenderDevice::CheckDraw(const char* call, uint32_t indexCount, uint32_t startIndex,
+								 uint32_t instanceCount, uint32_t startInstance)
+{
+	if (!m_shaders[StageVertex] || !m_inputLayout || !m_indexBuffer)
+	{
+		Error("%s: needs a vertex shader, an input layout and an index buffer", call);
+		return;
+	}
+	if (!m_topology)
+		Error("%s: no primitive topology", call);
+	bool tessellated = m_shaders[StageHull] && m_shaders[StageDomain];
+	if (IsPatchList(m_topology) != tessellated)
+		Error("%s: patch lists need hull and domain shaders and nothing else does", call);
+
+	uint64_t indexEnd = m_indexOffset + (uint64_t(startIndex) + indexCount) * FormatBytes(m_indexFormat);
+	if (indexEnd > m_indexBuffer->buffer.size)
+		Error("%s: indices %u+%u run past the index buffer", call, startIndex, indexCount);
+	if (m_indexBuffer->mapped)
+		Error("%s: the index buffer is mapped", call);
+
+	// Per-vertex streams can't be range checked without reading the indices; per-instance
+	// streams can.
+	for (uint32_t slot = 0; slot < VertexBufferSlots; ++slot)
+	{
+		if (!(m_inputLayout->slotMask & (1u << slot)))
+			continue;
+
+		const VertexStream& stream = m_vertexStreams[slot];
+		if (!stream.buffer)
+		{
+			Error("%s: the input layout reads vertex buffer slot %u, which is empty", call, slot);
+			continue;
+		}
+		if (stream.buffer->mapped)
+			Error("%s: vertex buffer slot %u is mapped", call, slot);
+		if ((m_inputLayout->instanceSlotMask & (1u << slot)) && instanceCount)
+		{
+			uint64_t end = stream.offset + (uint64_t(startInstance) + instanceCount - 1) * stream.stride +
+						   m_inputLayout->slotBytes[slot];
+			if (end > stream.buffer->buffer.size)
+				Error("%s: instances %u+%u run past vertex buffer slot %u", call, startInstance, instanceCount, slot);
+		}
+	}
+
+	for (uint32_t stage = 0; stage < StageCount; ++stage)
+	{
+		if (!m_shaders[stage])
+			continue;
+		for (uint32_t slot = 0; slot < ConstantBufferSlots; ++slot)
+		{
+			if (m_constantBuffers[stage][slot] && m_constantBuffers[stage][slot]->mapped)
+				Error("%s: %s constant buffer slot %u is mapped", call, StageNames[stage], slot);
+		}
+	}
+}
+
+void NullRenderDevice::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	(void)baseVertex;
+	CheckDraw("DrawIndexed", indexCount, startIndex, 0, 0);
+	++m_stats.draws;
+	++m_stats.instances;
+	m_stats.indices += indexCount;
+	m_stats.primitives += PrimitiveCount(m_topology, indexCount);
+}
+
+void NullRenderDevice::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+											int32_t baseVertex, uint32_t startInstance)
+{
+	(void)baseVertex;
+	CheckDraw("DrawIndexedInstanced", indexCount, startIndex, instanceCount, startInstance);
+	++m_stats.draws;
+	m_stats.instances += instanceCount;
+	m_stats.indices += uint64_t(indexCount) * instanceCount;
+	m_stats.primitives += PrimitiveCount(m_topology, indexCount) * instanceCount;
+}
+
+void NullRenderDevice::UpdateBuffer(const void* buffer, const void* data, uint32_t size)
+{
+	if (!buffer || !data)
+	{
+		Error("UpdateBuffer: null buffer or data");
+		return;
+	}
+	Object* object = Find(buffer, KindBuffer, "UpdateBuffer");
+	if (!object)
+		return;
+	if (object->buffer.usage != UsageDefault || size > object->buffer.size)
+	{
+		Error("UpdateBuffer: buffer %p is not default usage or is smaller than %u bytes", buffer, size);
+		return;
+	}
+
+	++m_stats.updates;
+	m_stats.uploadBytes += size;
+}
+
+void NullRenderDevice::ResetFrameStats(void)
+{
+	memset(m_stats.calls, 0, sizeof(m_stats.calls));
+	m_stats.draws = 0;
+	m_stats.instances = 0;
+	m_stats.indices = 0;
+	m_stats.primitives = 0;
+	m_stats.maps = 0;
+	m_stats.updates = 0;
+	m_stats.uploadBytes = 0;
+	m_stats.clears = 0;
+	m_stats.minLodChanges = 0;
+}
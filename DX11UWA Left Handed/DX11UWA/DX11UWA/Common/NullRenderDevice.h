@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderDevice.h"
+
+// Device and context that create nothing on a GPU. Every handle stands for a record of what was
+// asked for, and every call on the context is checked against those records: handle kinds,
+// bind flags and usages, buffer ranges, shader stages, topology against the tessellation
+// stages, buffers left mapped while bound. Calls, draws and uploaded bytes are counted, and so
+// are errors, with the first few messages kept, so a headless run can fail a CI job the way
+// the debug layer stops one on Windows.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct NullDeviceStats
+	{
+		// Live objects and the memory they would take.
+		uint32_t buffers;
+		uint32_t textures;
+		uint32_t shaders;
+		uint32_t inputLayouts;
+		uint32_t rasterizerStates;
+		uint32_t samplers;
+		uint64_t bufferBytes;
+		uint64_t textureBytes;
+
+		// Counted since the last ResetFrameStats.
+		uint32_t calls[StateCallCount];
+		uint32_t draws;
+		uint64_t instances;
+		uint64_t indices;
+		uint64_t primitives;
+		uint32_t maps;
+		uint32_t updates;		// UpdateBuffer and WriteBuffer.
+		uint64_t uploadBytes;	// Initial data and updates; what goes through Map isn't known.
+		uint32_t clears;
+		uint32_t minLodChanges;
+	};
+
+	class NullRenderDevice : public IRenderDevice, public IRenderBackend
+	{
+	public:
+		static const uint32_t VertexBufferSlots = 16;
+		static const uint32_t ConstantBufferSlots = 14;
+		static const uint32_t ShaderResourceSlots = 128;
+		static const uint32_t SamplerSlots = 16;
+		static const uint32_t MaxKeptErrors = 16;
+
+		NullRenderDevice();
+
+		const void* CreateBuffer(const BufferDesc& desc, const void* initialData) override;
+		const void* CreateTexture(const TextureDesc& desc, const void* initialData) override;
+		const void* CreateShader(ShaderStage stage, const void* bytecode, size_t size) override;
+		const void* CreateInputLayout(const InputElement* elements, uint32_t count,
+									  const void* vertexShaderBytecode, size_t size) override;
+		const void* CreateRasterizerState(const RasterizerDesc& desc) override;
+		const void* CreateSampler(const SamplerDesc& desc) override;
+		void Release(const void* handle) override;
+		void* Map(const void* buffer, bool discard) override;
+		void Unmap(const void* buffer) override;
+		// Binds by offset; has no deferred contexts.
+		DeviceCaps GetCaps(void) const override;
+		// The buffer's own handle.
+		const void* GetBufferView(const void* buffer) override;
+		IRenderBackend& GetContext(void) override { return *this; }
+		void WriteBuffer(const void* buffer, uint32_t offset, const void* data, uint32_t size) override;
+		void SetTextureMinLod(const void* texture, float lod) override;
+		void ClearDepth(void) override;
+		// Each reports an error, as GetCaps offers no deferred contexts.
+		IRenderBackend& BeginDeferred(uint32_t index) override;
+		bool FinishDeferred(uint32_t index) override;
+		void ExecuteDeferred(uint32_t index) override;
+
+		void SetInputLayout(const void* layout) override;
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) override;
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetShader(ShaderStage stage, const void* shader) override;
+		void SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+							   uint32_t firstConstant, uint32_t constantCount) override;
+		void SetShaderResource(ShaderStage stage, uint32_t slot, const void* view) override;
+		void SetSampler(ShaderStage stage, uint32_t slot, const void* sampler) override;
+		void SetRasterizerState(const void* state) override;
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+								  int32_t baseVertex, uint32_t startInstance) override;
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size) override;
+
+		// Clears the per-frame counters; the live object counts stay.
+		void ResetFrameStats(void);
+		const NullDeviceStats& GetStats(void) const { return m_stats; }
+
+		uint32_t GetErrorCount(void) const { return m_errorCount; }
+		// The first MaxKeptErrors messages.
+		const std::vector<std::string>& GetErrors(void) const { return m_errors; }
+
+	private:
+		enum ObjectKind : uint32_t
+		{
+			KindBuffer = 0,
+			KindTexture,
+			KindShader,
+			KindInputLayout,
+			KindRasterizerState,
+			KindSampler
+		};
+
+		struct Object
+		{
+			ObjectKind kind;
+			BufferDesc buffer;
+			ShaderStage stage;
+			uint32_t mipLevels;				// Textures.
+			uint64_t bytes;
+			bool mapped;
+			std::vector<uint8_t> memory;	// Backs Map for dynamic buffers.
+			uint32_t slotMask;				// Input layouts: vertex buffer slots read,
+			uint32_t instanceSlotMask;		// those stepped per instance,
+			uint32_t slotBytes[VertexBufferSlots];	// and the bytes read from each per element.
+		};
+
+		struct VertexStream
+		{
+			Object* buffer;
+			uint32_t stride;
+			uint32_t offset;
+		};
+
+		const void* Add(Object& object);
+		void Unbind(const Object* object);
+		// Returns the object behind handle, or null after reporting the error. A null handle
+		// is allowed (unbinding) and returns null without an error.
+		Object* Find(const void* handle, ObjectKind kind, const char* call);
+		void CheckDraw(const char* call, uint32_t indexCount, uint32_t startIndex,
+					   uint32_t instanceCount, uint32_t startInstance);
+		void Error(const char* format, ...);
+
+		std::unordered_map<const void*, Object> m_objects;
+		uintptr_t m_nextHandle;
+
+		// Bound state points straight at the records, which stay put in the map until released.
+		Object* m_inputLayout;
+		VertexStream m_vertexStreams[VertexBufferSlots];
+		Object* m_indexBuffer;
+		uint32_t m_indexFormat;
+		uint32_t m_indexOffset;
+		uint32_t m_topology;
+		Object* m_shaders[StageCount];
+		Object* m_constantBuffers[StageCount][ConstantBufferSlots];
+
+		NullDeviceStats m_stats;
+		uint32_t m_errorCount;
+		std::vector<std::string> m_errors;
+	};
+}
@@ -0,0 +1,113 @@
+#include "ObjMesh.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace DX;
+
+#ifdef _MSC_VER
+#define ScanLine sscanf_s
+#else
+#define ScanLine sscanf
+#endif
+
+namespace
+{
+	FILE* OpenFile(const char* path)
+	{
+#ifdef _MSC_VER
+		FILE* file = nullptr;
+		return fopen_s(&file, path, "r") == 0 ? file : nullptr;
+#else
+		return fopen(path, "r");
+#endif
+	}
+
+	struct Float3
+	{
+		float v[3];
+	};
+
+	// OBJ indices are 1-based; returns false when index doesn't name one of count elements.
+	bool Resolve(int index, size_t count, size_t& out)
+	{
+		if (index < 1 || size_t(index) > count)
+			return false;
+		out = size_t(index) - 1;
+		return true;
+	}
+}
+
+bool DX::LoadObjMesh(const char* path, std::vector<ObjVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	vertices.clear();
+	indices.clear();
+
+	FILE* file = OpenFile(path);
+	if (!file)
+		return false;
+
+	std::vector<Float3> positions;
+	std::vector<Float3> uvs;
+	std::vector<Float3> normals;
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		Float3 value = {};
+		int corners[9];
+		if (strncmp(line, "v ", 2) == 0)
+		{
+			if (ScanLine(line + 2, "%f %f %f", &value.v[0], &value.v[1], &value.v[2]) == 3)
+				positions.push_back(value);
+		}
+		else if (strncmp(line, "vt ", 3) == 0)
+		{
+			if (ScanLine(line + 3, "%f %f", &value.v[0], &value.v[1]) == 2)
+			{
+				if (value.v[0] > 1.0f)
+				{
+					value.v[0] /= 520.0f;
+					value.v[1] /= 520.0f;
+				}
+				uvs.push_back(value);
+			}
+		}
+		else if (strncmp(line, "vn ", 3) == 0)
+		{
+			if (ScanLine(line + 3, "%f %f %f", &value.v[0], &value.v[1], &value.v[2]) == 3)
+				normals.push_back(value);
+		}
+		else if (strncmp(line, "f ", 2) == 0)
+		{
+			if (ScanLine(line + 2, "%d/%d/%d %d/%d/%d %d/%d/%d", &corners[0], &corners[1], &corners[2], &corners[3],
+						 &corners[4], &corners[5], &corners[6], &corners[7], &corners[8]) != 9)
+				continue;
+
+			ObjVertex face[3];
+			bool valid = true;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				size_t p, t, n;
+				valid = Resolve(corners[corner * 3], positions.size(), p) &&
+						Resolve(corners[corner * 3 + 1], uvs.size(), t) &&
+						Resolve(corners[corner * 3 + 2], normals.size(), n);
+				if (!valid)
+					break;
+				memcpy(face[corner].pos, positions[p].v, sizeof(face[corner].pos));
+				memcpy(face[corner].uv, uvs[t].v, sizeof(face[corner].uv));
+				memcpy(face[corner].normal, normals[n].v, sizeof(face[corner].normal));
+			}
+			if (!valid)
+				continue;
+
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				indices.push_back(static_cast<uint32_t>(vertices.size()));
+				vertices.push_back(face[corner]);
+			}
+		}
+	}
+
+	fclose(file);
+	return true;
+}
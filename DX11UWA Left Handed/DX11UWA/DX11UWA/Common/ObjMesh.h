@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Reader for the Wavefront OBJ files in Assets. Faces must be triangles with position, texture
+// and normal indices (f p/t/n p/t/n p/t/n). Every face corner becomes its own vertex, so the
+// index list simply counts up. Texture coordinates above 1 are taken to be in pixels of a
+// 520-pixel texture, as the exporter wrote them.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	// Same layout as VertexPositionUVNormal; uv.z is free for an array slice.
+	struct ObjVertex
+	{
+		float pos[3];
+		float uv[3];
+		float normal[3];
+	};
+
+	// Returns false if the file can't be opened. Faces that refer to missing elements are skipped.
+	bool LoadObjMesh(const char* path, std::vector<ObjVertex>& vertices, std::vector<uint32_t>& indices);
+}
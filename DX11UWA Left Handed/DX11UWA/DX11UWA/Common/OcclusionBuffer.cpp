@@ -0,0 +1,502 @@
+#include "OcclusionBuffer.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t BlockSize = OcclusionBuffer::BlockSize;
+	const float Far = 1.0f;
+
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4 + 0] * b[0 + column] + a[row * 4 + 1] * b[4 + column] +
+										a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	void TransformPoint(const float m[16], float x, float y, float z, float out[4])
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			out[column] = x * m[column] + y * m[4 + column] + z * m[8 + column] + m[12 + column];
+		}
+	}
+
+	// Clips a triangle against the near plane (z >= 0) and returns the number of polygon vertices, 0 to 4.
+	int ClipNear(const float* in[3], float out[4][4])
+	{
+		int count = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const float* from = in[i];
+			const float* to = in[(i + 1) % 3];
+			if (from[2] >= 0.0f)
+			{
+				std::copy(from, from + 4, out[count++]);
+			}
+			if ((from[2] >= 0.0f) != (to[2] >= 0.0f))
+			{
+				float t = from[2] / (from[2] - to[2]);
+				for (int c = 0; c < 4; ++c)
+				{
+					out[count][c] = from[c] + (to[c] - from[c]) * t;
+				}
+				out[count++][2] = 0.0f;
+			}
+		}
+		return count;
+	}
+
+	// Writes min(depth, plane) to the 8x8 block for the samples inside all three edges. e holds the
+	// edge functions and z the depth at the block's first sample; covered skips the edge tests.
+	void RasterBlock(float* depth, size_t pitch, const float e[3], const float a[3], const float b[3],
+					 float z, float dzdx, float dzdy, bool covered)
+	{
+#if DX_SIMD_AVX2
+		const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 zStep = _mm256_mul_ps(_mm256_set1_ps(dzdx), lane);
+		__m256 eStep[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			eStep[i] = _mm256_mul_ps(_mm256_set1_ps(a[i]), lane);
+		}
+		for (uint32_t row = 0; row < BlockSize; ++row, depth += pitch)
+		{
+			__m256 plane = _mm256_add_ps(_mm256_set1_ps(z + dzdy * float(row)), zStep);
+			__m256 current = _mm256_loadu_ps(depth);
+			__m256 nearer = _mm256_min_ps(current, plane);
+			if (!covered)
+			{
+				__m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[0] + b[0] * float(row)), eStep[0]), zero, _CMP_GE_OQ);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[1] + b[1] * float(row)), eStep[1]), zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e[2] + b[2] * float(row)), eStep[2]), zero, _CMP_GE_OQ));
+				nearer = _mm256_blendv_ps(current, nearer, inside);
+			}
+			_mm256_storeu_ps(depth, nearer);
+		}
+#elif DX_SIMD_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		__m128 lane[2] = { _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f) };
+		for (uint32_t row = 0; row < BlockSize; ++row, depth += pitch)
+		{
+			float eRow[3] = { e[0] + b[0] * float(row), e[1] + b[1] * float(row), e[2] + b[2] * float(row) };
+			__m128 zRow = _mm_set1_ps(z + dzdy * float(row));
+			for (int half = 0; half < 2; ++half)
+			{
+				__m128 plane = _mm_add_ps(zRow, _mm_mul_ps(_mm_set1_ps(dzdx), lane[half]));
+				__m128 current = _mm_loadu_ps(depth + half * 4);
+				__m128 nearer = _mm_min_ps(current, plane);
+				if (!covered)
+				{
+					__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(eRow[0]), _mm_mul_ps(_mm_set1_ps(a[0]), lane[half])), zero);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(eRow[1]), _mm_mul_ps(_mm_set1_ps(a[1]), lane[half])), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(eRow[2]), _mm_mul_ps(_mm_set1_ps(a[2]), lane[half])), zero));
+					nearer = _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current));
+				}
+				_mm_storeu_ps(depth + half * 4, nearer);
+			}
+		}
+#else
+		for (uint32_t row = 0; row < BlockSize; ++row, depth += pitch)
+		{
+			float eRow[3] = { e[0] + b[0] * float(row), e[1] + b[1] * float(row), e[2] + b[2] * float(row) };
+			float zRow = z + dzdy * float(row);
+			for (uint32_t x = 0; x < BlockSize; ++x)
+			{
+				if (!covered && (eRow[0] + a[0] * float(x) < 0.0f || eRow[1] + a[1] * float(x) < 0.0f || eRow[2] + a[2] * float(x) < 0.0f))
+					continue;
+				float plane = zRow + dzdx * float(x);
+				depth[x] = plane < depth[x] ? plane : depth[x];
+			}
+		}
+#endif
+	}
+
+	float BlockMaxDepth(const float* depth, size_t pitch)
+	{
+#if DX_SIMD_AVX2
+		__m256 farthest = _mm256_loadu_ps(depth);
+		for (uint32_t row = 1; row < BlockSize; ++row)
+		{
+			farthest = _mm256_max_ps(farthest, _mm256_loadu_ps(depth + row * pitch));
+		}
+		__m128 half = _mm_max_ps(_mm256_castps256_ps128(farthest), _mm256_extractf128_ps(farthest, 1));
+		half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+		return _mm_cvtss_f32(half);
+#elif DX_SIMD_SSE2
+		__m128 farthest = _mm_max_ps(_mm_loadu_ps(depth), _mm_loadu_ps(depth + 4));
+		for (uint32_t row = 1; row < BlockSize; ++row)
+		{
+			farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(depth + row * pitch), _mm_loadu_ps(depth + row * pitch + 4)));
+		}
+		farthest = _mm_max_ps(farthest, _mm_movehl_ps(farthest, farthest));
+		farthest = _mm_max_ss(farthest, _mm_shuffle_ps(farthest, farthest, 1));
+		return _mm_cvtss_f32(farthest);
+#else
+		float farthest = depth[0];
+		for (uint32_t row = 0; row < BlockSize; ++row)
+		{
+			for (uint32_t x = 0; x < BlockSize; ++x)
+			{
+				farthest = depth[row * pitch + x] > farthest ? depth[row * pitch + x] : farthest;
+			}
+		}
+		return farthest;
+#endif
+	}
+
+	FILE* OpenFile(const char* path, const char* mode)
+	{
+#if defined(_MSC_VER)
+		FILE* file = nullptr;
+		return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+		return fopen(path, mode);
+#endif
+	}
+
+	// True if any pixel in columns [x0, x1] of rows [0, rows) is at or behind z.
+	bool AnyAtOrBehind(const float* depth, size_t pitch, uint32_t x0, uint32_t x1, uint32_t rows, float z)
+	{
+#if DX_SIMD_AVX2
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256 columns = _mm256_castsi256_ps(_mm256_and_si256(
+			_mm256_cmpgt_epi32(lane, _mm256_set1_epi32(int(x0) - 1)),
+			_mm256_cmpgt_epi32(_mm256_set1_epi32(int(x1) + 1), lane)));
+		const __m256 limit = _mm256_set1_ps(z);
+		for (uint32_t row = 0; row < rows; ++row, depth += pitch)
+		{
+			__m256 behind = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(depth), limit, _CMP_GE_OQ), columns);
+			if (_mm256_movemask_ps(behind))
+				return true;
+		}
+		return false;
+#elif DX_SIMD_SSE2
+		const __m128i lane[2] = { _mm_setr_epi32(0, 1, 2, 3), _mm_setr_epi32(4, 5, 6, 7) };
+		__m128 columns[2];
+		for (int half = 0; half < 2; ++half)
+		{
+			columns[half] = _mm_castsi128_ps(_mm_and_si128(
+				_mm_cmpgt_epi32(lane[half], _mm_set1_epi32(int(x0) - 1)),
+				_mm_cmpgt_epi32(_mm_set1_epi32(int(x1) + 1), lane[half])));
+		}
+		const __m128 limit = _mm_set1_ps(z);
+		for (uint32_t row = 0; row < rows; ++row, depth += pitch)
+		{
+			__m128 behind = _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(depth), limit), columns[0]),
+									  _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(depth + 4), limit), columns[1]));
+			if (_mm_movemask_ps(behind))
+				return true;
+		}
+		return false;
+#else
+		for (uint32_t row = 0; row < rows; ++row, depth += pitch)
+		{
+			for (uint32_t x = x0; x <= x1; ++x)
+			{
+				if (depth[x] >= z)
+					return true;
+			}
+		}
+		return false;
+#endif
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+{
+	Resize(width, height);
+}
+
+void OcclusionBuffer::Resize(uint32_t width, uint32_t height)
+{
+	m_tilesX = std::max(1u, (width + TileWidth - 1) / TileWidth);
+	m_tilesY = std::max(1u, (height + TileHeight - 1) / TileHeight);
+	m_width = m_tilesX * TileWidth;
+	m_height = m_tilesY * TileHeight;
+	m_blocksX = m_width / BlockSize;
+
+	m_depth.assign(size_t(m_width) * m_height, Far);
+	m_blockMax.assign(size_t(m_blocksX) * (m_height / BlockSize), Far);
+	m_bins.assign(size_t(m_tilesX) * m_tilesY, std::vector<uint32_t>());
+	m_triangles.clear();
+	std::fill(m_viewProjection, m_viewProjection + 16, 0.0f);
+}
+
+void OcclusionBuffer::BeginFrame(const float viewProjection[16])
+{
+	std::copy(viewProjection, viewProjection + 16, m_viewProjection);
+	std::fill(m_depth.begin(), m_depth.end(), Far);
+	std::fill(m_blockMax.begin(), m_blockMax.end(), Far);
+	m_triangles.clear();
+	for (std::vector<uint32_t>& bin : m_bins)
+	{
+		bin.clear();
+	}
+}
+
+void OcclusionBuffer::AddOccluder(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount,
+								  const float world[16])
+{
+	float worldViewProjection[16];
+	Multiply(world, m_viewProjection, worldViewProjection);
+
+	const uint8_t* vertices = reinterpret_cast<const uint8_t*>(positions);
+	for (size_t i = 0; i + 3 <= indexCount; i += 3)
+	{
+		float clip[3][4];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			const float* p = reinterpret_cast<const float*>(vertices + indices[i + corner] * stride);
+			TransformPoint(worldViewProjection, p[0], p[1], p[2], clip[corner]);
+		}
+
+		// Skip triangles entirely outside one side of the frustum.
+		bool outside = false;
+		for (int axis = 0; axis < 2 && !outside; ++axis)
+		{
+			outside = (clip[0][axis] > clip[0][3] && clip[1][axis] > clip[1][3] && clip[2][axis] > clip[2][3]) ||
+					  (clip[0][axis] < -clip[0][3] && clip[1][axis] < -clip[1][3] && clip[2][axis] < -clip[2][3]);
+		}
+		outside = outside || (clip[0][2] > clip[0][3] && clip[1][2] > clip[1][3] && clip[2][2] > clip[2][3]);
+		if (outside)
+			continue;
+
+		if (clip[0][2] >= 0.0f && clip[1][2] >= 0.0f && clip[2][2] >= 0.0f)
+		{
+			AddTriangle(clip[0], clip[1], clip[2]);
+			continue;
+		}
+
+		const float* in[3] = { clip[0], clip[1], clip[2] };
+		float polygon[4][4];
+		int count = ClipNear(in, polygon);
+		for (int fan = 2; fan < count; ++fan)
+		{
+			AddTriangle(polygon[0], polygon[fan - 1], polygon[fan]);
+		}
+	}
+}
+
+void OcclusionBuffer::AddTriangle(const float v0[4], const float v1[4], const float v2[4])
+{
+	const float* clip[3] = { v0, v1, v2 };
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		if (clip[i][3] <= 0.0f)
+			return;
+		float invW = 1.0f / clip[i][3];
+		x[i] = (clip[i][0] * invW * 0.5f + 0.5f) * float(m_width);
+		y[i] = (0.5f - clip[i][1] * invW * 0.5f) * float(m_height);
+		z[i] = clip[i][2] * invW;
+	}
+
+	// Both windings occlude; flip clockwise triangles so every edge function is positive inside.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.0f || !(fabsf(area) < 1e30f))
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(z[1], z[2]);
+		area = -area;
+	}
+
+	float minX = std::min(x[0], std::min(x[1], x[2])) - 0.5f;
+	float maxX = std::max(x[0], std::max(x[1], x[2])) - 0.5f;
+	float minY = std::min(y[0], std::min(y[1], y[2])) - 0.5f;
+	float maxY = std::max(y[0], std::max(y[1], y[2])) - 0.5f;
+	Triangle triangle;
+	triangle.minX = static_cast<int32_t>(ceilf(std::max(minX, 0.0f)));
+	triangle.minY = static_cast<int32_t>(ceilf(std::max(minY, 0.0f)));
+	triangle.maxX = static_cast<int32_t>(floorf(std::min(maxX, float(m_width - 1))));
+	triangle.maxY = static_cast<int32_t>(floorf(std::min(maxY, float(m_height - 1))));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		int next = (i + 1) % 3;
+		triangle.ox[i] = x[i];
+		triangle.oy[i] = y[i];
+		triangle.a[i] = y[i] - y[next];
+		triangle.b[i] = x[next] - x[i];
+	}
+
+	float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+	float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+	triangle.z0 = z[0];
+	triangle.dzdx = (dz1 * dy2 - dz2 * dy1) / area;
+	triangle.dzdy = (dx1 * dz2 - dx2 * dz1) / area;
+
+	uint32_t index = static_cast<uint32_t>(m_triangles.size());
+	m_triangles.push_back(triangle);
+	for (uint32_t ty = triangle.minY / TileHeight; ty <= uint32_t(triangle.maxY) / TileHeight; ++ty)
+	{
+		for (uint32_t tx = triangle.minX / TileWidth; tx <= uint32_t(triangle.maxX) / TileWidth; ++tx)
+		{
+			m_bins[ty * m_tilesX + tx].push_back(index);
+		}
+	}
+}
+
+void OcclusionBuffer::Rasterize(void)
+{
+	if (m_triangles.empty())
+		return;
+
+	// Tiles own disjoint pixels and blocks, so they need no synchronization.
+	WorkerPool::Shared().ParallelFor(m_bins.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; ++tile)
+		{
+			RasterizeTile(static_cast<uint32_t>(tile));
+		}
+	});
+}
+
+void OcclusionBuffer::RasterizeTile(uint32_t tile)
+{
+	const int32_t tileX = int32_t(tile % m_tilesX * TileWidth);
+	const int32_t tileY = int32_t(tile / m_tilesX * TileHeight);
+	const float span = float(BlockSize - 1);
+
+	for (uint32_t index : m_bins[tile])
+	{
+		const Triangle& triangle = m_triangles[index];
+		int32_t blockX0 = std::max(triangle.minX, tileX) / int32_t(BlockSize);
+		int32_t blockX1 = std::min(triangle.maxX, tileX + int32_t(TileWidth) - 1) / int32_t(BlockSize);
+		int32_t blockY0 = std::max(triangle.minY, tileY) / int32_t(BlockSize);
+		int32_t blockY1 = std::min(triangle.maxY, tileY + int32_t(TileHeight) - 1) / int32_t(BlockSize);
+
+		for (int32_t blockY = blockY0; blockY <= blockY1; ++blockY)
+		{
+			float sampleY = float(blockY * BlockSize) + 0.5f;
+			for (int32_t blockX = blockX0; blockX <= blockX1; ++blockX)
+			{
+				float sampleX = float(blockX * BlockSize) + 0.5f;
+
+				// The edge functions are linear, so the block's corner samples bound every sample in it.
+				float e[3];
+				bool covered = true;
+				bool missed = false;
+				for (int i = 0; i < 3; ++i)
+				{
+					e[i] = triangle.a[i] * (sampleX - triangle.ox[i]) + triangle.b[i] * (sampleY - triangle.oy[i]);
+					float low = e[i] + std::min(0.0f, triangle.a[i] * span) + std::min(0.0f, triangle.b[i] * span);
+					float high = e[i] + std::max(0.0f, triangle.a[i] * span) + std::max(0.0f, triangle.b[i] * span);
+					missed = missed || high < 0.0f;
+					covered = covered && low >= 0.0f;
+				}
+				if (missed)
+					continue;
+
+				// Skip the block when the triangle's plane is behind everything already in it.
+				float z = triangle.z0 + triangle.dzdx * (sampleX - triangle.ox[0]) + triangle.dzdy * (sampleY - triangle.oy[0]);
+				float nearest = z + std::min(0.0f, triangle.dzdx * span) + std::min(0.0f, triangle.dzdy * span);
+				float& blockMax = m_blockMax[size_t(blockY) * m_blocksX + blockX];
+				if (nearest >= blockMax)
+					continue;
+
+				float* depth = &m_depth[size_t(blockY * BlockSize) * m_width + blockX * BlockSize];
+				RasterBlock(depth, m_width, e, triangle.a, triangle.b, z, triangle.dzdx, triangle.dzdy, covered);
+				blockMax = BlockMaxDepth(depth, m_width);
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::TestBox(const float min[3], const float max[3]) const
+{
+	float minX = float(m_width), maxX = -1.0f;
+	float minY = float(m_height), maxY = -1.0f;
+	float nearest = Far;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float clip[4];
+		TransformPoint(m_viewProjection, (corner & 1) ? max[0] : min[0], (corner & 2) ? max[1] : min[1],
+					   (corner & 4) ? max[2] : min[2], clip);
+		if (clip[2] < 0.0f || clip[3] <= 0.0f)
+			return true;
+
+		float invW = 1.0f / clip[3];
+		float x = (clip[0] * invW * 0.5f + 0.5f) * float(m_width);
+		float y = (0.5f - clip[1] * invW * 0.5f) * float(m_height);
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip[2] * invW);
+	}
+
+	// Every pixel the box's screen rectangle touches.
+	int32_t x0 = static_cast<int32_t>(floorf(std::max(minX, 0.0f)));
+	int32_t y0 = static_cast<int32_t>(floorf(std::max(minY, 0.0f)));
+	int32_t x1 = static_cast<int32_t>(floorf(std::min(maxX, float(m_width - 1))));
+	int32_t y1 = static_cast<int32_t>(floorf(std::min(maxY, float(m_height - 1))));
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	const int32_t block = int32_t(BlockSize);
+	for (int32_t blockY = y0 / block; blockY <= y1 / block; ++blockY)
+	{
+		for (int32_t blockX = x0 / block; blockX <= x1 / block; ++blockX)
+		{
+			// The box is hidden in this block if even its nearest point is behind the block's farthest pixel.
+			if (m_blockMax[size_t(blockY) * m_blocksX + blockX] < nearest)
+				continue;
+
+			int32_t top = std::max(y0, blockY * block);
+			int32_t bottom = std::min(y1, blockY * block + block - 1);
+			uint32_t left = uint32_t(std::max(x0, blockX * block) - blockX * block);
+			uint32_t right = uint32_t(std::min(x1, blockX * block + block - 1) - blockX * block);
+			const float* depth = &m_depth[size_t(top) * m_width + blockX * block];
+			if (AnyAtOrBehind(depth, m_width, left, right, uint32_t(bottom - top + 1), nearest))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool OcclusionBuffer::WriteDepthImage(const char* path) const
+{
+	float nearest = Far;
+	float farthest = 0.0f;
+	for (float depth : m_depth)
+	{
+		if (depth < Far)
+		{
+			nearest = std::min(nearest, depth);
+			farthest = std::max(farthest, depth);
+		}
+	}
+
+	std::vector<uint8_t> pixels(m_depth.size());
+	float scale = farthest > nearest ? 191.0f / (farthest - nearest) : 0.0f;
+	for (size_t i = 0; i < m_depth.size(); ++i)
+	{
+		pixels[i] = m_depth[i] < Far ? static_cast<uint8_t>(255.0f - (m_depth[i] - nearest) * scale) : 0;
+	}
+
+	FILE* file = OpenFile(path, "wb");
+	if (!file)
+		return false;
+	fprintf(file, "P5\n%u %u\n255\n", m_width, m_height);
+	bool written = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	return fclose(file) == 0 && written;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Low-resolution CPU depth buffer for occlusion culling. Large occluders are rasterized into
+// it each frame, and the boxes of everything else are tested against it before submission.
+// Depth is kept per pixel and summarized per 8x8 block by its farthest value; the blocks let
+// the rasterizer skip triangles hidden behind what is already drawn and let most box tests
+// finish without reading pixels. Rasterization runs per tile across the shared worker pool,
+// eight pixels at a time with AVX2, four with SSE2, or one at a time otherwise.
+// Matrices follow the DirectXMath layout: row-major, row vectors, and a clip-space depth range
+// of [0, w] where 0 is the near plane.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class OcclusionBuffer
+	{
+	public:
+		static const uint32_t BlockSize = 8;		// Pixels per side of a hierarchical depth block.
+		static const uint32_t TileWidth = 64;		// Pixels per rasterizer bin; one bin is one job.
+		static const uint32_t TileHeight = 32;
+
+		// Sizes are rounded up to whole tiles.
+		explicit OcclusionBuffer(uint32_t width = 320, uint32_t height = 192);
+
+		void Resize(uint32_t width, uint32_t height);
+		uint32_t GetWidth(void) const { return m_width; }
+		uint32_t GetHeight(void) const { return m_height; }
+
+		// Clears depth to the far plane and drops the triangles of the previous frame.
+		void BeginFrame(const float viewProjection[16]);
+
+		// Transforms an indexed triangle list by world and the frame's view-projection, clips it
+		// against the near plane and bins it for Rasterize. positions points at the first float3;
+		// stride is the distance between vertices in bytes. Both faces of each triangle occlude.
+		void AddOccluder(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount,
+						 const float world[16]);
+
+		// Rasterizes every binned triangle. Call once after the last AddOccluder of the frame.
+		void Rasterize(void);
+
+		// False when the world-space box is certainly hidden behind the rasterized occluders or
+		// lies entirely off screen. Boxes that cross the near plane always count as visible.
+		bool TestBox(const float min[3], const float max[3]) const;
+
+		// Triangles that survived clipping this frame.
+		size_t GetTriangleCount(void) const { return m_triangles.size(); }
+
+		// Row-major depth values, 1 where nothing was drawn.
+		const float* GetDepthData(void) const { return m_depth.data(); }
+		float GetDepth(uint32_t x, uint32_t y) const { return m_depth[size_t(y) * m_width + x]; }
+
+		// Writes the depth buffer as a binary PGM, nearest occluder brightest and empty pixels
+		// black, for comparing against reference images. Returns false if the file can't be written.
+		bool WriteDepthImage(const char* path) const;
+
+	private:
+		// Screen-space triangle. Each edge function is a * (x - ox) + b * (y - oy), non-negative
+		// inside; keeping the vertex as the origin preserves precision for huge, near-clipped
+		// triangles. Depth is z0 + dzdx * (x - ox[0]) + dzdy * (y - oy[0]).
+		struct Triangle
+		{
+			float ox[3], oy[3];
+			float a[3], b[3];
+			float z0, dzdx, dzdy;
+			int32_t minX, minY, maxX, maxY;	// Pixels whose centers may be covered, inclusive.
+		};
+
+		void AddTriangle(const float v0[4], const float v1[4], const float v2[4]);
+		void RasterizeTile(uint32_t tile);
+
+		uint32_t m_width;
+		uint32_t m_height;
+		uint32_t m_tilesX;
+		uint32_t m_tilesY;
+		uint32_t m_blocksX;
+
+		float m_viewProjection[16];
+		std::vector<float> m_depth;
+		std::vector<float> m_blockMax;				// Farthest depth in each 8x8 block.
+		std::vector<Triangle> m_triangles;
+		std::vector<std::vector<uint32_t>> m_bins;	// Triangle indices per tile.
+	};
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "StateCache.h"
+
+// Resource creation side of the rendering abstraction. A device creates buffers, textures,
+// shaders, input layouts, rasterizer states and samplers and hands them back as opaque
+// handles, which its context (an IRenderBackend) accepts in the state calls. Formats and topologies use the
+// DXGI and D3D11 enum values, so code written against the interface maps onto Direct3D 11
+// one to one. D3D11RenderDevice is the implementation the app draws with; NullRenderDevice
+// checks and counts the same calls without a GPU.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum BindFlags : uint32_t
+	{
+		BindVertexBuffer = 1,
+		BindIndexBuffer = 2,
+		BindConstantBuffer = 4,
+		BindShaderResource = 8
+	};
+
+	enum ResourceUsage : uint32_t
+	{
+		UsageDefault = 0,	// GPU memory, updated with UpdateBuffer.
+		UsageImmutable,		// Initial data only.
+		UsageDynamic		// Rewritten through Map.
+	};
+
+	// DXGI values of the formats the renderer uses.
+	enum Format : uint32_t
+	{
+		FormatUnknown = 0,
+		FormatR32G32B32A32Float = 2,
+		FormatR32G32B32Float = 6,
+		FormatR32G32Uint = 16,
+		FormatR8G8B8A8Unorm = 28,
+		FormatR32Uint = 42,
+		FormatR16Uint = 57,
+		FormatB8G8R8A8Unorm = 87
+	};
+
+	// D3D11_PRIMITIVE_TOPOLOGY values.
+	enum Topology : uint32_t
+	{
+		TopologyLineList = 2,
+		TopologyTriangleList = 4,
+		TopologyTriangleStrip = 5,
+		TopologyFirstPatchList = 33,	// 1 to 32 control points.
+		TopologyLastPatchList = 64
+	};
+
+	struct BufferDesc
+	{
+		uint32_t size;
+		uint32_t bindFlags;
+		ResourceUsage usage;
+		Format viewFormat;		// Elements of the view of a BindShaderResource buffer.
+	};
+
+	// A texture is created together with the view the shaders read it through: a cube, or else a
+	// Texture2DArray of arraySize slices.
+	struct TextureDesc
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;		// Zero for the full chain.
+		uint32_t arraySize;		// Six for a cube map.
+		Format format;
+		bool cube;
+	};
+
+	struct InputElement
+	{
+		const char* semantic;
+		uint32_t semanticIndex;
+		Format format;
+		uint32_t slot;
+		uint32_t offset;
+		bool perInstance;
+	};
+
+	struct RasterizerDesc
+	{
+		bool cullBack;			// Otherwise nothing is culled.
+		bool frontCounterClockwise;
+		bool wireframe;
+	};
+
+	struct SamplerDesc
+	{
+		bool linear;			// Otherwise point sampling.
+		bool wrap;				// Otherwise clamped.
+	};
+
+	struct DeviceCaps
+	{
+		bool constantOffsets;			// Constant buffers bind by range and dynamic ones map without overwrite.
+		uint32_t deferredContexts;		// Contexts that record on other threads; zero unless the driver builds command lists itself.
+	};
+
+	class IRenderDevice
+	{
+	public:
+		virtual ~IRenderDevice() {}
+
+		// Each returns null on failure. initialData may be null except for immutable resources;
+		// texture data is every mip of every slice, tightly packed, slice-major.
+		virtual const void* CreateBuffer(const BufferDesc& desc, const void* initialData) = 0;
+		virtual const void* CreateTexture(const TextureDesc& desc, const void* initialData) = 0;
+		virtual const void* CreateShader(ShaderStage stage, const void* bytecode, size_t size) = 0;
+		virtual const void* CreateInputLayout(const InputElement* elements, uint32_t count,
+											  const void* vertexShaderBytecode, size_t size) = 0;
+		virtual const void* CreateRasterizerState(const RasterizerDesc& desc) = 0;
+		virtual const void* CreateSampler(const SamplerDesc& desc) = 0;
+		virtual void Release(const void* handle) = 0;
+
+		// Dynamic buffers only. discard asks for fresh memory; otherwise the caller promises not to
+		// touch bytes that earlier draws may still read. Null on failure.
+		virtual void* Map(const void* buffer, bool discard) = 0;
+		virtual void Unmap(const void* buffer) = 0;
+
+		virtual DeviceCaps GetCaps(void) const = 0;
+
+		// The view SetShaderResource takes for a BindShaderResource buffer. It lives as long as the buffer.
+		virtual const void* GetBufferView(const void* buffer) = 0;
+
+		// The context the device's handles are bound on.
+		virtual IRenderBackend& GetContext(void) = 0;
+
+		// Immediate context calls that aren't state and are never recorded.
+		// Copies size bytes of data to offset in a default usage buffer. Constant buffers are written whole.
+		virtual void WriteBuffer(const void* buffer, uint32_t offset, const void* data, uint32_t size) = 0;
+		// Keeps the shaders from sampling mips of texture finer than lod.
+		virtual void SetTextureMinLod(const void* texture, float lod) = 0;
+		// Clears the depth buffer of the render target.
+		virtual void ClearDepth(void) = 0;
+
+		// Deferred context index, for one thread at a time, with the render target bound.
+		virtual IRenderBackend& BeginDeferred(uint32_t index) = 0;
+		// Closes the recording; false if it failed, and there is nothing to execute.
+		virtual bool FinishDeferred(uint32_t index) = 0;
+		// Plays a finished recording on the immediate context, whose state is reset to the defaults
+		// with the render target bound again.
+		virtual void ExecuteDeferred(uint32_t index) = 0;
+	};
+}
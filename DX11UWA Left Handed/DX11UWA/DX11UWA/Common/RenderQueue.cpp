@@ -0,0 +1,93 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Short lists are cheaper to insertion sort than to histogram.
+	const size_t RadixThreshold = 64;
+}
+
+uint32_t DrawKey::QuantizeDepth(float viewDepth, float nearZ, float farZ, bool backToFront)
+{
+	const uint32_t maxDepth = (1u << DepthBits) - 1;
+	float t = (viewDepth - nearZ) / (farZ - nearZ);
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	uint32_t depth = static_cast<uint32_t>(t * float(maxDepth));
+	return backToFront ? maxDepth - depth : depth;
+}
+
+void RenderQueue::Reserve(size_t count)
+{
+	m_packets.reserve(count);
+	m_scratch.reserve(count);
+}
+
+void RenderQueue::Sort(void)
+{
+	m_scratch.resize(m_packets.size());
+	RadixSortPackets(m_packets.data(), m_scratch.data(), m_packets.size());
+}
+
+void DX::RadixSortPackets(DrawPacket* packets, DrawPacket* scratch, size_t count)
+{
+	if (count < RadixThreshold)
+	{
+		for (size_t i = 1; i < count; ++i)
+		{
+			DrawPacket packet = packets[i];
+			size_t j = i;
+			for (; j > 0 && packets[j - 1].key > packet.key; --j)
+			{
+				packets[j] = packets[j - 1];
+			}
+			packets[j] = packet;
+		}
+		return;
+	}
+
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = packets[i].key;
+		for (int digit = 0; digit < 8; ++digit)
+		{
+			++histograms[digit][(key >> (digit * 8)) & 0xff];
+		}
+	}
+
+	DrawPacket* src = packets;
+	DrawPacket* dst = scratch;
+	for (int digit = 0; digit < 8; ++digit)
+	{
+		size_t* histogram = histograms[digit];
+
+		// Every key shares this byte, so the pass wouldn't move anything.
+		if (histogram[(src[0].key >> (digit * 8)) & 0xff] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; ++bucket)
+		{
+			size_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		const int shift = digit * 8;
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != packets)
+	{
+		memcpy(packets, src, count * sizeof(DrawPacket));
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Sorted list of draw packets. Objects submit a 64-bit key plus an index into the caller's
+// own draw table; sorting the keys groups draws by pass, shader and material so the
+// submission loop only changes state when a key field changes.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct DrawPacket
+	{
+		uint64_t key;
+		uint32_t item;      // Index into the caller's draw table.
+		uint32_t user;      // Free for the caller (instance offset, sub-mesh, ...).
+	};
+
+	// Key layout, most significant field first:
+	//   pass (4) | shader (12) | material (12) | mesh (12) | depth (24)
+	// Within one pass, draws are grouped by state and ordered front to back as a tie-breaker.
+	namespace DrawKey
+	{
+		const uint32_t PassBits = 4;
+		const uint32_t ShaderBits = 12;
+		const uint32_t MaterialBits = 12;
+		const uint32_t MeshBits = 12;
+		const uint32_t DepthBits = 24;
+
+		const uint32_t DepthShift = 0;
+		const uint32_t MeshShift = DepthShift + DepthBits;
+		const uint32_t MaterialShift = MeshShift + MeshBits;
+		const uint32_t ShaderShift = MaterialShift + MaterialBits;
+		const uint32_t PassShift = ShaderShift + ShaderBits;
+
+		inline uint64_t Field(uint32_t value, uint32_t bits, uint32_t shift)
+		{
+			return uint64_t(value & ((1u << bits) - 1)) << shift;
+		}
+
+		inline uint64_t Make(uint32_t pass, uint32_t shader, uint32_t material, uint32_t mesh, uint32_t depth)
+		{
+			return Field(pass, PassBits, PassShift) | Field(shader, ShaderBits, ShaderShift) |
+				   Field(material, MaterialBits, MaterialShift) | Field(mesh, MeshBits, MeshShift) |
+				   Field(depth, DepthBits, DepthShift);
+		}
+
+		inline uint32_t Pass(uint64_t key) { return uint32_t(key >> PassShift) & ((1u << PassBits) - 1); }
+		inline uint32_t Shader(uint64_t key) { return uint32_t(key >> ShaderShift) & ((1u << ShaderBits) - 1); }
+		inline uint32_t Material(uint64_t key) { return uint32_t(key >> MaterialShift) & ((1u << MaterialBits) - 1); }
+		inline uint32_t Mesh(uint64_t key) { return uint32_t(key >> MeshShift) & ((1u << MeshBits) - 1); }
+		inline uint32_t Depth(uint64_t key) { return uint32_t(key >> DepthShift) & ((1u << DepthBits) - 1); }
+
+		// Maps a view-space depth in [nearZ, farZ] to the 24-bit depth field. Pass backToFront
+		// for blended passes so that farther draws sort first.
+		uint32_t QuantizeDepth(float viewDepth, float nearZ, float farZ, bool backToFront = false);
+	}
+
+	class RenderQueue
+	{
+	public:
+		void Reserve(size_t count);
+		void Clear(void) { m_packets.clear(); }
+
+		void Submit(uint64_t key, uint32_t item, uint32_t user = 0)
+		{
+			DrawPacket packet = { key, item, user };
+			m_packets.push_back(packet);
+		}
+
+		// Stable sort by key.
+		void Sort(void);
+
+		const DrawPacket* begin(void) const { return m_packets.data(); }
+		const DrawPacket* end(void) const { return m_packets.data() + m_packets.size(); }
+		size_t Size(void) const { return m_packets.size(); }
+
+	private:
+		std::vector<DrawPacket> m_packets;
+		std::vector<DrawPacket> m_scratch;
+	};
+
+	// LSD radix sort on the 64-bit key, one byte per pass. All eight histograms are built in a
+	// single read of the input, and passes where every key has the same byte are skipped, so
+	// the usual case (a few passes and shaders, varying depth) costs three to five passes.
+	// scratch must hold count packets. The result ends up in packets.
+	void RadixSortPackets(DrawPacket* packets, DrawPacket* scratch, size_t count);
+}
@@ -0,0 +1,1509 @@
+#include "SceneRenderer.h"
+
+#include "CubemapBuilder.h"
+#include "DDSFile.h"
+#include "MeshEdges.h"
+#include "ObjMesh.h"
+#include "TessellationCache.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Clip planes of the scene camera; the render queue quantizes object depth over the same range.
+	// With more than one copy the far plane moves out by twice the width they add, enough to reach the far
+	// corner of the grid from a camera circling it.
+	const float NearZ = 0.01f;
+	const float FarZ = 100.0f;
+
+	// The hull shader splits edges into segments about this many pixels long.
+	const float TessellationPixelsPerSegment = 16.0f;
+
+	// Meshes whose pre-tessellated levels would take more vertices than this stay tessellated on the GPU.
+	const size_t MaxPretessellatedVertices = 1 << 20;
+
+	// Size of the per-frame constant ring for one copy of the scene; one slice per draw, 256 bytes or more each.
+	const uint32_t ConstantRingBytes = 64 * 1024;
+
+	// Render queues are recorded in parallel only when every worker gets at least this many packets.
+	const size_t MinPacketsPerCommandList = 256;
+
+	const uint32_t PatchList3 = TopologyFirstPatchList + 2;
+
+	// Materials that sample from the shared texture atlas; the id is the PackInput id.
+	enum MaterialId : uint32_t
+	{
+		MaterialCastle = 0,
+		MaterialPokeball,
+		MaterialCount
+	};
+
+	const char* const MaterialFiles[MaterialCount] = { "Castle1.dds", "pokeball.dds" };
+
+	const char* const SkyboxMeshFile = "SkyboxCube.obj";
+	const char* const SkyboxCubeFile = "OutputCube.dds";
+	const char* const SkyboxEquirectFile = "SkyboxEquirect.dds";
+	// Skybox faces in the Direct3D cube order +X, -X, +Y, -Y, +Z, -Z; Tools/SkyboxGenerator writes them.
+	const char* const SkyboxFaceFiles[6] =
+	{
+		"SkyboxPosX.dds", "SkyboxNegX.dds", "SkyboxPosY.dds", "SkyboxNegY.dds", "SkyboxPosZ.dds", "SkyboxNegZ.dds"
+	};
+
+	// The shaders Load can't do without, in the order LoadShaders creates them.
+	enum RequiredShader : uint32_t
+	{
+		ShaderVertex = 0,
+		ShaderLitVertex,
+		ShaderInstancedVertex,
+		ShaderHull,
+		ShaderDomain,
+		ShaderPyramidPixel,
+		ShaderSkyboxVertex,
+		ShaderSkyboxPixel,
+		RequiredShaderCount
+	};
+
+	const char* const RequiredShaderNames[RequiredShaderCount] =
+	{
+		"SampleVertexShader", "LitVertexShader", "InstancedVertexShader", "HullShader", "DomainShader",
+		"PyramidPixelShader", "SkyboxVertexShader", "SkyboxPixelShader"
+	};
+
+	const ShaderStage RequiredShaderStages[RequiredShaderCount] =
+	{
+		StageVertex, StageVertex, StageVertex, StageHull, StageDomain, StagePixel, StageVertex, StagePixel
+	};
+
+	// The directional, point and spot light of each copy. Each sweeps back and forth along one axis
+	// between -limit and limit, starting from its initial position on the way down; the speeds are
+	// the steps the lights used to take per frame, at 60 frames per second. The directional light
+	// shines at the origin, the spot light down and the way it is moving.
+	const float LightStarts[3][3] = { { -7.0f, 5.0f, 0.0f }, { 5.0f, 1.0f, 5.0f }, { 0.0f, 2.0f, 0.0f } };
+	const float LightColors[3][4] = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } };
+	const LightChannel SweepAxes[3] = { ChannelPositionX, ChannelPositionX, ChannelPositionZ };
+	const float SweepSpeeds[3] = { 30.0f, 12.0f, 6.0f };
+	const float SweepLimits[3] = { 15.0f, 10.0f, 2.0f };
+	const float LightRadius = 10.0f;
+	const float SpotCosInner = 0.8f;
+	const float SpotCosOuter = 0.45f;
+
+	// xorshift32, so the extra lights are the same on every platform.
+	struct Random
+	{
+		uint32_t state;
+
+		float Next(float low, float high)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return low + (high - low) * float(state >> 8) / float(1 << 24);
+		}
+	};
+
+	// Row-major, row-vector matrices as in DirectXMath.
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] +
+										a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	void Transpose(const float in[16], float out[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[column * 4 + row] = in[row * 4 + column];
+			}
+		}
+	}
+
+	void Translation(float x, float y, float z, float out[16])
+	{
+		const float matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1 };
+		std::copy(matrix, matrix + 16, out);
+	}
+
+	void PerspectiveFovLH(float fov, float aspect, float nearZ, float farZ, float out[16])
+	{
+		float height = 1.0f / tanf(fov * 0.5f);
+		float range = farZ / (farZ - nearZ);
+		const float matrix[16] =
+		{
+			height / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, height, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -nearZ * range, 0.0f
+		};
+		std::copy(matrix, matrix + 16, out);
+	}
+
+	void TransformPoint(const float point[3], const float matrix[16], float out[3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			out[i] = point[0] * matrix[i] + point[1] * matrix[4 + i] + point[2] * matrix[8 + i] + matrix[12 + i];
+		}
+	}
+
+	typedef std::chrono::steady_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+#ifdef _MSC_VER
+		FILE* file = nullptr;
+		if (fopen_s(&file, path.c_str(), "rb") != 0)
+			file = nullptr;
+#else
+		FILE* file = fopen(path.c_str(), "rb");
+#endif
+		if (!file)
+			return false;
+
+		fseek(file, 0, SEEK_END);
+		long length = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(length > 0 ? static_cast<size_t>(length) : 0);
+		data.resize(fread(data.data(), 1, data.size(), file));
+		fclose(file);
+		return !data.empty();
+	}
+
+	Format ImageFormat(const DDSImage& image)
+	{
+		return image.bgra ? FormatB8G8R8A8Unorm : FormatR8G8B8A8Unorm;
+	}
+
+	// Texels in one slice of a texture: every mip, tightly packed.
+	size_t SliceTexels(uint32_t width, uint32_t height, uint32_t mipLevels)
+	{
+		size_t texels = 0;
+		for (uint32_t mip = 0; mip < mipLevels; ++mip)
+		{
+			texels += size_t(std::max(width >> mip, 1u)) * std::max(height >> mip, 1u);
+		}
+		return texels;
+	}
+}
+
+const SceneRenderer::MeshInfo SceneRenderer::MeshTable[MeshCount] =
+{
+	{ "floor_bottom.obj", PipelineLit, MaterialCastle, false },
+	{ "floor_platform.obj", PipelineLit, MaterialCastle, true },
+	{ "pokeballred.obj", PipelineLit, MaterialPokeball, false },
+	{ "pokeballwhite.obj", PipelineLit, MaterialPokeball, false },
+	{ "pokeballblack.obj", PipelineLit, MaterialPokeball, false },
+	{ "stadium.obj", PipelineLit, MaterialPokeball, true },
+	{ "sphere.obj", PipelineEdges, MaterialNone, false },
+	{ "pyramid.obj", PipelineInstanced, MaterialNone, false },
+};
+
+SceneRenderer::SceneRenderer(IRenderDevice& device) :
+	m_device(device),
+	m_loaded(false),
+	m_createFailed(false),
+	m_skyboxRasterizerState(nullptr),
+	m_skyboxTexture(nullptr),
+	m_skyboxSource(SkyboxNone),
+	m_sampler(nullptr),
+	m_skyboxResidency(TextureResidency::InvalidHandle),
+	m_root(SceneStore::NullEntity),
+	m_sceneExtent(0.0f),
+	m_constantRingBackend(device),
+	m_constantOffsets(false),
+	m_constantBuffer(nullptr),
+	m_skyboxConstants(),
+	m_instanceBuffer(nullptr),
+	m_instanceCapacity(0),
+	m_directionalLight(0),
+	m_spotTrack(0),
+	m_lightConstantsChanged(true),
+	m_lightBuffer(nullptr),
+	m_lightGridBuffer(nullptr),
+	m_lightGridChanged(true),
+	m_clusterLights(),
+	m_clusterRanges(),
+	m_lightIndices(),
+	m_frameLights(LightPermutationLights),
+	m_viewport(),
+	m_hasViewport(false),
+	m_farZ(FarZ),
+	m_tessellationScale(0.0f)
+{
+	m_stateCache.SetBackend(&m_device.GetContext());
+	memset(m_pipelines, 0, sizeof(m_pipelines));
+	memset(m_lightPixelShaders, 0, sizeof(m_lightPixelShaders));
+	memset(m_skyboxShaders, 0, sizeof(m_skyboxShaders));
+	memset(&m_lightConstants, 0, sizeof(m_lightConstants));
+	memset(&m_frameConstants, 0, sizeof(m_frameConstants));
+	memset(&m_frameStats, 0, sizeof(m_frameStats));
+	Translation(0.0f, 0.0f, 0.0f, m_view);
+	Translation(0.0f, 0.0f, 0.0f, m_projection);
+	memset(m_eye, 0, sizeof(m_eye));
+}
+
+SceneRenderer::~SceneRenderer()
+{
+	Unload();
+}
+
+std::vector<const char*> SceneRenderer::GetShaderNames(void)
+{
+	std::vector<const char*> names(RequiredShaderNames, RequiredShaderNames + RequiredShaderCount);
+	for (uint32_t i = 0; i < LightVariantCount; ++i)
+	{
+		names.push_back(LightVariants[i].name);
+	}
+	return names;
+}
+
+const char* SceneRenderer::GetMeshFile(MeshId mesh)
+{
+	return MeshTable[mesh].file;
+}
+
+bool SceneRenderer::Load(const SceneSettings& settings)
+{
+	Unload();
+	m_settings = settings;
+	m_loadError.clear();
+	m_textureResidency.SetBudget(settings.textureBudget);
+	if (settings.copies == 0 || settings.copies * 2 + settings.extraLights > LightGrid::MaxLights)
+	{
+		char message[96];
+		snprintf(message, sizeof(message), "from 1 copy up to %u lights, two per copy included", LightGrid::MaxLights);
+		return Fail(message);
+	}
+
+	// The material atlas goes first so the meshes' uvs can be moved into it as they load.
+	std::vector<PackedRegion> regions;
+	if (!LoadShaders() || !LoadMaterials(regions) || !LoadMeshes(regions) || !LoadSkybox())
+	{
+		Unload();
+		return false;
+	}
+	CreateScene();
+	CreateLights();
+	if (m_createFailed)
+	{
+		Unload();
+		return Fail("the device failed to create an object");
+	}
+
+	if (m_hasViewport)
+	{
+		UpdateProjection();
+	}
+	m_lightConstantsChanged = true;
+	m_lightGridChanged = true;
+	m_loaded = true;
+	return true;
+}
+
+void SceneRenderer::Unload(void)
+{
+	m_loaded = false;
+	m_stateCache.Invalidate();
+	m_renderQueue.Clear();
+	m_constantRing.Reset(0, nullptr);
+	m_constantRingBackend.SetBuffer(nullptr);
+	ReleaseShaderBuffer(m_clusterLights);
+	ReleaseShaderBuffer(m_clusterRanges);
+	ReleaseShaderBuffer(m_lightIndices);
+	if (m_instanceBuffer)
+	{
+		m_device.Release(m_instanceBuffer);
+	}
+	m_instanceBuffer = nullptr;
+	m_instanceCapacity = 0;
+	for (auto handle = m_handles.rbegin(); handle != m_handles.rend(); ++handle)
+	{
+		m_device.Release(*handle);
+	}
+	m_handles.clear();
+	m_createFailed = false;
+
+	for (MeshData& mesh : m_meshes)
+	{
+		mesh = MeshData();
+	}
+	m_skybox = MeshData();
+	memset(m_pipelines, 0, sizeof(m_pipelines));
+	memset(m_lightPixelShaders, 0, sizeof(m_lightPixelShaders));
+	memset(m_skyboxShaders, 0, sizeof(m_skyboxShaders));
+	m_skyboxRasterizerState = nullptr;
+	m_skyboxTexture = nullptr;
+	m_skyboxSource = SkyboxNone;
+	m_sampler = nullptr;
+	m_constantBuffer = nullptr;
+	m_lightBuffer = nullptr;
+	m_lightGridBuffer = nullptr;
+
+	m_materialPages.clear();
+	m_materialGroups.clear();
+	m_materialAlpha.clear();
+	m_atlasStats = PackStats();
+	m_textureResidency.Clear();
+	m_residentTextures.clear();
+	m_materialResidency.clear();
+	m_skyboxResidency = TextureResidency::InvalidHandle;
+
+	m_scene.Clear();
+	m_root = SceneStore::NullEntity;
+	m_items.clear();
+	m_copyOffsets.clear();
+	m_sceneTree.Clear();
+	m_visibleItems.clear();
+	m_cullStats = CullStats();
+	m_markers.Clear();
+
+	m_lights.Clear();
+	m_copyLights.clear();
+	m_lightAnimation.Clear();
+	m_packedLights.clear();
+	memset(&m_lightConstants.directional, 0, sizeof(m_lightConstants.directional));
+	m_frameLights = LightPermutationLights;
+}
+
+bool SceneRenderer::Fail(const std::string& message)
+{
+	m_loadError = message;
+	return false;
+}
+
+// Keeps a handle for Unload to release. Null handles are failures, which Load reports once
+// everything has been tried.
+const void* SceneRenderer::Keep(const void* handle)
+{
+	if (handle)
+		m_handles.push_back(handle);
+	else
+		m_createFailed = true;
+	return handle;
+}
+
+// Creates every shader from Shaders.dxsa, which the PackShaders build target packs from the .cso
+// files, or from the shader's own .cso when the archive lacks it, with the input layouts and
+// states the pipelines use. LightPixelShader variants may be missing; the lit draws choose among
+// the ones that loaded.
+bool SceneRenderer::LoadShaders(void)
+{
+	std::vector<uint8_t> file;
+	auto find = [&](const char* name)
+	{
+		ShaderBytecode code = { nullptr, 0 };
+		if (m_settings.shaders)
+			code = m_settings.shaders->Find(name);
+		if (!code.data && ReadFile(std::string(name) + ".cso", file))
+		{
+			code.data = file.data();
+			code.size = file.size();
+		}
+		return code;
+	};
+
+	const InputElement vertexElements[] =
+	{
+		{ "POSITION", 0, FormatR32G32B32Float, 0, 0, false },
+		{ "UV", 0, FormatR32G32B32Float, 0, 12, false },
+		{ "NORMAL", 0, FormatR32G32B32Float, 0, 24, false },
+	};
+	// Slot 1 streams the first three columns of each instance's world matrix.
+	const InputElement instancedElements[] =
+	{
+		{ "POSITION", 0, FormatR32G32B32Float, 0, 0, false },
+		{ "UV", 0, FormatR32G32B32Float, 0, 12, false },
+		{ "NORMAL", 0, FormatR32G32B32Float, 0, 24, false },
+		{ "INSTANCE", 0, FormatR32G32B32A32Float, 1, 0, true },
+		{ "INSTANCE", 1, FormatR32G32B32A32Float, 1, 16, true },
+		{ "INSTANCE", 2, FormatR32G32B32A32Float, 1, 32, true },
+	};
+
+	const void* shaders[RequiredShaderCount];
+	const void* inputLayout = nullptr;
+	const void* instancedLayout = nullptr;
+	std::string missing;
+	for (uint32_t i = 0; i < RequiredShaderCount; ++i)
+	{
+		ShaderBytecode code = find(RequiredShaderNames[i]);
+		if (!code.data)
+		{
+			missing += missing.empty() ? RequiredShaderNames[i] : std::string(", ") + RequiredShaderNames[i];
+			shaders[i] = nullptr;
+			continue;
+		}
+		shaders[i] = Keep(m_device.CreateShader(RequiredShaderStages[i], code.data, code.size));
+
+		// LitVertexShader and SkyboxVertexShader have the same input signature, so they share the layout.
+		if (i == ShaderVertex)
+			inputLayout = Keep(m_device.CreateInputLayout(vertexElements, 3, code.data, code.size));
+		else if (i == ShaderInstancedVertex)
+			instancedLayout = Keep(m_device.CreateInputLayout(instancedElements, 6, code.data, code.size));
+	}
+	if (!missing.empty())
+		return Fail("no bytecode in the shader archive or a .cso for " + missing);
+
+	bool available[LightVariantCount];
+	for (uint32_t i = 0; i < LightVariantCount; ++i)
+	{
+		ShaderBytecode code = find(LightVariants[i].name);
+		m_lightPixelShaders[i] = code.data ? Keep(m_device.CreateShader(StagePixel, code.data, code.size)) : nullptr;
+		available[i] = m_lightPixelShaders[i] != nullptr;
+	}
+	m_lightPermutations.Build(available);
+
+	const Pipeline pipelines[PipelineCount] =
+	{
+		{ inputLayout, { shaders[ShaderVertex], shaders[ShaderHull], shaders[ShaderDomain], nullptr, nullptr } },		// PipelineLit
+		{ inputLayout, { shaders[ShaderLitVertex], nullptr, nullptr, nullptr, nullptr } },								// PipelineLitFlat
+		{ inputLayout, { shaders[ShaderLitVertex], nullptr, nullptr, nullptr, shaders[ShaderPyramidPixel] } },			// PipelineEdges
+		{ instancedLayout, { shaders[ShaderInstancedVertex], nullptr, nullptr, nullptr, shaders[ShaderPyramidPixel] } },	// PipelineInstanced
+	};
+	std::copy(pipelines, pipelines + PipelineCount, m_pipelines);
+	m_skyboxShaders[StageVertex] = shaders[ShaderSkyboxVertex];
+	m_skyboxShaders[StagePixel] = shaders[ShaderSkyboxPixel];
+
+	// The camera sits inside the skybox cube, so neither winding may be culled.
+	RasterizerDesc skyboxRasterizer = { false, false, false };
+	m_skyboxRasterizerState = Keep(m_device.CreateRasterizerState(skyboxRasterizer));
+	SamplerDesc samplerDesc = { true, true };
+	m_sampler = Keep(m_device.CreateSampler(samplerDesc));
+	return true;
+}
+
+// Reads the material textures, packs them into atlas pages and builds each page on the CPU, with
+// the outermost texels of every image replicated into its gutter so bilinear filtering doesn't
+// bleed between images. Each group of pages becomes one immutable Texture2DArray.
+bool SceneRenderer::LoadMaterials(std::vector<PackedRegion>& regions)
+{
+	DDSImage images[MaterialCount];
+	std::vector<PackInput> inputs;
+	m_materialAlpha.resize(MaterialCount);
+	for (uint32_t i = 0; i < MaterialCount; ++i)
+	{
+		std::string path = m_settings.assets + "/" + MaterialFiles[i];
+		if (!ReadDDSFile(path.c_str(), images[i]))
+			return Fail(path + ": can't read texture");
+
+		m_materialAlpha[i] = ClassifyImageAlpha(images[i]);
+		PackInput input = { i, images[i].width, images[i].height, ImageFormat(images[i]), images[i].mipLevels, false };
+		inputs.push_back(input);
+	}
+
+	TexturePacker packer;
+	packer.Pack(inputs);
+	m_atlasStats = packer.GetStats();
+
+	regions.resize(MaterialCount);
+	m_materialGroups.resize(MaterialCount);
+	for (uint32_t i = 0; i < MaterialCount; ++i)
+	{
+		const PackedRegion* region = packer.FindRegion(i);
+		if (!region)
+			return Fail(m_settings.assets + "/" + MaterialFiles[i] + ": doesn't fit in an atlas page");
+		regions[i] = *region;
+		m_materialGroups[i] = region->group;
+	}
+
+	const uint32_t gutter = AtlasSettings().gutter;
+	const std::vector<PackedGroup>& groups = packer.GetGroups();
+	for (uint32_t group = 0; group < groups.size(); ++group)
+	{
+		const PackedGroup& pages = groups[group];
+		size_t sliceTexels = SliceTexels(pages.pageWidth, pages.pageHeight, pages.mipLevels);
+		std::vector<uint32_t> texels(sliceTexels * pages.pageCount, 0);
+
+		for (uint32_t i = 0; i < MaterialCount; ++i)
+		{
+			const PackedRegion& region = regions[i];
+			if (region.group != group)
+				continue;
+
+			uint32_t* slice = texels.data() + sliceTexels * region.page;
+			for (uint32_t mip = 0; mip < pages.mipLevels && mip < images[i].mipLevels; ++mip)
+			{
+				uint32_t* page = slice + SliceTexels(pages.pageWidth, pages.pageHeight, mip);
+				uint32_t pageWidth = std::max(pages.pageWidth >> mip, 1u);
+				uint32_t pageHeight = std::max(pages.pageHeight >> mip, 1u);
+				uint32_t x = region.x >> mip;
+				uint32_t y = region.y >> mip;
+				uint32_t width = images[i].LevelWidth(mip);
+				uint32_t height = images[i].LevelHeight(mip);
+				uint32_t mipGutter = gutter >> mip;
+				const uint32_t* source = images[i].Level(0, mip);
+
+				uint32_t top = y - std::min(mipGutter, y);
+				uint32_t bottom = std::min(y + height + mipGutter, pageHeight);
+				uint32_t left = x - std::min(mipGutter, x);
+				uint32_t right = std::min(x + width + mipGutter, pageWidth);
+				for (uint32_t row = top; row < bottom; ++row)
+				{
+					uint32_t sourceRow = std::min(row < y ? 0 : row - y, height - 1);
+					for (uint32_t column = left; column < right; ++column)
+					{
+						uint32_t sourceColumn = std::min(column < x ? 0 : column - x, width - 1);
+						page[size_t(row) * pageWidth + column] = source[size_t(sourceRow) * width + sourceColumn];
+					}
+				}
+			}
+		}
+
+		TextureDesc desc = { pages.pageWidth, pages.pageHeight, pages.mipLevels, pages.pageCount, Format(pages.format), false };
+		const void* texture = Keep(m_device.CreateTexture(desc, texels.data()));
+		m_materialPages.push_back(texture);
+		m_materialResidency.push_back(texture ? RegisterTexture(texture, desc) : TextureResidency::InvalidHandle);
+	}
+	return true;
+}
+
+// Parses and tessellates the meshes on the workers, then uploads them. Lit meshes are drawn without
+// the hull and domain shaders: as they are if tessellation can't improve them, else from
+// pre-tessellated levels. Static meshes only need the GPU to tessellate when those levels would be
+// too large. Edge meshes are drawn the same way, as a line list of each level's unique edges.
+bool SceneRenderer::LoadMeshes(const std::vector<PackedRegion>& regions)
+{
+	struct Source
+	{
+		std::vector<ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+		TessellationCache levels;
+		bool loaded;
+	};
+
+	// The skybox cube goes last.
+	std::vector<Source> sources(MeshCount + 1);
+	auto fileOf = [](size_t mesh) { return mesh < MeshCount ? MeshTable[mesh].file : SkyboxMeshFile; };
+	WorkerPool& pool = WorkerPool::Shared();
+	pool.ParallelFor(sources.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			Source& source = sources[i];
+			source.loaded = LoadObjMesh((m_settings.assets + "/" + fileOf(i)).c_str(), source.vertices, source.indices) &&
+							!source.indices.empty();
+			if (!source.loaded)
+				continue;
+
+			MeshData& mesh = i < MeshCount ? m_meshes[i] : m_skybox;
+			uint32_t material = i < MeshCount ? MeshTable[i].material : MaterialNone;
+			if (material != MaterialNone)
+			{
+				// Into the material's atlas region; uv.z carries the array slice.
+				const PackedRegion& region = regions[material];
+				for (ObjVertex& vertex : source.vertices)
+				{
+					vertex.uv[0] = vertex.uv[0] * region.uvScale[0] + region.uvOffset[0];
+					vertex.uv[1] = vertex.uv[1] * region.uvScale[1] + region.uvOffset[1];
+					vertex.uv[2] = static_cast<float>(region.page);
+				}
+			}
+
+			mesh.bounds = ComputeMeshBounds(source.vertices[0].pos, source.vertices.size(), sizeof(ObjVertex));
+			mesh.tessellation = AnalyzeTessellation(source.vertices[0].pos, source.vertices[0].normal, sizeof(ObjVertex),
+													source.indices.data(), source.indices.size());
+			PipelineId pipeline = i < MeshCount ? MeshTable[i].pipeline : PipelineLitFlat;
+			if ((pipeline == PipelineLit || pipeline == PipelineEdges) && mesh.tessellation.tessellate)
+			{
+				source.levels.Build(source.vertices.data(), source.vertices.size(), source.indices.data(), source.indices.size(),
+									mesh.tessellation.maxFactor, mesh.tessellation.phongAlpha, MaxPretessellatedVertices, pool);
+			}
+		}
+	});
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		const Source& source = sources[i];
+		if (!source.loaded)
+			return Fail(m_settings.assets + "/" + fileOf(i) + ": can't load mesh");
+
+		MeshData& mesh = i < MeshCount ? m_meshes[i] : m_skybox;
+		PipelineId pipeline = i < MeshCount ? MeshTable[i].pipeline : PipelineLitFlat;
+		uint32_t material = i < MeshCount ? MeshTable[i].material : MaterialNone;
+
+		// PipelineEdges draws every edge once, as found here, instead of each triangle's three sides.
+		const bool lines = pipeline == PipelineEdges;
+		EdgeList edges;
+		auto drawnIndices = [lines, &edges](const ObjVertex* vertices, const std::vector<uint32_t>& triangles) -> const std::vector<uint32_t>&
+		{
+			if (!lines)
+				return triangles;
+			ExtractEdges(vertices[0].pos, sizeof(ObjVertex), triangles.data(), triangles.size(), edges);
+			return edges.lines;
+		};
+		auto createBuffers = [this](const std::vector<ObjVertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			BufferDesc vertexDesc = { uint32_t(vertices.size() * sizeof(ObjVertex)), BindVertexBuffer, UsageImmutable, FormatUnknown };
+			BufferDesc indexDesc = { uint32_t(indices.size() * sizeof(uint32_t)), BindIndexBuffer, UsageImmutable, FormatUnknown };
+			MeshLevel buffers = { Keep(m_device.CreateBuffer(vertexDesc, vertices.data())), Keep(m_device.CreateBuffer(indexDesc, indices.data())),
+								  uint32_t(indices.size()) };
+			return buffers;
+		};
+
+		MeshLevel buffers = createBuffers(source.vertices, drawnIndices(source.vertices.data(), source.indices));
+		mesh.vertexBuffer = buffers.vertexBuffer;
+		mesh.indexBuffer = buffers.indexBuffer;
+		mesh.indexCount = buffers.indexCount;
+		mesh.pipeline = pipeline;
+		mesh.material = material;
+		mesh.topology = lines ? TopologyLineList : PatchList3;
+		for (size_t level = 0; level < source.levels.GetLevelCount(); ++level)
+		{
+			const TessellatedMesh& tessellated = source.levels.GetLevel(level);
+			mesh.levels.push_back(createBuffers(tessellated.vertices, drawnIndices(tessellated.vertices.data(), tessellated.indices)));
+		}
+		if (pipeline == PipelineLit && (!mesh.tessellation.tessellate || !mesh.levels.empty()))
+		{
+			mesh.topology = TopologyTriangleList;
+			mesh.pipeline = PipelineLitFlat;
+		}
+		if (i == MeshPyramid)
+			mesh.topology = TopologyTriangleStrip;
+		else if (i == MeshCount)
+			mesh.topology = TopologyTriangleList;
+
+		// Alpha-tested surfaces have holes the CPU depth buffer can't see, so only opaque materials occlude.
+		if (i < MeshCount && MeshTable[i].occluder && (material == MaterialNone || m_materialAlpha[material] == AlphaOpaque))
+		{
+			for (const ObjVertex& vertex : source.vertices)
+			{
+				mesh.occluderPositions.insert(mesh.occluderPositions.end(), vertex.pos, vertex.pos + 3);
+			}
+			mesh.occluderIndices = source.indices;
+		}
+	}
+	return true;
+}
+
+// Loads the prebuilt skybox cube map. If the build didn't produce one, builds it on the CPU from the
+// six face images, or else from an equirectangular panorama. With none of them the skybox stays off
+// and GetSkyboxSource says so.
+bool SceneRenderer::LoadSkybox(void)
+{
+	DDSImage cube;
+	WorkerPool& pool = WorkerPool::Shared();
+	if (ReadDDSFile((m_settings.assets + "/" + SkyboxCubeFile).c_str(), cube) && cube.faceCount == 6)
+	{
+		m_skyboxSource = SkyboxPrebuilt;
+	}
+	else
+	{
+		DDSImage faces[6];
+		bool haveFaces = true;
+		for (int i = 0; i < 6 && haveFaces; ++i)
+		{
+			haveFaces = ReadDDSFile((m_settings.assets + "/" + SkyboxFaceFiles[i]).c_str(), faces[i]);
+		}
+
+		CubemapSettings settings;
+		DDSImage equirect;
+		if (haveFaces)
+		{
+			const DDSImage* const faceImages[6] = { &faces[0], &faces[1], &faces[2], &faces[3], &faces[4], &faces[5] };
+			settings.faceSize = faces[0].width;
+			if (BuildCubemapFromFaces(faceImages, settings, cube, pool))
+				m_skyboxSource = SkyboxFaces;
+		}
+		if (m_skyboxSource == SkyboxNone && ReadDDSFile((m_settings.assets + "/" + SkyboxEquirectFile).c_str(), equirect) &&
+			BuildCubemapFromEquirect(equirect, CubemapSettings(), cube, pool))
+		{
+			m_skyboxSource = SkyboxEquirect;
+		}
+	}
+	if (m_skyboxSource == SkyboxNone)
+		return true;
+
+	TextureDesc desc = { cube.width, cube.height, cube.mipLevels, 6, ImageFormat(cube), true };
+	m_skyboxTexture = Keep(m_device.CreateTexture(desc, cube.texels.data()));
+	if (m_skyboxTexture)
+		m_skyboxResidency = RegisterTexture(m_skyboxTexture, desc);
+	return true;
+}
+
+// Places the copies on a square grid, each one an entity under the root with an entity per item
+// below it, and makes every light marker of every copy an instance of one pyramid item. Then
+// creates the buffers the frame writes.
+void SceneRenderer::CreateScene(void)
+{
+	const MeshBounds& stadium = m_meshes[MeshStadium].bounds;
+	float spacing = 2.0f * std::max(stadium.extents[0], stadium.extents[2]) + 1.0f;
+	uint32_t side = 1;
+	while (side * side < m_settings.copies)
+	{
+		++side;
+	}
+	m_sceneExtent = 0.5f * side * spacing;
+	m_farZ = FarZ + 2.0f * (side - 1) * spacing;
+
+	m_root = m_scene.Create();
+	m_items.reserve(m_settings.copies * MeshPyramid + 1);
+	for (uint32_t copy = 0; copy < m_settings.copies; ++copy)
+	{
+		float x = (float(copy % side) - 0.5f * (side - 1)) * spacing;
+		float z = (float(copy / side) - 0.5f * (side - 1)) * spacing;
+		m_copyOffsets.push_back(x);
+		m_copyOffsets.push_back(z);
+		SceneStore::Entity copyEntity = m_scene.Create(m_root);
+		m_scene.SetPosition(copyEntity, x, 0.0f, z);
+
+		for (uint32_t mesh = 0; mesh < MeshPyramid; ++mesh)
+		{
+			DrawItem item = {};
+			item.mesh = MeshId(mesh);
+			item.entity = m_scene.Create(copyEntity);
+			item.proxy = BoundingTree::NullNode;
+			m_scene.SetLocalBounds(item.entity, m_meshes[mesh].bounds);
+			m_scene.SetMesh(item.entity, mesh);
+			m_scene.SetMaterial(item.entity, m_meshes[mesh].material);
+			m_items.push_back(item);
+		}
+	}
+
+	DrawItem markers = {};
+	markers.mesh = MeshPyramid;
+	markers.entity = SceneStore::NullEntity;
+	markers.proxy = BoundingTree::NullNode;
+	markers.instances = &m_markers;
+	m_markers.SetMeshBounds(m_meshes[MeshPyramid].bounds);
+	m_markers.Reserve(m_settings.copies * 3);
+	m_items.push_back(markers);
+
+	BufferDesc lightDesc = { sizeof(SceneLightConstants), BindConstantBuffer, UsageDefault, FormatUnknown };
+	m_lightBuffer = Keep(m_device.CreateBuffer(lightDesc, nullptr));
+	BufferDesc gridDesc = { sizeof(LightGridConstants), BindConstantBuffer, UsageDefault, FormatUnknown };
+	m_lightGridBuffer = Keep(m_device.CreateBuffer(gridDesc, nullptr));
+
+	// Binding constant buffers by offset needs the ring mapped without overwrite as well; without
+	// both the ring lives in memory and every draw copies its slice into m_constantBuffer.
+	uint32_t ringBytes = ConstantRingBytes;
+	while (ringBytes < 2 * (m_items.size() + 1) * ConstantRing::Alignment)
+	{
+		ringBytes *= 2;
+	}
+	m_constantOffsets = m_device.GetCaps().constantOffsets;
+	if (m_constantOffsets)
+	{
+		BufferDesc ringDesc = { ringBytes, BindConstantBuffer, UsageDynamic, FormatUnknown };
+		m_constantRingBackend.SetBuffer(Keep(m_device.CreateBuffer(ringDesc, nullptr)));
+		m_constantRing.Reset(ringBytes, &m_constantRingBackend);
+	}
+	else
+	{
+		BufferDesc constantDesc = { sizeof(SceneConstants), BindConstantBuffer, UsageDefault, FormatUnknown };
+		m_constantBuffer = Keep(m_device.CreateBuffer(constantDesc, nullptr));
+		m_constantRingMemory.Resize(ringBytes);
+		m_constantRing.Reset(ringBytes, &m_constantRingMemory);
+	}
+}
+
+// Adds the directional light, each copy's point and spot light and the extra lights to the light
+// store. The extra lights are scattered over the copies and half of them drift back and forth.
+void SceneRenderer::CreateLights(void)
+{
+	LightAnimation::Curve sweeps[3];
+	float phases[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		float leg = 2.0f * SweepLimits[i] / SweepSpeeds[i];
+		AnimationCurve sweep(CurveLinear, CurvePingPong);
+		sweep.AddKey(0.0f, -SweepLimits[i]);
+		sweep.AddKey(leg, SweepLimits[i]);
+		sweeps[i] = m_lightAnimation.AddCurve(sweep);
+		float start = LightStarts[i][SweepAxes[i] == ChannelPositionX ? 0 : 2];
+		phases[i] = leg + (SweepLimits[i] - start) / SweepSpeeds[i];
+	}
+
+	auto create = [this](LightType type, int light, float x, float z)
+	{
+		LightStore::Light created = m_lights.Create(type);
+		m_lights.SetPosition(created, LightStarts[light][0] + x, LightStarts[light][1], LightStarts[light][2] + z);
+		m_lights.SetColor(created, LightColors[light][0], LightColors[light][1], LightColors[light][2], LightColors[light][3]);
+		m_lights.SetRadius(created, LightRadius);
+		m_lights.SetCone(created, SpotCosInner, SpotCosOuter);
+		m_lights.SetEnabled(created, true);
+		return created;
+	};
+
+	m_directionalLight = create(LightDirectional, 0, 0.0f, 0.0f);
+	m_lightAnimation.AddTrack(m_directionalLight, SweepAxes[0], sweeps[0], phases[0]);
+	m_lights.SetTarget(m_directionalLight, 0.0f, 0.0f, 0.0f);
+	size_t copies = m_copyOffsets.size() / 2;
+	for (size_t copy = 0; copy < copies; ++copy)
+	{
+		float x = m_copyOffsets[copy * 2];
+		float z = m_copyOffsets[copy * 2 + 1];
+		LightStore::Light point = create(LightPoint, 1, x, z);
+		m_lightAnimation.AddTrack(point, SweepAxes[1], sweeps[1], phases[1], x);
+		m_copyLights.push_back(point);
+		m_copyLights.push_back(create(LightSpot, 2, x, z));
+	}
+	// The spot tracks after all the point tracks, so Apply evaluates each sweep once per frame.
+	for (size_t copy = 0; copy < copies; ++copy)
+	{
+		LightAnimation::Track track = m_lightAnimation.AddTrack(m_copyLights[copy * 2 + 1], SweepAxes[2], sweeps[2], phases[2],
+																m_copyOffsets[copy * 2 + 1]);
+		if (copy == 0)
+			m_spotTrack = track;
+	}
+
+	const float still[3] = { 0.0f, 0.0f, 0.0f };
+	const float low[3] = { -m_sceneExtent, 0.5f, -m_sceneExtent };
+	const float high[3] = { m_sceneExtent, 6.0f, m_sceneExtent };
+	Random random = { 0x9E3779B9u };
+	for (uint32_t i = 0; i < m_settings.extraLights; ++i)
+	{
+		bool spot = random.Next(0.0f, 1.0f) < 0.5f;
+		LightStore::Light light = m_lights.Create(spot ? LightSpot : LightPoint);
+		m_lights.SetPosition(light, random.Next(low[0], high[0]), random.Next(low[1], high[1]), random.Next(low[2], high[2]));
+		m_lights.SetRadius(light, random.Next(1.0f, LightRadius));
+		if (spot)
+		{
+			// Down and off to the side, like the scene's spot lights.
+			m_lights.SetDirection(light, random.Next(-0.5f, 0.5f), -1.0f, random.Next(-1.0f, 1.0f));
+			m_lights.SetCone(light, SpotCosInner, SpotCosOuter);
+		}
+		// Half of them drift, at up to 3 units per second.
+		float velocity[3] = { random.Next(-3.0f, 3.0f), 0.0f, random.Next(-3.0f, 3.0f) };
+		m_lights.SetMotion(light, i & 1 ? velocity : still, low, high);
+	}
+}
+
+// Registers a 32-bit texture with the residency manager, sized per mip over every slice.
+uint32_t SceneRenderer::RegisterTexture(const void* texture, const TextureDesc& desc)
+{
+	std::vector<uint64_t> mipBytes(desc.mipLevels);
+	for (uint32_t mip = 0; mip < desc.mipLevels; ++mip)
+	{
+		mipBytes[mip] = uint64_t(std::max(desc.width >> mip, 1u)) * std::max(desc.height >> mip, 1u) * 4 * desc.arraySize;
+	}
+	ResidentTexture resident = { m_textureResidency.Register(mipBytes.data(), desc.mipLevels), texture };
+	m_residentTextures.push_back(resident);
+	return resident.handle;
+}
+
+void SceneRenderer::SetViewport(const SceneViewport& viewport)
+{
+	m_viewport = viewport;
+	m_hasViewport = true;
+	UpdateProjection();
+}
+
+// The projection, with the display orientation after it, and what depends on it: the light grid's
+// clusters, which are laid out in render target pixels, and the tessellation scale.
+void SceneRenderer::UpdateProjection(void)
+{
+	float perspective[16];
+	PerspectiveFovLH(m_viewport.fovAngleY, m_viewport.aspectRatio, NearZ, m_farZ, perspective);
+	Multiply(perspective, m_viewport.orientation, m_projection);
+	Transpose(m_projection, m_frameConstants.projection);
+
+	m_lightGrid.SetProjection(m_projection, m_viewport.targetWidth, m_viewport.targetHeight, NearZ, m_farZ);
+	m_lightGridChanged = true;
+
+	// An edge of length l at distance d covers about l / d times the focal length in pixels.
+	float focalPixels = 0.5f * m_viewport.outputHeight / tanf(0.5f * m_viewport.fovAngleY);
+	m_tessellationScale = focalPixels / TessellationPixelsPerSegment;
+}
+
+void SceneRenderer::SetCamera(const float view[16], const float eye[3])
+{
+	std::copy(view, view + 16, m_view);
+	Transpose(view, m_frameConstants.view);
+	std::copy(eye, eye + 3, m_eye);
+	const float eyePosition[4] = { eye[0], eye[1], eye[2], 1.0f };
+	if (!std::equal(eyePosition, eyePosition + 4, m_lightConstants.eyePosition))
+	{
+		std::copy(eyePosition, eyePosition + 4, m_lightConstants.eyePosition);
+		m_lightConstantsChanged = true;
+	}
+}
+
+void SceneRenderer::SetSceneRotation(float radians)
+{
+	if (m_root != SceneStore::NullEntity)
+		m_scene.SetRotation(m_root, 0.0f, sinf(0.5f * radians), 0.0f, cosf(0.5f * radians));
+}
+
+// The lights follow their curves by the clock, so they keep their speed at any frame rate. The spot
+// lights lean the way they are moving, and Animate re-aims the directional light and moves the
+// drifting ones. A pyramid marks each copy's directional, point and spot light.
+void SceneRenderer::Update(double time, float elapsed)
+{
+	if (!m_loaded)
+		return;
+
+	Clock::time_point start = Clock::now();
+	m_lightAnimation.Apply(time, m_lights);
+	size_t copies = m_copyOffsets.size() / 2;
+	float lean = m_lightAnimation.GetSlope(m_spotTrack, time) > 0.0f ? 1.0f : -1.0f;
+	for (size_t copy = 0; copy < copies; ++copy)
+	{
+		m_lights.SetDirection(m_copyLights[copy * 2 + 1], 0.0f, -1.0f, lean);
+	}
+	m_lights.Animate(elapsed);
+
+	float directional[3];
+	m_lights.GetPosition(m_directionalLight, directional);
+	for (size_t copy = 0; copy < copies; ++copy)
+	{
+		float positions[3][3] =
+		{
+			{ directional[0] + m_copyOffsets[copy * 2], directional[1], directional[2] + m_copyOffsets[copy * 2 + 1] }
+		};
+		m_lights.GetPosition(m_copyLights[copy * 2], positions[1]);
+		m_lights.GetPosition(m_copyLights[copy * 2 + 1], positions[2]);
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			float world[16];
+			Translation(positions[i][0], positions[i][1], positions[i][2], world);
+			uint32_t index = uint32_t(copy * 3 + i);
+			if (index < m_markers.Size())
+				m_markers.Set(index, world);
+			else
+				m_markers.Add(world);
+		}
+	}
+	m_frameStats.milliseconds[SceneStageUpdate] = MillisecondsSince(start);
+}
+
+// Records one frame. The lights go first: the light types in the grid decide which shader
+// variants the draws use. The skybox is drawn around the camera before the scene, with the
+// depth cleared after it so the scene always lands in front of it.
+void SceneRenderer::Render(void)
+{
+	if (!m_loaded || !m_hasViewport)
+		return;
+
+	m_stateCache.BeginFrame();
+	Clock::time_point start = Clock::now();
+	UploadLights();
+	UploadLightGrid();
+	m_frameStats.milliseconds[SceneStageLights] = MillisecondsSince(start);
+
+	start = Clock::now();
+	m_scene.UpdateTransforms();
+	m_frameStats.milliseconds[SceneStageTransforms] = MillisecondsSince(start);
+
+	start = Clock::now();
+	CullItems();
+	m_frameStats.milliseconds[SceneStageCull] = MillisecondsSince(start);
+
+	start = Clock::now();
+	QueueItems();
+	m_frameStats.milliseconds[SceneStageQueue] = MillisecondsSince(start);
+
+	start = Clock::now();
+	UploadDrawConstants();
+	UploadInstances();
+	m_frameStats.milliseconds[SceneStageUpload] = MillisecondsSince(start);
+
+	start = Clock::now();
+	DrawSkybox();
+	BindSharedState(m_stateCache);
+	ExecuteRenderQueue();
+	UpdateTextureResidency();
+	m_frameStats.milliseconds[SceneStageRecord] = MillisecondsSince(start);
+
+	m_frameStats.stateCalls = m_stateCache.GetStats().TotalIssued();
+	m_frameStats.filteredCalls = m_stateCache.GetStats().TotalFiltered();
+}
+
+// Packs the lights changed since the last frame and copies them into the cluster light buffer,
+// recreating it with room for the next power of two, at least 64, lights when they don't fit. The
+// light constants are only rewritten when the eye or the directional light changed.
+void SceneRenderer::UploadLights(void)
+{
+	uint32_t lightCount = m_lights.GetPackedCount();
+	uint32_t clusterOffset = m_lights.GetPackedOffset(LightPoint);
+	uint32_t clusterCount = lightCount - clusterOffset;
+	uint32_t first = 0;
+	uint32_t count = 0;
+	if (!m_clusterLights.buffer || clusterCount > m_clusterLights.capacity)
+	{
+		uint32_t capacity = std::max(m_clusterLights.capacity, 64u);
+		while (capacity < clusterCount)
+		{
+			capacity *= 2;
+		}
+		ReleaseShaderBuffer(m_clusterLights);
+		BufferDesc desc = { uint32_t(capacity * sizeof(PackedLight)), BindShaderResource, UsageDefault, FormatR32G32B32A32Float };
+		m_clusterLights.buffer = m_device.CreateBuffer(desc, nullptr);
+		m_clusterLights.view = m_clusterLights.buffer ? m_device.GetBufferView(m_clusterLights.buffer) : nullptr;
+		m_clusterLights.capacity = m_clusterLights.buffer ? capacity : 0;
+		count = lightCount;
+	}
+	else if (!m_lights.GetDirtyRange(first, count))
+	{
+		count = 0;
+	}
+	m_lights.ClearDirty();
+	m_frameStats.packedLights = count;
+
+	if (count)
+	{
+		m_packedLights.resize(lightCount);
+		m_lights.Pack(first, count, &m_packedLights[first]);
+		uint32_t directional = m_lights.GetPackedIndex(m_directionalLight);
+		if (directional >= first && directional < first + count)
+		{
+			m_lightConstants.directional = m_packedLights[directional];
+			m_lightConstantsChanged = true;
+		}
+
+		uint32_t begin = std::max(first, clusterOffset);
+		uint32_t end = first + count;
+		if (begin < end && m_clusterLights.buffer)
+		{
+			m_device.WriteBuffer(m_clusterLights.buffer, uint32_t((begin - clusterOffset) * sizeof(PackedLight)), &m_packedLights[begin],
+								 uint32_t((end - begin) * sizeof(PackedLight)));
+		}
+	}
+
+	if (m_lightConstantsChanged)
+	{
+		m_device.WriteBuffer(m_lightBuffer, 0, &m_lightConstants, sizeof(m_lightConstants));
+		m_lightConstantsChanged = false;
+	}
+}
+
+// Assigns the point and spot lights to the light grid's clusters for this frame's camera and uploads
+// the cluster ranges and the index list for LightPixelShader.
+void SceneRenderer::UploadLightGrid(void)
+{
+	m_gridLights.resize(m_lights.GetPackedCount() - m_lights.GetPackedOffset(LightPoint));
+	m_lights.WriteGridLights(m_gridLights.data());
+	m_lightGrid.Build(m_view, m_gridLights.data(), static_cast<uint32_t>(m_gridLights.size()));
+	uint32_t firstSpot = m_lights.GetPackedOffset(LightSpot) - m_lights.GetPackedOffset(LightPoint);
+	m_frameLights = FindGridLightTypes(m_lightGrid.GetLightIndices(), m_lightGrid.GetLightIndexCount(), firstSpot);
+	if (m_lightConstants.directional.parameters[2] != 0.0f)
+		m_frameLights |= PermutationDirectional;
+
+	if (m_lightGridChanged)
+	{
+		m_device.WriteBuffer(m_lightGridBuffer, 0, &m_lightGrid.GetConstants(), sizeof(LightGridConstants));
+		m_lightGridChanged = false;
+	}
+	WriteShaderBuffer(m_clusterRanges, FormatR32G32Uint, 2 * sizeof(uint32_t), m_lightGrid.GetClusterRanges(), m_lightGrid.GetClusterCount());
+	WriteShaderBuffer(m_lightIndices, FormatR16Uint, sizeof(uint16_t), m_lightGrid.GetLightIndices(),
+					  static_cast<uint32_t>(m_lightGrid.GetLightIndexCount()));
+}
+
+// Moves the items' leaves in the bounding tree, queries it with the view frustum, drops the items
+// hidden behind the occluders and culls the instances of the instanced items.
+void SceneRenderer::CullItems(void)
+{
+	float viewProjection[16];
+	Multiply(m_view, m_projection, viewProjection);
+	Frustum frustum = ExtractFrustum(viewProjection);
+
+	// Leaves only move once an item leaves its fat box. Instances carry their own world transforms;
+	// the tree holds one box around all of them.
+	for (uint32_t i = 0; i < m_items.size(); ++i)
+	{
+		DrawItem& item = m_items[i];
+		item.worldBounds = item.instances ? item.instances->ComputeBounds() : m_scene.GetWorldBounds(item.entity);
+		if (item.proxy == BoundingTree::NullNode)
+			item.proxy = m_sceneTree.Insert(item.worldBounds.min, item.worldBounds.max, i);
+		else
+			m_sceneTree.Move(item.proxy, item.worldBounds.min, item.worldBounds.max);
+	}
+
+	m_visibleItems.clear();
+	m_sceneTree.QueryFrustum(frustum, m_visibleItems);
+	m_cullStats.tested = m_sceneTree.GetLeafCount();
+	m_cullStats.culled = m_cullStats.tested - static_cast<uint32_t>(m_visibleItems.size());
+
+	// The visible occluders are rasterized into the CPU depth buffer; occluders are never tested,
+	// so they can't hide themselves.
+	auto occludes = [this](const DrawItem& item) { return !m_meshes[item.mesh].occluderIndices.empty(); };
+	m_occlusion.BeginFrame(viewProjection);
+	for (uint32_t i : m_visibleItems)
+	{
+		const DrawItem& item = m_items[i];
+		if (!occludes(item))
+			continue;
+		const MeshData& mesh = m_meshes[item.mesh];
+		float world[16];
+		m_scene.GetWorldMatrix(item.entity, world);
+		m_occlusion.AddOccluder(mesh.occluderPositions.data(), 3 * sizeof(float), mesh.occluderIndices.data(), mesh.occluderIndices.size(), world);
+	}
+	m_occlusion.Rasterize();
+	auto hidden = std::remove_if(m_visibleItems.begin(), m_visibleItems.end(), [&](uint32_t i)
+	{
+		const DrawItem& item = m_items[i];
+		return !occludes(item) && !m_occlusion.TestBox(item.worldBounds.min, item.worldBounds.max);
+	});
+	m_cullStats.occluded = static_cast<uint32_t>(m_visibleItems.end() - hidden);
+	m_visibleItems.erase(hidden, m_visibleItems.end());
+	m_cullStats.visible = static_cast<uint32_t>(m_visibleItems.size());
+
+	// Only the instances inside the frustum reach the instance buffer.
+	for (uint32_t i : m_visibleItems)
+	{
+		DrawItem& item = m_items[i];
+		if (item.instances)
+			item.instanceCount = item.instances->Cull(frustum).visible;
+	}
+}
+
+// Builds this frame's draw packets for the visible items. Lit draws use the cheapest LightPixelShader
+// variant for their material and this frame's lights; those without the alpha test draw before
+// alpha-tested ones, and the view depth in the key orders each state group front to back.
+void SceneRenderer::QueueItems(void)
+{
+	memset(m_frameStats.variantDraws, 0, sizeof(m_frameStats.variantDraws));
+	m_renderQueue.Clear();
+	for (uint32_t i : m_visibleItems)
+	{
+		DrawItem& item = m_items[i];
+		if (item.instances && item.instanceCount == 0)
+			continue;
+
+		const MeshData& mesh = m_meshes[item.mesh];
+		bool textured = mesh.material != MaterialNone;
+		bool alphaTested = textured && m_materialAlpha[mesh.material] != AlphaOpaque;
+		uint32_t variant = 0;
+		if (!m_pipelines[mesh.pipeline].shaders[StagePixel])
+		{
+			variant = m_lightPermutations.Select(MakeLightPermutation(alphaTested, textured, m_frameLights));
+			if (variant == LightPermutationTable::NoVariant)
+				continue;
+			alphaTested = (LightVariants[variant].key & PermutationAlphaTest) != 0;
+			++m_frameStats.variantDraws[variant];
+		}
+		uint32_t pass = alphaTested ? PassAlphaTested : PassOpaque;
+
+		float center[3];
+		TransformPoint(item.worldBounds.center, m_view, center);
+		if (!mesh.levels.empty())
+		{
+			// The largest factor the hull shader would give any edge: the longest one, as close as the bounds allow.
+			float distance = std::max(sqrtf(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]) - item.worldBounds.radius, NearZ);
+			float factor = std::min(mesh.tessellation.edgeLength * m_tessellationScale / distance, mesh.tessellation.maxFactor);
+			item.level = std::min(OddTessellationFactor(factor) / 2, static_cast<uint32_t>(mesh.levels.size() - 1));
+		}
+		uint64_t key = DrawKey::Make(pass, mesh.pipeline * LightVariantCount + variant, mesh.material, item.mesh,
+									 DrawKey::QuantizeDepth(center[2], NearZ, m_farZ));
+		m_renderQueue.Submit(key, i);
+	}
+	m_renderQueue.Sort();
+}
+
+// Writes this frame's constants for the skybox and every queued item into the ring, one slice each.
+void SceneRenderer::UploadDrawConstants(void)
+{
+	m_constantRing.BeginFrame();
+
+	m_skyboxConstants.size = 0;
+	if (m_skyboxTexture)
+	{
+		SceneConstants skybox = m_frameConstants;
+		float world[16];
+		Translation(m_eye[0], m_eye[1], m_eye[2], world);
+		Transpose(world, skybox.model);
+		m_constantRing.Upload(&skybox, sizeof(skybox), m_skyboxConstants);
+	}
+
+	SceneConstants objectData = m_frameConstants;
+	for (DrawItem& item : m_items)
+	{
+		item.constants.size = 0;
+	}
+	for (const DrawPacket& packet : m_renderQueue)
+	{
+		// The instanced vertex shader takes its transforms from the instance buffer and ignores model.
+		DrawItem& item = m_items[packet.item];
+		float world[16];
+		if (item.instances)
+			Translation(0.0f, 0.0f, 0.0f, world);
+		else
+			m_scene.GetWorldMatrix(item.entity, world);
+		Transpose(world, objectData.model);
+		const TessellationPolicy& tessellation = m_meshes[item.mesh].tessellation;
+		objectData.tessellation[0] = tessellation.maxFactor;
+		objectData.tessellation[1] = tessellation.phongAlpha;
+		objectData.tessellation[2] = m_tessellationScale;
+		m_constantRing.Upload(&objectData, sizeof(objectData), item.constants);
+	}
+
+	m_constantRing.Flush();
+}
+
+// Packs the visible instances of every queued instanced item into the instance buffer, one range
+// per item, growing the buffer to the next power of two when they don't fit.
+void SceneRenderer::UploadInstances(void)
+{
+	uint32_t total = 0;
+	for (const DrawPacket& packet : m_renderQueue)
+	{
+		DrawItem& item = m_items[packet.item];
+		if (item.instances)
+		{
+			item.firstInstance = total;
+			total += item.instanceCount;
+		}
+	}
+	if (total == 0)
+		return;
+
+	if (total > m_instanceCapacity)
+	{
+		uint32_t capacity = std::max(m_instanceCapacity, 64u);
+		while (capacity < total)
+		{
+			capacity *= 2;
+		}
+		if (m_instanceBuffer)
+			m_device.Release(m_instanceBuffer);
+		BufferDesc desc = { uint32_t(capacity * sizeof(InstanceData)), BindVertexBuffer, UsageDynamic, FormatUnknown };
+		m_instanceBuffer = m_device.CreateBuffer(desc, nullptr);
+		m_instanceCapacity = m_instanceBuffer ? capacity : 0;
+		if (!m_instanceBuffer)
+			return;
+	}
+
+	InstanceData* instances = static_cast<InstanceData*>(m_device.Map(m_instanceBuffer, true));
+	if (!instances)
+		return;
+	for (const DrawPacket& packet : m_renderQueue)
+	{
+		const DrawItem& item = m_items[packet.item];
+		if (item.instances)
+			item.instances->WriteVisible(instances + item.firstInstance);
+	}
+	m_device.Unmap(m_instanceBuffer);
+}
+
+void SceneRenderer::DrawSkybox(void)
+{
+	if (!m_skyboxTexture || !m_skyboxConstants.size)
+		return;
+
+	m_textureResidency.Touch(m_skyboxResidency);
+	m_stateCache.SetVertexBuffer(0, m_skybox.vertexBuffer, sizeof(ObjVertex), 0);
+	m_stateCache.SetIndexBuffer(m_skybox.indexBuffer, FormatR32Uint, 0);
+	m_stateCache.SetPrimitiveTopology(m_skybox.topology);
+	m_stateCache.SetInputLayout(m_pipelines[PipelineLit].inputLayout);
+	for (uint32_t stage = 0; stage < StageCount; ++stage)
+	{
+		m_stateCache.SetShader(ShaderStage(stage), m_skyboxShaders[stage]);
+	}
+	BindDrawConstants(m_stateCache, m_skyboxConstants);
+	m_stateCache.SetRasterizerState(m_skyboxRasterizerState);
+	m_stateCache.SetShaderResource(StagePixel, 0, m_skyboxTexture);
+	m_stateCache.SetSampler(StagePixel, 0, m_sampler);
+	m_stateCache.DrawIndexed(m_skybox.indexCount, 0, 0);
+	m_device.ClearDepth();
+}
+
+// Records the sorted packets. Small queues go straight through the immediate state cache; large
+// ones are split into one command list per worker, recorded in parallel and submitted in order.
+void SceneRenderer::ExecuteRenderQueue(void)
+{
+	// Every queued material's atlas page is used this frame. Marked here, since recording may
+	// happen on the workers.
+	for (const DrawPacket& packet : m_renderQueue)
+	{
+		uint32_t material = m_meshes[m_items[packet.item].mesh].material;
+		if (material != MaterialNone && m_materialResidency[m_materialGroups[material]] != TextureResidency::InvalidHandle)
+			m_textureResidency.Touch(m_materialResidency[m_materialGroups[material]]);
+	}
+
+	const DrawPacket* packets = m_renderQueue.begin();
+	size_t packetCount = m_renderQueue.Size();
+	WorkerPool& pool = WorkerPool::Shared();
+	size_t listCount = std::min<size_t>(pool.GetConcurrency(), packetCount / MinPacketsPerCommandList);
+	if (listCount < 2)
+	{
+		RecordDraws(m_stateCache, packets, packets + packetCount);
+		return;
+	}
+
+	if (m_commandLists.size() < listCount)
+		m_commandLists.resize(listCount);
+	m_deferredFinished.assign(listCount, 0);
+	bool deferred = m_device.GetCaps().deferredContexts >= listCount;
+	pool.ParallelFor(listCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t list = first; list < last; ++list)
+		{
+			// Every list starts from unknown state, so it binds the shared state before its draws.
+			CommandList& commands = m_commandLists[list];
+			commands.Reset();
+			StateCache cache(&commands);
+			BindSharedState(cache);
+			RecordDraws(cache, packets + packetCount * list / listCount, packets + packetCount * (list + 1) / listCount);
+
+			// A list that fails to finish is replayed on the immediate context instead.
+			if (deferred)
+			{
+				commands.Replay(m_device.BeginDeferred(uint32_t(list)));
+				m_deferredFinished[list] = m_device.FinishDeferred(uint32_t(list));
+			}
+		}
+	});
+
+	for (size_t list = 0; list < listCount; ++list)
+	{
+		if (m_deferredFinished[list])
+		{
+			// Executing a recording resets the immediate context to its defaults.
+			m_device.ExecuteDeferred(uint32_t(list));
+			m_stateCache.Invalidate();
+		}
+		else
+		{
+			// Replaying through the immediate cache drops state that repeats across list boundaries.
+			m_commandLists[list].Replay(m_stateCache);
+		}
+	}
+}
+
+// Binds each draw's full state. The sort keeps neighbouring draws alike, so the state cache
+// filters most of these calls. Only reads renderer state, so workers can record concurrently.
+void SceneRenderer::RecordDraws(StateCache& cache, const DrawPacket* begin, const DrawPacket* end) const
+{
+	for (const DrawPacket* packet = begin; packet != end; ++packet)
+	{
+		const DrawItem& item = m_items[packet->item];
+		if (item.constants.size == 0)
+			continue;
+
+		uint32_t shader = DrawKey::Shader(packet->key);
+		const Pipeline& pipeline = m_pipelines[shader / LightVariantCount];
+		cache.SetInputLayout(pipeline.inputLayout);
+		for (uint32_t stage = 0; stage < StagePixel; ++stage)
+		{
+			cache.SetShader(ShaderStage(stage), pipeline.shaders[stage]);
+		}
+		const void* pixelShader = pipeline.shaders[StagePixel];
+		cache.SetShader(StagePixel, pixelShader ? pixelShader : m_lightPixelShaders[shader % LightVariantCount]);
+		BindDrawConstants(cache, item.constants);
+
+		// The state cache drops the bind when the material's atlas page is already bound.
+		const MeshData& mesh = m_meshes[item.mesh];
+		if (mesh.material != MaterialNone)
+			cache.SetShaderResource(StagePixel, 0, m_materialPages[m_materialGroups[mesh.material]]);
+
+		MeshLevel buffers = { mesh.vertexBuffer, mesh.indexBuffer, mesh.indexCount };
+		if (!mesh.levels.empty())
+			buffers = mesh.levels[item.level];
+		cache.SetVertexBuffer(0, buffers.vertexBuffer, sizeof(ObjVertex), 0);
+		cache.SetIndexBuffer(buffers.indexBuffer, FormatR32Uint, 0);
+		cache.SetPrimitiveTopology(mesh.topology);
+		if (item.instances)
+		{
+			cache.SetVertexBuffer(1, m_instanceBuffer, sizeof(InstanceData), 0);
+			cache.DrawIndexedInstanced(buffers.indexCount, item.instanceCount, 0, 0, item.firstInstance);
+		}
+		else
+		{
+			cache.DrawIndexed(buffers.indexCount, 0, 0);
+		}
+	}
+}
+
+// State every scene draw expects that isn't part of its packet.
+void SceneRenderer::BindSharedState(StateCache& cache) const
+{
+	cache.SetRasterizerState(nullptr);
+	cache.SetConstantBuffer(StagePixel, 0, m_lightBuffer);
+	cache.SetConstantBuffer(StagePixel, 1, m_lightGridBuffer);
+	cache.SetShaderResource(StagePixel, 1, m_clusterLights.view);
+	cache.SetShaderResource(StagePixel, 2, m_clusterRanges.view);
+	cache.SetShaderResource(StagePixel, 3, m_lightIndices.view);
+	cache.SetSampler(StagePixel, 0, m_sampler);
+}
+
+// Binds a slice of the constant ring to the vertex, hull and domain shaders. On devices that can't
+// bind by offset, the slice's constants are copied into the fallback buffer instead. The slice is
+// rounded up to the ring's alignment, so only the constant buffer's own size is copied.
+void SceneRenderer::BindDrawConstants(StateCache& cache, const RingSlice& slice) const
+{
+	static const ShaderStage stages[3] = { StageVertex, StageHull, StageDomain };
+	if (m_constantOffsets)
+	{
+		const void* ring = m_constantRingBackend.GetBuffer();
+		for (ShaderStage stage : stages)
+		{
+			cache.SetConstantBuffer(stage, 0, ring, slice.FirstConstant(), slice.ConstantCount());
+		}
+	}
+	else
+	{
+		cache.UpdateBuffer(m_constantBuffer, m_constantRingMemory.Data() + slice.offset, sizeof(SceneConstants));
+		for (ShaderStage stage : stages)
+		{
+			cache.SetConstantBuffer(stage, 0, m_constantBuffer);
+		}
+	}
+}
+
+// Closes the residency frame and clamps the LOD of any texture whose resident mips changed.
+void SceneRenderer::UpdateTextureResidency(void)
+{
+	m_residencyChanges.clear();
+	m_textureResidency.EndFrame(m_residencyChanges);
+	for (const ResidencyChange& change : m_residencyChanges)
+	{
+		for (const ResidentTexture& resident : m_residentTextures)
+		{
+			if (resident.handle == change.handle)
+				m_device.SetTextureMinLod(resident.texture, static_cast<float>(change.residentMip));
+		}
+	}
+}
+
+// Copies count elements into a dynamic shader buffer, recreating it at the next power of two, at
+// least 64 elements, when they don't fit.
+void SceneRenderer::WriteShaderBuffer(ShaderBuffer& target, Format format, uint32_t elementSize, const void* data, uint32_t count)
+{
+	if (count > target.capacity || !target.buffer)
+	{
+		uint32_t capacity = std::max(target.capacity, 64u);
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		ReleaseShaderBuffer(target);
+		BufferDesc desc = { capacity * elementSize, BindShaderResource, UsageDynamic, format };
+		target.buffer = m_device.CreateBuffer(desc, nullptr);
+		target.view = target.buffer ? m_device.GetBufferView(target.buffer) : nullptr;
+		target.capacity = target.buffer ? capacity : 0;
+	}
+	if (count == 0 || !target.buffer)
+		return;
+
+	void* mapped = m_device.Map(target.buffer, true);
+	if (!mapped)
+		return;
+	memcpy(mapped, data, size_t(count) * elementSize);
+	m_device.Unmap(target.buffer);
+}
+
+void SceneRenderer::ReleaseShaderBuffer(ShaderBuffer& target)
+{
+	if (target.buffer)
+		m_device.Release(target.buffer);
+	target.buffer = nullptr;
+	target.view = nullptr;
+	target.capacity = 0;
+}
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AlphaCoverage.h"
+#include "BoundingTree.h"
+#include "CommandList.h"
+#include "ConstantRing.h"
+#include "FrustumCulling.h"
+#include "InstanceSet.h"
+#include "LightAnimation.h"
+#include "LightGrid.h"
+#include "LightPermutation.h"
+#include "LightStore.h"
+#include "OcclusionBuffer.h"
+#include "RenderDevice.h"
+#include "RenderQueue.h"
+#include "SceneStore.h"
+#include "ShaderArchive.h"
+#include "TessellationPolicy.h"
+#include "TexturePacker.h"
+#include "TextureResidency.h"
+
+// The app's scene and everything its frame does on the CPU, written against IRenderDevice: loading
+// the meshes, material atlas, skybox and shaders, animating the lights, and every frame culling,
+// sorting, uploading and recording the draws through the state cache. Sample3DSceneRenderer runs
+// it on a D3D11RenderDevice with the camera its input moves; Tools/HeadlessFrame runs the same
+// code on a NullRenderDevice.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct SceneSettings
+	{
+		std::string assets = "Assets";				// Meshes and textures.
+		const ShaderArchive* shaders = nullptr;		// Searched first; shaders it lacks are read from <name>.cso.
+		uint32_t copies = 1;						// The scene repeated on a square grid, each copy with its own point and spot light.
+		uint32_t extraLights = 0;					// Random point and spot lights over the copies, half of them drifting.
+		uint64_t textureBudget = 256ull * 1024 * 1024;	// Texture memory to stay under before fine mips are dropped.
+	};
+
+	// The camera's lens and the render target it draws to.
+	struct SceneViewport
+	{
+		float fovAngleY;
+		float aspectRatio;
+		float orientation[16];	// Applied after the projection, as DeviceResources::GetOrientationTransform3D gives it.
+		uint32_t targetWidth;	// Render target pixels, which the light grid's tiles cover.
+		uint32_t targetHeight;
+		float outputHeight;		// Pixels along the view's vertical axis, which the tessellation factors aim at.
+	};
+
+	// Same layout as ModelViewProjectionConstantBuffer, which the vertex, hull and domain shaders read.
+	struct SceneConstants
+	{
+		float model[16];
+		float view[16];
+		float projection[16];
+		float tessellation[4];	// Largest factor, Phong shape factor, segments per unit of edge length at distance 1, unused.
+	};
+
+	// Same layout as the LightProperties constant buffer of LightPixelShader.
+	struct SceneLightConstants
+	{
+		float eyePosition[4];
+		float globalAmbient[4];
+		PackedLight directional;
+	};
+
+	enum SceneStage : uint32_t
+	{
+		SceneStageUpdate = 0,	// Light animation and markers.
+		SceneStageLights,		// Light packing, cluster assignment and their uploads.
+		SceneStageTransforms,
+		SceneStageCull,			// Bounding tree, frustum, occlusion and instance culling.
+		SceneStageQueue,		// Shader variants, tessellation levels, draw keys and the sort.
+		SceneStageUpload,		// Draw constants and instances.
+		SceneStageRecord,		// Skybox, draws and texture residency.
+		SceneStageCount
+	};
+
+	// What the last Update and Render did.
+	struct SceneFrameStats
+	{
+		double milliseconds[SceneStageCount];
+		uint32_t packedLights;						// Lights packed for upload.
+		uint32_t variantDraws[LightVariantCount];	// Lit draws queued with each LightPixelShader variant.
+		uint32_t stateCalls;						// Issued by the state cache, command lists included.
+		uint32_t filteredCalls;
+	};
+
+	class SceneRenderer
+	{
+	public:
+		// Slots of the mesh table.
+		enum MeshId : uint32_t
+		{
+			MeshFloorBottom = 0,
+			MeshFloorPlatform,
+			MeshPokeplatRed,
+			MeshPokeplatWhite,
+			MeshPokeplatBlack,
+			MeshStadium,
+			MeshStadiumTop,
+			MeshPyramid,
+			MeshCount
+		};
+
+		// Where the skybox came from.
+		enum SkyboxSource : uint32_t
+		{
+			SkyboxNone = 0,
+			SkyboxPrebuilt,		// OutputCube.dds.
+			SkyboxFaces,		// Built from the six Skybox*.dds faces.
+			SkyboxEquirect		// Built from SkyboxEquirect.dds.
+		};
+
+		explicit SceneRenderer(IRenderDevice& device);
+		~SceneRenderer();
+
+		SceneRenderer(const SceneRenderer&) = delete;
+		SceneRenderer& operator=(const SceneRenderer&) = delete;
+
+		// Every shader the scene reads, by name: the ones Load needs, then the LightPixelShader variants,
+		// of which any may be missing.
+		static std::vector<const char*> GetShaderNames(void);
+		static const char* GetMeshFile(MeshId mesh);
+
+		// Reads the assets and creates every device object, on any one thread while no other call is
+		// made. Returns false, with nothing left on the device, when a file is missing or unreadable
+		// or the device fails.
+		bool Load(const SceneSettings& settings);
+		void Unload(void);
+		bool IsLoaded(void) const { return m_loaded; }
+		const std::string& GetLoadError(void) const { return m_loadError; }
+
+		void SetViewport(const SceneViewport& viewport);
+		// Row-major, row-vector world to view transform, and the eye in world space.
+		void SetCamera(const float view[16], const float eye[3]);
+		// Turns every copy of the scene about the y axis through the origin.
+		void SetSceneRotation(float radians);
+
+		// Moves the lights to where they are at time seconds; elapsed is the time since the last call.
+		void Update(double time, float elapsed);
+		void Render(void);
+
+		const SceneFrameStats& GetFrameStats(void) const { return m_frameStats; }
+		const CullStats& GetCullStats(void) const { return m_cullStats; }
+		const StateCacheStats& GetStateCacheStats(void) const { return m_stateCache.GetLastFrameStats(); }
+		const ResidencyStats& GetResidencyStats(void) const { return m_textureResidency.GetStats(); }
+		const PackStats& GetAtlasStats(void) const { return m_atlasStats; }
+		AlphaClass GetMaterialAlpha(uint32_t material) const { return m_materialAlpha[material]; }
+		uint32_t GetMaterialCount(void) const { return static_cast<uint32_t>(m_materialAlpha.size()); }
+		SkyboxSource GetSkyboxSource(void) const { return m_skyboxSource; }
+		const TessellationPolicy& GetTessellation(MeshId mesh) const { return m_meshes[mesh].tessellation; }
+		uint32_t GetLevelCount(MeshId mesh) const { return static_cast<uint32_t>(m_meshes[mesh].levels.size()); }
+		const LightGrid& GetLightGrid(void) const { return m_lightGrid; }
+		const LightStore& GetLights(void) const { return m_lights; }
+		size_t GetItemCount(void) const { return m_items.size(); }
+		size_t GetMarkerCount(void) const { return m_markers.Size(); }
+		// Half the width of the grid the copies stand on.
+		float GetSceneExtent(void) const { return m_sceneExtent; }
+
+	private:
+		enum PipelineId : uint32_t
+		{
+			PipelineLit = 0,		// Tessellated and lit.
+			PipelineLitFlat,		// Lit, for meshes not worth tessellating.
+			PipelineEdges,			// Unique edges as a line list.
+			PipelineInstanced,		// Instanced pyramids.
+			PipelineCount
+		};
+
+		// Render passes in draw order. The value is the pass field of the draw key.
+		enum RenderPass : uint32_t
+		{
+			PassOpaque = 0,
+			PassAlphaTested
+		};
+
+		// The shaders a pipeline binds. The lit pipelines have no pixel shader; each draw picks a
+		// LightPixelShader variant, and the shader field of its key is the pipeline times
+		// LightVariantCount plus that variant.
+		struct Pipeline
+		{
+			const void* inputLayout;
+			const void* shaders[StageCount];
+		};
+
+		// One pre-tessellated version of a mesh, drawn without the hull and domain shaders.
+		struct MeshLevel
+		{
+			const void* vertexBuffer;
+			const void* indexBuffer;
+			uint32_t indexCount;
+		};
+
+		struct MeshData
+		{
+			const void* vertexBuffer;
+			const void* indexBuffer;
+			uint32_t indexCount;
+			uint32_t topology;
+			PipelineId pipeline;
+			uint32_t material;				// MaterialNone if the pixel shader samples none.
+			MeshBounds bounds;
+			TessellationPolicy tessellation;
+			std::vector<MeshLevel> levels;	// Level i is tessellated with factor 2i + 1; empty if the GPU tessellates.
+			// Object-space triangles that hide other items; empty unless the mesh occludes.
+			std::vector<float> occluderPositions;
+			std::vector<uint32_t> occluderIndices;
+		};
+
+		// One object of the scene. The render queue sorts indices into m_items.
+		struct DrawItem
+		{
+			MeshId mesh;
+			SceneStore::Entity entity;		// NullEntity for instanced items.
+			uint32_t proxy;					// Leaf of the bounding tree.
+			MeshBounds worldBounds;
+			RingSlice constants;			// This frame's constants; size 0 if the upload failed.
+			InstanceSet* instances;			// World-space instance transforms, or null.
+			uint32_t instanceCount;			// This frame's visible instances.
+			uint32_t firstInstance;			// Start of those instances in the instance buffer.
+			uint32_t level;					// This frame's tessellation level.
+		};
+
+		// A buffer the pixel shaders read through a typed view, grown as needed.
+		struct ShaderBuffer
+		{
+			const void* buffer;
+			const void* view;
+			uint32_t capacity;				// Elements.
+		};
+
+		struct ResidentTexture
+		{
+			uint32_t handle;
+			const void* texture;
+		};
+
+		// Maps the constant ring's buffer through the device.
+		class DeviceRingBackend : public IConstantRingBackend
+		{
+		public:
+			explicit DeviceRingBackend(IRenderDevice& device) : m_device(device), m_buffer(nullptr) {}
+
+			void SetBuffer(const void* buffer) { m_buffer = buffer; }
+			const void* GetBuffer(void) const { return m_buffer; }
+
+			void* Map(bool discard) override { return m_device.Map(m_buffer, discard); }
+			void Unmap(void) override { m_device.Unmap(m_buffer); }
+
+		private:
+			IRenderDevice& m_device;
+			const void* m_buffer;
+		};
+
+		struct MeshInfo
+		{
+			const char* file;
+			PipelineId pipeline;
+			uint32_t material;
+			bool occluder;		// Hides the items behind it, if its material is opaque.
+		};
+
+		static const uint32_t MaterialNone = 0xffffffff;
+		static const MeshInfo MeshTable[MeshCount];
+
+		// Load steps; each records why it failed in m_loadError.
+		bool LoadShaders(void);
+		bool LoadMaterials(std::vector<PackedRegion>& regions);
+		bool LoadMeshes(const std::vector<PackedRegion>& regions);
+		bool LoadSkybox(void);
+		void CreateScene(void);
+		void CreateLights(void);
+		const void* Keep(const void* handle);
+		bool Fail(const std::string& message);
+		void UpdateProjection(void);
+		uint32_t RegisterTexture(const void* texture, const TextureDesc& desc);
+
+		// Frame steps, in Render's order.
+		void UploadLights(void);
+		void UploadLightGrid(void);
+		void CullItems(void);
+		void QueueItems(void);
+		void UploadDrawConstants(void);
+		void UploadInstances(void);
+		void DrawSkybox(void);
+		void ExecuteRenderQueue(void);
+		void RecordDraws(StateCache& cache, const DrawPacket* begin, const DrawPacket* end) const;
+		void BindSharedState(StateCache& cache) const;
+		void BindDrawConstants(StateCache& cache, const RingSlice& slice) const;
+		void UpdateTextureResidency(void);
+		void WriteShaderBuffer(ShaderBuffer& target, Format format, uint32_t elementSize, const void* data, uint32_t count);
+		void ReleaseShaderBuffer(ShaderBuffer& target);
+
+		IRenderDevice&			m_device;
+		SceneSettings			m_settings;
+		bool					m_loaded;
+		std::string				m_loadError;
+		// Objects created by Load, released by Unload.
+		std::vector<const void*>	m_handles;
+		bool						m_createFailed;
+
+		// Every bind goes through the cache, which drops calls that wouldn't change anything.
+		StateCache				m_stateCache;
+
+		MeshData				m_meshes[MeshCount];
+		MeshData				m_skybox;
+		Pipeline				m_pipelines[PipelineCount];
+		const void*				m_lightPixelShaders[LightVariantCount];	// In LightVariants order; null if not loaded.
+		LightPermutationTable	m_lightPermutations;
+		const void*				m_skyboxShaders[StageCount];
+		const void*				m_skyboxRasterizerState;
+		const void*				m_skyboxTexture;
+		SkyboxSource			m_skyboxSource;
+		const void*				m_sampler;
+
+		// Texture atlas pages, one Texture2DArray per packed group, and the atlas regions of the materials.
+		std::vector<const void*>	m_materialPages;
+		std::vector<uint32_t>		m_materialGroups;
+		std::vector<AlphaClass>		m_materialAlpha;
+		PackStats					m_atlasStats;
+
+		// Texture memory accounting, one handle per atlas page texture plus the skybox.
+		TextureResidency				m_textureResidency;
+		std::vector<ResidentTexture>	m_residentTextures;
+		std::vector<uint32_t>			m_materialResidency;	// By atlas group.
+		uint32_t						m_skyboxResidency;
+		std::vector<ResidencyChange>	m_residencyChanges;
+
+		// Transforms and bounds. One root carries the scene rotation, one entity per copy sits on the
+		// grid below it, and one per item below that. The tree answers the frustum query.
+		SceneStore				m_scene;
+		SceneStore::Entity		m_root;
+		std::vector<DrawItem>	m_items;
+		std::vector<float>		m_copyOffsets;		// x, z per copy.
+		float					m_sceneExtent;
+		BoundingTree			m_sceneTree;
+		std::vector<uint32_t>	m_visibleItems;
+		CullStats				m_cullStats;
+
+		// The floor platform and the stadium walls hide most of the scene from inside the stadium.
+		// Their triangles are rasterized into a small CPU depth buffer each frame, and visible items
+		// whose boxes are behind it are dropped before submission.
+		OcclusionBuffer			m_occlusion;
+		RenderQueue				m_renderQueue;
+
+		// Large render queues are split across the worker pool, each worker recording its share into
+		// its own command list. When the device has deferred contexts, each worker also plays its
+		// list into one; otherwise the lists replay on the immediate context in order.
+		std::vector<CommandList>	m_commandLists;
+		std::vector<uint8_t>		m_deferredFinished;
+
+		// Per-draw constants are written once per frame into slices of one dynamic buffer and bound
+		// by offset. Without constant buffer offsets the ring lives in memory and each slice is
+		// copied into m_constantBuffer before its draw.
+		ConstantRing			m_constantRing;
+		DeviceRingBackend		m_constantRingBackend;
+		MemoryRingBackend		m_constantRingMemory;
+		bool					m_constantOffsets;
+		const void*				m_constantBuffer;
+		RingSlice				m_skyboxConstants;
+
+		// One pyramid marks each light of each copy, drawn instanced. Every frame the visible
+		// instances are packed into one dynamic vertex buffer that grows as needed.
+		InstanceSet				m_markers;
+		const void*				m_instanceBuffer;
+		uint32_t				m_instanceCapacity;
+
+		// The directional light, then each copy's point and spot light, then the extra ones. Update
+		// moves them along their curves by the clock; only the lights that changed are packed and uploaded.
+		LightStore					m_lights;
+		LightStore::Light			m_directionalLight;
+		std::vector<LightStore::Light>	m_copyLights;		// Point and spot light per copy.
+		LightAnimation				m_lightAnimation;
+		LightAnimation::Track		m_spotTrack;		// The first copy's; every copy's spot moves alike.
+		std::vector<PackedLight>	m_packedLights;
+		SceneLightConstants			m_lightConstants;
+		bool						m_lightConstantsChanged;
+		const void*					m_lightBuffer;
+
+		// The point and spot lights are assigned to clusters of the view frustum every frame and read
+		// by LightPixelShader from three buffers: the lights, each cluster's range of the index list,
+		// and the index list. The directional light stays in the light constants. The light buffer is
+		// default usage, so that only the lights that changed are copied into it.
+		LightGrid					m_lightGrid;
+		std::vector<GridLight>		m_gridLights;
+		const void*					m_lightGridBuffer;
+		bool						m_lightGridChanged;
+		ShaderBuffer				m_clusterLights;
+		ShaderBuffer				m_clusterRanges;
+		ShaderBuffer				m_lightIndices;
+		uint32_t					m_frameLights;		// LightPermutationFeature light bits.
+
+		// Camera and projection.
+		SceneViewport			m_viewport;
+		bool					m_hasViewport;
+		float					m_farZ;
+		float					m_tessellationScale;	// Hull shader segments per unit of edge length at distance 1.
+		float					m_projection[16];		// Row-major, row-vector, orientation included.
+		float					m_view[16];
+		float					m_eye[3];
+		SceneConstants			m_frameConstants;		// This frame's view and projection, transposed for the shaders.
+
+		SceneFrameStats			m_frameStats;
+	};
+}
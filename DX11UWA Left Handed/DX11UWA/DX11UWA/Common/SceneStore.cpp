@@ -0,0 +1,584 @@
+#include "SceneStore.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace DX;
+
+const SceneStore::Entity SceneStore::NullEntity;
+const uint32_t SceneStore::NullHandle;
+const uint32_t SceneStore::MaxEntities;
+
+namespace
+{
+	// Levels smaller than this are updated on the calling thread. The grain keeps batches whole.
+	const size_t ParallelThreshold = 64 * 1024;
+	const size_t ParallelGrain = 16 * 1024;
+
+	const uint32_t IndexMask = SceneStore::MaxEntities - 1;
+	const uint32_t UnknownDepth = 0xffffffff;
+
+	// One value per entity, so the transform kernel below is written once and runs eight (AVX2),
+	// four (SSE2) or one entity at a time.
+	struct Single
+	{
+		static const size_t Width = 1;
+		float v;
+
+		static Single Load(const float* p) { Single r = { *p }; return r; }
+		static Single Gather(const float* base, const uint32_t* index) { Single r = { base[*index] }; return r; }
+		static Single Splat(float s) { Single r = { s }; return r; }
+		void Store(float* p) const { *p = v; }
+		Single Abs(void) const { Single r = { fabsf(v) }; return r; }
+	};
+
+	inline Single operator+(Single a, Single b) { Single r = { a.v + b.v }; return r; }
+	inline Single operator-(Single a, Single b) { Single r = { a.v - b.v }; return r; }
+	inline Single operator*(Single a, Single b) { Single r = { a.v * b.v }; return r; }
+
+#if DX_SIMD_AVX2
+	struct Batch
+	{
+		static const size_t Width = 8;
+		__m256 v;
+
+		static Batch Load(const float* p) { Batch r = { _mm256_loadu_ps(p) }; return r; }
+		static Batch Gather(const float* base, const uint32_t* index)
+		{
+			Batch r = { _mm256_i32gather_ps(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index)), 4) };
+			return r;
+		}
+		static Batch Splat(float s) { Batch r = { _mm256_set1_ps(s) }; return r; }
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+		Batch Abs(void) const { Batch r = { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v) }; return r; }
+	};
+
+	inline Batch operator+(Batch a, Batch b) { Batch r = { _mm256_add_ps(a.v, b.v) }; return r; }
+	inline Batch operator-(Batch a, Batch b) { Batch r = { _mm256_sub_ps(a.v, b.v) }; return r; }
+	inline Batch operator*(Batch a, Batch b) { Batch r = { _mm256_mul_ps(a.v, b.v) }; return r; }
+#elif DX_SIMD_SSE2
+	struct Batch
+	{
+		static const size_t Width = 4;
+		__m128 v;
+
+		static Batch Load(const float* p) { Batch r = { _mm_loadu_ps(p) }; return r; }
+		static Batch Gather(const float* base, const uint32_t* index)
+		{
+			Batch r = { _mm_setr_ps(base[index[0]], base[index[1]], base[index[2]], base[index[3]]) };
+			return r;
+		}
+		static Batch Splat(float s) { Batch r = { _mm_set1_ps(s) }; return r; }
+		void Store(float* p) const { _mm_storeu_ps(p, v); }
+		Batch Abs(void) const { Batch r = { _mm_andnot_ps(_mm_set1_ps(-0.0f), v) }; return r; }
+	};
+
+	inline Batch operator+(Batch a, Batch b) { Batch r = { _mm_add_ps(a.v, b.v) }; return r; }
+	inline Batch operator-(Batch a, Batch b) { Batch r = { _mm_sub_ps(a.v, b.v) }; return r; }
+	inline Batch operator*(Batch a, Batch b) { Batch r = { _mm_mul_ps(a.v, b.v) }; return r; }
+#else
+	typedef Single Batch;
+#endif
+
+	struct Columns
+	{
+		const float* const* local;	// Indexed by LocalComponent.
+		float* const* world;		// The 12 world matrix entries.
+		float* box[6];				// World box center x, y, z, then extents.
+		const uint32_t* parents;
+	};
+
+	// Computes the world matrix and box of the B::Width entities starting at slot i. The local
+	// matrix is scale * rotation * translation, as XMMatrixAffineTransformation builds it.
+	template <typename B>
+	void TransformEntities(const Columns& columns, size_t i, bool roots)
+	{
+		const float* const* local = columns.local;
+		B qx = B::Load(local[3] + i);
+		B qy = B::Load(local[4] + i);
+		B qz = B::Load(local[5] + i);
+		B qw = B::Load(local[6] + i);
+		B x2 = qx + qx, y2 = qy + qy, z2 = qz + qz;
+		B xx = qx * x2, yy = qy * y2, zz = qz * z2;
+		B xy = qx * y2, xz = qx * z2, yz = qy * z2;
+		B wx = qw * x2, wy = qw * y2, wz = qw * z2;
+		B one = B::Splat(1.0f);
+		B sx = B::Load(local[7] + i);
+		B sy = B::Load(local[8] + i);
+		B sz = B::Load(local[9] + i);
+
+		B m[12];
+		m[0] = sx * (one - (yy + zz));
+		m[1] = sx * (xy + wz);
+		m[2] = sx * (xz - wy);
+		m[3] = sy * (xy - wz);
+		m[4] = sy * (one - (xx + zz));
+		m[5] = sy * (yz + wx);
+		m[6] = sz * (xz + wy);
+		m[7] = sz * (yz - wx);
+		m[8] = sz * (one - (xx + yy));
+		m[9] = B::Load(local[0] + i);
+		m[10] = B::Load(local[1] + i);
+		m[11] = B::Load(local[2] + i);
+
+		if (!roots)
+		{
+			// Parents live on the previous level, which is already done.
+			B p[12];
+			for (int k = 0; k < 12; ++k)
+			{
+				p[k] = B::Gather(columns.world[k], columns.parents + i);
+			}
+
+			B w[12];
+			for (int row = 0; row < 4; ++row)
+			{
+				const B* r = m + row * 3;
+				for (int column = 0; column < 3; ++column)
+				{
+					w[row * 3 + column] = r[0] * p[column] + r[1] * p[3 + column] + r[2] * p[6 + column];
+				}
+			}
+			for (int column = 0; column < 3; ++column)
+			{
+				m[column] = w[column];
+				m[3 + column] = w[3 + column];
+				m[6 + column] = w[6 + column];
+				m[9 + column] = w[9 + column] + p[9 + column];
+			}
+		}
+
+		for (int k = 0; k < 12; ++k)
+		{
+			m[k].Store(columns.world[k] + i);
+		}
+
+		B cx = B::Load(local[10] + i);
+		B cy = B::Load(local[11] + i);
+		B cz = B::Load(local[12] + i);
+		B ex = B::Load(local[13] + i);
+		B ey = B::Load(local[14] + i);
+		B ez = B::Load(local[15] + i);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			B center = cx * m[axis] + cy * m[3 + axis] + cz * m[6 + axis] + m[9 + axis];
+			B extent = ex * m[axis].Abs() + ey * m[3 + axis].Abs() + ez * m[6 + axis].Abs();
+			center.Store(columns.box[axis] + i);
+			extent.Store(columns.box[3 + axis] + i);
+		}
+	}
+
+	template <typename T>
+	void Permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+	{
+		std::vector<T> sorted(order.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			sorted[i] = values[order[i]];
+		}
+		values.swap(sorted);
+	}
+
+	void PermuteBoxes(BoxList& boxes, const std::vector<uint32_t>& order)
+	{
+		size_t count = boxes.Size();
+		std::vector<float> components[6];
+		float* source[6] = { boxes.CenterX(), boxes.CenterY(), boxes.CenterZ(),
+							 boxes.ExtentX(), boxes.ExtentY(), boxes.ExtentZ() };
+		for (int k = 0; k < 6; ++k)
+		{
+			components[k].assign(source[k], source[k] + count);
+			Permute(components[k], order);
+		}
+
+		boxes.Resize(order.size());
+		float* destination[6] = { boxes.CenterX(), boxes.CenterY(), boxes.CenterZ(),
+								  boxes.ExtentX(), boxes.ExtentY(), boxes.ExtentZ() };
+		for (int k = 0; k < 6; ++k)
+		{
+			if (!order.empty())
+				memcpy(destination[k], components[k].data(), order.size() * sizeof(float));
+		}
+	}
+}
+
+SceneStore::SceneStore() :
+	m_orderDirty(false)
+{
+}
+
+void SceneStore::Reserve(size_t count)
+{
+	m_slots.reserve(count);
+	m_generations.reserve(count);
+	m_entities.reserve(count);
+	m_parents.reserve(count);
+	m_meshes.reserve(count);
+	m_materials.reserve(count);
+	m_dirty.reserve(count);
+	m_changed.reserve(count);
+	m_destroyed.reserve(count);
+	for (int k = 0; k < LocalCount; ++k)
+	{
+		m_local[k].reserve(count);
+	}
+	for (int k = 0; k < WorldCount; ++k)
+	{
+		m_world[k].reserve(count);
+	}
+	m_worldBoxes.Reserve(count);
+}
+
+void SceneStore::Clear(void)
+{
+	for (uint32_t index = 0; index < m_slots.size(); ++index)
+	{
+		if (m_slots[index] != NullHandle)
+		{
+			m_slots[index] = NullHandle;
+			++m_generations[index];
+			m_freeIndices.push_back(index);
+		}
+	}
+
+	m_entities.clear();
+	m_parents.clear();
+	m_meshes.clear();
+	m_materials.clear();
+	m_dirty.clear();
+	m_changed.clear();
+	m_destroyed.clear();
+	for (int k = 0; k < LocalCount; ++k)
+	{
+		m_local[k].clear();
+	}
+	for (int k = 0; k < WorldCount; ++k)
+	{
+		m_world[k].clear();
+	}
+	m_worldBoxes.Clear();
+	m_levels.clear();
+	m_orderDirty = false;
+}
+
+SceneStore::Entity SceneStore::Create(Entity parent)
+{
+	uint32_t index;
+	if (!m_freeIndices.empty())
+	{
+		index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else
+	{
+		if (m_slots.size() >= MaxEntities)
+			return NullEntity;
+		index = static_cast<uint32_t>(m_slots.size());
+		m_slots.push_back(NullHandle);
+		m_generations.push_back(0);
+	}
+
+	uint32_t slot = static_cast<uint32_t>(m_entities.size());
+	Entity entity = index | (uint32_t(m_generations[index]) << 24);
+	m_slots[index] = slot;
+
+	static const float Local[LocalCount] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0 };
+	static const float World[WorldCount] = { 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0 };
+	m_entities.push_back(entity);
+	m_parents.push_back(parent == NullEntity ? NullHandle : SlotOf(parent));
+	m_meshes.push_back(NullHandle);
+	m_materials.push_back(NullHandle);
+	m_dirty.push_back(1);
+	m_changed.push_back(0);
+	m_destroyed.push_back(0);
+	for (int k = 0; k < LocalCount; ++k)
+	{
+		m_local[k].push_back(Local[k]);
+	}
+	for (int k = 0; k < WorldCount; ++k)
+	{
+		m_world[k].push_back(World[k]);
+	}
+	m_worldBoxes.Resize(m_entities.size());
+
+	// Appending breaks the depth order unless the new entity happens to be on the deepest level.
+	m_orderDirty = true;
+	return entity;
+}
+
+void SceneStore::Destroy(Entity entity)
+{
+	m_destroyed[SlotOf(entity)] = 1;
+	m_orderDirty = true;
+}
+
+bool SceneStore::IsAlive(Entity entity) const
+{
+	uint32_t index = entity & IndexMask;
+	if (entity == NullEntity || index >= m_slots.size() || m_slots[index] == NullHandle)
+		return false;
+	return m_generations[index] == (entity >> 24) && !m_destroyed[m_slots[index]];
+}
+
+bool SceneStore::SetParent(Entity entity, Entity parent)
+{
+	uint32_t slot = SlotOf(entity);
+	uint32_t parentSlot = parent == NullEntity ? NullHandle : SlotOf(parent);
+	for (uint32_t ancestor = parentSlot; ancestor != NullHandle; ancestor = m_parents[ancestor])
+	{
+		if (ancestor == slot)
+			return false;
+	}
+
+	m_parents[slot] = parentSlot;
+	MarkDirty(slot);
+	m_orderDirty = true;
+	return true;
+}
+
+SceneStore::Entity SceneStore::GetParent(Entity entity) const
+{
+	uint32_t parentSlot = m_parents[SlotOf(entity)];
+	return parentSlot == NullHandle ? NullEntity : m_entities[parentSlot];
+}
+
+void SceneStore::SetPosition(Entity entity, float x, float y, float z)
+{
+	uint32_t slot = SlotOf(entity);
+	m_local[PositionX][slot] = x;
+	m_local[PositionY][slot] = y;
+	m_local[PositionZ][slot] = z;
+	MarkDirty(slot);
+}
+
+void SceneStore::SetRotation(Entity entity, float x, float y, float z, float w)
+{
+	uint32_t slot = SlotOf(entity);
+	m_local[RotationX][slot] = x;
+	m_local[RotationY][slot] = y;
+	m_local[RotationZ][slot] = z;
+	m_local[RotationW][slot] = w;
+	MarkDirty(slot);
+}
+
+void SceneStore::SetScale(Entity entity, float x, float y, float z)
+{
+	uint32_t slot = SlotOf(entity);
+	m_local[ScaleX][slot] = x;
+	m_local[ScaleY][slot] = y;
+	m_local[ScaleZ][slot] = z;
+	MarkDirty(slot);
+}
+
+void SceneStore::SetLocalBounds(Entity entity, const MeshBounds& bounds)
+{
+	uint32_t slot = SlotOf(entity);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_local[CenterX + axis][slot] = bounds.center[axis];
+		m_local[ExtentX + axis][slot] = bounds.extents[axis];
+	}
+	MarkDirty(slot);
+}
+
+void SceneStore::Rebuild(void)
+{
+	size_t count = m_entities.size();
+
+	// Depth of every slot. Walking up to the first slot with a known depth keeps this linear;
+	// destruction is inherited on the way back down.
+	std::vector<uint32_t> depths(count, UnknownDepth);
+	std::vector<uint32_t> chain;
+	uint32_t levelCount = 0;
+	for (uint32_t slot = 0; slot < count; ++slot)
+	{
+		uint32_t top = slot;
+		while (depths[top] == UnknownDepth)
+		{
+			chain.push_back(top);
+			if (m_parents[top] == NullHandle)
+				break;
+			top = m_parents[top];
+		}
+		if (depths[top] == UnknownDepth)
+		{
+			depths[top] = 0;
+			chain.pop_back();
+		}
+
+		uint32_t depth = depths[top];
+		uint8_t destroyed = m_destroyed[top];
+		while (!chain.empty())
+		{
+			uint32_t child = chain.back();
+			chain.pop_back();
+			depths[child] = ++depth;
+			m_destroyed[child] |= destroyed;
+			destroyed = m_destroyed[child];
+		}
+		if (!m_destroyed[slot] && depths[slot] + 1 > levelCount)
+			levelCount = depths[slot] + 1;
+	}
+
+	// Counting sort of the surviving slots by depth; slots on one level keep their order.
+	m_levels.assign(levelCount + 1, 0);
+	for (uint32_t slot = 0; slot < count; ++slot)
+	{
+		if (!m_destroyed[slot])
+			++m_levels[depths[slot] + 1];
+	}
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		m_levels[level + 1] += m_levels[level];
+	}
+
+	std::vector<uint32_t> next(m_levels.begin(), m_levels.end() - 1);
+	std::vector<uint32_t> order(m_levels.back());
+	std::vector<uint32_t> newSlots(count, NullHandle);
+	for (uint32_t slot = 0; slot < count; ++slot)
+	{
+		uint32_t index = m_entities[slot] & IndexMask;
+		if (m_destroyed[slot])
+		{
+			m_slots[index] = NullHandle;
+			++m_generations[index];
+			m_freeIndices.push_back(index);
+			continue;
+		}
+		uint32_t newSlot = next[depths[slot]]++;
+		order[newSlot] = slot;
+		newSlots[slot] = newSlot;
+		m_slots[index] = newSlot;
+	}
+
+	std::vector<uint32_t> parents(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		uint32_t parent = m_parents[order[i]];
+		parents[i] = parent == NullHandle ? NullHandle : newSlots[parent];
+	}
+	m_parents.swap(parents);
+
+	Permute(m_entities, order);
+	Permute(m_meshes, order);
+	Permute(m_materials, order);
+	Permute(m_dirty, order);
+	Permute(m_changed, order);
+	m_destroyed.assign(order.size(), 0);
+	for (int k = 0; k < LocalCount; ++k)
+	{
+		Permute(m_local[k], order);
+	}
+	for (int k = 0; k < WorldCount; ++k)
+	{
+		Permute(m_world[k], order);
+	}
+	PermuteBoxes(m_worldBoxes, order);
+
+	m_orderDirty = false;
+}
+
+void SceneStore::UpdateRange(size_t begin, size_t end, bool roots)
+{
+	const uint8_t* dirty = m_dirty.data();
+	uint8_t* changed = m_changed.data();
+	const uint32_t* parents = m_parents.data();
+	for (size_t i = begin; i < end; ++i)
+	{
+		changed[i] = dirty[i] | (roots ? 0 : changed[parents[i]]);
+	}
+
+	const float* local[LocalCount];
+	for (int k = 0; k < LocalCount; ++k)
+	{
+		local[k] = m_local[k].data();
+	}
+	float* world[WorldCount];
+	for (int k = 0; k < WorldCount; ++k)
+	{
+		world[k] = m_world[k].data();
+	}
+	Columns columns = { local, world,
+		{ m_worldBoxes.CenterX(), m_worldBoxes.CenterY(), m_worldBoxes.CenterZ(),
+		  m_worldBoxes.ExtentX(), m_worldBoxes.ExtentY(), m_worldBoxes.ExtentZ() },
+		parents };
+
+	// A batch is recomputed whole if any entity in it changed; the others get the same result again.
+	size_t i = begin;
+	for (; i + Batch::Width <= end; i += Batch::Width)
+	{
+		uint8_t any = 0;
+		for (size_t lane = 0; lane < Batch::Width; ++lane)
+		{
+			any |= changed[i + lane];
+		}
+		if (any)
+			TransformEntities<Batch>(columns, i, roots);
+	}
+	for (; i < end; ++i)
+	{
+		if (changed[i])
+			TransformEntities<Single>(columns, i, roots);
+	}
+}
+
+void SceneStore::UpdateTransforms(void)
+{
+	if (m_orderDirty)
+		Rebuild();
+
+	for (size_t level = 0; level + 1 < m_levels.size(); ++level)
+	{
+		size_t begin = m_levels[level];
+		size_t end = m_levels[level + 1];
+		bool roots = level == 0;
+		if (end - begin < ParallelThreshold)
+		{
+			UpdateRange(begin, end, roots);
+			continue;
+		}
+
+		WorkerPool::Shared().ParallelFor(end - begin, ParallelGrain, [&](size_t first, size_t last)
+		{
+			UpdateRange(begin + first, begin + last, roots);
+		});
+	}
+
+	if (!m_dirty.empty())
+		memset(m_dirty.data(), 0, m_dirty.size());
+}
+
+void SceneStore::GetWorldMatrix(Entity entity, float world[16]) const
+{
+	uint32_t slot = SlotOf(entity);
+	for (int row = 0; row < 4; ++row)
+	{
+		for (int column = 0; column < 3; ++column)
+		{
+			world[row * 4 + column] = m_world[row * 3 + column][slot];
+		}
+		world[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+	}
+}
+
+MeshBounds SceneStore::GetWorldBounds(Entity entity) const
+{
+	uint32_t slot = SlotOf(entity);
+	const float center[3] = { m_worldBoxes.CenterX()[slot], m_worldBoxes.CenterY()[slot], m_worldBoxes.CenterZ()[slot] };
+	const float extents[3] = { m_worldBoxes.ExtentX()[slot], m_worldBoxes.ExtentY()[slot], m_worldBoxes.ExtentZ()[slot] };
+
+	MeshBounds bounds;
+	float radiusSq = 0.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bounds.center[axis] = center[axis];
+		bounds.extents[axis] = extents[axis];
+		bounds.min[axis] = center[axis] - extents[axis];
+		bounds.max[axis] = center[axis] + extents[axis];
+		radiusSq += extents[axis] * extents[axis];
+	}
+	bounds.radius = sqrtf(radiusSq);
+	return bounds;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+// Entity store for scene objects. Every component lives in a dense array indexed by slot:
+// local position, rotation and scale, object-space bounds, mesh and material handles, and the
+// world matrix and world box derived from them. Entities may have a parent. Slots are kept
+// sorted by depth in the hierarchy, so UpdateTransforms can finish one level before starting
+// the next, splitting each level across the shared worker pool and computing eight (AVX2) or
+// four (SSE2) entities per step. Only entities whose local transform, or an ancestor's,
+// changed since the last update are recomputed.
+// Matrices follow the DirectXMath layout: row-major and row vectors, so world = local * parent.
+// Rotations are unit quaternions stored as (x, y, z, w).
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class SceneStore
+	{
+	public:
+		// Index in the low 24 bits and a generation in the high 8, so most stale handles are caught.
+		typedef uint32_t Entity;
+		static const Entity NullEntity = 0xffffffff;
+		static const uint32_t NullHandle = 0xffffffff;
+		static const uint32_t MaxEntities = 1 << 24;
+
+		SceneStore();
+
+		void Reserve(size_t count);
+		// Destroys every entity; handles from before the call become stale.
+		void Clear(void);
+
+		// New entities sit at the origin with no rotation, unit scale, empty bounds and null handles.
+		Entity Create(Entity parent = NullEntity);
+		// Destroys the entity and everything below it. The descendants stay alive until the next
+		// UpdateTransforms, which also reclaims their slots.
+		void Destroy(Entity entity);
+		bool IsAlive(Entity entity) const;
+
+		// Keeps the local transform, so the entity follows its new parent from the next update.
+		// Fails if parent is the entity itself or one of its descendants.
+		bool SetParent(Entity entity, Entity parent);
+		Entity GetParent(Entity entity) const;
+
+		void SetPosition(Entity entity, float x, float y, float z);
+		void SetRotation(Entity entity, float x, float y, float z, float w);
+		void SetScale(Entity entity, float x, float y, float z);
+		void SetLocalBounds(Entity entity, const MeshBounds& bounds);
+
+		void SetMesh(Entity entity, uint32_t mesh) { m_meshes[SlotOf(entity)] = mesh; }
+		void SetMaterial(Entity entity, uint32_t material) { m_materials[SlotOf(entity)] = material; }
+		uint32_t GetMesh(Entity entity) const { return m_meshes[SlotOf(entity)]; }
+		uint32_t GetMaterial(Entity entity) const { return m_materials[SlotOf(entity)]; }
+
+		// Recomputes the world matrix and box of every entity that moved since the last call.
+		void UpdateTransforms(void);
+
+		// Results of the last UpdateTransforms.
+		void GetWorldMatrix(Entity entity, float world[16]) const;
+		MeshBounds GetWorldBounds(Entity entity) const;
+		bool WasChanged(Entity entity) const { return m_changed[SlotOf(entity)] != 0; }
+
+		// Dense views in slot order, for bulk consumers such as CullBoxList. Slots are renumbered
+		// by UpdateTransforms whenever the hierarchy changed.
+		size_t GetSlotCount(void) const { return m_entities.size(); }
+		Entity GetEntityAt(uint32_t slot) const { return m_entities[slot]; }
+		const BoxList& GetWorldBoxes(void) const { return m_worldBoxes; }
+		size_t GetLevelCount(void) const { return m_levels.empty() ? 0 : m_levels.size() - 1; }
+
+	private:
+		enum LocalComponent
+		{
+			PositionX = 0, PositionY, PositionZ,
+			RotationX, RotationY, RotationZ, RotationW,
+			ScaleX, ScaleY, ScaleZ,
+			CenterX, CenterY, CenterZ,
+			ExtentX, ExtentY, ExtentZ,
+			LocalCount
+		};
+
+		// The world matrix without its constant last column, as rows 0-2 (linear) and row 3 (translation).
+		static const int WorldCount = 12;
+
+		uint32_t SlotOf(Entity entity) const { return m_slots[entity & (MaxEntities - 1)]; }
+		void MarkDirty(uint32_t slot) { m_dirty[slot] = 1; }
+		// Sorts the slots by depth, drops destroyed subtrees and rebuilds m_levels.
+		void Rebuild(void);
+		void UpdateRange(size_t begin, size_t end, bool roots);
+
+		// Per entity index.
+		std::vector<uint32_t> m_slots;
+		std::vector<uint8_t> m_generations;
+		std::vector<uint32_t> m_freeIndices;
+
+		// Per slot.
+		std::vector<Entity> m_entities;
+		std::vector<uint32_t> m_parents;		// Slot of the parent, or NullHandle.
+		std::vector<uint32_t> m_meshes;
+		std::vector<uint32_t> m_materials;
+		std::vector<uint8_t> m_dirty;			// Local transform or bounds changed.
+		std::vector<uint8_t> m_changed;			// World changed in the last update.
+		std::vector<uint8_t> m_destroyed;
+		std::vector<float> m_local[LocalCount];
+		std::vector<float> m_world[WorldCount];
+		BoxList m_worldBoxes;
+
+		std::vector<uint32_t> m_levels;			// First slot of each depth, then the slot count.
+		bool m_orderDirty;
+	};
+}
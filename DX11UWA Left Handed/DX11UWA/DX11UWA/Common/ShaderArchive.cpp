@@ -0,0 +1,314 @@
+#include "ShaderArchive.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace DX;
+
+const uint32_t ShaderArchive::Magic;
+const uint32_t ShaderArchive::Version;
+const uint32_t ShaderArchive::EmptySlot;
+const uint32_t ShaderArchive::DataAlignment;
+
+namespace
+{
+	size_t Align(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// At most half full, so lookups rarely probe more than one slot.
+	uint32_t SlotCount(size_t entryCount)
+	{
+		uint32_t count = 16;
+		while (count < entryCount * 2)
+		{
+			count *= 2;
+		}
+		return count;
+	}
+
+	bool InBounds(uint64_t offset, uint64_t size, size_t total)
+	{
+		return offset <= total && size <= total - offset;
+	}
+
+	// Maps the whole file read-only; null if it can't be opened, is empty or can't be mapped.
+	void* MapFile(const char* path, size_t& size)
+	{
+#if defined(_WIN32)
+		int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+		if (length <= 0)
+			return nullptr;
+		std::wstring widePath(length, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, path, -1, &widePath[0], length);
+
+		HANDLE file = CreateFile2(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+		void* view = nullptr;
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && uint64_t(fileSize.QuadPart) <= SIZE_MAX)
+		{
+			// The view keeps the mapping and the file open after their handles close.
+			HANDLE mapping = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+			if (mapping)
+			{
+				view = MapViewOfFileFromApp(mapping, FILE_MAP_READ, 0, 0);
+				CloseHandle(mapping);
+			}
+			size = size_t(fileSize.QuadPart);
+		}
+		CloseHandle(file);
+		return view;
+#else
+		int file = open(path, O_RDONLY);
+		if (file < 0)
+			return nullptr;
+		void* view = nullptr;
+		struct stat status;
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+		{
+			view = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (view == MAP_FAILED)
+				view = nullptr;
+			size = size_t(status.st_size);
+		}
+		close(file);
+		return view;
+#endif
+	}
+
+	void UnmapFile(void* view, size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		UnmapViewOfFile(view);
+#else
+		munmap(view, size);
+#endif
+	}
+}
+
+uint64_t DX::HashShaderName(const char* name, size_t length)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= uint8_t(name[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool DX::WriteShaderArchive(const std::vector<ShaderArchiveEntry>& entries, std::vector<uint8_t>& archive)
+{
+	typedef ShaderArchive::Header Header;
+	typedef ShaderArchive::Entry Entry;
+
+	const uint32_t slotCount = SlotCount(entries.size());
+	const size_t entriesOffset = sizeof(Header);
+	const size_t slotsOffset = entriesOffset + sizeof(Entry) * entries.size();
+	const size_t namesOffset = slotsOffset + sizeof(uint32_t) * slotCount;
+	size_t size = namesOffset;
+	for (const ShaderArchiveEntry& entry : entries)
+	{
+		if (entry.name.empty())
+			return false;
+		size += entry.name.size() + 1;
+	}
+	for (const ShaderArchiveEntry& entry : entries)
+	{
+		size = Align(size, ShaderArchive::DataAlignment) + entry.bytecode.size();
+	}
+	if (size > UINT32_MAX)
+		return false;
+
+	archive.assign(size, 0);
+	Header header = { ShaderArchive::Magic, ShaderArchive::Version, uint32_t(entries.size()), slotCount,
+					  uint32_t(entriesOffset), uint32_t(slotsOffset), uint32_t(namesOffset), uint32_t(size) };
+	memcpy(archive.data(), &header, sizeof(header));
+
+	std::vector<uint32_t> slots(slotCount, ShaderArchive::EmptySlot);
+	size_t nameOffset = namesOffset;
+	size_t dataOffset = nameOffset;
+	for (const ShaderArchiveEntry& entry : entries)
+	{
+		dataOffset += entry.name.size() + 1;
+	}
+	for (uint32_t i = 0; i < entries.size(); ++i)
+	{
+		const ShaderArchiveEntry& source = entries[i];
+		Entry entry;
+		entry.hash = HashShaderName(source.name.data(), source.name.size());
+		entry.nameOffset = uint32_t(nameOffset);
+		entry.nameLength = uint32_t(source.name.size());
+		dataOffset = Align(dataOffset, ShaderArchive::DataAlignment);
+		entry.dataOffset = uint32_t(dataOffset);
+		entry.dataSize = uint32_t(source.bytecode.size());
+
+		uint32_t slot = uint32_t(entry.hash) & (slotCount - 1);
+		for (; slots[slot] != ShaderArchive::EmptySlot; slot = (slot + 1) & (slotCount - 1))
+		{
+			if (entries[slots[slot]].name == source.name)
+				return false;
+		}
+		slots[slot] = i;
+
+		memcpy(&archive[entriesOffset + sizeof(Entry) * i], &entry, sizeof(entry));
+		memcpy(&archive[nameOffset], source.name.data(), source.name.size());
+		if (!source.bytecode.empty())
+			memcpy(&archive[dataOffset], source.bytecode.data(), source.bytecode.size());
+		nameOffset += source.name.size() + 1;
+		dataOffset += source.bytecode.size();
+	}
+	memcpy(&archive[slotsOffset], slots.data(), sizeof(uint32_t) * slotCount);
+	return true;
+}
+
+ShaderArchive::ShaderArchive() :
+	m_data(nullptr),
+	m_size(0),
+	m_mapping(nullptr),
+	m_entries(nullptr),
+	m_slots(nullptr),
+	m_entryCount(0),
+	m_slotMask(0)
+{
+}
+
+ShaderArchive::~ShaderArchive()
+{
+	Close();
+}
+
+bool ShaderArchive::Open(const char* path)
+{
+	Close();
+	size_t size = 0;
+	void* view = MapFile(path, size);
+	if (!view)
+		return false;
+	m_mapping = view;
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = size;
+	if (Validate())
+		return true;
+	Close();
+	return false;
+}
+
+bool ShaderArchive::OpenMemory(const void* data, size_t size)
+{
+	Close();
+	// The table of contents is read in place, so it has to be aligned like its 64-bit hashes.
+	if (!data || reinterpret_cast<uintptr_t>(data) % alignof(Entry) != 0)
+		return false;
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = size;
+	if (Validate())
+		return true;
+	Close();
+	return false;
+}
+
+void ShaderArchive::Close(void)
+{
+	Unmap();
+	m_data = nullptr;
+	m_size = 0;
+	m_entries = nullptr;
+	m_slots = nullptr;
+	m_entryCount = 0;
+	m_slotMask = 0;
+}
+
+void ShaderArchive::Unmap(void)
+{
+	if (m_mapping)
+	{
+		UnmapFile(m_mapping, m_size);
+		m_mapping = nullptr;
+	}
+}
+
+// Checks every offset in the table of contents once, so Find and Get never read outside the
+// archive. An archive whose entries aren't where their hashes put them is still safe to use;
+// Find just won't return them.
+bool ShaderArchive::Validate(void)
+{
+	Header header;
+	if (m_size < sizeof(header))
+		return false;
+	memcpy(&header, m_data, sizeof(header));
+	if (header.magic != Magic || header.version != Version || header.size != m_size)
+		return false;
+	if (header.slotCount <= header.entryCount || (header.slotCount & (header.slotCount - 1)) != 0 ||
+		header.entriesOffset % alignof(Entry) != 0 || header.slotsOffset % alignof(uint32_t) != 0 ||
+		!InBounds(header.entriesOffset, uint64_t(sizeof(Entry)) * header.entryCount, m_size) ||
+		!InBounds(header.slotsOffset, uint64_t(sizeof(uint32_t)) * header.slotCount, m_size))
+		return false;
+
+	const Entry* entries = reinterpret_cast<const Entry*>(m_data + header.entriesOffset);
+	const uint32_t* slots = reinterpret_cast<const uint32_t*>(m_data + header.slotsOffset);
+	uint32_t emptySlots = 0;
+	for (uint32_t slot = 0; slot < header.slotCount; ++slot)
+	{
+		if (slots[slot] == EmptySlot)
+			++emptySlots;
+		else if (slots[slot] >= header.entryCount)
+			return false;
+	}
+	if (emptySlots == 0)
+		return false;
+	for (uint32_t i = 0; i < header.entryCount; ++i)
+	{
+		const Entry& entry = entries[i];
+		if (!InBounds(entry.nameOffset, uint64_t(entry.nameLength) + 1, m_size) || m_data[entry.nameOffset + entry.nameLength] != 0 ||
+			!InBounds(entry.dataOffset, entry.dataSize, m_size) || entry.dataOffset % DataAlignment != 0 ||
+			entry.hash != HashShaderName(reinterpret_cast<const char*>(m_data + entry.nameOffset), entry.nameLength))
+			return false;
+	}
+
+	m_entries = entries;
+	m_slots = slots;
+	m_entryCount = header.entryCount;
+	m_slotMask = header.slotCount - 1;
+	return true;
+}
+
+const char* ShaderArchive::GetName(uint32_t index) const
+{
+	return reinterpret_cast<const char*>(m_data + m_entries[index].nameOffset);
+}
+
+ShaderBytecode ShaderArchive::Get(uint32_t index) const
+{
+	ShaderBytecode bytecode = { m_data + m_entries[index].dataOffset, m_entries[index].dataSize };
+	return bytecode;
+}
+
+ShaderBytecode ShaderArchive::Find(const char* name) const
+{
+	ShaderBytecode none = { nullptr, 0 };
+	if (!m_data)
+		return none;
+	size_t length = strlen(name);
+	uint64_t hash = HashShaderName(name, length);
+	// Validate made sure there is an empty slot to stop at.
+	for (uint32_t slot = uint32_t(hash) & m_slotMask; m_slots[slot] != EmptySlot; slot = (slot + 1) & m_slotMask)
+	{
+		const Entry& entry = m_entries[m_slots[slot]];
+		if (entry.hash == hash && entry.nameLength == length && memcmp(m_data + entry.nameOffset, name, length) == 0)
+			return Get(m_slots[slot]);
+	}
+	return none;
+}
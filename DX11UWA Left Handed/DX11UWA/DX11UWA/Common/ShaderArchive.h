@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Compiled shaders packed into one file, so start-up maps a single file instead of opening and
+// copying every .cso on its own. The file is a header, a table of contents and the bytecode:
+// an open-addressing hash table of slots over the entries, keyed by the 64-bit FNV-1a hash of
+// each name, the names, and each shader's bytecode at a 16-byte boundary. Open maps the file
+// read-only and checks every offset once; after that Find hands out spans of the mapping
+// without copying. Tools/ShaderPacker writes archives from .cso files.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	// A shader's bytecode inside an open archive, valid until the archive is closed.
+	struct ShaderBytecode
+	{
+		const void* data;
+		size_t size;
+	};
+
+	struct ShaderArchiveEntry
+	{
+		std::string name;			// Looked up as is, e.g. "SampleVertexShader".
+		std::vector<uint8_t> bytecode;
+	};
+
+	// Lays entries out as an archive. Returns false if a name is empty or used twice, or the
+	// archive would reach 4 GB.
+	bool WriteShaderArchive(const std::vector<ShaderArchiveEntry>& entries, std::vector<uint8_t>& archive);
+
+	uint64_t HashShaderName(const char* name, size_t length);
+
+	class ShaderArchive
+	{
+	public:
+		ShaderArchive();
+		~ShaderArchive();
+
+		// Maps the file at path, UTF-8, relative to the working directory, which for the app is its
+		// install folder. Returns false, and stays closed, if the file can't be mapped or isn't a
+		// valid archive.
+		bool Open(const char* path);
+		// Uses an archive already in memory, which must outlive the archive or its next Close.
+		bool OpenMemory(const void* data, size_t size);
+		void Close(void);
+		bool IsOpen(void) const { return m_data != nullptr; }
+
+		uint32_t GetCount(void) const { return m_entryCount; }
+		const char* GetName(uint32_t index) const;
+		ShaderBytecode Get(uint32_t index) const;
+		// The shader called name, or a null span if the archive has none.
+		ShaderBytecode Find(const char* name) const;
+
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t slotCount;		// A power of two, more than entryCount.
+			uint32_t entriesOffset;
+			uint32_t slotsOffset;
+			uint32_t namesOffset;
+			uint32_t size;			// Of the whole archive.
+		};
+
+		struct Entry
+		{
+			uint64_t hash;
+			uint32_t nameOffset;	// The name is followed by a 0.
+			uint32_t nameLength;
+			uint32_t dataOffset;
+			uint32_t dataSize;
+		};
+
+		static const uint32_t Magic = 0x41535844;	// "DXSA"
+		static const uint32_t Version = 1;
+		static const uint32_t EmptySlot = 0xffffffff;
+		static const uint32_t DataAlignment = 16;
+
+		bool Validate(void);
+		void Unmap(void);
+
+		friend bool WriteShaderArchive(const std::vector<ShaderArchiveEntry>& entries, std::vector<uint8_t>& archive);
+
+		const uint8_t* m_data;
+		size_t m_size;
+		void* m_mapping;	// The mapped view when Open mapped the file, else null.
+		const Entry* m_entries;
+		const uint32_t* m_slots;
+		uint32_t m_entryCount;
+		uint32_t m_slotMask;
+	};
+}
@@ -0,0 +1,371 @@
+#include "ShaderLighting.h"
+#include "SimdConfig.h"
+
+#include <math.h>
+
+using namespace DX;
+
+// Each path evaluates the same expressions in the same order, without fused multiply-adds, so
+// they agree to the last bit as long as the compiler doesn't contract the scalar path into FMAs
+// either (MSVC's default /fp:precise; -ffp-contract=off with GCC and Clang).
+// ShadeSamplesReference is the one that follows the shader's text.
+namespace
+{
+	// HLSL saturate; NaN becomes 0 as on the GPU.
+	float Saturate(float x)
+	{
+		return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+	}
+
+	double Saturate(double x)
+	{
+		return x > 0.0 ? (x < 1.0 ? x : 1.0) : 0.0;
+	}
+
+	float Dot3(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Normalize3(const float in[3], float out[3])
+	{
+		float length = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+		out[0] = in[0] / length;
+		out[1] = in[1] / length;
+		out[2] = in[2] / length;
+	}
+
+	void ShadeScalar(const LightingConstants& k, const LightSamples& s, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const float n[3] = { s.normal[0][i], s.normal[1][i], s.normal[2][i] };
+			const float p[3] = { s.position[0][i], s.position[1][i], s.position[2][i] };
+
+			float dirRatio = Saturate(Dot3(k.negativeDirection, n));
+
+			float spotDir[3] = { k.spotPosition[0] - p[0], k.spotPosition[1] - p[1], k.spotPosition[2] - p[2] };
+			float spotDistance = sqrtf(Dot3(spotDir, spotDir));
+			spotDir[0] /= spotDistance;
+			spotDir[1] /= spotDistance;
+			spotDir[2] /= spotDistance;
+			float surfaceRatio = Saturate(Dot3(spotDir, k.negativeSpotAxis));
+			float spotFactor = surfaceRatio > k.spotOuter ? 1.0f : 0.0f;
+			float spotRatio = Saturate(Dot3(spotDir, n));
+			float spotAttenuation = 1.0f - Saturate(spotDistance / k.spotRadius);
+			float coneAttenuation = 1.0f - Saturate((k.spotInner - surfaceRatio) / k.spotWidth);
+
+			float pointDir[3] = { k.pointPosition[0] - p[0], k.pointPosition[1] - p[1], k.pointPosition[2] - p[2] };
+			float pointDistance = sqrtf(Dot3(pointDir, pointDir));
+			pointDir[0] /= pointDistance;
+			pointDir[1] /= pointDistance;
+			pointDir[2] /= pointDistance;
+			float pointRatio = Saturate(Dot3(pointDir, n));
+			float pointAttenuation = 1.0f - Saturate(pointDistance / k.pointRadius);
+
+			for (int c = 0; c < 4; ++c)
+			{
+				float base = s.base[c][i];
+				float dirColor = dirRatio * k.directionalColor[c] * base;
+				float spotColor = spotFactor * spotRatio * k.spotColor[c] * spotAttenuation * coneAttenuation * base;
+				float pointColor = pointRatio * k.pointColor[c] * pointAttenuation * base;
+				s.color[c][i] = Saturate(dirColor + spotColor + pointColor);
+			}
+		}
+	}
+
+#if DX_SIMD_AVX2
+	__m256 Saturate8(__m256 x)
+	{
+		// max returns its second operand for NaN.
+		return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	}
+
+	__m256 Dot8(const __m256 a[3], const __m256 b[3])
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])), _mm256_mul_ps(a[2], b[2]));
+	}
+
+	// Unit vector from each sample towards position, and the distance.
+	void DirectionTo8(const float position[3], const __m256 p[3], __m256 dir[3], __m256& distance)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			dir[i] = _mm256_sub_ps(_mm256_set1_ps(position[i]), p[i]);
+		}
+		distance = _mm256_sqrt_ps(Dot8(dir, dir));
+		for (int i = 0; i < 3; ++i)
+		{
+			dir[i] = _mm256_div_ps(dir[i], distance);
+		}
+	}
+
+	void ShadeAvx2(const LightingConstants& k, const LightSamples& s, size_t end)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 negativeDirection[3] = { _mm256_set1_ps(k.negativeDirection[0]), _mm256_set1_ps(k.negativeDirection[1]), _mm256_set1_ps(k.negativeDirection[2]) };
+		const __m256 negativeSpotAxis[3] = { _mm256_set1_ps(k.negativeSpotAxis[0]), _mm256_set1_ps(k.negativeSpotAxis[1]), _mm256_set1_ps(k.negativeSpotAxis[2]) };
+		const __m256 spotOuter = _mm256_set1_ps(k.spotOuter);
+		const __m256 spotInner = _mm256_set1_ps(k.spotInner);
+		const __m256 spotWidth = _mm256_set1_ps(k.spotWidth);
+		const __m256 spotRadius = _mm256_set1_ps(k.spotRadius);
+		const __m256 pointRadius = _mm256_set1_ps(k.pointRadius);
+		for (size_t i = 0; i + 8 <= end; i += 8)
+		{
+			const __m256 n[3] = { _mm256_loadu_ps(s.normal[0] + i), _mm256_loadu_ps(s.normal[1] + i), _mm256_loadu_ps(s.normal[2] + i) };
+			const __m256 p[3] = { _mm256_loadu_ps(s.position[0] + i), _mm256_loadu_ps(s.position[1] + i), _mm256_loadu_ps(s.position[2] + i) };
+
+			__m256 dirRatio = Saturate8(Dot8(negativeDirection, n));
+
+			__m256 spotDir[3], spotDistance;
+			DirectionTo8(k.spotPosition, p, spotDir, spotDistance);
+			__m256 surfaceRatio = Saturate8(Dot8(spotDir, negativeSpotAxis));
+			__m256 spotFactor = _mm256_and_ps(_mm256_cmp_ps(surfaceRatio, spotOuter, _CMP_GT_OQ), one);
+			__m256 spotRatio = Saturate8(Dot8(spotDir, n));
+			__m256 spotAttenuation = _mm256_sub_ps(one, Saturate8(_mm256_div_ps(spotDistance, spotRadius)));
+			__m256 coneAttenuation = _mm256_sub_ps(one, Saturate8(_mm256_div_ps(_mm256_sub_ps(spotInner, surfaceRatio), spotWidth)));
+
+			__m256 pointDir[3], pointDistance;
+			DirectionTo8(k.pointPosition, p, pointDir, pointDistance);
+			__m256 pointRatio = Saturate8(Dot8(pointDir, n));
+			__m256 pointAttenuation = _mm256_sub_ps(one, Saturate8(_mm256_div_ps(pointDistance, pointRadius)));
+
+			__m256 spotScale = _mm256_mul_ps(spotFactor, spotRatio);
+			for (int c = 0; c < 4; ++c)
+			{
+				__m256 base = _mm256_loadu_ps(s.base[c] + i);
+				__m256 dirColor = _mm256_mul_ps(_mm256_mul_ps(dirRatio, _mm256_set1_ps(k.directionalColor[c])), base);
+				__m256 spotColor = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(spotScale, _mm256_set1_ps(k.spotColor[c])),
+																			 spotAttenuation), coneAttenuation), base);
+				__m256 pointColor = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(pointRatio, _mm256_set1_ps(k.pointColor[c])), pointAttenuation), base);
+				_mm256_storeu_ps(s.color[c] + i, Saturate8(_mm256_add_ps(_mm256_add_ps(dirColor, spotColor), pointColor)));
+			}
+		}
+	}
+#elif DX_SIMD_SSE2
+	__m128 Saturate4(__m128 x)
+	{
+		// max returns its second operand for NaN.
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	__m128 Dot4(const __m128 a[3], const __m128 b[3])
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+	}
+
+	void DirectionTo4(const float position[3], const __m128 p[3], __m128 dir[3], __m128& distance)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			dir[i] = _mm_sub_ps(_mm_set1_ps(position[i]), p[i]);
+		}
+		distance = _mm_sqrt_ps(Dot4(dir, dir));
+		for (int i = 0; i < 3; ++i)
+		{
+			dir[i] = _mm_div_ps(dir[i], distance);
+		}
+	}
+
+	void ShadeSse2(const LightingConstants& k, const LightSamples& s, size_t end)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 negativeDirection[3] = { _mm_set1_ps(k.negativeDirection[0]), _mm_set1_ps(k.negativeDirection[1]), _mm_set1_ps(k.negativeDirection[2]) };
+		const __m128 negativeSpotAxis[3] = { _mm_set1_ps(k.negativeSpotAxis[0]), _mm_set1_ps(k.negativeSpotAxis[1]), _mm_set1_ps(k.negativeSpotAxis[2]) };
+		const __m128 spotOuter = _mm_set1_ps(k.spotOuter);
+		const __m128 spotInner = _mm_set1_ps(k.spotInner);
+		const __m128 spotWidth = _mm_set1_ps(k.spotWidth);
+		const __m128 spotRadius = _mm_set1_ps(k.spotRadius);
+		const __m128 pointRadius = _mm_set1_ps(k.pointRadius);
+		for (size_t i = 0; i + 4 <= end; i += 4)
+		{
+			const __m128 n[3] = { _mm_loadu_ps(s.normal[0] + i), _mm_loadu_ps(s.normal[1] + i), _mm_loadu_ps(s.normal[2] + i) };
+			const __m128 p[3] = { _mm_loadu_ps(s.position[0] + i), _mm_loadu_ps(s.position[1] + i), _mm_loadu_ps(s.position[2] + i) };
+
+			__m128 dirRatio = Saturate4(Dot4(negativeDirection, n));
+
+			__m128 spotDir[3], spotDistance;
+			DirectionTo4(k.spotPosition, p, spotDir, spotDistance);
+			__m128 surfaceRatio = Saturate4(Dot4(spotDir, negativeSpotAxis));
+			__m128 spotFactor = _mm_and_ps(_mm_cmpgt_ps(surfaceRatio, spotOuter), one);
+			__m128 spotRatio = Saturate4(Dot4(spotDir, n));
+			__m128 spotAttenuation = _mm_sub_ps(one, Saturate4(_mm_div_ps(spotDistance, spotRadius)));
+			__m128 coneAttenuation = _mm_sub_ps(one, Saturate4(_mm_div_ps(_mm_sub_ps(spotInner, surfaceRatio), spotWidth)));
+
+			__m128 pointDir[3], pointDistance;
+			DirectionTo4(k.pointPosition, p, pointDir, pointDistance);
+			__m128 pointRatio = Saturate4(Dot4(pointDir, n));
+			__m128 pointAttenuation = _mm_sub_ps(one, Saturate4(_mm_div_ps(pointDistance, pointRadius)));
+
+			__m128 spotScale = _mm_mul_ps(spotFactor, spotRatio);
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 base = _mm_loadu_ps(s.base[c] + i);
+				__m128 dirColor = _mm_mul_ps(_mm_mul_ps(dirRatio, _mm_set1_ps(k.directionalColor[c])), base);
+				__m128 spotColor = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(spotScale, _mm_set1_ps(k.spotColor[c])),
+																	spotAttenuation), coneAttenuation), base);
+				__m128 pointColor = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(pointRatio, _mm_set1_ps(k.pointColor[c])), pointAttenuation), base);
+				_mm_storeu_ps(s.color[c] + i, Saturate4(_mm_add_ps(_mm_add_ps(dirColor, spotColor), pointColor)));
+			}
+		}
+	}
+#endif
+
+	// The reference follows LightPixelShader.hlsl line by line.
+	struct Sample
+	{
+		double worldPos[3];
+		double normal[3];
+	};
+
+	void NormalizeD(const double in[3], double out[3])
+	{
+		double length = sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+		for (int i = 0; i < 3; ++i)
+		{
+			out[i] = in[i] / length;
+		}
+	}
+
+	double DotD(const double a[3], const double b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	double Attenuation(const ShaderLight& light, const Sample& input)
+	{
+		double d[3] = { light.position[0] - input.worldPos[0], light.position[1] - input.worldPos[1], light.position[2] - input.worldPos[2] };
+		return 1.0 - Saturate(sqrt(DotD(d, d)) / light.radius[0]);
+	}
+
+	double SpotlightAttenuation(const ShaderLight& light, const Sample& input)
+	{
+		double toLight[3] = { light.position[0] - input.worldPos[0], light.position[1] - input.worldPos[1], light.position[2] - input.worldPos[2] };
+		double lightDir[3], axis[3];
+		NormalizeD(toLight, lightDir);
+		const double cone[3] = { light.coneAngle[0], light.coneAngle[1], light.coneAngle[2] };
+		NormalizeD(cone, axis);
+		const double negative[3] = { -lightDir[0], -lightDir[1], -lightDir[2] };
+		double surfaceRatio = Saturate(DotD(negative, axis));
+		return 1.0 - Saturate((light.coneRatio[0] - surfaceRatio) / (light.coneRatio[0] - light.coneRatio[1]));
+	}
+
+	void PointLight(const ShaderLight& light, const Sample& input, double result[4])
+	{
+		double toLight[3] = { light.position[0] - input.worldPos[0], light.position[1] - input.worldPos[1], light.position[2] - input.worldPos[2] };
+		double lightDir[3];
+		NormalizeD(toLight, lightDir);
+		double lightRatio = Saturate(DotD(lightDir, input.normal));
+		double attenuation = Attenuation(light, input);
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = lightRatio * light.color[c] * attenuation;
+		}
+	}
+
+	void DirectionalLight(const ShaderLight& light, const Sample& input, double result[4])
+	{
+		// normalize(light.Direction) is a float4 normalize; w is 0 in the renderer's constants.
+		double length = sqrt(double(light.direction[0]) * light.direction[0] + double(light.direction[1]) * light.direction[1] +
+							 double(light.direction[2]) * light.direction[2] + double(light.direction[3]) * light.direction[3]);
+		const double negative[3] = { -light.direction[0] / length, -light.direction[1] / length, -light.direction[2] / length };
+		double lightRatio = Saturate(DotD(negative, input.normal));
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = lightRatio * light.color[c];
+		}
+	}
+
+	void SpotLight(const ShaderLight& light, const Sample& input, double result[4])
+	{
+		double toLight[3] = { light.position[0] - input.worldPos[0], light.position[1] - input.worldPos[1], light.position[2] - input.worldPos[2] };
+		double lightDir[3], axis[3];
+		NormalizeD(toLight, lightDir);
+		const double cone[3] = { light.coneAngle[0], light.coneAngle[1], light.coneAngle[2] };
+		NormalizeD(cone, axis);
+		const double negative[3] = { -lightDir[0], -lightDir[1], -lightDir[2] };
+		double surfaceRatio = Saturate(DotD(negative, axis));
+		double spotFactor = surfaceRatio > light.coneRatio[1] ? 1.0 : 0.0;
+		double lightRatio = Saturate(DotD(lightDir, input.normal));
+		double attenuation = Attenuation(light, input);
+		double spotAttenuation = SpotlightAttenuation(light, input);
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = spotFactor * lightRatio * light.color[c] * attenuation * spotAttenuation;
+		}
+	}
+}
+
+LightingConstants DX::PrepareLighting(const ShaderLightSet& lights)
+{
+	LightingConstants constants;
+	const ShaderLight& directional = lights.lights[0];
+	const ShaderLight& point = lights.lights[1];
+	const ShaderLight& spot = lights.lights[2];
+
+	// The shader normalizes Direction as a float4; the renderer leaves w at 0.
+	float length = sqrtf(directional.direction[0] * directional.direction[0] + directional.direction[1] * directional.direction[1] +
+						 directional.direction[2] * directional.direction[2] + directional.direction[3] * directional.direction[3]);
+	float axis[3];
+	Normalize3(spot.coneAngle, axis);
+	for (int i = 0; i < 3; ++i)
+	{
+		constants.negativeDirection[i] = -(directional.direction[i] / length);
+		constants.pointPosition[i] = point.position[i];
+		constants.spotPosition[i] = spot.position[i];
+		constants.negativeSpotAxis[i] = -axis[i];
+	}
+	for (int c = 0; c < 4; ++c)
+	{
+		constants.directionalColor[c] = directional.color[c];
+		constants.pointColor[c] = point.color[c];
+		constants.spotColor[c] = spot.color[c];
+	}
+	constants.pointRadius = point.radius[0];
+	constants.spotRadius = spot.radius[0];
+	constants.spotInner = spot.coneRatio[0];
+	constants.spotOuter = spot.coneRatio[1];
+	constants.spotWidth = spot.coneRatio[0] - spot.coneRatio[1];
+	return constants;
+}
+
+void DX::ShadeSamples(const LightingConstants& constants, const LightSamples& samples, size_t count)
+{
+#if DX_SIMD_AVX2
+	ShadeAvx2(constants, samples, count);
+	ShadeScalar(constants, samples, count & ~size_t(7), count);
+#elif DX_SIMD_SSE2
+	ShadeSse2(constants, samples, count);
+	ShadeScalar(constants, samples, count & ~size_t(3), count);
+#else
+	ShadeScalar(constants, samples, 0, count);
+#endif
+}
+
+void DX::ShadeSamplesScalar(const LightingConstants& constants, const LightSamples& samples, size_t count)
+{
+	ShadeScalar(constants, samples, 0, count);
+}
+
+void DX::ShadeSamplesReference(const ShaderLightSet& lights, const LightSamples& samples, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		Sample input;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			input.worldPos[axis] = samples.position[axis][i];
+			input.normal[axis] = samples.normal[axis][i];
+		}
+
+		double dirColor[4], spotColor[4], pointColor[4];
+		DirectionalLight(lights.lights[0], input, dirColor);
+		SpotLight(lights.lights[2], input, spotColor);
+		PointLight(lights.lights[1], input, pointColor);
+		for (int c = 0; c < 4; ++c)
+		{
+			double base = samples.base[c][i];
+			samples.color[c][i] = float(Saturate(dirColor[c] * base + spotColor[c] * base + pointColor[c] * base));
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+
+// The lighting model of LightPixelShader on the CPU: a directional light, a point light and a
+// spot light with a hard cone edge, each attenuated and modulated by the sampled base color, for
+// baking, CPU-side lighting queries and the software rasterizer. Samples are passed as arrays
+// per component and shaded eight at a time with AVX2, four with SSE2, or one at a time.
+// ShadeSamplesReference transcribes the HLSL function for function in double precision and is
+// what the fast paths are checked against.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	// The parameters of one of LightPixelShader's lights, unpacked; the renderer sends the same
+	// values to the GPU as a PackedLight.
+	struct ShaderLight
+	{
+		float position[4];
+		float direction[4];
+		float radius[4];		// x = range of the point and spot lights.
+		float color[4];
+		float attenuation[4];
+		float typeEnabled[4];
+		float coneRatio[4];		// x = inner, y = outer cosine.
+		float coneAngle[4];		// Spot direction.
+	};
+
+	// The renderer's eye position and its three scene lights.
+	struct ShaderLightSet
+	{
+		float eyePosition[4];
+		float globalAmbient[4];
+		ShaderLight lights[3];	// Directional, point and spot, in the order the shader reads them.
+	};
+
+	// A light set with everything the shader recomputes per pixel but doesn't depend on the pixel
+	// done once: the normalized, negated light direction and spot axis and the cone's width.
+	struct LightingConstants
+	{
+		float negativeDirection[3];
+		float directionalColor[4];
+		float pointPosition[3];
+		float pointRadius;
+		float pointColor[4];
+		float spotPosition[3];
+		float spotRadius;
+		float negativeSpotAxis[3];
+		float spotInner;
+		float spotOuter;
+		float spotWidth;		// spotInner - spotOuter.
+		float spotColor[4];
+	};
+
+	LightingConstants PrepareLighting(const ShaderLightSet& lights);
+
+	// Structure of arrays, one array per component.
+	struct LightSamples
+	{
+		const float* position[3];	// World position.
+		const float* normal[3];		// Interpolated normal, unnormalized, as the shader receives it.
+		const float* base[4];		// Sampled base color.
+		float* color[4];			// saturate(directional + spot + point), written for every sample.
+	};
+
+	// Shades count samples with the widest SIMD path the build allows. Every path rounds the same
+	// way, so the result doesn't depend on the path or on where a sample falls in a batch.
+	void ShadeSamples(const LightingConstants& constants, const LightSamples& samples, size_t count);
+
+	// The scalar path of ShadeSamples, also used for the samples after the last full vector.
+	void ShadeSamplesScalar(const LightingConstants& constants, const LightSamples& samples, size_t count);
+
+	// LightPixelShader's functions transcribed in double precision, for validation only.
+	void ShadeSamplesReference(const ShaderLightSet& lights, const LightSamples& samples, size_t count);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Picks the SIMD instruction sets the compiler is allowed to emit for the portable
+// CPU-side libraries. SSE2 is always present on x86/x64; AVX2 only when the build
+// enables it (/arch:AVX2 or -mavx2). ARM builds fall back to the scalar paths.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define DX_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define DX_SIMD_SSE41 1
+#include <smmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define DX_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
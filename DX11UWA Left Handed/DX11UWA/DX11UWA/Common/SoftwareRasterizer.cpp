@@ -0,0 +1,1400 @@
+#include "SoftwareRasterizer.h"
+#include "SimdConfig.h"
+#include "TessellationCache.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	const uint32_t SpanWidth = 8;
+	const uint32_t MaxLevels = 16;
+	const uint32_t MaxTessellationFactor = 63;
+
+	// Slices are cut so each worker gets a few hundred patches or a few thousand triangles.
+	const size_t PatchesPerSlice = 256;
+	const size_t TrianglesPerSlice = 4096;
+
+	// Triangles are only clipped against x and y once they reach this far outside the viewport,
+	// which keeps the edge functions precise without clipping everything that crosses the border.
+	const float GuardBand = 8.0f;
+
+	const uint32_t ClipVertexFloats = 13;
+	// At most one extra vertex per clip plane.
+	const int MaxClipVertices = 9;
+
+	// Pixel shader inputs, after perspective correction.
+	enum Input
+	{
+		InputU = 0, InputV, InputPage,
+		InputDuDx, InputDvDx, InputDuDy, InputDvDy,		// In uv units per pixel.
+		InputNormalX, InputNormalY, InputNormalZ,
+		InputWorldX, InputWorldY, InputWorldZ,
+		InputCount
+	};
+
+	// The mip chain a draw samples, with the tables the AVX2 gathers index per lane.
+	struct TextureLevels
+	{
+		const uint32_t* texels;
+		const int32_t* offset;
+		const int32_t* width;
+		const int32_t* height;
+		int32_t levels;
+		bool bgra;
+	};
+
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row * 4 + column] = a[row * 4 + 0] * b[0 + column] + a[row * 4 + 1] * b[4 + column] +
+										a[row * 4 + 2] * b[8 + column] + a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	void TransformPoint(const float m[16], float x, float y, float z, float out[4])
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			out[column] = x * m[column] + y * m[4 + column] + z * m[8 + column] + m[12 + column];
+		}
+	}
+
+	// HLSL saturate; NaN becomes 0 as on the GPU.
+	float Saturate(float x)
+	{
+		return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+	}
+
+	// log2 from the exponent and a polynomial over the mantissa, good to about 1e-4. The scalar
+	// and AVX2 paths share it so they pick the same mip weights.
+	float FastLog2(float x)
+	{
+		uint32_t bits;
+		memcpy(&bits, &x, sizeof(bits));
+		float exponent = float(int32_t((bits >> 23) & 0xff) - 127);
+		bits = (bits & 0x7fffff) | 0x3f800000;
+		float m;
+		memcpy(&m, &bits, sizeof(m));
+		return exponent + (-1.7417939f + (2.8212026f + (-1.4699568f + (0.44717955f - 0.056570851f * m) * m) * m) * m);
+	}
+
+	uint32_t PackColor(const float color[4])
+	{
+		uint32_t packed = 0;
+		for (int c = 0; c < 4; ++c)
+		{
+			packed |= uint32_t(Saturate(color[c]) * 255.0f + 0.5f) << (c * 8);
+		}
+		return packed;
+	}
+
+	// Lines, triangles or patches in one instance of a draw.
+	size_t PrimitivesPerInstance(const SoftwareDraw& draw)
+	{
+		switch (draw.primitive)
+		{
+		case PrimitiveTriangleStrip: return draw.indexCount >= 3 ? draw.indexCount - 2 : 0;
+		case PrimitiveLineList: return draw.indexCount / 2;
+		default: return draw.indexCount / 3;
+		}
+	}
+
+	// Frustum sides a clip-space point is outside of, with x and y scaled by band.
+	uint32_t OutCode(const float clip[4], float band)
+	{
+		float w = clip[3] * band;
+		return (clip[0] < -w ? 1u : 0u) | (clip[0] > w ? 2u : 0u) | (clip[1] < -w ? 4u : 0u) |
+			   (clip[1] > w ? 8u : 0u) | (clip[2] < 0.0f ? 16u : 0u) | (clip[2] > clip[3] ? 32u : 0u);
+	}
+
+	// Signed distance to the OutCode plane with the given bit, non-negative inside.
+	float PlaneDistance(const float clip[4], uint32_t plane, float band)
+	{
+		switch (plane)
+		{
+		case 0: return clip[0] + clip[3] * band;
+		case 1: return clip[3] * band - clip[0];
+		case 2: return clip[1] + clip[3] * band;
+		case 3: return clip[3] * band - clip[1];
+		case 4: return clip[2];
+		default: return clip[3] - clip[2];
+		}
+	}
+
+	void Lerp(const float* a, const float* b, float t, float* out)
+	{
+		for (uint32_t i = 0; i < ClipVertexFloats; ++i)
+		{
+			out[i] = a[i] + (b[i] - a[i]) * t;
+		}
+	}
+
+	// Bilinear filter of one mip level with wrap addressing. Wrapping works for any size, as the
+	// scene's textures aren't powers of two.
+	void SampleLevel(const TextureLevels& texture, int32_t level, float u, float v, float out[4])
+	{
+		const int32_t width = texture.width[level];
+		const int32_t height = texture.height[level];
+		float fx = u * float(width) - 0.5f;
+		float fy = v * float(height) - 0.5f;
+		fx -= float(width) * floorf(fx / float(width));
+		fy -= float(height) * floorf(fy / float(height));
+		fx = (fx >= 0.0f && fx < float(width)) ? fx : 0.0f;
+		fy = (fy >= 0.0f && fy < float(height)) ? fy : 0.0f;
+		int32_t x0 = int32_t(fx);
+		int32_t y0 = int32_t(fy);
+		float ax = fx - float(x0);
+		float ay = fy - float(y0);
+		int32_t x1 = x0 + 1 == width ? 0 : x0 + 1;
+		int32_t y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+		const uint32_t* texels = texture.texels + texture.offset[level];
+		uint32_t t00 = texels[y0 * width + x0];
+		uint32_t t10 = texels[y0 * width + x1];
+		uint32_t t01 = texels[y1 * width + x0];
+		uint32_t t11 = texels[y1 * width + x1];
+		for (int c = 0; c < 4; ++c)
+		{
+			int shift = c * 8;
+			float c00 = float((t00 >> shift) & 0xff), c10 = float((t10 >> shift) & 0xff);
+			float c01 = float((t01 >> shift) & 0xff), c11 = float((t11 >> shift) & 0xff);
+			float top = c00 + (c10 - c00) * ax;
+			float bottom = c01 + (c11 - c01) * ax;
+			out[c] = (top + (bottom - top) * ay) * (1.0f / 255.0f);
+		}
+	}
+
+	// Trilinear filter with the level of detail from the uv derivatives, as Sample picks it.
+	void SampleTexture(const TextureLevels& texture, const float in[InputCount], float out[4])
+	{
+		if (!texture.texels)
+		{
+			out[0] = out[1] = out[2] = out[3] = 0.0f;
+			return;
+		}
+
+		int32_t level0 = 0;
+		float blend = 0.0f;
+		if (texture.levels > 1)
+		{
+			float w = float(texture.width[0]), h = float(texture.height[0]);
+			float dudx = in[InputDuDx] * w, dvdx = in[InputDvDx] * h;
+			float dudy = in[InputDuDy] * w, dvdy = in[InputDvDy] * h;
+			float rho = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+			float lod = 0.5f * FastLog2(rho);
+			float maxLod = float(texture.levels - 1);
+			lod = lod > 0.0f ? (lod < maxLod ? lod : maxLod) : 0.0f;
+			level0 = int32_t(lod);
+			blend = lod - float(level0);
+		}
+
+		SampleLevel(texture, level0, in[InputU], in[InputV], out);
+		if (blend > 0.0f)
+		{
+			float next[4];
+			SampleLevel(texture, std::min(level0 + 1, texture.levels - 1), in[InputU], in[InputV], next);
+			for (int c = 0; c < 4; ++c)
+			{
+				out[c] += (next[c] - out[c]) * blend;
+			}
+		}
+		if (texture.bgra)
+		{
+			std::swap(out[0], out[2]);
+		}
+	}
+
+	// One pixel of the draw's pixel shader. Returns false when it discards.
+	bool ShadePixel(SoftwarePixelShader shader, const TextureLevels& texture, const LightingConstants& lighting,
+					const float in[InputCount], uint32_t& color)
+	{
+		if (shader == PixelUV)
+		{
+			const float uv[4] = { in[InputU], in[InputV], in[InputPage], 1.0f };
+			color = PackColor(uv);
+			return true;
+		}
+
+		float base[4];
+		SampleTexture(texture, in, base);
+		if (shader == PixelLit && base[3] < 0.5f)
+			return false;
+
+		float result[4];
+		const LightSamples samples =
+		{
+			{ in + InputWorldX, in + InputWorldY, in + InputWorldZ },
+			{ in + InputNormalX, in + InputNormalY, in + InputNormalZ },
+			{ base, base + 1, base + 2, base + 3 },
+			{ result, result + 1, result + 2, result + 3 }
+		};
+		ShadeSamples(lighting, samples, 1);
+		color = PackColor(result);
+		return true;
+	}
+
+#if DX_SIMD_AVX2
+	uint32_t CountBits(uint32_t mask)
+	{
+		uint32_t count = 0;
+		for (; mask; mask &= mask - 1)
+		{
+			++count;
+		}
+		return count;
+	}
+
+	__m256 SaturateAvx2(__m256 x)
+	{
+		// max returns its second operand for NaN.
+		return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	}
+
+	__m256 FastLog2Avx2(__m256 x)
+	{
+		__m256i bits = _mm256_castps_si256(x);
+		__m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+		__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), _mm256_set1_epi32(0x3f800000)));
+		__m256 p = _mm256_sub_ps(_mm256_set1_ps(0.44717955f), _mm256_mul_ps(_mm256_set1_ps(0.056570851f), m));
+		p = _mm256_add_ps(_mm256_set1_ps(-1.4699568f), _mm256_mul_ps(p, m));
+		p = _mm256_add_ps(_mm256_set1_ps(2.8212026f), _mm256_mul_ps(p, m));
+		p = _mm256_add_ps(_mm256_set1_ps(-1.7417939f), _mm256_mul_ps(p, m));
+		return _mm256_add_ps(exponent, p);
+	}
+
+	__m256i PackColorAvx2(const __m256 color[4])
+	{
+		const __m256 scale = _mm256_set1_ps(255.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		__m256i packed = _mm256_setzero_si256();
+		for (int c = 0; c < 4; ++c)
+		{
+			__m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(SaturateAvx2(color[c]), scale), half));
+			packed = _mm256_or_si256(packed, _mm256_slli_epi32(channel, c * 8));
+		}
+		return packed;
+	}
+
+	// SampleLevel for eight lanes; each lane may read its own level.
+	void SampleLevelAvx2(const TextureLevels& texture, __m256i level, __m256 u, __m256 v, __m256 out[4])
+	{
+		__m256i width, height, offset;
+		if (texture.levels == 1)
+		{
+			width = _mm256_set1_epi32(texture.width[0]);
+			height = _mm256_set1_epi32(texture.height[0]);
+			offset = _mm256_set1_epi32(texture.offset[0]);
+		}
+		else
+		{
+			width = _mm256_i32gather_epi32(reinterpret_cast<const int*>(texture.width), level, 4);
+			height = _mm256_i32gather_epi32(reinterpret_cast<const int*>(texture.height), level, 4);
+			offset = _mm256_i32gather_epi32(reinterpret_cast<const int*>(texture.offset), level, 4);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 half = _mm256_set1_ps(0.5f);
+		__m256 fw = _mm256_cvtepi32_ps(width);
+		__m256 fh = _mm256_cvtepi32_ps(height);
+		__m256 fx = _mm256_sub_ps(_mm256_mul_ps(u, fw), half);
+		__m256 fy = _mm256_sub_ps(_mm256_mul_ps(v, fh), half);
+		fx = _mm256_sub_ps(fx, _mm256_mul_ps(fw, _mm256_floor_ps(_mm256_div_ps(fx, fw))));
+		fy = _mm256_sub_ps(fy, _mm256_mul_ps(fh, _mm256_floor_ps(_mm256_div_ps(fy, fh))));
+		fx = _mm256_and_ps(fx, _mm256_and_ps(_mm256_cmp_ps(fx, zero, _CMP_GE_OQ), _mm256_cmp_ps(fx, fw, _CMP_LT_OQ)));
+		fy = _mm256_and_ps(fy, _mm256_and_ps(_mm256_cmp_ps(fy, zero, _CMP_GE_OQ), _mm256_cmp_ps(fy, fh, _CMP_LT_OQ)));
+		__m256i x0 = _mm256_cvttps_epi32(fx);
+		__m256i y0 = _mm256_cvttps_epi32(fy);
+		__m256 ax = _mm256_sub_ps(fx, _mm256_cvtepi32_ps(x0));
+		__m256 ay = _mm256_sub_ps(fy, _mm256_cvtepi32_ps(y0));
+		const __m256i one = _mm256_set1_epi32(1);
+		__m256i x1 = _mm256_add_epi32(x0, one);
+		__m256i y1 = _mm256_add_epi32(y0, one);
+		x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(x1, width), x1);
+		y1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(y1, height), y1);
+
+		__m256i row0 = _mm256_add_epi32(offset, _mm256_mullo_epi32(y0, width));
+		__m256i row1 = _mm256_add_epi32(offset, _mm256_mullo_epi32(y1, width));
+		const int* texels = reinterpret_cast<const int*>(texture.texels);
+		__m256i t00 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x0), 4);
+		__m256i t10 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row0, x1), 4);
+		__m256i t01 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x0), 4);
+		__m256i t11 = _mm256_i32gather_epi32(texels, _mm256_add_epi32(row1, x1), 4);
+
+		const __m256i mask = _mm256_set1_epi32(0xff);
+		const __m256 inv255 = _mm256_set1_ps(1.0f / 255.0f);
+		for (int c = 0; c < 4; ++c)
+		{
+			__m256 c00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(t00, c * 8), mask));
+			__m256 c10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(t10, c * 8), mask));
+			__m256 c01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(t01, c * 8), mask));
+			__m256 c11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(t11, c * 8), mask));
+			__m256 top = _mm256_add_ps(c00, _mm256_mul_ps(_mm256_sub_ps(c10, c00), ax));
+			__m256 bottom = _mm256_add_ps(c01, _mm256_mul_ps(_mm256_sub_ps(c11, c01), ax));
+			out[c] = _mm256_mul_ps(_mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), ay)), inv255);
+		}
+	}
+
+	void SampleTextureAvx2(const TextureLevels& texture, const __m256 in[InputCount], __m256 out[4])
+	{
+		if (!texture.texels)
+		{
+			out[0] = out[1] = out[2] = out[3] = _mm256_setzero_ps();
+			return;
+		}
+
+		__m256i level0 = _mm256_setzero_si256();
+		__m256 blend = _mm256_setzero_ps();
+		if (texture.levels > 1)
+		{
+			__m256 w = _mm256_set1_ps(float(texture.width[0])), h = _mm256_set1_ps(float(texture.height[0]));
+			__m256 dudx = _mm256_mul_ps(in[InputDuDx], w), dvdx = _mm256_mul_ps(in[InputDvDx], h);
+			__m256 dudy = _mm256_mul_ps(in[InputDuDy], w), dvdy = _mm256_mul_ps(in[InputDvDy], h);
+			__m256 rho = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(dudx, dudx), _mm256_mul_ps(dvdx, dvdx)),
+									   _mm256_add_ps(_mm256_mul_ps(dudy, dudy), _mm256_mul_ps(dvdy, dvdy)));
+			__m256 lod = _mm256_mul_ps(_mm256_set1_ps(0.5f), FastLog2Avx2(rho));
+			lod = _mm256_min_ps(_mm256_max_ps(lod, _mm256_setzero_ps()), _mm256_set1_ps(float(texture.levels - 1)));
+			level0 = _mm256_cvttps_epi32(lod);
+			blend = _mm256_sub_ps(lod, _mm256_cvtepi32_ps(level0));
+		}
+
+		SampleLevelAvx2(texture, level0, in[InputU], in[InputV], out);
+		if (_mm256_movemask_ps(_mm256_cmp_ps(blend, _mm256_setzero_ps(), _CMP_GT_OQ)))
+		{
+			__m256i level1 = _mm256_min_epi32(_mm256_add_epi32(level0, _mm256_set1_epi32(1)), _mm256_set1_epi32(texture.levels - 1));
+			__m256 next[4];
+			SampleLevelAvx2(texture, level1, in[InputU], in[InputV], next);
+			for (int c = 0; c < 4; ++c)
+			{
+				out[c] = _mm256_add_ps(out[c], _mm256_mul_ps(_mm256_sub_ps(next[c], out[c]), blend));
+			}
+		}
+		if (texture.bgra)
+		{
+			std::swap(out[0], out[2]);
+		}
+	}
+
+	// ShadePixel for eight pixels. keep comes back clear in the lanes that discard.
+	__m256i ShadeAvx2(SoftwarePixelShader shader, const TextureLevels& texture, const LightingConstants& lighting,
+					  const __m256 in[InputCount], __m256& keep)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		if (shader == PixelUV)
+		{
+			const __m256 uv[4] = { in[InputU], in[InputV], in[InputPage], one };
+			return PackColorAvx2(uv);
+		}
+
+		__m256 base[4];
+		SampleTextureAvx2(texture, in, base);
+		if (shader == PixelLit)
+		{
+			// a < 0.5 discards, NaN doesn't.
+			keep = _mm256_andnot_ps(_mm256_cmp_ps(base[3], _mm256_set1_ps(0.5f), _CMP_LT_OQ), keep);
+		}
+
+		// Through memory to ShaderLighting's eight-wide kernel.
+		alignas(32) float inputs[10][8];
+		alignas(32) float output[4][8];
+		for (int i = 0; i < 3; ++i)
+		{
+			_mm256_store_ps(inputs[i], in[InputWorldX + i]);
+			_mm256_store_ps(inputs[3 + i], in[InputNormalX + i]);
+		}
+		for (int c = 0; c < 4; ++c)
+		{
+			_mm256_store_ps(inputs[6 + c], base[c]);
+		}
+		const LightSamples samples =
+		{
+			{ inputs[0], inputs[1], inputs[2] },
+			{ inputs[3], inputs[4], inputs[5] },
+			{ inputs[6], inputs[7], inputs[8], inputs[9] },
+			{ output[0], output[1], output[2], output[3] }
+		};
+		ShadeSamples(lighting, samples, 8);
+		__m256 result[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = _mm256_load_ps(output[c]);
+		}
+		return PackColorAvx2(result);
+	}
+#endif
+
+	FILE* OpenFile(const char* path, const char* mode)
+	{
+#if defined(_MSC_VER)
+		FILE* file = nullptr;
+		return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+		return fopen(path, mode);
+#endif
+	}
+
+	// Skips whitespace and comments in a PPM header and reads the next number.
+	bool ReadHeaderValue(FILE* file, uint32_t& value)
+	{
+		int c = fgetc(file);
+		while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+		{
+			if (c == '#')
+			{
+				while (c != '\n' && c != EOF)
+				{
+					c = fgetc(file);
+				}
+			}
+			c = fgetc(file);
+		}
+		if (c < '0' || c > '9')
+			return false;
+		value = 0;
+		while (c >= '0' && c <= '9')
+		{
+			value = value * 10 + uint32_t(c - '0');
+			if (value > 65535)
+				return false;
+			c = fgetc(file);
+		}
+		// The single whitespace after the header's last value is consumed here too.
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	// The tessellator's output for a patch with the given odd edge factors (edge i opposite corner
+	// i, as SV_TessFactor has them) and odd inside factor: barycentric domain points, and
+	// triangles over them wound like the patch. Rings of points run from the patch's edges
+	// inward: the outer ring has each edge's own segments, inner ring k has inside - 2k segments
+	// per side and its corners sit on the lines from the centroid to the patch corners,
+	// (inside - 2k) / inside of the way out. The last ring is a single triangle.
+	void TessellatePatch(const uint32_t edges[3], uint32_t inside, std::vector<float>& points, std::vector<uint16_t>& triangles)
+	{
+		points.clear();
+		triangles.clear();
+		const float third = 1.0f / 3.0f;
+		const uint32_t rings = (inside + 1) / 2;
+		std::vector<uint32_t> ringStart(rings);
+		std::vector<uint32_t> sideSegments(rings * 3);
+		for (uint32_t ring = 0; ring < rings; ++ring)
+		{
+			ringStart[ring] = uint32_t(points.size() / 3);
+			float scale = float(inside - 2 * ring) / float(inside);
+			for (uint32_t side = 0; side < 3; ++side)
+			{
+				// Side s runs from corner s to corner s + 1, opposite corner s + 2.
+				uint32_t segments = ring == 0 ? edges[(side + 2) % 3] : inside - 2 * ring;
+				sideSegments[ring * 3 + side] = segments;
+				float from[3] = { third, third, third };
+				float to[3] = { third, third, third };
+				for (int i = 0; i < 3; ++i)
+				{
+					from[i] += ((i == int(side) ? 1.0f : 0.0f) - third) * scale;
+					to[i] += ((i == int((side + 1) % 3) ? 1.0f : 0.0f) - third) * scale;
+				}
+				for (uint32_t step = 0; step < segments; ++step)
+				{
+					float t = float(step) / float(segments);
+					for (int i = 0; i < 3; ++i)
+					{
+						points.push_back(from[i] + (to[i] - from[i]) * t);
+					}
+				}
+			}
+		}
+
+		auto addTriangle = [&](uint32_t i0, uint32_t i1, uint32_t i2)
+		{
+			// Keep the patch's winding: positive area over the second and third weights.
+			const float* p0 = &points[i0 * 3];
+			const float* p1 = &points[i1 * 3];
+			const float* p2 = &points[i2 * 3];
+			float area = (p1[1] - p0[1]) * (p2[2] - p0[2]) - (p2[1] - p0[1]) * (p1[2] - p0[2]);
+			if (area < 0.0f)
+				std::swap(i1, i2);
+			triangles.push_back(uint16_t(i0));
+			triangles.push_back(uint16_t(i1));
+			triangles.push_back(uint16_t(i2));
+		};
+
+		// Zip each ring to the next one inside, one side at a time. Inner point j lies across from
+		// (j + 1) / (inner + 2) of the outer side, so with inner = outer - 2 it lines up with outer
+		// point j + 1.
+		for (uint32_t ring = 0; ring + 1 < rings; ++ring)
+		{
+			const uint32_t* outerSegments = &sideSegments[ring * 3];
+			const uint32_t innerSegments = inside - 2 * (ring + 1);
+			const uint32_t outerPoints = outerSegments[0] + outerSegments[1] + outerSegments[2];
+			uint32_t outerSide = 0;
+			for (uint32_t side = 0; side < 3; ++side)
+			{
+				const uint32_t m = outerSegments[side];
+				auto outer = [&](uint32_t step) { return ringStart[ring] + (outerSide + step) % outerPoints; };
+				auto inner = [&](uint32_t step) { return ringStart[ring + 1] + (side * innerSegments + step) % (3 * innerSegments); };
+				uint32_t i = 0, j = 0;
+				while (i < m || j < innerSegments)
+				{
+					if (j == innerSegments || (i < m && (i + 1) * (innerSegments + 2) <= (j + 2) * m))
+					{
+						addTriangle(outer(i), outer(i + 1), inner(j));
+						++i;
+					}
+					else
+					{
+						addTriangle(outer(i), inner(j + 1), inner(j));
+						++j;
+					}
+				}
+				outerSide += m;
+			}
+		}
+		uint32_t last = ringStart[rings - 1];
+		addTriangle(last, last + 1, last + 2);
+	}
+}
+
+const uint32_t SoftwareRasterizer::TileSize;
+
+SoftwareRasterizer::SoftwareRasterizer(uint32_t width, uint32_t height) :
+	m_clearColor(0)
+{
+	memset(&m_lighting, 0, sizeof(m_lighting));
+	memset(&m_stats, 0, sizeof(m_stats));
+	std::fill(m_view, m_view + 16, 0.0f);
+	std::fill(m_viewProjection, m_viewProjection + 16, 0.0f);
+	Resize(width, height);
+}
+
+void SoftwareRasterizer::Resize(uint32_t width, uint32_t height)
+{
+	m_width = std::max(1u, width);
+	m_height = std::max(1u, height);
+	m_tilesX = (m_width + TileSize - 1) / TileSize;
+	m_tilesY = (m_height + TileSize - 1) / TileSize;
+	m_pitch = size_t(m_tilesX) * TileSize;
+	m_color.assign(m_pitch * m_tilesY * TileSize, 0);
+	m_depth.assign(m_pitch * m_tilesY * TileSize, 1.0f);
+	m_tileStats.assign(size_t(m_tilesX) * m_tilesY, SoftwareRasterStats());
+	for (Batch& batch : m_batches)
+	{
+		batch.bins.assign(m_tileStats.size(), std::vector<uint32_t>());
+	}
+}
+
+void SoftwareRasterizer::BeginFrame(const float view[16], const float projection[16], const ShaderLightSet& lights,
+									const float clearColor[4])
+{
+	std::copy(view, view + 16, m_view);
+	Multiply(view, projection, m_viewProjection);
+	m_lighting = PrepareLighting(lights);
+	m_clearColor = PackColor(clearColor);
+	m_drawList.clear();
+	m_draws.clear();
+}
+
+void SoftwareRasterizer::Draw(const SoftwareDraw& draw)
+{
+	m_drawList.push_back(draw);
+
+	DrawState state;
+	memset(&state, 0, sizeof(state));
+	state.pixelShader = draw.pixelShader;
+	const DDSImage* texture = draw.texture;
+	if (texture && !texture->texels.empty())
+	{
+		state.texels = texture->texels.data();
+		state.bgra = texture->bgra;
+		state.levels = int32_t(std::min(std::max(texture->mipLevels, 1u), MaxLevels));
+		for (int32_t level = 0; level < int32_t(MaxLevels); ++level)
+		{
+			uint32_t mip = uint32_t(std::min(level, state.levels - 1));
+			state.levelOffset[level] = int32_t(texture->LevelOffset(0, mip));
+			state.levelWidth[level] = int32_t(texture->LevelWidth(mip));
+			state.levelHeight[level] = int32_t(texture->LevelHeight(mip));
+		}
+	}
+	m_draws.push_back(state);
+}
+
+void SoftwareRasterizer::Render(void)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	// Slice the draws so the setup spreads over the workers.
+	m_slices.clear();
+	for (uint32_t i = 0; i < uint32_t(m_drawList.size()); ++i)
+	{
+		const SoftwareDraw& draw = m_drawList[i];
+		size_t perInstance = PrimitivesPerInstance(draw);
+		size_t count = perInstance * (draw.instances ? draw.instanceCount : 1);
+		size_t step = draw.primitive >= PrimitivePatchList ? PatchesPerSlice : TrianglesPerSlice;
+		for (size_t begin = 0; begin < count; begin += step)
+		{
+			Slice slice = { i, begin, std::min(count, begin + step) };
+			m_slices.push_back(slice);
+		}
+		++m_stats.draws;
+	}
+	if (m_batches.size() < m_slices.size())
+	{
+		size_t first = m_batches.size();
+		m_batches.resize(m_slices.size());
+		for (size_t i = first; i < m_batches.size(); ++i)
+		{
+			m_batches[i].bins.assign(m_tileStats.size(), std::vector<uint32_t>());
+		}
+	}
+
+	WorkerPool& pool = WorkerPool::Shared();
+	pool.ParallelFor(m_slices.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			SetupSlice(m_slices[i], m_batches[i]);
+		}
+	});
+
+	// Tiles own disjoint pixels, so they need no synchronization.
+	pool.ParallelFor(m_tileStats.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; ++tile)
+		{
+			RasterizeTile(static_cast<uint32_t>(tile), m_tileStats[tile]);
+		}
+	});
+
+	for (size_t i = 0; i < m_slices.size(); ++i)
+	{
+		const SoftwareRasterStats& stats = m_batches[i].stats;
+		m_stats.patches += stats.patches;
+		m_stats.triangles += stats.triangles;
+		m_stats.culled += stats.culled;
+		m_stats.lines += stats.lines;
+		m_stats.binned += stats.binned;
+	}
+	for (const SoftwareRasterStats& stats : m_tileStats)
+	{
+		m_stats.pixelsShaded += stats.pixelsShaded;
+		m_stats.pixelsWritten += stats.pixelsWritten;
+	}
+}
+
+void SoftwareRasterizer::SetupSlice(const Slice& slice, Batch& batch)
+{
+	batch.primitives.clear();
+	for (std::vector<uint32_t>& bin : batch.bins)
+	{
+		bin.clear();
+	}
+	memset(&batch.stats, 0, sizeof(batch.stats));
+
+	const SoftwareDraw& draw = m_drawList[slice.draw];
+	const size_t perInstance = PrimitivesPerInstance(draw);
+	const bool patches = draw.primitive >= PrimitivePatchList;
+	const float maxFactor = std::min(std::max(draw.tessellation[0], 1.0f), float(MaxTessellationFactor));
+	const float phongAlpha = draw.tessellation[1];
+	std::vector<ClipVertex> domain;
+	uint32_t patternFactors[4] = {};
+
+	float world[16];
+	float worldViewProjection[16];
+	size_t currentInstance = size_t(-1);
+	for (size_t primitive = slice.begin; primitive < slice.end; ++primitive)
+	{
+		size_t instance = primitive / perInstance;
+		size_t local = primitive % perInstance;
+		if (instance != currentInstance)
+		{
+			currentInstance = instance;
+			if (draw.instances)
+			{
+				// InstancedVertexShader dots the position with three columns of the object-to-world matrix.
+				const InstanceData& data = draw.instances[instance];
+				for (int row = 0; row < 4; ++row)
+				{
+					for (int column = 0; column < 3; ++column)
+					{
+						world[row * 4 + column] = data.columns[column][row];
+					}
+					world[row * 4 + 3] = row == 3 ? 1.0f : 0.0f;
+				}
+			}
+			else
+			{
+				std::copy(draw.world, draw.world + 16, world);
+			}
+			Multiply(world, m_viewProjection, worldViewProjection);
+		}
+
+		uint32_t corner[3];
+		if (draw.primitive == PrimitiveLineList)
+		{
+			corner[0] = draw.indices[local * 2];
+			corner[1] = draw.indices[local * 2 + 1];
+			corner[2] = corner[1];
+		}
+		else if (draw.primitive == PrimitiveTriangleStrip)
+		{
+			// Odd triangles of a strip swap their first two vertices to keep the winding.
+			bool odd = (local & 1) != 0;
+			corner[0] = draw.indices[local + (odd ? 1 : 0)];
+			corner[1] = draw.indices[local + (odd ? 0 : 1)];
+			corner[2] = draw.indices[local + 2];
+		}
+		else
+		{
+			corner[0] = draw.indices[local * 3];
+			corner[1] = draw.indices[local * 3 + 1];
+			corner[2] = draw.indices[local * 3 + 2];
+		}
+
+		// The vertex shaders, and the end of DomainShader: object space to clip space and world.
+		auto transform = [&](const ObjVertex& vertex, ClipVertex& out)
+		{
+			TransformPoint(worldViewProjection, vertex.pos[0], vertex.pos[1], vertex.pos[2], out.clip);
+			std::copy(vertex.uv, vertex.uv + 3, out.attributes);
+			for (int column = 0; column < 3; ++column)
+			{
+				out.attributes[3 + column] = vertex.normal[0] * world[column] + vertex.normal[1] * world[4 + column] +
+											 vertex.normal[2] * world[8 + column];
+			}
+			float position[4];
+			TransformPoint(world, vertex.pos[0], vertex.pos[1], vertex.pos[2], position);
+			std::copy(position, position + 3, out.attributes + 6);
+		};
+
+		ClipVertex control[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			transform(draw.vertices[corner[i]], control[i]);
+		}
+		++batch.stats.patches;
+
+		if (draw.primitive == PrimitiveLineList)
+		{
+			ClipLine(batch, control[0], control[1], slice.draw);
+			continue;
+		}
+
+		if (!patches)
+		{
+			++batch.stats.triangles;
+			ClipTriangle(batch, control[0], control[1], control[2], slice.draw);
+			continue;
+		}
+
+		// HullShader's factors: each edge split by its world length over its distance from the eye,
+		// rounded up to odd as fractional_odd partitioning does at whole factors; the inside
+		// factor is the largest edge factor.
+		uint32_t factors[4];
+		float inside = 1.0f;
+		for (int e = 0; e < 3; ++e)
+		{
+			const float* a = control[(e + 1) % 3].attributes + 6;
+			const float* b = control[(e + 2) % 3].attributes + 6;
+			float middle[4];
+			TransformPoint(m_view, 0.5f * (a[0] + b[0]), 0.5f * (a[1] + b[1]), 0.5f * (a[2] + b[2]), middle);
+			float length = sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+			float distance = std::max(sqrtf(middle[0] * middle[0] + middle[1] * middle[1] + middle[2] * middle[2]), 1e-3f);
+			float factor = std::min(std::max(length * draw.tessellation[2] / distance, 1.0f), maxFactor);
+			factors[e] = OddTessellationFactor(factor);
+			inside = std::max(inside, factor);
+		}
+		factors[3] = OddTessellationFactor(inside);
+		if (!std::equal(factors, factors + 4, patternFactors))
+		{
+			// Neighbouring patches mostly share their factors, so the pattern is rarely rebuilt.
+			TessellatePatch(factors, factors[3], batch.domainPoints, batch.domainTriangles);
+			std::copy(factors, factors + 4, patternFactors);
+			domain.resize(batch.domainPoints.size() / 3);
+		}
+		const uint32_t domainPoints = uint32_t(batch.domainPoints.size() / 3);
+		const uint32_t domainTriangles = uint32_t(batch.domainTriangles.size() / 3);
+
+		// Flat tessellated points lie inside the patch, so a patch outside one frustum plane goes
+		// whole; so does a back-facing one in front of the eye, whose pieces all face the same way.
+		// Phong tessellation can bulge past the patch, so its pieces are culled one by one.
+		batch.stats.triangles += domainTriangles;
+		if (phongAlpha == 0.0f && (OutCode(control[0].clip, 1.0f) & OutCode(control[1].clip, 1.0f) & OutCode(control[2].clip, 1.0f)))
+		{
+			batch.stats.culled += domainTriangles;
+			continue;
+		}
+		if (phongAlpha == 0.0f && control[0].clip[3] > 0.0f && control[1].clip[3] > 0.0f && control[2].clip[3] > 0.0f)
+		{
+			float x[3], y[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				x[i] = control[i].clip[0] / control[i].clip[3];
+				y[i] = -control[i].clip[1] / control[i].clip[3];
+			}
+			if (!((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]) > 0.0f))
+			{
+				batch.stats.culled += domainTriangles;
+				continue;
+			}
+		}
+
+		for (uint32_t i = 0; i < domainPoints; ++i)
+		{
+			const float* weights = &batch.domainPoints[i * 3];
+			if (phongAlpha != 0.0f)
+			{
+				// DomainShader bends the point in object space, as the load-time tessellation does.
+				transform(EvaluatePhongTriangle(draw.vertices[corner[0]], draw.vertices[corner[1]], draw.vertices[corner[2]], weights, phongAlpha),
+						  domain[i]);
+				continue;
+			}
+			// Without Phong, DomainShader interpolates linearly and every transform is affine, so
+			// mixing the transformed control points gives what the shader computes.
+			const float* a = control[0].clip;
+			const float* b = control[1].clip;
+			const float* c = control[2].clip;
+			float* out = domain[i].clip;
+			for (uint32_t f = 0; f < ClipVertexFloats; ++f)
+			{
+				out[f] = a[f] * weights[0] + b[f] * weights[1] + c[f] * weights[2];
+			}
+		}
+		for (uint32_t i = 0; i < domainTriangles; ++i)
+		{
+			const ClipVertex& v0 = domain[batch.domainTriangles[i * 3]];
+			const ClipVertex& v1 = domain[batch.domainTriangles[i * 3 + 1]];
+			const ClipVertex& v2 = domain[batch.domainTriangles[i * 3 + 2]];
+			ClipTriangle(batch, v0, v1, v2, slice.draw);
+		}
+	}
+}
+
+void SoftwareRasterizer::ClipTriangle(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, uint32_t draw)
+{
+	// Clipping and the domain mix treat a vertex as one run of floats.
+	static_assert(sizeof(ClipVertex) == ClipVertexFloats * sizeof(float), "ClipVertex must be tightly packed");
+	if (OutCode(v0.clip, 1.0f) & OutCode(v1.clip, 1.0f) & OutCode(v2.clip, 1.0f))
+	{
+		++batch.stats.culled;
+		return;
+	}
+	uint32_t planes = OutCode(v0.clip, GuardBand) | OutCode(v1.clip, GuardBand) | OutCode(v2.clip, GuardBand);
+	if (!planes)
+	{
+		SetupTriangle(batch, v0, v1, v2, draw);
+		return;
+	}
+
+	ClipVertex polygon[2][MaxClipVertices];
+	polygon[0][0] = v0;
+	polygon[0][1] = v1;
+	polygon[0][2] = v2;
+	int count = 3;
+	int current = 0;
+	for (uint32_t plane = 0; plane < 6 && count >= 3; ++plane)
+	{
+		if (!(planes & (1u << plane)))
+			continue;
+		const ClipVertex* in = polygon[current];
+		ClipVertex* out = polygon[current ^ 1];
+		int outCount = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			const ClipVertex& from = in[i];
+			const ClipVertex& to = in[(i + 1) % count];
+			float dFrom = PlaneDistance(from.clip, plane, GuardBand);
+			float dTo = PlaneDistance(to.clip, plane, GuardBand);
+			if (dFrom >= 0.0f)
+			{
+				out[outCount++] = from;
+			}
+			if ((dFrom >= 0.0f) != (dTo >= 0.0f))
+			{
+				Lerp(from.clip, to.clip, dFrom / (dFrom - dTo), out[outCount++].clip);
+			}
+		}
+		count = outCount;
+		current ^= 1;
+	}
+	if (count < 3)
+	{
+		++batch.stats.culled;
+		return;
+	}
+	for (int fan = 2; fan < count; ++fan)
+	{
+		SetupTriangle(batch, polygon[current][0], polygon[current][fan - 1], polygon[current][fan], draw);
+	}
+}
+
+void SoftwareRasterizer::ClipLine(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, uint32_t draw)
+{
+	if (OutCode(v0.clip, 1.0f) & OutCode(v1.clip, 1.0f))
+		return;
+	uint32_t planes = OutCode(v0.clip, GuardBand) | OutCode(v1.clip, GuardBand);
+	if (!planes)
+	{
+		SetupLine(batch, v0, v1, draw);
+		return;
+	}
+
+	float t0 = 0.0f, t1 = 1.0f;
+	for (uint32_t plane = 0; plane < 6; ++plane)
+	{
+		if (!(planes & (1u << plane)))
+			continue;
+		float d0 = PlaneDistance(v0.clip, plane, GuardBand);
+		float d1 = PlaneDistance(v1.clip, plane, GuardBand);
+		if (d0 < 0.0f && d1 < 0.0f)
+			return;
+		float t = d0 / (d0 - d1);
+		if (d0 < 0.0f)
+			t0 = std::max(t0, t);
+		else if (d1 < 0.0f)
+			t1 = std::min(t1, t);
+	}
+	if (t0 >= t1)
+		return;
+	ClipVertex a, b;
+	Lerp(v0.clip, v1.clip, t0, a.clip);
+	Lerp(v0.clip, v1.clip, t1, b.clip);
+	SetupLine(batch, a, b, draw);
+}
+
+void SoftwareRasterizer::SetupTriangle(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, uint32_t draw)
+{
+	const ClipVertex* vertices[3] = { &v0, &v1, &v2 };
+	float x[3], y[3], invW[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* clip = vertices[i]->clip;
+		if (clip[3] <= 0.0f)
+		{
+			++batch.stats.culled;
+			return;
+		}
+		invW[i] = 1.0f / clip[3];
+		x[i] = (clip[0] * invW[i] * 0.5f + 0.5f) * float(m_width);
+		y[i] = (0.5f - clip[1] * invW[i] * 0.5f) * float(m_height);
+	}
+
+	// Clockwise on screen is positive here and is the front face.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f) || !(area < 1e30f))
+	{
+		++batch.stats.culled;
+		return;
+	}
+
+	Primitive primitive;
+	float minX = std::min(x[0], std::min(x[1], x[2])) - 0.5f;
+	float maxX = std::max(x[0], std::max(x[1], x[2])) - 0.5f;
+	float minY = std::min(y[0], std::min(y[1], y[2])) - 0.5f;
+	float maxY = std::max(y[0], std::max(y[1], y[2])) - 0.5f;
+	primitive.minX = static_cast<int32_t>(ceilf(std::max(minX, 0.0f)));
+	primitive.minY = static_cast<int32_t>(ceilf(std::max(minY, 0.0f)));
+	primitive.maxX = static_cast<int32_t>(floorf(std::min(maxX, float(m_width - 1))));
+	primitive.maxY = static_cast<int32_t>(floorf(std::min(maxY, float(m_height - 1))));
+	if (primitive.minX > primitive.maxX || primitive.minY > primitive.maxY)
+	{
+		++batch.stats.culled;
+		return;
+	}
+
+	primitive.flags = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		int next = (i + 1) % 3;
+		primitive.a[i] = y[i] - y[next];
+		primitive.b[i] = x[next] - x[i];
+		bool fromFirst = x[i] < x[next] || (x[i] == x[next] && y[i] < y[next]);
+		primitive.ox[i] = fromFirst ? x[i] : x[next];
+		primitive.oy[i] = fromFirst ? y[i] : y[next];
+		if (primitive.a[i] > 0.0f || (primitive.a[i] == 0.0f && primitive.b[i] > 0.0f))
+			primitive.flags |= FlagTopLeft0 << i;
+	}
+
+	float values[3][PlaneCount];
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* clip = vertices[i]->clip;
+		values[i][PlaneDepth] = clip[2] * invW[i];
+		values[i][PlaneInvW] = invW[i];
+		for (int attribute = 0; attribute < 9; ++attribute)
+		{
+			values[i][PlaneU + attribute] = vertices[i]->attributes[attribute] * invW[i];
+		}
+	}
+	float dx1 = x[1] - x[0], dy1 = y[1] - y[0];
+	float dx2 = x[2] - x[0], dy2 = y[2] - y[0];
+	primitive.x0 = x[0];
+	primitive.y0 = y[0];
+	for (int plane = 0; plane < PlaneCount; ++plane)
+	{
+		float d1 = values[1][plane] - values[0][plane];
+		float d2 = values[2][plane] - values[0][plane];
+		primitive.planes[plane][0] = values[0][plane];
+		primitive.planes[plane][1] = (d1 * dy2 - d2 * dy1) / area;
+		primitive.planes[plane][2] = (dx1 * d2 - dx2 * d1) / area;
+	}
+	primitive.draw = draw;
+	Bin(batch, primitive);
+}
+
+void SoftwareRasterizer::SetupLine(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, uint32_t draw)
+{
+	const ClipVertex* vertices[2] = { &v0, &v1 };
+	Primitive primitive;
+	memset(&primitive, 0, sizeof(primitive));
+	for (int i = 0; i < 2; ++i)
+	{
+		const float* clip = vertices[i]->clip;
+		if (clip[3] <= 0.0f)
+			return;
+		float invW = 1.0f / clip[3];
+		primitive.ox[i] = (clip[0] * invW * 0.5f + 0.5f) * float(m_width);
+		primitive.oy[i] = (0.5f - clip[1] * invW * 0.5f) * float(m_height);
+		primitive.planes[PlaneDepth][i] = clip[2] * invW;
+		primitive.planes[PlaneInvW][i] = invW;
+		for (int attribute = 0; attribute < 9; ++attribute)
+		{
+			primitive.planes[PlaneU + attribute][i] = vertices[i]->attributes[attribute] * invW;
+		}
+	}
+	primitive.minX = std::max(0, int32_t(floorf(std::min(primitive.ox[0], primitive.ox[1]))));
+	primitive.minY = std::max(0, int32_t(floorf(std::min(primitive.oy[0], primitive.oy[1]))));
+	primitive.maxX = std::min(int32_t(m_width) - 1, int32_t(floorf(std::max(primitive.ox[0], primitive.ox[1]))));
+	primitive.maxY = std::min(int32_t(m_height) - 1, int32_t(floorf(std::max(primitive.oy[0], primitive.oy[1]))));
+	if (primitive.minX > primitive.maxX || primitive.minY > primitive.maxY)
+		return;
+	primitive.draw = draw;
+	primitive.flags = FlagLine;
+	++batch.stats.lines;
+	Bin(batch, primitive);
+}
+
+void SoftwareRasterizer::Bin(Batch& batch, const Primitive& primitive)
+{
+	uint32_t index = static_cast<uint32_t>(batch.primitives.size());
+	batch.primitives.push_back(primitive);
+	for (uint32_t ty = uint32_t(primitive.minY) / TileSize; ty <= uint32_t(primitive.maxY) / TileSize; ++ty)
+	{
+		for (uint32_t tx = uint32_t(primitive.minX) / TileSize; tx <= uint32_t(primitive.maxX) / TileSize; ++tx)
+		{
+			batch.bins[ty * m_tilesX + tx].push_back(index);
+			++batch.stats.binned;
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tile, SoftwareRasterStats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+	const int32_t tileX = int32_t(tile % m_tilesX * TileSize);
+	const int32_t tileY = int32_t(tile / m_tilesX * TileSize);
+	for (uint32_t row = 0; row < TileSize; ++row)
+	{
+		size_t offset = (tileY + row) * m_pitch + tileX;
+		std::fill(&m_color[offset], &m_color[offset] + TileSize, m_clearColor);
+		std::fill(&m_depth[offset], &m_depth[offset] + TileSize, 1.0f);
+	}
+
+	for (size_t i = 0; i < m_slices.size(); ++i)
+	{
+		const Batch& batch = m_batches[i];
+		for (uint32_t index : batch.bins[tile])
+		{
+			const Primitive& primitive = batch.primitives[index];
+			if (primitive.flags & FlagLine)
+				RasterizeLine(primitive, tileX, tileY, stats);
+			else
+				RasterizeTriangle(primitive, tileX, tileY, stats);
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Primitive& primitive, int32_t tileX, int32_t tileY, SoftwareRasterStats& stats)
+{
+	const DrawState& draw = m_draws[primitive.draw];
+	const TextureLevels texture = { draw.texels, draw.levelOffset, draw.levelWidth, draw.levelHeight, draw.levels, draw.bgra };
+	const bool textured = draw.pixelShader != PixelUV && draw.texels;
+	const int32_t x0 = std::max(primitive.minX, tileX) & ~int32_t(SpanWidth - 1);
+	const int32_t x1 = std::min(primitive.maxX, tileX + int32_t(TileSize) - 1);
+	const int32_t y0 = std::max(primitive.minY, tileY);
+	const int32_t y1 = std::min(primitive.maxY, tileY + int32_t(TileSize) - 1);
+	const float (*planes)[3] = primitive.planes;
+
+#if DX_SIMD_AVX2
+	const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 topLeft[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		topLeft[i] = (primitive.flags & (FlagTopLeft0 << i)) ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : zero;
+	}
+	for (int32_t y = y0; y <= y1; ++y)
+	{
+		const float py = float(y) + 0.5f;
+		for (int32_t x = x0; x <= x1; x += SpanWidth)
+		{
+			__m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), lane);
+			__m256i column = _mm256_add_epi32(_mm256_set1_epi32(x), laneIndex);
+			__m256 mask = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(column, _mm256_set1_epi32(primitive.minX - 1)),
+															   _mm256_cmpgt_epi32(_mm256_set1_epi32(x1 + 1), column)));
+			for (int i = 0; i < 3; ++i)
+			{
+				__m256 e = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(primitive.a[i]), _mm256_sub_ps(px, _mm256_set1_ps(primitive.ox[i]))),
+										 _mm256_set1_ps(primitive.b[i] * (py - primitive.oy[i])));
+				__m256 inside = _mm256_or_ps(_mm256_cmp_ps(e, zero, _CMP_GT_OQ), _mm256_and_ps(_mm256_cmp_ps(e, zero, _CMP_EQ_OQ), topLeft[i]));
+				mask = _mm256_and_ps(mask, inside);
+			}
+			if (!_mm256_movemask_ps(mask))
+				continue;
+
+			// Each plane at the span's pixel centers.
+			const __m256 dx = _mm256_sub_ps(px, _mm256_set1_ps(primitive.x0));
+			const float dy = py - primitive.y0;
+			auto plane = [&](int p)
+			{
+				return _mm256_add_ps(_mm256_set1_ps(planes[p][0] + planes[p][2] * dy), _mm256_mul_ps(_mm256_set1_ps(planes[p][1]), dx));
+			};
+
+			size_t offset = size_t(y) * m_pitch + size_t(x);
+			__m256 z = plane(PlaneDepth);
+			__m256 depth = _mm256_loadu_ps(&m_depth[offset]);
+			mask = _mm256_and_ps(mask, _mm256_cmp_ps(z, depth, _CMP_LT_OQ));
+			int covered = _mm256_movemask_ps(mask);
+			if (!covered)
+				continue;
+			stats.pixelsShaded += CountBits(uint32_t(covered));
+
+			__m256 in[InputCount];
+			__m256 invW = plane(PlaneInvW);
+			__m256 w = _mm256_div_ps(one, invW);
+			in[InputU] = _mm256_mul_ps(plane(PlaneU), w);
+			in[InputV] = _mm256_mul_ps(plane(PlaneV), w);
+			in[InputPage] = _mm256_mul_ps(plane(PlanePage), w);
+			if (textured)
+			{
+				// d(a / w) / dx with a / w and 1 / w linear on screen.
+				__m256 dInvWdx = _mm256_set1_ps(planes[PlaneInvW][1]), dInvWdy = _mm256_set1_ps(planes[PlaneInvW][2]);
+				in[InputDuDx] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(planes[PlaneU][1]), _mm256_mul_ps(in[InputU], dInvWdx)), w);
+				in[InputDvDx] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(planes[PlaneV][1]), _mm256_mul_ps(in[InputV], dInvWdx)), w);
+				in[InputDuDy] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(planes[PlaneU][2]), _mm256_mul_ps(in[InputU], dInvWdy)), w);
+				in[InputDvDy] = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(planes[PlaneV][2]), _mm256_mul_ps(in[InputV], dInvWdy)), w);
+			}
+			else
+			{
+				in[InputDuDx] = in[InputDvDx] = in[InputDuDy] = in[InputDvDy] = zero;
+			}
+			if (draw.pixelShader != PixelUV)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					in[InputNormalX + i] = _mm256_mul_ps(plane(PlaneNormalX + i), w);
+					in[InputWorldX + i] = _mm256_mul_ps(plane(PlaneWorldX + i), w);
+				}
+			}
+
+			__m256 keep = mask;
+			__m256i color = ShadeAvx2(draw.pixelShader, texture, m_lighting, in, keep);
+			int written = _mm256_movemask_ps(keep);
+			if (!written)
+				continue;
+			stats.pixelsWritten += CountBits(uint32_t(written));
+			__m256i* target = reinterpret_cast<__m256i*>(&m_color[offset]);
+			_mm256_storeu_si256(target, _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(_mm256_loadu_si256(target)),
+																			  _mm256_castsi256_ps(color), keep)));
+			_mm256_storeu_ps(&m_depth[offset], _mm256_blendv_ps(depth, z, keep));
+		}
+	}
+#else
+	for (int32_t y = y0; y <= y1; ++y)
+	{
+		const float py = float(y) + 0.5f;
+		for (int32_t x = std::max(x0, primitive.minX); x <= x1; ++x)
+		{
+			const float px = float(x) + 0.5f;
+			bool inside = true;
+			for (int i = 0; i < 3 && inside; ++i)
+			{
+				float e = primitive.a[i] * (px - primitive.ox[i]) + primitive.b[i] * (py - primitive.oy[i]);
+				inside = e > 0.0f || (e == 0.0f && (primitive.flags & (FlagTopLeft0 << i)));
+			}
+			if (!inside)
+				continue;
+
+			const float dx = px - primitive.x0;
+			const float dy = py - primitive.y0;
+			auto plane = [&](int p) { return planes[p][0] + planes[p][2] * dy + planes[p][1] * dx; };
+
+			size_t offset = size_t(y) * m_pitch + size_t(x);
+			float z = plane(PlaneDepth);
+			if (!(z < m_depth[offset]))
+				continue;
+			++stats.pixelsShaded;
+
+			float in[InputCount];
+			float w = 1.0f / plane(PlaneInvW);
+			in[InputU] = plane(PlaneU) * w;
+			in[InputV] = plane(PlaneV) * w;
+			in[InputPage] = plane(PlanePage) * w;
+			if (textured)
+			{
+				float dInvWdx = planes[PlaneInvW][1], dInvWdy = planes[PlaneInvW][2];
+				in[InputDuDx] = (planes[PlaneU][1] - in[InputU] * dInvWdx) * w;
+				in[InputDvDx] = (planes[PlaneV][1] - in[InputV] * dInvWdx) * w;
+				in[InputDuDy] = (planes[PlaneU][2] - in[InputU] * dInvWdy) * w;
+				in[InputDvDy] = (planes[PlaneV][2] - in[InputV] * dInvWdy) * w;
+			}
+			else
+			{
+				in[InputDuDx] = in[InputDvDx] = in[InputDuDy] = in[InputDvDy] = 0.0f;
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				in[InputNormalX + i] = plane(PlaneNormalX + i) * w;
+				in[InputWorldX + i] = plane(PlaneWorldX + i) * w;
+			}
+
+			uint32_t color;
+			if (!ShadePixel(draw.pixelShader, texture, m_lighting, in, color))
+				continue;
+			++stats.pixelsWritten;
+			m_color[offset] = color;
+			m_depth[offset] = z;
+		}
+	}
+#endif
+}
+
+void SoftwareRasterizer::RasterizeLine(const Primitive& primitive, int32_t tileX, int32_t tileY, SoftwareRasterStats& stats)
+{
+	const DrawState& draw = m_draws[primitive.draw];
+	const TextureLevels texture = { draw.texels, draw.levelOffset, draw.levelWidth, draw.levelHeight, draw.levels, draw.bgra };
+	const int32_t tileX1 = std::min(tileX + int32_t(TileSize), int32_t(m_width)) - 1;
+	const int32_t tileY1 = std::min(tileY + int32_t(TileSize), int32_t(m_height)) - 1;
+
+	// One pixel per column or row along the major axis, at the pixel centers it crosses.
+	const float dx = primitive.ox[1] - primitive.ox[0];
+	const float dy = primitive.oy[1] - primitive.oy[0];
+	const bool xMajor = fabsf(dx) >= fabsf(dy);
+	const float length = xMajor ? dx : dy;
+	if (length == 0.0f)
+		return;
+	const float start = xMajor ? primitive.ox[0] : primitive.oy[0];
+	const float end = xMajor ? primitive.ox[1] : primitive.oy[1];
+	int32_t first = int32_t(ceilf(std::min(start, end) - 0.5f));
+	int32_t last = int32_t(ceilf(std::max(start, end) - 0.5f)) - 1;
+	first = std::max(first, xMajor ? tileX : tileY);
+	last = std::min(last, xMajor ? tileX1 : tileY1);
+
+	for (int32_t major = first; major <= last; ++major)
+	{
+		float t = (float(major) + 0.5f - start) / length;
+		float minor = xMajor ? primitive.oy[0] + dy * t : primitive.ox[0] + dx * t;
+		int32_t x = xMajor ? major : int32_t(floorf(minor));
+		int32_t y = xMajor ? int32_t(floorf(minor)) : major;
+		if (x < tileX || x > tileX1 || y < tileY || y > tileY1)
+			continue;
+
+		auto plane = [&](int p) { return primitive.planes[p][0] + (primitive.planes[p][1] - primitive.planes[p][0]) * t; };
+		size_t offset = size_t(y) * m_pitch + size_t(x);
+		float z = plane(PlaneDepth);
+		if (!(z < m_depth[offset]))
+			continue;
+		++stats.pixelsShaded;
+
+		float in[InputCount];
+		float w = 1.0f / plane(PlaneInvW);
+		in[InputU] = plane(PlaneU) * w;
+		in[InputV] = plane(PlaneV) * w;
+		in[InputPage] = plane(PlanePage) * w;
+		in[InputDuDx] = in[InputDvDx] = in[InputDuDy] = in[InputDvDy] = 0.0f;
+		for (int i = 0; i < 3; ++i)
+		{
+			in[InputNormalX + i] = plane(PlaneNormalX + i) * w;
+			in[InputWorldX + i] = plane(PlaneWorldX + i) * w;
+		}
+
+		uint32_t color;
+		if (!ShadePixel(draw.pixelShader, texture, m_lighting, in, color))
+			continue;
+		++stats.pixelsWritten;
+		m_color[offset] = color;
+		m_depth[offset] = z;
+	}
+}
+
+bool SoftwareRasterizer::WriteImage(const char* path) const
+{
+	FILE* file = OpenFile(path, "wb");
+	if (!file)
+		return false;
+	fprintf(file, "P6\n%u %u\n255\n", m_width, m_height);
+	std::vector<uint8_t> row(size_t(m_width) * 3);
+	bool ok = true;
+	for (uint32_t y = 0; y < m_height && ok; ++y)
+	{
+		const uint32_t* pixels = &m_color[y * m_pitch];
+		for (uint32_t x = 0; x < m_width; ++x)
+		{
+			row[x * 3] = uint8_t(pixels[x]);
+			row[x * 3 + 1] = uint8_t(pixels[x] >> 8);
+			row[x * 3 + 2] = uint8_t(pixels[x] >> 16);
+		}
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+	return fclose(file) == 0 && ok;
+}
+
+bool DX::ReadImage(const char* path, std::vector<uint32_t>& pixels, uint32_t& width, uint32_t& height)
+{
+	FILE* file = OpenFile(path, "rb");
+	if (!file)
+		return false;
+	uint32_t maxValue = 0;
+	bool ok = fgetc(file) == 'P' && fgetc(file) == '6' && ReadHeaderValue(file, width) && ReadHeaderValue(file, height) &&
+			  ReadHeaderValue(file, maxValue) && maxValue == 255 && width > 0 && height > 0;
+	if (ok)
+	{
+		std::vector<uint8_t> data(size_t(width) * height * 3);
+		ok = fread(data.data(), 1, data.size(), file) == data.size();
+		pixels.resize(size_t(width) * height);
+		for (size_t i = 0; ok && i < pixels.size(); ++i)
+		{
+			pixels[i] = uint32_t(data[i * 3]) | (uint32_t(data[i * 3 + 1]) << 8) | (uint32_t(data[i * 3 + 2]) << 16) | 0xff000000u;
+		}
+	}
+	fclose(file);
+	return ok;
+}
+
+ImageDifference DX::CompareImages(const uint32_t* a, const uint32_t* b, size_t count, uint32_t tolerance)
+{
+	ImageDifference difference = { 0, 0, 0.0 };
+	double sum = 0.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t worst = 0;
+		for (int c = 0; c < 3; ++c)
+		{
+			int32_t delta = int32_t((a[i] >> (c * 8)) & 0xff) - int32_t((b[i] >> (c * 8)) & 0xff);
+			uint32_t error = uint32_t(delta < 0 ? -delta : delta);
+			worst = std::max(worst, error);
+			sum += double(error) * double(error);
+		}
+		difference.maxError = std::max(difference.maxError, worst);
+		if (worst > tolerance)
+			++difference.pixelsOver;
+	}
+	difference.rootMeanSquare = count ? sqrt(sum / (double(count) * 3.0)) : 0.0;
+	return difference;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "DDSFile.h"
+#include "InstanceSet.h"
+#include "ObjMesh.h"
+#include "ShaderLighting.h"
+
+// CPU reference renderer for machines without a GPU. It runs the scene's shader pipeline in
+// C++: the vertex shaders' transforms, HullShader's screen-size edge factors (rounded up to the
+// odd whole factors that fractional_odd spaces evenly) with DomainShader's Phong interpolation,
+// and the pixel shaders (LightPixelShader's directional, spot and point lights, through
+// ShaderLighting, behind the alpha test, and the pyramids' uv colors). Render cuts the frame's
+// draws into slices that the shared worker pool transforms, tessellates, clips, sets up and bins
+// into 64x64 tiles, then rasterizes and shades the tiles in parallel, eight pixels at a time with
+// AVX2. Rasterization follows Direct3D 11: pixel centers at .5, the top-left fill rule, a LESS
+// depth test, and counter-clockwise (back) faces culled.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	enum SoftwarePixelShader : uint32_t
+	{
+		PixelLit = 0,		// LightPixelShader.
+		PixelLitOpaque,		// LightPixelShaderOpaque, without the alpha test.
+		PixelUV				// PyramidPixelShader: float4(uv, 1).
+	};
+
+	enum SoftwarePrimitive : uint32_t
+	{
+		PrimitiveTriangleList = 0,
+		PrimitiveTriangleStrip,
+		PrimitiveLineList,		// Two indices per line, as the renderer's MeshEdges draws.
+		PrimitivePatchList		// Three-point patches through HullShader and DomainShader.
+	};
+
+	struct SoftwareDraw
+	{
+		const ObjVertex* vertices;
+		const uint32_t* indices;
+		uint32_t indexCount;
+		SoftwarePrimitive primitive;
+		SoftwarePixelShader pixelShader;
+		float world[16];					// Row-major object-to-world; ignored with instances.
+		const InstanceData* instances;		// Transforms as InstancedVertexShader does when set.
+		uint32_t instanceCount;
+		const DDSImage* texture;			// Read by the lit shaders; must outlive Render.
+		float tessellation[4];				// Patch draws: the object constants' x = largest factor,
+											// y = Phong shape factor, z = segments per unit of edge
+											// length at distance 1. All zero tessellates nothing.
+	};
+
+	struct SoftwareRasterStats
+	{
+		uint32_t draws;
+		uint32_t patches;				// Input primitives, patches, triangles or lines, of every instance.
+		uint32_t triangles;				// After tessellation.
+		uint32_t culled;				// Back-facing, degenerate or outside the frustum.
+		uint32_t lines;
+		uint64_t binned;				// Primitive and tile pairs.
+		uint64_t pixelsShaded;			// Pixels that passed the depth test.
+		uint64_t pixelsWritten;			// and weren't discarded.
+	};
+
+	class SoftwareRasterizer
+	{
+	public:
+		static const uint32_t TileSize = 64;
+
+		explicit SoftwareRasterizer(uint32_t width = 1280, uint32_t height = 720);
+
+		void Resize(uint32_t width, uint32_t height);
+
+		// Starts a frame. view and projection are row-major, as the renderer keeps them before
+		// transposing them into the constant buffer. Color and depth are cleared during Render.
+		void BeginFrame(const float view[16], const float projection[16], const ShaderLightSet& lights,
+						const float clearColor[4]);
+
+		// Records a draw; its vertices, indices, instances and texture must stay valid until Render.
+		void Draw(const SoftwareDraw& draw);
+
+		// Clears the targets and renders every draw recorded since BeginFrame.
+		void Render(void);
+
+		uint32_t GetWidth(void) const { return m_width; }
+		uint32_t GetHeight(void) const { return m_height; }
+		// Row-major RGBA8, red in the low byte.
+		const uint32_t* GetColorData(void) const { return m_color.data(); }
+		size_t GetPitch(void) const { return m_pitch; }
+		const SoftwareRasterStats& GetStats(void) const { return m_stats; }
+
+		// Writes the color buffer as a binary PPM. Returns false if the file can't be written.
+		bool WriteImage(const char* path) const;
+
+	private:
+		// Values interpolated across a primitive, each divided by w except depth.
+		enum Plane
+		{
+			PlaneDepth = 0,
+			PlaneInvW,
+			PlaneU, PlaneV, PlanePage,
+			PlaneNormalX, PlaneNormalY, PlaneNormalZ,
+			PlaneWorldX, PlaneWorldY, PlaneWorldZ,
+			PlaneCount
+		};
+
+		enum PrimitiveFlags : uint32_t
+		{
+			FlagTopLeft0 = 1,		// Edge i is a top or left edge when bit i is set.
+			FlagLine = 8
+		};
+
+		// A set-up triangle or line. Triangles keep three edge functions, a * (x - ox) + b * (y - oy),
+		// non-negative inside; both triangles on a shared edge take the same end point as its origin,
+		// so they compute the same value with opposite signs and the fill rule hands each pixel to
+		// exactly one of them. Each plane holds the value at (x0, y0) and its x and y gradients.
+		// Lines keep their end points in ox and oy and each plane's value at both ends.
+		struct Primitive
+		{
+			float ox[3], oy[3];
+			float a[3], b[3];
+			float x0, y0;
+			float planes[PlaneCount][3];
+			int32_t minX, minY, maxX, maxY;	// Pixels that may be covered, inclusive.
+			uint32_t draw;
+			uint32_t flags;
+		};
+
+		// Input primitives [begin, end) of one draw, counting every instance.
+		struct Slice
+		{
+			uint32_t draw;
+			size_t begin;
+			size_t end;
+		};
+
+		// Primitives set up from one slice, with the slice's own tile bins so workers need no
+		// synchronization. Tiles walk the batches in submission order. The domain points and
+		// triangles are the tessellator's output for the slice's last patch.
+		struct Batch
+		{
+			std::vector<Primitive> primitives;
+			std::vector<std::vector<uint32_t>> bins;
+			std::vector<float> domainPoints;
+			std::vector<uint16_t> domainTriangles;
+			SoftwareRasterStats stats;
+		};
+
+		// What the pixel shaders read for a draw: its texture's mip chain and the shader itself.
+		struct DrawState
+		{
+			SoftwarePixelShader pixelShader;
+			const uint32_t* texels;			// Null without a texture, which then samples as zero.
+			bool bgra;
+			int32_t levels;
+			int32_t levelOffset[16];
+			int32_t levelWidth[16];
+			int32_t levelHeight[16];
+		};
+
+		struct ClipVertex
+		{
+			float clip[4];
+			float attributes[9];		// uv, normal and world position.
+		};
+
+		void SetupSlice(const Slice& slice, Batch& batch);
+		void ClipTriangle(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, uint32_t draw);
+		void ClipLine(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, uint32_t draw);
+		void SetupTriangle(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, uint32_t draw);
+		void SetupLine(Batch& batch, const ClipVertex& v0, const ClipVertex& v1, uint32_t draw);
+		void Bin(Batch& batch, const Primitive& primitive);
+		void RasterizeTile(uint32_t tile, SoftwareRasterStats& stats);
+		void RasterizeTriangle(const Primitive& primitive, int32_t tileX, int32_t tileY, SoftwareRasterStats& stats);
+		void RasterizeLine(const Primitive& primitive, int32_t tileX, int32_t tileY, SoftwareRasterStats& stats);
+
+		uint32_t m_width;
+		uint32_t m_height;
+		uint32_t m_tilesX;
+		uint32_t m_tilesY;
+		size_t m_pitch;						// Pixels per row of the padded targets.
+		std::vector<uint32_t> m_color;
+		std::vector<float> m_depth;
+
+		float m_view[16];
+		float m_viewProjection[16];
+		LightingConstants m_lighting;
+		uint32_t m_clearColor;
+		std::vector<SoftwareDraw> m_drawList;
+		std::vector<DrawState> m_draws;
+		std::vector<Slice> m_slices;
+		std::vector<Batch> m_batches;
+		std::vector<SoftwareRasterStats> m_tileStats;
+		SoftwareRasterStats m_stats;
+	};
+
+	// Reads a binary PPM written by WriteImage into RGBA8 pixels with opaque alpha.
+	bool ReadImage(const char* path, std::vector<uint32_t>& pixels, uint32_t& width, uint32_t& height);
+
+	struct ImageDifference
+	{
+		uint32_t maxError;			// Largest difference of any color channel.
+		size_t pixelsOver;			// Pixels with a channel off by more than the tolerance.
+		double rootMeanSquare;		// Over every color channel, in 0-255 units.
+	};
+
+	// Compares the color channels of two equally sized RGBA8 images; alpha is ignored.
+	ImageDifference CompareImages(const uint32_t* a, const uint32_t* b, size_t count, uint32_t tolerance);
+}
@@ -0,0 +1,199 @@
+#include "StateCache.h"
+
+#include <string.h>
+
+using namespace DX;
+
+namespace
+{
+	// Stands for "unknown" after Invalidate. No real state object lives at this address and
+	// no real enum or offset has this value, so the first call of each kind always goes through.
+	const void* const Unknown = reinterpret_cast<const void*>(~uintptr_t(0));
+	const uint32_t UnknownValue = UINT32_MAX;
+}
+
+uint32_t StateCacheStats::TotalIssued(void) const
+{
+	uint32_t total = 0;
+	for (uint32_t count : issued)
+	{
+		total += count;
+	}
+	return total;
+}
+
+uint32_t StateCacheStats::TotalFiltered(void) const
+{
+	uint32_t total = 0;
+	for (uint32_t count : filtered)
+	{
+		total += count;
+	}
+	return total;
+}
+
+StateCache::StateCache(IRenderBackend* backend) :
+	m_backend(backend)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	memset(&m_lastFrame, 0, sizeof(m_lastFrame));
+	Invalidate();
+}
+
+void StateCache::Invalidate(void)
+{
+	m_inputLayout = Unknown;
+	for (VertexStream& stream : m_vertexStreams)
+	{
+		stream.buffer = Unknown;
+		stream.stride = UnknownValue;
+		stream.offset = UnknownValue;
+	}
+	m_indexBuffer = Unknown;
+	m_indexFormat = UnknownValue;
+	m_indexOffset = UnknownValue;
+	m_topology = UnknownValue;
+	m_rasterizerState = Unknown;
+
+	for (uint32_t stage = 0; stage < StageCount; ++stage)
+	{
+		m_shaders[stage] = Unknown;
+		for (ConstantBinding& binding : m_constantBuffers[stage])
+		{
+			binding.buffer = Unknown;
+			binding.firstConstant = UnknownValue;
+			binding.constantCount = UnknownValue;
+		}
+		for (const void*& view : m_shaderResources[stage])
+			view = Unknown;
+		for (const void*& sampler : m_samplers[stage])
+			sampler = Unknown;
+	}
+}
+
+void StateCache::BeginFrame(void)
+{
+	m_lastFrame = m_stats;
+	memset(&m_stats, 0, sizeof(m_stats));
+	Invalidate();
+}
+
+void StateCache::SetInputLayout(const void* layout)
+{
+	if (Track(CallInputLayout, layout != m_inputLayout))
+	{
+		m_backend->SetInputLayout(layout);
+	}
+	m_inputLayout = layout;
+}
+
+void StateCache::SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset)
+{
+	// Slots past the cache's range are passed through untracked.
+	if (slot >= VertexBufferSlots)
+	{
+		if (Track(CallVertexBuffer, true))
+			m_backend->SetVertexBuffer(slot, buffer, stride, offset);
+		return;
+	}
+
+	VertexStream& stream = m_vertexStreams[slot];
+	if (Track(CallVertexBuffer, stream.buffer != buffer || stream.stride != stride || stream.offset != offset))
+	{
+		m_backend->SetVertexBuffer(slot, buffer, stride, offset);
+	}
+	stream.buffer = buffer;
+	stream.stride = stride;
+	stream.offset = offset;
+}
+
+void StateCache::SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset)
+{
+	if (Track(CallIndexBuffer, buffer != m_indexBuffer || format != m_indexFormat || offset != m_indexOffset))
+	{
+		m_backend->SetIndexBuffer(buffer, format, offset);
+	}
+	m_indexBuffer = buffer;
+	m_indexFormat = format;
+	m_indexOffset = offset;
+}
+
+void StateCache::SetPrimitiveTopology(uint32_t topology)
+{
+	if (Track(CallTopology, topology != m_topology))
+	{
+		m_backend->SetPrimitiveTopology(topology);
+	}
+	m_topology = topology;
+}
+
+void StateCache::SetShader(ShaderStage stage, const void* shader)
+{
+	if (Track(CallShader, shader != m_shaders[stage]))
+	{
+		m_backend->SetShader(stage, shader);
+	}
+	m_shaders[stage] = shader;
+}
+
+void StateCache::SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+								   uint32_t firstConstant, uint32_t constantCount)
+{
+	if (slot >= ConstantBufferSlots)
+	{
+		if (Track(CallConstantBuffer, true))
+			m_backend->SetConstantBuffer(stage, slot, buffer, firstConstant, constantCount);
+		return;
+	}
+
+	ConstantBinding& binding = m_constantBuffers[stage][slot];
+	if (Track(CallConstantBuffer, binding.buffer != buffer || binding.firstConstant != firstConstant ||
+								  binding.constantCount != constantCount))
+	{
+		m_backend->SetConstantBuffer(stage, slot, buffer, firstConstant, constantCount);
+	}
+	binding.buffer = buffer;
+	binding.firstConstant = firstConstant;
+	binding.constantCount = constantCount;
+}
+
+void StateCache::SetShaderResource(ShaderStage stage, uint32_t slot, const void* view)
+{
+	if (slot >= ShaderResourceSlots)
+	{
+		if (Track(CallShaderResource, true))
+			m_backend->SetShaderResource(stage, slot, view);
+		return;
+	}
+
+	if (Track(CallShaderResource, view != m_shaderResources[stage][slot]))
+	{
+		m_backend->SetShaderResource(stage, slot, view);
+	}
+	m_shaderResources[stage][slot] = view;
+}
+
+void StateCache::SetSampler(ShaderStage stage, uint32_t slot, const void* sampler)
+{
+	if (slot >= SamplerSlots)
+	{
+		if (Track(CallSampler, true))
+			m_backend->SetSampler(stage, slot, sampler);
+		return;
+	}
+
+	if (Track(CallSampler, sampler != m_samplers[stage][slot]))
+	{
+		m_backend->SetSampler(stage, slot, sampler);
+	}
+	m_samplers[stage][slot] = sampler;
+}
+
+void StateCache::SetRasterizerState(const void* state)
+{
+	if (Track(CallRasterizerState, state != m_rasterizerState))
+	{
+		m_backend->SetRasterizerState(state);
+	}
+	m_rasterizerState = state;
+}
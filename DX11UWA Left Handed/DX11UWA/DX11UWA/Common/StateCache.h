@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+
+// Filters redundant pipeline state changes before they reach the device context.
+// The cache talks to an IRenderBackend, so the filtering logic has no Direct3D
+// dependencies and can be driven by a recording backend on any platform;
+// D3D11StateBackend forwards to a real ID3D11DeviceContext1.
+namespace DX
+{
+	enum ShaderStage : uint32_t
+	{
+		StageVertex = 0,
+		StageHull,
+		StageDomain,
+		StageGeometry,
+		StagePixel,
+		StageCount
+	};
+
+	// Kinds of state calls, used to index the per-frame counters.
+	enum StateCall : uint32_t
+	{
+		CallInputLayout = 0,
+		CallVertexBuffer,
+		CallIndexBuffer,
+		CallTopology,
+		CallShader,
+		CallConstantBuffer,
+		CallShaderResource,
+		CallSampler,
+		CallRasterizerState,
+		StateCallCount
+	};
+
+	// State objects are passed as opaque handles; the backend knows their real types.
+	class IRenderBackend
+	{
+	public:
+		virtual ~IRenderBackend() {}
+
+		virtual void SetInputLayout(const void* layout) = 0;
+		virtual void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) = 0;
+		virtual void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) = 0;
+		virtual void SetPrimitiveTopology(uint32_t topology) = 0;
+		virtual void SetShader(ShaderStage stage, const void* shader) = 0;
+		// constantCount == 0 binds the whole buffer; otherwise the range is in 16-byte constants.
+		virtual void SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+									   uint32_t firstConstant, uint32_t constantCount) = 0;
+		virtual void SetShaderResource(ShaderStage stage, uint32_t slot, const void* view) = 0;
+		virtual void SetSampler(ShaderStage stage, uint32_t slot, const void* sampler) = 0;
+		virtual void SetRasterizerState(const void* state) = 0;
+
+		// Not cached, but issued through the backend so that recorded streams keep them in order
+		// with the state calls.
+		virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+		virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+										  int32_t baseVertex, uint32_t startInstance) = 0;
+		// Replaces the whole contents of buffer with size bytes read from data.
+		virtual void UpdateBuffer(const void* buffer, const void* data, uint32_t size) = 0;
+	};
+
+	struct StateCacheStats
+	{
+		uint32_t issued[StateCallCount];
+		uint32_t filtered[StateCallCount];
+
+		uint32_t TotalIssued(void) const;
+		uint32_t TotalFiltered(void) const;
+	};
+
+	class StateCache
+	{
+	public:
+		static const uint32_t VertexBufferSlots = 4;
+		static const uint32_t ConstantBufferSlots = 4;
+		static const uint32_t ShaderResourceSlots = 8;
+		static const uint32_t SamplerSlots = 4;
+
+		explicit StateCache(IRenderBackend* backend = nullptr);
+
+		void SetBackend(IRenderBackend* backend) { m_backend = backend; Invalidate(); }
+		IRenderBackend* GetBackend(void) const { return m_backend; }
+
+		// Forgets everything that is bound, so the next call of each kind always goes through.
+		// Call whenever something else may have touched the context (Direct2D, a command list, ...).
+		void Invalidate(void);
+
+		// Starts a new frame: invalidates the cache and moves the counters to GetLastFrameStats.
+		void BeginFrame(void);
+
+		void SetInputLayout(const void* layout);
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset);
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset);
+		void SetPrimitiveTopology(uint32_t topology);
+		void SetShader(ShaderStage stage, const void* shader);
+		void SetConstantBuffer(ShaderStage stage, uint32_t slot, const void* buffer,
+							   uint32_t firstConstant = 0, uint32_t constantCount = 0);
+		void SetShaderResource(ShaderStage stage, uint32_t slot, const void* view);
+		void SetSampler(ShaderStage stage, uint32_t slot, const void* sampler);
+		void SetRasterizerState(const void* state);
+
+		// Passed straight through to the backend.
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+		{
+			if (m_backend)
+				m_backend->DrawIndexed(indexCount, startIndex, baseVertex);
+		}
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex,
+								  int32_t baseVertex, uint32_t startInstance)
+		{
+			if (m_backend)
+				m_backend->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+		}
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size)
+		{
+			if (m_backend)
+				m_backend->UpdateBuffer(buffer, data, size);
+		}
+
+		const StateCacheStats& GetStats(void) const { return m_stats; }
+		const StateCacheStats& GetLastFrameStats(void) const { return m_lastFrame; }
+
+	private:
+		struct VertexStream
+		{
+			const void* buffer;
+			uint32_t stride;
+			uint32_t offset;
+		};
+
+		struct ConstantBinding
+		{
+			const void* buffer;
+			uint32_t firstConstant;
+			uint32_t constantCount;
+		};
+
+		// Records the call and returns true if it has to reach the backend.
+		bool Track(StateCall call, bool changed)
+		{
+			++(changed ? m_stats.issued : m_stats.filtered)[call];
+			return changed && m_backend;
+		}
+
+		IRenderBackend* m_backend;
+
+		const void* m_inputLayout;
+		VertexStream m_vertexStreams[VertexBufferSlots];
+		const void* m_indexBuffer;
+		uint32_t m_indexFormat;
+		uint32_t m_indexOffset;
+		uint32_t m_topology;
+		const void* m_shaders[StageCount];
+		ConstantBinding m_constantBuffers[StageCount][ConstantBufferSlots];
+		const void* m_shaderResources[StageCount][ShaderResourceSlots];
+		const void* m_samplers[StageCount][SamplerSlots];
+		const void* m_rasterizerState;
+
+		StateCacheStats m_stats;
+		StateCacheStats m_lastFrame;
+	};
+}
@@ -0,0 +1,402 @@
+#include "TessellationCache.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace DX;
+
+namespace
+{
+	const size_t PatchGrain = 64;
+	const size_t EdgeGrain = 256;
+
+	enum PointKind : uint8_t { PointCorner, PointEdge, PointInterior };
+
+	// A point of the tessellation of one patch, where every patch of a mesh puts it.
+	struct PatternPoint
+	{
+		float domain[3];
+		PointKind kind;
+		uint8_t side;		// Corner, or edge from corner side to the next one.
+		uint32_t index;		// Steps from the side's corner along an edge, or interior point number.
+	};
+
+	// The tessellation of one patch with every factor set to the same odd n.
+	struct Pattern
+	{
+		uint32_t factor;
+		std::vector<PatternPoint> points;
+		std::vector<uint32_t> triangles;	// Into points.
+		uint32_t interiorCount;
+	};
+
+	// The unique edges of a mesh; the corners of an edge are ordered by index.
+	struct MeshEdges
+	{
+		std::vector<uint32_t> corners;		// Two per edge.
+		std::vector<uint32_t> sideEdges;	// Edge of each triangle side, side k going from corner k to k + 1.
+		// Per edge, the first edge between the same two positions, which places the points of
+		// both, and whether its lower corner is at this edge's upper one.
+		std::vector<uint32_t> placedBy;
+		std::vector<uint8_t> reversed;
+	};
+
+	bool PositionLess(const ObjVertex& a, const ObjVertex& b)
+	{
+		if (a.pos[0] != b.pos[0])
+			return a.pos[0] < b.pos[0];
+		if (a.pos[1] != b.pos[1])
+			return a.pos[1] < b.pos[1];
+		return a.pos[2] < b.pos[2];
+	}
+
+	bool PositionEqual(const ObjVertex& a, const ObjVertex& b)
+	{
+		return a.pos[0] == b.pos[0] && a.pos[1] == b.pos[1] && a.pos[2] == b.pos[2];
+	}
+
+	// Twice the signed area in the plane of the first two weights; the patch itself is positive.
+	float Orientation(const PatternPoint& a, const PatternPoint& b, const PatternPoint& c)
+	{
+		return (b.domain[0] - a.domain[0]) * (c.domain[1] - a.domain[1]) - (b.domain[1] - a.domain[1]) * (c.domain[0] - a.domain[0]);
+	}
+
+	// Ring r is a copy of the patch shrunk about its centre to (n - 2r) / n of its size, split
+	// into n - 2r segments per side; rings are stitched to the next one in by strips of triangles.
+	void BuildPattern(uint32_t n, Pattern& pattern)
+	{
+		pattern.factor = n;
+		pattern.points.clear();
+		pattern.triangles.clear();
+		pattern.interiorCount = 0;
+
+		const uint32_t rings = (n - 1) / 2;
+		std::vector<std::vector<uint32_t>> ringPoints(rings + 1);
+		for (uint32_t r = 0; r <= rings; ++r)
+		{
+			const uint32_t m = n - 2 * r;
+			const double scale = double(m) / n;
+			double corners[3][3];
+			for (int k = 0; k < 3; ++k)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					corners[k][c] = (1.0 - scale) / 3.0 + (k == c ? scale : 0.0);
+				}
+			}
+			for (uint8_t k = 0; k < 3; ++k)
+			{
+				for (uint32_t j = 0; j < m; ++j)
+				{
+					PatternPoint point;
+					double t = double(j) / m;
+					for (int c = 0; c < 3; ++c)
+					{
+						point.domain[c] = static_cast<float>(corners[k][c] + t * (corners[(k + 1) % 3][c] - corners[k][c]));
+					}
+					point.side = k;
+					if (r > 0)
+					{
+						point.kind = PointInterior;
+						point.index = pattern.interiorCount++;
+					}
+					else
+					{
+						point.kind = j == 0 ? PointCorner : PointEdge;
+						point.index = j;
+					}
+					ringPoints[r].push_back(static_cast<uint32_t>(pattern.points.size()));
+					pattern.points.push_back(point);
+				}
+			}
+		}
+
+		auto triangle = [&](uint32_t a, uint32_t b, uint32_t c)
+		{
+			if (Orientation(pattern.points[a], pattern.points[b], pattern.points[c]) < 0.0f)
+				std::swap(b, c);
+			pattern.triangles.push_back(a);
+			pattern.triangles.push_back(b);
+			pattern.triangles.push_back(c);
+		};
+		for (uint32_t r = 0; r < rings; ++r)
+		{
+			const uint32_t m = n - 2 * r;
+			const std::vector<uint32_t>& outerRing = ringPoints[r];
+			const std::vector<uint32_t>& innerRing = ringPoints[r + 1];
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				// Point j of side k; the last one is the next side's first.
+				auto outer = [&](uint32_t j) { return outerRing[(k * m + j) % (3 * m)]; };
+				auto inner = [&](uint32_t j) { return innerRing[(k * (m - 2) + j) % (3 * (m - 2))]; };
+				triangle(outer(0), outer(1), inner(0));
+				for (uint32_t j = 0; j + 2 < m; ++j)
+				{
+					triangle(inner(j), outer(j + 1), outer(j + 2));
+					triangle(inner(j), outer(j + 2), inner(j + 1));
+				}
+				triangle(inner(m - 2), outer(m - 1), outer(m));
+			}
+		}
+		triangle(ringPoints[rings][0], ringPoints[rings][1], ringPoints[rings][2]);
+	}
+
+	// Corners that only differ in uv or normal, as OBJ files split them at seams, are separate
+	// vertices, so their edges are too; they are matched up again by position.
+	void FindEdges(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t triangleCount, MeshEdges& edges)
+	{
+		struct Side
+		{
+			uint32_t low, high;
+			size_t side;
+			bool operator<(const Side& other) const { return low != other.low ? low < other.low : high < other.high; }
+		};
+		std::vector<Side> sides(triangleCount * 3);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				uint32_t a = indices[t * 3 + k];
+				uint32_t b = indices[t * 3 + (k + 1) % 3];
+				Side side = { std::min(a, b), std::max(a, b), t * 3 + k };
+				sides[t * 3 + k] = side;
+			}
+		}
+		std::sort(sides.begin(), sides.end());
+
+		edges.corners.clear();
+		edges.sideEdges.resize(sides.size());
+		for (size_t i = 0; i < sides.size(); ++i)
+		{
+			if (i == 0 || sides[i].low != sides[i - 1].low || sides[i].high != sides[i - 1].high)
+			{
+				edges.corners.push_back(sides[i].low);
+				edges.corners.push_back(sides[i].high);
+			}
+			edges.sideEdges[sides[i].side] = static_cast<uint32_t>(edges.corners.size() / 2 - 1);
+		}
+
+		// Each vertex maps to the lowest-numbered one at the same position.
+		std::vector<uint32_t> order(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			order[v] = v;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return PositionLess(vertices[a], vertices[b]); });
+		std::vector<uint32_t> weld(vertexCount);
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			bool same = i > 0 && PositionEqual(vertices[order[i]], vertices[order[i - 1]]);
+			weld[order[i]] = same ? weld[order[i - 1]] : order[i];
+		}
+
+		const size_t edgeCount = edges.corners.size() / 2;
+		for (size_t e = 0; e < edgeCount; ++e)
+		{
+			uint32_t a = weld[edges.corners[e * 2]];
+			uint32_t b = weld[edges.corners[e * 2 + 1]];
+			Side side = { std::min(a, b), std::max(a, b), e };
+			sides[e] = side;
+		}
+		sides.resize(edgeCount);
+		std::stable_sort(sides.begin(), sides.end());
+		edges.placedBy.resize(edgeCount);
+		edges.reversed.resize(edgeCount);
+		for (size_t i = 0, first = 0; i < sides.size(); ++i)
+		{
+			if (sides[i].low != sides[first].low || sides[i].high != sides[first].high)
+				first = i;
+			size_t e = sides[i].side, placer = sides[first].side;
+			edges.placedBy[e] = static_cast<uint32_t>(placer);
+			edges.reversed[e] = weld[edges.corners[e * 2]] != weld[edges.corners[placer * 2]];
+		}
+	}
+
+	// Corners, then n - 1 points per edge, then the interior points of each patch.
+	size_t TessellatedVertexCount(size_t vertexCount, size_t edgeCount, size_t triangleCount, uint32_t n)
+	{
+		size_t rings = (n - 1) / 2;
+		return vertexCount + edgeCount * (n - 1) + triangleCount * 3 * rings * rings;
+	}
+
+	size_t TessellatedIndexCount(size_t triangleCount, uint32_t n)
+	{
+		size_t rings = (n - 1) / 2;
+		return triangleCount * 3 * (6 * rings * (n - rings) + 1);
+	}
+
+	void Tessellate(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t triangleCount,
+					const MeshEdges& edges, const Pattern& pattern, float phongAlpha, TessellatedMesh& out, WorkerPool& pool)
+	{
+		const uint32_t n = pattern.factor;
+		const size_t edgeCount = edges.corners.size() / 2;
+		const size_t edgeBase = vertexCount;
+		const size_t interiorBase = edgeBase + edgeCount * (n - 1);
+		out.factor = n;
+		out.vertices.resize(TessellatedVertexCount(vertexCount, edgeCount, triangleCount, n));
+		out.indices.resize(TessellatedIndexCount(triangleCount, n));
+
+		// At a corner, Phong tessellation gives back the corner itself.
+		std::copy(vertices, vertices + vertexCount, out.vertices.begin());
+
+		// Every edge between the same two positions takes its points' positions from one of them,
+		// evaluated the same way, so patches split by a seam meet bit for bit.
+		pool.ParallelFor(edgeCount, EdgeGrain, [&](size_t begin, size_t end)
+		{
+			for (size_t e = begin; e < end; ++e)
+			{
+				const ObjVertex& low = vertices[edges.corners[e * 2]];
+				const ObjVertex& high = vertices[edges.corners[e * 2 + 1]];
+				const size_t placer = edges.placedBy[e];
+				const ObjVertex& placerLow = vertices[edges.corners[placer * 2]];
+				const ObjVertex& placerHigh = vertices[edges.corners[placer * 2 + 1]];
+				for (uint32_t step = 1; step < n; ++step)
+				{
+					const float domain[3] = { float(n - step) / n, float(step) / n, 0.0f };
+					ObjVertex& vertex = out.vertices[edgeBase + e * (n - 1) + step - 1];
+					vertex = EvaluatePhongTriangle(low, high, low, domain, phongAlpha);
+					if (placer != e)
+					{
+						uint32_t placerStep = edges.reversed[e] ? n - step : step;
+						const float placerDomain[3] = { float(n - placerStep) / n, float(placerStep) / n, 0.0f };
+						ObjVertex placed = EvaluatePhongTriangle(placerLow, placerHigh, placerLow, placerDomain, phongAlpha);
+						std::copy(placed.pos, placed.pos + 3, vertex.pos);
+					}
+				}
+			}
+		});
+
+		pool.ParallelFor(triangleCount, PatchGrain, [&](size_t begin, size_t end)
+		{
+			std::vector<uint32_t> pointVertices(pattern.points.size());
+			for (size_t t = begin; t < end; ++t)
+			{
+				const uint32_t* corners = indices + t * 3;
+				size_t interior = interiorBase + t * pattern.interiorCount;
+				for (size_t p = 0; p < pattern.points.size(); ++p)
+				{
+					const PatternPoint& point = pattern.points[p];
+					size_t vertex;
+					if (point.kind == PointCorner)
+					{
+						vertex = corners[point.side];
+					}
+					else if (point.kind == PointEdge)
+					{
+						// Steps are counted from the edge's lower index, whichever way the side runs.
+						uint32_t edge = edges.sideEdges[t * 3 + point.side];
+						uint32_t step = corners[point.side] == edges.corners[edge * 2] ? point.index : n - point.index;
+						vertex = edgeBase + size_t(edge) * (n - 1) + step - 1;
+					}
+					else
+					{
+						vertex = interior + point.index;
+						out.vertices[vertex] = EvaluatePhongTriangle(vertices[corners[0]], vertices[corners[1]], vertices[corners[2]],
+																	 point.domain, phongAlpha);
+					}
+					pointVertices[p] = static_cast<uint32_t>(vertex);
+				}
+
+				uint32_t* triangles = out.indices.data() + t * pattern.triangles.size();
+				for (size_t i = 0; i < pattern.triangles.size(); ++i)
+				{
+					triangles[i] = pointVertices[pattern.triangles[i]];
+				}
+			}
+		});
+	}
+}
+
+ObjVertex DX::EvaluatePhongTriangle(const ObjVertex& a, const ObjVertex& b, const ObjVertex& c, const float domain[3], float phongAlpha)
+{
+	const ObjVertex* corners[3] = { &a, &b, &c };
+	ObjVertex result = {};
+	float flat[3] = {};
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			flat[c] += corners[i]->pos[c] * domain[i];
+			result.uv[c] += corners[i]->uv[c] * domain[i];
+			result.normal[c] += corners[i]->normal[c] * domain[i];
+		}
+	}
+
+	// Projections of the flat point onto each corner's tangent plane, blended like the corners.
+	float curved[3] = {};
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* normal = corners[i]->normal;
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (!(length > 0.0f))
+			length = 1.0f;
+		float n[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+		float height = 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			height += (flat[c] - corners[i]->pos[c]) * n[c];
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			curved[c] += domain[i] * (flat[c] - height * n[c]);
+		}
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		result.pos[c] = flat[c] + phongAlpha * (curved[c] - flat[c]);
+	}
+	return result;
+}
+
+uint32_t DX::OddTessellationFactor(float factor)
+{
+	if (!(factor > 1.0f))
+		return 1;
+	uint32_t n = static_cast<uint32_t>(ceilf(factor));
+	return n | 1;
+}
+
+void DX::TessellateMesh(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+						uint32_t factor, float phongAlpha, TessellatedMesh& out, WorkerPool& pool)
+{
+	size_t triangleCount = indexCount / 3;
+	MeshEdges edges;
+	FindEdges(vertices, vertexCount, indices, triangleCount, edges);
+	Pattern pattern;
+	BuildPattern(OddTessellationFactor(float(factor)), pattern);
+	Tessellate(vertices, vertexCount, indices, triangleCount, edges, pattern, phongAlpha, out, pool);
+}
+
+bool TessellationCache::Build(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+							  float maxFactor, float phongAlpha, size_t maxVertices, WorkerPool& pool)
+{
+	m_levels.clear();
+	size_t triangleCount = indexCount / 3;
+	MeshEdges edges;
+	FindEdges(vertices, vertexCount, indices, triangleCount, edges);
+
+	const uint32_t finest = OddTessellationFactor(maxFactor);
+	size_t total = 0;
+	for (uint32_t n = 1; n <= finest; n += 2)
+	{
+		total += TessellatedVertexCount(vertexCount, edges.corners.size() / 2, triangleCount, n);
+	}
+	if (total > maxVertices)
+		return false;
+
+	m_levels.resize((finest + 1) / 2);
+	Pattern pattern;
+	for (uint32_t n = 1; n <= finest; n += 2)
+	{
+		BuildPattern(n, pattern);
+		Tessellate(vertices, vertexCount, indices, triangleCount, edges, pattern, phongAlpha, m_levels[n / 2], pool);
+	}
+	return true;
+}
+
+size_t TessellationCache::SelectLevel(float factor) const
+{
+	size_t level = OddTessellationFactor(factor) / 2;
+	return std::min(level, m_levels.size() - 1);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ObjMesh.h"
+
+// Reproduces on the CPU what the tessellator and DomainShader.hlsl make of a triangle mesh, so a
+// static mesh can be tessellated once at load and drawn without the hull and domain stages.
+// fractional_odd partitioning with every factor set to the same odd integer n places exactly the
+// points of integer partitioning: rings of triangles shrinking towards the patch centre, ring r
+// with n - 2r segments per side, down to a single triangle. Points on a patch edge depend only on
+// the edge, so patches that share an edge's vertices share its points too. Where a seam splits a
+// corner into vertices with their own uv or normal, the edges between the same two positions all
+// take their points' positions from the first of them, so the result has no cracks there either.
+// A cache keeps one welded mesh per odd factor; factors in between are drawn with the next one up.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	class WorkerPool;
+
+	struct TessellatedMesh
+	{
+		uint32_t factor;
+		std::vector<ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	// DomainShader.hlsl at domain (weights of a, b and c, summing to 1): Phong tessellation blended
+	// in by phongAlpha, and the corners' uv and normal interpolated linearly, in object space.
+	ObjVertex EvaluatePhongTriangle(const ObjVertex& a, const ObjVertex& b, const ObjVertex& c, const float domain[3], float phongAlpha);
+
+	// Smallest odd factor at least factor, and at least 1.
+	uint32_t OddTessellationFactor(float factor);
+
+	// Tessellates every triangle with all edge and inside factors set to factor, rounded up to odd.
+	// Triangles keep the winding of the patch they come from. Patches are split across pool.
+	void TessellateMesh(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+						uint32_t factor, float phongAlpha, TessellatedMesh& out, WorkerPool& pool);
+
+	class TessellationCache
+	{
+	public:
+		// Tessellates the mesh once for every odd factor from 1 up to maxFactor rounded up to odd.
+		// Returns false, and keeps nothing, if the levels would hold more than maxVertices in all.
+		bool Build(const ObjVertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+				   float maxFactor, float phongAlpha, size_t maxVertices, WorkerPool& pool);
+		void Clear(void) { m_levels.clear(); }
+
+		size_t GetLevelCount(void) const { return m_levels.size(); }
+		const TessellatedMesh& GetLevel(size_t level) const { return m_levels[level]; }
+		// The level to draw where the hull shader would pick factor: the next odd factor up, or
+		// the finest level built.
+		size_t SelectLevel(float factor) const;
+
+	private:
+		std::vector<TessellatedMesh> m_levels;
+	};
+}
@@ -0,0 +1,151 @@
+#include "TessellationPolicy.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace DX;
+
+namespace
+{
+	const float DegreesPerRadian = 57.2957795f;
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	Vector Load(const float* base, size_t stride, uint32_t index)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(base) + stride * index);
+		Vector v = { p[0], p[1], p[2] };
+		return v;
+	}
+
+	Vector Subtract(Vector a, Vector b)
+	{
+		Vector r = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return r;
+	}
+
+	Vector Cross(Vector a, Vector b)
+	{
+		Vector r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return r;
+	}
+
+	float Dot(Vector a, Vector b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// False for vectors too short to have a direction.
+	bool Normalize(Vector& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		if (!(length > 1e-12f))
+			return false;
+		v.x /= length;
+		v.y /= length;
+		v.z /= length;
+		return true;
+	}
+
+	// Between unit vectors, in degrees.
+	float Angle(float cosine)
+	{
+		return acosf(std::min(std::max(cosine, -1.0f), 1.0f)) * DegreesPerRadian;
+	}
+
+	bool PositionLess(Vector a, Vector b)
+	{
+		if (a.x != b.x)
+			return a.x < b.x;
+		if (a.y != b.y)
+			return a.y < b.y;
+		return a.z < b.z;
+	}
+
+	bool PositionEqual(Vector a, Vector b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+}
+
+TessellationSettings DX::DefaultTessellationSettings(void)
+{
+	TessellationSettings settings = { 1.0f, 1.0f, 5.0f, 16.0f, 0.0f };
+	return settings;
+}
+
+TessellationPolicy DX::AnalyzeTessellation(const float* positions, const float* normals, size_t stride,
+										   const uint32_t* indices, size_t indexCount,
+										   const TessellationSettings& settings)
+{
+	TessellationPolicy policy = { false, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+	uint32_t vertexCount = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		vertexCount = std::max(vertexCount, indices[i] + 1);
+	}
+
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		Vector p[3];
+		Vector n[3];
+		bool shaded = true;
+		for (int k = 0; k < 3; ++k)
+		{
+			p[k] = Load(positions, stride, indices[t + k]);
+			n[k] = Load(normals, stride, indices[t + k]);
+			shaded &= Normalize(n[k]);
+		}
+		Vector face = Cross(Subtract(p[1], p[0]), Subtract(p[2], p[0]));
+		if (!shaded || !Normalize(face))
+			continue;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			// Either winding may face outwards.
+			policy.curvature = std::max(policy.curvature, Angle(fabsf(Dot(face, n[k]))));
+			policy.edgeBend = std::max(policy.edgeBend, Angle(Dot(n[k], n[(k + 1) % 3])));
+			Vector edge = Subtract(p[(k + 1) % 3], p[k]);
+			policy.edgeLength = std::max(policy.edgeLength, sqrtf(Dot(edge, edge)));
+		}
+	}
+
+	// Group the vertices by position; a group whose normals disagree is a crease.
+	std::vector<uint32_t> order(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return PositionLess(Load(positions, stride, a), Load(positions, stride, b));
+	});
+	float creaseCosine = cosf(settings.creaseAngle / DegreesPerRadian);
+	for (size_t begin = 0, end = 0; begin < order.size(); begin = end)
+	{
+		Vector position = Load(positions, stride, order[begin]);
+		Vector first = Load(normals, stride, order[begin]);
+		bool creased = false;
+		Normalize(first);
+		for (end = begin + 1; end < order.size() && PositionEqual(Load(positions, stride, order[end]), position); ++end)
+		{
+			Vector normal = Load(normals, stride, order[end]);
+			Normalize(normal);
+			creased |= Dot(first, normal) < creaseCosine;
+		}
+		policy.creases += creased ? 1 : 0;
+	}
+
+	float factor = std::min(ceilf(policy.edgeBend / settings.segmentAngle), settings.maxFactor);
+	if (policy.curvature > settings.flatAngle && policy.creases == 0 && factor > 1.0f)
+	{
+		policy.tessellate = true;
+		policy.maxFactor = factor;
+		policy.phongAlpha = settings.phongAlpha;
+	}
+	return policy;
+}
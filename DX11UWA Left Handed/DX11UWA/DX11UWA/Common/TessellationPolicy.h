@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decides at load time whether a mesh is worth tessellating. The hull and domain shaders can only
+// add detail by bending flat triangles towards their vertex normals (Phong tessellation, blended
+// in by phongAlpha, which is off by default), so a mesh gains nothing when its normals are those
+// of its faces, and tears apart along creases, where one position carries several normals. Such
+// meshes are drawn without tessellation; the others get a cap on their tessellation factors from
+// how far the normals turn along their edges.
+// This file has no Direct3D dependencies so that it can be built and profiled on any platform.
+namespace DX
+{
+	struct TessellationPolicy
+	{
+		bool tessellate;
+		float maxFactor;			// Largest edge or inside factor the hull shader may pick; 1 if flat.
+		float phongAlpha;			// How far the domain shader bends towards the normals; 0 if flat.
+		float curvature;			// Largest angle, in degrees, between a corner's normal and its face's.
+		float edgeBend;				// Largest angle, in degrees, between the normals at an edge's ends.
+		float edgeLength;			// Longest edge, in object units.
+		uint32_t creases;			// Positions whose corners disagree on the normal.
+	};
+
+	struct TessellationSettings
+	{
+		float flatAngle;			// Meshes whose normals stay this close to their faces are flat.
+		float creaseAngle;			// Normals further apart than this at one position form a crease.
+		float segmentAngle;			// The normals may turn this much along one tessellated segment.
+		float maxFactor;			// Upper bound on the factors of any mesh; hardware allows 64.
+		float phongAlpha;			// 0 keeps the tessellated surface flat; 0.75 is a typical Phong shape.
+	};
+
+	// 1 degree flat and crease angles, 5 degree segments, factors up to 16 and a shape factor of 0,
+	// so tessellation doesn't change the surface until Phong is turned on.
+	TessellationSettings DefaultTessellationSettings(void);
+
+	// positions and normals point at the first vertex's and are stride bytes apart; every three
+	// indices form a triangle.
+	TessellationPolicy AnalyzeTessellation(const float* positions, const float* normals, size_t stride,
+										   const uint32_t* indices, size_t indexCount,
+										   const TessellationSettings& settings = DefaultTessellationSettings());
+}
@@ -0,0 +1,272 @@
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DX;
+
+namespace
+{
+	inline uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+bool TexturePacker::Pack(const std::vector<PackInput>& inputs)
+{
+	m_regions.clear();
+	m_groups.clear();
+	m_stats = PackStats();
+	m_stats.inputCount = static_cast<uint32_t>(inputs.size());
+
+	bool allPacked = true;
+
+	// Textures that wrap can't share a page, so each one becomes a single slice group of its own.
+	std::vector<const PackInput*> shared;
+	for (const PackInput& in : inputs)
+	{
+		if (!in.wraps)
+		{
+			shared.push_back(&in);
+			continue;
+		}
+		if (in.width > m_settings.maxPageSize || in.height > m_settings.maxPageSize)
+		{
+			allPacked = false;
+			continue;
+		}
+
+		PackedGroup group = { in.format, in.width, in.height, 1, std::max(in.mipLevels, 1u) };
+		PackedRegion region = { in.id, static_cast<uint32_t>(m_groups.size()), 0, 0, 0, in.width, in.height, { 1.0f, 1.0f }, { 0.0f, 0.0f } };
+		m_groups.push_back(group);
+		m_regions.push_back(region);
+		m_stats.imageArea += uint64_t(in.width) * in.height;
+		m_stats.paddedArea += uint64_t(in.width) * in.height;
+	}
+
+	// Bucket the rest by format, largest side first so big images claim space before fragmentation sets in.
+	std::sort(shared.begin(), shared.end(), [](const PackInput* a, const PackInput* b)
+	{
+		if (a->format != b->format)
+			return a->format < b->format;
+		return std::max(a->width, a->height) > std::max(b->width, b->height);
+	});
+
+	size_t first = 0;
+	while (first < shared.size())
+	{
+		size_t last = first;
+		uint32_t mipLevels = UINT32_MAX;
+		while (last < shared.size() && shared[last]->format == shared[first]->format)
+		{
+			mipLevels = std::min(mipLevels, std::max(shared[last]->mipLevels, 1u));
+			++last;
+		}
+		if (!m_settings.keepMips)
+		{
+			mipLevels = 1;
+		}
+
+		// Cells, an image plus its gutter on every side, are placed at multiples of the coarsest
+		// mip's footprint and padded to one. The whole packing sits lead texels in from the page's
+		// corner, so each image's origin lands on a multiple of the footprint too and
+		// CopySubresourceRegion offsets stay exact down the whole chain.
+		const uint32_t alignment = 1u << (mipLevels - 1);
+		const uint32_t gutter = m_settings.gutter;
+		const uint32_t lead = (alignment - gutter % alignment) % alignment;
+		const uint32_t maxPageSize = m_settings.maxPageSize / alignment * alignment;
+		const uint32_t maxCellSpan = maxPageSize - AlignUp(lead, alignment);
+
+		uint64_t totalArea = 0;
+		uint32_t widest = 0;
+		for (size_t i = first; i < last; ++i)
+		{
+			uint32_t w = AlignUp(shared[i]->width + 2 * gutter, alignment);
+			uint32_t h = AlignUp(shared[i]->height + 2 * gutter, alignment);
+			if (w > maxCellSpan || h > maxCellSpan)
+				continue;	// Left out below; it mustn't widen the page for the rest.
+			totalArea += uint64_t(w) * h;
+			widest = std::max(widest, w);
+		}
+
+		// Aim for a roughly square page, but never narrower than the widest image.
+		uint32_t cellSpan = std::max(widest, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(totalArea)))));
+		cellSpan = std::min(AlignUp(cellSpan, alignment), maxCellSpan);
+		const uint32_t pageWidth = AlignUp(lead + cellSpan, alignment);
+
+		const uint32_t groupIndex = static_cast<uint32_t>(m_groups.size());
+		const size_t firstRegion = m_regions.size();
+		std::vector<Page> pages;
+
+		for (size_t i = first; i < last; ++i)
+		{
+			const PackInput& in = *shared[i];
+			uint32_t w = AlignUp(in.width + 2 * gutter, alignment);
+			uint32_t h = AlignUp(in.height + 2 * gutter, alignment);
+			if (w > cellSpan || h > maxCellSpan)
+			{
+				allPacked = false;
+				continue;
+			}
+
+			Rect placed;
+			uint32_t pageIndex = 0;
+			for (; pageIndex < pages.size(); ++pageIndex)
+			{
+				if (Insert(pages[pageIndex], w, h, placed))
+					break;
+			}
+			if (pageIndex == pages.size())
+			{
+				Page page;
+				page.freeRects.push_back({ 0, 0, cellSpan, maxCellSpan });
+				page.usedWidth = 0;
+				page.usedHeight = 0;
+				pages.push_back(page);
+				Insert(pages.back(), w, h, placed);
+			}
+
+			PackedRegion region = { in.id, groupIndex, pageIndex, lead + placed.x + gutter, lead + placed.y + gutter, in.width, in.height, { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+			m_regions.push_back(region);
+			m_stats.imageArea += uint64_t(in.width) * in.height;
+			m_stats.paddedArea += uint64_t(w) * h;
+		}
+
+		if (!pages.empty())
+		{
+			// Array slices all share one size, so trim every page to the tallest one.
+			uint32_t usedHeight = 0;
+			for (const Page& page : pages)
+			{
+				usedHeight = std::max(usedHeight, page.usedHeight);
+			}
+			const uint32_t pageHeight = AlignUp(lead + usedHeight, alignment);
+
+			PackedGroup group = { shared[first]->format, pageWidth, pageHeight, static_cast<uint32_t>(pages.size()), mipLevels };
+			m_groups.push_back(group);
+
+			for (size_t r = firstRegion; r < m_regions.size(); ++r)
+			{
+				PackedRegion& region = m_regions[r];
+				region.uvScale[0] = float(region.width) / float(pageWidth);
+				region.uvScale[1] = float(region.height) / float(pageHeight);
+				region.uvOffset[0] = float(region.x) / float(pageWidth);
+				region.uvOffset[1] = float(region.y) / float(pageHeight);
+			}
+		}
+
+		first = last;
+	}
+
+	m_stats.packedCount = static_cast<uint32_t>(m_regions.size());
+	m_stats.groupCount = static_cast<uint32_t>(m_groups.size());
+	for (const PackedGroup& group : m_groups)
+	{
+		m_stats.pageCount += group.pageCount;
+		m_stats.pageArea += uint64_t(group.pageWidth) * group.pageHeight * group.pageCount;
+	}
+	m_stats.efficiency = m_stats.pageArea ? float(double(m_stats.imageArea) / double(m_stats.pageArea)) : 0.0f;
+
+	return allPacked;
+}
+
+const PackedRegion* TexturePacker::FindRegion(uint32_t id) const
+{
+	for (const PackedRegion& region : m_regions)
+	{
+		if (region.id == id)
+			return &region;
+	}
+	return nullptr;
+}
+
+// Best short side fit: pick the free rectangle that leaves the smallest leftover on its shorter side.
+bool TexturePacker::Insert(Page& page, uint32_t w, uint32_t h, Rect& placed) const
+{
+	uint32_t bestShort = UINT32_MAX;
+	uint32_t bestLong = UINT32_MAX;
+	const Rect* best = nullptr;
+
+	for (const Rect& free : page.freeRects)
+	{
+		if (free.w < w || free.h < h)
+			continue;
+
+		uint32_t leftoverW = free.w - w;
+		uint32_t leftoverH = free.h - h;
+		uint32_t shortSide = std::min(leftoverW, leftoverH);
+		uint32_t longSide = std::max(leftoverW, leftoverH);
+		if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+		{
+			bestShort = shortSide;
+			bestLong = longSide;
+			best = &free;
+		}
+	}
+
+	if (!best)
+		return false;
+
+	placed = { best->x, best->y, w, h };
+	SplitFreeRects(page, placed);
+	PruneFreeRects(page);
+
+	page.usedWidth = std::max(page.usedWidth, placed.x + w);
+	page.usedHeight = std::max(page.usedHeight, placed.y + h);
+	return true;
+}
+
+void TexturePacker::SplitFreeRects(Page& page, const Rect& used)
+{
+	std::vector<Rect> result;
+	result.reserve(page.freeRects.size() + 4);
+
+	for (const Rect& free : page.freeRects)
+	{
+		bool overlaps = used.x < free.x + free.w && used.x + used.w > free.x &&
+						used.y < free.y + free.h && used.y + used.h > free.y;
+		if (!overlaps)
+		{
+			result.push_back(free);
+			continue;
+		}
+
+		// Keep up to four maximal rectangles around the used area.
+		if (used.x > free.x)
+			result.push_back({ free.x, free.y, used.x - free.x, free.h });
+		if (used.x + used.w < free.x + free.w)
+			result.push_back({ used.x + used.w, free.y, free.x + free.w - (used.x + used.w), free.h });
+		if (used.y > free.y)
+			result.push_back({ free.x, free.y, free.w, used.y - free.y });
+		if (used.y + used.h < free.y + free.h)
+			result.push_back({ free.x, used.y + used.h, free.w, free.y + free.h - (used.y + used.h) });
+	}
+
+	page.freeRects.swap(result);
+}
+
+// Removes free rectangles that are fully contained in another one.
+void TexturePacker::PruneFreeRects(Page& page)
+{
+	std::vector<Rect>& rects = page.freeRects;
+	for (size_t i = 0; i < rects.size(); ++i)
+	{
+		for (size_t j = i + 1; j < rects.size(); ++j)
+		{
+			const Rect& a = rects[i];
+			const Rect& b = rects[j];
+			if (a.x >= b.x && a.y >= b.y && a.x + a.w <= b.x + b.w && a.y + a.h <= b.y + b.h)
+			{
+				rects.erase(rects.begin() + i);
+				--i;
+				break;
+			}
+			if (b.x >= a.x && b.y >= a.y && b.x + b.w <= a.x + a.w && b.y + b.h <= a.y + a.h)
+			{
+				rects.erase(rects.begin() + j);
+				--j;
+			}
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Packs textures into shared atlas pages so that several materials can be drawn
+// from one Texture2DArray without rebinding shader resources between draws.
+// This file has no Direct3D dependencies so that it can be built and profiled
+// on any platform.
+namespace DX
+{
+	// One texture submitted to the packer.
+	struct PackInput
+	{
+		uint32_t id;        // Caller supplied, returned unchanged in PackedRegion.
+		uint32_t width;
+		uint32_t height;
+		uint32_t format;    // Only textures with the same format can share a page (usually a DXGI_FORMAT).
+		uint32_t mipLevels;
+		bool     wraps;     // True if the material samples outside [0,1] and needs a page of its own.
+	};
+
+	// Where a texture landed. x/y/width/height describe the image itself, without the gutter.
+	struct PackedRegion
+	{
+		uint32_t id;
+		uint32_t group;     // Index into TexturePacker::GetGroups().
+		uint32_t page;      // Array slice inside the group.
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+		float    uvScale[2];
+		float    uvOffset[2];
+	};
+
+	// A set of pages that share a format and page size, i.e. one Texture2DArray.
+	struct PackedGroup
+	{
+		uint32_t format;
+		uint32_t pageWidth;
+		uint32_t pageHeight;
+		uint32_t pageCount;
+		uint32_t mipLevels;
+	};
+
+	struct AtlasSettings
+	{
+		uint32_t maxPageSize = 16384; // D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION.
+		uint32_t gutter = 4;          // Texels of edge replication around each image.
+		bool     keepMips = true;     // Align placements so every mip of every image stays on texel boundaries.
+	};
+
+	struct PackStats
+	{
+		uint32_t inputCount = 0;
+		uint32_t packedCount = 0;
+		uint32_t groupCount = 0;
+		uint32_t pageCount = 0;
+		uint64_t imageArea = 0;       // Texels of actual image data.
+		uint64_t paddedArea = 0;      // Image area plus gutters and alignment.
+		uint64_t pageArea = 0;        // Texels allocated across all pages.
+		float    efficiency = 0.0f;   // imageArea / pageArea.
+	};
+
+	// MaxRects packer (best short side fit) with gutter and mip alignment.
+	class TexturePacker
+	{
+	public:
+		TexturePacker(const AtlasSettings& settings = AtlasSettings()) : m_settings(settings) {}
+
+		// Packs every input. Returns false if an input is larger than a page can hold,
+		// in which case that input is left out of the regions.
+		bool Pack(const std::vector<PackInput>& inputs);
+
+		const std::vector<PackedRegion>& GetRegions(void) const { return m_regions; }
+		const std::vector<PackedGroup>& GetGroups(void) const { return m_groups; }
+		const PackStats& GetStats(void) const { return m_stats; }
+		const PackedRegion* FindRegion(uint32_t id) const;
+
+	private:
+		struct Rect
+		{
+			uint32_t x, y, w, h;
+		};
+
+		struct Page
+		{
+			std::vector<Rect> freeRects;
+			uint32_t usedWidth;
+			uint32_t usedHeight;
+		};
+
+		bool Insert(Page& page, uint32_t w, uint32_t h, Rect& placed) const;
+		static void SplitFreeRects(Page& page, const Rect& used);
+		static void PruneFreeRects(Page& page);
+
+		AtlasSettings             m_settings;
+		std::vector<PackedRegion> m_regions;
+		std::vector<PackedGroup>  m_groups;
+		PackStats                 m_stats;
+	};
+}
@@ -0,0 +1,193 @@
+#include "TextureResidency.h"
+
+using namespace DX;
+
+TextureResidency::TextureResidency(uint64_t budgetBytes) :
+	m_frame(1)
+{
+	m_stats.budgetBytes = budgetBytes;
+}
+
+uint32_t TextureResidency::Register(const uint64_t* mipBytes, uint32_t mipCount)
+{
+	if (mipCount == 0)
+		return InvalidHandle;
+
+	uint32_t handle;
+	if (!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<uint32_t>(m_textures.size());
+		m_textures.push_back(Texture());
+	}
+
+	Texture& texture = m_textures[handle];
+	texture.mipBytes.assign(mipBytes, mipBytes + mipCount);
+	texture.lastUsed.assign(mipCount, m_frame);
+	texture.residentMip = 0;
+	texture.requestedMip = mipCount;
+	texture.live = true;
+	texture.changed = false;
+
+	UpdateTotals();
+	return handle;
+}
+
+void TextureResidency::Unregister(uint32_t handle)
+{
+	if (handle >= m_textures.size() || !m_textures[handle].live)
+		return;
+
+	m_textures[handle] = Texture();
+	m_textures[handle].live = false;
+	m_freeHandles.push_back(handle);
+	UpdateTotals();
+}
+
+void TextureResidency::Clear(void)
+{
+	m_textures.clear();
+	m_freeHandles.clear();
+	UpdateTotals();
+}
+
+void TextureResidency::Touch(uint32_t handle, uint32_t finestMip)
+{
+	if (handle >= m_textures.size() || !m_textures[handle].live)
+		return;
+
+	Texture& texture = m_textures[handle];
+	uint32_t mipCount = static_cast<uint32_t>(texture.mipBytes.size());
+	if (finestMip >= mipCount)
+		finestMip = mipCount - 1;
+
+	for (uint32_t mip = finestMip; mip < mipCount; ++mip)
+	{
+		texture.lastUsed[mip] = m_frame;
+	}
+	if (finestMip < texture.requestedMip)
+		texture.requestedMip = finestMip;
+}
+
+void TextureResidency::EndFrame(std::vector<ResidencyChange>& changes)
+{
+	m_stats.evictionsThisFrame = 0;
+	m_stats.restoresThisFrame = 0;
+
+	// Restore mips that were asked for this frame, one level at a time, as long as room can be
+	// made by evicting only mips that weren't sampled this frame.
+	for (Texture& texture : m_textures)
+	{
+		if (!texture.live)
+			continue;
+
+		while (texture.requestedMip < texture.residentMip)
+		{
+			uint64_t needed = texture.mipBytes[texture.residentMip - 1];
+			while (m_stats.residentBytes + needed > m_stats.budgetBytes && EvictOne(m_frame))
+			{
+			}
+			if (m_stats.residentBytes + needed > m_stats.budgetBytes)
+				break;
+
+			--texture.residentMip;
+			m_stats.residentBytes += needed;
+			++m_stats.residentMips;
+			++m_stats.restoresThisFrame;
+			texture.changed = true;
+		}
+	}
+
+	// Then enforce the budget against everything, oldest first.
+	while (m_stats.residentBytes > m_stats.budgetBytes && EvictOne(m_frame + 1))
+	{
+	}
+
+	for (uint32_t handle = 0; handle < m_textures.size(); ++handle)
+	{
+		Texture& texture = m_textures[handle];
+		if (texture.live)
+		{
+			if (texture.changed)
+			{
+				ResidencyChange change = { handle, texture.residentMip };
+				changes.push_back(change);
+				texture.changed = false;
+			}
+			texture.requestedMip = static_cast<uint32_t>(texture.mipBytes.size());
+		}
+	}
+
+	m_stats.evictions += m_stats.evictionsThisFrame;
+	m_stats.restores += m_stats.restoresThisFrame;
+	++m_frame;
+}
+
+// Drops the finest resident mip of whichever texture sampled it longest ago, preferring the
+// larger mip on ties. Only mips last used before olderThan are candidates, and the coarsest
+// mip of a texture is never evicted.
+bool TextureResidency::EvictOne(uint64_t olderThan)
+{
+	Texture* victim = nullptr;
+	uint64_t victimUsed = 0;
+	uint64_t victimBytes = 0;
+
+	for (Texture& texture : m_textures)
+	{
+		if (!texture.live || texture.residentMip + 1 >= texture.mipBytes.size())
+			continue;
+
+		uint64_t used = texture.lastUsed[texture.residentMip];
+		uint64_t bytes = texture.mipBytes[texture.residentMip];
+		if (used >= olderThan)
+			continue;
+
+		if (!victim || used < victimUsed || (used == victimUsed && bytes > victimBytes))
+		{
+			victim = &texture;
+			victimUsed = used;
+			victimBytes = bytes;
+		}
+	}
+
+	if (!victim)
+		return false;
+
+	m_stats.residentBytes -= victimBytes;
+	--m_stats.residentMips;
+	++victim->residentMip;
+	++m_stats.evictionsThisFrame;
+	victim->changed = true;
+	return true;
+}
+
+void TextureResidency::UpdateTotals(void)
+{
+	m_stats.residentBytes = 0;
+	m_stats.totalBytes = 0;
+	m_stats.textureCount = 0;
+	m_stats.residentMips = 0;
+	m_stats.totalMips = 0;
+
+	for (const Texture& texture : m_textures)
+	{
+		if (!texture.live)
+			continue;
+
+		++m_stats.textureCount;
+		for (uint32_t mip = 0; mip < texture.mipBytes.size(); ++mip)
+		{
+			m_stats.totalBytes += texture.mipBytes[mip];
+			++m_stats.totalMips;
+			if (mip >= texture.residentMip)
+			{
+				m_stats.residentBytes += texture.mipBytes[mip];
+				++m_stats.residentMips;
+			}
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Tracks how many bytes of texture memory each mip level occupies and keeps the total under
+// a budget by dropping the least recently sampled fine mips. Only the policy lives here: the
+// renderer applies the resulting residency with ID3D11DeviceContext::SetResourceMinLOD, which
+// keeps this code free of Direct3D so it can be driven by a recorded access trace anywhere.
+namespace DX
+{
+	struct ResidencyStats
+	{
+		uint64_t budgetBytes = 0;
+		uint64_t residentBytes = 0;   // Bytes of the mips currently kept resident.
+		uint64_t totalBytes = 0;      // Bytes if every mip of every texture were resident.
+		uint32_t textureCount = 0;
+		uint32_t residentMips = 0;
+		uint32_t totalMips = 0;
+		uint32_t evictionsThisFrame = 0;
+		uint32_t restoresThisFrame = 0;
+		uint64_t evictions = 0;
+		uint64_t restores = 0;
+	};
+
+	// Reported when a texture's finest resident mip changes.
+	struct ResidencyChange
+	{
+		uint32_t handle;
+		uint32_t residentMip;
+	};
+
+	class TextureResidency
+	{
+	public:
+		static const uint32_t InvalidHandle = 0xffffffff;
+
+		explicit TextureResidency(uint64_t budgetBytes = 256ull * 1024 * 1024);
+
+		void SetBudget(uint64_t budgetBytes) { m_stats.budgetBytes = budgetBytes; }
+
+		// mipBytes[i] is the size of mip i summed over every array slice or cube face.
+		// New textures start fully resident.
+		uint32_t Register(const uint64_t* mipBytes, uint32_t mipCount);
+		void Unregister(uint32_t handle);
+		void Clear(void);
+
+		// Records that a texture was sampled this frame, needing mips finestMip and coarser.
+		void Touch(uint32_t handle, uint32_t finestMip = 0);
+
+		// Ends the frame: brings requested mips back while they fit, then evicts least recently
+		// sampled mips until the budget holds. Changed textures are appended to changes.
+		void EndFrame(std::vector<ResidencyChange>& changes);
+
+		uint32_t GetResidentMip(uint32_t handle) const { return m_textures[handle].residentMip; }
+		const ResidencyStats& GetStats(void) const { return m_stats; }
+
+	private:
+		struct Texture
+		{
+			std::vector<uint64_t> mipBytes;
+			std::vector<uint64_t> lastUsed;   // Frame each mip was last sampled.
+			uint32_t residentMip;             // Finest resident mip; coarser ones are always resident.
+			uint32_t requestedMip;            // Finest mip sampled this frame, or mip count if untouched.
+			bool     live;
+			bool     changed;
+		};
+
+		bool EvictOne(uint64_t olderThan);
+		void UpdateTotals(void);
+
+		std::vector<Texture>  m_textures;
+		std::vector<uint32_t> m_freeHandles;
+		uint64_t              m_frame;
+		ResidencyStats        m_stats;
+	};
+}
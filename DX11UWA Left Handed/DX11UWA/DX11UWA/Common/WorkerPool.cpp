@@ -0,0 +1,135 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace DX;
+
+namespace
+{
+	thread_local bool t_insideWorker = false;
+}
+
+WorkerPool::WorkerPool(unsigned int threadCount) :
+	m_next(0),
+	m_pending(0),
+	m_active(0),
+	m_generation(0),
+	m_quit(false)
+{
+	m_job.fn = nullptr;
+	m_job.count = 0;
+	m_job.grain = 1;
+
+	if (threadCount == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		m_threads.emplace_back(&WorkerPool::WorkerMain, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+WorkerPool& WorkerPool::Shared(void)
+{
+	static WorkerPool pool;
+	return pool;
+}
+
+void WorkerPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+
+	// Small loops, nested loops and single-threaded pools don't pay for the hand-off.
+	if (t_insideWorker || m_threads.empty() || count <= grain)
+	{
+		for (size_t begin = 0; begin < count; begin += grain)
+		{
+			fn(begin, std::min(begin + grain, count));
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(m_submitLock);
+	Job job = { &fn, count, grain };
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_job = job;
+		m_pending = (count + grain - 1) / grain;
+		m_next = 0;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	t_insideWorker = true;
+	RunChunks(job);
+	t_insideWorker = false;
+
+	// Wait for the last chunk and for every worker to leave the job before fn goes out of scope.
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_done.wait(lock, [this]() { return m_pending == 0 && m_active == 0; });
+	m_job.fn = nullptr;
+}
+
+void WorkerPool::WorkerMain(void)
+{
+	t_insideWorker = true;
+	unsigned long long seen = 0;
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_wake.wait(lock, [&]() { return m_quit || (m_generation != seen && m_job.fn); });
+			if (m_quit)
+				return;
+			seen = m_generation;
+			job = m_job;
+			++m_active;
+		}
+
+		RunChunks(job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			--m_active;
+		}
+		m_done.notify_all();
+	}
+}
+
+void WorkerPool::RunChunks(const Job& job)
+{
+	for (;;)
+	{
+		size_t begin = m_next.fetch_add(job.grain);
+		if (begin >= job.count)
+			return;
+
+		(*job.fn)(begin, std::min(begin + job.grain, job.count));
+
+		if (m_pending.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_done.notify_all();
+		}
+	}
+}
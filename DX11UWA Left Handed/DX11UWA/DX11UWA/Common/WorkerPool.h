@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+	// A fixed set of worker threads for data-parallel loops on the CPU side of the renderer.
+	// Only one ParallelFor runs at a time; a ParallelFor issued from inside a worker runs inline.
+	class WorkerPool
+	{
+	public:
+		// threadCount == 0 uses one worker per hardware thread, minus the calling thread.
+		explicit WorkerPool(unsigned int threadCount = 0);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		// Number of threads that execute work, including the calling thread.
+		unsigned int GetConcurrency(void) const { return static_cast<unsigned int>(m_threads.size()) + 1; }
+
+		// Splits [0, count) into chunks of at most grain items and calls fn(begin, end) for each one.
+		// The calling thread helps out and the call returns once every chunk has finished.
+		void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+		// Process-wide pool shared by the loaders and per-frame passes.
+		static WorkerPool& Shared(void);
+
+	private:
+		struct Job
+		{
+			const std::function<void(size_t, size_t)>* fn;
+			size_t count;
+			size_t grain;
+		};
+
+		void WorkerMain(void);
+		void RunChunks(const Job& job);
+
+		std::vector<std::thread>	m_threads;
+		std::mutex					m_submitLock;
+		std::mutex					m_lock;
+		std::condition_variable		m_wake;
+		std::condition_variable		m_done;
+
+		Job							m_job;
+		std::atomic<size_t>			m_next;
+		std::atomic<size_t>			m_pending;
+		unsigned int				m_active;
+		unsigned long long			m_generation;
+		bool						m_quit;
+	};
+}
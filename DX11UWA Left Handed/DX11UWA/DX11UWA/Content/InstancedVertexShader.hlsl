@@ -1,18 +1,22 @@
 // A constant buffer that stores the three basic column-major matrices for composing geometry.
-cbuffer ModelViewProjectionConstantBufferInstanced : register(b0)
+// The model matrix is unused here; each instance brings its own world transform.
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
 {
-	matrix model[3];
+	matrix model;
 	matrix view;
 	matrix projection;
 };
 
-// Per-vertex data used as input to the vertex shader.
+// Per-vertex data used as input to the vertex shader, followed by the per-instance data: the
+// first three columns of the instance's object-to-world matrix, translation in w.
 struct VertexShaderInput
 {
 	float3 pos : POSITION;
 	float3 uv : UV;
 	float3 normal : NORMAL;
-	
+	float4 world0 : INSTANCE0;
+	float4 world1 : INSTANCE1;
+	float4 world2 : INSTANCE2;
 };
 
 struct GSOutput
@@ -24,22 +28,20 @@ struct GSOutput
 };
 
 // Simple shader to do vertex processing on the GPU.
-//SV_InstancedID
-GSOutput main(VertexShaderInput input, uint id : SV_InstanceID)
+GSOutput main(VertexShaderInput input)
 {
 	GSOutput output;
 	float4 pos = float4(input.pos, 1.0f);
-	float4 normals = float4(input.normal, 0.0f);
 
 	// Transform the vertex position into projected space.
-	pos = mul(pos, model[id]);
-	output.world_pos = pos;
+	pos = float4(dot(pos, input.world0), dot(pos, input.world1), dot(pos, input.world2), 1.0f);
+	output.world_pos = pos.xyz;
 	pos = mul(pos, view);
 	pos = mul(pos, projection);
 	output.pos = pos;
 
 	// Pass the color through without modification.
 	output.uv = input.uv;
-	output.normal = mul(normals, model[id]);
+	output.normal = float3(dot(input.normal, input.world0.xyz), dot(input.normal, input.world1.xyz), dot(input.normal, input.world2.xyz));
 	return output;
 }
@@ -1,20 +1,34 @@
-Texture2D baseTexture : register(t0);
+// Permutation switches, 0 or 1, named in DX::LightPermutationFeature. A variant defines the ones
+// it leaves out to 0 and includes this file; on its own this file is the variant with everything.
+#ifndef LIGHT_ALPHA_TEST
+#define LIGHT_ALPHA_TEST 1
+#endif
+#ifndef LIGHT_TEXTURE
+#define LIGHT_TEXTURE 1
+#endif
+#ifndef LIGHT_DIRECTIONAL
+#define LIGHT_DIRECTIONAL 1
+#endif
+#ifndef LIGHT_POINT
+#define LIGHT_POINT 1
+#endif
+#ifndef LIGHT_SPOT
+#define LIGHT_SPOT 1
+#endif
+
+Texture2DArray baseTexture : register(t0); // material atlas, uv.z selects the page
 sampler filters : register(s0);
 
 
 // Per-pixel color data passed through the pixel shader.
+// Same layout as DX::PackedLight.
 struct Light
 {
-    float4 Position; //16
-    float4 Direction; //16
-    float4 radius;
-    float4 Color; //16
-    float4 AttenuationData;
-    float4 LightTypeEnabled;		
-    float4 ConeRatio; // x = inner ratio,  y = outerratio	
-    float4 coneAngle;
-									
-};       
+    float4 PositionRadius;  // xyz = world position, w = range of point and spot lights
+    float4 Color;
+    float4 DirectionInner;  // xyz = where a directional or spot light shines, w = inner cone cosine
+    float4 Parameters;      // x = outer cone cosine, y = type, z = 1 if enabled
+};
 
 struct DS_OUTPUT
 {
@@ -28,28 +42,51 @@ cbuffer LightProperties : register(b0)
 {
 	float4 EyePosition;                 
 	float4 GlobalAmbient;               
-	Light Lights[3];           
-};                       
+	Light Directional;
+};
+
+// Point and spot lights, assigned to the clusters of the view frustum on the CPU (LightGrid).
+// Each light is four float4s laid out like Light; each cluster holds an offset and a count into
+// LightIndices. The directional light reaches every pixel and stays in LightProperties.
+Buffer<float4> ClusterLights : register(t1);
+Buffer<uint2> ClusterRanges : register(t2);
+Buffer<uint> LightIndices : register(t3);
+
+cbuffer LightGrid : register(b1)
+{
+	uint4 GridSize;				// Tiles across and down, depth slices, tile size in pixels.
+	float4 SliceParameters;		// log2(view depth) * x + y is the depth slice.
+};
+
+Light LoadLight(uint index)
+{
+	Light light;
+	light.PositionRadius = ClusterLights[index * 4 + 0];
+	light.Color = ClusterLights[index * 4 + 1];
+	light.DirectionInner = ClusterLights[index * 4 + 2];
+	light.Parameters = ClusterLights[index * 4 + 3];
+	return light;
+}
 
 float Attenuation(Light light, DS_OUTPUT input)
 {
 	
-	return 1.0f - saturate(length(light.Position.xyz - input.world_pos.xyz) / light.radius.x);
+	return 1.0f - saturate(length(light.PositionRadius.xyz - input.world_pos.xyz) / light.PositionRadius.w);
 }
 
 float SpotlightAttenuation(Light light, DS_OUTPUT input)
 {
 	float ans;
-    float3 lightdir = normalize(light.Position.xyz - input.world_pos.xyz);
-    float surfaceratio = saturate(dot(-lightdir, normalize(light.coneAngle.xyz)));
-	ans = 1 - saturate((light.ConeRatio.x - surfaceratio)/(light.ConeRatio.x - light.ConeRatio.y));
+    float3 lightdir = normalize(light.PositionRadius.xyz - input.world_pos.xyz);
+    float surfaceratio = saturate(dot(-lightdir, normalize(light.DirectionInner.xyz)));
+	ans = 1 - saturate((light.DirectionInner.w - surfaceratio)/(light.DirectionInner.w - light.Parameters.x));
 	return ans;
 }
 
 float4 PointLight(Light light, DS_OUTPUT input)
 {
 	float4 result;
-    float3 lightdir = normalize(light.Position.xyz - input.world_pos.xyz);
+    float3 lightdir = normalize(light.PositionRadius.xyz - input.world_pos.xyz);
 	float  lightratio = saturate(dot(lightdir,input.normal));
 
 	result = lightratio * light.Color;
@@ -61,9 +98,9 @@ float4 DirectionalLight(Light light, DS_OUTPUT input)
 {
 	
 	float4 result;
-	float3 lightdir = normalize(light.Direction);
-	float lightratio = saturate(dot(-lightdir, input.normal));
-	result = lightratio * light.Color;
+	float3 lightdir = normalize(light.DirectionInner.xyz);
+	float lightratio = saturate(dot(-lightdir, input.normal.xyz));
+	result = lightratio * light.Color * light.Parameters.z;
 
 	return result;
 }
@@ -72,9 +109,9 @@ float4 SpotLight(Light light, DS_OUTPUT input)
 {
 	float4 result;
 	
-    float3 lightdir = normalize(light.Position.xyz - input.world_pos.xyz);
-	float surfaceratio = saturate(dot(-lightdir, normalize(light.coneAngle.xyz)));
-	float spotFactor = (surfaceratio > light.ConeRatio.y) ? 1 : 0;
+    float3 lightdir = normalize(light.PositionRadius.xyz - input.world_pos.xyz);
+	float surfaceratio = saturate(dot(-lightdir, normalize(light.DirectionInner.xyz)));
+	float spotFactor = (surfaceratio > light.Parameters.x) ? 1 : 0;
 	float lightratio = saturate(dot(lightdir, input.normal.xyz));
 
 	result = spotFactor * lightratio * light.Color;
@@ -86,19 +123,41 @@ float4 SpotLight(Light light, DS_OUTPUT input)
 // A pass-through function for the (interpolated) color data.
 float4 main(DS_OUTPUT input) : SV_TARGET
 {
+#if LIGHT_TEXTURE
     float4 baseColor = baseTexture.Sample(filters, input.uv);
+#else
+    float4 baseColor = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+#if LIGHT_ALPHA_TEST && LIGHT_TEXTURE
     if (baseColor.a < 0.5f)
     {
         discard;
     }
+#endif
     
-    float4 dirColor = DirectionalLight(Lights[0], input) * baseColor;
-    float4 spotColor = SpotLight(Lights[2], input) * baseColor;
-
-    float4 pointcolor = PointLight(Lights[1], input) * baseColor;
-   
-
-   
+    float4 color = float4(0.0f, 0.0f, 0.0f, 0.0f);
+#if LIGHT_DIRECTIONAL
+    color += DirectionalLight(Directional, input) * baseColor;
+#endif
+
+#if LIGHT_POINT || LIGHT_SPOT
+    // pos.w is the pixel's view-space depth.
+    uint slice = (uint)clamp(log2(input.pos.w) * SliceParameters.x + SliceParameters.y, 0.0f, GridSize.z - 1.0f);
+    uint2 tile = min((uint2)input.pos.xy / GridSize.w, GridSize.xy - 1);
+    uint2 range = ClusterRanges[(slice * GridSize.y + tile.y) * GridSize.x + tile.x];
+    for (uint i = 0; i < range.y; ++i)
+    {
+        Light light = LoadLight(LightIndices[range.x + i]);
+#if LIGHT_POINT && LIGHT_SPOT
+        float4 lit = light.Parameters.y == 2 ? SpotLight(light, input) : PointLight(light, input);
+#elif LIGHT_SPOT
+        float4 lit = SpotLight(light, input);
+#else
+        float4 lit = PointLight(light, input);
+#endif
+        color += lit * baseColor;
+    }
+#endif
 
-	return saturate(dirColor + spotColor + pointcolor);
+	return saturate(color);
 }
@@ -0,0 +1,5 @@
+// LightPixelShader for frames without local lights in view: only the directional light,
+// and no cluster lookup at all.
+#define LIGHT_POINT 0
+#define LIGHT_SPOT 0
+#include "LightPixelShader.hlsl"
@@ -0,0 +1,5 @@
+// LightPixelShaderDirectional without the alpha test.
+#define LIGHT_ALPHA_TEST 0
+#define LIGHT_POINT 0
+#define LIGHT_SPOT 0
+#include "LightPixelShader.hlsl"
@@ -0,0 +1,4 @@
+// LightPixelShader without the alpha test, for materials whose texture never drops below
+// the cutoff. Leaving out the discard lets the hardware keep early depth testing on.
+#define LIGHT_ALPHA_TEST 0
+#include "LightPixelShader.hlsl"
@@ -0,0 +1,4 @@
+// LightPixelShader for frames whose clusters hold no spot lights: the cluster loop shades
+// every light as a point light, without branching on the type.
+#define LIGHT_SPOT 0
+#include "LightPixelShader.hlsl"
@@ -0,0 +1,4 @@
+// LightPixelShaderPoint without the alpha test.
+#define LIGHT_ALPHA_TEST 0
+#define LIGHT_SPOT 0
+#include "LightPixelShader.hlsl"
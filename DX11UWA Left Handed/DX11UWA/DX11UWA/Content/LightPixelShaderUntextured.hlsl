@@ -0,0 +1,5 @@
+// LightPixelShader for lit draws without a material: the base color is white, so there is
+// nothing to sample and nothing to alpha test.
+#define LIGHT_ALPHA_TEST 0
+#define LIGHT_TEXTURE 0
+#include "LightPixelShader.hlsl"
@@ -0,0 +1,37 @@
+// Vertex shader for the lit meshes that aren't worth tessellating (see Common/TessellationPolicy.h).
+// Produces what DomainShader does for the tessellated ones, so the same pixel shaders follow.
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+};
+
+// Per-vertex data used as input to the vertex shader.
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 uv : UV;
+	float3 normal : NORMAL;
+};
+
+// Same layout as DomainShader's output.
+struct DS_OUTPUT
+{
+	float4 pos : SV_POSITION;
+	float3 uv : UV;
+	float4 normal : NORMAL;
+	float3 world_pos : WORLDPOS;
+};
+
+DS_OUTPUT main(VertexShaderInput input)
+{
+	DS_OUTPUT output;
+	float4 pos = mul(float4(input.pos, 1.0f), model);
+	output.world_pos = pos.xyz;
+	pos = mul(pos, view);
+	output.pos = mul(pos, projection);
+	output.normal = mul(float4(input.normal, 0.0f), model);
+	output.uv = input.uv;
+	return output;
+}
@@ -8,18 +8,23 @@ using namespace DX11UWA;
 using namespace DirectX;
 using namespace Windows::Foundation;
 
+// SceneRenderer fills the same constant buffer layouts the shaders declare.
+static_assert(sizeof(DX::SceneConstants) == sizeof(ModelViewProjectionConstantBuffer), "SceneConstants must match ModelViewProjectionConstantBuffer");
+
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
 Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
 	m_loadingComplete(false),
 	m_degreesPerSecond(45),
-	m_indexCount(0),
 	m_tracking(false),
+	m_viewportChanged(false),
+	m_sceneRotation(0.0f),
 	m_deviceResources(deviceResources)
 {
 	memset(m_kbuttons, 0, sizeof(m_kbuttons));
 	m_currMousePos = nullptr;
 	m_prevMousePos = nullptr;
 	memset(&m_camera, 0, sizeof(XMFLOAT4X4));
+	memset(&m_viewport, 0, sizeof(m_viewport));
 
 	CreateDeviceDependentResources();
 	CreateWindowSizeDependentResources();
@@ -44,15 +49,18 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources(void)
 	// This post-multiplication step is required for any draw calls that are
 	// made to the swap chain render target. For draw calls to other targets,
 	// this transform should not be applied.
-
-	// This sample makes use of a right-handed coordinate system using row-major matrices.
-	XMMATRIX perspectiveMatrix = XMMatrixPerspectiveFovLH(fovAngleY, aspectRatio, 0.01f, 100.0f);
-
 	XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
 
-	XMMATRIX orientationMatrix = XMLoadFloat4x4(&orientation);
-
-	XMStoreFloat4x4(&m_constantBufferData.projection, XMMatrixTranspose(perspectiveMatrix * orientationMatrix));
+	// The light grid's clusters are laid out in render target pixels, which the orientation transform
+	// maps to; the screen viewport covers the whole render target.
+	D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+	m_viewport.fovAngleY = fovAngleY;
+	m_viewport.aspectRatio = aspectRatio;
+	memcpy(m_viewport.orientation, &orientation, sizeof(m_viewport.orientation));
+	m_viewport.targetWidth = static_cast<uint32>(viewport.Width);
+	m_viewport.targetHeight = static_cast<uint32>(viewport.Height);
+	m_viewport.outputHeight = outputSize.Height;
+	m_viewportChanged = true;
 
 	// Eye is at (0,0.7,1.5), looking at point (0,-0.1,0) with the up-vector along the y-axis.
 	static const XMVECTORF32 eye = { 0.0f, 0.7f, -1.5f, 0.0f };
@@ -60,10 +68,9 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources(void)
 	static const XMVECTORF32 up = { 0.0f, 1.0f, 0.0f, 0.0f };
 
 	XMStoreFloat4x4(&m_camera, XMMatrixInverse(nullptr, XMMatrixLookAtLH(eye, at, up)));
-	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixLookAtLH(eye, at, up)));
 }
 
-// Called once per frame, rotates the cube and calculates the model and view matrices.
+// Called once per frame, moves the camera and hands it to the scene with the clock its lights follow.
 void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
 {
 	if (!m_tracking)
@@ -80,135 +87,29 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
 	// Update or move camera here
 	UpdateCamera(timer, 10.0f, 0.75f);
 
-	XMStoreFloat4(&m_LightProperties.EyePosition, XMVectorSet(m_camera._41, m_camera._42, m_camera._43, 1.0f));
-
-	m_skyBoxBufferData.view = m_constantBufferData.view;
-	m_skyBoxBufferData.projection = m_constantBufferData.projection;
-	XMStoreFloat4x4(&m_skyBoxBufferData.model, XMMatrixTranspose(XMMatrixTranslation(m_camera._41, m_camera._42, m_camera._43)));
-
-	for (int i = 0; i < numLights; ++i)
+	// Loading is asynchronous. Only touch the scene after it's loaded.
+	if (!m_loadingComplete)
 	{
-		Light light;
-		XMFLOAT4 LightPosition;
-		memset(&light, 0, sizeof(Light));
-		light.LightTypeEnabled.y = LightEnabled[i];
-		light.LightTypeEnabled.x = i;
-		light.Color = XMFLOAT4(LightColors[i]);
-		light.AttenuationData.x = XMConvertToRadians(45.0f);
-		light.AttenuationData.y = 1.0f;
-		light.AttenuationData.z = 2.0f;
-		light.AttenuationData.w = 0.0f;
-
-		//Directional light location
-		if (i == 0)
-		{
-			if (dirLightSwitch)
-			{
-				directionalLightPos.x += .5;
-				if (directionalLightPos.x >= 15)
-				{
-					dirLightSwitch = false;
-				}
-			}
-			else
-			{
-				directionalLightPos.x -= .5;
-				if (directionalLightPos.x <= -15)
-				{
-					dirLightSwitch = true;
-				}
-			}
-
-			LightPosition = directionalLightPos;
-		}
-
-		//point light location
-		if (i == 1)
-		{
-			if (pointLightSwitch)
-			{
-				pointLightPos.x += .2f;
-				if (pointLightPos.x >= 10)
-				{
-					pointLightSwitch = false;
-				}
-			}
-			else
-			{
-				pointLightPos.x -= .2f;
-				if (pointLightPos.x <= -10)
-				{
-					pointLightSwitch = true;
-				}
-			}
-			LightPosition = pointLightPos;
-		}
-
-		//Spot Light Information
-		if (i == 2) // Spot light Location
-		{
-			if (spotLightSwitch)
-			{
-				spotPos.z += .1f;
-				XMStoreFloat4(&light.coneAngle, XMVectorSet(coneAng.x, coneAng.y, coneAng.z + 1.0f, 0.0f));
-				if (spotPos.z >= 2)
-				{
-					spotLightSwitch = false;
-				}
-			}
-			else
-			{
-				spotPos.z -= .1f;
-				XMStoreFloat4(&light.coneAngle, XMVectorSet(coneAng.x, coneAng.y, coneAng.z - 1.0f, 0.0f));
-				if (spotPos.z <= -2)
-				{
-					spotLightSwitch = true;
-				}
-			}
-			LightPosition = spotPos;
-		}
-
-		light.radius.x = spotRad;
-		light.ConeRatio.x = innerConeRat;
-		light.ConeRatio.y = outterConeRat;
-		
-		light.Position = LightPosition;
-		XMVECTOR LightDirection = XMVectorSet(-LightPosition.x, -LightPosition.y, -LightPosition.z, 0.0f);
-		LightDirection = XMVector3Normalize(LightDirection);
-		XMStoreFloat4(&light.Direction, LightDirection);
-
-		m_LightProperties.Lights[i] = light;
-
+		return;
 	}
 
-	//m_d3dDeviceContext->UpdateSubresource(m_d3dLightPropertiesConstantBuffer.Get(), 0, nullptr, &m_LightProperties, 0, 0);
-	m_deviceResources->GetD3DDeviceContext()->UpdateSubresource(lightbuffer.Get(), 0, NULL, &m_LightProperties, 0, 0);
-
-	for (unsigned int i = 0; i < 3; i++)
+	if (m_viewportChanged)
 	{
-		m_constBufferPyramidData.model[i] = m_constantBufferData.model;
-		m_constBufferPyramidData.projection = m_constantBufferData.projection;
-		m_constBufferPyramidData.view = m_constantBufferData.view;
-		XMStoreFloat4x4(&m_constBufferPyramidData.model[i],
-			XMMatrixTranspose(XMMatrixTranslation(m_LightProperties.Lights[i].Position.x,
-												  m_LightProperties.Lights[i].Position.y,
-												  m_LightProperties.Lights[i].Position.z)));
+		m_scene->SetViewport(m_viewport);
+		m_viewportChanged = false;
 	}
-
-	//CreateDDSTextureFromMemory(m_deviceResources->GetD3DDevice(),)
-
-
-		//CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(),
-		//	L"Assets/pokeball.dds",
-		//	nullptr,
-		//	m_pokeplatTex.GetAddressOf());
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera)));
+	const float eye[3] = { m_camera._41, m_camera._42, m_camera._43 };
+	m_scene->SetCamera(&view._11, eye);
+	m_scene->SetSceneRotation(m_sceneRotation);
+	m_scene->Update(timer.GetTotalSeconds(), static_cast<float>(timer.GetElapsedSeconds()));
 }
 
-// Rotate the 3D cube model a set amount of radians.
+// Rotate the 3D scene a set amount of radians.
 void Sample3DSceneRenderer::Rotate(float radians)
 {
-	// Prepare to pass the updated model matrix to the shader
-	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixTranspose(XMMatrixRotationY(radians)));
+	m_sceneRotation = radians;
 }
 
 void Sample3DSceneRenderer::UpdateCamera(DX::StepTimer const& timer, float const moveSpd, float const rotSpd)
@@ -326,6 +227,7 @@ void Sample3DSceneRenderer::StopTracking(void)
 	m_tracking = false;
 }
 
+
 // Renders one frame using the vertex and pixel shaders.
 void Sample3DSceneRenderer::Render(void)
 {
@@ -335,513 +237,48 @@ void Sample3DSceneRenderer::Render(void)
 		return;
 	}
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
-
-	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_camera))));
-
-	
-	//// Prepare the constant buffer to send it to the graphics device.
-	//context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0, 0);
-	//// Each vertex is one instance of the VertexPositionColor struct.
-	UINT stride = sizeof(VertexPositionUVNormal);
-	 const UINT offset = 0;
-
-//context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_skyBoxBufferData, 0, 0, 0);
-//	context->IASetVertexBuffers(0, 1, m_VertSkyboxBuffer.GetAddressOf(), &stride, &offset);
-//	context->IASetIndexBuffer(m_IndexSkyboxBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-//	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-//	context->IASetInputLayout(m_inputLayout.Get());
-//	// Attach our vertex shader.
-//	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-//	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-//	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-//	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-//	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-//	context->GSSetShader(m_geoShader.Get(), nullptr, 0);
-//	// Send the constant buffer to the graphics device.
-//
-//	// Attach our pixel shader.
-//	context->PSSetShader(m_pyramid_pixelShader.Get(), nullptr, 0);
-//	context->PSSetShaderResources(0, 1, m_SkyboxTex.GetAddressOf());
-//	// Draw the objects.
-//	context->DrawIndexed(m_indexSkyboxCount, 0, 0);
-//	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-//	
-	 	context->UpdateSubresource1(m_constPyramidBuffer.Get(), 0, NULL, &m_constBufferPyramidData, 0, 0, 0);
-		context->IASetVertexBuffers(0, 1, m_VertPyramidBuffer.GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(m_IndexPyramidBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-		context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-		context->IASetInputLayout(m_inputLayout.Get());
-		context->VSSetShader(m_instancedvertexShader.Get(), nullptr, 0);
-		context->VSSetConstantBuffers1(0, 1, m_constPyramidBuffer.GetAddressOf(), nullptr, nullptr);
-		context->DSSetShader(nullptr, nullptr, 0);
-		context->HSSetShader(nullptr, nullptr, 0);
-		context->GSSetShader(nullptr, nullptr, 0);
-		context->PSSetShader(m_pyramid_pixelShader.Get(), nullptr, 0);
-		
-		// Draw the objects.
-		context->DrawIndexedInstanced(m_indexPyramidCount, 3, 0, 0, 0);
-
-
-
-
-
-	
-	
-	stride = sizeof(VertexPositionUVNormal);
-	// Prepare the constant buffer to send it to the graphics device.
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertfloor_bottomBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexfloor_bottomBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-	
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_floor_bottomTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexfloor_bottomCount, 0, 0);
-
-
-
-
-	stride = sizeof(VertexPositionUVNormal);
-	// Prepare the constant buffer to send it to the graphics device.
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertfloor_platformBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexfloor_platformBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	// Draw the objects.
-	context->DrawIndexed(m_indexfloor_platformCount, 0, 0);
-
-
-	stride = sizeof(VertexPositionUVNormal);
-	// Prepare the constant buffer to send it to the graphics device.
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertpokeplat_redBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexpokeplat_redBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_pokeplatTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexpokeplat_redCount, 0, 0);
-
-	// Prepare the constant buffer to send it to the graphics device.
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &m_constantBufferData, 0, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertpokeplat_whiteBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexpokeplat_whiteBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_pokeplatTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexpokeplat_whiteCount, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertpokeplat_blackBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexpokeplat_blackBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_pokeplatTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexpokeplat_blackCount, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_VertstadiumBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_IndexstadiumBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(nullptr, nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_light_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_pokeplatTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexstadiumCount, 0, 0);
-
-	context->PSSetConstantBuffers(0, 1, lightbuffer.GetAddressOf());
-	context->IASetVertexBuffers(0, 1, m_Vertstadium_topBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_Indexstadium_topBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	context->IASetInputLayout(m_inputLayout.Get());
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->HSSetShader(m_hulShader.Get(), nullptr, 0);
-	context->DSSetShader(m_domShader.Get(), nullptr, 0);
-	context->DSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
-	context->GSSetShader(m_geoShader.Get(), nullptr, 0);
-	// Send the constant buffer to the graphics device.
-
-	// Attach our pixel shader.
-	context->PSSetShader(m_pyramid_pixelShader.Get(), nullptr, 0);
-	context->PSSetShaderResources(0, 1, m_pokeplatTex.GetAddressOf());
-	// Draw the objects.
-	context->DrawIndexed(m_indexstadium_topCount, 0, 0);
-
-
-	
-
+	m_scene->Render();
 }
 
+// Creates the render device and loads the scene on a worker task. The shaders come from
+// Shaders.dxsa, which the PackShaders build target packs from the .cso files; each shader missing
+// from it is read from its own .cso instead.
 void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 {
+	m_renderDevice = std::unique_ptr<DX::D3D11RenderDevice>(new DX::D3D11RenderDevice(m_deviceResources));
+	m_scene = std::unique_ptr<DX::SceneRenderer>(new DX::SceneRenderer(*m_renderDevice));
 
-	CD3D11_SAMPLER_DESC sampDesc;
-	ZeroMemory(&sampDesc, sizeof(CD3D11_SAMPLER_DESC));
-
-	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	sampDesc.MipLODBias = 0.0f;
-	sampDesc.MaxAnisotropy = 1;
-	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	sampDesc.BorderColor[0] = 1.0f;
-	sampDesc.BorderColor[1] = 1.0f;
-	sampDesc.BorderColor[2] = 1.0f;
-	sampDesc.BorderColor[3] = 1.0f;
-	sampDesc.MinLOD = -FLT_MAX;
-	sampDesc.MaxLOD = FLT_MAX;
-
-	// Load shaders asynchronously.
-	auto loadVSTask = DX::ReadDataAsync(L"SampleVertexShader.cso");
-	auto loadInstanceVStask = DX::ReadDataAsync(L"InstancedVertexShader.cso");
-	auto loadDSTask = DX::ReadDataAsync(L"DomainShader.cso");
-	//auto loadInstanceDSTask = DX::ReadDataAsync(L"InstancedDomainShader.cso");
-	auto loadHSTasK = DX::ReadDataAsync(L"HullShader.cso");
-	auto loadPSTask = DX::ReadDataAsync(L"SamplePixelShader.cso");
-	auto loadLightPSTask = DX::ReadDataAsync(L"LightPixelShader.cso");
-	auto loadPyramidPSTask = DX::ReadDataAsync(L"PyramidPixelShader.cso");
-	auto loadGSTask = DX::ReadDataAsync(L"GeometryShader.cso");
-
-	// After the vertex shader file is loaded, create the shader and input layout.
-	auto createVSTask = loadVSTask.then([this](const std::vector<byte>& fileData)
+	DX::SceneRenderer* scene = m_scene.get();
+	Concurrency::create_task([this, scene]()
 	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_vertexShader));
-		static const D3D11_INPUT_ELEMENT_DESC vertexDesc[] =
+		DX::ShaderArchive shaders;
+		shaders.Open("Shaders.dxsa");
+		DX::SceneSettings settings;
+		settings.shaders = &shaders;
+		bool loaded = scene->Load(settings);
+		shaders.Close();
+		if (!loaded)
 		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "UV", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		};
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateInputLayout(vertexDesc, ARRAYSIZE(vertexDesc), &fileData[0], fileData.size(), &m_inputLayout));
-	});
-	auto createInstanceVSTask = loadInstanceVStask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateVertexShader(&fileData[0], fileData.size(), nullptr, &m_instancedvertexShader));
-	});
-	auto createHSTask = loadHSTasK.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateHullShader(&fileData[0], fileData.size(), nullptr, &m_hulShader));
-	});
-	auto createDSTask = loadDSTask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateDomainShader(&fileData[0], fileData.size(), nullptr, &m_domShader));
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &m_constantBuffer));
-	});
-	auto createGSTask = loadGSTask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateGeometryShader(&fileData[0],fileData.size(),nullptr, &m_geoShader));
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(m_geoBuffer), D3D11_BIND_STREAM_OUTPUT);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &m_geoBuffer));
-	});
-	// After the pixel shader file is loaded, create the shader and constant buffer.
-	auto createPSTask = loadPSTask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_pixelShader));
-
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &m_constantBuffer));
-	});
-	auto createPyramidPSTask = loadPyramidPSTask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_pyramid_pixelShader));
-		CD3D11_BUFFER_DESC instancedconstantBufferDesc(sizeof(ModelViewProjectionConstantBufferInstanced), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&instancedconstantBufferDesc, nullptr, &m_constPyramidBuffer));
-	});
-	auto createlightPSTask = loadLightPSTask.then([this](const std::vector<byte>& fileData)
-	{
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreatePixelShader(&fileData[0], fileData.size(), nullptr, &m_light_pixelShader));
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(LightProperties), D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&constantBufferDesc, nullptr, &lightbuffer));
-	});
-	// Once both shaders are loaded, create the mesh.
-
-	auto createGroundTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/floor_bottom.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertfloor_bottomBuffer));
-
-		m_indexfloor_bottomCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexfloor_bottomBuffer));
-
-
-		CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(),
-			L"Assets/Castle1.dds",
-			nullptr,
-			m_floor_bottomTex.GetAddressOf());
-	});
-
-	auto createPlatformTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/floor_platform.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertfloor_platformBuffer));
-
-		m_indexfloor_platformCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexfloor_platformBuffer));
-	});
-
-	auto createpokeplat_redTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/pokeballred.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertpokeplat_redBuffer));
-
-		m_indexpokeplat_redCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexpokeplat_redBuffer));
-
-
-		CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(),
-			L"Assets/pokeball.dds",
-			nullptr,
-			m_pokeplatTex.GetAddressOf());
-	});
-
-	auto createpokeplat_whiteTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/pokeballwhite.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertpokeplat_whiteBuffer));
-
-		m_indexpokeplat_whiteCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexpokeplat_whiteBuffer));
-	});
-
-	auto createpokeplat_blackTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/pokeballblack.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertpokeplat_blackBuffer));
-
-		m_indexpokeplat_blackCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexpokeplat_blackBuffer));
-	});
-
-	auto createstadiumTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/stadium.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_VertstadiumBuffer));
-
-		m_indexstadiumCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_IndexstadiumBuffer));
-	});
-
-	auto createstadium_topTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/sphere.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_Vertstadium_topBuffer));
-
-		m_indexstadium_topCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_Indexstadium_topBuffer));
-	});
+			std::string error = "Scene failed to load: " + scene->GetLoadError() + "\n";
+			OutputDebugStringA(error.c_str());
+			throw Platform::Exception::CreateException(E_FAIL);
+		}
 
-	auto createSkyboxTask = (createlightPSTask && createVSTask && createHSTask && createDSTask).then([this]()
-	{
-		Mesh sphere = Mesh("Assets/SkyboxCube.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = sphere.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*sphere.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_VertSkyboxBuffer));
-
-		m_indexSkyboxCount = sphere.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = sphere.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*sphere.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_IndexSkyboxBuffer));
-	
-		CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"Assets/OutputCube.dds", nullptr, &m_SkyboxTex);
-	});
+		const DX::PackStats& atlas = scene->GetAtlasStats();
+		wchar_t message[128];
+		swprintf_s(message, L"Material atlas: %u textures, %u pages, %.1f%% packed\n",
+			atlas.packedCount, atlas.pageCount, atlas.efficiency * 100.0f);
+		OutputDebugStringW(message);
+		for (uint32 i = 0; i < scene->GetMaterialCount(); ++i)
+		{
+			swprintf_s(message, L"Material %u: %S\n", i, DX::AlphaClassName(scene->GetMaterialAlpha(i)));
+			OutputDebugStringW(message);
+		}
+		if (scene->GetSkyboxSource() == DX::SceneRenderer::SkyboxNone)
+		{
+			OutputDebugStringW(L"Warning: no usable OutputCube.dds, Skybox*.dds faces or SkyboxEquirect.dds in Assets; the skybox is skipped.\n");
+		}
 
-	auto createPyramidsTask = (createInstanceVSTask && createPyramidPSTask && createGSTask).then([this]()
-	{
-		Mesh pyramid = Mesh("Assets/pyramid.obj");
-
-		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-		vertexBufferData.pSysMem = pyramid.uniqueVertList.data();
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionUVNormal)*pyramid.uniqueVertList.size(), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &m_VertPyramidBuffer));
-
-		m_indexPyramidCount = pyramid.indexbuffer.size();
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-		indexBufferData.pSysMem = pyramid.indexbuffer.data();
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int)*pyramid.indexbuffer.size(), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&indexBufferDesc, &indexBufferData, &m_IndexPyramidBuffer));
-	});
-	// Once the cube is loaded, the object is ready to be rendered.
-	(createPyramidsTask  && createGroundTask).then([this]()
-	{
 		m_loadingComplete = true;
 	});
 }
@@ -849,10 +286,26 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources(void)
 void Sample3DSceneRenderer::ReleaseDeviceDependentResources(void)
 {
 	m_loadingComplete = false;
-	m_vertexShader.Reset();
-	m_inputLayout.Reset();
-	m_pixelShader.Reset();
-	m_constantBuffer.Reset();
-	m_vertexBuffer.Reset();
-	m_indexBuffer.Reset();
-}
\ No newline at end of file
+	m_scene.reset();
+	m_renderDevice.reset();
+	m_viewportChanged = true;
+}
+
+// The scene's stats, or empty ones while it loads.
+const DX::ResidencyStats& Sample3DSceneRenderer::GetResidencyStats(void) const
+{
+	static const DX::ResidencyStats none = {};
+	return m_loadingComplete ? m_scene->GetResidencyStats() : none;
+}
+
+const DX::StateCacheStats& Sample3DSceneRenderer::GetStateCacheStats(void) const
+{
+	static const DX::StateCacheStats none = {};
+	return m_loadingComplete ? m_scene->GetStateCacheStats() : none;
+}
+
+const DX::CullStats& Sample3DSceneRenderer::GetCullStats(void) const
+{
+	static const DX::CullStats none = {};
+	return m_loadingComplete ? m_scene->GetCullStats() : none;
+}
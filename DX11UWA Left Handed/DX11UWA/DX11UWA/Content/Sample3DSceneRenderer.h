@@ -1,13 +1,19 @@
 ﻿#pragma once
 
+#include <ppltasks.h>
 #include "..\Common\DeviceResources.h"
 #include "ShaderStructures.h"
 #include "..\Common\StepTimer.h"
+#include "..\Common\D3D11RenderDevice.h"
+#include "..\Common\SceneRenderer.h"
 
 
 namespace DX11UWA
 {
-	// This sample renderer instantiates a basic rendering pipeline.
+	// This sample renderer instantiates a basic rendering pipeline. The scene and its frame live in
+	// DX::SceneRenderer, which draws through a DX::D3D11RenderDevice; this class loads it, feeds it the
+	// window's viewport and the camera the keyboard and mouse move, and turns the scene while the
+	// pointer is tracked.
 	class Sample3DSceneRenderer
 	{
 	public:
@@ -21,6 +27,9 @@ namespace DX11UWA
 		void TrackingUpdate(float positionX);
 		void StopTracking(void);
 		inline bool IsTracking(void) { return m_tracking; }
+		const DX::ResidencyStats& GetResidencyStats(void) const;
+		const DX::StateCacheStats& GetStateCacheStats(void) const;
+		const DX::CullStats& GetCullStats(void) const;
 
 		// Helper functions for keyboard and mouse input
 		void SetKeyboardButtons(const char* list);
@@ -36,154 +45,14 @@ namespace DX11UWA
 		// Cached pointer to device resources.
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
-		// Direct3D resources for cube geometry.
-		Microsoft::WRL::ComPtr<ID3D11InputLayout>	m_inputLayout;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_vertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_indexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>        m_geoBuffer;
-
-		Microsoft::WRL::ComPtr<ID3D11VertexShader>	 m_vertexShader;
-		Microsoft::WRL::ComPtr<ID3D11VertexShader>	 m_instancedvertexShader;
-		Microsoft::WRL::ComPtr<ID3D11DomainShader>   m_domShader;
-		Microsoft::WRL::ComPtr<ID3D11DomainShader>   m_InstdomShader;
-		Microsoft::WRL::ComPtr<ID3D11HullShader>     m_hulShader;
-		Microsoft::WRL::ComPtr<ID3D11GeometryShader> m_geoShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>    m_light_pixelShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>	 m_pyramid_pixelShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>	 m_pixelShader;
-													 
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		 m_constantBuffer;
-		
-		// System resources for cube geometry.
-		ModelViewProjectionConstantBuffer	m_constantBufferData;
-		uint32	m_indexCount;
-
-
-		// Direct3D resources for floor_bottom geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_VertSkyboxBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_IndexSkyboxBuffer;
-		// System resources for floor_bottom geometry.
-		uint32	m_indexSkyboxCount;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_SkyboxTex;
-		ModelViewProjectionConstantBuffer m_skyBoxBufferData;
-
-
-		// Direct3D resources for floor_bottom geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertfloor_bottomBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexfloor_bottomBuffer;
-		// System resources for floor_bottom geometry.
-		uint32	m_indexfloor_bottomCount;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_floor_bottomTex;
-
-		// Direct3D resources for floor_platform geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertfloor_platformBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexfloor_platformBuffer;
-		// System resources for floor_platform geometry.
-		uint32	m_indexfloor_platformCount;
-
-		// Direct3D resources for pokeplat_red geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertpokeplat_redBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexpokeplat_redBuffer;
-		// System resources for pokeplat_red geometry.
-		uint32	m_indexpokeplat_redCount;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_pokeplatTex;
-
-		// Direct3D resources for pokeplat_black geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertpokeplat_blackBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexpokeplat_blackBuffer;
-		// System resources for pokeplat_black geometry.
-		uint32	m_indexpokeplat_blackCount;
-
-		// Direct3D resources for pokeplat_white geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertpokeplat_whiteBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexpokeplat_whiteBuffer;
-		// System resources for floor_platform geometry.
-		uint32	m_indexpokeplat_whiteCount;
-
-		// Direct3D resources for stadium geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_VertstadiumBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_IndexstadiumBuffer;
-		// System resources for stadium geometry.
-		uint32	m_indexstadiumCount;
-		// Direct3D resources for stadium geometry.//
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Vertstadium_topBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_Indexstadium_topBuffer;
-		// System resources for stadium geometry.
-		uint32	m_indexstadium_topCount;
-
-		// Direct3D resources for pyramid
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_VertPyramidBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_IndexPyramidBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_constPyramidBuffer;
-		// System resources for pyramid geometry.
-		uint32	m_indexPyramidCount;
-		uint32 m_numPyramids;
-		ModelViewProjectionConstantBufferInstanced 	m_constBufferPyramidData;
-
-		//lighting
-		struct Light
-		{
-			XMFLOAT4    Position;    //16
-			XMFLOAT4    Direction;   //16
-			XMFLOAT4    radius;
-			XMFLOAT4    Color; //16
-
-			XMFLOAT4    AttenuationData;
-			// x =  SpotAngle;
-			// y =  ConstantAttenuation;
-			// z =  LinearAttenuation;
-			// w =  QuadraticAttenuation; 
-
-			XMFLOAT4 LightTypeEnabled;
-			// x  = type
-			// y = Enabled;
-
-			XMFLOAT4   ConeRatio; // x = inner ratio,  y = outerratio
-
-			XMFLOAT4    coneAngle;
-
-		};
-
-		struct LightProperties
-		{
-			XMFLOAT4 EyePosition;
-			XMFLOAT4 GlobalAmbient;
-			Light  Lights[3];
-		};
-		LightProperties m_LightProperties;
-
-		XMVECTORF32 LightColors[3] =
-		{
-			// Directional light;      Point Light;    Spot Light;
-			Colors::White, Colors::Blue, Colors::Red
-
-		};
-
-		bool LightEnabled[3] =
-		{
-			true, true, true
-		};
-
-		//Dynamic Variables
-		bool dirLightSwitch = false; // false = negative direction true = positive direction
-		bool pointLightSwitch = false; // false = negative direction true = positive direction
-		bool spotLightSwitch = false;
-		float spotRad = 10.0f;
-		float innerConeRat = .8f;
-		float outterConeRat = .45f;
-		XMFLOAT4 coneAng = { 0,-1.0f, 0.0f, 0 };
-
-		XMFLOAT4 pointLightPos = { 5.0f,1.0f, 5.0f,1 };
-		XMFLOAT4 directionalLightPos = { -7.0f, 5.0f, 0.0f,1 };
-		XMFLOAT4 spotPos = { 0.0, 2.0f, 0.0f,1 };
-
-		int numLights = 3;
-		float radius = 1.0f;
-		float offset = 2.0f * XM_PI / numLights;
-
-
-		Microsoft::WRL::ComPtr<ID3D11Buffer> lightbuffer;
+		// Created with the device; the scene loads on a worker task and is only touched once it has.
+		std::unique_ptr<DX::D3D11RenderDevice>	m_renderDevice;
+		std::unique_ptr<DX::SceneRenderer>		m_scene;
 
+		// The window's viewport, handed to the scene by the first Update after it changes.
+		DX::SceneViewport	m_viewport;
+		bool				m_viewportChanged;
+		float				m_sceneRotation;
 
 		// Variables used with the rendering loop.
 		bool	m_loadingComplete;
@@ -199,4 +68,3 @@ namespace DX11UWA
 		DirectX::XMFLOAT4X4 m_camera;
 	};
 }
-
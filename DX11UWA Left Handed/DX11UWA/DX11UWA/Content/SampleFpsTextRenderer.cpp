@@ -12,6 +12,7 @@ SampleFpsTextRenderer::SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceRes
 	m_deviceResources(deviceResources)
 {
 	ZeroMemory(&m_textMetrics, sizeof(DWRITE_TEXT_METRICS));
+	ZeroMemory(&m_stateCacheStats, sizeof(DX::StateCacheStats));
 
 	// Create device independent resources
 	ComPtr<IDWriteTextFormat> textFormat;
@@ -51,14 +52,31 @@ void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
 
 	m_text = (fps > 0) ? std::to_wstring(fps) + L" FPS" : L" - FPS";
 
+	// Second line: resident texture memory against the budget, and how many mips were dropped so far.
+	const uint64_t megabyte = 1024 * 1024;
+	m_text += L"\n" + std::to_wstring((m_residencyStats.residentBytes + megabyte - 1) / megabyte) + L"/" +
+		std::to_wstring(m_residencyStats.budgetBytes / megabyte) + L" MB tex";
+	if (m_residencyStats.evictions > 0)
+	{
+		m_text += L", " + std::to_wstring(m_residencyStats.evictions) + L" evicted";
+	}
+
+	// Third line: state calls that reached the device context last frame, and how many were redundant.
+	m_text += L"\n" + std::to_wstring(m_stateCacheStats.TotalIssued()) + L" state calls, " +
+		std::to_wstring(m_stateCacheStats.TotalFiltered()) + L" filtered";
+
+	// Fourth line: objects that survived frustum and occlusion culling last frame.
+	m_text += L"\n" + std::to_wstring(m_cullStats.visible) + L" visible, " + std::to_wstring(m_cullStats.culled) + L" culled, " +
+		std::to_wstring(m_cullStats.occluded) + L" occluded";
+
 	ComPtr<IDWriteTextLayout> textLayout;
 	DX::ThrowIfFailed(
 		m_deviceResources->GetDWriteFactory()->CreateTextLayout(
 			m_text.c_str(),
 			(uint32) m_text.length(),
 			m_textFormat.Get(),
-			240.0f, // Max width of the input text.
-			50.0f, // Max height of the input text.
+			480.0f, // Max width of the input text.
+			190.0f, // Max height of the input text.
 			&textLayout
 			)
 		);
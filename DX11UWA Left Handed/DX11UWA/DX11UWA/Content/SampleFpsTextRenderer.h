@@ -3,6 +3,9 @@
 #include <string>
 #include "..\Common\DeviceResources.h"
 #include "..\Common\StepTimer.h"
+#include "..\Common\TextureResidency.h"
+#include "..\Common\StateCache.h"
+#include "..\Common\FrustumCulling.h"
 
 namespace DX11UWA
 {
@@ -14,6 +17,9 @@ namespace DX11UWA
 		void CreateDeviceDependentResources();
 		void ReleaseDeviceDependentResources();
 		void Update(DX::StepTimer const& timer);
+		void SetResidencyStats(const DX::ResidencyStats& stats) { m_residencyStats = stats; }
+		void SetStateCacheStats(const DX::StateCacheStats& stats) { m_stateCacheStats = stats; }
+		void SetCullStats(const DX::CullStats& stats) { m_cullStats = stats; }
 		void Render();
 
 	private:
@@ -22,6 +28,9 @@ namespace DX11UWA
 
 		// Resources related to text rendering.
 		std::wstring                                    m_text;
+		DX::ResidencyStats                              m_residencyStats;
+		DX::StateCacheStats                             m_stateCacheStats;
+		DX::CullStats                                   m_cullStats;
 		DWRITE_TEXT_METRICS	                            m_textMetrics;
 		Microsoft::WRL::ComPtr<ID2D1SolidColorBrush>    m_whiteBrush;
 		Microsoft::WRL::ComPtr<ID2D1DrawingStateBlock1> m_stateBlock;
@@ -8,13 +8,9 @@ namespace DX11UWA
 		DirectX::XMFLOAT4X4 model;
 		DirectX::XMFLOAT4X4 view;
 		DirectX::XMFLOAT4X4 projection;
-	};
-
-	struct ModelViewProjectionConstantBufferInstanced
-	{
-		DirectX::XMFLOAT4X4 model[3];
-		DirectX::XMFLOAT4X4 view;
-		DirectX::XMFLOAT4X4 projection;
+		// Read by the hull and domain shaders: largest factor, Phong shape factor, segments per unit
+		// of edge length at distance 1, unused.
+		DirectX::XMFLOAT4 tessellation;
 	};
 
 	// Used to send per-vertex data to the vertex shader.
@@ -0,0 +1,14 @@
+TextureCube skyboxTexture : register(t0);
+SamplerState filters : register(s0);
+
+struct SkyboxPixelInput
+{
+	float4 pos : SV_POSITION;
+	float3 dir : DIRECTION;
+};
+
+// One cube map sample per pixel.
+float4 main(SkyboxPixelInput input) : SV_TARGET
+{
+	return skyboxTexture.Sample(filters, input.dir);
+}
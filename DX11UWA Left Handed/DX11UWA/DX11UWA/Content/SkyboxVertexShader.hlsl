@@ -0,0 +1,35 @@
+// A constant buffer that stores the three basic column-major matrices for composing geometry.
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+};
+
+// Per-vertex data used as input to the vertex shader.
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 uv : UV;
+	float3 normal : NORMAL;
+};
+
+struct SkyboxPixelInput
+{
+	float4 pos : SV_POSITION;
+	float3 dir : DIRECTION;
+};
+
+// Centers the unit cube on the camera; its object space position doubles as the cube map lookup direction.
+SkyboxPixelInput main(VertexShaderInput input)
+{
+	SkyboxPixelInput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	pos = mul(pos, model);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+	output.dir = input.pos;
+	return output;
+}
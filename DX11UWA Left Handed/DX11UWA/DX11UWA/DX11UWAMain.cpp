@@ -49,6 +49,9 @@ void DX11UWAMain::Update(void)
 		// TODO: Replace this with your app's content update functions.
 		m_sceneRenderer->Update(m_timer);
 		m_sceneRenderer->SetInputDeviceData(main_kbuttons, main_currentpos);
+		m_fpsTextRenderer->SetResidencyStats(m_sceneRenderer->GetResidencyStats());
+		m_fpsTextRenderer->SetStateCacheStats(m_sceneRenderer->GetStateCacheStats());
+		m_fpsTextRenderer->SetCullStats(m_sceneRenderer->GetCullStats());
 		m_fpsTextRenderer->Update(m_timer);
 	});
 }
@@ -3,6 +3,7 @@ cbuffer ModelViewProjectionConstantBuffer : register(b0)
 	matrix model;
 	matrix view;
 	matrix projection;
+	float4 tessellation;	// y = Phong shape factor; see HullShader.hlsl.
 };
 
 
@@ -41,7 +42,19 @@ DS_OUTPUT main(HS_CONSTANT_DATA_OUTPUT input,float3 domain : SV_DomainLocation,
 
 	
 
-	float4 pos = float4(patch[0].pos.xyz*domain.x + patch[1].pos.xyz*domain.y + patch[2].pos.xyz*domain.z,1.0f);
+	float3 flat = patch[0].pos.xyz*domain.x + patch[1].pos.xyz*domain.y + patch[2].pos.xyz*domain.z;
+
+	// Phong tessellation: project the flat point onto each corner's tangent plane, blend the
+	// projections like the corners, and move part of the way there. The result only depends on
+	// the corners of the edge a point lies on, so neighbouring patches meet.
+	float3 curved = float3(0.0f, 0.0f, 0.0f);
+	[unroll]
+	for (uint i = 0; i < NUM_CONTROL_POINTS; ++i)
+	{
+		float3 n = normalize(patch[i].normal);
+		curved += domain[i] * (flat - dot(flat - patch[i].pos.xyz, n) * n);
+	}
+	float4 pos = float4(lerp(flat, curved, tessellation.y), 1.0f);
 	float3 uv = float3(patch[0].uv*domain.x + patch[1].uv*domain.y + patch[2].uv*domain.z);
 	float4 normal = float4(patch[0].normal*domain.x + patch[1].normal*domain.y + patch[2].normal*domain.z,0.0f);
 
@@ -1,6 +1,12 @@
-
-
-
+// Per-object constants; tessellation comes from the mesh's TessellationPolicy (see
+// Common/TessellationPolicy.h).
+cbuffer ModelViewProjectionConstantBuffer : register(b0)
+{
+	matrix model;
+	matrix view;
+	matrix projection;
+	float4 tessellation;	// x = largest factor, y = Phong shape factor, z = segments per unit of edge length at distance 1
+};
 
 // Input control point
 struct VS_CONTROL_POINT_OUTPUT
@@ -8,7 +14,6 @@ struct VS_CONTROL_POINT_OUTPUT
 	float4 pos : SV_POSITION;
 	float3 uv : UV;
 	float3 normal : NORMAL;
-	// TODO: change/add other stuff
 };
 
 // Output control point
@@ -24,23 +29,36 @@ struct HS_CONSTANT_DATA_OUTPUT
 {
 	float EdgeTessFactor[3]			: SV_TessFactor; // e.g. would be [4] for a quad domain
 	float InsideTessFactor			: SV_InsideTessFactor; // e.g. would be Inside[2] for a quad domain
-	// TODO: change/add other stuff
 };
 
 #define NUM_CONTROL_POINTS 3
 
+// Splits an edge into segments of roughly the same size on screen: its length over its distance
+// from the eye is its projected size. Only the edge's own ends go in, so the two patches sharing
+// it agree and no cracks open between them.
+float EdgeFactor(float3 a, float3 b)
+{
+	float3 middle = mul(float4(0.5f * (a + b), 1.0f), view).xyz;
+	float segments = distance(a, b) * tessellation.z / max(length(middle), 1e-3f);
+	return clamp(segments, 1.0f, tessellation.x);
+}
+
 // Patch Constant Function
 HS_CONSTANT_DATA_OUTPUT CalcHSPatchConstants(InputPatch<VS_CONTROL_POINT_OUTPUT, NUM_CONTROL_POINTS> ip,uint PatchID : SV_PrimitiveID)
 {
 	HS_CONSTANT_DATA_OUTPUT Output;
 
-
-
-	// Insert code to compute Output here
-	Output.EdgeTessFactor[0] = 
-		Output.EdgeTessFactor[1] = 
-		Output.EdgeTessFactor[2] = 
-		Output.InsideTessFactor = 3; // e.g. could calculate dynamic tessellation factors instead
+	float3 world[NUM_CONTROL_POINTS];
+	for (uint i = 0; i < NUM_CONTROL_POINTS; ++i)
+	{
+		world[i] = mul(float4(ip[i].pos.xyz, 1.0f), model).xyz;
+	}
+
+	// Edge i is the one opposite control point i.
+	Output.EdgeTessFactor[0] = EdgeFactor(world[1], world[2]);
+	Output.EdgeTessFactor[1] = EdgeFactor(world[2], world[0]);
+	Output.EdgeTessFactor[2] = EdgeFactor(world[0], world[1]);
+	Output.InsideTessFactor = max(Output.EdgeTessFactor[0], max(Output.EdgeTessFactor[1], Output.EdgeTessFactor[2]));
 
 	return Output;
 }
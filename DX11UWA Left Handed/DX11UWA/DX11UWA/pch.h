@@ -16,6 +16,8 @@
 #include <vector>
 #include "Content\ShaderStructures.h"
 #include "Common\DDSTextureLoader.h"
+#include "Common\FrustumCulling.h"
+#include "Common\ObjMesh.h"
 
 using namespace DX11UWA;
 using namespace std;
@@ -29,29 +31,17 @@ public:
 	Mesh(const char* filename);
 	~Mesh();
 
+	// Scales and offsets every texture coordinate into an atlas region; uv.z selects the array slice.
+	void RemapUVs(const float scale[2], const float offset[2], float slice);
+
 	vector<VertexPositionUVNormal> uniqueVertList;
 	vector<unsigned int> indexbuffer;
+	// Object-space bounds of every vertex, computed once after loading.
+	DX::MeshBounds bounds = {};
 private:
 
 
 };
 
-class SceneObject
-{
-public:
-	SceneObject();
-	~SceneObject();
-
-private:
-
-};
-
-SceneObject::SceneObject()
-{
-}
-
-SceneObject::~SceneObject()
-{
-}
 
 
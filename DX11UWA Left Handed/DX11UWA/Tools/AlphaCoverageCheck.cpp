@@ -0,0 +1,235 @@
+// Checks AlphaCoverage, the load-time alpha analysis that picks the discard-free lit shaders.
+//
+//   AlphaCoverageCheck <Assets dir> [size] [iterations]
+//
+// Counts random surfaces of every width from 1 to 67, with padded pitches and alpha drawn mostly
+// from 0, 255 and the values around the cutoff, with AnalyzeAlpha at several cutoffs and compares
+// the counts with a scalar loop; a size by size (default 2048) surface takes the worker pool path.
+// Then checks ClassifyAlpha at the edges of its classes: partial alpha that never falls below the
+// cutoff is opaque, a few partial texels are alpha tested, many are blended. ClassifyImageAlpha
+// must report each mip and the least opaque of them, including a texture whose only clear texels
+// are in a coarse mip or on one cube face. Last, the scene's materials must classify as opaque, as
+// the renderer relies on. Times AnalyzeAlpha on the large surface against the scalar loop over
+// iterations (default 10) runs, and exits with 1 on any mismatch. Only depends on the portable
+// sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common AlphaCoverageCheck.cpp ..\DX11UWA\Common\AlphaCoverage.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common AlphaCoverageCheck.cpp ../DX11UWA/Common/{AlphaCoverage,DDSFile,DDSFormatConvert,WorkerPool}.cpp
+
+#include "AlphaCoverage.h"
+#include "DDSFile.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* const MaterialFiles[] = { "Castle1.dds", "pokeball.dds" };
+	const uint8_t Cutoffs[] = { 0, 1, 127, 128, 129, 255 };
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	uint32_t RandomTexel(uint32_t& state)
+	{
+		static const uint32_t edges[] = { 0, 1, 126, 127, 128, 129, 254, 255 };
+		uint32_t pick = Random(state) % 4;
+		uint32_t alpha = pick == 0 ? 0 : pick == 1 ? 255 : pick == 2 ? edges[Random(state) % 8] : Random(state) & 0xff;
+		return (Random(state) & 0xffffff) | alpha << 24;
+	}
+
+	DX::AlphaCoverage ScalarCoverage(const uint32_t* texels, size_t width, size_t height, size_t pitch, uint8_t cutoff)
+	{
+		DX::AlphaCoverage coverage;
+		for (size_t y = 0; y < height; ++y)
+		{
+			for (size_t x = 0; x < width; ++x)
+			{
+				uint32_t a = texels[y * pitch + x] >> 24;
+				++coverage.texels;
+				coverage.opaque += a == 255;
+				coverage.clear += a == 0;
+				coverage.belowCutoff += a < cutoff;
+			}
+		}
+		return coverage;
+	}
+
+	bool Same(const DX::AlphaCoverage& a, const DX::AlphaCoverage& b)
+	{
+		return a.texels == b.texels && a.opaque == b.opaque && a.clear == b.clear && a.belowCutoff == b.belowCutoff;
+	}
+
+	bool CheckCounts(size_t size, uint32_t iterations)
+	{
+		uint32_t state = 5;
+		for (size_t width = 1; width <= 67; ++width)
+		{
+			size_t height = 1 + Random(state) % 9;
+			size_t pitch = width + Random(state) % 5;
+			std::vector<uint32_t> texels(pitch * height);
+			for (uint32_t& texel : texels)
+			{
+				texel = RandomTexel(state);
+			}
+			for (uint8_t cutoff : Cutoffs)
+			{
+				if (!Same(DX::AnalyzeAlpha(texels.data(), width, height, pitch, cutoff), ScalarCoverage(texels.data(), width, height, pitch, cutoff)))
+				{
+					printf("%zux%zu surface, pitch %zu, cutoff %u: counts differ from the scalar loop\n", width, height, pitch, cutoff);
+					return false;
+				}
+			}
+		}
+
+		const size_t pitch = size + 3;
+		std::vector<uint32_t> texels(pitch * size);
+		for (uint32_t& texel : texels)
+		{
+			texel = RandomTexel(state);
+		}
+		double analyzeMs = 0.0, scalarMs = 0.0;
+		bool same = true;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			DX::AlphaCoverage coverage = DX::AnalyzeAlpha(texels.data(), size, size, pitch, 128);
+			analyzeMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			DX::AlphaCoverage expected = ScalarCoverage(texels.data(), size, size, pitch, 128);
+			scalarMs += Milliseconds(start);
+			same &= Same(coverage, expected);
+		}
+		double texelCount = double(size) * size * iterations * 1e-3;
+		printf("counts: widths 1 to 67 at %zu cutoffs match the scalar loop; %zux%zu surface AnalyzeAlpha %.2f ms (%.0f Mtexels/s), scalar %.2f ms (%.0f)%s\n",
+			   sizeof(Cutoffs), size, size, analyzeMs / iterations, texelCount / analyzeMs, scalarMs / iterations, texelCount / scalarMs,
+			   same ? "" : "; DIFFERS");
+		return same;
+	}
+
+	DX::AlphaCoverage Coverage(uint64_t opaque, uint64_t clear, uint64_t partialBelow, uint64_t partialAbove)
+	{
+		DX::AlphaCoverage coverage;
+		coverage.texels = opaque + clear + partialBelow + partialAbove;
+		coverage.opaque = opaque;
+		coverage.clear = clear;
+		coverage.belowCutoff = clear + partialBelow;
+		return coverage;
+	}
+
+	bool CheckClasses(void)
+	{
+		struct Case
+		{
+			const char* name;
+			DX::AlphaCoverage coverage;
+			DX::AlphaClass expected;
+		};
+		const Case cases[] =
+		{
+			{ "all opaque", Coverage(1000, 0, 0, 0), DX::AlphaOpaque },
+			{ "partial alpha above the cutoff", Coverage(0, 0, 0, 1000), DX::AlphaOpaque },
+			{ "one clear texel", Coverage(999, 1, 0, 0), DX::AlphaTested },
+			{ "cutout", Coverage(500, 500, 0, 0), DX::AlphaTested },
+			{ "10% partial", Coverage(800, 100, 50, 50), DX::AlphaTested },
+			{ "11% partial", Coverage(790, 100, 60, 50), DX::AlphaBlended },
+			{ "all partial", Coverage(0, 0, 500, 500), DX::AlphaBlended },
+		};
+		bool passed = true;
+		for (const Case& c : cases)
+		{
+			DX::AlphaClass found = DX::ClassifyAlpha(c.coverage);
+			if (found != c.expected)
+			{
+				printf("%s: classified %s, expected %s\n", c.name, DX::AlphaClassName(found), DX::AlphaClassName(c.expected));
+				passed = false;
+			}
+		}
+
+		// Mip 2 of a 16x16 texture has the only clear texels, so the texture as a whole is alpha tested.
+		DX::DDSImage image;
+		image.Allocate(16, 16, 5, 1);
+		for (uint32_t& texel : image.texels)
+		{
+			texel = 0xff808080;
+		}
+		image.Level(0, 2)[5] = 0x00808080;
+		std::vector<DX::AlphaClass> perMip;
+		DX::AlphaClass whole = DX::ClassifyImageAlpha(image, &perMip);
+		const DX::AlphaClass expectedMips[] = { DX::AlphaOpaque, DX::AlphaOpaque, DX::AlphaTested, DX::AlphaOpaque, DX::AlphaOpaque };
+		if (whole != DX::AlphaTested || perMip != std::vector<DX::AlphaClass>(expectedMips, expectedMips + 5))
+		{
+			printf("clear texel in mip 2: classified %s\n", DX::AlphaClassName(whole));
+			passed = false;
+		}
+
+		// A cube map half transparent on one face only.
+		DX::DDSImage cube;
+		cube.Allocate(8, 8, 1, 6);
+		for (uint32_t& texel : cube.texels)
+		{
+			texel = 0xffffffff;
+		}
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			cube.Level(4, 0)[i] = i % 2 ? 0x80ffffff : 0x10ffffff;
+		}
+		whole = DX::ClassifyImageAlpha(cube, &perMip);
+		if (whole != DX::AlphaBlended || perMip.size() != 1)
+		{
+			printf("cube with one blended face: classified %s\n", DX::AlphaClassName(whole));
+			passed = false;
+		}
+		printf("classes: %zu coverages and 2 images %s\n", sizeof(cases) / sizeof(cases[0]), passed ? "as expected" : "FAILED");
+		return passed;
+	}
+
+	bool CheckMaterials(const std::string& assets)
+	{
+		bool passed = true;
+		for (const char* file : MaterialFiles)
+		{
+			DX::DDSImage image;
+			if (!DX::ReadDDSFile((assets + "/" + file).c_str(), image))
+			{
+				printf("%s: can't read\n", file);
+				passed = false;
+				continue;
+			}
+			std::vector<DX::AlphaClass> perMip;
+			DX::AlphaClass whole = DX::ClassifyImageAlpha(image, &perMip);
+			printf("%s: %ux%u, %u mips, %s%s\n", file, image.width, image.height, image.mipLevels, DX::AlphaClassName(whole),
+				   whole == DX::AlphaOpaque ? "" : "; EXPECTED OPAQUE");
+			passed &= whole == DX::AlphaOpaque;
+		}
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t size = argc > 2 ? size_t(atoi(argv[2])) : 2048;
+	uint32_t iterations = argc > 3 ? uint32_t(atoi(argv[3])) : 10;
+	if (argc < 2 || argc > 4 || size == 0 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> [size] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckCounts(size, iterations);
+	passed &= CheckClasses();
+	passed &= CheckMaterials(argv[1]);
+	return passed ? 0 : 1;
+}
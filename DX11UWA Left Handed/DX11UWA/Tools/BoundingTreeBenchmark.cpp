@@ -0,0 +1,326 @@
+// Checks and times BoundingTree, the dynamic AABB tree the renderer culls draw items with.
+//
+//   BoundingTreeBenchmark [objects] [iterations]
+//
+// Inserts objects (default 200000) random boxes in a 200 unit cube, moves every one of them by
+// up to a unit, refits every leaf by a small step, refits the whole tree, rebalances it and
+// removes every third object, timing each step. After each, every live object's fat box must hold
+// its box and report its user data, and the leaf and node counts must add up. Then compares the
+// frustum, sphere and ray queries and RayCast with brute force over the fat boxes: the same
+// objects, and the same nearest entry distance. The frustum query is timed over iterations
+// (default 100) runs against the brute force loop, the sphere query and ray cast over more.
+// Exits with 1 on any mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common BoundingTreeBenchmark.cpp ..\DX11UWA\Common\BoundingTree.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common BoundingTreeBenchmark.cpp ../DX11UWA/Common/{BoundingTree,FrustumCulling,WorkerPool}.cpp
+
+#include "BoundingTree.h"
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const uint32_t Rays = 200;
+	const float RayLength = 300.0f;
+
+	struct Object
+	{
+		float min[3];
+		float max[3];
+		uint32_t proxy;
+		bool alive;
+	};
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	float RandomFloat(uint32_t& state, float low, float high)
+	{
+		return low + (high - low) * float(Random(state) & 0xffff) / 65535.0f;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool Validate(const char* step, const DX::BoundingTree& tree, const std::vector<Object>& objects)
+	{
+		uint32_t alive = 0;
+		for (uint32_t i = 0; i < objects.size(); ++i)
+		{
+			const Object& object = objects[i];
+			if (!object.alive)
+				continue;
+			++alive;
+			float min[3], max[3];
+			tree.GetFatBounds(object.proxy, min, max);
+			bool holds = tree.GetUserData(object.proxy) == i;
+			for (int a = 0; a < 3; ++a)
+			{
+				holds &= min[a] <= object.min[a] && max[a] >= object.max[a];
+			}
+			if (!holds)
+			{
+				printf("%s: object %u not held by its fat box\n", step, i);
+				return false;
+			}
+		}
+		if (tree.GetLeafCount() != alive || tree.GetNodeCount() != (alive ? 2 * alive - 1 : 0))
+		{
+			printf("%s: %u leaves and %u nodes for %u objects\n", step, tree.GetLeafCount(), tree.GetNodeCount(), alive);
+			return false;
+		}
+		return true;
+	}
+
+	void Report(const char* step, double ms, const DX::BoundingTree& tree)
+	{
+		printf("  %-22s %9.2f ms, height %d, cost %.1f\n", step, ms, tree.GetHeight(), tree.ComputeCost());
+	}
+
+	bool FrustumTouches(const DX::Frustum& frustum, const float min[3], const float max[3])
+	{
+		for (const float* plane : frustum.planes)
+		{
+			float distance = plane[3], reach = 0.0f;
+			for (int a = 0; a < 3; ++a)
+			{
+				distance += plane[a] * 0.5f * (min[a] + max[a]);
+				reach += fabsf(plane[a]) * 0.5f * (max[a] - min[a]);
+			}
+			if (distance + reach < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	bool SphereTouches(const float center[3], float radius, const float min[3], const float max[3])
+	{
+		float squared = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			float d = center[a] < min[a] ? min[a] - center[a] : (center[a] > max[a] ? center[a] - max[a] : 0.0f);
+			squared += d * d;
+		}
+		return squared <= radius * radius;
+	}
+
+	// Entry distance along the ray, or a negative value if it misses within length.
+	float RayEntry(const float origin[3], const float direction[3], float length, const float min[3], const float max[3])
+	{
+		float enter = 0.0f, leave = length;
+		for (int a = 0; a < 3; ++a)
+		{
+			float d = fabsf(direction[a]) < 1e-20f ? 1e-20f : direction[a];
+			float t1 = (min[a] - origin[a]) / d, t2 = (max[a] - origin[a]) / d;
+			enter = fmaxf(enter, fminf(t1, t2));
+			leave = fminf(leave, fmaxf(t1, t2));
+		}
+		return enter <= leave ? enter : -1.0f;
+	}
+
+	// Live objects whose fat box passes test.
+	template <typename Test>
+	std::vector<uint32_t> BruteForce(const DX::BoundingTree& tree, const std::vector<Object>& objects, Test test)
+	{
+		std::vector<uint32_t> found;
+		for (uint32_t i = 0; i < objects.size(); ++i)
+		{
+			if (!objects[i].alive)
+				continue;
+			float min[3], max[3];
+			tree.GetFatBounds(objects[i].proxy, min, max);
+			if (test(min, max))
+				found.push_back(i);
+		}
+		return found;
+	}
+
+	bool CheckQueries(const DX::BoundingTree& tree, const std::vector<Object>& objects, uint32_t iterations)
+	{
+		float h = 1.0f / tanf(0.6f), w = h / 1.7f, r = 100.0f / (100.0f - 0.01f);
+		const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * 0.01f, 0 };
+		const DX::Frustum frustum = DX::ExtractFrustum(projection);
+		bool passed = true;
+
+		std::vector<uint32_t> results;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			results.clear();
+			tree.QueryFrustum(frustum, results);
+		}
+		double frustumMs = Milliseconds(start) / iterations;
+		start = std::chrono::steady_clock::now();
+		std::vector<uint32_t> expected = BruteForce(tree, objects, [&](const float* min, const float* max) { return FrustumTouches(frustum, min, max); });
+		double bruteMs = Milliseconds(start);
+		std::sort(results.begin(), results.end());
+		if (results != expected)
+		{
+			printf("frustum query: %zu objects, brute force %zu\n", results.size(), expected.size());
+			passed = false;
+		}
+		printf("  frustum query %.3f ms (%zu objects), brute force %.3f ms\n", frustumMs, results.size(), bruteMs);
+
+		uint32_t state = 31;
+		size_t sphereHits = 0;
+		for (uint32_t i = 0; i < 50; ++i)
+		{
+			const float center[3] = { RandomFloat(state, -100.0f, 100.0f), RandomFloat(state, -100.0f, 100.0f), RandomFloat(state, -100.0f, 100.0f) };
+			float radius = RandomFloat(state, 0.0f, 20.0f);
+			results.clear();
+			tree.QuerySphere(center, radius, results);
+			std::sort(results.begin(), results.end());
+			expected = BruteForce(tree, objects, [&](const float* min, const float* max) { return SphereTouches(center, radius, min, max); });
+			if (results != expected)
+			{
+				printf("sphere query %u: %zu objects, brute force %zu\n", i, results.size(), expected.size());
+				passed = false;
+			}
+			sphereHits += results.size();
+		}
+		const float center[3] = { 10.0f, 5.0f, -3.0f };
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations * 10; ++i)
+		{
+			results.clear();
+			tree.QuerySphere(center, 15.0f, results);
+		}
+		printf("  sphere query %.4f ms (%zu objects), 50 random spheres against brute force, %zu objects\n",
+			   Milliseconds(start) / (iterations * 10), results.size(), sphereHits);
+
+		size_t rayHits = 0;
+		for (uint32_t i = 0; i < Rays; ++i)
+		{
+			const float origin[3] = { RandomFloat(state, -125.0f, 125.0f), RandomFloat(state, -125.0f, 125.0f), RandomFloat(state, -125.0f, 125.0f) };
+			// Every seventh ray runs parallel to the xy plane, so one slab test divides by zero.
+			float direction[3] = { RandomFloat(state, -0.5f, 0.5f), RandomFloat(state, -0.5f, 0.5f), i % 7 == 0 ? 0.0f : RandomFloat(state, -0.5f, 0.5f) };
+			float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+			for (float& d : direction)
+			{
+				d /= length;
+			}
+			results.clear();
+			tree.QueryRay(origin, direction, RayLength, results);
+			std::sort(results.begin(), results.end());
+			float nearest = 1e30f;
+			expected = BruteForce(tree, objects, [&](const float* min, const float* max)
+			{
+				float entry = RayEntry(origin, direction, RayLength, min, max);
+				nearest = entry >= 0.0f ? fminf(nearest, entry) : nearest;
+				return entry >= 0.0f;
+			});
+			float distance = -1.0f;
+			uint32_t hit = tree.RayCast(origin, direction, RayLength, &distance);
+			if (results != expected || (hit == DX::BoundingTree::NullNode) != expected.empty() ||
+				(hit != DX::BoundingTree::NullNode && fabsf(distance - nearest) > 1e-3f))
+			{
+				printf("ray %u: %zu objects, brute force %zu, cast hits at %g, nearest %g\n", i, results.size(), expected.size(), distance, nearest);
+				passed = false;
+			}
+			rayHits += results.size();
+		}
+		const float origin[3] = { 0.0f, 0.0f, -150.0f }, direction[3] = { 0.01f, 0.02f, 0.9997f };
+		start = std::chrono::steady_clock::now();
+		uint32_t casts = 0;
+		for (uint32_t i = 0; i < iterations * 100; ++i)
+		{
+			casts += tree.RayCast(origin, direction, 400.0f) != DX::BoundingTree::NullNode ? 1 : 0;
+		}
+		printf("  ray cast %.5f ms (%s); %u random rays against brute force, %zu objects%s\n", Milliseconds(start) / (iterations * 100),
+			   casts ? "hit" : "missed", Rays, rayHits, passed ? "" : "; FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? size_t(atoi(argv[1])) : 200000;
+	uint32_t iterations = argc > 2 ? uint32_t(atoi(argv[2])) : 100;
+	if (argc > 3 || count < 100 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [objects, at least 100] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	uint32_t state = 3;
+	DX::BoundingTree tree(0.1f);
+	std::vector<Object> objects(count);
+	printf("%zu objects:\n", count);
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Object& object = objects[i];
+		for (int a = 0; a < 3; ++a)
+		{
+			float center = RandomFloat(state, -100.0f, 100.0f), extent = RandomFloat(state, 0.1f, 1.1f);
+			object.min[a] = center - extent;
+			object.max[a] = center + extent;
+		}
+		object.proxy = tree.Insert(object.min, object.max, i);
+		object.alive = true;
+	}
+	Report("build", Milliseconds(start), tree);
+	bool passed = Validate("build", tree, objects);
+
+	start = std::chrono::steady_clock::now();
+	uint32_t reinserted = 0;
+	for (Object& object : objects)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			float step = RandomFloat(state, -1.0f, 1.0f);
+			object.min[a] += step;
+			object.max[a] += step;
+		}
+		reinserted += tree.Move(object.proxy, object.min, object.max) ? 1 : 0;
+	}
+	Report("move every object", Milliseconds(start), tree);
+	printf("  %u moves reinserted their leaf\n", reinserted);
+	passed &= Validate("move", tree, objects);
+
+	start = std::chrono::steady_clock::now();
+	for (Object& object : objects)
+	{
+		for (int a = 0; a < 3; ++a)
+		{
+			object.min[a] += 0.05f * (a + 1);
+			object.max[a] += 0.05f * (a + 1);
+		}
+		tree.Refit(object.proxy, object.min, object.max);
+	}
+	Report("refit every leaf", Milliseconds(start), tree);
+	passed &= Validate("refit", tree, objects);
+
+	start = std::chrono::steady_clock::now();
+	tree.RefitAll();
+	Report("RefitAll", Milliseconds(start), tree);
+	start = std::chrono::steady_clock::now();
+	tree.Rebalance(tree.GetNodeCount() * 2);
+	Report("rebalance every node", Milliseconds(start), tree);
+	passed &= Validate("rebalance", tree, objects);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; i += 3)
+	{
+		tree.Remove(objects[i].proxy);
+		objects[i].alive = false;
+	}
+	Report("remove every third", Milliseconds(start), tree);
+	passed &= Validate("remove", tree, objects);
+
+	passed &= CheckQueries(tree, objects, iterations);
+	return passed ? 0 : 1;
+}
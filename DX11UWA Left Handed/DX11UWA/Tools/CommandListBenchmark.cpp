@@ -0,0 +1,397 @@
+// Checks and times CommandList, the per-thread recording that the submission thread replays in order.
+//
+//   CommandListBenchmark [draws] [lists] [iterations]
+//
+// Builds a frame of draws (default 1000000) that use every call of IRenderBackend, sorted the
+// way the render queue sorts them, so most state repeats from one draw to the next. Records it
+// once on one thread through a StateCache straight into a backend that only counts and hashes
+// the calls it gets, then splits it into lists (default 8) recorded in parallel on the worker
+// pool, each through its own StateCache. Replaying every list into the same kind of backend must
+// give exactly the calls its StateCache passed on, with 64-bit handles and negative base vertices
+// intact, and replaying all of them in order through one immediate StateCache must give exactly
+// the calls of the serial recording. Replaying twice must give the same calls again, and a Reset
+// list recorded again must come out the same size. Times serial recording, parallel recording
+// and both replays over iterations (default 10) frames and prints nanoseconds per draw. Exits
+// with 1 on any mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common CommandListBenchmark.cpp ..\DX11UWA\Common\CommandList.cpp ..\DX11UWA\Common\StateCache.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common CommandListBenchmark.cpp ../DX11UWA/Common/{CommandList,StateCache,WorkerPool}.cpp
+
+#include "CommandList.h"
+#include "RenderDevice.h"
+#include "StateCache.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Counts the calls it gets and folds every argument into an FNV-style hash, a word at a time,
+	// so two call streams are the same exactly when count and hash are (barring collisions).
+	class HashingBackend : public DX::IRenderBackend
+	{
+	public:
+		HashingBackend() : m_hash(1469598103934665603ull), m_calls(0), m_draws(0) {}
+
+		uint64_t GetHash(void) const { return m_hash; }
+		size_t GetCallCount(void) const { return m_calls; }
+		size_t GetDrawCount(void) const { return m_draws; }
+		bool Same(const HashingBackend& other) const
+		{
+			return m_hash == other.m_hash && m_calls == other.m_calls && m_draws == other.m_draws;
+		}
+
+		void SetInputLayout(const void* layout) override
+		{
+			Call(1);
+			Mix(layout);
+		}
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) override
+		{
+			Call(2);
+			Mix(slot);
+			Mix(buffer);
+			Mix(stride);
+			Mix(offset);
+		}
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) override
+		{
+			Call(3);
+			Mix(buffer);
+			Mix(format);
+			Mix(offset);
+		}
+		void SetPrimitiveTopology(uint32_t topology) override
+		{
+			Call(4);
+			Mix(topology);
+		}
+		void SetShader(DX::ShaderStage stage, const void* shader) override
+		{
+			Call(5);
+			Mix(stage);
+			Mix(shader);
+		}
+		void SetConstantBuffer(DX::ShaderStage stage, uint32_t slot, const void* buffer, uint32_t firstConstant, uint32_t constantCount) override
+		{
+			Call(6);
+			Mix(stage);
+			Mix(slot);
+			Mix(buffer);
+			Mix(firstConstant);
+			Mix(constantCount);
+		}
+		void SetShaderResource(DX::ShaderStage stage, uint32_t slot, const void* view) override
+		{
+			Call(7);
+			Mix(stage);
+			Mix(slot);
+			Mix(view);
+		}
+		void SetSampler(DX::ShaderStage stage, uint32_t slot, const void* sampler) override
+		{
+			Call(8);
+			Mix(stage);
+			Mix(slot);
+			Mix(sampler);
+		}
+		void SetRasterizerState(const void* state) override
+		{
+			Call(9);
+			Mix(state);
+		}
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override
+		{
+			Call(10);
+			Mix(indexCount);
+			Mix(startIndex);
+			Mix(uint64_t(int64_t(baseVertex)));
+			++m_draws;
+		}
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override
+		{
+			Call(11);
+			Mix(indexCount);
+			Mix(instanceCount);
+			Mix(startIndex);
+			Mix(uint64_t(int64_t(baseVertex)));
+			Mix(startInstance);
+			++m_draws;
+		}
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size) override
+		{
+			Call(12);
+			Mix(buffer);
+			Mix(data);
+			Mix(size);
+		}
+
+	private:
+		void Call(uint64_t op)
+		{
+			++m_calls;
+			Mix(op);
+		}
+		void Mix(uint64_t value) { m_hash = (m_hash ^ value) * 1099511628211ull; }
+		void Mix(const void* pointer) { Mix(uint64_t(reinterpret_cast<uintptr_t>(pointer))); }
+
+		uint64_t m_hash;
+		size_t m_calls;
+		size_t m_draws;
+	};
+
+	// A fake handle. On 64-bit builds the high word is set too, so losing it in a list shows.
+	const void* Handle(uintptr_t id)
+	{
+		return reinterpret_cast<const void*>(id * 16 + (uintptr_t(0xabc) << (sizeof(uintptr_t) * 8 - 12)));
+	}
+
+	struct Draw
+	{
+		const void* inputLayout;
+		const void* shaders[DX::StageCount];
+		const void* texture;
+		const void* sampler;
+		const void* vertexBuffer;
+		const void* indexBuffer;
+		uint32_t firstConstant;
+		uint32_t indexCount;
+		uint32_t startIndex;
+		int32_t baseVertex;
+		uint32_t topology;
+		uint32_t instances;		// 0 for DrawIndexed.
+		bool update;
+	};
+
+	// Four pipelines, 64 materials, a mesh every three draws; what the sorted queue hands over.
+	std::vector<Draw> MakeFrame(size_t count)
+	{
+		std::vector<Draw> draws(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			Draw& draw = draws[i];
+			size_t pipeline = i * 4 / count, material = i * 64 / count, mesh = i / 3;
+			draw.inputLayout = Handle(1 + pipeline % 2);
+			for (uint32_t stage = 0; stage < DX::StageCount; ++stage)
+			{
+				// Half the pipelines are tessellated; the others unbind the hull and domain shaders.
+				bool tessellated = pipeline % 2 == 1;
+				bool used = stage == DX::StageVertex || stage == DX::StagePixel || tessellated;
+				draw.shaders[stage] = used ? Handle(10 + pipeline * DX::StageCount + stage) : nullptr;
+			}
+			draw.texture = Handle(100 + material / 2);
+			draw.sampler = Handle(200 + material / 16);
+			draw.vertexBuffer = Handle(1000 + mesh);
+			draw.indexBuffer = Handle(2000000 + mesh);
+			draw.firstConstant = static_cast<uint32_t>(i * 16);
+			draw.indexCount = 300 + static_cast<uint32_t>(mesh % 7) * 3;
+			draw.startIndex = static_cast<uint32_t>(i % 3) * 900;
+			draw.baseVertex = -static_cast<int32_t>(i % 5);
+			draw.topology = pipeline % 2 == 1 ? DX::TopologyFirstPatchList + 2 : DX::TopologyTriangleList;
+			draw.instances = i % 17 == 0 ? 4 : 0;
+			draw.update = i % 64 == 0;
+		}
+		return draws;
+	}
+
+	// What the renderer sets once per frame and per list.
+	void RecordShared(DX::StateCache& cache)
+	{
+		cache.SetRasterizerState(Handle(5));
+		cache.SetConstantBuffer(DX::StagePixel, 0, Handle(902));
+	}
+
+	void Record(DX::StateCache& cache, const std::vector<Draw>& draws, size_t begin, size_t end)
+	{
+		const void* constants = Handle(900);
+		const void* instanceData = Handle(901);
+		for (size_t i = begin; i < end; ++i)
+		{
+			const Draw& draw = draws[i];
+			if (draw.update)
+				cache.UpdateBuffer(constants, &draw, sizeof(Draw));
+			cache.SetInputLayout(draw.inputLayout);
+			for (uint32_t stage = 0; stage < DX::StageCount; ++stage)
+			{
+				cache.SetShader(DX::ShaderStage(stage), draw.shaders[stage]);
+			}
+			cache.SetConstantBuffer(DX::StageVertex, 0, constants, draw.firstConstant, 16);
+			cache.SetConstantBuffer(DX::StageDomain, 0, constants, draw.firstConstant, 16);
+			cache.SetShaderResource(DX::StagePixel, 0, draw.texture);
+			cache.SetSampler(DX::StagePixel, 0, draw.sampler);
+			cache.SetVertexBuffer(0, draw.vertexBuffer, 36, 0);
+			cache.SetIndexBuffer(draw.indexBuffer, DX::FormatR32Uint, 0);
+			cache.SetPrimitiveTopology(draw.topology);
+			if (draw.instances)
+			{
+				cache.SetVertexBuffer(1, instanceData, 48, 0);
+				cache.DrawIndexedInstanced(draw.indexCount, draw.instances, draw.startIndex, draw.baseVertex, static_cast<uint32_t>(i));
+			}
+			else
+			{
+				cache.DrawIndexed(draw.indexCount, draw.startIndex, draw.baseVertex);
+			}
+		}
+	}
+
+	const char* Verdict(bool same)
+	{
+		return same ? "same" : "DIFFERS; FAILED";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 1000000;
+	size_t listCount = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 8;
+	int iterations = argc > 3 ? atoi(argv[3]) : 10;
+	if (count < listCount || listCount < 1 || iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [draws] [lists] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<Draw> draws = MakeFrame(count);
+	std::vector<DX::CommandList> lists(listCount);
+	auto range = [&](size_t list, size_t& begin, size_t& end)
+	{
+		begin = count * list / listCount;
+		end = count * (list + 1) / listCount;
+	};
+	auto recordLists = [&](void)
+	{
+		DX::WorkerPool::Shared().ParallelFor(listCount, 1, [&](size_t first, size_t last)
+		{
+			for (size_t list = first; list < last; ++list)
+			{
+				size_t begin, end;
+				range(list, begin, end);
+				lists[list].Reset();
+				DX::StateCache cache(&lists[list]);
+				RecordShared(cache);
+				Record(cache, draws, begin, end);
+			}
+		});
+	};
+	bool passed = true;
+
+	// Serial recording straight into the hashing backend is the reference.
+	HashingBackend serial;
+	{
+		DX::StateCache cache(&serial);
+		RecordShared(cache);
+		Record(cache, draws, 0, count);
+	}
+
+	// Each list must hold exactly what its StateCache passed on.
+	recordLists();
+	size_t wrongLists = 0, commands = 0, bytes = 0;
+	for (size_t list = 0; list < listCount; ++list)
+	{
+		size_t begin, end;
+		range(list, begin, end);
+		HashingBackend direct, replayed;
+		DX::StateCache cache(&direct);
+		RecordShared(cache);
+		Record(cache, draws, begin, end);
+		lists[list].Replay(replayed);
+		wrongLists += direct.Same(replayed) && lists[list].GetCommandCount() == direct.GetCallCount() ? 0 : 1;
+		commands += lists[list].GetCommandCount();
+		bytes += lists[list].GetSizeBytes();
+	}
+	printf("%zu draws in %zu lists: %zu commands, %.1f bytes per draw; %zu lists replay differently from their StateCache%s\n", count,
+		   listCount, commands, double(bytes) / count, wrongLists, wrongLists ? "; FAILED" : "");
+	passed = passed && !wrongLists;
+
+	// In order through one immediate StateCache, the lists must give the serial calls, every time.
+	HashingBackend merged, again;
+	{
+		DX::StateCache immediate(&merged);
+		RecordShared(immediate);
+		for (const DX::CommandList& list : lists)
+		{
+			list.Replay(immediate);
+		}
+		DX::StateCache second(&again);
+		RecordShared(second);
+		for (const DX::CommandList& list : lists)
+		{
+			list.Replay(second);
+		}
+	}
+	printf("serial %zu calls, %zu draws; lists through the immediate StateCache %zu calls, %zu draws: %s; replayed again: %s\n",
+		   serial.GetCallCount(), serial.GetDrawCount(), merged.GetCallCount(), merged.GetDrawCount(), Verdict(serial.Same(merged)),
+		   Verdict(serial.Same(again)));
+	passed = passed && serial.Same(merged) && serial.Same(again);
+
+	// A second frame of the same draws, recorded after Reset, must come out the same size.
+	std::vector<size_t> sizes;
+	for (const DX::CommandList& list : lists)
+	{
+		sizes.push_back(list.GetSizeBytes());
+	}
+	recordLists();
+	size_t grown = 0;
+	for (size_t list = 0; list < listCount; ++list)
+	{
+		grown += lists[list].GetSizeBytes() == sizes[list] ? 0 : 1;
+	}
+	if (grown)
+	{
+		printf("%zu lists changed size when recorded again; FAILED\n", grown);
+		passed = false;
+	}
+
+	double serialMs = 0.0, recordMs = 0.0, immediateMs = 0.0, rawMs = 0.0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		HashingBackend backend;
+		auto start = std::chrono::steady_clock::now();
+		{
+			DX::StateCache cache(&backend);
+			RecordShared(cache);
+			Record(cache, draws, 0, count);
+		}
+		serialMs += Milliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		recordLists();
+		recordMs += Milliseconds(start);
+
+		HashingBackend immediateBackend;
+		start = std::chrono::steady_clock::now();
+		{
+			DX::StateCache immediate(&immediateBackend);
+			RecordShared(immediate);
+			for (const DX::CommandList& list : lists)
+			{
+				list.Replay(immediate);
+			}
+		}
+		immediateMs += Milliseconds(start);
+
+		HashingBackend rawBackend;
+		start = std::chrono::steady_clock::now();
+		for (const DX::CommandList& list : lists)
+		{
+			list.Replay(rawBackend);
+		}
+		rawMs += Milliseconds(start);
+	}
+	double toNanoseconds = 1e6 / iterations / count;
+	printf("%u threads, %d iterations, per draw:\n", DX::WorkerPool::Shared().GetConcurrency(), iterations);
+	printf("  %-44s %6.1f ns\n", "serial recording through StateCache", serialMs * toNanoseconds);
+	printf("  %-44s %6.1f ns\n", "recording the lists on the worker pool", recordMs * toNanoseconds);
+	printf("  %-44s %6.1f ns\n", "replay through the immediate StateCache", immediateMs * toNanoseconds);
+	printf("  %-44s %6.1f ns\n", "replay straight into the backend", rawMs * toNanoseconds);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+// Checks ConstantRing, the per-draw constant allocator behind the renderer's *SetConstantBuffers1 binds.
+//
+//   ConstantRingCheck [frames] [capacity]
+//
+// Runs the ring on a backend that behaves like a driver renaming a dynamic buffer: a discard map
+// hands out fresh memory, a no-overwrite map the memory already in use, which earlier draws may
+// still read. Every slice must be 256-byte aligned, rounded up to whole alignments and point into
+// the mapped memory at its offset. Maps must discard exactly when the ring starts over at offset
+// 0, the first map included, never while slices wait for Flush, and otherwise no slice may
+// overlap one written since the last discard. Every slice must still hold what was written to it when the draws read it, at Flush
+// and up to the discard that retires its memory. A script covers the edge cases: the wrap at
+// BeginFrame, Allocate returning nullptr rather than wrapping over slices not yet flushed, and
+// sizes that never fit. Then plays frames (default 2000) random frames of draws and flushes on a
+// capacity (default 65536) byte ring, where an allocation may only fail if it can't fit behind
+// unflushed slices, and checks the counters against the backend's. Last, the renderer's
+// fallback: slices uploaded through MemoryRingBackend must read back from its Data. Exits with 1
+// on any failure. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common ConstantRingCheck.cpp ..\DX11UWA\Common\ConstantRing.cpp
+//   g++ -O2 -I../DX11UWA/Common ConstantRingCheck.cpp ../DX11UWA/Common/ConstantRing.cpp
+
+#include "ConstantRing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const uint32_t Alignment = DX::ConstantRing::Alignment;
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// A discard map gets a new block, as a driver renames the buffer; the old one stays readable.
+	class RenamingBackend : public DX::IConstantRingBackend
+	{
+	public:
+		explicit RenamingBackend(uint32_t capacity) : capacity(capacity), mapped(false), maps(0), discards(0), misuse(0) {}
+
+		void* Map(bool discard) override
+		{
+			if (mapped || (!discard && blocks.empty()))
+				++misuse;
+			mapped = true;
+			++maps;
+			if (discard)
+			{
+				++discards;
+				blocks.push_back(std::vector<uint8_t>(capacity, 0xcd));
+			}
+			return blocks.empty() ? nullptr : blocks.back().data();
+		}
+
+		void Unmap(void) override
+		{
+			if (!mapped)
+				++misuse;
+			mapped = false;
+		}
+
+		uint32_t capacity;
+		bool mapped;
+		uint32_t maps;
+		uint32_t discards;
+		uint32_t misuse;	// Maps while mapped, unmaps while not, and a first map that doesn't discard.
+		std::vector<std::vector<uint8_t>> blocks;
+	};
+
+	struct Written
+	{
+		size_t block;
+		DX::RingSlice slice;
+		std::vector<uint8_t> data;
+	};
+
+	// Allocates through the ring and keeps what each slice should hold until its block retires.
+	class Checker
+	{
+	public:
+		explicit Checker(uint32_t capacity) :
+			backend(capacity), ring(capacity, &backend), passed(true), m_head(0), m_pending(0), m_peak(0), m_frameBytes(0)
+		{
+		}
+
+		bool Fail(const char* what)
+		{
+			if (passed)
+				printf("%s\n", what);
+			passed = false;
+			return false;
+		}
+
+		// Allocates size bytes and fills them, returning whether the ring handed out a slice.
+		bool Allocate(uint32_t size, uint32_t& state)
+		{
+			size_t blocksBefore = backend.blocks.size();
+			DX::RingSlice slice;
+			uint8_t* data = static_cast<uint8_t*>(ring.Allocate(size, slice));
+			if (!data)
+				return false;
+
+			uint32_t aligned = (size + Alignment - 1) / Alignment * Alignment;
+			if (slice.offset % Alignment != 0 || slice.size != aligned || slice.offset + slice.size > ring.GetCapacity() ||
+				slice.FirstConstant() * 16 != slice.offset || slice.ConstantCount() * 16 != slice.size)
+				return Fail("slice not aligned, sized or placed as expected");
+			if (!backend.mapped || data != backend.blocks.back().data() + slice.offset)
+				return Fail("slice doesn't point into the mapped buffer at its offset");
+
+			if (backend.blocks.size() != blocksBefore)
+			{
+				// Discarded: only when starting over, with every slice drawn, and when the old memory was out of room.
+				if (slice.offset != 0)
+					return Fail("discard map for a slice not at offset 0");
+				if (m_pending > 0)
+					return Fail("discarded slices not flushed yet, whose draws would read the new memory");
+				if (blocksBefore > 0 && ring.GetCapacity() - m_head >= aligned && ring.GetCapacity() - m_head >= m_peak)
+					return Fail("discarded with room left for the allocation and the largest frame");
+				Retire();
+				m_head = 0;
+			}
+			else if (slice.offset < m_head)
+			{
+				return Fail("no-overwrite slice overlaps one written since the last discard");
+			}
+			m_head = slice.offset + slice.size;
+			m_frameBytes += aligned;
+
+			Written written = { backend.blocks.size() - 1, slice, std::vector<uint8_t>(size) };
+			for (uint8_t& byte : written.data)
+			{
+				byte = uint8_t(Random(state));
+			}
+			if (size)
+				memcpy(data, written.data.data(), size);
+			m_live.push_back(written);
+			++m_pending;
+			return true;
+		}
+
+		void Flush(void)
+		{
+			ring.Flush();
+			if (backend.mapped)
+				Fail("buffer still mapped after Flush");
+			Draw();
+			m_pending = 0;
+		}
+
+		void BeginFrame(void)
+		{
+			ring.BeginFrame();
+			Draw();
+			m_pending = 0;
+			m_peak = m_frameBytes > m_peak ? m_frameBytes : m_peak;
+			m_frameBytes = 0;
+		}
+
+		// Whether an allocation may fail: only if it can't fit behind slices not yet flushed.
+		bool MayFail(uint32_t size) const
+		{
+			uint32_t aligned = (size + Alignment - 1) / Alignment * Alignment;
+			return aligned == 0 || aligned > ring.GetCapacity() || (m_pending > 0 && ring.GetCapacity() - m_head < aligned);
+		}
+
+		// Reads every slice still live, as the draws would.
+		void Draw(void)
+		{
+			for (const Written& written : m_live)
+			{
+				const uint8_t* block = backend.blocks[written.block].data();
+				if (memcmp(block + written.slice.offset, written.data.data(), written.data.size()) != 0)
+				{
+					Fail("a slice was overwritten before its draws were done with it");
+					return;
+				}
+			}
+		}
+
+		RenamingBackend backend;
+		DX::ConstantRing ring;
+		bool passed;
+
+	private:
+		void Retire(void)
+		{
+			Draw();
+			m_live.clear();
+		}
+
+		std::vector<Written> m_live;
+		uint32_t m_head;
+		uint32_t m_pending;
+		uint32_t m_peak;
+		uint32_t m_frameBytes;
+	};
+
+	bool CheckScript(void)
+	{
+		Checker c(1024 + 100);
+		uint32_t state = 1;
+		if (c.ring.GetCapacity() != 1024)
+			c.Fail("capacity not rounded down to the alignment");
+
+		c.ring.BeginFrame();
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			if (!c.Allocate(192, state))
+				c.Fail("first frame doesn't fit");
+		}
+		c.Flush();
+		if (c.backend.maps != 1 || c.backend.discards != 1)
+			c.Fail("first frame: not one discard map");
+
+		// 256 bytes left can't hold another 768 byte frame, so the ring starts over.
+		c.BeginFrame();
+		if (!c.Allocate(192, state) || c.backend.discards != 2)
+			c.Fail("BeginFrame didn't start over");
+		c.Flush();
+		if (!c.Allocate(16, state) || c.backend.maps != 3 || c.backend.discards != 2)
+			c.Fail("second map of a frame discarded");
+
+		// The rest of the ring holds two slices; the third would have to wrap over unflushed ones.
+		uint32_t failedBefore = c.ring.GetStats().failed;
+		uint32_t mapsBefore = c.backend.maps;
+		bool fits = c.Allocate(256, state) && c.Allocate(256, state);
+		DX::RingSlice slice;
+		if (!fits || c.ring.Allocate(16, slice) || c.ring.GetStats().failed != failedBefore + 1 || c.backend.maps != mapsBefore ||
+			!c.backend.mapped)
+			c.Fail("wrapped over slices not yet flushed");
+		c.Flush();
+		if (!c.Allocate(16, state) || c.backend.discards != 3)
+			c.Fail("after Flush the ring doesn't start over");
+		c.Flush();
+
+		failedBefore = c.ring.GetStats().failed;
+		if (c.ring.Allocate(0, slice) || c.ring.Allocate(1025, slice) || c.ring.GetStats().failed != failedBefore + 2)
+			c.Fail("empty or oversized allocation succeeded");
+		DX::ConstantRing detached(1024, nullptr);
+		if (detached.Allocate(16, slice))
+			c.Fail("ring without a backend allocated");
+
+		const DX::ConstantRingStats frame = c.ring.GetStats();
+		c.BeginFrame();
+		if (c.ring.GetLastFrameStats().allocations != frame.allocations || c.ring.GetStats().allocations != 0 || frame.allocations != 5 ||
+			frame.bytes != 5 * 256 || frame.failed != 3)
+			c.Fail("counters not moved to the last frame");
+		if (c.backend.misuse)
+			c.Fail("map and unmap calls out of order");
+		c.Draw();
+		printf("script: %u maps, %u discards%s\n", c.backend.maps, c.backend.discards, c.passed ? "" : "; FAILED");
+		return c.passed;
+	}
+
+	bool CheckRandom(uint32_t frames, uint32_t capacity)
+	{
+		Checker c(capacity);
+		uint32_t state = 7;
+		uint64_t allocations = 0, retries = 0, bytes = 0;
+		uint32_t maps = 0, discards = 0;
+		for (uint32_t frame = 0; frame < frames && c.passed; ++frame)
+		{
+			// Mostly the renderer's few hundred bytes per draw, now and then a frame much larger.
+			uint32_t draws = 1 + Random(state) % (Random(state) % 16 == 0 ? 200 : 40);
+			for (uint32_t draw = 0; draw < draws && c.passed; ++draw)
+			{
+				uint32_t size = Random(state) % 8 == 0 ? 1 + Random(state) % 2048 : 16 * (1 + Random(state) % 24);
+				bool mayFail = c.MayFail(size);
+				if (!c.Allocate(size, state))
+				{
+					if (!mayFail)
+						c.Fail("allocation failed with room behind the unflushed slices");
+					// The renderer flushes and draws what it has, then tries again.
+					c.Flush();
+					++retries;
+					if (!c.Allocate(size, state))
+						c.Fail("allocation failed right after Flush");
+				}
+				++allocations;
+				bytes += size;
+				if (Random(state) % 16 == 0)
+					c.Flush();
+			}
+			const DX::ConstantRingStats stats = c.ring.GetStats();
+			if (stats.maps != c.backend.maps - maps || stats.discards != c.backend.discards - discards)
+				c.Fail("map counters differ from the backend's");
+			maps = c.backend.maps;
+			discards = c.backend.discards;
+			c.BeginFrame();
+		}
+		c.Draw();
+		if (c.backend.misuse)
+			c.Fail("map and unmap calls out of order");
+		printf("random: %u frames, %llu allocations of %llu bytes on a %u byte ring, %u maps, %u discards, %llu retries after Flush%s\n",
+			   frames, static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(bytes), capacity, c.backend.maps,
+			   c.backend.discards, static_cast<unsigned long long>(retries), c.passed ? "" : "; FAILED");
+		return c.passed;
+	}
+
+	bool CheckMemoryBackend(void)
+	{
+		DX::MemoryRingBackend memory(4096);
+		DX::ConstantRing ring(4096, &memory);
+		uint32_t state = 3;
+		bool passed = true;
+		for (uint32_t frame = 0; frame < 20; ++frame)
+		{
+			ring.BeginFrame();
+			for (uint32_t draw = 0; draw < 5; ++draw)
+			{
+				uint8_t constants[200];
+				for (uint8_t& byte : constants)
+				{
+					byte = uint8_t(Random(state));
+				}
+				DX::RingSlice slice;
+				passed &= ring.Upload(constants, sizeof(constants), slice);
+				passed &= memcmp(memory.Data() + slice.offset, constants, sizeof(constants)) == 0;
+			}
+			ring.Flush();
+		}
+		printf("MemoryRingBackend: uploads read back from Data%s\n", passed ? "" : "; FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = argc > 1 ? uint32_t(atoi(argv[1])) : 2000;
+	uint32_t capacity = argc > 2 ? uint32_t(atoi(argv[2])) : 64 * 1024;
+	if (argc > 3 || capacity < 4096)
+	{
+		fprintf(stderr, "usage: %s [frames] [capacity of at least 4096]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckScript();
+	passed &= CheckRandom(frames, capacity);
+	passed &= CheckMemoryBackend();
+	return passed ? 0 : 1;
+}
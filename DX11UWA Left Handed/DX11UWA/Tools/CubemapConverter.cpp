@@ -0,0 +1,71 @@
+// Offline converter that turns a skybox source into Assets/OutputCube.dds.
+//
+//   CubemapConverter <output.dds> <faceSize> <equirect.dds>
+//   CubemapConverter <output.dds> <faceSize> <+x.dds> <-x.dds> <+y.dds> <-y.dds> <+z.dds> <-z.dds>
+//
+// Sources must be uncompressed 32-bit DDS files. The output is a cube map with a full
+// mip chain that CreateDDSTextureFromFile loads as-is. The converter only depends on the
+// portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common CubemapConverter.cpp ..\DX11UWA\Common\CubemapBuilder.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common CubemapConverter.cpp ../DX11UWA/Common/{CubemapBuilder,DDSFile,DDSFormatConvert,WorkerPool}.cpp
+
+#include "CubemapBuilder.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv)
+{
+	if (argc != 4 && argc != 9)
+	{
+		fprintf(stderr, "usage: %s <output.dds> <faceSize> <equirect.dds | +x -x +y -y +z -z>\n", argv[0]);
+		return 1;
+	}
+
+	DX::CubemapSettings settings;
+	settings.faceSize = static_cast<uint32_t>(atoi(argv[2]));
+
+	DX::DDSImage sources[6];
+	int sourceCount = argc - 3;
+	for (int i = 0; i < sourceCount; ++i)
+	{
+		if (!DX::ReadDDSFile(argv[3 + i], sources[i]))
+		{
+			fprintf(stderr, "%s: not an uncompressed 32-bit DDS file\n", argv[3 + i]);
+			return 1;
+		}
+	}
+
+	DX::WorkerPool pool;
+	DX::DDSImage cube;
+	auto start = std::chrono::steady_clock::now();
+
+	bool built;
+	if (sourceCount == 1)
+	{
+		built = DX::BuildCubemapFromEquirect(sources[0], settings, cube, pool);
+	}
+	else
+	{
+		const DX::DDSImage* faces[6] = { &sources[0], &sources[1], &sources[2], &sources[3], &sources[4], &sources[5] };
+		built = DX::BuildCubemapFromFaces(faces, settings, cube, pool);
+	}
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (!built)
+	{
+		fprintf(stderr, "conversion failed\n");
+		return 1;
+	}
+	if (!DX::WriteDDSFile(argv[1], cube))
+	{
+		fprintf(stderr, "%s: could not write\n", argv[1]);
+		return 1;
+	}
+
+	printf("%ux%u x6, %u mips in %.1f ms on %u threads\n", cube.width, cube.height, cube.mipLevels, elapsed, pool.GetConcurrency());
+	return 0;
+}
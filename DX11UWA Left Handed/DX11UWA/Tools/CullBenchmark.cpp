@@ -0,0 +1,338 @@
+// Checks and times FrustumCulling, the per-frame box test that keeps hidden draw items out of the queue.
+//
+//   CullBenchmark [boxes] [iterations]
+//
+// Checks the mesh bounds first: ComputeMeshBounds on strided point clouds must give their exact
+// box and a sphere holding every point, TransformBounds a box holding every transformed point,
+// MergeBounds a box holding both inputs. ExtractFrustum must give the planes of a perspective
+// view-projection computed here in double precision. Then scatters boxes (default 1000000) of
+// mixed sizes around a camera and culls them with CullBoxList, which splits them across the
+// worker pool, CullBoxes on one thread and CullBoxesScalar. All three must return the same
+// indices in the same order, for every begin and end offset around the SIMD width too, and
+// agree with a double precision box-against-plane test except for boxes touching a plane.
+// Each is timed over iterations (default 20) runs. Build with and without AVX2 to time both
+// SIMD paths. Exits with 1 on any mismatch. Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common CullBenchmark.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common CullBenchmark.cpp ../DX11UWA/Common/{FrustumCulling,WorkerPool}.cpp
+
+#include "FrustumCulling.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const double Touching = 1e-3;
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	float RandomFloat(uint32_t& state, float low, float high)
+	{
+		return low + (high - low) * float(Random(state) & 0xffff) / 65535.0f;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* SimdPath(void)
+	{
+#if DX_SIMD_AVX2
+		return "AVX2";
+#elif DX_SIMD_SSE2
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	void Multiply(const float a[16], const float b[16], float result[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; ++k)
+				{
+					sum += a[row * 4 + k] * b[k * 4 + column];
+				}
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// Left-handed look-at and perspective, row vectors, as XMMatrixLookAtLH and XMMatrixPerspectiveFovLH build them.
+	void ViewProjection(const float eye[3], const float at[3], float fovY, float aspect, float nearZ, float farZ, float result[16])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& v : z)
+		{
+			v /= length;
+		}
+		float x[3] = { z[2], 0.0f, -z[0] };	// up (0, 1, 0) cross z
+		length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length;
+		x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		const float view[16] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+			-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f,
+		};
+		float h = 1.0f / tanf(fovY / 2.0f), w = h / aspect, r = farZ / (farZ - nearZ);
+		const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * nearZ, 0 };
+		Multiply(view, projection, result);
+	}
+
+	// Inward planes of clip-space -w <= x, y <= w, 0 <= z <= w, in the Frustum order.
+	void ReferencePlanes(const float m[16], double planes[6][4])
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			double x = m[i * 4 + 0], y = m[i * 4 + 1], z = m[i * 4 + 2], w = m[i * 4 + 3];
+			planes[0][i] = w + x;
+			planes[1][i] = w - x;
+			planes[2][i] = w + y;
+			planes[3][i] = w - y;
+			planes[4][i] = z;
+			planes[5][i] = w - z;
+		}
+		for (int p = 0; p < 6; ++p)
+		{
+			double length = sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+			for (double& v : planes[p])
+			{
+				v /= length;
+			}
+		}
+	}
+
+	// 1 inside, 0 outside, -1 within Touching of a plane where float rounding may go either way.
+	int ReferenceVisible(const double planes[6][4], const DX::BoxList& boxes, size_t i)
+	{
+		const double c[3] = { boxes.CenterX()[i], boxes.CenterY()[i], boxes.CenterZ()[i] };
+		const double e[3] = { boxes.ExtentX()[i], boxes.ExtentY()[i], boxes.ExtentZ()[i] };
+		bool touching = false;
+		for (int p = 0; p < 6; ++p)
+		{
+			const double* n = planes[p];
+			double distance = n[0] * c[0] + n[1] * c[1] + n[2] * c[2] + n[3] + fabs(n[0]) * e[0] + fabs(n[1]) * e[1] + fabs(n[2]) * e[2];
+			if (distance < -Touching)
+				return 0;
+			touching |= distance < Touching;
+		}
+		return touching ? -1 : 1;
+	}
+
+	bool Contains(const DX::MeshBounds& box, const float p[3], float slack)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (p[i] < box.min[i] - slack || p[i] > box.max[i] + slack ||
+				fabsf(box.center[i] - (box.min[i] + box.max[i]) * 0.5f) > slack || fabsf(box.extents[i] - (box.max[i] - box.min[i]) * 0.5f) > slack)
+				return false;
+		}
+		float dx = p[0] - box.center[0], dy = p[1] - box.center[1], dz = p[2] - box.center[2];
+		return sqrtf(dx * dx + dy * dy + dz * dz) <= box.radius + slack;
+	}
+
+	bool CheckBounds(void)
+	{
+		uint32_t state = 5;
+		bool passed = true;
+		const float rotate[16] = { 0, 0, -1, 0, 0, 2, 0, 0, 1, 0, 0, 0, 5, -3, 7, 1 };
+		for (uint32_t mesh = 0; mesh < 50 && passed; ++mesh)
+		{
+			// Positions first in an 8-float vertex, as the scene's vertex buffers are laid out.
+			size_t count = 1 + Random(state) % 300;
+			std::vector<float> vertices(count * 8);
+			float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+			for (size_t v = 0; v < count; ++v)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					vertices[v * 8 + i] = RandomFloat(state, -10.0f, 10.0f) + (i < 3 ? float(mesh) : 100.0f);
+				}
+				for (int i = 0; i < 3; ++i)
+				{
+					low[i] = fminf(low[i], vertices[v * 8 + i]);
+					high[i] = fmaxf(high[i], vertices[v * 8 + i]);
+				}
+			}
+			DX::MeshBounds bounds = DX::ComputeMeshBounds(vertices.data(), count, 8 * sizeof(float));
+			DX::MeshBounds moved = DX::TransformBounds(bounds, rotate);
+			DX::MeshBounds other = DX::ComputeMeshBounds(vertices.data() + 8, count - 1, 8 * sizeof(float));
+			DX::MeshBounds merged = DX::MergeBounds(moved, count > 1 ? other : bounds);
+			for (int i = 0; i < 3; ++i)
+			{
+				passed &= bounds.min[i] == low[i] && bounds.max[i] == high[i];
+			}
+			for (size_t v = 0; v < count; ++v)
+			{
+				const float* p = &vertices[v * 8];
+				float q[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					q[i] = p[0] * rotate[i] + p[1] * rotate[4 + i] + p[2] * rotate[8 + i] + rotate[12 + i];
+				}
+				passed &= Contains(bounds, p, 1e-4f) && Contains(moved, q, 1e-3f) && Contains(merged, q, 1e-3f) &&
+						  (v == 0 || Contains(merged, p, 1e-3f));
+			}
+		}
+		float none = 0.0f;
+		DX::MeshBounds empty = DX::ComputeMeshBounds(&none, 0, 12);
+		passed &= empty.radius == 0.0f && empty.center[0] == 0.0f && empty.extents[1] == 0.0f;
+		printf("bounds: 50 meshes, boxes and spheres hold every point%s\n", passed ? "" : "; FAILED");
+		return passed;
+	}
+
+	bool CheckPlanes(const float viewProjection[16])
+	{
+		DX::Frustum frustum = DX::ExtractFrustum(viewProjection);
+		double planes[6][4];
+		ReferencePlanes(viewProjection, planes);
+		bool passed = true;
+		for (int p = 0; p < 6; ++p)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				passed &= fabs(frustum.planes[p][i] - planes[p][i]) < 1e-4 * (i == 3 ? 1.0 + fabs(planes[p][3]) : 1.0);
+			}
+		}
+		printf("planes: ExtractFrustum matches the double precision planes%s\n", passed ? "" : "; FAILED");
+		return passed;
+	}
+
+	void FillBoxes(DX::BoxList& boxes, size_t count, uint32_t& state)
+	{
+		boxes.Clear();
+		boxes.Reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Mostly small props, some buildings, a few huge ones that straddle many planes.
+			float size = Random(state) % 64 == 0 ? RandomFloat(state, 5.0f, 40.0f) : RandomFloat(state, 0.05f, 2.0f);
+			const float center[3] = { RandomFloat(state, -150.0f, 150.0f), RandomFloat(state, -20.0f, 40.0f), RandomFloat(state, -150.0f, 150.0f) };
+			const float extents[3] = { size * RandomFloat(state, 0.5f, 1.0f), size, size * RandomFloat(state, 0.5f, 1.0f) };
+			boxes.Add(center, extents);
+		}
+	}
+
+	bool CheckRanges(const DX::Frustum& frustum, const DX::BoxList& boxes)
+	{
+		std::vector<uint32_t> simd(64), scalar(64);
+		for (size_t begin = 0; begin < 17; ++begin)
+		{
+			for (size_t end = begin; end < begin + 40 && end <= boxes.Size(); ++end)
+			{
+				size_t found = DX::CullBoxes(frustum, boxes, begin, end, simd.data());
+				size_t expected = DX::CullBoxesScalar(frustum, boxes, begin, end, scalar.data());
+				bool same = found == expected;
+				for (size_t i = 0; same && i < found; ++i)
+				{
+					same = simd[i] == scalar[i];
+				}
+				if (!same)
+				{
+					printf("boxes %zu to %zu: CullBoxes differs from CullBoxesScalar\n", begin, end);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool Benchmark(size_t count, uint32_t iterations)
+	{
+		const float eye[3] = { 0.0f, 10.0f, -20.0f }, at[3] = { 20.0f, 0.0f, 60.0f };
+		float viewProjection[16];
+		ViewProjection(eye, at, 70.0f * 3.14159265f / 180.0f, 16.0f / 9.0f, 0.01f, 100.0f, viewProjection);
+		bool passed = CheckPlanes(viewProjection);
+
+		uint32_t state = 17;
+		DX::BoxList boxes;
+		FillBoxes(boxes, count, state);
+		DX::Frustum frustum = DX::ExtractFrustum(viewProjection);
+		passed &= CheckRanges(frustum, boxes);
+
+		std::vector<uint32_t> pooled, single(count), scalar(count);
+		DX::CullStats stats;
+		size_t singleCount = 0, scalarCount = 0;
+		double pooledMs = 0.0, singleMs = 0.0, scalarMs = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			stats = DX::CullBoxList(frustum, boxes, pooled);
+			pooledMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			singleCount = DX::CullBoxes(frustum, boxes, 0, count, single.data());
+			singleMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			scalarCount = DX::CullBoxesScalar(frustum, boxes, 0, count, scalar.data());
+			scalarMs += Milliseconds(start);
+		}
+
+		bool same = pooled.size() == scalarCount && singleCount == scalarCount && stats.visible == scalarCount &&
+					stats.tested == count && stats.culled == count - scalarCount;
+		for (size_t i = 0; same && i < scalarCount; ++i)
+		{
+			same = pooled[i] == scalar[i] && single[i] == scalar[i];
+		}
+		if (!same)
+			printf("CullBoxList, CullBoxes and CullBoxesScalar disagree\n");
+
+		double planes[6][4];
+		ReferencePlanes(viewProjection, planes);
+		size_t next = 0, touching = 0, wrong = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			bool visible = next < scalarCount && scalar[next] == i;
+			next += visible ? 1 : 0;
+			int expected = ReferenceVisible(planes, boxes, i);
+			touching += expected < 0 ? 1 : 0;
+			wrong += expected >= 0 && visible != (expected == 1) ? 1 : 0;
+		}
+		if (wrong)
+			printf("%zu boxes culled differently from the double precision test\n", wrong);
+		passed &= same && wrong == 0;
+
+		printf("%zu boxes, %zu visible, %zu touching a plane; %s build, %u threads:\n", count, scalarCount, touching, SimdPath(),
+			   DX::WorkerPool::Shared().GetConcurrency());
+		printf("  CullBoxList %.2f ms, CullBoxes %.2f ms, CullBoxesScalar %.2f ms (%.1f, %.1f and %.1f ms per million boxes)%s\n",
+			   pooledMs / iterations, singleMs / iterations, scalarMs / iterations, pooledMs / iterations / (count * 1e-6),
+			   singleMs / iterations / (count * 1e-6), scalarMs / iterations / (count * 1e-6), passed ? "" : "; FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t boxes = argc > 1 ? size_t(atoi(argv[1])) : 1000000;
+	uint32_t iterations = argc > 2 ? uint32_t(atoi(argv[2])) : 20;
+	if (argc > 3 || boxes < 64 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [boxes, at least 64] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckBounds();
+	passed &= Benchmark(boxes, iterations);
+	return passed ? 0 : 1;
+}
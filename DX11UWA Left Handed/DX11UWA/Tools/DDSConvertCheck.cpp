@@ -0,0 +1,258 @@
+// Checks and times DDSFormatConvert, the expansion of legacy DDS layouts while textures load.
+//
+//   DDSConvertCheck [size] [iterations]
+//
+// Every legacy layout is described by the DDS_PIXELFORMAT a file declares for it. The check
+// classifies each description, then converts every possible texel (random ones for 24 and 32 bits)
+// with ConvertLegacyRow and ConvertLegacyRowScalar and compares both with a reference built from
+// the channel masks alone: each field widened to 8 bits by repeating its bits from the top, so 0
+// stays 0 and the field's maximum becomes 255, alpha 255 where there's no alpha mask, luminance copied to red, green and blue, in the channel order LegacyTargetLayout
+// gives. Every row width from 1 to 80 is converted too, so the SIMD bodies and scalar tails meet at
+// every offset, into a row with guard texels that must stay untouched. Then converts a size by size
+// (default 2048) surface with padded pitches through ConvertLegacySurface, which splits it across
+// the worker pool, and times it, one thread of SIMD rows and the scalar rows over iterations
+// (default 10) runs. Exits with 1 on any mismatch. Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common DDSConvertCheck.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common DDSConvertCheck.cpp ../DX11UWA/Common/{DDSFormatConvert,WorkerPool}.cpp
+
+#include "DDSFormatConvert.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_RGB = 0x40;
+	const uint32_t DDPF_LUMINANCE = 0x20000;
+	const uint32_t Guard = 0xdeadbeef;
+	const size_t MaxWidth = 80;
+
+	struct PixelFormat
+	{
+		DX::LegacyFormat format;
+		uint32_t flags;
+		uint32_t bitCount;
+		uint32_t masks[4];	// R (or luminance), G, B, A.
+	};
+
+	const PixelFormat Formats[] =
+	{
+		{ DX::LegacyR8G8B8, DDPF_RGB, 24, { 0xff0000, 0x00ff00, 0x0000ff, 0 } },
+		{ DX::LegacyB8G8R8, DDPF_RGB, 24, { 0x0000ff, 0x00ff00, 0xff0000, 0 } },
+		{ DX::LegacyX8B8G8R8, DDPF_RGB, 32, { 0x000000ff, 0x0000ff00, 0x00ff0000, 0 } },
+		{ DX::LegacyL8, DDPF_LUMINANCE, 8, { 0xff, 0, 0, 0 } },
+		{ DX::LegacyA8L8, DDPF_LUMINANCE | DDPF_ALPHAPIXELS, 16, { 0x00ff, 0, 0, 0xff00 } },
+		{ DX::LegacyA4L4, DDPF_LUMINANCE | DDPF_ALPHAPIXELS, 8, { 0x0f, 0, 0, 0xf0 } },
+		{ DX::LegacyX1R5G5B5, DDPF_RGB, 16, { 0x7c00, 0x03e0, 0x001f, 0 } },
+		{ DX::LegacyA1R5G5B5, DDPF_RGB | DDPF_ALPHAPIXELS, 16, { 0x7c00, 0x03e0, 0x001f, 0x8000 } },
+		{ DX::LegacyX4R4G4B4, DDPF_RGB, 16, { 0x0f00, 0x00f0, 0x000f, 0 } },
+		{ DX::LegacyA4R4G4B4, DDPF_RGB | DDPF_ALPHAPIXELS, 16, { 0x0f00, 0x00f0, 0x000f, 0xf000 } },
+		{ DX::LegacyR3G3B2, DDPF_RGB, 8, { 0xe0, 0x1c, 0x03, 0 } },
+		{ DX::LegacyA8R3G3B2, DDPF_RGB | DDPF_ALPHAPIXELS, 16, { 0x00e0, 0x001c, 0x0003, 0xff00 } },
+	};
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// The field under mask with its bits repeated down to 8 bits; 255 for an empty mask.
+	uint32_t Channel(uint32_t texel, uint32_t mask)
+	{
+		if (mask == 0)
+			return 255;
+		int low = 0, bits = 0;
+		while (!(mask >> low & 1))
+		{
+			++low;
+		}
+		while (mask >> (low + bits) & 1)
+		{
+			++bits;
+		}
+		uint32_t field = (texel & mask) >> low;
+		uint32_t value = 0;
+		for (int shift = 8 - bits; shift > -bits; shift -= bits)
+		{
+			value |= shift >= 0 ? field << shift : field >> -shift;
+		}
+		return value;
+	}
+
+	uint32_t Reference(const PixelFormat& pf, uint32_t texel)
+	{
+		bool luminance = (pf.flags & DDPF_LUMINANCE) != 0;
+		uint32_t r = Channel(texel, pf.masks[0]);
+		uint32_t g = luminance ? r : Channel(texel, pf.masks[1]);
+		uint32_t b = luminance ? r : Channel(texel, pf.masks[2]);
+		uint32_t a = Channel(texel, pf.masks[3]);
+		if (DX::LegacyTargetLayout(pf.format) == DX::ConvertedR8G8B8A8)
+			return r | g << 8 | b << 16 | a << 24;
+		return b | g << 8 | r << 16 | a << 24;
+	}
+
+	// width texels packed at the format's size, little-endian like the file.
+	std::vector<uint8_t> PackRow(const PixelFormat& pf, const std::vector<uint32_t>& texels)
+	{
+		size_t bytes = pf.bitCount / 8;
+		std::vector<uint8_t> row(texels.size() * bytes);
+		for (size_t x = 0; x < texels.size(); ++x)
+		{
+			for (size_t i = 0; i < bytes; ++i)
+			{
+				row[x * bytes + i] = uint8_t(texels[x] >> (8 * i));
+			}
+		}
+		return row;
+	}
+
+	std::vector<uint32_t> SampleTexels(const PixelFormat& pf, uint32_t& state)
+	{
+		std::vector<uint32_t> texels;
+		if (pf.bitCount <= 16)
+		{
+			for (uint32_t v = 0; v < (1u << pf.bitCount); ++v)
+			{
+				texels.push_back(v);
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < 65536; ++i)
+			{
+				texels.push_back(pf.bitCount == 32 ? Random(state) ^ (Random(state) << 24) : Random(state));
+			}
+		}
+		return texels;
+	}
+
+	bool CheckFormat(const PixelFormat& pf)
+	{
+		const char* name = DX::LegacyFormatName(pf.format);
+		DX::LegacyFormat classified = DX::ClassifyLegacyFormat(pf.flags, pf.bitCount, pf.masks[0], pf.masks[1], pf.masks[2], pf.masks[3]);
+		if (classified != pf.format || DX::LegacyBitsPerPixel(pf.format) != pf.bitCount)
+		{
+			printf("%s: classified as %s, %u bits\n", name, DX::LegacyFormatName(classified), DX::LegacyBitsPerPixel(classified));
+			return false;
+		}
+
+		uint32_t state = pf.format;
+		std::vector<uint32_t> texels = SampleTexels(pf, state);
+		std::vector<uint8_t> row = PackRow(pf, texels);
+		std::vector<uint32_t> simd(texels.size()), scalar(texels.size());
+		DX::ConvertLegacyRow(pf.format, row.data(), simd.data(), texels.size());
+		DX::ConvertLegacyRowScalar(pf.format, row.data(), scalar.data(), texels.size());
+		for (size_t x = 0; x < texels.size(); ++x)
+		{
+			uint32_t expected = Reference(pf, texels[x]);
+			if (simd[x] != expected || scalar[x] != expected)
+			{
+				printf("%s: texel 0x%x converts to 0x%08x (scalar 0x%08x), expected 0x%08x\n", name, texels[x], simd[x], scalar[x], expected);
+				return false;
+			}
+		}
+
+		// Rows sized exactly, so a kernel reading past its row would read past the allocation.
+		for (size_t width = 1; width <= MaxWidth; ++width)
+		{
+			std::vector<uint32_t> part(texels.begin() + width, texels.begin() + 2 * width);
+			std::vector<uint8_t> source = PackRow(pf, part);
+			std::vector<uint32_t> converted(width + 4, Guard);
+			DX::ConvertLegacyRow(pf.format, source.data(), converted.data(), width);
+			for (size_t x = 0; x < width + 4; ++x)
+			{
+				uint32_t expected = x < width ? Reference(pf, part[x]) : Guard;
+				if (converted[x] != expected)
+				{
+					printf("%s: a row of %zu texels has 0x%08x at %zu, expected 0x%08x\n", name, width, converted[x], x, expected);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool Benchmark(const PixelFormat& pf, size_t size, uint32_t iterations)
+	{
+		const size_t srcPitch = size * pf.bitCount / 8 + 7;
+		const size_t dstPitch = size * 4 + 16;
+		uint32_t state = 99;
+		std::vector<uint8_t> src(srcPitch * size);
+		for (uint8_t& byte : src)
+		{
+			byte = uint8_t(Random(state));
+		}
+		std::vector<uint8_t> dst(dstPitch * size), expected(dstPitch * size);
+
+		double surfaceMs = 0.0, rowsMs = 0.0, scalarMs = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			DX::ConvertLegacySurface(pf.format, src.data(), srcPitch, dst.data(), dstPitch, size, size);
+			surfaceMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			for (size_t y = 0; y < size; ++y)
+			{
+				DX::ConvertLegacyRow(pf.format, &src[y * srcPitch], reinterpret_cast<uint32_t*>(&expected[y * dstPitch]), size);
+			}
+			rowsMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			for (size_t y = 0; y < size; ++y)
+			{
+				DX::ConvertLegacyRowScalar(pf.format, &src[y * srcPitch], reinterpret_cast<uint32_t*>(&expected[y * dstPitch]), size);
+			}
+			scalarMs += Milliseconds(start);
+		}
+
+		bool matches = true;
+		for (size_t y = 0; y < size; ++y)
+		{
+			matches &= memcmp(&dst[y * dstPitch], &expected[y * dstPitch], size * 4) == 0;
+		}
+		double texels = double(size) * size * iterations * 1e-3;
+		printf("  %-10s surface %7.2f ms (%6.0f Mtexels/s), SIMD rows %7.2f ms (%5.0f), scalar rows %7.2f ms (%5.0f)%s\n",
+			   DX::LegacyFormatName(pf.format), surfaceMs / iterations, texels / surfaceMs, rowsMs / iterations, texels / rowsMs,
+			   scalarMs / iterations, texels / scalarMs, matches ? "" : "; SURFACE DIFFERS");
+		return matches;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t size = argc > 1 ? size_t(atoi(argv[1])) : 2048;
+	uint32_t iterations = argc > 2 ? uint32_t(atoi(argv[2])) : 10;
+	if (argc > 3 || size == 0 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [size] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = true;
+	for (const PixelFormat& pf : Formats)
+	{
+		passed &= CheckFormat(pf);
+	}
+	printf("%zu layouts checked against their channel masks, rows of 1 to %zu texels%s\n", sizeof(Formats) / sizeof(Formats[0]),
+		   MaxWidth, passed ? "" : "; FAILED");
+
+	printf("%zux%zu surfaces, %u threads:\n", size, size, DX::WorkerPool::Shared().GetConcurrency());
+	for (const PixelFormat& pf : Formats)
+	{
+		passed &= Benchmark(pf, size, iterations);
+	}
+	return passed ? 0 : 1;
+}
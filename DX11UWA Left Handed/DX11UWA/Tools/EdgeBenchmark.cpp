@@ -0,0 +1,180 @@
+// Checks and times MeshEdges, the load-time edge extraction behind the renderer's line-list draws.
+//
+//   EdgeBenchmark <Assets dir> [factor] [iterations]
+//
+// Loads the scene's meshes from Assets and tessellates each with TessellateMesh at factor 1 and
+// at factor (default 15), which turns the stadium into over a million triangles. Every mesh gets
+// its edges extracted and compared with a std::map based reference: the same vertex at each end
+// of every triangle side, and the same faces on every edge. ExtractEdges, ClassifyEdges and
+// FindSilhouetteEdges are then timed over iterations (default 5) runs, the reference over one.
+// Exits with 1 if any mesh differs from the reference. Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common EdgeBenchmark.cpp ..\DX11UWA\Common\MeshEdges.cpp ..\DX11UWA\Common\ObjMesh.cpp ..\DX11UWA\Common\TessellationCache.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common EdgeBenchmark.cpp ../DX11UWA/Common/{MeshEdges,ObjMesh,TessellationCache,WorkerPool}.cpp
+
+#include "MeshEdges.h"
+#include "ObjMesh.h"
+#include "TessellationCache.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const char* const MeshFiles[] =
+	{
+		"floor_bottom.obj", "floor_platform.obj", "pokeballred.obj", "pokeballwhite.obj", "pokeballblack.obj",
+		"stadium.obj", "sphere.obj", "pyramid.obj",
+	};
+	const float CreaseAngle = 30.0f;
+	const float Eye[3] = { 0.0f, 10.0f, -20.0f };
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// The same edges the slow way: ordered maps keyed by position and by vertex pair.
+	struct ReferenceEdges
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> sides;				// Per triangle side; equal ends for none.
+		std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> faces;
+	};
+
+	void ExtractReference(const DX::TessellatedMesh& mesh, ReferenceEdges& reference)
+	{
+		std::map<std::array<float, 3>, uint32_t> first;
+		std::vector<uint32_t> weld(mesh.vertices.size());
+		for (uint32_t v = 0; v < mesh.vertices.size(); ++v)
+		{
+			const float* p = mesh.vertices[v].pos;
+			std::array<float, 3> key = { { p[0] + 0.0f, p[1] + 0.0f, p[2] + 0.0f } };
+			weld[v] = first.insert(std::make_pair(key, v)).first->second;
+		}
+
+		reference.sides.clear();
+		reference.faces.clear();
+		for (size_t t = 0; t < mesh.indices.size() / 3; ++t)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				uint32_t a = weld[mesh.indices[t * 3 + k]];
+				uint32_t b = weld[mesh.indices[t * 3 + (k + 1) % 3]];
+				std::pair<uint32_t, uint32_t> side(std::min(a, b), std::max(a, b));
+				reference.sides.push_back(side);
+				if (a != b)
+					reference.faces[side].push_back(uint32_t(t));
+			}
+		}
+	}
+
+	bool Matches(const DX::EdgeList& edges, const ReferenceEdges& reference)
+	{
+		if (edges.EdgeCount() != reference.faces.size())
+			return false;
+		for (size_t side = 0; side < reference.sides.size(); ++side)
+		{
+			uint32_t edge = edges.faceEdges[side];
+			if (reference.sides[side].first == reference.sides[side].second)
+			{
+				if (edge != DX::EdgeList::NoEdge)
+					return false;
+				continue;
+			}
+			if (edge == DX::EdgeList::NoEdge || edges.lines[edge * 2] != reference.sides[side].first ||
+				edges.lines[edge * 2 + 1] != reference.sides[side].second)
+				return false;
+
+			const std::vector<uint32_t>& faces = reference.faces.find(reference.sides[side])->second;
+			uint32_t second = faces.size() > 1 ? faces[1] : DX::EdgeList::NoFace;
+			if (edges.faceCounts[edge] != std::min<size_t>(faces.size(), 255) || edges.faces[edge * 2] != faces[0] ||
+				edges.faces[edge * 2 + 1] != second)
+				return false;
+		}
+		return true;
+	}
+
+	bool Run(const char* file, const DX::TessellatedMesh& mesh, uint32_t iterations)
+	{
+		const float* positions = mesh.vertices[0].pos;
+		const size_t stride = sizeof(DX::ObjVertex);
+		DX::EdgeList edges;
+		std::vector<uint32_t> silhouette;
+		double extractMs = 0.0, classifyMs = 0.0, silhouetteMs = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			DX::ExtractEdges(positions, stride, mesh.indices.data(), mesh.indices.size(), edges);
+			extractMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			DX::ClassifyEdges(positions, stride, mesh.indices.data(), CreaseAngle, edges);
+			classifyMs += Milliseconds(start);
+			start = std::chrono::steady_clock::now();
+			DX::FindSilhouetteEdges(positions, stride, mesh.indices.data(), edges, Eye, silhouette);
+			silhouetteMs += Milliseconds(start);
+		}
+
+		ReferenceEdges reference;
+		auto start = std::chrono::steady_clock::now();
+		ExtractReference(mesh, reference);
+		double referenceMs = Milliseconds(start);
+		bool matches = Matches(edges, reference);
+
+		size_t kinds[4] = {};
+		for (DX::EdgeKind kind : edges.kinds)
+		{
+			++kinds[kind];
+		}
+		size_t triangles = mesh.indices.size() / 3;
+		printf("%-18s factor %2u: %8zu triangles, %8zu edges (%zu boundary, %zu crease, %zu non-manifold), %zu on the silhouette%s\n",
+			   file, mesh.factor, triangles, edges.EdgeCount(), kinds[DX::EdgeBoundary], kinds[DX::EdgeCrease],
+			   kinds[DX::EdgeNonManifold], silhouette.size() / 2, matches ? "" : "; DIFFERS FROM THE REFERENCE");
+		printf("  extract %.3f ms (%.1f Mtriangles/s), classify %.3f ms, silhouette %.3f ms, std::map reference %.3f ms; %zu line indices instead of %zu\n",
+			   extractMs / iterations, triangles / (extractMs / iterations) * 1e-3, classifyMs / iterations, silhouetteMs / iterations,
+			   referenceMs, edges.lines.size(), triangles * 6);
+		return matches;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t factor = argc > 2 ? uint32_t(atoi(argv[2])) : 15;
+	uint32_t iterations = argc > 3 ? uint32_t(atoi(argv[3])) : 5;
+	if (argc < 2 || factor == 0 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> [factor] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = true;
+	for (const char* file : MeshFiles)
+	{
+		std::vector<DX::ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+		if (!DX::LoadObjMesh((std::string(argv[1]) + "/" + file).c_str(), vertices, indices) || indices.empty())
+		{
+			fprintf(stderr, "%s: can't load mesh\n", file);
+			return 1;
+		}
+		uint32_t factors[2] = { 1, factor };
+		for (uint32_t n : factors)
+		{
+			DX::TessellatedMesh mesh;
+			DX::TessellateMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), n, 0.75f, mesh, DX::WorkerPool::Shared());
+			passed &= Run(file, mesh, iterations);
+			if (factor == 1)
+				break;
+		}
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Runs the renderer's frame without a GPU, for benchmarks and CI performance tracking.
+//
+//   HeadlessFrame <Assets dir> [frames] [copies] [lights]
+//
+// Loads the app's scene through SceneRenderer, the frame code Sample3DSceneRenderer runs, on a
+// NullRenderDevice: every buffer, texture, shader and state is created on the null device, with
+// placeholder bytecode for the shaders. Then runs frames of it: light animation, light packing and
+// grid assignment, scene transforms, bounding tree and frustum query, occlusion and instance
+// culling, draw packet sort, constant ring and instance uploads, and draw recording through the
+// state cache, split across command lists when the queue is large. copies repeats the scene on a
+// grid to load the pipeline; lights (default 1024) adds random point and spot lights, half of them
+// drifting over the copies, to each copy's own two. The camera orbits the scene, which turns
+// slowly, and frames are animated as if they ran at 60 per second. Prints per-stage timings and
+// device counters, and exits with 1 if the device saw an invalid call. Only depends on the portable
+// sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common HeadlessFrame.cpp ..\DX11UWA\Common\AlphaCoverage.cpp ..\DX11UWA\Common\AnimationCurve.cpp ..\DX11UWA\Common\BoundingTree.cpp ..\DX11UWA\Common\CommandList.cpp ..\DX11UWA\Common\ConstantRing.cpp ..\DX11UWA\Common\CubemapBuilder.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\InstanceSet.cpp ..\DX11UWA\Common\LightAnimation.cpp ..\DX11UWA\Common\LightGrid.cpp ..\DX11UWA\Common\LightPermutation.cpp ..\DX11UWA\Common\LightStore.cpp ..\DX11UWA\Common\MeshEdges.cpp ..\DX11UWA\Common\NullRenderDevice.cpp ..\DX11UWA\Common\ObjMesh.cpp ..\DX11UWA\Common\OcclusionBuffer.cpp ..\DX11UWA\Common\RenderQueue.cpp ..\DX11UWA\Common\SceneRenderer.cpp ..\DX11UWA\Common\SceneStore.cpp ..\DX11UWA\Common\ShaderArchive.cpp ..\DX11UWA\Common\StateCache.cpp ..\DX11UWA\Common\TessellationCache.cpp ..\DX11UWA\Common\TessellationPolicy.cpp ..\DX11UWA\Common\TexturePacker.cpp ..\DX11UWA\Common\TextureResidency.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common HeadlessFrame.cpp ../DX11UWA/Common/{AlphaCoverage,AnimationCurve,BoundingTree,CommandList,ConstantRing,CubemapBuilder,DDSFile,DDSFormatConvert,FrustumCulling,InstanceSet,LightAnimation,LightGrid,LightPermutation,LightStore,MeshEdges,NullRenderDevice,ObjMesh,OcclusionBuffer,RenderQueue,SceneRenderer,SceneStore,ShaderArchive,StateCache,TessellationCache,TessellationPolicy,TexturePacker,TextureResidency,WorkerPool}.cpp
+
+#include "NullRenderDevice.h"
+#include "SceneRenderer.h"
+#include "ShaderArchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const float FieldOfView = 70.0f * 3.14159265f / 180.0f;
+	const float AspectRatio = 16.0f / 9.0f;
+	const uint32_t TargetWidth = 1280;
+	const uint32_t TargetHeight = 720;
+	const double FrameSeconds = 1.0 / 60.0;
+
+	// Row-major, row-vector matrices as in DirectXMath.
+	void LookAtLH(const float eye[3], const float at[3], float out[16])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		z[0] /= length; z[1] /= length; z[2] /= length;
+		// x = normalize(cross(up, z)) with up = +y.
+		float x[3] = { z[2], 0.0f, -z[0] };
+		length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length; x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		const float matrix[16] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]),
+			-(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+			-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f
+		};
+		std::copy(matrix, matrix + 16, out);
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Placeholder bytecode for every shader the scene reads; the null device only checks its size.
+	bool WritePlaceholderShaders(std::vector<uint8_t>& archive)
+	{
+		std::vector<DX::ShaderArchiveEntry> entries;
+		for (const char* name : DX::SceneRenderer::GetShaderNames())
+		{
+			DX::ShaderArchiveEntry entry = { name, std::vector<uint8_t>(64, 0) };
+			std::copy_n("DXBC", 4, entry.bytecode.begin());
+			entries.push_back(entry);
+		}
+		return DX::WriteShaderArchive(entries, archive);
+	}
+
+	// Per-frame counters summed over the run.
+	struct Totals
+	{
+		double milliseconds[DX::SceneStageCount + 1] = {};	// The last one is the whole frame.
+		uint64_t visibleItems = 0;
+		uint64_t occludedItems = 0;
+		uint64_t draws = 0;
+		uint64_t primitives = 0;
+		uint64_t stateCalls = 0;
+		uint64_t filteredCalls = 0;
+		uint64_t gridVisibleLights = 0;
+		uint64_t gridOccupiedClusters = 0;
+		uint64_t gridIndices = 0;
+		uint32_t gridMaxClusterLights = 0;
+		uint64_t packedLights = 0;
+		uint64_t variantDraws[DX::LightVariantCount] = {};
+	};
+
+	// Turns the scene and orbits the camera around it, then runs one frame and adds up its counters.
+	void RunFrame(DX::SceneRenderer& scene, DX::NullRenderDevice& device, uint32_t frame, float cameraDistance, Totals& totals)
+	{
+		auto start = std::chrono::steady_clock::now();
+		device.ResetFrameStats();
+
+		float orbit = 0.01f * frame;
+		float eye[3] = { -1.5f * cameraDistance * sinf(orbit), 0.7f * cameraDistance, -1.5f * cameraDistance * cosf(orbit) };
+		const float at[3] = { 0.0f, -0.1f, 0.0f };
+		float view[16];
+		LookAtLH(eye, at, view);
+		scene.SetCamera(view, eye);
+		scene.SetSceneRotation(0.002f * frame);
+		scene.Update(frame * FrameSeconds, static_cast<float>(FrameSeconds));
+		scene.Render();
+		totals.milliseconds[DX::SceneStageCount] += Milliseconds(start);
+
+		const DX::SceneFrameStats& stats = scene.GetFrameStats();
+		for (uint32_t stage = 0; stage < DX::SceneStageCount; ++stage)
+		{
+			totals.milliseconds[stage] += stats.milliseconds[stage];
+		}
+		totals.visibleItems += scene.GetCullStats().visible;
+		totals.occludedItems += scene.GetCullStats().occluded;
+		totals.draws += device.GetStats().draws;
+		totals.primitives += device.GetStats().primitives;
+		totals.stateCalls += stats.stateCalls;
+		totals.filteredCalls += stats.filteredCalls;
+		const DX::LightGridStats& grid = scene.GetLightGrid().GetStats();
+		totals.gridVisibleLights += grid.visibleLights;
+		totals.gridOccupiedClusters += grid.occupiedClusters;
+		totals.gridIndices += grid.indices;
+		totals.gridMaxClusterLights = std::max(totals.gridMaxClusterLights, grid.maxClusterLights);
+		totals.packedLights += stats.packedLights;
+		for (uint32_t i = 0; i < DX::LightVariantCount; ++i)
+		{
+			totals.variantDraws[i] += stats.variantDraws[i];
+		}
+	}
+
+	void PrintReport(const DX::SceneRenderer& scene, const DX::NullRenderDevice& device, const Totals& totals, uint32_t frames)
+	{
+		const char* const names[DX::SceneStageCount + 1] = { "update", "lights", "transforms", "cull", "queue", "upload", "record", "total" };
+		printf("%u frames, %u items, %u pyramid instances\n", frames, uint32_t(scene.GetItemCount()), uint32_t(scene.GetMarkerCount()));
+		for (uint32_t stage = 0; stage <= DX::SceneStageCount; ++stage)
+		{
+			printf("  %-10s %9.4f ms/frame\n", names[stage], totals.milliseconds[stage] / frames);
+		}
+		printf("  per frame: %.1f visible items, %.1f occluded, %.1f draws, %.0f primitives\n",
+			   double(totals.visibleItems) / frames, double(totals.occludedItems) / frames, double(totals.draws) / frames,
+			   double(totals.primitives) / frames);
+		for (uint32_t mesh = 0; mesh < DX::SceneRenderer::MeshCount; ++mesh)
+		{
+			DX::SceneRenderer::MeshId id = DX::SceneRenderer::MeshId(mesh);
+			const DX::TessellationPolicy& tessellation = scene.GetTessellation(id);
+			if (tessellation.tessellate)
+				printf("  %s: tessellated up to %.0f, %u pre-tessellated levels\n", DX::SceneRenderer::GetMeshFile(id),
+					   tessellation.maxFactor, scene.GetLevelCount(id));
+		}
+		printf("  per frame: %.1f state calls issued, %.1f filtered\n", double(totals.stateCalls) / frames,
+			   double(totals.filteredCalls) / frames);
+		const DX::LightGridConstants& grid = scene.GetLightGrid().GetConstants();
+		printf("  light grid: %u lights, %ux%ux%u clusters; per frame %.1f lights visible, %.1f clusters lit, %.1f indices; at most %u lights in a cluster\n",
+			   scene.GetLightGrid().GetStats().lights, grid.tilesX, grid.tilesY, grid.slices, double(totals.gridVisibleLights) / frames,
+			   double(totals.gridOccupiedClusters) / frames, double(totals.gridIndices) / frames, totals.gridMaxClusterLights);
+		printf("  lights: %u, %.1f packed per frame\n", scene.GetLights().GetPackedCount(), double(totals.packedLights) / frames);
+		printf("  light shader variants, draws per frame:");
+		for (uint32_t i = 0; i < DX::LightVariantCount; ++i)
+		{
+			if (totals.variantDraws[i])
+				printf(" %s %.1f", DX::LightVariants[i].name, double(totals.variantDraws[i]) / frames);
+		}
+		printf("\n");
+
+		const DX::NullDeviceStats& stats = device.GetStats();
+		printf("device: %u buffers (%.2f MB), %u textures (%.2f MB), %u shaders, %u input layouts, %u errors\n",
+			   stats.buffers, stats.bufferBytes / 1048576.0, stats.textures, stats.textureBytes / 1048576.0,
+			   stats.shaders, stats.inputLayouts, device.GetErrorCount());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 5)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> [frames] [copies] [lights]\n", argv[0]);
+		return 1;
+	}
+	uint32_t frames = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 1000;
+	uint32_t copies = argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 1;
+	uint32_t lights = argc > 4 ? static_cast<uint32_t>(atoi(argv[4])) : 1024;
+	if (frames == 0 || copies == 0)
+	{
+		fprintf(stderr, "frames and copies must be positive\n");
+		return 1;
+	}
+
+	std::vector<uint8_t> archiveData;
+	DX::ShaderArchive archive;
+	if (!WritePlaceholderShaders(archiveData) || !archive.OpenMemory(archiveData.data(), archiveData.size()))
+	{
+		fprintf(stderr, "can't build the placeholder shader archive\n");
+		return 1;
+	}
+
+	DX::NullRenderDevice device;
+	DX::SceneRenderer scene(device);
+	DX::SceneSettings settings;
+	settings.assets = argv[1];
+	settings.shaders = &archive;
+	settings.copies = copies;
+	settings.extraLights = lights;
+
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = scene.Load(settings);
+	if (loaded)
+	{
+		printf("loaded in %.1f ms\n", Milliseconds(start));
+		DX::SceneViewport viewport = { FieldOfView, AspectRatio, { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 },
+									   TargetWidth, TargetHeight, float(TargetHeight) };
+		scene.SetViewport(viewport);
+
+		Totals totals;
+		float cameraDistance = std::max(1.0f, scene.GetSceneExtent());
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			RunFrame(scene, device, frame, cameraDistance, totals);
+		}
+		PrintReport(scene, device, totals, frames);
+	}
+	else
+	{
+		fprintf(stderr, "error: %s\n", scene.GetLoadError().c_str());
+	}
+
+	for (const std::string& error : device.GetErrors())
+	{
+		fprintf(stderr, "error: %s\n", error.c_str());
+	}
+	return loaded && device.GetErrorCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+// Checks and times InstanceSet, the per-frame cull and compaction of instance transforms before upload.
+//
+//   InstanceBenchmark [instances] [iterations]
+//
+// Scatters instances (default 1000000) of a small box with random rotation, scale and position
+// around a camera. Checks that every instance keeps its transform in the columns the vertex
+// shader reads, and that its box holds the eight corners of the mesh box transformed in double
+// precision without being more than a rounding error larger. Checks Remove, which moves the last
+// instance into the gap, and ComputeBounds against a plain loop. Cull must keep exactly the
+// indices CullBoxesScalar keeps, in order, and WriteVisible must write the transforms of those
+// instances, front to back, to aligned and unaligned buffers, for 1000 instances and for all of
+// them, which at the default count is past the size where it splits the copy across the worker
+// pool. Then times Cull and WriteVisible over iterations (default 20) frames against a single
+// loop that tests each box and copies the survivors. Build with and without AVX2 to time both
+// SIMD paths. Exits with 1 on any mismatch. Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common InstanceBenchmark.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\InstanceSet.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common InstanceBenchmark.cpp ../DX11UWA/Common/{FrustumCulling,InstanceSet,WorkerPool}.cpp
+
+#include "FrustumCulling.h"
+#include "InstanceSet.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	float RandomFloat(uint32_t& state, float low, float high)
+	{
+		return low + (high - low) * float(Random(state) & 0xffff) / 65535.0f;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* SimdPath(void)
+	{
+#if DX_SIMD_AVX2
+		return "AVX2";
+#elif DX_SIMD_SSE2
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	void Multiply(const float a[16], const float b[16], float result[16])
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; ++k)
+				{
+					sum += a[row * 4 + k] * b[k * 4 + column];
+				}
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// Left-handed look-at and perspective, row vectors, as XMMatrixLookAtLH and XMMatrixPerspectiveFovLH build them.
+	void ViewProjection(const float eye[3], const float at[3], float fovY, float aspect, float nearZ, float farZ, float result[16])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& v : z)
+		{
+			v /= length;
+		}
+		float x[3] = { z[2], 0.0f, -z[0] };	// up (0, 1, 0) cross z
+		length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length;
+		x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		const float view[16] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]), -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+			-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f,
+		};
+		float h = 1.0f / tanf(fovY / 2.0f), w = h / aspect, r = farZ / (farZ - nearZ);
+		const float projection[16] = { w, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * nearZ, 0 };
+		Multiply(view, projection, result);
+	}
+
+	// Rotation about y then x, uniform scale, then translation.
+	void RandomWorld(uint32_t& state, float world[16])
+	{
+		float yaw = RandomFloat(state, -3.14159f, 3.14159f), pitch = RandomFloat(state, -0.5f, 0.5f);
+		float scale = RandomFloat(state, 0.2f, 2.0f);
+		float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+		const float rotation[16] =
+		{
+			cy * scale, 0.0f, -sy * scale, 0.0f,
+			sy * sp * scale, cp * scale, cy * sp * scale, 0.0f,
+			sy * cp * scale, -sp * scale, cy * cp * scale, 0.0f,
+			RandomFloat(state, -500.0f, 500.0f), RandomFloat(state, -5.0f, 20.0f), RandomFloat(state, -500.0f, 500.0f), 1.0f
+		};
+		memcpy(world, rotation, sizeof(rotation));
+	}
+
+	bool SameInstance(const DX::InstanceData& a, const DX::InstanceData& b)
+	{
+		return memcmp(&a, &b, sizeof(DX::InstanceData)) == 0;
+	}
+
+	// The box of an instance must hold every corner of the mesh box, transformed in double
+	// precision, and be no more than slack larger than the tightest such box.
+	bool CheckBox(const DX::MeshBounds& mesh, const float world[16], const DX::BoxList& boxes, uint32_t index)
+	{
+		const float center[3] = { boxes.CenterX()[index], boxes.CenterY()[index], boxes.CenterZ()[index] };
+		const float extents[3] = { boxes.ExtentX()[index], boxes.ExtentY()[index], boxes.ExtentZ()[index] };
+		double low[3] = { 1e30, 1e30, 1e30 }, high[3] = { -1e30, -1e30, -1e30 };
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const double p[3] = { (corner & 1) ? mesh.max[0] : mesh.min[0], (corner & 2) ? mesh.max[1] : mesh.min[1],
+								  (corner & 4) ? mesh.max[2] : mesh.min[2] };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				double v = p[0] * world[axis] + p[1] * world[4 + axis] + p[2] * world[8 + axis] + world[12 + axis];
+				low[axis] = std::min(low[axis], v);
+				high[axis] = std::max(high[axis], v);
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			double slack = 1e-5 * (1.0 + fabs(low[axis]) + fabs(high[axis]));
+			double boxLow = double(center[axis]) - extents[axis], boxHigh = double(center[axis]) + extents[axis];
+			if (boxLow > low[axis] + slack || boxHigh < high[axis] - slack || boxLow < low[axis] - 2.0 * slack ||
+				boxHigh > high[axis] + 2.0 * slack)
+				return false;
+		}
+		return true;
+	}
+
+	bool CheckWrite(const DX::InstanceSet& set, const char* label, size_t misalign)
+	{
+		size_t count = set.GetVisibleCount();
+		// Over-allocate so the output can start 16-byte aligned or misaligned by misalign bytes.
+		std::vector<float> storage((count + 2) * 12 + 4);
+		uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+		address = ((address + 15) & ~uintptr_t(15)) + misalign;
+		DX::InstanceData* out = reinterpret_cast<DX::InstanceData*>(address);
+		// A marker after the last entry catches writes past the end.
+		memset(out, 0xcd, (count + 1) * sizeof(DX::InstanceData));
+		set.WriteVisible(out);
+		const uint32_t* visible = set.GetVisible();
+		size_t wrong = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			wrong += SameInstance(out[i], set.Get(visible[i])) ? 0 : 1;
+		}
+		const unsigned char* marker = reinterpret_cast<const unsigned char*>(out + count);
+		bool overrun = false;
+		for (size_t i = 0; i < sizeof(DX::InstanceData); ++i)
+		{
+			overrun |= marker[i] != 0xcd;
+		}
+		printf("  write %zu visible, %s, %zu bytes past 16-byte alignment: %zu wrong%s%s\n", count, label, misalign, wrong,
+			   overrun ? ", wrote past the end" : "", wrong || overrun ? "; FAILED" : "");
+		return !wrong && !overrun;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 1000000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 20;
+	if (count < 1000 || iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [instances >= 1000] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	// Off-center in y, so the box centers move with the transforms too.
+	const float unitBox[8][3] = { { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f },
+								  { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }, { 0.5f, 1.5f, 0.5f } };
+	DX::MeshBounds mesh = DX::ComputeMeshBounds(unitBox[0], 8, sizeof(unitBox[0]));
+	const float eye[3] = { 0.0f, 10.0f, -60.0f }, at[3] = { 40.0f, 0.0f, 100.0f };
+	float viewProjection[16];
+	ViewProjection(eye, at, 70.0f * 3.14159265f / 180.0f, 16.0f / 9.0f, 0.01f, 400.0f, viewProjection);
+	DX::Frustum frustum = DX::ExtractFrustum(viewProjection);
+	bool passed = true;
+
+	// Transforms and boxes.
+	DX::InstanceSet set;
+	set.SetMeshBounds(mesh);
+	set.Reserve(count);
+	std::vector<float> worlds(count * 16);
+	uint32_t state = 12345;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < count; ++i)
+	{
+		RandomWorld(state, &worlds[i * 16]);
+		set.Add(&worlds[i * 16]);
+	}
+	double addMs = Milliseconds(start);
+	size_t badColumns = 0, badBoxes = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const float* world = &worlds[i * 16];
+		const DX::InstanceData& instance = set.Get(i);
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				badColumns += instance.columns[column][row] == world[row * 4 + column] ? 0 : 1;
+			}
+		}
+		badBoxes += CheckBox(mesh, world, set.GetBoxes(), i) ? 0 : 1;
+	}
+	printf("%zu instances added in %.1f ms: %zu wrong columns, %zu wrong boxes%s\n", count, addMs, badColumns, badBoxes,
+		   badColumns || badBoxes ? "; FAILED" : "");
+	passed = passed && !badColumns && !badBoxes;
+
+	// Remove moves the last instance into the gap; SetMeshBounds redoes every box.
+	{
+		DX::InstanceSet small;
+		small.SetMeshBounds(mesh);
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			small.Add(&worlds[i * 16]);
+		}
+		small.Remove(10);
+		small.Remove(98);
+		small.Remove(0);
+		const uint32_t expected[] = { 97, 99 };	// Now at 0 and 10; 98 was last when removed.
+		bool removed = small.Size() == 97 && small.GetBoxes().Size() == 97 && SameInstance(small.Get(0), set.Get(expected[0])) &&
+					   SameInstance(small.Get(10), set.Get(expected[1])) && CheckBox(mesh, &worlds[97 * 16], small.GetBoxes(), 0) &&
+					   CheckBox(mesh, &worlds[99 * 16], small.GetBoxes(), 10) && CheckBox(mesh, &worlds[96 * 16], small.GetBoxes(), 96);
+		DX::MeshBounds bigger = mesh;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			bigger.min[axis] -= 1.0f;
+			bigger.max[axis] += 1.0f;
+			bigger.extents[axis] += 1.0f;
+		}
+		small.SetMeshBounds(bigger);
+		removed = removed && CheckBox(bigger, &worlds[97 * 16], small.GetBoxes(), 0) && CheckBox(bigger, &worlds[50 * 16], small.GetBoxes(), 50);
+		printf("remove and rebound: %s\n", removed ? "ok" : "FAILED");
+		passed = passed && removed;
+	}
+
+	// ComputeBounds against a plain loop over the boxes.
+	{
+		DX::MeshBounds bounds = set.ComputeBounds();
+		const DX::BoxList& boxes = set.GetBoxes();
+		const float* centers[3] = { boxes.CenterX(), boxes.CenterY(), boxes.CenterZ() };
+		const float* extents[3] = { boxes.ExtentX(), boxes.ExtentY(), boxes.ExtentZ() };
+		bool same = true;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float low = 1e30f, high = -1e30f;
+			for (size_t i = 0; i < count; ++i)
+			{
+				low = std::min(low, centers[axis][i] - extents[axis][i]);
+				high = std::max(high, centers[axis][i] + extents[axis][i]);
+			}
+			same = same && bounds.min[axis] == low && bounds.max[axis] == high;
+		}
+		DX::InstanceSet empty;
+		DX::MeshBounds none = empty.ComputeBounds();
+		same = same && none.min[0] == 0.0f && none.max[0] == 0.0f && none.radius == 0.0f;
+		printf("compute bounds: %s\n", same ? "ok" : "FAILED");
+		passed = passed && same;
+	}
+
+	// Cull against CullBoxesScalar, then the compacted copies. The small set stays under the
+	// size where WriteVisible goes parallel.
+	std::vector<uint32_t> expected(count);
+	expected.resize(DX::CullBoxesScalar(frustum, set.GetBoxes(), 0, count, expected.data()));
+	DX::CullStats stats = set.Cull(frustum);
+	bool sameVisible = set.GetVisibleCount() == expected.size() && stats.visible == expected.size() && stats.tested == count &&
+					   std::equal(expected.begin(), expected.end(), set.GetVisible());
+	printf("cull: %zu of %zu visible, %s\n", set.GetVisibleCount(), count, sameVisible ? "same as CullBoxesScalar" : "differs from CullBoxesScalar; FAILED");
+	passed = passed && sameVisible;
+	{
+		DX::InstanceSet small;
+		small.SetMeshBounds(mesh);
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			small.Add(&worlds[i * 16]);
+		}
+		small.Cull(frustum);
+		passed = CheckWrite(small, "small set", 0) && passed;
+		passed = CheckWrite(small, "small set", 4) && passed;
+	}
+	passed = CheckWrite(set, "full set", 0) && passed;
+	passed = CheckWrite(set, "full set", 4) && passed;
+
+	// Timing. The output is aligned like a mapped buffer.
+	std::vector<float> storage((count + 1) * 12);
+	DX::InstanceData* out = reinterpret_cast<DX::InstanceData*>((reinterpret_cast<uintptr_t>(storage.data()) + 15) & ~uintptr_t(15));
+	double cullMs = 0.0, writeMs = 0.0, naiveMs = 0.0;
+	size_t naiveCount = 0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		start = std::chrono::steady_clock::now();
+		set.Cull(frustum);
+		cullMs += Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		set.WriteVisible(out);
+		writeMs += Milliseconds(start);
+
+		// One pass per instance: box test, then copy the survivor.
+		start = std::chrono::steady_clock::now();
+		const DX::BoxList& boxes = set.GetBoxes();
+		naiveCount = 0;
+		for (uint32_t index = 0; index < count; ++index)
+		{
+			uint32_t visible;
+			if (DX::CullBoxesScalar(frustum, boxes, index, index + 1, &visible))
+				out[naiveCount++] = set.Get(index);
+		}
+		naiveMs += Milliseconds(start);
+	}
+	if (naiveCount != set.GetVisibleCount())
+	{
+		printf("single loop kept %zu instances; FAILED\n", naiveCount);
+		passed = false;
+	}
+	printf("%s build, %u threads, %d iterations:\n", SimdPath(), DX::WorkerPool::Shared().GetConcurrency(), iterations);
+	printf("  Cull          %8.3f ms\n", cullMs / iterations);
+	printf("  WriteVisible  %8.3f ms (%.1f MB)\n", writeMs / iterations, set.GetVisibleCount() * sizeof(DX::InstanceData) / 1048576.0);
+	printf("  single loop   %8.3f ms\n", naiveMs / iterations);
+	return passed ? 0 : 1;
+}
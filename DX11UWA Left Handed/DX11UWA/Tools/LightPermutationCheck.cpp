@@ -0,0 +1,219 @@
+// Checks LightPermutation, the choice of LightPixelShader variant behind every lit draw.
+//
+//   LightPermutationCheck <Content dir>
+//
+// Reads each variant's .hlsl from the renderer's Content directory and checks that its defines
+// give the key LightVariants lists for it, and that LightPixelShader.hlsl defaults every switch.
+// Then checks the table for every key under every subset of loaded variants: the variant picked
+// must cover the key and no loaded variant covering it may be cheaper, and NoVariant only when
+// none covers it. Last, builds light grids with only point lights, only spot lights and both, and
+// checks the light types FindGridLightTypes reports. Prints the key table with every variant
+// loaded, and exits with 1 on any mismatch. Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common LightPermutationCheck.cpp ..\DX11UWA\Common\LightGrid.cpp ..\DX11UWA\Common\LightPermutation.cpp ..\DX11UWA\Common\LightStore.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common LightPermutationCheck.cpp ../DX11UWA/Common/{LightGrid,LightPermutation,LightStore,WorkerPool}.cpp
+
+#include "LightGrid.h"
+#include "LightPermutation.h"
+#include "LightStore.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const uint32_t LightBits = DX::PermutationPointLights | DX::PermutationSpotLights;
+
+	bool ReadFile(const std::string& path, std::string& text)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		char buffer[4096];
+		size_t read;
+		text.clear();
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			text.append(buffer, read);
+		}
+		fclose(file);
+		return true;
+	}
+
+	// The key a wrapper compiles to: every switch it doesn't define to 0 stays on.
+	bool CheckVariantFile(const std::string& content, const DX::LightVariant& variant)
+	{
+		std::string text;
+		if (!ReadFile(content + "/" + variant.name + ".hlsl", text))
+		{
+			printf("%s.hlsl: can't read\n", variant.name);
+			return false;
+		}
+		uint32_t key = DX::LightPermutationAll;
+		for (uint32_t bit = 0; bit < DX::LightPermutationBits; ++bit)
+		{
+			std::string off = std::string("#define ") + DX::GetLightPermutationDefine(1u << bit) + " 0";
+			if (text.find(off) != std::string::npos)
+				key &= ~(1u << bit);
+		}
+		if (variant.key != DX::LightPermutationAll && text.find("#include \"LightPixelShader.hlsl\"") == std::string::npos)
+		{
+			printf("%s.hlsl: doesn't include LightPixelShader.hlsl\n", variant.name);
+			return false;
+		}
+		if (key != variant.key)
+		{
+			printf("%s.hlsl: compiles to key 0x%02x, LightVariants says 0x%02x\n", variant.name, key, variant.key);
+			return false;
+		}
+		return true;
+	}
+
+	bool CheckDefaults(const std::string& content)
+	{
+		std::string text;
+		if (!ReadFile(content + "/LightPixelShader.hlsl", text))
+		{
+			printf("LightPixelShader.hlsl: can't read\n");
+			return false;
+		}
+		bool passed = true;
+		for (uint32_t bit = 0; bit < DX::LightPermutationBits; ++bit)
+		{
+			const char* define = DX::GetLightPermutationDefine(1u << bit);
+			if (text.find(std::string("#ifndef ") + define) == std::string::npos ||
+				text.find(std::string("#define ") + define + " 1") == std::string::npos)
+			{
+				printf("LightPixelShader.hlsl: %s has no default of 1\n", define);
+				passed = false;
+			}
+		}
+		return passed;
+	}
+
+	bool CheckTable(const bool available[DX::LightVariantCount])
+	{
+		DX::LightPermutationTable table;
+		table.Build(available);
+		for (uint32_t key = 0; key < DX::LightPermutationCount; ++key)
+		{
+			uint32_t best = DX::LightPermutationTable::NoVariant;
+			for (uint32_t i = 0; i < DX::LightVariantCount; ++i)
+			{
+				if (available[i] && DX::CoversLightPermutation(DX::LightVariants[i].key, key) &&
+					(best == DX::LightPermutationTable::NoVariant ||
+					 DX::LightPermutationCost(DX::LightVariants[i].key) < DX::LightPermutationCost(DX::LightVariants[best].key)))
+					best = i;
+			}
+			uint32_t picked = table.Select(key);
+			if (picked == DX::LightPermutationTable::NoVariant ? best != picked :
+				!available[picked] || !DX::CoversLightPermutation(DX::LightVariants[picked].key, key) ||
+				DX::LightPermutationCost(DX::LightVariants[picked].key) != DX::LightPermutationCost(DX::LightVariants[best].key))
+			{
+				printf("key 0x%02x: picked %u, expected %u\n", key, picked, best);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// XMMatrixPerspectiveFovLH, row-major with row vectors.
+	void Perspective(float fovY, float aspect, float nearZ, float farZ, float m[16])
+	{
+		float yScale = 1.0f / tanf(0.5f * fovY);
+		float range = farZ / (farZ - nearZ);
+		memset(m, 0, 16 * sizeof(float));
+		m[0] = yScale / aspect;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -range * nearZ;
+	}
+
+	// Lights in a row in front of an eye at the origin looking along +z; every one is in view.
+	uint32_t GridLightTypes(uint32_t points, uint32_t spots)
+	{
+		DX::LightStore store;
+		for (uint32_t i = 0; i < points + spots; ++i)
+		{
+			DX::LightStore::Light light = store.Create(i < points ? DX::LightPoint : DX::LightSpot);
+			store.SetPosition(light, -4.0f + 0.5f * float(i), 0.0f, 10.0f);
+			store.SetRadius(light, 5.0f);
+			store.SetDirection(light, 0.0f, 0.0f, -1.0f);
+		}
+		std::vector<DX::GridLight> lights(store.GetPackedCount() - store.GetPackedOffset(DX::LightPoint));
+		store.WriteGridLights(lights.data());
+
+		float projection[16];
+		const float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		Perspective(1.2f, 16.0f / 9.0f, 0.01f, 100.0f, projection);
+		DX::LightGrid grid;
+		grid.SetProjection(projection, 1280, 720, 0.01f, 100.0f);
+		grid.Build(view, lights.data(), uint32_t(lights.size()));
+		uint32_t firstSpot = store.GetPackedOffset(DX::LightSpot) - store.GetPackedOffset(DX::LightPoint);
+		return DX::FindGridLightTypes(grid.GetLightIndices(), grid.GetLightIndexCount(), firstSpot);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s <Content dir>\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckDefaults(argv[1]);
+	for (const DX::LightVariant& variant : DX::LightVariants)
+	{
+		passed &= CheckVariantFile(argv[1], variant);
+	}
+
+	uint32_t subsets = 0;
+	for (uint32_t mask = 0; mask < (1u << DX::LightVariantCount); ++mask)
+	{
+		bool available[DX::LightVariantCount];
+		for (uint32_t i = 0; i < DX::LightVariantCount; ++i)
+		{
+			available[i] = (mask >> i & 1) != 0;
+		}
+		passed &= CheckTable(available);
+		++subsets;
+	}
+	printf("table: %u keys checked under %u subsets of loaded variants\n", DX::LightPermutationCount, subsets);
+
+	bool all[DX::LightVariantCount];
+	for (bool& loaded : all)
+	{
+		loaded = true;
+	}
+	DX::LightPermutationTable table;
+	table.Build(all);
+	for (uint32_t key = 0; key < DX::LightPermutationCount; ++key)
+	{
+		// Keys with an alpha test but no texture never occur.
+		if (DX::MakeLightPermutation(key & DX::PermutationAlphaTest, key & DX::PermutationTexture, key) != key)
+			continue;
+		uint32_t variant = table.Select(key);
+		printf("  %-17s%-8s%-12s%-6s%-5s -> %s\n", key & DX::PermutationAlphaTest ? "alpha tested" : "opaque",
+			   key & DX::PermutationTexture ? "texture" : "", key & DX::PermutationDirectional ? "directional" : "",
+			   key & DX::PermutationPointLights ? "point" : "", key & DX::PermutationSpotLights ? "spot" : "",
+			   variant == DX::LightPermutationTable::NoVariant ? "none" : DX::LightVariants[variant].name);
+	}
+
+	const uint32_t counts[4][2] = { { 0, 0 }, { 6, 0 }, { 0, 6 }, { 6, 6 } };
+	const uint32_t expected[4] = { 0, DX::PermutationPointLights, DX::PermutationSpotLights, LightBits };
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		uint32_t types = GridLightTypes(counts[i][0], counts[i][1]);
+		printf("grid with %u point and %u spot lights: light bits 0x%02x%s\n", counts[i][0], counts[i][1], types,
+			   types == expected[i] ? "" : "; WRONG");
+		passed &= types == expected[i];
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+// Checks and times ShaderLighting, the CPU version of LightPixelShader's lighting.
+//
+//   LightingBenchmark [samples] [iterations]
+//
+// Shades samples (default 1048576) random positions, normals and base colors with the
+// renderer's start-up lights and with random light sets, compares ShadeSamples and
+// ShadeSamplesScalar against the double precision ShadeSamplesReference, then times each path
+// over iterations (default 20) runs and prints millions of samples per second. Samples within
+// 1e-5 of the spot light's hard cone edge are left out of the comparison, as rounding may put
+// them on either side of it. Exits with 1 if any channel is off by more than 1e-4 or the SIMD and
+// scalar paths disagree. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /fp:precise /I..\DX11UWA\Common LightingBenchmark.cpp ..\DX11UWA\Common\ShaderLighting.cpp
+//   g++ -O2 -mavx2 -ffp-contract=off -I../DX11UWA/Common LightingBenchmark.cpp ../DX11UWA/Common/ShaderLighting.cpp
+
+#include "ShaderLighting.h"
+#include "SimdConfig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const double Tolerance = 1e-4;
+	const double ConeMargin = 1e-5;
+
+	// xorshift32, so runs are repeatable on every platform.
+	struct Random
+	{
+		uint32_t state;
+
+		float Next(float low, float high)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return low + (high - low) * float(state >> 8) / float(1 << 24);
+		}
+	};
+
+	struct SampleArrays
+	{
+		std::vector<float> components[14];	// position, normal, base and color.
+
+		explicit SampleArrays(size_t count)
+		{
+			for (auto& component : components)
+			{
+				component.resize(count);
+			}
+		}
+
+		DX::LightSamples Samples(void)
+		{
+			DX::LightSamples samples;
+			for (int i = 0; i < 3; ++i)
+			{
+				samples.position[i] = components[i].data();
+				samples.normal[i] = components[3 + i].data();
+			}
+			for (int c = 0; c < 4; ++c)
+			{
+				samples.base[c] = components[6 + c].data();
+				samples.color[c] = components[10 + c].data();
+			}
+			return samples;
+		}
+	};
+
+	// The light constants after the renderer's first Update, as in ReferenceRender.
+	void InitialLights(DX::ShaderLightSet& lights)
+	{
+		memset(&lights, 0, sizeof(lights));
+		const float positions[3][3] = { { -7.5f, 5.0f, 0.0f }, { 4.8f, 1.0f, 5.0f }, { 0.0f, 2.0f, -0.1f } };
+		const float colors[3][4] = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } };
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			DX::ShaderLight& light = lights.lights[i];
+			std::copy(positions[i], positions[i] + 3, light.position);
+			light.position[3] = 1.0f;
+			const float* p = positions[i];
+			float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				light.direction[axis] = -p[axis] / length;
+			}
+			light.radius[0] = 10.0f;
+			std::copy(colors[i], colors[i] + 4, light.color);
+			light.typeEnabled[0] = float(i);
+			light.typeEnabled[1] = 1.0f;
+			light.coneRatio[0] = 0.8f;
+			light.coneRatio[1] = 0.45f;
+		}
+		lights.lights[2].coneAngle[1] = -1.0f;
+		lights.lights[2].coneAngle[2] = -1.0f;
+	}
+
+	void RandomLights(Random& random, DX::ShaderLightSet& lights)
+	{
+		memset(&lights, 0, sizeof(lights));
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			DX::ShaderLight& light = lights.lights[i];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				light.position[axis] = random.Next(-8.0f, 8.0f);
+				light.direction[axis] = random.Next(-1.0f, 1.0f);
+				light.coneAngle[axis] = random.Next(-1.0f, 1.0f);
+			}
+			light.position[3] = 1.0f;
+			light.radius[0] = random.Next(2.0f, 20.0f);
+			for (int c = 0; c < 4; ++c)
+			{
+				light.color[c] = random.Next(0.0f, 1.0f);
+			}
+			light.coneRatio[0] = random.Next(0.6f, 0.95f);
+			light.coneRatio[1] = light.coneRatio[0] - random.Next(0.05f, 0.5f);
+		}
+	}
+
+	void RandomSamples(Random& random, SampleArrays& arrays, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				arrays.components[axis][i] = random.Next(-10.0f, 10.0f);
+			}
+			// Interpolated normals, roughly but not exactly unit length.
+			float n[3] = { random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f), random.Next(-1.0f, 1.0f) };
+			float scale = random.Next(0.9f, 1.1f) / std::max(sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]), 1e-3f);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				arrays.components[3 + axis][i] = n[axis] * scale;
+			}
+			for (int c = 0; c < 4; ++c)
+			{
+				arrays.components[6 + c][i] = random.Next(0.0f, 1.0f);
+			}
+		}
+	}
+
+	// Whether the sample is too close to the spot light's cone edge to compare.
+	bool NearConeEdge(const DX::ShaderLight& spot, const SampleArrays& arrays, size_t i)
+	{
+		double d[3], axis[3], dLength = 0.0, axisLength = 0.0;
+		for (int k = 0; k < 3; ++k)
+		{
+			d[k] = double(arrays.components[k][i]) - spot.position[k];
+			axis[k] = spot.coneAngle[k];
+			dLength += d[k] * d[k];
+			axisLength += axis[k] * axis[k];
+		}
+		double ratio = (d[0] * axis[0] + d[1] * axis[1] + d[2] * axis[2]) / sqrt(dLength * axisLength);
+		return fabs(ratio - spot.coneRatio[1]) < ConeMargin;
+	}
+
+	struct Comparison
+	{
+		double maxError;
+		size_t compared;
+		size_t mismatched;		// SIMD and scalar results that differ in any bit.
+	};
+
+	typedef void (*ShadeFunction)(const DX::LightingConstants&, const DX::LightSamples&, size_t);
+
+	bool Check(const char* name, const DX::ShaderLightSet& lights, Random& random, size_t count)
+	{
+		SampleArrays arrays(count);
+		RandomSamples(random, arrays, count);
+		DX::LightSamples samples = arrays.Samples();
+
+		DX::ShadeSamplesReference(lights, samples, count);
+		std::vector<float> reference[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			reference[c] = arrays.components[10 + c];
+		}
+		DX::LightingConstants constants = DX::PrepareLighting(lights);
+		DX::ShadeSamplesScalar(constants, samples, count);
+		std::vector<float> scalar[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			scalar[c] = arrays.components[10 + c];
+		}
+		DX::ShadeSamples(constants, samples, count);
+
+		Comparison result = {};
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (memcmp(&scalar[c][i], &arrays.components[10 + c][i], sizeof(float)))
+				{
+					++result.mismatched;
+				}
+			}
+			if (NearConeEdge(lights.lights[2], arrays, i))
+			{
+				continue;
+			}
+			++result.compared;
+			for (int c = 0; c < 4; ++c)
+			{
+				result.maxError = std::max(result.maxError, fabs(double(scalar[c][i]) - reference[c][i]));
+			}
+		}
+		bool passed = result.maxError <= Tolerance && result.mismatched == 0;
+		printf("%-14s %zu of %zu samples compared, max error %.3g, %zu SIMD channels differ from scalar: %s\n",
+			   name, result.compared, count, result.maxError, result.mismatched, passed ? "ok" : "FAILED");
+		return passed;
+	}
+
+	// Best of iterations, in millions of samples per second.
+	double Throughput(const DX::LightingConstants& constants, const DX::LightSamples& samples, size_t count,
+					  uint32_t iterations, ShadeFunction shade)
+	{
+		double best = 1e30;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			shade(constants, samples, count);
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		return double(count) / best * 1e-6;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? size_t(atol(argv[1])) : size_t(1) << 20;
+	uint32_t iterations = argc > 2 ? uint32_t(atoi(argv[2])) : 20;
+	if (count == 0 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [samples] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	Random random = { 0x2545F491u };
+	bool passed = true;
+	DX::ShaderLightSet lights;
+	InitialLights(lights);
+	passed &= Check("start-up", lights, random, count);
+	for (int i = 0; i < 8; ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "random set %d", i);
+		RandomLights(random, lights);
+		// Odd counts so the paths' scalar tails are checked too.
+		passed &= Check(name, lights, random, count / 8 + size_t(i));
+	}
+
+	InitialLights(lights);
+	SampleArrays arrays(count);
+	RandomSamples(random, arrays, count);
+	DX::LightSamples samples = arrays.Samples();
+	DX::LightingConstants constants = DX::PrepareLighting(lights);
+#if DX_SIMD_AVX2
+	const char* widest = "AVX2";
+#elif DX_SIMD_SSE2
+	const char* widest = "SSE2";
+#else
+	const char* widest = "scalar";
+#endif
+	double fast = Throughput(constants, samples, count, iterations, DX::ShadeSamples);
+	double scalar = Throughput(constants, samples, count, iterations, DX::ShadeSamplesScalar);
+	auto start = std::chrono::steady_clock::now();
+	DX::ShadeSamplesReference(lights, samples, count);
+	double reference = double(count) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e-6;
+	printf("%zu samples: ShadeSamples (%s) %.1f Msamples/s, scalar %.1f Msamples/s (%.2fx), double reference %.1f Msamples/s\n",
+		   count, widest, fast, scalar, fast / scalar, reference);
+	return passed ? 0 : 1;
+}
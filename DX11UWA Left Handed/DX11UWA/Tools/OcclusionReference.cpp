@@ -0,0 +1,308 @@
+// Rasterizes the renderer's occluders on the CPU and writes the occlusion depth buffer, for reference images.
+//
+//   OcclusionReference <Assets dir> <output.pgm> [-view start|low|near] [-size W H] [-frames N] [-compare reference.pgm] [-tolerance T]
+//
+// Loads floor_platform.obj and stadium.obj, the meshes Sample3DSceneRenderer keeps as occluders,
+// rasterizes them into an OcclusionBuffer (default 320x192, the renderer's) from one of three
+// cameras and writes the buffer with WriteDepthImage: start is the renderer's start-up view,
+// low looks along the platform from just above the floor so the platform hides most of the scene,
+// near sits between the platform's triangles so they are clipped at the near plane. Then tests the boxes of the other draw items, the light
+// pyramids included, and prints which are hidden. frames rasterizes that many times and prints
+// the time per frame. compare diffs the image against an earlier one and exits with 1 if any
+// pixel is off by more than tolerance (default 2) or the sizes differ, so the checked-in
+// Reference/Occlusion*_320x192.pgm images work as regression tests for every SIMD path. Only
+// depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common OcclusionReference.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\ObjMesh.cpp ..\DX11UWA\Common\OcclusionBuffer.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common OcclusionReference.cpp ../DX11UWA/Common/{FrustumCulling,ObjMesh,OcclusionBuffer,WorkerPool}.cpp
+
+#include "FrustumCulling.h"
+#include "ObjMesh.h"
+#include "OcclusionBuffer.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Same values as in Sample3DSceneRenderer.
+	const float NearZ = 0.01f;
+	const float FarZ = 100.0f;
+	const float FieldOfView = 70.0f * 3.14159265f / 180.0f;
+
+	struct View
+	{
+		const char* name;
+		float eye[3];
+		float at[3];
+	};
+
+	const View Views[] =
+	{
+		{ "start", { 0.0f, 0.7f, -1.5f }, { 0.0f, -0.1f, 0.0f } },
+		{ "low", { 0.0f, 0.2f, -7.0f }, { 0.0f, 0.3f, 0.0f } },
+		{ "near", { 0.5f, 0.3f, -0.5f }, { -1.0f, 0.2f, 3.0f } },
+	};
+
+	const char* const OccluderFiles[] = { "floor_platform.obj", "stadium.obj" };
+	const char* const OccludeeFiles[] = { "floor_bottom.obj", "pokeballred.obj", "pokeballwhite.obj", "pokeballblack.obj", "sphere.obj" };
+
+	// Where the light pyramids stand after the renderer's first Update.
+	const float LightPositions[3][3] = { { -7.5f, 5.0f, 0.0f }, { 4.8f, 1.0f, 5.0f }, { 0.0f, 2.0f, -0.1f } };
+
+	struct Mesh
+	{
+		std::vector<DX::ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	struct Occludee
+	{
+		std::string name;
+		float min[3];
+		float max[3];
+	};
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* SimdPath(void)
+	{
+#if DX_SIMD_AVX2
+		return "AVX2";
+#elif DX_SIMD_SSE2
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	// Row-major, row-vector view-projection as XMMatrixLookAtLH times XMMatrixPerspectiveFovLH.
+	void ViewProjection(const View& view, float aspect, float out[16])
+	{
+		float z[3] = { view.at[0] - view.eye[0], view.at[1] - view.eye[1], view.at[2] - view.eye[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		z[0] /= length; z[1] /= length; z[2] /= length;
+		// x = normalize(cross(up, z)) with up = +y.
+		float x[3] = { z[2], 0.0f, -z[0] };
+		length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length; x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		const float* eye = view.eye;
+		const float lookAt[16] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]),
+			-(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+			-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f
+		};
+		float height = 1.0f / tanf(FieldOfView * 0.5f);
+		float range = FarZ / (FarZ - NearZ);
+		const float perspective[16] =
+		{
+			height / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, height, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -NearZ * range, 0.0f
+		};
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; ++k)
+				{
+					sum += lookAt[row * 4 + k] * perspective[k * 4 + column];
+				}
+				out[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// Reads a binary PGM as WriteDepthImage writes it.
+	bool ReadDepthImage(const char* path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+		unsigned w = 0, h = 0, maxValue = 0;
+		bool read = fscanf(file, "P5 %u %u %u", &w, &h, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+		if (read)
+		{
+			pixels.resize(size_t(w) * h);
+			read = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+		}
+		fclose(file);
+		width = w;
+		height = h;
+		return read;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> <output.pgm> [-view start|low|near] [-size W H] [-frames N] [-compare reference.pgm] [-tolerance T]\n", argv[0]);
+		return 1;
+	}
+	const std::string assets = argv[1];
+	const char* output = argv[2];
+	uint32_t width = 320, height = 192, frames = 1, tolerance = 2;
+	const View* view = &Views[0];
+	const char* reference = nullptr;
+	for (int i = 3; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-view") && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			view = nullptr;
+			for (const View& candidate : Views)
+			{
+				if (!strcmp(candidate.name, name))
+					view = &candidate;
+			}
+			if (!view)
+			{
+				fprintf(stderr, "unknown view %s\n", name);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-size") && i + 2 < argc)
+		{
+			width = static_cast<uint32_t>(atoi(argv[++i]));
+			height = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-compare") && i + 1 < argc)
+			reference = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = static_cast<uint32_t>(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (width == 0 || height == 0 || frames == 0)
+	{
+		fprintf(stderr, "size and frames must be positive\n");
+		return 1;
+	}
+
+	Mesh occluders[2];
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		if (!DX::LoadObjMesh((assets + "/" + OccluderFiles[i]).c_str(), occluders[i].vertices, occluders[i].indices) ||
+			occluders[i].indices.empty())
+		{
+			fprintf(stderr, "%s: can't load mesh\n", OccluderFiles[i]);
+			return 1;
+		}
+	}
+	std::vector<Occludee> occludees;
+	Mesh pyramid;
+	for (const char* file : OccludeeFiles)
+	{
+		Mesh mesh;
+		if (!DX::LoadObjMesh((assets + "/" + file).c_str(), mesh.vertices, mesh.indices) || mesh.vertices.empty())
+		{
+			fprintf(stderr, "%s: can't load mesh\n", file);
+			return 1;
+		}
+		DX::MeshBounds bounds = DX::ComputeMeshBounds(mesh.vertices[0].pos, mesh.vertices.size(), sizeof(DX::ObjVertex));
+		occludees.push_back(Occludee{ file, { bounds.min[0], bounds.min[1], bounds.min[2] }, { bounds.max[0], bounds.max[1], bounds.max[2] } });
+	}
+	if (!DX::LoadObjMesh((assets + "/pyramid.obj").c_str(), pyramid.vertices, pyramid.indices) || pyramid.vertices.empty())
+	{
+		fprintf(stderr, "pyramid.obj: can't load mesh\n");
+		return 1;
+	}
+	DX::MeshBounds pyramidBounds = DX::ComputeMeshBounds(pyramid.vertices[0].pos, pyramid.vertices.size(), sizeof(DX::ObjVertex));
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const float world[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, LightPositions[i][0], LightPositions[i][1], LightPositions[i][2], 1 };
+		DX::MeshBounds bounds = DX::TransformBounds(pyramidBounds, world);
+		occludees.push_back(Occludee{ "pyramid.obj at light " + std::to_string(i), { bounds.min[0], bounds.min[1], bounds.min[2] },
+									  { bounds.max[0], bounds.max[1], bounds.max[2] } });
+	}
+
+	float viewProjection[16];
+	ViewProjection(*view, float(width) / float(height), viewProjection);
+	const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	DX::OcclusionBuffer occlusion(width, height);
+	double totalMs = 0.0, bestMs = 1e30;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+		occlusion.BeginFrame(viewProjection);
+		for (const Mesh& mesh : occluders)
+		{
+			occlusion.AddOccluder(mesh.vertices[0].pos, sizeof(DX::ObjVertex), mesh.indices.data(), mesh.indices.size(), identity);
+		}
+		occlusion.Rasterize();
+		double ms = Milliseconds(start);
+		totalMs += ms;
+		bestMs = std::min(bestMs, ms);
+	}
+	printf("%s view, %ux%u, %s build, %u worker threads: %zu triangles, %.3f ms per frame (best %.3f)\n", view->name,
+		   occlusion.GetWidth(), occlusion.GetHeight(), SimdPath(), DX::WorkerPool::Shared().GetConcurrency(), occlusion.GetTriangleCount(),
+		   totalMs / frames, bestMs);
+
+	uint32_t hidden = 0;
+	for (const Occludee& occludee : occludees)
+	{
+		bool visible = occlusion.TestBox(occludee.min, occludee.max);
+		hidden += visible ? 0 : 1;
+		printf("  %-24s %s\n", occludee.name.c_str(), visible ? "visible" : "hidden");
+	}
+	printf("%u of %zu items hidden\n", hidden, occludees.size());
+
+	if (!occlusion.WriteDepthImage(output))
+	{
+		fprintf(stderr, "%s: can't write image\n", output);
+		return 1;
+	}
+
+	if (reference)
+	{
+		std::vector<uint8_t> expected, actual;
+		uint32_t expectedWidth = 0, expectedHeight = 0, actualWidth = 0, actualHeight = 0;
+		if (!ReadDepthImage(reference, expected, expectedWidth, expectedHeight) || !ReadDepthImage(output, actual, actualWidth, actualHeight))
+		{
+			fprintf(stderr, "%s: can't read image\n", reference);
+			return 1;
+		}
+		if (expectedWidth != actualWidth || expectedHeight != actualHeight)
+		{
+			fprintf(stderr, "%s is %ux%u, rasterized %ux%u\n", reference, expectedWidth, expectedHeight, actualWidth, actualHeight);
+			return 1;
+		}
+		uint32_t maxError = 0;
+		size_t pixelsOver = 0;
+		for (size_t i = 0; i < actual.size(); ++i)
+		{
+			uint32_t error = uint32_t(abs(int(actual[i]) - int(expected[i])));
+			maxError = std::max(maxError, error);
+			pixelsOver += error > tolerance ? 1 : 0;
+		}
+		printf("against %s: max error %u, %zu pixels over %u\n", reference, maxError, pixelsOver, tolerance);
+		if (pixelsOver)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,398 @@
+// Renders the scene on the CPU, for reference images on machines without a GPU.
+//
+//   ReferenceRender <Assets dir> <output.ppm> [-size W H] [-look EX EY EZ AX AY AZ] [-frames N] [-compare reference.ppm] [-tolerance T]
+//
+// Loads the meshes and textures Sample3DSceneRenderer draws and renders its start-up view, with
+// the lights after their first Update step, through SoftwareRasterizer: the lit meshes that
+// TessellationPolicy tessellates as patches with the constants the hull and domain shaders get
+// (the pre-tessellated levels the renderer draws instead reproduce that path), the flat ones as
+// triangle lists, the sphere as the line list of its MeshEdges edges at the pre-tessellated level
+// the renderer picks for its distance, and the light pyramids as instanced strips.
+// The skybox is left out; SkyboxReference checks the cube map it samples. look moves the camera
+// to eye E looking at A, as the user can; Reference/SceneEdges_320x180.ppm looks at the sphere,
+// which the start-up view doesn't show, with "-look 0 3.5 -3 0 3.5 0". frames renders the image
+// that many times and prints the frame rate. compare diffs the result against an earlier image
+// and exits with 1 if any color channel is off by more than tolerance (default 2) or the sizes
+// differ, so checked-in images such as Reference/Scene_320x180.ppm work as regression tests.
+// Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common ReferenceRender.cpp ..\DX11UWA\Common\AlphaCoverage.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\InstanceSet.cpp ..\DX11UWA\Common\MeshEdges.cpp ..\DX11UWA\Common\ObjMesh.cpp ..\DX11UWA\Common\ShaderLighting.cpp ..\DX11UWA\Common\SoftwareRasterizer.cpp ..\DX11UWA\Common\TessellationCache.cpp ..\DX11UWA\Common\TessellationPolicy.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common ReferenceRender.cpp ../DX11UWA/Common/{AlphaCoverage,DDSFile,DDSFormatConvert,FrustumCulling,InstanceSet,MeshEdges,ObjMesh,ShaderLighting,SoftwareRasterizer,TessellationCache,TessellationPolicy,WorkerPool}.cpp
+
+#include "AlphaCoverage.h"
+#include "DDSFile.h"
+#include "FrustumCulling.h"
+#include "InstanceSet.h"
+#include "MeshEdges.h"
+#include "ObjMesh.h"
+#include "SoftwareRasterizer.h"
+#include "TessellationCache.h"
+#include "TessellationPolicy.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Same values and meaning as in Sample3DSceneRenderer.
+	const float NearZ = 0.01f;
+	const float FarZ = 100.0f;
+	const float FieldOfView = 70.0f * 3.14159265f / 180.0f;
+	const float Eye[3] = { 0.0f, 0.7f, -1.5f };
+	const float At[3] = { 0.0f, -0.1f, 0.0f };
+	const float ClearColor[4] = { 0.392156899f, 0.584313750f, 0.929411829f, 1.0f };	// CornflowerBlue.
+	const float TessellationPixelsPerSegment = 16.0f;
+	const size_t MaxPretessellatedVertices = 1 << 20;
+
+	enum MaterialId : uint32_t { MaterialCastle = 0, MaterialPokeball, MaterialCount, MaterialNone = MaterialCount };
+
+	struct MeshInfo
+	{
+		const char* file;
+		DX::SoftwarePrimitive primitive;
+		MaterialId material;
+	};
+
+	// The renderer's draw items: PipelineLit, PipelineEdges and PipelineInstanced. Lit meshes that
+	// TessellationPolicy leaves flat are drawn as triangle lists, as PipelineLitFlat does.
+	const MeshInfo Meshes[] =
+	{
+		{ "floor_bottom.obj", DX::PrimitivePatchList, MaterialCastle },
+		{ "floor_platform.obj", DX::PrimitivePatchList, MaterialCastle },
+		{ "pokeballred.obj", DX::PrimitivePatchList, MaterialPokeball },
+		{ "pokeballwhite.obj", DX::PrimitivePatchList, MaterialPokeball },
+		{ "pokeballblack.obj", DX::PrimitivePatchList, MaterialPokeball },
+		{ "stadium.obj", DX::PrimitivePatchList, MaterialPokeball },
+		{ "sphere.obj", DX::PrimitiveLineList, MaterialNone },
+		{ "pyramid.obj", DX::PrimitiveTriangleStrip, MaterialNone },
+	};
+	const uint32_t MeshCount = sizeof(Meshes) / sizeof(Meshes[0]);
+	const char* const MaterialFiles[MaterialCount] = { "Castle1.dds", "pokeball.dds" };
+
+	struct Mesh
+	{
+		std::vector<DX::ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+		DX::TessellationPolicy tessellation;
+		DX::MeshBounds bounds;
+		// Line lists: the pre-tessellated levels, coarsest first, and each level's unique edges;
+		// without levels, the edges of the mesh itself.
+		DX::TessellationCache levels;
+		std::vector<std::vector<uint32_t>> levelLines;
+	};
+
+	// Row-major, row-vector matrices as in DirectXMath.
+	void LookAtLH(const float eye[3], const float at[3], float out[16])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		z[0] /= length; z[1] /= length; z[2] /= length;
+		// x = normalize(cross(up, z)) with up = +y.
+		float x[3] = { z[2], 0.0f, -z[0] };
+		length = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= length; x[2] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		const float matrix[16] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]),
+			-(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]),
+			-(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]), 1.0f
+		};
+		std::copy(matrix, matrix + 16, out);
+	}
+
+	void PerspectiveFovLH(float fov, float aspect, float nearZ, float farZ, float out[16])
+	{
+		float height = 1.0f / tanf(fov * 0.5f);
+		float range = farZ / (farZ - nearZ);
+		const float matrix[16] =
+		{
+			height / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, height, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -nearZ * range, 0.0f
+		};
+		std::copy(matrix, matrix + 16, out);
+	}
+
+	// The light constants after the renderer's first Update: every light starts out moving towards
+	// its negative limit, so the directional light is at x = -7.5, the point light at x = 4.8 and
+	// the spot light at z = -0.1 with its cone tipped towards -z.
+	void InitialLights(const float eye[3], DX::ShaderLightSet& lights)
+	{
+		memset(&lights, 0, sizeof(lights));
+		std::copy(eye, eye + 3, lights.eyePosition);
+		lights.eyePosition[3] = 1.0f;
+
+		const float positions[3][3] = { { -7.5f, 5.0f, 0.0f }, { 4.8f, 1.0f, 5.0f }, { 0.0f, 2.0f, -0.1f } };
+		const float colors[3][4] = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } };
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			DX::ShaderLight& light = lights.lights[i];
+			std::copy(positions[i], positions[i] + 3, light.position);
+			light.position[3] = 1.0f;
+			const float* p = positions[i];
+			float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+			light.direction[0] = -p[0] / length;
+			light.direction[1] = -p[1] / length;
+			light.direction[2] = -p[2] / length;
+			light.radius[0] = 10.0f;
+			std::copy(colors[i], colors[i] + 4, light.color);
+			light.attenuation[0] = 45.0f * 3.14159265f / 180.0f;
+			light.attenuation[1] = 1.0f;
+			light.attenuation[2] = 2.0f;
+			light.typeEnabled[0] = float(i);
+			light.typeEnabled[1] = 1.0f;
+			light.coneRatio[0] = 0.8f;
+			light.coneRatio[1] = 0.45f;
+		}
+		lights.lights[2].coneAngle[1] = -1.0f;
+		lights.lights[2].coneAngle[2] = -1.0f;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> <output.ppm> [-size W H] [-look EX EY EZ AX AY AZ] [-frames N] [-compare reference.ppm] [-tolerance T]\n", argv[0]);
+		return 1;
+	}
+	const std::string assets = argv[1];
+	const char* output = argv[2];
+	uint32_t width = 1280, height = 720, frames = 1, tolerance = 2;
+	const char* reference = nullptr;
+	float eye[3] = { Eye[0], Eye[1], Eye[2] };
+	float at[3] = { At[0], At[1], At[2] };
+	for (int i = 3; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-size") && i + 2 < argc)
+		{
+			width = static_cast<uint32_t>(atoi(argv[++i]));
+			height = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "-look") && i + 6 < argc)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				eye[c] = static_cast<float>(atof(argv[++i]));
+			}
+			for (int c = 0; c < 3; ++c)
+			{
+				at[c] = static_cast<float>(atof(argv[++i]));
+			}
+		}
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-compare") && i + 1 < argc)
+			reference = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = static_cast<uint32_t>(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (width == 0 || height == 0 || frames == 0)
+	{
+		fprintf(stderr, "size and frames must be positive\n");
+		return 1;
+	}
+
+	// Assets, as the renderer's loader tasks read them.
+	auto start = std::chrono::steady_clock::now();
+	Mesh meshes[MeshCount];
+	for (uint32_t i = 0; i < MeshCount; ++i)
+	{
+		if (!DX::LoadObjMesh((assets + "/" + Meshes[i].file).c_str(), meshes[i].vertices, meshes[i].indices) ||
+			meshes[i].indices.empty())
+		{
+			fprintf(stderr, "%s: can't load mesh\n", Meshes[i].file);
+			return 1;
+		}
+		Mesh& mesh = meshes[i];
+		mesh.tessellation = DX::AnalyzeTessellation(mesh.vertices[0].pos, mesh.vertices[0].normal, sizeof(DX::ObjVertex),
+													mesh.indices.data(), mesh.indices.size());
+		mesh.bounds = DX::ComputeMeshBounds(mesh.vertices[0].pos, mesh.vertices.size(), sizeof(DX::ObjVertex));
+
+		// CreateDrawItem's edge draws: every edge once, of each level when the mesh is tessellated.
+		if (Meshes[i].primitive != DX::PrimitiveLineList)
+			continue;
+		DX::EdgeList edges;
+		if (mesh.tessellation.tessellate &&
+			mesh.levels.Build(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), mesh.tessellation.maxFactor,
+							  mesh.tessellation.phongAlpha, MaxPretessellatedVertices, DX::WorkerPool::Shared()))
+		{
+			for (size_t level = 0; level < mesh.levels.GetLevelCount(); ++level)
+			{
+				const DX::TessellatedMesh& tessellated = mesh.levels.GetLevel(level);
+				DX::ExtractEdges(tessellated.vertices[0].pos, sizeof(DX::ObjVertex), tessellated.indices.data(), tessellated.indices.size(), edges);
+				mesh.levelLines.push_back(edges.lines);
+			}
+		}
+		else
+		{
+			DX::ExtractEdges(mesh.vertices[0].pos, sizeof(DX::ObjVertex), mesh.indices.data(), mesh.indices.size(), edges);
+			mesh.levelLines.push_back(edges.lines);
+		}
+	}
+	DX::DDSImage materials[MaterialCount];
+	DX::AlphaClass materialAlpha[MaterialCount];
+	for (uint32_t i = 0; i < MaterialCount; ++i)
+	{
+		if (!DX::ReadDDSFile((assets + "/" + MaterialFiles[i]).c_str(), materials[i]))
+		{
+			fprintf(stderr, "%s: can't read texture\n", MaterialFiles[i]);
+			return 1;
+		}
+		materialAlpha[i] = DX::ClassifyImageAlpha(materials[i]);
+	}
+	printf("loaded in %.1f ms\n", Milliseconds(start));
+
+	float aspect = float(width) / float(height);
+	float view[16], projection[16];
+	LookAtLH(eye, at, view);
+	PerspectiveFovLH(aspect < 1.0f ? FieldOfView * 2.0f : FieldOfView, aspect, NearZ, FarZ, projection);
+	DX::ShaderLightSet lights;
+	InitialLights(eye, lights);
+	// An edge of length l at distance d covers about l / d times the focal length in pixels.
+	float focalPixels = 0.5f * height / tanf(0.5f * (aspect < 1.0f ? FieldOfView * 2.0f : FieldOfView));
+	float tessellationScale = focalPixels / TessellationPixelsPerSegment;
+
+	// A pyramid marks each light.
+	DX::InstanceSet pyramids;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const float* p = lights.lights[i].position;
+		const float world[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, p[0], p[1], p[2], 1 };
+		pyramids.Add(world);
+	}
+
+	DX::SoftwareRasterizer rasterizer(width, height);
+	double totalMs = 0.0, bestMs = 1e30;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+		rasterizer.BeginFrame(view, projection, lights, ClearColor);
+		for (uint32_t i = 0; i < MeshCount; ++i)
+		{
+			DX::SoftwareDraw draw = {};
+			const Mesh& mesh = meshes[i];
+			draw.vertices = mesh.vertices.data();
+			draw.indices = mesh.indices.data();
+			draw.indexCount = uint32_t(mesh.indices.size());
+			draw.primitive = Meshes[i].primitive;
+			const DX::TessellationPolicy& tessellation = mesh.tessellation;
+			if (draw.primitive == DX::PrimitiveLineList)
+			{
+				// The level the renderer's SubmitDrawItems picks: the largest factor the hull
+				// shader would give any edge, the longest one as close as the bounds allow.
+				size_t level = 0;
+				if (mesh.levels.GetLevelCount())
+				{
+					float center[4];
+					const float* c = mesh.bounds.center;
+					for (int column = 0; column < 4; ++column)
+					{
+						center[column] = c[0] * view[column] + c[1] * view[4 + column] + c[2] * view[8 + column] + view[12 + column];
+					}
+					float distance = std::max(sqrtf(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]) - mesh.bounds.radius, NearZ);
+					level = mesh.levels.SelectLevel(std::min(tessellation.edgeLength * tessellationScale / distance, tessellation.maxFactor));
+					draw.vertices = mesh.levels.GetLevel(level).vertices.data();
+				}
+				draw.indices = mesh.levelLines[level].data();
+				draw.indexCount = uint32_t(mesh.levelLines[level].size());
+			}
+			if (draw.primitive == DX::PrimitivePatchList && !tessellation.tessellate)
+				draw.primitive = DX::PrimitiveTriangleList;
+			if (draw.primitive == DX::PrimitivePatchList)
+			{
+				draw.tessellation[0] = tessellation.maxFactor;
+				draw.tessellation[1] = tessellation.phongAlpha;
+				draw.tessellation[2] = tessellationScale;
+			}
+			const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			std::copy(identity, identity + 16, draw.world);
+			MaterialId material = Meshes[i].material;
+			if (material == MaterialNone)
+			{
+				draw.pixelShader = DX::PixelUV;
+			}
+			else
+			{
+				// PipelineLitOpaque drops the alpha test for materials without any transparent texel.
+				draw.pixelShader = materialAlpha[material] == DX::AlphaOpaque ? DX::PixelLitOpaque : DX::PixelLit;
+				draw.texture = &materials[material];
+			}
+			if (draw.primitive == DX::PrimitiveTriangleStrip)
+			{
+				draw.instances = &pyramids.Get(0);
+				draw.instanceCount = uint32_t(pyramids.Size());
+			}
+			rasterizer.Draw(draw);
+		}
+		rasterizer.Render();
+		double ms = Milliseconds(frameStart);
+		totalMs += ms;
+		bestMs = std::min(bestMs, ms);
+	}
+
+	const DX::SoftwareRasterStats& stats = rasterizer.GetStats();
+	printf("%ux%u, %u worker threads: %.2f ms per frame (best %.2f), %.1f fps\n", width, height,
+		   DX::WorkerPool::Shared().GetConcurrency(), totalMs / frames, bestMs, 1000.0 * frames / totalMs);
+	printf("%u draws, %u patches/triangles in, %u triangles after tessellation, %u culled, %u lines\n",
+		   stats.draws, stats.patches, stats.triangles, stats.culled, stats.lines);
+	printf("%llu tile bin entries, %llu pixels shaded, %llu written\n", (unsigned long long)stats.binned,
+		   (unsigned long long)stats.pixelsShaded, (unsigned long long)stats.pixelsWritten);
+
+	if (!rasterizer.WriteImage(output))
+	{
+		fprintf(stderr, "%s: can't write image\n", output);
+		return 1;
+	}
+
+	if (reference)
+	{
+		std::vector<uint32_t> expected;
+		uint32_t expectedWidth = 0, expectedHeight = 0;
+		if (!DX::ReadImage(reference, expected, expectedWidth, expectedHeight))
+		{
+			fprintf(stderr, "%s: can't read image\n", reference);
+			return 1;
+		}
+		if (expectedWidth != width || expectedHeight != height)
+		{
+			fprintf(stderr, "%s is %ux%u, rendered %ux%u\n", reference, expectedWidth, expectedHeight, width, height);
+			return 1;
+		}
+		std::vector<uint32_t> actual(size_t(width) * height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint32_t* row = rasterizer.GetColorData() + y * rasterizer.GetPitch();
+			std::copy(row, row + width, actual.begin() + size_t(y) * width);
+		}
+		DX::ImageDifference difference = DX::CompareImages(actual.data(), expected.data(), actual.size(), tolerance);
+		printf("against %s: max error %u, rms %.3f, %zu pixels over %u\n", reference, difference.maxError,
+			   difference.rootMeanSquare, difference.pixelsOver, tolerance);
+		if (difference.pixelsOver)
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+// Checks and times RenderQueue, the radix-sorted draw list Sample3DSceneRenderer submits through.
+//
+//   RenderQueueBenchmark [draws] [iterations]
+//
+// Packs and unpacks every DrawKey field at its limits, and checks that QuantizeDepth clamps to the
+// clip range and reverses for back to front passes. Then sorts queues of every size around the
+// insertion sort threshold, and some larger ones, whose keys either vary in every field or share
+// all but the depth, and compares each with std::stable_sort: same keys in the same order, and
+// draws with equal keys still in the order they were submitted. Last, times sorting draws
+// (default 100000) packets like the scene's, a few passes and shaders, a few hundred materials and
+// meshes and any depth, against std::sort and std::stable_sort over iterations (default 50) runs.
+// Exits with 1 on any mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common RenderQueueBenchmark.cpp ..\DX11UWA\Common\RenderQueue.cpp
+//   g++ -O2 -I../DX11UWA/Common RenderQueueBenchmark.cpp ../DX11UWA/Common/RenderQueue.cpp
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	const size_t QueueSizes[] = { 0, 1, 2, 3, 17, 62, 63, 64, 65, 255, 1000, 4097, 65536 };
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool KeyLess(const DX::DrawPacket& a, const DX::DrawPacket& b)
+	{
+		return a.key < b.key;
+	}
+
+	bool CheckKeys(void)
+	{
+		using namespace DX;
+		const uint32_t pass = (1u << DrawKey::PassBits) - 1, shader = (1u << DrawKey::ShaderBits) - 1;
+		const uint32_t material = (1u << DrawKey::MaterialBits) - 1, mesh = (1u << DrawKey::MeshBits) - 1;
+		const uint32_t depth = (1u << DrawKey::DepthBits) - 1;
+		bool passed = DrawKey::Make(pass, shader, material, mesh, depth) == ~uint64_t(0);
+
+		uint32_t state = 3;
+		for (uint32_t i = 0; i < 10000; ++i)
+		{
+			uint32_t p = Random(state) & pass, s = Random(state) & shader, m = Random(state) & material;
+			uint32_t e = Random(state) & mesh, d = Random(state) & depth;
+			uint64_t key = DrawKey::Make(p, s, m, e, d);
+			passed &= DrawKey::Pass(key) == p && DrawKey::Shader(key) == s && DrawKey::Material(key) == m &&
+					  DrawKey::Mesh(key) == e && DrawKey::Depth(key) == d;
+			// A field out of range must not spill into its neighbours.
+			passed &= DrawKey::Make(p, s, m + material + 1, e, d) == key;
+		}
+
+		// Pass sorts before shader, shader before material and so on down to depth.
+		passed &= DrawKey::Make(1, 0, 0, 0, 0) > DrawKey::Make(0, shader, material, mesh, depth);
+		passed &= DrawKey::Make(0, 1, 0, 0, 0) > DrawKey::Make(0, 0, material, mesh, depth);
+		passed &= DrawKey::Make(0, 0, 1, 0, 0) > DrawKey::Make(0, 0, 0, mesh, depth);
+		passed &= DrawKey::Make(0, 0, 0, 1, 0) > DrawKey::Make(0, 0, 0, 0, depth);
+
+		passed &= DrawKey::QuantizeDepth(0.01f, 0.01f, 100.0f) == 0 && DrawKey::QuantizeDepth(100.0f, 0.01f, 100.0f) == depth;
+		passed &= DrawKey::QuantizeDepth(-5.0f, 0.01f, 100.0f) == 0 && DrawKey::QuantizeDepth(500.0f, 0.01f, 100.0f) == depth;
+		passed &= DrawKey::QuantizeDepth(0.01f, 0.01f, 100.0f, true) == depth && DrawKey::QuantizeDepth(100.0f, 0.01f, 100.0f, true) == 0;
+		uint32_t previous = 0;
+		for (float z = 0.01f; z < 100.0f; z += 0.37f)
+		{
+			uint32_t quantized = DrawKey::QuantizeDepth(z, 0.01f, 100.0f);
+			passed &= quantized >= previous && DrawKey::QuantizeDepth(z, 0.01f, 100.0f, true) == depth - quantized;
+			previous = quantized;
+		}
+		printf("keys: fields round trip, sort in field order, depth quantizes monotonically%s\n", passed ? "" : "; FAILED");
+		return passed;
+	}
+
+	// depthOnly keys share every field but a depth of 0 to 15, so equal keys are common and stability shows.
+	uint64_t RandomKey(uint32_t& state, bool depthOnly)
+	{
+		uint32_t depth = Random(state) & 0xffffff;
+		if (depthOnly)
+			return DX::DrawKey::Make(1, 7, 42, 5, depth % 16);
+		return DX::DrawKey::Make(Random(state) % 3, Random(state) % 32, Random(state) % 300, Random(state) % 300, depth);
+	}
+
+	bool CheckOrder(void)
+	{
+		uint32_t state = 11;
+		for (size_t count : QueueSizes)
+		{
+			for (int depthOnly = 0; depthOnly < 2; ++depthOnly)
+			{
+				DX::RenderQueue queue;
+				std::vector<DX::DrawPacket> expected;
+				for (size_t i = 0; i < count; ++i)
+				{
+					uint64_t key = RandomKey(state, depthOnly != 0);
+					queue.Submit(key, uint32_t(i), uint32_t(count - i));
+					expected.push_back(DX::DrawPacket{ key, uint32_t(i), uint32_t(count - i) });
+				}
+				queue.Sort();
+				std::stable_sort(expected.begin(), expected.end(), KeyLess);
+				bool same = queue.Size() == count;
+				for (size_t i = 0; same && i < count; ++i)
+				{
+					const DX::DrawPacket& packet = queue.begin()[i];
+					same = packet.key == expected[i].key && packet.item == expected[i].item && packet.user == expected[i].user;
+				}
+				if (!same)
+				{
+					printf("%zu draws%s: order differs from std::stable_sort\n", count, depthOnly ? " sharing all but depth" : "");
+					return false;
+				}
+			}
+		}
+		printf("order: %zu queue sizes from 0 to %zu match std::stable_sort\n", sizeof(QueueSizes) / sizeof(QueueSizes[0]),
+			   QueueSizes[sizeof(QueueSizes) / sizeof(QueueSizes[0]) - 1]);
+		return true;
+	}
+
+	bool Benchmark(size_t draws, uint32_t iterations)
+	{
+		uint32_t state = 19;
+		std::vector<DX::DrawPacket> submitted;
+		for (size_t i = 0; i < draws; ++i)
+		{
+			submitted.push_back(DX::DrawPacket{ RandomKey(state, false), uint32_t(i), 0 });
+		}
+
+		DX::RenderQueue queue;
+		queue.Reserve(draws);
+		std::vector<DX::DrawPacket> sorted, stable;
+		double radixMs = 0.0, sortMs = 0.0, stableMs = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			queue.Clear();
+			for (const DX::DrawPacket& packet : submitted)
+			{
+				queue.Submit(packet.key, packet.item);
+			}
+			auto start = std::chrono::steady_clock::now();
+			queue.Sort();
+			radixMs += Milliseconds(start);
+
+			sorted = submitted;
+			start = std::chrono::steady_clock::now();
+			std::sort(sorted.begin(), sorted.end(), KeyLess);
+			sortMs += Milliseconds(start);
+
+			stable = submitted;
+			start = std::chrono::steady_clock::now();
+			std::stable_sort(stable.begin(), stable.end(), KeyLess);
+			stableMs += Milliseconds(start);
+		}
+
+		bool same = queue.Size() == draws;
+		for (size_t i = 0; same && i < draws; ++i)
+		{
+			same = queue.begin()[i].key == stable[i].key && queue.begin()[i].item == stable[i].item;
+		}
+		printf("%zu draws: RenderQueue::Sort %.3f ms, std::sort %.3f ms (%.1fx), std::stable_sort %.3f ms (%.1fx)%s\n", draws,
+			   radixMs / iterations, sortMs / iterations, sortMs / radixMs, stableMs / iterations, stableMs / radixMs,
+			   same ? "" : "; DIFFERS");
+		return same;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t draws = argc > 1 ? size_t(atoi(argv[1])) : 100000;
+	uint32_t iterations = argc > 2 ? uint32_t(atoi(argv[2])) : 50;
+	if (argc > 3 || iterations == 0)
+	{
+		fprintf(stderr, "usage: %s [draws] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckKeys();
+	passed &= CheckOrder();
+	passed &= Benchmark(draws, iterations);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+// Checks TextureResidency, the budget and eviction policy behind the renderer's SetResourceMinLOD.
+//
+//   ResidencyCheck [textures] [frames]
+//
+// First replays a scripted trace of eight 256x256 textures and checks the exact residency after
+// each frame: nothing changes while everything fits, the least recently sampled textures lose
+// their fine mips when the budget shrinks, a texture sampled again is restored by evicting ones
+// that weren't, a budget below every coarsest mip keeps exactly the coarsest mips, and requested
+// mips come back once the budget allows. Then replays a random trace over textures (default 256)
+// of mixed sizes and cube maps whose working set drifts for frames (default 2000) under a budget
+// of 40% of the total. After every frame the changes reported must match GetResidentMip, the stats
+// must match the mips kept, the budget must hold unless only coarsest mips are left, and a texture
+// sampled this frame may only be short of its mips once every other one is down to its coarsest.
+// Prints the eviction counts and the time per EndFrame, and exits with 1 on any mismatch. Only
+// depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common ResidencyCheck.cpp ..\DX11UWA\Common\TextureResidency.cpp
+//   g++ -O2 -I../DX11UWA/Common ResidencyCheck.cpp ../DX11UWA/Common/TextureResidency.cpp
+
+#include "TextureResidency.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// A full mip chain of 32-bit texels, summed over slices.
+	std::vector<uint64_t> MipChain(uint32_t width, uint32_t height, uint32_t slices)
+	{
+		std::vector<uint64_t> mips;
+		for (;;)
+		{
+			mips.push_back(uint64_t(width) * height * 4 * slices);
+			if (width == 1 && height == 1)
+				break;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		return mips;
+	}
+
+	// The residency the renderer would see, rebuilt from the reported changes alone.
+	class Trace
+	{
+	public:
+		explicit Trace(uint64_t budget) : m_residency(budget), m_passed(true) {}
+
+		uint32_t Register(const std::vector<uint64_t>& mips)
+		{
+			uint32_t handle = m_residency.Register(mips.data(), uint32_t(mips.size()));
+			if (handle >= m_mips.size())
+			{
+				m_mips.resize(handle + 1);
+				m_applied.resize(handle + 1);
+				m_touched.resize(handle + 1);
+			}
+			m_mips[handle] = mips;
+			m_applied[handle] = 0;
+			m_touched[handle] = uint32_t(mips.size());
+			return handle;
+		}
+
+		void Unregister(uint32_t handle)
+		{
+			m_residency.Unregister(handle);
+			m_mips[handle].clear();
+		}
+
+		void Touch(uint32_t handle, uint32_t finestMip)
+		{
+			m_residency.Touch(handle, finestMip);
+			if (finestMip < m_touched[handle])
+				m_touched[handle] = finestMip;
+		}
+
+		void SetBudget(uint64_t budget) { m_residency.SetBudget(budget); }
+
+		// Ends the frame and checks every invariant; returns the handles that changed.
+		std::vector<uint32_t> EndFrame(const char* frame)
+		{
+			uint64_t before = 0;
+			for (uint32_t handle = 0; handle < m_mips.size(); ++handle)
+			{
+				before += m_mips[handle].empty() ? 0 : m_applied[handle];
+			}
+
+			std::vector<DX::ResidencyChange> changes;
+			m_residency.EndFrame(changes);
+			std::vector<uint32_t> changed;
+			for (const DX::ResidencyChange& change : changes)
+			{
+				if (change.handle >= m_mips.size() || m_mips[change.handle].empty() || change.residentMip != m_residency.GetResidentMip(change.handle))
+					Fail(frame, "reports a change that isn't the texture's residency");
+				else
+					m_applied[change.handle] = change.residentMip;
+				changed.push_back(change.handle);
+			}
+
+			const DX::ResidencyStats& stats = m_residency.GetStats();
+			uint64_t residentBytes = 0, totalBytes = 0, after = 0;
+			uint32_t residentMips = 0, totalMips = 0, textures = 0;
+			bool onlyCoarsest = true, untouchedCoarsest = true, touchedShort = false;
+			for (uint32_t handle = 0; handle < m_mips.size(); ++handle)
+			{
+				const std::vector<uint64_t>& mips = m_mips[handle];
+				if (mips.empty())
+					continue;
+				uint32_t resident = m_residency.GetResidentMip(handle);
+				if (resident != m_applied[handle] || resident >= mips.size())
+					Fail(frame, "a texture's residency changed without being reported");
+				++textures;
+				after += resident;
+				for (uint32_t mip = 0; mip < mips.size(); ++mip)
+				{
+					totalBytes += mips[mip];
+					++totalMips;
+					if (mip >= resident)
+					{
+						residentBytes += mips[mip];
+						++residentMips;
+					}
+				}
+				bool coarsest = resident + 1 == mips.size();
+				onlyCoarsest &= coarsest;
+				if (m_touched[handle] == mips.size())
+					untouchedCoarsest &= coarsest;
+				else
+					touchedShort |= resident > m_touched[handle];
+				m_touched[handle] = uint32_t(mips.size());
+			}
+
+			if (stats.residentBytes != residentBytes || stats.totalBytes != totalBytes || stats.residentMips != residentMips ||
+				stats.totalMips != totalMips || stats.textureCount != textures)
+				Fail(frame, "stats don't match the mips kept");
+			if (after - before != uint64_t(stats.evictionsThisFrame) - stats.restoresThisFrame)
+				Fail(frame, "eviction and restore counts don't match the mips moved");
+			if (residentBytes > stats.budgetBytes && !onlyCoarsest)
+				Fail(frame, "over budget with fine mips left to evict");
+			if (touchedShort && !untouchedCoarsest)
+				Fail(frame, "a sampled texture is short of mips while unsampled ones keep fine mips");
+			return changed;
+		}
+
+		const DX::TextureResidency& Residency(void) const { return m_residency; }
+		DX::TextureResidency& Residency(void) { return m_residency; }
+		bool Passed(void) const { return m_passed; }
+
+		void Fail(const char* frame, const char* what)
+		{
+			printf("%s: %s\n", frame, what);
+			m_passed = false;
+		}
+
+		void Expect(const char* frame, const std::vector<uint32_t>& changed, const std::vector<uint32_t>& expectedChanged,
+					const uint32_t* expectedMips)
+		{
+			if (changed != expectedChanged)
+				Fail(frame, "changed other textures than expected");
+			for (uint32_t handle = 0; handle < m_mips.size(); ++handle)
+			{
+				if (!m_mips[handle].empty() && m_residency.GetResidentMip(handle) != expectedMips[handle])
+				{
+					printf("%s: texture %u keeps mip %u and coarser, expected %u\n", frame, handle, m_residency.GetResidentMip(handle),
+						   expectedMips[handle]);
+					m_passed = false;
+				}
+			}
+		}
+
+	private:
+		DX::TextureResidency m_residency;
+		std::vector<std::vector<uint64_t>> m_mips;	// Empty for unregistered handles.
+		std::vector<uint32_t> m_applied;
+		std::vector<uint32_t> m_touched;			// Finest mip sampled this frame, or the mip count.
+		bool m_passed;
+	};
+
+	bool Scripted(void)
+	{
+		const std::vector<uint64_t> mips = MipChain(256, 256, 1);
+		const uint32_t coarsest = uint32_t(mips.size()) - 1;
+		uint64_t full = 0;
+		for (uint64_t bytes : mips)
+		{
+			full += bytes;
+		}
+
+		Trace trace(8 * full);
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			trace.Register(mips);
+		}
+
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			trace.Touch(i, 0);
+		}
+		const uint32_t allResident[8] = {};
+		trace.Expect("everything fits", trace.EndFrame("everything fits"), {}, allResident);
+
+		for (uint32_t i = 4; i < 8; ++i)
+		{
+			trace.Touch(i, 0);
+		}
+		trace.EndFrame("4 to 7 sampled");
+
+		// Room for five textures, plus the coarsest mip the other three always keep.
+		trace.SetBudget(5 * full + 3 * mips[coarsest]);
+		for (uint32_t i = 0; i < 5; ++i)
+		{
+			trace.Touch(i, 0);
+		}
+		const uint32_t shrunk[8] = { 0, 0, 0, 0, 0, coarsest, coarsest, coarsest };
+		trace.Expect("budget shrinks", trace.EndFrame("budget shrinks"), { 5, 6, 7 }, shrunk);
+
+		// 5 comes back: 0 to 4 were sampled a frame ago, so the first and then the larger mips go.
+		trace.Touch(5, 0);
+		const uint32_t restored[8] = { 1, 1, 0, 0, 0, 0, coarsest, coarsest };
+		trace.Expect("5 sampled again", trace.EndFrame("5 sampled again"), { 0, 1, 5 }, restored);
+
+		trace.SetBudget(mips[coarsest]);
+		const uint32_t starved[8] = { coarsest, coarsest, coarsest, coarsest, coarsest, coarsest, coarsest, coarsest };
+		trace.Expect("budget below the coarsest mips", trace.EndFrame("budget below the coarsest mips"), { 0, 1, 2, 3, 4, 5 }, starved);
+
+		trace.SetBudget(8 * full);
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			trace.Touch(i, 2);
+		}
+		const uint32_t partial[8] = { 2, 2, 2, 2, 2, 2, 2, 2 };
+		trace.Expect("mip 2 requested", trace.EndFrame("mip 2 requested"), { 0, 1, 2, 3, 4, 5, 6, 7 }, partial);
+		trace.Touch(3, 0);
+		const uint32_t one[8] = { 2, 2, 2, 0, 2, 2, 2, 2 };
+		trace.Expect("mip 0 of 3 requested", trace.EndFrame("mip 0 of 3 requested"), { 3 }, one);
+
+		trace.Unregister(6);
+		uint32_t handle = trace.Register(MipChain(64, 64, 6));
+		if (handle != 6 || trace.Residency().GetResidentMip(handle) != 0 || trace.Residency().GetStats().textureCount != 8)
+			trace.Fail("handle reuse", "a new texture didn't take the free handle fully resident");
+		trace.EndFrame("handle reuse");
+		trace.Residency().Clear();
+		if (trace.Residency().GetStats().textureCount != 0 || trace.Residency().GetStats().residentBytes != 0)
+			trace.Fail("clear", "stats left after Clear");
+
+		printf("scripted trace: %s\n", trace.Passed() ? "as expected" : "FAILED");
+		return trace.Passed();
+	}
+
+	bool RandomTrace(uint32_t textureCount, uint32_t frames)
+	{
+		uint32_t state = 7;
+		Trace trace(0);
+		std::vector<uint32_t> mipCounts;
+		uint64_t total = 0;
+		for (uint32_t i = 0; i < textureCount; ++i)
+		{
+			uint32_t size = 16u << Random(state) % 8;
+			std::vector<uint64_t> mips = MipChain(size, size, Random(state) % 8 == 0 ? 6 : 1);
+			for (uint64_t bytes : mips)
+			{
+				total += bytes;
+			}
+			mipCounts.push_back(uint32_t(mips.size()));
+			trace.Register(mips);
+		}
+		// Registering counts as sampling, so the budget only applies from the next frame.
+		trace.SetBudget(total);
+		trace.EndFrame("random trace registered");
+		trace.SetBudget(total * 2 / 5);
+
+		// A window over a quarter of the textures that drifts one texture every few frames, plus a
+		// few samples anywhere; sampled near the camera at mip 0, further away at coarser mips.
+		double endFrameMs = 0.0;
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			uint32_t first = frame / 4;
+			for (uint32_t i = 0; i < textureCount / 4; ++i)
+			{
+				uint32_t handle = (first + i) % textureCount;
+				trace.Touch(handle, Random(state) % 4 == 0 ? Random(state) % mipCounts[handle] : 0);
+			}
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				uint32_t handle = Random(state) % textureCount;
+				trace.Touch(handle, Random(state) % mipCounts[handle]);
+			}
+			auto start = std::chrono::steady_clock::now();
+			char name[32];
+			snprintf(name, sizeof(name), "random frame %u", frame);
+			trace.EndFrame(name);
+			endFrameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (!trace.Passed())
+				break;
+		}
+
+		const DX::ResidencyStats& stats = trace.Residency().GetStats();
+		printf("random trace: %u textures, %u frames, %.1f of %.1f MB resident under a %.1f MB budget, %llu evictions, %llu restores; "
+			   "EndFrame %.3f ms%s\n", textureCount, frames, stats.residentBytes / 1048576.0, stats.totalBytes / 1048576.0,
+			   stats.budgetBytes / 1048576.0, (unsigned long long)stats.evictions, (unsigned long long)stats.restores,
+			   endFrameMs / frames, trace.Passed() ? "" : "; FAILED");
+		return trace.Passed() && stats.evictions > 0 && stats.restores > 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t textures = argc > 1 ? uint32_t(atoi(argv[1])) : 256;
+	uint32_t frames = argc > 2 ? uint32_t(atoi(argv[2])) : 2000;
+	if (argc > 3 || textures < 4 || frames == 0)
+	{
+		fprintf(stderr, "usage: %s [textures] [frames]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = Scripted();
+	passed &= RandomTrace(textures, frames);
+	return passed ? 0 : 1;
+}
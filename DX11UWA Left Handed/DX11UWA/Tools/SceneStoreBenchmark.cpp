@@ -0,0 +1,442 @@
+// Checks and times SceneStore, the entity store whose UpdateTransforms derives world matrices and boxes.
+//
+//   SceneStoreBenchmark [entities] [iterations]
+//
+// Builds a random forest of 5000 entities and checks every world matrix, world box and parent
+// against a recursive double precision reference after each of: the first update, edits to
+// local transforms, reparenting (SetParent must refuse exactly the moves that make a cycle),
+// destroying subtrees, creating entities in the freed indices, and moving one entity, after which
+// WasChanged must be set for its subtree alone. Stale handles must stay dead. Then builds
+// forests of four-level trees with four children per node, up to entities (default 1000000),
+// and times the first update, which sorts the slots, an update with every root rotated and one
+// with 1% of the roots moved, over iterations (default 10) frames; a sample of the entities is
+// checked against the reference too. Build with and without AVX2 to time both SIMD paths. Exits
+// with 1 on any mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common SceneStoreBenchmark.cpp ..\DX11UWA\Common\FrustumCulling.cpp ..\DX11UWA\Common\SceneStore.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common SceneStoreBenchmark.cpp ../DX11UWA/Common/{FrustumCulling,SceneStore,WorkerPool}.cpp
+
+#include "FrustumCulling.h"
+#include "SceneStore.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+	typedef DX::SceneStore::Entity Entity;
+
+	// Largest relative difference allowed between the store and the double precision reference.
+	const double MaxError = 1e-5;
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	float RandomFloat(uint32_t& state, float low, float high)
+	{
+		return low + (high - low) * float(Random(state) & 0xffff) / 65535.0f;
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* SimdPath(void)
+	{
+#if DX_SIMD_AVX2
+		return "AVX2";
+#elif DX_SIMD_SSE2
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	// What the store was told about one entity.
+	struct Reference
+	{
+		int parent;
+		bool alive;
+		float position[3];
+		float rotation[4];
+		float scale[3];
+		float center[3];
+		float extents[3];
+	};
+
+	void Randomize(uint32_t& state, Reference& reference)
+	{
+		double length = 0.0;
+		for (int i = 0; i < 4; ++i)
+		{
+			reference.rotation[i] = RandomFloat(state, -1.0f, 1.0f);
+			length += reference.rotation[i] * reference.rotation[i];
+		}
+		length = std::max(sqrt(length), 1e-3);
+		for (int i = 0; i < 4; ++i)
+		{
+			reference.rotation[i] = float(reference.rotation[i] / length);
+		}
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			reference.position[axis] = RandomFloat(state, -5.0f, 5.0f);
+			reference.scale[axis] = RandomFloat(state, 0.5f, 1.0f);
+			reference.center[axis] = RandomFloat(state, -1.0f, 1.0f);
+			reference.extents[axis] = RandomFloat(state, 0.0f, 1.0f);
+		}
+	}
+
+	void Apply(DX::SceneStore& store, Entity entity, const Reference& reference)
+	{
+		store.SetPosition(entity, reference.position[0], reference.position[1], reference.position[2]);
+		store.SetRotation(entity, reference.rotation[0], reference.rotation[1], reference.rotation[2], reference.rotation[3]);
+		store.SetScale(entity, reference.scale[0], reference.scale[1], reference.scale[2]);
+		DX::MeshBounds bounds = {};
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			bounds.center[axis] = reference.center[axis];
+			bounds.extents[axis] = reference.extents[axis];
+		}
+		store.SetLocalBounds(entity, bounds);
+	}
+
+	// World matrix rows 0-2 and the translation row, scale * rotation * translation * parent.
+	void ReferenceWorld(const std::vector<Reference>& references, int index, double world[12])
+	{
+		const Reference& r = references[index];
+		double x = r.rotation[0], y = r.rotation[1], z = r.rotation[2], w = r.rotation[3];
+		const double rotation[9] =
+		{
+			1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+			2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+			2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+		};
+		double local[12];
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				local[row * 3 + column] = rotation[row * 3 + column] * r.scale[row];
+			}
+			local[9 + row] = r.position[row];
+		}
+		if (r.parent < 0)
+		{
+			std::copy(local, local + 12, world);
+			return;
+		}
+		double parent[12];
+		ReferenceWorld(references, r.parent, parent);
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				world[row * 3 + column] = local[row * 3] * parent[column] + local[row * 3 + 1] * parent[3 + column] +
+										  local[row * 3 + 2] * parent[6 + column] + (row == 3 ? parent[9 + column] : 0.0);
+			}
+		}
+	}
+
+	double Relative(double expected, double actual)
+	{
+		return fabs(expected - actual) / (1.0 + fabs(expected));
+	}
+
+	// Largest relative error of the world matrix and box of one entity.
+	double EntityError(const DX::SceneStore& store, const std::vector<Reference>& references, int index, Entity entity)
+	{
+		double world[12];
+		ReferenceWorld(references, index, world);
+		float matrix[16];
+		store.GetWorldMatrix(entity, matrix);
+		double worst = 0.0;
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				worst = std::max(worst, Relative(world[row * 3 + column], matrix[row * 4 + column]));
+			}
+			worst = std::max(worst, Relative(row == 3 ? 1.0 : 0.0, matrix[row * 4 + 3]));
+		}
+		const Reference& r = references[index];
+		DX::MeshBounds bounds = store.GetWorldBounds(entity);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			double center = r.center[0] * world[axis] + r.center[1] * world[3 + axis] + r.center[2] * world[6 + axis] + world[9 + axis];
+			double extent = r.extents[0] * fabs(world[axis]) + r.extents[1] * fabs(world[3 + axis]) + r.extents[2] * fabs(world[6 + axis]);
+			worst = std::max(worst, std::max(Relative(center, bounds.center[axis]), Relative(extent, bounds.extents[axis])));
+		}
+		return worst;
+	}
+
+	bool IsUnder(const std::vector<Reference>& references, int index, int ancestor)
+	{
+		for (int i = index; i >= 0; i = references[i].parent)
+		{
+			if (i == ancestor)
+				return true;
+		}
+		return false;
+	}
+
+	// Compares every entity with the reference and prints one line.
+	bool Check(const char* step, const DX::SceneStore& store, const std::vector<Reference>& references, const std::vector<Entity>& entities)
+	{
+		double worst = 0.0;
+		size_t wrongAlive = 0, wrongParent = 0, live = 0;
+		for (size_t i = 0; i < references.size(); ++i)
+		{
+			if (store.IsAlive(entities[i]) != references[i].alive)
+			{
+				++wrongAlive;
+				continue;
+			}
+			if (!references[i].alive)
+				continue;
+			++live;
+			int parent = references[i].parent;
+			wrongParent += store.GetParent(entities[i]) == (parent < 0 ? DX::SceneStore::NullEntity : entities[parent]) ? 0 : 1;
+			worst = std::max(worst, EntityError(store, references, int(i), entities[i]));
+		}
+		bool passed = !wrongAlive && !wrongParent && worst <= MaxError && store.GetSlotCount() == live;
+		printf("  %-22s %zu live in %zu slots, %zu levels, max error %.2g, %zu wrong alive, %zu wrong parents%s\n", step, live,
+			   store.GetSlotCount(), store.GetLevelCount(), worst, wrongAlive, wrongParent, passed ? "" : "; FAILED");
+		return passed;
+	}
+
+	bool CheckForest(void)
+	{
+		const int Count = 5000;
+		uint32_t state = 7;
+		DX::SceneStore store;
+		std::vector<Reference> references;
+		std::vector<Entity> entities;
+		bool passed = true;
+		printf("random forest of %d entities:\n", Count);
+
+		for (int i = 0; i < Count; ++i)
+		{
+			Reference reference;
+			Randomize(state, reference);
+			reference.alive = true;
+			reference.parent = i < 50 || Random(state) % 8 == 0 ? -1 : int(Random(state) % i);
+			references.push_back(reference);
+			entities.push_back(store.Create(reference.parent < 0 ? DX::SceneStore::NullEntity : entities[reference.parent]));
+			Apply(store, entities.back(), reference);
+		}
+		store.UpdateTransforms();
+		passed = Check("first update", store, references, entities) && passed;
+
+		for (int edit = 0; edit < 200; ++edit)
+		{
+			int i = int(Random(state) % Count);
+			Randomize(state, references[i]);
+			Apply(store, entities[i], references[i]);
+		}
+		store.UpdateTransforms();
+		passed = Check("local edits", store, references, entities) && passed;
+
+		size_t moved = 0, refused = 0, wrongRefusals = 0;
+		for (int move = 0; move < 400; ++move)
+		{
+			int i = int(Random(state) % Count), parent = int(Random(state) % Count);
+			// Every fourth move tries the entity itself or one of its descendants.
+			if (move % 4 == 0)
+				parent = i;
+			for (int depth = move % 4 == 0 ? int(Random(state) % 3) : 0; depth > 0; --depth)
+			{
+				int child = 0;
+				while (child < Count && references[child].parent != parent)
+				{
+					++child;
+				}
+				parent = child < Count ? child : parent;
+			}
+			bool cycle = IsUnder(references, parent, i);
+			bool accepted = store.SetParent(entities[i], entities[parent]);
+			wrongRefusals += accepted == cycle ? 1 : 0;
+			if (accepted && !cycle)
+				references[i].parent = parent;
+			moved += accepted ? 1 : 0;
+			refused += accepted ? 0 : 1;
+		}
+		printf("  SetParent moved %zu and refused %zu, %zu wrongly%s\n", moved, refused, wrongRefusals, wrongRefusals ? "; FAILED" : "");
+		// A cycle the store accepted would never finish updating.
+		if (wrongRefusals)
+			return false;
+		store.UpdateTransforms();
+		passed = Check("reparenting", store, references, entities) && passed;
+
+		for (int destroy = 0; destroy < 20; ++destroy)
+		{
+			int i = int(Random(state) % Count);
+			if (!references[i].alive)
+				continue;
+			store.Destroy(entities[i]);
+			references[i].alive = false;
+		}
+		for (int i = 0; i < Count; ++i)
+		{
+			for (int ancestor = references[i].parent; ancestor >= 0 && references[i].alive; ancestor = references[ancestor].parent)
+			{
+				references[i].alive = references[ancestor].alive;
+			}
+		}
+		store.UpdateTransforms();
+		passed = Check("destroyed subtrees", store, references, entities) && passed;
+
+		// New roots take the freed indices; the old handles must stay dead.
+		for (int i = 0; i < 100; ++i)
+		{
+			Reference reference;
+			Randomize(state, reference);
+			reference.alive = true;
+			reference.parent = -1;
+			references.push_back(reference);
+			entities.push_back(store.Create());
+			Apply(store, entities.back(), reference);
+		}
+		store.UpdateTransforms();
+		passed = Check("reused indices", store, references, entities) && passed;
+
+		// Only the moved entity's subtree reports a change.
+		store.UpdateTransforms();
+		int mover = 0;
+		while (!references[mover].alive || references[mover].parent >= 0)
+		{
+			++mover;
+		}
+		references[mover].position[0] += 1.0f;
+		Apply(store, entities[mover], references[mover]);
+		store.UpdateTransforms();
+		size_t changed = 0, wrongChanged = 0;
+		for (size_t i = 0; i < references.size(); ++i)
+		{
+			if (!references[i].alive)
+				continue;
+			bool under = IsUnder(references, int(i), mover);
+			changed += under ? 1 : 0;
+			wrongChanged += store.WasChanged(entities[i]) == under ? 0 : 1;
+		}
+		printf("  moved one root: %zu entities below it, %zu wrong changed flags%s\n", changed, wrongChanged, wrongChanged ? "; FAILED" : "");
+		passed = Check("after the move", store, references, entities) && passed && !wrongChanged;
+		return passed;
+	}
+
+	// Four-level trees with four children per node until count entities exist.
+	bool Benchmark(size_t count, int iterations)
+	{
+		DX::SceneStore store;
+		store.Reserve(count);
+		std::vector<Reference> references;
+		std::vector<Entity> entities, roots;
+		references.reserve(count);
+		entities.reserve(count);
+		Reference node = { -1, true, { 1.0f, 2.0f, 3.0f }, { 0.0f, 0.38268343f, 0.0f, 0.92387953f }, { 1.0f, 1.0f, 1.0f },
+						   { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+		auto add = [&](int parent)
+		{
+			node.parent = parent;
+			references.push_back(node);
+			entities.push_back(store.Create(parent < 0 ? DX::SceneStore::NullEntity : entities[parent]));
+			Apply(store, entities.back(), node);
+			return int(entities.size() - 1);
+		};
+		while (entities.size() < count)
+		{
+			int root = add(-1);
+			roots.push_back(entities[root]);
+			for (int a = 0; a < 4 && entities.size() < count; ++a)
+			{
+				int child = add(root);
+				for (int b = 0; b < 4 && entities.size() < count; ++b)
+				{
+					int grandchild = add(child);
+					for (int c = 0; c < 4 && entities.size() < count; ++c)
+					{
+						add(grandchild);
+					}
+				}
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		store.UpdateTransforms();
+		double firstMs = Milliseconds(start);
+
+		double allMs = 0.0, someMs = 0.0;
+		for (int frame = 0; frame < iterations; ++frame)
+		{
+			float angle = 0.01f * frame;
+			for (size_t root = 0; root < roots.size(); ++root)
+			{
+				store.SetRotation(roots[root], 0.0f, sinf(angle), 0.0f, cosf(angle));
+			}
+			start = std::chrono::steady_clock::now();
+			store.UpdateTransforms();
+			allMs += Milliseconds(start);
+		}
+		// The roots are the first of every run of 85 entities.
+		for (size_t i = 0; i < references.size(); i += 85)
+		{
+			float angle = 0.01f * (iterations - 1);
+			references[i].rotation[1] = sinf(angle);
+			references[i].rotation[3] = cosf(angle);
+		}
+		for (int frame = 0; frame < iterations; ++frame)
+		{
+			for (size_t root = 0; root < roots.size(); root += 100)
+			{
+				store.SetPosition(roots[root], float(frame), 0.0f, 0.0f);
+				references[root * 85].position[0] = float(frame);
+				references[root * 85].position[1] = 0.0f;
+				references[root * 85].position[2] = 0.0f;
+			}
+			start = std::chrono::steady_clock::now();
+			store.UpdateTransforms();
+			someMs += Milliseconds(start);
+		}
+
+		double worst = 0.0;
+		for (size_t i = 0; i < references.size(); i += 97)
+		{
+			worst = std::max(worst, EntityError(store, references, int(i), entities[i]));
+		}
+		bool passed = worst <= MaxError;
+		printf("  %8zu %9.3f ms %9.3f ms (%5.2f ns each) %9.3f ms   %.2g%s\n", count, firstMs, allMs / iterations,
+			   allMs / iterations * 1e6 / count, someMs / iterations, worst, passed ? "" : "; FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 1000000;
+	int iterations = argc > 2 ? atoi(argv[2]) : 10;
+	if (count < 1000 || count > DX::SceneStore::MaxEntities || iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [entities, 1000 to 16M] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckForest();
+	printf("%s build, %u threads, %d iterations:\n", SimdPath(), DX::WorkerPool::Shared().GetConcurrency(), iterations);
+	printf("  entities  first update  every root moved             1%% of roots   max error\n");
+	for (size_t size = 1000; size < count; size *= 10)
+	{
+		passed = Benchmark(size, iterations) && passed;
+	}
+	passed = Benchmark(count, iterations) && passed;
+	return passed ? 0 : 1;
+}
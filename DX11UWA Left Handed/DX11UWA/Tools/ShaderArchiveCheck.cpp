@@ -0,0 +1,300 @@
+// Checks ShaderArchive, the single mapped file the renderer's shaders load from.
+//
+//   ShaderArchiveCheck <scratch dir> [shaders]
+//
+// Packs random bytecode under the renderer's shader names, plus filler shaders up to shaders
+// (default 64), writes the archive to the scratch directory and maps it back. Every name must
+// find its bytecode byte for byte at a 16-byte boundary, and names not in the archive must find
+// nothing, both from the mapped file and from memory. Archives with a duplicate or empty name must
+// not be written. Then flips each byte of the table of contents and cuts the archive at every
+// length short of whole: each must be rejected, or, where the flip only moves a lookup, every span
+// it hands out must stay inside the archive. Last, times opening the archive and finding every
+// shader against reading each shader from its own .cso in the scratch directory. Exits with 1 on
+// any failure. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common ShaderArchiveCheck.cpp ..\DX11UWA\Common\LightPermutation.cpp ..\DX11UWA\Common\ShaderArchive.cpp
+//   g++ -O2 -I../DX11UWA/Common ShaderArchiveCheck.cpp ../DX11UWA/Common/{LightPermutation,ShaderArchive}.cpp
+
+#include "LightPermutation.h"
+#include "ShaderArchive.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* const RendererShaders[] =
+	{
+		"SampleVertexShader", "LitVertexShader", "InstancedVertexShader", "DomainShader", "HullShader",
+		"SamplePixelShader", "PyramidPixelShader", "SkyboxVertexShader", "SkyboxPixelShader",
+	};
+
+	const char* const MissingNames[] =
+	{
+		"", "Light", "LightPixelShaderX", "samplevertexshader", "SampleVertexShader.cso", "Shader999",
+	};
+
+	const uint32_t Repeats = 20;
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		bool written = data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && written;
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		uint8_t buffer[4096];
+		size_t read;
+		data.clear();
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			data.insert(data.end(), buffer, buffer + read);
+		}
+		fclose(file);
+		return true;
+	}
+
+	bool CheckContents(const char* source, const DX::ShaderArchive& archive, const std::vector<DX::ShaderArchiveEntry>& entries)
+	{
+		if (archive.GetCount() != entries.size())
+		{
+			printf("%s: %u shaders, expected %zu\n", source, archive.GetCount(), entries.size());
+			return false;
+		}
+		for (uint32_t i = 0; i < entries.size(); ++i)
+		{
+			const DX::ShaderArchiveEntry& entry = entries[i];
+			DX::ShaderBytecode found = archive.Find(entry.name.c_str());
+			DX::ShaderBytecode indexed = archive.Get(i);
+			if (!found.data || found.data != indexed.data || found.size != entry.bytecode.size() ||
+				strcmp(archive.GetName(i), entry.name.c_str()) != 0 || reinterpret_cast<uintptr_t>(found.data) % 16 != 0 ||
+				(!entry.bytecode.empty() && memcmp(found.data, entry.bytecode.data(), entry.bytecode.size()) != 0))
+			{
+				printf("%s: %s doesn't find its bytecode\n", source, entry.name.c_str());
+				return false;
+			}
+		}
+		for (const char* name : MissingNames)
+		{
+			if (archive.Find(name).data)
+			{
+				printf("%s: finds \"%s\", which it doesn't have\n", source, name);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Whether every span a corrupted archive that still opened hands out lies inside it.
+	bool SpansInside(const DX::ShaderArchive& archive, const std::vector<DX::ShaderArchiveEntry>& entries, const uint8_t* begin, size_t size)
+	{
+		const uint8_t* end = begin + size;
+		for (uint32_t i = 0; i < archive.GetCount(); ++i)
+		{
+			const uint8_t* data = static_cast<const uint8_t*>(archive.Get(i).data);
+			const char* name = archive.GetName(i);
+			if (data < begin || data + archive.Get(i).size > end ||
+				reinterpret_cast<const uint8_t*>(name) < begin || reinterpret_cast<const uint8_t*>(name) + strlen(name) >= end)
+				return false;
+		}
+		for (const DX::ShaderArchiveEntry& entry : entries)
+		{
+			DX::ShaderBytecode found = archive.Find(entry.name.c_str());
+			const uint8_t* data = static_cast<const uint8_t*>(found.data);
+			if (data && (data < begin || data + found.size > end))
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "usage: %s <scratch dir> [shaders]\n", argv[0]);
+		return 1;
+	}
+	const std::string scratch = argv[1];
+	const uint32_t shaderCount = argc > 2 ? uint32_t(atoi(argv[2])) : 64;
+
+	std::vector<DX::ShaderArchiveEntry> entries;
+	for (const char* name : RendererShaders)
+	{
+		entries.push_back(DX::ShaderArchiveEntry{ name, {} });
+	}
+	for (const DX::LightVariant& variant : DX::LightVariants)
+	{
+		entries.push_back(DX::ShaderArchiveEntry{ variant.name, {} });
+	}
+	while (entries.size() < shaderCount)
+	{
+		entries.push_back(DX::ShaderArchiveEntry{ "Shader" + std::to_string(entries.size()), {} });
+	}
+	uint32_t state = 1;
+	size_t bytecodeSize = 0;
+	for (DX::ShaderArchiveEntry& entry : entries)
+	{
+		// One empty shader; the rest the size of the renderer's, about 1 to 16 KB.
+		entry.bytecode.resize(&entry == &entries.back() ? 0 : 1024 + Random(state) % (15 * 1024));
+		for (uint8_t& byte : entry.bytecode)
+		{
+			byte = uint8_t(Random(state));
+		}
+		bytecodeSize += entry.bytecode.size();
+	}
+
+	bool passed = true;
+	std::vector<uint8_t> archive;
+	if (!DX::WriteShaderArchive(entries, archive))
+	{
+		printf("can't pack %zu shaders\n", entries.size());
+		return 1;
+	}
+	printf("%zu shaders, %zu bytes of bytecode, %zu byte archive\n", entries.size(), bytecodeSize, archive.size());
+
+	std::vector<DX::ShaderArchiveEntry> duplicate(entries.begin(), entries.begin() + 3);
+	duplicate.push_back(duplicate[1]);
+	std::vector<DX::ShaderArchiveEntry> unnamed(1);
+	std::vector<uint8_t> refused;
+	if (DX::WriteShaderArchive(duplicate, refused) || DX::WriteShaderArchive(unnamed, refused))
+	{
+		printf("packed a duplicate or empty name\n");
+		passed = false;
+	}
+
+	const std::string archivePath = scratch + "/Shaders.dxsa";
+	if (!WriteFile(archivePath, archive))
+	{
+		printf("%s: can't write\n", archivePath.c_str());
+		return 1;
+	}
+	DX::ShaderArchive mapped;
+	if (!mapped.Open(archivePath.c_str()))
+	{
+		printf("%s: doesn't open\n", archivePath.c_str());
+		return 1;
+	}
+	passed &= CheckContents("mapped", mapped, entries);
+	mapped.Close();
+	if (mapped.IsOpen() || mapped.Find(entries[0].name.c_str()).data || mapped.Open((scratch + "/Missing.dxsa").c_str()))
+	{
+		printf("closed or missing archive still finds shaders\n");
+		passed = false;
+	}
+
+	DX::ShaderArchive memory;
+	if (!memory.OpenMemory(archive.data(), archive.size()))
+	{
+		printf("archive in memory doesn't open\n");
+		return 1;
+	}
+	passed &= CheckContents("memory", memory, entries);
+
+	// Flip each byte of the table of contents, everything before the first shader's bytecode.
+	const size_t tableSize = static_cast<const uint8_t*>(memory.Get(0).data) - archive.data();
+	memory.Close();
+	std::vector<uint8_t> corrupt = archive;
+	uint32_t flipsRejected = 0;
+	uint32_t flipsOpened = 0;
+	for (size_t i = 0; i < tableSize; ++i)
+	{
+		corrupt[i] ^= 0xff;
+		if (memory.OpenMemory(corrupt.data(), corrupt.size()))
+		{
+			++flipsOpened;
+			if (!SpansInside(memory, entries, corrupt.data(), corrupt.size()))
+			{
+				printf("flipping byte %zu hands out a span outside the archive\n", i);
+				passed = false;
+			}
+		}
+		else
+		{
+			++flipsRejected;
+		}
+		corrupt[i] ^= 0xff;
+	}
+	printf("table of contents: %zu bytes flipped, %u rejected, %u opened with every span inside\n", tableSize, flipsRejected, flipsOpened);
+
+	uint32_t cutsOpened = 0;
+	for (size_t size = 0; size < archive.size(); ++size)
+	{
+		cutsOpened += memory.OpenMemory(archive.data(), size) ? 1 : 0;
+	}
+	if (cutsOpened != 0 || memory.OpenMemory(archive.data() + 1, archive.size() - 1))
+	{
+		printf("%u cut archives opened\n", cutsOpened);
+		passed = false;
+	}
+	printf("%zu cut archives rejected\n", archive.size());
+
+	std::vector<std::string> shaderPaths;
+	for (const DX::ShaderArchiveEntry& entry : entries)
+	{
+		shaderPaths.push_back(scratch + "/" + entry.name + ".cso");
+		if (!WriteFile(shaderPaths.back(), entry.bytecode))
+		{
+			printf("%s: can't write\n", shaderPaths.back().c_str());
+			return 1;
+		}
+	}
+
+	// Both start warm in the file cache, as on a second launch.
+	typedef std::chrono::high_resolution_clock Clock;
+	size_t checksum = 0;
+	Clock::time_point start = Clock::now();
+	for (uint32_t repeat = 0; repeat < Repeats; ++repeat)
+	{
+		std::vector<uint8_t> data;
+		for (const std::string& path : shaderPaths)
+		{
+			passed &= ReadFile(path, data);
+			checksum += data.size();
+		}
+	}
+	double filesMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / Repeats;
+
+	start = Clock::now();
+	for (uint32_t repeat = 0; repeat < Repeats; ++repeat)
+	{
+		passed &= mapped.Open(archivePath.c_str());
+		for (const DX::ShaderArchiveEntry& entry : entries)
+		{
+			checksum += mapped.Find(entry.name.c_str()).size;
+		}
+		mapped.Close();
+	}
+	double archiveMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / Repeats;
+
+	for (const std::string& path : shaderPaths)
+	{
+		remove(path.c_str());
+	}
+	remove(archivePath.c_str());
+	if (checksum != 2 * Repeats * bytecodeSize)
+	{
+		printf("timed loads saw the wrong sizes\n");
+		passed = false;
+	}
+	printf("load every shader: %zu files %.3f ms, archive %.3f ms (%.1fx)\n", entries.size(), filesMs, archiveMs, filesMs / archiveMs);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Packs compiled shaders into the archive Sample3DSceneRenderer maps at start-up.
+//
+//   ShaderPacker <archive> <file.cso>...
+//
+// Each shader is stored under its file name without the directory and extension, the name the
+// renderer looks it up by, e.g. LightPixelShaderOpaque for ..\AppX\LightPixelShaderOpaque.cso.
+// ShaderPacker.vcxproj builds it for the host, and DX11UWA.sln builds that project before the
+// app. The app's PackShaders target then runs it over the .cso files fxc wrote and deploys the
+// result as Shaders.dxsa; shaders left out are still read from their own .cso. Prints each shader
+// and the archive's size, and exits with 1 if a file can't be read, two files have the same name
+// or the archive can't be written. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common ShaderPacker.cpp ..\DX11UWA\Common\ShaderArchive.cpp
+//   g++ -O2 -I../DX11UWA/Common ShaderPacker.cpp ../DX11UWA/Common/ShaderArchive.cpp
+
+#include "ShaderArchive.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	bool ReadFile(const char* path, std::vector<uint8_t>& data)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+		uint8_t buffer[4096];
+		size_t read;
+		data.clear();
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			data.insert(data.end(), buffer, buffer + read);
+		}
+		bool failed = ferror(file) != 0;
+		fclose(file);
+		return !failed;
+	}
+
+	std::string ShaderName(const std::string& path)
+	{
+		size_t start = path.find_last_of("/\\");
+		start = start == std::string::npos ? 0 : start + 1;
+		size_t end = path.find_last_of('.');
+		if (end == std::string::npos || end < start)
+			end = path.size();
+		return path.substr(start, end - start);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <archive> <file.cso>...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<DX::ShaderArchiveEntry> entries(argc - 2);
+	size_t bytecodeSize = 0;
+	for (int i = 2; i < argc; ++i)
+	{
+		DX::ShaderArchiveEntry& entry = entries[i - 2];
+		entry.name = ShaderName(argv[i]);
+		if (!ReadFile(argv[i], entry.bytecode))
+		{
+			fprintf(stderr, "%s: can't read\n", argv[i]);
+			return 1;
+		}
+		bytecodeSize += entry.bytecode.size();
+		printf("  %-36s%8zu bytes\n", entry.name.c_str(), entry.bytecode.size());
+	}
+
+	std::vector<uint8_t> archive;
+	if (!DX::WriteShaderArchive(entries, archive))
+	{
+		fprintf(stderr, "%s: shader names must be unique and not empty\n", argv[1]);
+		return 1;
+	}
+	FILE* file = fopen(argv[1], "wb");
+	bool written = file && fwrite(archive.data(), 1, archive.size(), file) == archive.size();
+	if (file && fclose(file) != 0)
+		written = false;
+	if (!written)
+	{
+		fprintf(stderr, "%s: can't write\n", argv[1]);
+		return 1;
+	}
+	printf("%zu shaders, %zu bytes of bytecode, %zu byte archive\n", entries.size(), bytecodeSize, archive.size());
+	return 0;
+}
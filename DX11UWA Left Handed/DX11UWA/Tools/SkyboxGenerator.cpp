@@ -0,0 +1,140 @@
+// Generates the daylight sky the app ships as its skybox source and writes it as six cube faces.
+//
+//   SkyboxGenerator <output prefix> [faceSize]
+//
+// Writes <prefix>PosX.dds, NegX, PosY, NegY, PosZ and NegZ as uncompressed R8G8B8A8 images of
+// faceSize x faceSize (default 256), each texel the sky in its direction as the Direct3D cube map
+// addressing table gives it. The sky fades from a pale horizon to a deep blue zenith, has a sun
+// with a soft glow in front of the start-up camera and a dark ground below the horizon. The
+// renderer builds its cube map from these files with BuildCubemapFromFaces when no prebuilt
+// OutputCube.dds is deployed; CubemapConverter takes them too. The checked-in Assets/Skybox*.dds
+// come from "SkyboxGenerator ../DX11UWA/Assets/Skybox". Only depends on the portable sources in
+// DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common SkyboxGenerator.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common SkyboxGenerator.cpp ../DX11UWA/Common/{DDSFile,DDSFormatConvert,WorkerPool}.cpp
+
+#include "DDSFile.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+namespace
+{
+	const char* const FaceNames[6] = { "PosX", "NegX", "PosY", "NegY", "PosZ", "NegZ" };
+
+	const float Horizon[3] = { 0.78f, 0.86f, 0.95f };
+	const float Zenith[3] = { 0.16f, 0.36f, 0.74f };
+	const float Ground[3] = { 0.09f, 0.085f, 0.08f };
+	const float SunColor[3] = { 1.0f, 0.93f, 0.78f };
+
+	// Low in the sky and ahead of the camera, which looks down +Z at start-up.
+	const float SunDirection[3] = { 0.35f, 0.30f, 0.89f };
+
+	float Lerp(float a, float b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	// Linear color of the sky in a direction of unit length.
+	void SkyColor(const float direction[3], float color[3])
+	{
+		float up = direction[1];
+		float sunLength = sqrtf(SunDirection[0] * SunDirection[0] + SunDirection[1] * SunDirection[1] + SunDirection[2] * SunDirection[2]);
+		float sun = (direction[0] * SunDirection[0] + direction[1] * SunDirection[1] + direction[2] * SunDirection[2]) / sunLength;
+		float glow = powf(std::max(sun, 0.0f), 48.0f) * 0.6f + powf(std::max(sun, 0.0f), 6.0f) * 0.15f;
+		float disk = sun > 0.9994f ? 1.0f : 0.0f;
+		for (int c = 0; c < 3; ++c)
+		{
+			float sky;
+			if (up >= 0.0f)
+			{
+				sky = Lerp(Horizon[c], Zenith[c], sqrtf(up));
+			}
+			else
+			{
+				// A thin haze band blends the horizon into the ground.
+				sky = Lerp(Horizon[c], Ground[c], std::min(-up * 8.0f, 1.0f));
+				glow *= std::max(1.0f + up * 8.0f, 0.0f);
+			}
+			color[c] = std::min(sky + glow * SunColor[c] + disk, 1.0f);
+		}
+	}
+
+	// The direction of texel coordinates s, t in [-1, 1] on a face, as the Direct3D cube map
+	// addressing table defines them: s runs along sc and t along tc.
+	void FaceDirection(uint32_t face, float s, float t, float direction[3])
+	{
+		switch (face)
+		{
+		case 0: direction[0] = 1.0f; direction[1] = -t; direction[2] = -s; break;
+		case 1: direction[0] = -1.0f; direction[1] = -t; direction[2] = s; break;
+		case 2: direction[0] = s; direction[1] = 1.0f; direction[2] = t; break;
+		case 3: direction[0] = s; direction[1] = -1.0f; direction[2] = -t; break;
+		case 4: direction[0] = s; direction[1] = -t; direction[2] = 1.0f; break;
+		default: direction[0] = -s; direction[1] = -t; direction[2] = -1.0f; break;
+		}
+		float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		for (int i = 0; i < 3; ++i)
+		{
+			direction[i] /= length;
+		}
+	}
+
+	// RGBA8 texel of a linear color, gamma encoded since the skybox samples a UNORM texture.
+	uint32_t PackColor(const float color[3])
+	{
+		uint32_t texel = 0xff000000u;
+		for (int c = 0; c < 3; ++c)
+		{
+			float encoded = powf(std::min(std::max(color[c], 0.0f), 1.0f), 1.0f / 2.2f);
+			texel |= uint32_t(encoded * 255.0f + 0.5f) << (c * 8);
+		}
+		return texel;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		fprintf(stderr, "usage: %s <output prefix> [faceSize]\n", argv[0]);
+		return 1;
+	}
+	uint32_t size = argc > 2 ? uint32_t(atoi(argv[2])) : 256;
+	if (size < 1 || size > 16384)
+	{
+		fprintf(stderr, "faceSize must be 1 to 16384\n");
+		return 1;
+	}
+
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		DX::DDSImage image;
+		image.Allocate(size, size, 1, 1);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				float direction[3];
+				float color[3];
+				FaceDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, direction);
+				SkyColor(direction, color);
+				image.texels[size_t(y) * size + x] = PackColor(color);
+			}
+		}
+
+		std::string path = std::string(argv[1]) + FaceNames[face] + ".dds";
+		if (!DX::WriteDDSFile(path.c_str(), image))
+		{
+			fprintf(stderr, "%s: could not write\n", path.c_str());
+			return 1;
+		}
+		printf("%s: %ux%u\n", path.c_str(), size, size);
+	}
+	return 0;
+}
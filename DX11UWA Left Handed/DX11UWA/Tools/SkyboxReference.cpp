@@ -0,0 +1,359 @@
+// Builds a skybox cube map on the CPU from a generated sky and writes its faces, for reference images.
+//
+//   SkyboxReference <output.ppm> [-source equirect|faces] [-size S] [-frames N] [-compare reference.ppm] [-tolerance T]
+//
+// Generates a sky whose color follows the view direction, either as an equirectangular panorama
+// of 8S x 4S texels or as six faces of 2S x 2S, and converts it with BuildCubemapFromEquirect or
+// BuildCubemapFromFaces into a cube map with faces of S x S (default 64, at least 8) and a full
+// mip chain. Every texel of mip 0 is then checked against the sky in its direction, as the cube
+// map addressing table of Direct3D gives it: a face that is flipped, turned or swapped shows up.
+// The image holds mip 0 as a cross, +Y above -X +Z +X -Z and -Y below, and the crosses of the
+// other mips side by side under it. frames builds the cube that many times and prints the time
+// per build. compare diffs the image against an earlier one and exits with 1 if any color channel
+// is off by more than tolerance (default 1) or the sizes differ, so the checked-in
+// Reference/Skybox_*_32.ppm images work as regression tests for every SIMD path. Only depends on
+// the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /arch:AVX2 /I..\DX11UWA\Common SkyboxReference.cpp ..\DX11UWA\Common\CubemapBuilder.cpp ..\DX11UWA\Common\DDSFile.cpp ..\DX11UWA\Common\DDSFormatConvert.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -mavx2 -pthread -I../DX11UWA/Common SkyboxReference.cpp ../DX11UWA/Common/{CubemapBuilder,DDSFile,DDSFormatConvert,WorkerPool}.cpp
+
+#include "CubemapBuilder.h"
+#include "SimdConfig.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+
+	// Largest difference of a color channel between a texel of mip 0 and the sky in its direction,
+	// for faces large enough that bilinear filtering follows the sky's ripple.
+	const uint32_t MaxSkyError = 4;
+	const uint32_t MinSize = 8;
+
+	// Where each face of mip 0 goes in the cross, in units of the face size.
+	const uint32_t CrossColumn[6] = { 2, 0, 1, 1, 1, 3 };
+	const uint32_t CrossRow[6] = { 1, 1, 0, 2, 1, 1 };
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const char* SimdPath(void)
+	{
+#if DX_SIMD_AVX2
+		return "AVX2";
+#elif DX_SIMD_SSE2
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	// RGBA8 color of the sky in a direction of unit length: a gradient along each axis, shaded
+	// by a ripple so that every face has detail in both directions.
+	void SkyColor(float x, float y, float z, float color[3])
+	{
+		float shade = 0.75f + 0.25f * cosf(5.0f * x) * cosf(5.0f * y) * cosf(5.0f * z);
+		color[0] = 255.0f * (0.5f + 0.5f * x) * shade;
+		color[1] = 255.0f * (0.5f + 0.5f * y) * shade;
+		color[2] = 255.0f * (0.5f + 0.5f * z) * shade;
+	}
+
+	uint32_t PackColor(const float color[3])
+	{
+		uint32_t texel = 0xff000000u;
+		for (int c = 0; c < 3; ++c)
+		{
+			texel |= uint32_t(std::min(std::max(color[c] + 0.5f, 0.0f), 255.0f)) << (c * 8);
+		}
+		return texel;
+	}
+
+	// The direction of texel coordinates s, t in [-1, 1] on a face, as the Direct3D cube map
+	// addressing table defines them: s runs along sc and t along tc.
+	void FaceDirection(uint32_t face, float s, float t, float direction[3])
+	{
+		switch (face)
+		{
+		case 0: direction[0] = 1.0f; direction[1] = -t; direction[2] = -s; break;
+		case 1: direction[0] = -1.0f; direction[1] = -t; direction[2] = s; break;
+		case 2: direction[0] = s; direction[1] = 1.0f; direction[2] = t; break;
+		case 3: direction[0] = s; direction[1] = -1.0f; direction[2] = -t; break;
+		case 4: direction[0] = s; direction[1] = -t; direction[2] = 1.0f; break;
+		default: direction[0] = -s; direction[1] = -t; direction[2] = -1.0f; break;
+		}
+		float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		for (int i = 0; i < 3; ++i)
+		{
+			direction[i] /= length;
+		}
+	}
+
+	// The sky as an equirectangular panorama: longitude atan2(x, z) from -pi at the left edge,
+	// latitude from +pi/2 at the top.
+	void MakePanorama(uint32_t width, uint32_t height, DX::DDSImage& panorama)
+	{
+		panorama.Allocate(width, height, 1, 1);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			float latitude = Pi * 0.5f - (y + 0.5f) * Pi / height;
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				float longitude = (x + 0.5f) * 2.0f * Pi / width - Pi;
+				float color[3];
+				SkyColor(cosf(latitude) * sinf(longitude), sinf(latitude), cosf(latitude) * cosf(longitude), color);
+				panorama.texels[size_t(y) * width + x] = PackColor(color);
+			}
+		}
+	}
+
+	void MakeFace(uint32_t face, uint32_t size, DX::DDSImage& image)
+	{
+		image.Allocate(size, size, 1, 1);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				float direction[3], color[3];
+				FaceDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, direction);
+				SkyColor(direction[0], direction[1], direction[2], color);
+				image.texels[size_t(y) * size + x] = PackColor(color);
+			}
+		}
+	}
+
+	// Copies one mip of every face into the image as a cross whose top left corner is at left, top.
+	void DrawCross(const DX::DDSImage& cube, uint32_t mip, uint32_t left, uint32_t top, std::vector<uint32_t>& image, uint32_t width)
+	{
+		uint32_t size = cube.LevelWidth(mip);
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			const uint32_t* texels = cube.Level(face, mip);
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				std::copy(texels + size_t(y) * size, texels + size_t(y + 1) * size,
+						  image.begin() + size_t(top + CrossRow[face] * size + y) * width + left + CrossColumn[face] * size);
+			}
+		}
+	}
+
+	bool WriteImage(const char* path, const std::vector<uint32_t>& pixels, uint32_t width, uint32_t height)
+	{
+		FILE* file = fopen(path, "wb");
+		if (!file)
+			return false;
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		std::vector<uint8_t> data(pixels.size() * 3);
+		for (size_t i = 0; i < pixels.size(); ++i)
+		{
+			data[i * 3] = uint8_t(pixels[i]);
+			data[i * 3 + 1] = uint8_t(pixels[i] >> 8);
+			data[i * 3 + 2] = uint8_t(pixels[i] >> 16);
+		}
+		bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && written;
+	}
+
+	// Reads a binary PPM as WriteImage writes it.
+	bool ReadImage(const char* path, std::vector<uint32_t>& pixels, uint32_t& width, uint32_t& height)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+		unsigned w = 0, h = 0, maxValue = 0;
+		bool read = fscanf(file, "P6 %u %u %u", &w, &h, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+		if (read)
+		{
+			std::vector<uint8_t> data(size_t(w) * h * 3);
+			read = fread(data.data(), 1, data.size(), file) == data.size();
+			pixels.resize(size_t(w) * h);
+			for (size_t i = 0; read && i < pixels.size(); ++i)
+			{
+				pixels[i] = uint32_t(data[i * 3]) | (uint32_t(data[i * 3 + 1]) << 8) | (uint32_t(data[i * 3 + 2]) << 16) | 0xff000000u;
+			}
+		}
+		fclose(file);
+		width = w;
+		height = h;
+		return read;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <output.ppm> [-source equirect|faces] [-size S] [-frames N] [-compare reference.ppm] [-tolerance T]\n", argv[0]);
+		return 1;
+	}
+	const char* output = argv[1];
+	uint32_t size = 64, frames = 1, tolerance = 1;
+	bool fromFaces = false;
+	const char* reference = nullptr;
+	for (int i = 2; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-source") && i + 1 < argc)
+		{
+			const char* source = argv[++i];
+			if (!strcmp(source, "faces"))
+				fromFaces = true;
+			else if (strcmp(source, "equirect"))
+			{
+				fprintf(stderr, "unknown source %s\n", source);
+				return 1;
+			}
+		}
+		else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+			size = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-compare") && i + 1 < argc)
+			reference = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = static_cast<uint32_t>(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (size < MinSize || frames == 0)
+	{
+		fprintf(stderr, "size must be at least %u and frames positive\n", MinSize);
+		return 1;
+	}
+
+	DX::DDSImage panorama;
+	DX::DDSImage faces[6];
+	if (fromFaces)
+	{
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			MakeFace(face, size * 2, faces[face]);
+		}
+	}
+	else
+	{
+		MakePanorama(size * 8, size * 4, panorama);
+	}
+
+	DX::CubemapSettings settings;
+	settings.faceSize = size;
+	DX::WorkerPool pool;
+	DX::DDSImage cube;
+	double totalMs = 0.0, bestMs = 1e30;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+		bool built;
+		if (fromFaces)
+		{
+			const DX::DDSImage* sources[6] = { &faces[0], &faces[1], &faces[2], &faces[3], &faces[4], &faces[5] };
+			built = DX::BuildCubemapFromFaces(sources, settings, cube, pool);
+		}
+		else
+		{
+			built = DX::BuildCubemapFromEquirect(panorama, settings, cube, pool);
+		}
+		if (!built)
+		{
+			fprintf(stderr, "conversion failed\n");
+			return 1;
+		}
+		double ms = Milliseconds(start);
+		totalMs += ms;
+		bestMs = std::min(bestMs, ms);
+	}
+	printf("%s source, %ux%u x6, %u mips, %s build, %u threads: %.3f ms per build (best %.3f)\n", fromFaces ? "faces" : "equirect",
+		   cube.width, cube.height, cube.mipLevels, SimdPath(), pool.GetConcurrency(), totalMs / frames, bestMs);
+
+	bool passed = true;
+	uint32_t skyError = 0;
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		const uint32_t* texels = cube.Level(face, 0);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				float direction[3], color[3];
+				FaceDirection(face, (x + 0.5f) * 2.0f / size - 1.0f, (y + 0.5f) * 2.0f / size - 1.0f, direction);
+				SkyColor(direction[0], direction[1], direction[2], color);
+				uint32_t expected = PackColor(color);
+				uint32_t texel = texels[size_t(y) * size + x];
+				for (uint32_t shift = 0; shift < 24; shift += 8)
+				{
+					skyError = std::max(skyError, uint32_t(abs(int((texel >> shift) & 0xff) - int((expected >> shift) & 0xff))));
+				}
+			}
+		}
+	}
+	printf("mip 0 against the sky: max error %u%s\n", skyError, skyError > MaxSkyError ? "; FAILED" : "");
+	passed &= skyError <= MaxSkyError;
+
+	// Mip 0 across the top, the other mips side by side below it.
+	uint32_t width = size * 4, height = size * 3;
+	uint32_t mipsWidth = 0;
+	for (uint32_t mip = 1; mip < cube.mipLevels; ++mip)
+	{
+		mipsWidth += cube.LevelWidth(mip) * 4;
+	}
+	if (cube.mipLevels > 1)
+	{
+		width = std::max(width, mipsWidth);
+		height += cube.LevelWidth(1) * 3;
+	}
+	std::vector<uint32_t> image(size_t(width) * height, 0xff000000u);
+	DrawCross(cube, 0, 0, 0, image, width);
+	for (uint32_t mip = 1, left = 0; mip < cube.mipLevels; ++mip)
+	{
+		DrawCross(cube, mip, left, size * 3, image, width);
+		left += cube.LevelWidth(mip) * 4;
+	}
+	if (!WriteImage(output, image, width, height))
+	{
+		fprintf(stderr, "%s: can't write image\n", output);
+		return 1;
+	}
+
+	if (reference)
+	{
+		std::vector<uint32_t> expected;
+		uint32_t expectedWidth = 0, expectedHeight = 0;
+		if (!ReadImage(reference, expected, expectedWidth, expectedHeight))
+		{
+			fprintf(stderr, "%s: can't read image\n", reference);
+			return 1;
+		}
+		if (expectedWidth != width || expectedHeight != height)
+		{
+			fprintf(stderr, "%s is %ux%u, built %ux%u\n", reference, expectedWidth, expectedHeight, width, height);
+			return 1;
+		}
+		uint32_t maxError = 0;
+		size_t pixelsOver = 0;
+		for (size_t i = 0; i < image.size(); ++i)
+		{
+			uint32_t error = 0;
+			for (uint32_t shift = 0; shift < 24; shift += 8)
+			{
+				error = std::max(error, uint32_t(abs(int((image[i] >> shift) & 0xff) - int((expected[i] >> shift) & 0xff))));
+			}
+			maxError = std::max(maxError, error);
+			pixelsOver += error > tolerance ? 1 : 0;
+		}
+		printf("against %s: max error %u, %zu pixels over %u\n", reference, maxError, pixelsOver, tolerance);
+		passed &= pixelsOver == 0;
+	}
+	return passed ? 0 : 1;
+}
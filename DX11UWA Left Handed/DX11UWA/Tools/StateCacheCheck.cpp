@@ -0,0 +1,400 @@
+// Checks StateCache, the filter between the render queue and the device context.
+//
+//   StateCacheCheck [calls] [frames]
+//
+// Drives the cache through a backend that records every call it receives. A script first covers
+// the cases the renderer relies on: the first call of each kind always goes through, a repeat is
+// filtered only for the same stage, slot and arguments, Invalidate, BeginFrame and SetBackend make
+// the next calls go through again, slots past the cached range are passed on every time, draws
+// and buffer updates are never filtered, and a cache without a backend still counts. Then plays
+// calls (default 20000) random state calls per frame over frames (default 50), with Invalidate
+// now and then, against a model of what the device has bound: each call must reach the backend
+// exactly when it changes that state, with its arguments intact, and each frame's counters must
+// match. Exits with 1 on any mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common StateCacheCheck.cpp ..\DX11UWA\Common\StateCache.cpp
+//   g++ -O2 -I../DX11UWA/Common StateCacheCheck.cpp ../DX11UWA/Common/StateCache.cpp
+
+#include "StateCache.h"
+
+#include <array>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const uint32_t CallDraw = DX::StateCallCount;
+	const uint32_t CallDrawInstanced = DX::StateCallCount + 1;
+	const uint32_t CallUpdate = DX::StateCallCount + 2;
+
+	const char* const CallNames[] =
+	{
+		"input layout", "vertex buffer", "index buffer", "topology", "shader", "constant buffer",
+		"shader resource", "sampler", "rasterizer state", "draw", "instanced draw", "buffer update",
+	};
+
+	struct Call
+	{
+		uint32_t kind;
+		uint32_t stage;
+		uint32_t slot;
+		const void* handle;
+		uint32_t a;
+		uint32_t b;
+
+		bool operator==(const Call& other) const
+		{
+			return kind == other.kind && stage == other.stage && slot == other.slot && handle == other.handle && a == other.a && b == other.b;
+		}
+	};
+
+	class RecordingBackend : public DX::IRenderBackend
+	{
+	public:
+		std::vector<Call> calls;
+
+		void SetInputLayout(const void* layout) override { Record(DX::CallInputLayout, 0, 0, layout, 0, 0); }
+		void SetVertexBuffer(uint32_t slot, const void* buffer, uint32_t stride, uint32_t offset) override
+		{
+			Record(DX::CallVertexBuffer, 0, slot, buffer, stride, offset);
+		}
+		void SetIndexBuffer(const void* buffer, uint32_t format, uint32_t offset) override
+		{
+			Record(DX::CallIndexBuffer, 0, 0, buffer, format, offset);
+		}
+		void SetPrimitiveTopology(uint32_t topology) override { Record(DX::CallTopology, 0, 0, nullptr, topology, 0); }
+		void SetShader(DX::ShaderStage stage, const void* shader) override { Record(DX::CallShader, stage, 0, shader, 0, 0); }
+		void SetConstantBuffer(DX::ShaderStage stage, uint32_t slot, const void* buffer, uint32_t firstConstant, uint32_t constantCount) override
+		{
+			Record(DX::CallConstantBuffer, stage, slot, buffer, firstConstant, constantCount);
+		}
+		void SetShaderResource(DX::ShaderStage stage, uint32_t slot, const void* view) override
+		{
+			Record(DX::CallShaderResource, stage, slot, view, 0, 0);
+		}
+		void SetSampler(DX::ShaderStage stage, uint32_t slot, const void* sampler) override
+		{
+			Record(DX::CallSampler, stage, slot, sampler, 0, 0);
+		}
+		void SetRasterizerState(const void* state) override { Record(DX::CallRasterizerState, 0, 0, state, 0, 0); }
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override
+		{
+			Record(CallDraw, 0, startIndex, nullptr, indexCount, uint32_t(baseVertex));
+		}
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override
+		{
+			Record(CallDrawInstanced, startInstance, startIndex, nullptr, indexCount, instanceCount ^ uint32_t(baseVertex));
+		}
+		void UpdateBuffer(const void* buffer, const void* data, uint32_t size) override
+		{
+			Record(CallUpdate, 0, 0, buffer, size, *static_cast<const uint32_t*>(data));
+		}
+
+	private:
+		void Record(uint32_t kind, uint32_t stage, uint32_t slot, const void* handle, uint32_t a, uint32_t b)
+		{
+			calls.push_back(Call{ kind, stage, slot, handle, a, b });
+		}
+	};
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// Slots the cache tracks for a kind of call; 1 for the kinds without slots.
+	uint32_t CachedSlots(uint32_t kind)
+	{
+		switch (kind)
+		{
+		case DX::CallVertexBuffer: return DX::StateCache::VertexBufferSlots;
+		case DX::CallConstantBuffer: return DX::StateCache::ConstantBufferSlots;
+		case DX::CallShaderResource: return DX::StateCache::ShaderResourceSlots;
+		case DX::CallSampler: return DX::StateCache::SamplerSlots;
+		default: return 1;
+		}
+	}
+
+	void Issue(DX::StateCache& cache, const Call& call)
+	{
+		DX::ShaderStage stage = DX::ShaderStage(call.stage);
+		switch (call.kind)
+		{
+		case DX::CallInputLayout: cache.SetInputLayout(call.handle); break;
+		case DX::CallVertexBuffer: cache.SetVertexBuffer(call.slot, call.handle, call.a, call.b); break;
+		case DX::CallIndexBuffer: cache.SetIndexBuffer(call.handle, call.a, call.b); break;
+		case DX::CallTopology: cache.SetPrimitiveTopology(call.a); break;
+		case DX::CallShader: cache.SetShader(stage, call.handle); break;
+		case DX::CallConstantBuffer: cache.SetConstantBuffer(stage, call.slot, call.handle, call.a, call.b); break;
+		case DX::CallShaderResource: cache.SetShaderResource(stage, call.slot, call.handle); break;
+		case DX::CallSampler: cache.SetSampler(stage, call.slot, call.handle); break;
+		case DX::CallRasterizerState: cache.SetRasterizerState(call.handle); break;
+		case CallDraw: cache.DrawIndexed(call.a, call.slot, int32_t(call.b)); break;
+		case CallDrawInstanced: cache.DrawIndexedInstanced(call.a, call.b, call.slot, 0, call.stage); break;
+		case CallUpdate: cache.UpdateBuffer(call.handle, &call.b, call.a); break;
+		}
+	}
+
+	// What the backend has seen, per kind, stage and slot.
+	class DeviceModel
+	{
+	public:
+		// Whether the call changes what is bound, or isn't cached at all.
+		bool Changes(const Call& call) const
+		{
+			if (call.kind >= DX::StateCallCount || call.slot >= CachedSlots(call.kind))
+				return true;
+			auto bound = m_bound.find(Key(call));
+			return bound == m_bound.end() || !(bound->second == call);
+		}
+
+		void Bind(const Call& call)
+		{
+			if (call.kind < DX::StateCallCount && call.slot < CachedSlots(call.kind))
+				m_bound[Key(call)] = call;
+		}
+
+		void Forget(void) { m_bound.clear(); }
+
+	private:
+		static std::array<uint32_t, 3> Key(const Call& call) { return { { call.kind, call.stage, call.slot } }; }
+
+		std::map<std::array<uint32_t, 3>, Call> m_bound;
+	};
+
+	class Checker
+	{
+	public:
+		Checker(void) : cache(&backend), passed(true)
+		{
+			memset(&stats, 0, sizeof(stats));
+		}
+
+		// Issues the call and checks that it reaches the backend if and only if forwarded.
+		void Expect(const char* what, const Call& call, bool forwarded)
+		{
+			size_t before = backend.calls.size();
+			Issue(cache, call);
+			bool reached = backend.calls.size() == before + 1 && backend.calls.back() == call;
+			if (backend.calls.size() != before + (forwarded ? 1 : 0) || (forwarded && !reached))
+			{
+				printf("%s: %s %s\n", what, CallNames[call.kind], forwarded ? "didn't reach the backend intact" : "wasn't filtered");
+				passed = false;
+			}
+			if (call.kind < DX::StateCallCount)
+				++(forwarded ? stats.issued : stats.filtered)[call.kind];
+		}
+
+		bool SameStats(const DX::StateCacheStats& found) const
+		{
+			return memcmp(found.issued, stats.issued, sizeof(stats.issued)) == 0 &&
+				   memcmp(found.filtered, stats.filtered, sizeof(stats.filtered)) == 0;
+		}
+
+		RecordingBackend backend;
+		DX::StateCache cache;
+		DX::StateCacheStats stats;
+		bool passed;
+	};
+
+	const int Handles[8] = {};
+	const void* Handle(uint32_t i) { return &Handles[i]; }
+
+	Call Make(uint32_t kind, uint32_t stage, uint32_t slot, const void* handle, uint32_t a = 0, uint32_t b = 0)
+	{
+		return Call{ kind, stage, slot, handle, a, b };
+	}
+
+	bool CheckScript(void)
+	{
+		Checker c;
+		const Call vs = Make(DX::CallShader, DX::StageVertex, 0, Handle(0));
+		c.Expect("first shader", vs, true);
+		c.Expect("same shader", vs, false);
+		c.Expect("same shader on another stage", Make(DX::CallShader, DX::StagePixel, 0, Handle(0)), true);
+		c.Expect("null shader", Make(DX::CallShader, DX::StageHull, 0, nullptr), true);
+		c.Expect("null shader again", Make(DX::CallShader, DX::StageHull, 0, nullptr), false);
+
+		const Call cb = Make(DX::CallConstantBuffer, DX::StageVertex, 1, Handle(1), 0, 16);
+		c.Expect("constant range", cb, true);
+		c.Expect("same constant range", cb, false);
+		c.Expect("constants moved", Make(DX::CallConstantBuffer, DX::StageVertex, 1, Handle(1), 16, 16), true);
+		c.Expect("constants resized", Make(DX::CallConstantBuffer, DX::StageVertex, 1, Handle(1), 16, 32), true);
+		c.Expect("constants in another slot", Make(DX::CallConstantBuffer, DX::StageVertex, 0, Handle(1), 16, 32), true);
+		c.Expect("constants in another stage", Make(DX::CallConstantBuffer, DX::StageDomain, 1, Handle(1), 16, 32), true);
+
+		c.Expect("vertex buffer", Make(DX::CallVertexBuffer, 0, 0, Handle(2), 32, 0), true);
+		c.Expect("new stride", Make(DX::CallVertexBuffer, 0, 0, Handle(2), 48, 0), true);
+		c.Expect("new offset", Make(DX::CallVertexBuffer, 0, 0, Handle(2), 48, 96), true);
+		c.Expect("same stream", Make(DX::CallVertexBuffer, 0, 0, Handle(2), 48, 96), false);
+		c.Expect("index buffer", Make(DX::CallIndexBuffer, 0, 0, Handle(3), 42, 0), true);
+		c.Expect("index format", Make(DX::CallIndexBuffer, 0, 0, Handle(3), 57, 0), true);
+		c.Expect("same index buffer", Make(DX::CallIndexBuffer, 0, 0, Handle(3), 57, 0), false);
+		c.Expect("topology", Make(DX::CallTopology, 0, 0, nullptr, 4), true);
+		c.Expect("same topology", Make(DX::CallTopology, 0, 0, nullptr, 4), false);
+		c.Expect("texture", Make(DX::CallShaderResource, DX::StagePixel, 0, Handle(4)), true);
+		c.Expect("texture in the next slot", Make(DX::CallShaderResource, DX::StagePixel, 1, Handle(4)), true);
+		c.Expect("same texture", Make(DX::CallShaderResource, DX::StagePixel, 1, Handle(4)), false);
+		c.Expect("sampler", Make(DX::CallSampler, DX::StagePixel, 0, Handle(5)), true);
+		c.Expect("same sampler", Make(DX::CallSampler, DX::StagePixel, 0, Handle(5)), false);
+		c.Expect("input layout", Make(DX::CallInputLayout, 0, 0, Handle(6)), true);
+		c.Expect("same input layout", Make(DX::CallInputLayout, 0, 0, Handle(6)), false);
+		c.Expect("default rasterizer", Make(DX::CallRasterizerState, 0, 0, nullptr), true);
+		c.Expect("default rasterizer again", Make(DX::CallRasterizerState, 0, 0, nullptr), false);
+
+		// Past the cached range every call goes through, the same one twice included.
+		const Call pastSlots[] =
+		{
+			Make(DX::CallVertexBuffer, 0, DX::StateCache::VertexBufferSlots, Handle(2), 32, 0),
+			Make(DX::CallConstantBuffer, DX::StagePixel, DX::StateCache::ConstantBufferSlots, Handle(1), 0, 0),
+			Make(DX::CallShaderResource, DX::StagePixel, DX::StateCache::ShaderResourceSlots, Handle(4)),
+			Make(DX::CallSampler, DX::StageDomain, DX::StateCache::SamplerSlots + 9, Handle(5)),
+		};
+		for (const Call& call : pastSlots)
+		{
+			c.Expect("past the cached slots", call, true);
+			c.Expect("past the cached slots again", call, true);
+		}
+
+		// Draws and updates are never filtered and keep their place among the state calls.
+		c.Expect("draw", Make(CallDraw, 0, 6, nullptr, 36, 0), true);
+		c.Expect("same draw", Make(CallDraw, 0, 6, nullptr, 36, 0), true);
+		c.Expect("instanced draw", Make(CallDrawInstanced, 3, 0, nullptr, 36, 100), true);
+		c.Expect("buffer update", Make(CallUpdate, 0, 0, Handle(7), 4, 0x1234), true);
+		c.Expect("same buffer update", Make(CallUpdate, 0, 0, Handle(7), 4, 0x1234), true);
+
+		if (!c.SameStats(c.cache.GetStats()))
+		{
+			printf("script: counters differ\n");
+			c.passed = false;
+		}
+
+		c.cache.Invalidate();
+		c.Expect("shader after Invalidate", vs, true);
+		c.Expect("constants after Invalidate", cb, true);
+		c.Expect("default rasterizer after Invalidate", Make(DX::CallRasterizerState, 0, 0, nullptr), true);
+
+		const DX::StateCacheStats frame = c.stats;
+		c.cache.BeginFrame();
+		memset(&c.stats, 0, sizeof(c.stats));
+		if (!c.SameStats(c.cache.GetStats()) || memcmp(&c.cache.GetLastFrameStats(), &frame, sizeof(frame)) != 0 ||
+			frame.TotalIssued() != 30 || frame.TotalFiltered() != 10)
+		{
+			printf("BeginFrame: counters not moved to the last frame, %u issued and %u filtered\n",
+				   c.cache.GetLastFrameStats().TotalIssued(), c.cache.GetLastFrameStats().TotalFiltered());
+			c.passed = false;
+		}
+		c.Expect("shader after BeginFrame", vs, true);
+		c.Expect("same shader after BeginFrame", vs, false);
+
+		RecordingBackend other;
+		c.cache.SetBackend(&other);
+		Issue(c.cache, vs);
+		if (other.calls.size() != 1)
+		{
+			printf("SetBackend: first shader filtered\n");
+			c.passed = false;
+		}
+
+		// Without a backend nothing is called, but the cache still tracks and counts.
+		DX::StateCache detached;
+		Issue(detached, vs);
+		Issue(detached, vs);
+		Issue(detached, Make(CallDraw, 0, 0, nullptr, 3, 0));
+		detached.SetBackend(&other);
+		Issue(detached, vs);
+		if (detached.GetStats().issued[DX::CallShader] != 2 || detached.GetStats().filtered[DX::CallShader] != 1 || other.calls.size() != 2)
+		{
+			printf("no backend: counted %u issued, %u filtered\n", detached.GetStats().issued[DX::CallShader],
+				   detached.GetStats().filtered[DX::CallShader]);
+			c.passed = false;
+		}
+		printf("script: %zu calls reached the backend%s\n", c.backend.calls.size(), c.passed ? "" : "; FAILED");
+		return c.passed;
+	}
+
+	Call RandomCall(uint32_t& state)
+	{
+		Call call = Make(Random(state) % (DX::StateCallCount + 2), Random(state) % DX::StageCount, 0, nullptr);
+		if (call.kind >= DX::StateCallCount)
+		{
+			call.kind = CallDraw;
+			call.stage = 0;
+			call.a = Random(state) % 1000;
+			return call;
+		}
+		// Mostly cached slots, a few past them.
+		call.slot = Random(state) % (CachedSlots(call.kind) + 1);
+		if (CachedSlots(call.kind) == 1)
+			call.slot = 0;
+		uint32_t handle = Random(state) % 4;
+		call.handle = handle == 3 ? nullptr : Handle(handle);
+		switch (call.kind)
+		{
+		case DX::CallVertexBuffer: call.a = 16 * (1 + Random(state) % 2); call.b = Random(state) % 2 * 64; break;
+		case DX::CallIndexBuffer: call.a = Random(state) % 2 ? 42 : 57; break;
+		case DX::CallTopology: call.handle = nullptr; call.a = Random(state) % 3; break;
+		case DX::CallConstantBuffer: call.a = Random(state) % 2 * 16; call.b = Random(state) % 2 * 16; break;
+		}
+		if (call.kind == DX::CallInputLayout || call.kind == DX::CallVertexBuffer || call.kind == DX::CallIndexBuffer ||
+			call.kind == DX::CallTopology || call.kind == DX::CallRasterizerState)
+			call.stage = 0;
+		return call;
+	}
+
+	bool CheckRandom(uint32_t callsPerFrame, uint32_t frames)
+	{
+		Checker c;
+		DeviceModel model;
+		uint32_t state = 7;
+		uint64_t issued = 0, filtered = 0;
+		for (uint32_t frame = 0; frame < frames && c.passed; ++frame)
+		{
+			for (uint32_t i = 0; i < callsPerFrame && c.passed; ++i)
+			{
+				if (Random(state) % 2000 == 0)
+				{
+					c.cache.Invalidate();
+					model.Forget();
+				}
+				Call call = RandomCall(state);
+				bool forwarded = model.Changes(call);
+				c.Expect("random", call, forwarded);
+				model.Bind(call);
+			}
+			if (!c.SameStats(c.cache.GetStats()))
+			{
+				printf("frame %u: counters differ\n", frame);
+				c.passed = false;
+			}
+			issued += c.stats.TotalIssued();
+			filtered += c.stats.TotalFiltered();
+			c.cache.BeginFrame();
+			model.Forget();
+			memset(&c.stats, 0, sizeof(c.stats));
+		}
+		printf("random: %u frames of %u calls, %llu state calls issued and %llu filtered%s\n", frames,
+			   callsPerFrame, static_cast<unsigned long long>(issued), static_cast<unsigned long long>(filtered), c.passed ? "" : "; FAILED");
+		return c.passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t calls = argc > 1 ? uint32_t(atoi(argv[1])) : 20000;
+	uint32_t frames = argc > 2 ? uint32_t(atoi(argv[2])) : 50;
+	if (argc > 3)
+	{
+		fprintf(stderr, "usage: %s [calls] [frames]\n", argv[0]);
+		return 1;
+	}
+
+	bool passed = CheckScript();
+	passed &= CheckRandom(calls, frames);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+// Checks TessellateMesh, the load-time tessellation that stands in for the hull and domain shaders.
+//
+//   TessellationCheck <Assets dir> [factor] [phong alpha]
+//
+// Loads the scene's meshes from Assets and tessellates each with TessellateMesh at every odd
+// factor up to factor (default 15), with a Phong shape factor (default 0.75, so the curved surface
+// is checked; the renderer ships with 0, which leaves it flat). The
+// stadium is left out: where its corners disagree on the normal the patches would part on the
+// GPU, and TessellateMesh closes the gap by bending one side, so TessellationPolicy never
+// tessellates such meshes. Every patch must come back as the points the tessellator places with
+// integer partitioning, rings of n - 2r segments per side, each evaluated in double precision
+// with the formula of DomainShader.hlsl from the patch's own corners: position, uv and normal.
+// The triangles of each patch must keep its winding and cover its domain exactly once. Then the
+// open sides of the result are counted with corners welded by position: a tessellated mesh must
+// have factor times the open sides of the original, which is none for the closed sphere.obj and
+// pyramid.obj, or it has cracks. Exits with 1 on any mismatch. Only depends on the portable
+// sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common TessellationCheck.cpp ..\DX11UWA\Common\ObjMesh.cpp ..\DX11UWA\Common\TessellationCache.cpp ..\DX11UWA\Common\WorkerPool.cpp
+//   g++ -O2 -pthread -I../DX11UWA/Common TessellationCheck.cpp ../DX11UWA/Common/{ObjMesh,TessellationCache,WorkerPool}.cpp
+
+#include "ObjMesh.h"
+#include "TessellationCache.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <map>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const char* const MeshFiles[] =
+	{
+		"floor_bottom.obj", "floor_platform.obj", "pokeballred.obj", "pokeballwhite.obj", "pokeballblack.obj",
+		"sphere.obj", "pyramid.obj",
+	};
+
+	// Largest difference allowed from the double precision evaluation, relative to the mesh size
+	// for positions and absolute for uvs and normals.
+	const double MaxError = 1e-5;
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	struct DomainPoint
+	{
+		double domain[3];
+		double pos[3];
+		double uv[3];
+		double normal[3];
+	};
+
+	// The points the tessellator places on a triangle domain with integer partitioning and every
+	// factor set to the odd n: ring r is the triangle shrunk about its centre to (n - 2r) / n,
+	// split into n - 2r segments per side, down to a single triangle.
+	std::vector<std::array<double, 3>> DomainPoints(uint32_t n)
+	{
+		std::vector<std::array<double, 3>> points;
+		for (uint32_t m = n; m >= 1; m -= 2)
+		{
+			double scale = double(m) / n;
+			for (int side = 0; side < 3; ++side)
+			{
+				for (uint32_t j = 0; j < m; ++j)
+				{
+					double t = double(j) / m;
+					std::array<double, 3> point;
+					for (int c = 0; c < 3; ++c)
+					{
+						double from = (1.0 - scale) / 3.0 + (c == side ? scale : 0.0);
+						double to = (1.0 - scale) / 3.0 + (c == (side + 1) % 3 ? scale : 0.0);
+						point[c] = from + t * (to - from);
+					}
+					points.push_back(point);
+				}
+			}
+			if (m == 1)
+				break;
+		}
+		return points;
+	}
+
+	// DomainShader.hlsl, before the model, view and projection transforms.
+	DomainPoint Evaluate(const DX::ObjVertex* corners[3], const std::array<double, 3>& domain, double phongAlpha)
+	{
+		DomainPoint point = {};
+		double flat[3] = {};
+		for (int i = 0; i < 3; ++i)
+		{
+			point.domain[i] = domain[i];
+			for (int c = 0; c < 3; ++c)
+			{
+				flat[c] += corners[i]->pos[c] * domain[i];
+				point.uv[c] += corners[i]->uv[c] * domain[i];
+				point.normal[c] += corners[i]->normal[c] * domain[i];
+			}
+		}
+		double curved[3] = {};
+		for (int i = 0; i < 3; ++i)
+		{
+			const float* normal = corners[i]->normal;
+			double length = sqrt(double(normal[0]) * normal[0] + double(normal[1]) * normal[1] + double(normal[2]) * normal[2]);
+			double n[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+			double height = 0.0;
+			for (int c = 0; c < 3; ++c)
+			{
+				height += (flat[c] - corners[i]->pos[c]) * n[c];
+			}
+			for (int c = 0; c < 3; ++c)
+			{
+				curved[c] += domain[i] * (flat[c] - height * n[c]);
+			}
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			point.pos[c] = flat[c] + phongAlpha * (curved[c] - flat[c]);
+		}
+		return point;
+	}
+
+	double Distance(const double a[3], const float b[3])
+	{
+		double x = a[0] - b[0], y = a[1] - b[1], z = a[2] - b[2];
+		return sqrt(x * x + y * y + z * z);
+	}
+
+	// Sides of exactly one triangle, with corners at the same position counted as one vertex.
+	size_t CountOpenSides(const std::vector<DX::ObjVertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::map<std::array<float, 3>, uint32_t> positions;
+		std::vector<uint32_t> weld(vertices.size());
+		for (size_t v = 0; v < vertices.size(); ++v)
+		{
+			// Adding zero turns -0 into +0.
+			std::array<float, 3> key = { vertices[v].pos[0] + 0.0f, vertices[v].pos[1] + 0.0f, vertices[v].pos[2] + 0.0f };
+			weld[v] = positions.insert(std::make_pair(key, uint32_t(positions.size()))).first->second;
+		}
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> sides;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32_t a = weld[indices[i + k]], b = weld[indices[i + (k + 1) % 3]];
+				++sides[std::make_pair(std::min(a, b), std::max(a, b))];
+			}
+		}
+		size_t open = 0;
+		for (const auto& side : sides)
+		{
+			open += side.second == 1 ? 1 : 0;
+		}
+		return open;
+	}
+
+	struct PatchErrors
+	{
+		double position;
+		double attribute;
+		size_t unmatched;	// Points with no vertex close enough, or vertices left over.
+		size_t wound;		// Triangles turned against the patch.
+		double coverage;	// Largest difference of the triangles' domain area from the patch's.
+		size_t degenerate;	// Patches without area, whose points all fall together.
+	};
+
+	// Twice the area of a triangle.
+	double TwiceArea(const float a[3], const float b[3], const float c[3])
+	{
+		double u[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+		double v[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+		double x = u[1] * v[2] - u[2] * v[1], y = u[2] * v[0] - u[0] * v[2], z = u[0] * v[1] - u[1] * v[0];
+		return sqrt(x * x + y * y + z * z);
+	}
+
+	// Matches the vertices of each patch to the domain points and measures how far they are.
+	PatchErrors CheckPatches(const std::vector<DX::ObjVertex>& vertices, const std::vector<uint32_t>& indices,
+							 const DX::TessellatedMesh& mesh, double phongAlpha, double size)
+	{
+		PatchErrors errors = {};
+		const size_t patches = indices.size() / 3;
+		const std::vector<std::array<double, 3>> domainPoints = DomainPoints(mesh.factor);
+		if (patches == 0 || mesh.indices.size() % patches != 0)
+		{
+			errors.unmatched = 1;
+			return errors;
+		}
+		const size_t perPatch = mesh.indices.size() / patches;
+		std::vector<DomainPoint> points;
+		std::vector<uint32_t> patchVertices;
+		std::vector<int> matchOf;
+		for (size_t t = 0; t < patches; ++t)
+		{
+			const DX::ObjVertex* corners[3] = { &vertices[indices[t * 3]], &vertices[indices[t * 3 + 1]], &vertices[indices[t * 3 + 2]] };
+			points.clear();
+			for (const std::array<double, 3>& domain : domainPoints)
+			{
+				points.push_back(Evaluate(corners, domain, phongAlpha));
+			}
+			// Points that fall together can't be told apart, so a patch without area is only checked
+			// for vertices on its surface.
+			const bool degenerate = TwiceArea(corners[0]->pos, corners[1]->pos, corners[2]->pos) <= 1e-12 * size * size;
+			errors.degenerate += degenerate ? 1 : 0;
+			const uint32_t* triangles = mesh.indices.data() + t * perPatch;
+			patchVertices.assign(triangles, triangles + perPatch);
+			std::sort(patchVertices.begin(), patchVertices.end());
+			patchVertices.erase(std::unique(patchVertices.begin(), patchVertices.end()), patchVertices.end());
+			if (patchVertices.size() != points.size())
+			{
+				errors.unmatched += std::max(patchVertices.size(), points.size()) - std::min(patchVertices.size(), points.size());
+			}
+
+			// Each vertex goes to the nearest point; two vertices on one point leave another unmatched.
+			matchOf.assign(patchVertices.size(), -1);
+			std::vector<bool> taken(points.size(), false);
+			for (size_t v = 0; v < patchVertices.size(); ++v)
+			{
+				const DX::ObjVertex& vertex = mesh.vertices[patchVertices[v]];
+				double best = 1e30;
+				for (size_t p = 0; p < points.size(); ++p)
+				{
+					double distance = Distance(points[p].pos, vertex.pos) + Distance(points[p].uv, vertex.uv);
+					if (distance < best)
+					{
+						best = distance;
+						matchOf[v] = int(p);
+					}
+				}
+				if (matchOf[v] < 0 || (taken[matchOf[v]] && !degenerate))
+				{
+					++errors.unmatched;
+					continue;
+				}
+				taken[matchOf[v]] = true;
+				const DomainPoint& point = points[matchOf[v]];
+				errors.position = std::max(errors.position, Distance(point.pos, vertex.pos) / size);
+				errors.attribute = std::max(errors.attribute, std::max(Distance(point.uv, vertex.uv), Distance(point.normal, vertex.normal)));
+			}
+
+			if (degenerate)
+				continue;
+
+			// In the domain, every triangle must turn like the patch, and together they must cover
+			// its area of one half exactly.
+			double area = 0.0;
+			for (size_t i = 0; i < perPatch; i += 3)
+			{
+				const double* d[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					size_t v = std::lower_bound(patchVertices.begin(), patchVertices.end(), triangles[i + k]) - patchVertices.begin();
+					d[k] = matchOf[v] < 0 ? points[0].domain : points[matchOf[v]].domain;
+				}
+				double twice = (d[1][0] - d[0][0]) * (d[2][1] - d[0][1]) - (d[1][1] - d[0][1]) * (d[2][0] - d[0][0]);
+				errors.wound += twice > 0.0 ? 0 : 1;
+				area += 0.5 * fabs(twice);
+			}
+			errors.coverage = std::max(errors.coverage, fabs(area - 0.5));
+		}
+		return errors;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <Assets dir> [factor] [phong alpha]\n", argv[0]);
+		return 1;
+	}
+	const std::string assets = argv[1];
+	const uint32_t maxFactor = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 15;
+	const float phongAlpha = argc > 3 ? static_cast<float>(atof(argv[3])) : 0.75f;
+	if (maxFactor < 1 || maxFactor > 64)
+	{
+		fprintf(stderr, "factor must be 1 to 64\n");
+		return 1;
+	}
+
+	bool passed = true;
+	for (const char* file : MeshFiles)
+	{
+		std::vector<DX::ObjVertex> vertices;
+		std::vector<uint32_t> indices;
+		if (!DX::LoadObjMesh((assets + "/" + file).c_str(), vertices, indices) || indices.empty())
+		{
+			fprintf(stderr, "%s: can't load mesh\n", file);
+			return 1;
+		}
+		double low[3] = { 1e30, 1e30, 1e30 }, high[3] = { -1e30, -1e30, -1e30 };
+		for (const DX::ObjVertex& vertex : vertices)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				low[c] = std::min(low[c], double(vertex.pos[c]));
+				high[c] = std::max(high[c], double(vertex.pos[c]));
+			}
+		}
+		const double size = std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+		const size_t open = CountOpenSides(vertices, indices);
+
+		for (uint32_t n = 1; n <= maxFactor; n += 2)
+		{
+			DX::TessellatedMesh mesh;
+			auto start = std::chrono::steady_clock::now();
+			DX::TessellateMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), n, phongAlpha, mesh, DX::WorkerPool::Shared());
+			double ms = Milliseconds(start);
+			PatchErrors errors = CheckPatches(vertices, indices, mesh, phongAlpha, size);
+			size_t tessellatedOpen = CountOpenSides(mesh.vertices, mesh.indices);
+			bool ok = mesh.factor == n && errors.position <= MaxError && errors.attribute <= MaxError && !errors.unmatched &&
+					  !errors.wound && errors.coverage <= 1e-9 && tessellatedOpen == open * n;
+			printf("%-18s factor %2u: %8zu triangles in %7.3f ms, error %.1e (uv, normal %.1e), %zu unmatched, %zu turned, "
+				   "%zu open sides for %zu%s%s\n", file, n, mesh.indices.size() / 3, ms, errors.position, errors.attribute,
+				   errors.unmatched, errors.wound, tessellatedOpen, open * n, errors.degenerate ? ", degenerate patches skipped" : "",
+				   ok ? "" : "; FAILED");
+			passed = passed && ok;
+		}
+	}
+	return passed ? 0 : 1;
+}
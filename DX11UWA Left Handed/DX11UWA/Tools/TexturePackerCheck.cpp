@@ -0,0 +1,166 @@
+// Checks TexturePacker, the atlas packing behind the renderer's material Texture2DArray pages.
+//
+//   TexturePackerCheck
+//
+// Packs a few fixed sets of textures: the two material textures the app ships, sixteen 256x256
+// images with full mip chains, forty images of odd sizes with five mips, twenty 1024x1024 images
+// that need several pages, and a set with a wrapping and an oversized texture. For every set each
+// image must sit inside its page with its whole gutter, no two gutters may overlap, every image
+// origin and page size must be a multiple of the coarsest mip's footprint so mip offsets stay
+// exact, and the uv transform must map [0,1] onto the image. Each set must also come out at its
+// expected page count and at least its expected efficiency (image area over page area); a gutter
+// padded to the mip footprint misses those. Prints the stats per set and exits with 1 on any
+// mismatch. Only depends on the portable sources in DX11UWA/Common, e.g.:
+//
+//   cl /O2 /EHsc /I..\DX11UWA\Common TexturePackerCheck.cpp ..\DX11UWA\Common\TexturePacker.cpp
+//   g++ -O2 -I../DX11UWA/Common TexturePackerCheck.cpp ../DX11UWA/Common/TexturePacker.cpp
+
+#include "TexturePacker.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace
+{
+	// DXGI_FORMAT_R8G8B8A8_UNORM and DXGI_FORMAT_BC1_UNORM.
+	const uint32_t FormatRGBA = 28;
+	const uint32_t FormatBC1 = 71;
+
+	uint32_t Random(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	DX::PackInput Input(uint32_t id, uint32_t width, uint32_t height, uint32_t mipLevels, bool wraps = false, uint32_t format = FormatRGBA)
+	{
+		DX::PackInput input = { id, width, height, format, mipLevels, wraps };
+		return input;
+	}
+
+	// Packs inputs and checks the placement of every region; expectedPacked is the number of
+	// inputs that must come out placed, the rest must be reported as left out.
+	bool Check(const char* name, const std::vector<DX::PackInput>& inputs, const DX::AtlasSettings& settings, size_t expectedPacked,
+			   uint32_t expectedPages, float minEfficiency)
+	{
+		bool passed = true;
+		auto fail = [&](const char* what, uint32_t id)
+		{
+			printf("%s: texture %u %s\n", name, id, what);
+			passed = false;
+		};
+
+		DX::TexturePacker packer(settings);
+		bool allPacked = packer.Pack(inputs);
+		const std::vector<DX::PackedRegion>& regions = packer.GetRegions();
+		const std::vector<DX::PackedGroup>& groups = packer.GetGroups();
+		if (allPacked != (expectedPacked == inputs.size()) || regions.size() != expectedPacked)
+		{
+			printf("%s: %zu of %zu textures packed, expected %zu\n", name, regions.size(), inputs.size(), expectedPacked);
+			passed = false;
+		}
+
+		for (const DX::PackInput& in : inputs)
+		{
+			const DX::PackedRegion* region = packer.FindRegion(in.id);
+			if (!region)
+				continue;
+			if (region->width != in.width || region->height != in.height || region->group >= groups.size())
+			{
+				fail("lost its size or group", in.id);
+				continue;
+			}
+
+			const DX::PackedGroup& group = groups[region->group];
+			const uint32_t gutter = in.wraps ? 0 : settings.gutter;
+			const uint32_t alignment = 1u << (group.mipLevels - 1);
+			if (group.format != in.format || region->page >= group.pageCount)
+				fail("landed in a group of another format or past its pages", in.id);
+			if (region->x < gutter || region->y < gutter || region->x + in.width + gutter > group.pageWidth ||
+				region->y + in.height + gutter > group.pageHeight)
+				fail("doesn't fit in its page with its gutter", in.id);
+			if (region->x % alignment || region->y % alignment || group.pageWidth % alignment || group.pageHeight % alignment)
+				fail("isn't aligned to the coarsest mip", in.id);
+			if (group.pageWidth > settings.maxPageSize || group.pageHeight > settings.maxPageSize)
+				fail("is on a page larger than maxPageSize", in.id);
+			if (fabsf(region->uvOffset[0] * group.pageWidth - region->x) > 0.01f || fabsf(region->uvOffset[1] * group.pageHeight - region->y) > 0.01f ||
+				fabsf(region->uvScale[0] * group.pageWidth - in.width) > 0.01f || fabsf(region->uvScale[1] * group.pageHeight - in.height) > 0.01f)
+				fail("has a uv transform that misses its image", in.id);
+
+			for (const DX::PackedRegion& other : regions)
+			{
+				if (other.id == region->id || other.group != region->group || other.page != region->page)
+					continue;
+				// Both images with their gutters must stay apart.
+				if (region->x < other.x + other.width + 2 * gutter && other.x < region->x + region->width + 2 * gutter &&
+					region->y < other.y + other.height + 2 * gutter && other.y < region->y + region->height + 2 * gutter)
+				{
+					fail("overlaps another image's gutter", in.id);
+					break;
+				}
+			}
+		}
+
+		const DX::PackStats& stats = packer.GetStats();
+		if (stats.pageCount != expectedPages)
+		{
+			printf("%s: %u pages, expected %u\n", name, stats.pageCount, expectedPages);
+			passed = false;
+		}
+		if (stats.efficiency < minEfficiency)
+		{
+			printf("%s: %.1f%% efficient, expected at least %.1f%%\n", name, stats.efficiency * 100.0f, minEfficiency * 100.0f);
+			passed = false;
+		}
+
+		printf("%s: %u of %u textures in %u groups, %u pages, %.1f%% efficient%s\n", name, stats.packedCount, stats.inputCount,
+			   stats.groupCount, stats.pageCount, stats.efficiency * 100.0f, passed ? "" : "; FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 1;
+	}
+
+	const DX::AtlasSettings defaults;
+	bool passed = true;
+
+	// Castle1.dds and pokeball.dds, as CreateMaterialAtlas submits them.
+	passed &= Check("app materials", { Input(0, 880, 65, 1), Input(1, 1152, 648, 1) }, defaults, 2, 1, 0.90f);
+
+	std::vector<DX::PackInput> mipped;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		mipped.push_back(Input(i, 256, 256, 9));
+	}
+	passed &= Check("256x256 with 9 mips", mipped, defaults, 16, 1, 0.19f);
+
+	uint32_t state = 11;
+	std::vector<DX::PackInput> odd;
+	for (uint32_t i = 0; i < 40; ++i)
+	{
+		odd.push_back(Input(i, 40 + Random(state) % 400, 40 + Random(state) % 400, 5, false, i % 4 ? FormatRGBA : FormatBC1));
+	}
+	passed &= Check("odd sizes with 5 mips", odd, defaults, 40, 2, 0.70f);
+
+	DX::AtlasSettings small;
+	small.maxPageSize = 4096;
+	std::vector<DX::PackInput> large;
+	for (uint32_t i = 0; i < 20; ++i)
+	{
+		large.push_back(Input(i, 1024, 1024, 1));
+	}
+	passed &= Check("1024x1024 on 4096 pages", large, small, 20, 3, 0.40f);
+
+	std::vector<DX::PackInput> mixed = { Input(0, 512, 512, 10, true), Input(1, 300, 200, 1), Input(2, 20000, 64, 1), Input(3, 128, 96, 1) };
+	passed &= Check("wrapping and oversized", mixed, defaults, 3, 2, 0.90f);
+
+	return passed ? 0 : 1;
+}